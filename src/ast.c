@@ -0,0 +1,174 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "ast.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/fs.h"
+#include "util/str.h"
+
+void initAst(Ast *ast, const int nodeCapacity) {
+    ast->capacity = max(nodeCapacity, 64);
+    ast->kinds = (uint8_t *)malloc(sizeof(uint8_t) * ast->capacity);
+    ast->offsets = (uint32_t *)malloc(sizeof(uint32_t) * ast->capacity);
+    ast->data = (NodeData *)malloc(sizeof(NodeData) * ast->capacity);
+    ast->count = 0;
+
+    ast->extraCapacity = max(nodeCapacity / 2, 64);
+    ast->extra = (uint32_t *)malloc(sizeof(uint32_t) * ast->extraCapacity);
+    ast->extraCount = 0;
+
+    ast->symbolCapacity = 64;
+    ast->symbols = (Symbol *)malloc(sizeof(Symbol) * ast->symbolCapacity);
+    ast->symbols[0] = SYMBOL_NONE;
+    ast->symbolCount = 1;
+
+    ast->mapped = nullptr;
+    ast->mappedSize = 0;
+
+    addAstNode(ast, VoidNodeType, 0, 0, 0);
+    const uint32_t empty = 0;
+    addAstExtra(ast, &empty, 1);
+    ast->decls = LIST_EMPTY;
+}
+
+void freeAst(Ast *ast) {
+    free(ast->symbols);
+    if (ast->mapped != nullptr) {
+        fs_unmap(ast->mapped, ast->mappedSize);
+        return;
+    }
+
+    free(ast->kinds);
+    free(ast->offsets);
+    free(ast->data);
+    free(ast->extra);
+}
+
+// Copies the arrays of a tree loaded from the AST cache to the heap, before anything is appended to them.
+static void ownArrays(Ast *ast) {
+    uint8_t *kinds = (uint8_t *)malloc(sizeof(uint8_t) * ast->capacity);
+    uint32_t *offsets = (uint32_t *)malloc(sizeof(uint32_t) * ast->capacity);
+    NodeData *data = (NodeData *)malloc(sizeof(NodeData) * ast->capacity);
+    uint32_t *extra = (uint32_t *)malloc(sizeof(uint32_t) * ast->extraCapacity);
+    memcpy(kinds, ast->kinds, sizeof(uint8_t) * ast->count);
+    memcpy(offsets, ast->offsets, sizeof(uint32_t) * ast->count);
+    memcpy(data, ast->data, sizeof(NodeData) * ast->count);
+    memcpy(extra, ast->extra, sizeof(uint32_t) * ast->extraCount);
+
+    fs_unmap(ast->mapped, ast->mappedSize);
+    ast->mapped = nullptr;
+    ast->mappedSize = 0;
+    ast->kinds = kinds;
+    ast->offsets = offsets;
+    ast->data = data;
+    ast->extra = extra;
+}
+
+NodeIndex addAstNode(Ast *ast, const NodeKind kind, const uint32_t offset, const uint32_t a, const uint32_t b) {
+    if (ast->mapped != nullptr) {
+        ownArrays(ast);
+    }
+
+    if (ast->count == ast->capacity) {
+        ast->capacity *= 2;
+        ast->kinds = (uint8_t *)realloc(ast->kinds, sizeof(uint8_t) * ast->capacity);
+        ast->offsets = (uint32_t *)realloc(ast->offsets, sizeof(uint32_t) * ast->capacity);
+        ast->data = (NodeData *)realloc(ast->data, sizeof(NodeData) * ast->capacity);
+    }
+
+    ast->kinds[ast->count] = (uint8_t)kind;
+    ast->offsets[ast->count] = offset;
+    ast->data[ast->count].a = a;
+    ast->data[ast->count].b = b;
+
+    return (NodeIndex)ast->count++;
+}
+
+uint32_t addAstSymbol(Ast *ast, const Symbol symbol) {
+    if (ast->symbolCount == ast->symbolCapacity) {
+        ast->symbolCapacity *= 2;
+        ast->symbols = (Symbol *)realloc(ast->symbols, sizeof(Symbol) * ast->symbolCapacity);
+    }
+
+    ast->symbols[ast->symbolCount] = symbol;
+    return (uint32_t)ast->symbolCount++;
+}
+
+uint32_t addAstExtra(Ast *ast, const uint32_t *words, const int count) {
+    if (ast->mapped != nullptr) {
+        ownArrays(ast);
+    }
+
+    if (ast->extraCount + count > ast->extraCapacity) {
+        ast->extraCapacity = max(ast->extraCapacity * 2, ast->extraCount + count);
+        ast->extra = (uint32_t *)realloc(ast->extra, sizeof(uint32_t) * ast->extraCapacity);
+    }
+
+    const uint32_t index = (uint32_t)ast->extraCount;
+    memcpy(ast->extra + index, words, sizeof(uint32_t) * count);
+    ast->extraCount += count;
+
+    return index;
+}
+
+uint32_t addAstList(Ast *ast, const uint32_t *items, const int count) {
+    if (count == 0) {
+        return LIST_EMPTY;
+    }
+
+    const uint32_t length = (uint32_t)count;
+    const uint32_t index = addAstExtra(ast, &length, 1);
+    addAstExtra(ast, items, count);
+
+    return index;
+}
+
+size_t astBytes(const Ast *ast) {
+    return (sizeof(uint8_t) + sizeof(uint32_t) + sizeof(NodeData)) * ast->count + sizeof(uint32_t) * ast->extraCount +
+           sizeof(Symbol) * ast->symbolCount;
+}
+
+static const char *nodeKindNames[] = {
+    "Void",
+    "Function", "Prototype", "Arg", "Overloads", "Struct", "Impl", "Use", "LazyBody",
+    "NamedType", "PointerType", "SliceType", "ArrayType", "VariadicType", "OptionalType", "FunctionType",
+    "GenericType", "UnionType",
+    "Block", "Var", "Assign", "CompoundAssign", "Return", "If", "While", "Until", "For", "ForIn", "Break", "Continue",
+    "Defer", "Delete",
+    "Int", "Float", "String", "Char", "Bool", "Null", "Undefined", "Ident", "Scope", "Call", "InlineCall", "NamedArg",
+    "Index", "Member", "PointerMember", "ArrayLit", "StructLit", "New", "Ternary", "OrElse",
+    "Neg", "Not", "BitNot", "AddressOf", "Deref", "PreInc", "PreDec", "PostInc", "PostDec",
+    "Add", "Sub", "Mul", "Div", "Mod", "AddWrap", "SubWrap", "MulWrap", "AddSat", "SubSat", "MulSat", "ShlSat",
+    "Shl", "Shr", "BitAnd", "BitOr", "BitXor", "Eq", "NotEq", "Lt", "LtEq", "Gt", "GtEq", "And", "Or",
+    "NullCoalesce", "RangeOpen", "RangeClosed",
+};
+
+const char *nodeKindName(const NodeKind kind) {
+    if ((int)kind < 0 || kind >= NODE_KIND_COUNT) {
+        return "Unknown";
+    }
+
+    return nodeKindNames[kind];
+}
@@ -0,0 +1,289 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_AST_H
+#define NIFTY_AST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "intern.h"
+
+// A file's syntax tree as one pool of nodes, addressed by index. Every node has a kind, the source offset of its main
+// token and two 32 bit fields, a and b, whose meaning depends on the kind (see NodeKind). Anything that doesn't fit in
+// two fields, like lists of statements or arguments, lives in the extra array, which a or b index into.
+//
+// Nodes are added after their children, so index order is a post-order walk of the whole file: a pass that needs the
+// results of a node's children can run front to back over the arrays without recursing. The one exception is a body
+// skipped by lazy parsing, which is appended after everything else once it is parsed.
+
+typedef uint32_t NodeIndex;
+
+// Index 0 is a VoidNodeType node, used for missing children.
+#define NODE_NONE 0
+
+// A list in extra is its length followed by its items. Extra index 0 always holds the empty list.
+#define LIST_EMPTY 0
+
+// The builtin types, aliases like int are named types until types are resolved.
+typedef enum {
+    TYPE_U8,
+    TYPE_U16,
+    TYPE_U32,
+    TYPE_U64,
+    TYPE_U28,
+    TYPE_S8,
+    TYPE_S16,
+    TYPE_S32,
+    TYPE_S64,
+    TYPE_S28,
+    TYPE_F16,
+    TYPE_F32,
+    TYPE_F64,
+    TYPE_F128,
+    TYPE_B8,
+    TYPE_B16,
+    TYPE_B32,
+    TYPE_B64,
+
+    TYPE_STRING,
+    TYPE_CHAR,
+    TYPE_UINTPTR,
+    TYPE_TYPE_ID,
+    TYPE_ANY,
+    TYPE_VOID,
+
+    TYPE_NONE,
+} TypeKind;
+
+// Names index the file's own name table, see astSymbol. "list" is an extra index of a list.
+typedef enum {
+    VoidNodeType,
+
+    // Declarations.
+    FunctionNodeType,       // a: prototype, b: body block, NODE_NONE if the function has none.
+    PrototypeNodeType,      // a: name, b: extra [argument list, return type list, type parameter list, FunctionFlags].
+    ArgNodeType,            // a: name, b: extra [type, default value, ArgFlags]. Arguments sharing a type share it.
+    OverloadsNodeType,      // a: name, b: list of function names.
+    StructNodeType,         // a: name, b: extra [list of fields as ArgNodeType, type parameter list].
+    ImplNodeType,           // a: type name, b: list of methods.
+    UseNodeType,            // a: namespace path spelled with ::, b: extra [UseFlags, alias name]. Also in blocks.
+    LazyBodyNodeType,       // b: source offset past the '}'. A function body not parsed yet, see parseFunctionBody.
+
+    // Types.
+    NamedTypeNodeType,      // a: name, b: TypeKind of builtin types, TYPE_NONE for the rest.
+    PointerTypeNodeType,    // a: element type, b: 1 for [^]T, which points at many.
+    SliceTypeNodeType,      // a: element type.
+    ArrayTypeNodeType,      // a: element type, b: size expression.
+    VariadicTypeNodeType,   // a: element type.
+    OptionalTypeNodeType,   // a: element type. T?
+    FunctionTypeNodeType,   // a: list of argument types, b: list of return types.
+    GenericTypeNodeType,    // a: NamedTypeNodeType, b: list of type arguments. Array<T>
+    UnionTypeNodeType,      // a: list of member types. int | float
+
+    // Statements.
+    BlockNodeType,          // a: list of statements.
+    VarNodeType,            // a: extra [VarFlags, type, value list, name list].
+    AssignNodeType,         // a: target, b: value.
+    CompoundAssignNodeType, // a: target, b: extra [operator NodeKind, value]. x += 1
+    ReturnNodeType,         // a: list of values.
+    IfNodeType,             // a: condition, b: extra [init, then, else]. if (v := f(); v), else is a block or an if.
+    WhileNodeType,          // a: condition, b: body.
+    UntilNodeType,          // a: condition, b: body.
+    ForNodeType,            // a: extra [init, condition, step, body]. for (i := 0; i < n; ++i)
+    ForInNodeType,          // a: extra [name list, iterable, step, body], b: 1 to iterate in reverse. for <(val i in r; 2)
+    BreakNodeType,
+    ContinueNodeType,
+    DeferNodeType,          // a: statement.
+    DeleteNodeType,         // a: expression.
+
+    // Expressions.
+    IntNodeType,            // a: value, or extra [four words of the value, low to high] if b isn't INT_SMALL.
+    FloatNodeType,          // a: extra [two words of the double, low first], b: 32 or 64 for the .f and .d suffixes.
+    StringNodeType,         // a: name of the text between the quotes.
+    CharNodeType,           // a: code point.
+    BoolNodeType,           // a: 0 or 1.
+    NullNodeType,
+    UndefinedNodeType,
+    IdentNodeType,          // a: name. Built in functions like size_of are identifiers too.
+    ScopeNodeType,          // a: left, b: name. a::b
+    CallNodeType,           // a: callee, b: list of arguments.
+    InlineCallNodeType,     // a: callee, b: list of arguments. #[inline] f(x), inlined whatever the function costs.
+    NamedArgNodeType,       // a: name, b: value. f(start: 100)
+    IndexNodeType,          // a: base, b: index.
+    MemberNodeType,         // a: base, b: name.
+    PointerMemberNodeType,  // a: base, b: name. a->b
+    ArrayLitNodeType,       // a: list of elements.
+    StructLitNodeType,      // a: type, b: list of fields, NamedArgNodeType or plain values.
+    NewNodeType,            // a: expression or type.
+    TernaryNodeType,        // a: condition, b: extra [then, else].
+    OrElseNodeType,         // a: value, b: block giving the value when it is missing. f() else { "" }
+
+    // Unary, a: operand.
+    NegNodeType,
+    NotNodeType,
+    BitNotNodeType,
+    AddressOfNodeType,
+    DerefNodeType,
+    PreIncNodeType,
+    PreDecNodeType,
+    PostIncNodeType,
+    PostDecNodeType,
+
+    // Binary, a: left, b: right.
+    AddNodeType,
+    SubNodeType,
+    MulNodeType,
+    DivNodeType,
+    ModNodeType,
+    AddWrapNodeType,
+    SubWrapNodeType,
+    MulWrapNodeType,
+    AddSatNodeType,
+    SubSatNodeType,
+    MulSatNodeType,
+    ShlSatNodeType,
+    ShlNodeType,
+    ShrNodeType,
+    BitAndNodeType,
+    BitOrNodeType,
+    BitXorNodeType,
+    EqNodeType,
+    NotEqNodeType,
+    LtNodeType,
+    LtEqNodeType,
+    GtNodeType,
+    GtEqNodeType,
+    AndNodeType,
+    OrNodeType,
+    NullCoalesceNodeType,
+    RangeOpenNodeType,      // a ..< b
+    RangeClosedNodeType,    // a ..= b
+
+    NODE_KIND_COUNT
+} NodeKind;
+
+// How an IntNodeType holds its value, most fit in a.
+typedef enum {
+    INT_SMALL,    // Up to 32 bits.
+    INT_WIDE,     // Up to 128 bits.
+    INT_OVERFLOW, // Doesn't fit in 128 bits, the low 128 are kept.
+} IntForm;
+
+typedef enum {
+    VAR_LET,   // let, :=
+    VAR_VAL,   // val, ::=
+    VAR_CONST, // const
+} VarFlags;
+
+// Attributes written before a function that the compiler acts on. #[maybeInline] is the default, none.
+typedef enum {
+    FN_INLINE = 1 << 0,    // #[inline]
+    FN_NO_INLINE = 1 << 1, // #[noInline]
+    // #[in("a")], shifted left by the index of the argument named. Only the first FN_IN_ARGS arguments can be.
+    FN_IN = 1 << 8,
+} FunctionFlags;
+
+#define FN_IN_ARGS 24
+
+// What an argument says about the memory its pointer reaches.
+typedef enum {
+    ARG_RESTRICT = 1 << 0, // restrict a: ^int, nothing else the function reaches aliases it.
+    ARG_OUT = 1 << 1,      // #[out("a")], only written through. It can still alias another argument.
+} ArgFlags;
+
+typedef enum {
+    USE_PATH = 1 << 0,  // A quoted user namespace, found relative to the file. Others are from the nsl.
+    USE_USING = 1 << 1, // using, the namespace's items are in scope too.
+} UseFlags;
+
+typedef struct {
+    uint32_t offset; // Into the file's source, the line and column are looked up with lexerLocation.
+} Location;
+
+typedef struct {
+    uint32_t a;
+    uint32_t b;
+} NodeData;
+
+typedef struct {
+    uint8_t *kinds;
+    uint32_t *offsets;
+    NodeData *data;
+    int count;
+    int capacity;
+
+    uint32_t *extra;
+    int extraCount;
+    int extraCapacity;
+
+    uint32_t decls; // List of the file's top level declarations.
+
+    // Names used by the file, nodes hold indexes into it instead of Symbols so the arrays above don't depend on the
+    // interner of the run that built them. Index 0 is SYMBOL_NONE.
+    Symbol *symbols;
+    int symbolCount;
+    int symbolCapacity;
+
+    // Set when the node and extra arrays point into a mapped AST cache file instead of owning their memory.
+    void *mapped;
+    size_t mappedSize;
+} Ast;
+
+void initAst(Ast *ast, int nodeCapacity);
+void freeAst(Ast *ast);
+
+NodeIndex addAstNode(Ast *ast, NodeKind kind, uint32_t offset, uint32_t a, uint32_t b);
+// Appends count words to extra and returns the index of the first.
+uint32_t addAstExtra(Ast *ast, const uint32_t *words, int count);
+// Appends a list, returns its extra index.
+uint32_t addAstList(Ast *ast, const uint32_t *items, int count);
+
+// Adds a name to the file's table, returns its index. The parser keeps each Symbol to one index.
+uint32_t addAstSymbol(Ast *ast, Symbol symbol);
+
+// Items of the list at index, only valid until extra grows.
+static inline const uint32_t *astList(const Ast *ast, const uint32_t index, int *count) {
+    *count = (int)ast->extra[index];
+    return ast->extra + index + 1;
+}
+
+static inline Symbol astSymbol(const Ast *ast, const uint32_t name) {
+    return ast->symbols[name];
+}
+
+static inline NodeKind astKind(const Ast *ast, const NodeIndex node) {
+    return (NodeKind)ast->kinds[node];
+}
+
+// CallNodeType or InlineCallNodeType, which are the same but for the attribute.
+static inline bool isCallNode(const Ast *ast, const NodeIndex node) {
+    return astKind(ast, node) == CallNodeType || astKind(ast, node) == InlineCallNodeType;
+}
+
+// Memory held by the node and extra arrays, counting what is in use.
+size_t astBytes(const Ast *ast);
+
+const char *nodeKindName(NodeKind kind);
+
+#endif //NIFTY_AST_H
@@ -0,0 +1,262 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "astcache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef N_WIN
+#   include <unistd.h>
+#else
+#   include <process.h>
+#endif
+
+#include "intern.h"
+#include "util/fs.h"
+#include "util/hash.h"
+#include "util/str.h"
+
+// Bumped whenever the layout below or the meaning of any node changes.
+#define AST_CACHE_FORMAT 9
+
+static const char AST_CACHE_MAGIC[8] = {'N', 'I', 'F', 'T', 'Y', 'A', 'S', 'T'};
+
+// The file is this header followed by, in order:
+//     offsets       nodeCount u32
+//     data          nodeCount NodeData
+//     extra         extraCount u32
+//     name starts   symbolCount + 1 u32, into the names
+//     names         nameBytes, without terminators
+//     kinds         nodeCount u8
+// Everything before the names is a multiple of four bytes, so the u32 arrays are aligned where the mapping starts.
+typedef struct {
+    char magic[8];
+    uint32_t format;
+    uint32_t headerSize;
+    uint64_t compiler; // compilerKey(), files of other builds of the compiler or other modes are ignored.
+    uint64_t sourceHash;
+    uint64_t sourceLength;
+    uint32_t nodeCount;
+    uint32_t extraCount;
+    uint32_t symbolCount;
+    uint32_t nameBytes;
+    uint32_t decls;
+    uint32_t namespaceName; // Index in the names, 0 without a namespace declaration.
+} AstCacheHeader;
+
+// Trees with skipped bodies are kept apart from complete ones.
+static uint64_t compilerKey(const CompilerConfig *config) {
+    static const char version[] = NIFTY_VERSION " " NIFTY_DATE;
+    return hash_bytes(version, sizeof(version) - 1) ^ AST_CACHE_FORMAT ^ (config->lazyBodies ? 1ull << 63 : 0);
+}
+
+static char *cachePath(const char *dir, const uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ast", (unsigned long long)key);
+    return fs_join(dir, name);
+}
+
+static size_t cacheSize(const AstCacheHeader *header) {
+    return sizeof(AstCacheHeader) + (sizeof(uint32_t) + sizeof(NodeData)) * header->nodeCount +
+           sizeof(uint32_t) * (header->extraCount + header->symbolCount + 1) + header->nameBytes + header->nodeCount;
+}
+
+// Results pointing into the mapping at data, nullptr if it doesn't hold the tree of this exact source.
+static ParseResults *loadCache(const char *file, const char *data, const size_t size, const uint64_t sourceHash,
+                               const size_t sourceLength, CompilerConfig *config) {
+    AstCacheHeader header;
+    if (size < sizeof(header)) {
+        return nullptr;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, AST_CACHE_MAGIC, sizeof(AST_CACHE_MAGIC)) != 0 || header.format != AST_CACHE_FORMAT ||
+        header.headerSize != sizeof(header) || header.compiler != compilerKey(config) || header.sourceHash != sourceHash ||
+        header.sourceLength != sourceLength || header.symbolCount == 0 || header.nodeCount == 0 ||
+        cacheSize(&header) != size) {
+        return nullptr;
+    }
+
+    ParseResults *results = (ParseResults *)malloc(sizeof(ParseResults));
+    if (results == nullptr) {
+        return nullptr;
+    }
+
+    arena_init(&results->arena, 0);
+    results->file = arena_str(&results->arena, file, str_len(file));
+    results->errorCount = 0;
+    results->runTime = 0;
+    results->lexer = nullptr;
+    initDiagnostics(&results->diagnostics);
+
+    Ast *ast = &results->ast;
+    const char *at = data + sizeof(header);
+    ast->offsets = (uint32_t *)at;
+    at += sizeof(uint32_t) * header.nodeCount;
+    ast->data = (NodeData *)at;
+    at += sizeof(NodeData) * header.nodeCount;
+    ast->extra = (uint32_t *)at;
+    at += sizeof(uint32_t) * header.extraCount;
+    const uint32_t *nameStarts = (const uint32_t *)at;
+    at += sizeof(uint32_t) * (header.symbolCount + 1);
+    const char *names = at;
+    at += header.nameBytes;
+    ast->kinds = (uint8_t *)at;
+
+    // The arrays are read only, capacity equal to count keeps anything from appending to them in place.
+    ast->count = ast->capacity = (int)header.nodeCount;
+    ast->extraCount = ast->extraCapacity = (int)header.extraCount;
+    ast->decls = header.decls;
+    ast->mapped = (void *)data;
+    ast->mappedSize = size;
+
+    ast->symbolCount = ast->symbolCapacity = (int)header.symbolCount;
+    ast->symbols = (Symbol *)malloc(sizeof(Symbol) * header.symbolCount);
+    ast->symbols[0] = SYMBOL_NONE;
+    for (uint32_t i = 1; i < header.symbolCount; ++i) {
+        ast->symbols[i] = intern(config->interner, names + nameStarts[i], (int)(nameStarts[i + 1] - nameStarts[i]));
+    }
+
+    results->namespace = header.namespaceName < header.symbolCount ? ast->symbols[header.namespaceName] : SYMBOL_NONE;
+
+    return results;
+}
+
+static bool writeSection(FILE *out, const void *data, const size_t size) {
+    return size == 0 || fwrite(data, 1, size, out) == size;
+}
+
+// Written to a temporary file first and renamed, so other builds never map a partial file.
+static void writeCache(const char *dir, const uint64_t key, const ParseResults *results, const uint64_t sourceHash,
+                       const size_t sourceLength, const CompilerConfig *config) {
+    const Ast *ast = &results->ast;
+
+    uint32_t *nameStarts = (uint32_t *)malloc(sizeof(uint32_t) * (ast->symbolCount + 1));
+    nameStarts[0] = 0;
+    nameStarts[1] = 0;
+    uint32_t namespaceName = 0;
+    for (int i = 1; i < ast->symbolCount; ++i) {
+        int len = 0;
+        symbolName(config->interner, ast->symbols[i], &len);
+        nameStarts[i + 1] = nameStarts[i] + (uint32_t)len;
+        if (ast->symbols[i] == results->namespace) {
+            namespaceName = (uint32_t)i;
+        }
+    }
+
+    AstCacheHeader header;
+    memcpy(header.magic, AST_CACHE_MAGIC, sizeof(AST_CACHE_MAGIC));
+    header.format = AST_CACHE_FORMAT;
+    header.headerSize = sizeof(header);
+    header.compiler = compilerKey(config);
+    header.sourceHash = sourceHash;
+    header.sourceLength = sourceLength;
+    header.nodeCount = (uint32_t)ast->count;
+    header.extraCount = (uint32_t)ast->extraCount;
+    header.symbolCount = (uint32_t)ast->symbolCount;
+    header.nameBytes = nameStarts[ast->symbolCount];
+    header.decls = ast->decls;
+    header.namespaceName = namespaceName;
+
+    char *path = cachePath(dir, key);
+    char *temp = str_new_empty(str_len(path) + 48);
+#ifndef N_WIN
+    sprintf(temp, "%s.%ld.%p.tmp", path, (long)getpid(), (const void *)results);
+#else
+    sprintf(temp, "%s.%d.%p.tmp", path, _getpid(), (const void *)results);
+#endif
+
+    FILE *out = fopen(temp, "wb");
+    bool written = out != nullptr;
+    if (written) {
+        written = writeSection(out, &header, sizeof(header)) &&
+                  writeSection(out, ast->offsets, sizeof(uint32_t) * ast->count) &&
+                  writeSection(out, ast->data, sizeof(NodeData) * ast->count) &&
+                  writeSection(out, ast->extra, sizeof(uint32_t) * ast->extraCount) &&
+                  writeSection(out, nameStarts, sizeof(uint32_t) * (ast->symbolCount + 1));
+        for (int i = 1; written && i < ast->symbolCount; ++i) {
+            int len = 0;
+            const char *name = symbolName(config->interner, ast->symbols[i], &len);
+            written = writeSection(out, name, (size_t)len);
+        }
+        written = written && writeSection(out, ast->kinds, ast->count);
+        written = fclose(out) == 0 && written;
+    }
+
+#ifdef N_WIN
+    // rename doesn't replace existing files on Windows.
+    written = written && MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    written = written && rename(temp, path) == 0;
+#endif
+    if (!written) {
+        remove(temp);
+    }
+
+    str_delete(temp);
+    str_delete(path);
+    free(nameStarts);
+}
+
+ParseResults *parseFileCached(const char *file, CompilerConfig *config, bool *cached) {
+    if (cached != nullptr) {
+        *cached = false;
+    }
+
+    if (config == nullptr || config->cacheDir == nullptr || config->interner == nullptr) {
+        return parseFile(file, config);
+    }
+
+    Lexer *lexer = initLexer(file);
+    if (lexer == nullptr) {
+        return nullptr;
+    }
+
+    const uint64_t sourceHash = hash_bytes(lexer->source, lexer->length);
+    const uint64_t key = sourceHash ^ compilerKey(config) * 0x9E3779B97F4A7C15ull;
+    const size_t sourceLength = lexer->length;
+
+    char *path = cachePath(config->cacheDir, key);
+    size_t size = 0;
+    const char *data = (const char *)fs_map(path, &size);
+    str_delete(path);
+    if (data != nullptr) {
+        ParseResults *results = loadCache(file, data, size, sourceHash, sourceLength, config);
+        if (results != nullptr) {
+            freeLexer(lexer);
+            if (cached != nullptr) {
+                *cached = true;
+            }
+            return results;
+        }
+        fs_unmap(data, size);
+    }
+
+    ParseResults *results = parseFileWithLexer(file, lexer, config);
+    if (results != nullptr && results->diagnostics.count == 0 && fs_make_dirs(config->cacheDir)) {
+        writeCache(config->cacheDir, key, results, sourceHash, sourceLength, config);
+    }
+
+    return results;
+}
@@ -0,0 +1,37 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_ASTCACHE_H
+#define NIFTY_ASTCACHE_H
+
+#include "parser.h"
+
+// Parsed files are kept in config->cacheDir, one file per source, named by a hash of the source bytes and the compiler
+// that wrote it. A later build of an unchanged file maps the cache file and points its Ast straight into it: the node
+// and extra arrays are stored exactly as they are in memory, only the names are interned again, since Symbols differ
+// from run to run. Files with errors or warnings are never cached, their diagnostics come from parsing.
+
+// Same as parseFile, but reuses the cached tree when there is one and writes it when there isn't. cached is set to
+// whether the tree came from the cache, it may be nullptr. Without config->cacheDir or an interner this is parseFile.
+ParseResults *parseFileCached(const char *file, CompilerConfig *config, bool *cached);
+
+#endif //NIFTY_ASTCACHE_H
@@ -0,0 +1,1744 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "astcache.h"
+#include "check.h"
+#include "edit.h"
+#include "intern.h"
+#include "lexer.h"
+#include "parser.h"
+#include "program.h"
+#include "symtab.h"
+#include "types.h"
+#include "util/fs.h"
+#include "util/hash.h"
+#include "util/str.h"
+#include "util/thread.h"
+#include "util/timer.h"
+
+#include <sys/stat.h>
+#ifndef N_WIN
+#   include <fcntl.h>
+#   include <sys/wait.h>
+#   include <unistd.h>
+#   define BENCH_MKDIR(dir) mkdir(dir, 0755)
+#else
+#   include <direct.h>
+#   define BENCH_MKDIR(dir) _mkdir(dir)
+#endif
+
+#define BENCH_MIN_ITERATIONS 3
+#define BENCH_MIN_TIME_MS 1000.0
+
+// The hand written identType switch the lexer used before the keyword table was generated. Kept as the baseline for
+// 'nifty bench keywords'.
+
+static NiftyTokenType checkKeyword(const Lexer *lexer, const int start, const int len, const char *rest,
+                                   const NiftyTokenType type) {
+    if (lexer->current - lexer->start == start + len && str_eq_len(lexer->start + start, rest, len)) {
+        return type;
+    }
+
+    return TK_IDENT;
+}
+
+static NiftyTokenType checkKeyword2(const Lexer *lexer, const int start, const int len, const char *rest,
+                                    const NiftyTokenType type, const int len2, const char *rest2,
+                                    const NiftyTokenType type2) {
+    const NiftyTokenType tokenType = checkKeyword(lexer, start, len, rest, type);
+    if (tokenType == TK_IDENT) {
+        return checkKeyword(lexer, start, len2, rest2, type2);
+    }
+
+    return tokenType;
+}
+
+static NiftyTokenType checkUInts(const Lexer *lexer) {
+    if (str_eq_len(lexer->start + 1, "32", 2)) {
+        return TK_U32;
+    }
+    if (str_eq_len(lexer->start + 1, "8", 1)) {
+        return TK_U8;
+    }
+    if (str_eq_len(lexer->start + 1, "int", 3)) {
+        return TK_UINT;
+    }
+    if (str_eq_len(lexer->start + 1, "64", 2)) {
+        return TK_U64;
+    }
+    if (str_eq_len(lexer->start + 1, "16", 2)) {
+        return TK_U16;
+    }
+    if (str_eq_len(lexer->start + 1, "intptr", 6)) {
+        return TK_UINTPTR;
+    }
+    if (str_eq_len(lexer->start + 1, "128", 3)) {
+        return TK_U128;
+    }
+
+    return TK_IDENT;
+}
+
+static NiftyTokenType checkSInts(const Lexer *lexer) {
+    if (str_eq_len(lexer->start + 1, "32", 2)) {
+        return TK_S32;
+    }
+    if (str_eq_len(lexer->start + 1, "64", 2)) {
+        return TK_S64;
+    }
+    if (str_eq_len(lexer->start + 1, "8", 1)) {
+        return TK_S8;
+    }
+    if (str_eq_len(lexer->start + 1, "16", 2)) {
+        return TK_S16;
+    }
+    if (str_eq_len(lexer->start + 1, "128", 3)) {
+        return TK_S128;
+    }
+
+    return TK_IDENT;
+}
+
+static NiftyTokenType checkBoolTypes(const Lexer *lexer) {
+    if (str_eq_len(lexer->start + 1, "ool", 3)) {
+        return TK_BOOL;
+    }
+    if (str_eq_len(lexer->start + 1, "8", 1)) {
+        return TK_B8;
+    }
+    if (str_eq_len(lexer->start + 1, "16", 2)) {
+        return TK_B16;
+    }
+    if (str_eq_len(lexer->start + 1, "32", 2)) {
+        return TK_B32;
+    }
+    if (str_eq_len(lexer->start + 1, "64", 2)) {
+        return TK_B64;
+    }
+
+    return TK_IDENT;
+}
+
+static NiftyTokenType checkFloatTypes(const Lexer *lexer) {
+    if (str_eq_len(lexer->start + 1, "32", 2)) {
+        return TK_F32;
+    }
+    if (str_eq_len(lexer->start + 1, "oat", 3)) {
+        return TK_FLOAT;
+    }
+    if (str_eq_len(lexer->start + 1, "64", 2)) {
+        return TK_F64;
+    }
+    if (str_eq_len(lexer->start + 1, "16", 2)) {
+        return TK_F16;
+    }
+    if (str_eq_len(lexer->start + 1, "128", 3)) {
+        return TK_F128;
+    }
+
+    return TK_IDENT;
+}
+
+// The cases that fall through into the next letter are the old switch's, kept so the timings compare the same code.
+static NiftyTokenType switchIdentType(const Lexer *lexer) {
+    switch (lexer->start[0]) {
+        case '_': return checkKeyword(lexer, 1, 8, "_anytype", TK_ANY_TYPE); // __anytype
+        case 'a':
+            // align_of
+            // api
+            // as
+            // assert
+            // assert_db
+            // auto_cast
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'l': return checkKeyword(lexer, 2, 6, "ign_of", TK_ALIGN_OF);
+                    case 'p': return checkKeyword(lexer, 2, 1, "i", TK_API);
+                    case 's':
+                        if (lexer->start[2] == 's') {
+                            return checkKeyword2(lexer, 2, 4, "sert", TK_ASSERT, 7, "sert_db", TK_ASSERT_DB);
+                        } else {
+                            return checkKeyword(lexer, 2, 0, "", TK_AS);
+                        }
+                    case 'u': return checkKeyword(lexer, 2, 7, "to_cast", TK_AUTO_CAST);
+                    default: break;
+                }
+            }
+            // fallthrough
+        case 'b': {
+            // behavior
+            // break
+            // bool b8 b16 b32 b64
+            const NiftyTokenType type = checkKeyword2(lexer, 1, 4, "reak", TK_BREAK, 7, "ehavior", TK_BEHAVIOR);
+            if (type != TK_IDENT) {
+                return type;
+            }
+            return checkBoolTypes(lexer);
+        }
+        case 'c':
+            // cast
+            // char
+            // const
+            // constimpl
+            // continue
+            // cstring
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'a': return checkKeyword(lexer, 2, 2, "st", TK_CAST);
+                    case 'h': return checkKeyword(lexer, 2, 2, "ar", TK_CHAR_TYPE);
+                    case 'o':
+                        if (lexer->start[2] == 'n' && lexer->start[3] == 's') {
+                            return checkKeyword2(lexer, 4, 1, "t", TK_CONST, 5, "timpl", TK_CONST_IMPL);
+                        } else {
+                            return checkKeyword(lexer, 3, 5, "ntinue", TK_CONTINUE);
+                        }
+                    case 's': return checkKeyword(lexer, 2, 5, "tring", TK_CSTRING_TYPE);
+                    default: break;
+                }
+            }
+            // fallthrough
+        case 'd':
+            // defer
+            // defer_err
+            // delete
+            // does
+            // double
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'e':
+                        if (lexer->start[2] == 'f') {
+                            return checkKeyword2(lexer, 3, 2, "er", TK_DEFER, 6, "er_err", TK_DEFER_ERR);
+                        } else {
+                            return checkKeyword(lexer, 2, 4, "lete", TK_DELETE);
+                        }
+                    case 'o': return checkKeyword2(lexer, 2, 2, "es", TK_DOES, 4, "uble", TK_DOUBLE);
+                    default: break;
+                }
+            }
+            // fallthrough
+        case 'e':
+            // else
+            // elif
+            // emit
+            // endimpl
+            // enum
+            // extern
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'l': return checkKeyword2(lexer, 2, 2, "se", TK_ELSE, 2, "if", TK_ELIF);
+                    case 'm': return checkKeyword(lexer, 2, 2, "it", TK_EMIT);
+                    case 'n': return checkKeyword2(lexer, 2, 2, "um", TK_ENUM, 3, "dimpl", TK_END_IMPL);
+                    case 'x': return checkKeyword(lexer, 2, 4, "tern", TK_EXTERN);
+                    default: break;
+                }
+            }
+            // fallthrough
+        case 'f': {
+            // false
+            // float
+            // f16 f32 f64
+            // fn
+            // for
+            NiftyTokenType type = checkKeyword(lexer, 1, 1, "n", TK_FN);
+            if (type != TK_IDENT) {
+                return type;
+            }
+            type = checkFloatTypes(lexer);
+            if (type != TK_IDENT) {
+                return type;
+            }
+            return checkKeyword2(lexer, 1, 2, "or", TK_FOR, 4, "alse", TK_FALSE);
+        }
+        case 'g': return checkKeyword(lexer, 1, 3, "oto", TK_GOTO); // goto
+        case 'h': break;
+        case 'i':
+            // if
+            // impl
+            // in
+            // int
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'f': return checkKeyword(lexer, 2, 0, "", TK_IF);
+                    case 'm': return checkKeyword(lexer, 2, 2, "pl", TK_IMPL);
+                    case 'n': return checkKeyword2(lexer, 2, 0, "", TK_IN, 1, "t", TK_INT);
+                    default: break;
+                }
+            }
+        case 'j':
+        case 'k': break;
+        case 'l': return checkKeyword(lexer, 1, 2, "et", TK_LET); // let
+        case 'm': return checkKeyword(lexer, 1, 1, "d", TK_MD); // md
+        case 'n':
+            // name_of
+            // namespace
+            // new
+            // null
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'a': return checkKeyword2(lexer, 2, 5, "me_of", TK_NAME_OF, 7, "mespace", TK_NAMESPACE);
+                    case 'e': return checkKeyword(lexer, 2, 1, "w", TK_NEW);
+                    case 'u': return checkKeyword(lexer, 2, 2, "ll", TK_NULL);
+                    default: break;
+                }
+            }
+        case 'o': break;
+        case 'p': return checkKeyword(lexer, 1, 6, "ackage", TK_PACKAGE); // package
+        case 'q': break;
+        case 'r':
+            // rawptr
+            // recast
+            // restrict
+            // return
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'a': return checkKeyword(lexer, 2, 3, "ptr", TK_RAWPTR);
+                    case 'e':
+                        switch (lexer->start[2]) {
+                            case 'c': return checkKeyword(lexer, 3, 3, "ast", TK_RECAST);
+                            case 's': return checkKeyword(lexer, 3, 6, "strict", TK_RESTRICT);
+                            case 't': return checkKeyword(lexer, 3, 3, "urn", TK_RETURN);
+                            default: break;
+                        }
+                        // fallthrough
+                    default: break;
+                }
+            }
+            // fallthrough
+        case 's': {
+            // size_of
+            // skip
+            // string
+            // struct
+            // s8 s16 s32 s64 s128
+            const NiftyTokenType type = checkSInts(lexer);
+            if (type != TK_IDENT) {
+                return type;
+            }
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'i': return checkKeyword(lexer, 2, 5, "ze_of", TK_SIZE_OF);
+                    case 'k': return checkKeyword(lexer, 2, 2, "ip", TK_SKIP);
+                    case 't': return checkKeyword2(lexer, 2, 4, "ring", TK_STRING_TYPE, 4, "ruct", TK_STRUCT);
+                    default: break;
+                }
+            }
+        }
+            // fallthrough
+        case 't':
+            // test
+            // true
+            // try
+            // type
+            // type_of
+            // type_from
+            // typeid_of
+            // typeinfo_of
+            // typeid
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'e': return checkKeyword(lexer, 2, 2, "st", TK_TEST);
+                    case 'r': return checkKeyword2(lexer, 2, 1, "y", TK_TRY, 2, "ue", TK_TRUE);
+                    case 'y': {
+                        NiftyTokenType type = checkKeyword(lexer, 2, 5, "pedef", TK_TYPEDEF);
+                        if (type != TK_IDENT) {
+                            return type;
+                        }
+                        type = checkKeyword2(lexer, 2, 5, "pe_of", TK_TYPE_OF, 7, "pe_from", TK_TYPE_FROM);
+                        if (type != TK_IDENT) {
+                            return type;
+                        }
+                        type = checkKeyword2(lexer, 2, 7, "peid_of", TK_TYPEID_OF, 9, "peinfo_of", TK_TYPEINFO_OF);
+                        if (type != TK_IDENT) {
+                            return type;
+                        }
+                        return checkKeyword(lexer, 2, 4, "peid", TK_TYPEID);
+                    }
+                    default: break;
+                }
+            }
+            // fallthrough
+        case 'u': {
+            // until
+            // use
+            // using
+            // u8 u16 u32 u64 u128
+            // uint
+            // uintptr
+            // unused
+            // undefined
+            NiftyTokenType type = checkKeyword2(lexer, 1, 2, "se", TK_USE, 4, "sing", TK_USING);
+            if (type != TK_IDENT) {
+                return type;
+            }
+            type = checkKeyword(lexer, 1, 4, "ntil", TK_UNTIL);
+            if (type != TK_IDENT) {
+                return type;
+            }
+            type = checkUInts(lexer);
+            if (type != TK_IDENT) {
+                return type;
+            }
+            return checkKeyword2(lexer, 1, 8, "ndefined", TK_UNDEFINED, 5, "nused", TK_UNUSED);
+        }
+        case 'v':
+            // val
+            // void
+            if (lexer->current - lexer->start > 1) {
+                switch (lexer->start[1]) {
+                    case 'a': return checkKeyword(lexer, 2, 1, "l", TK_VAL);
+                    case 'o': return checkKeyword(lexer, 2, 2, "id", TK_VOID);
+                    default: break;
+                }
+            }
+            // fallthrough
+        case 'w': return checkKeyword2(lexer, 1, 4, "hile", TK_WHILE, 2, "en", TK_WHEN); // when, while
+        case 'x':
+        case 'y':
+        case 'z':
+        default: break;
+    }
+
+    return TK_IDENT;
+}
+
+static const char *sourceLoadModeName(const SourceLoadMode mode) {
+    switch (mode) {
+        case SOURCE_LOAD_AUTO: return "mmap";
+        case SOURCE_LOAD_COPY: return "copy";
+        default: return "unknown";
+    }
+}
+
+static void benchLexMode(const char *file, const SourceLoadMode mode) {
+    size_t bytes = 0;
+    int tokens = 0;
+    int iterations = 0;
+    const uint64_t start = timer_now_ns();
+
+    while (iterations < BENCH_MIN_ITERATIONS || timer_elapsed_ms(start) < BENCH_MIN_TIME_MS) {
+        Lexer *lexer = initLexerWithMode(file, mode);
+        if (lexer == nullptr) {
+            return;
+        }
+
+        for (Token token = nextToken(lexer); token.type != TK_EOF; token = nextToken(lexer)) {
+            ++tokens;
+        }
+
+        bytes += lexer->length;
+        freeLexer(lexer);
+        ++iterations;
+    }
+
+    const double ms = timer_elapsed_ms(start);
+    println("%s: %8.1f MB/s, %d tokens per pass, peak RSS %ld KB", sourceLoadModeName(mode),
+            (double)bytes / (1024.0 * 1024.0) / (ms / 1000.0), tokens / iterations, timer_peak_rss_kb());
+}
+
+// Each mode runs in its own process so the peak RSS of one doesn't hide the other.
+static void benchLex(const char *file) {
+    if (str_empty(file)) {
+        println("Usage: nifty bench lex <file>");
+        return;
+    }
+
+    const SourceLoadMode modes[] = {SOURCE_LOAD_AUTO, SOURCE_LOAD_COPY};
+    for (int i = 0; i < 2; ++i) {
+#ifndef N_WIN
+        fflush(stdout);
+        const pid_t pid = fork();
+        if (pid == 0) {
+            benchLexMode(file, modes[i]);
+            fflush(stdout);
+            _exit(0);
+        }
+
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+            continue;
+        }
+#endif
+        benchLexMode(file, modes[i]);
+    }
+}
+
+typedef struct {
+    const char *start;
+    int len;
+} Span;
+
+// Classifies every identifier and keyword in file with the old switch and with the perfect hash.
+static void benchKeywords(const char *file) {
+    if (str_empty(file)) {
+        println("Usage: nifty bench keywords <file>");
+        return;
+    }
+
+    Lexer *lexer = initLexer(file);
+    if (lexer == nullptr) {
+        return;
+    }
+
+    int count = 0;
+    int capacity = 1024;
+    Span *spans = (Span *)malloc(sizeof(Span) * capacity);
+    for (Token token = nextToken(lexer); token.type != TK_EOF; token = nextToken(lexer)) {
+        if (token.type == TK_INTERNAL_ERROR || !isAlpha(token.lexeme[0])) {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity *= 2;
+            spans = (Span *)realloc(spans, sizeof(Span) * capacity);
+        }
+        spans[count].start = token.lexeme;
+        spans[count].len = token.len;
+        ++count;
+    }
+
+    if (count == 0) {
+        println("No identifiers in '%s'.", file);
+        free(spans);
+        freeLexer(lexer);
+        return;
+    }
+
+    Lexer probe = *lexer;
+    int mismatches = 0;
+    for (int i = 0; i < count; ++i) {
+        probe.start = spans[i].start;
+        probe.current = spans[i].start + spans[i].len;
+        if (switchIdentType(&probe) != keywordType(spans[i].start, spans[i].len)) {
+            ++mismatches;
+        }
+    }
+
+    long checksum = 0;
+    int passes = 0;
+    uint64_t start = timer_now_ns();
+    while (passes < BENCH_MIN_ITERATIONS || timer_elapsed_ms(start) < BENCH_MIN_TIME_MS) {
+        for (int i = 0; i < count; ++i) {
+            probe.start = spans[i].start;
+            probe.current = spans[i].start + spans[i].len;
+            checksum += switchIdentType(&probe);
+        }
+        ++passes;
+    }
+    const double switchNs = timer_elapsed_ms(start) * 1e6 / ((double)count * passes);
+
+    passes = 0;
+    start = timer_now_ns();
+    while (passes < BENCH_MIN_ITERATIONS || timer_elapsed_ms(start) < BENCH_MIN_TIME_MS) {
+        for (int i = 0; i < count; ++i) {
+            checksum += keywordType(spans[i].start, spans[i].len);
+        }
+        ++passes;
+    }
+    const double hashNs = timer_elapsed_ms(start) * 1e6 / ((double)count * passes);
+
+    println("%d identifiers and keywords (checksum %ld)", count, checksum);
+    println("switch: %6.2f ns per identifier", switchNs);
+    println("hash  : %6.2f ns per identifier", hashNs);
+    if (mismatches > 0) {
+        println("%d identifiers classified differently, the switch matches some keywords by prefix only.", mismatches);
+    }
+
+    free(spans);
+    freeLexer(lexer);
+}
+
+// Generated code with the things that make chunk boundaries hard: nested block comments and multi-line strings.
+static char *syntheticSource(const size_t size, size_t *length) {
+    static const char *pieces[] = {
+        "fn table%d(x: int, y: f64): int {\n    val name ::= \"entry %d\\\"quoted\\\"\"\n"
+        "    return x * 0x%X + 1_000 // row %d\n}\n",
+        "/- generated block %d\n /* nested %d\n    fn notCode() { \"not a string }\n */\n still comment -/\n",
+        "data%d ::= [1, 2, 3, 4.5e+%d, 0q17, %d, \"multi\nline %d\nstring\"]\n",
+        "md get%d(idx: int): ^u8 {\n    if idx >= %d && idx %%+ 2 != 0 { return null }\n    return _data[idx]\n}\n",
+    };
+
+    char *source = (char *)malloc(size + 256);
+    size_t at = 0;
+    for (int i = 0; at < size; ++i) {
+        at += sprintf(source + at, pieces[i % 4], i, i, i, i);
+    }
+
+    *length = at;
+    return source;
+}
+
+static bool sameTokens(const TokenStream *a, const TokenStream *b) {
+    if (a->count != b->count || a->errorCount != b->errorCount) {
+        return false;
+    }
+
+    for (int i = 0; i < a->count; ++i) {
+        if (a->kinds[i] != b->kinds[i] || a->offsets[i] != b->offsets[i] || a->lengths[i] != b->lengths[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Thread counts double up to the most, which is run last even if it isn't a power of 2.
+static int nextThreads(const int threads, const int maxThreads) {
+    return threads * 2 > maxThreads && threads != maxThreads ? maxThreads : threads * 2;
+}
+
+static void benchLexParallel(const char *sizeArg, const char *threadsArg) {
+    const int megabytes = sizeArg != nullptr ? atoi(sizeArg) : 100;
+    if (megabytes <= 0) {
+        println("Usage: nifty bench lex-parallel <megabytes> <max threads>");
+        return;
+    }
+
+    size_t length;
+    char *source = syntheticSource((size_t)megabytes * 1024 * 1024, &length);
+    Lexer *lexer = initLexerFromMemory(source, length);
+    free(source);
+    if (lexer == nullptr) {
+        return;
+    }
+
+    uint64_t start = timer_now_ns();
+    TokenStream *expected = tokenizeFile(lexer);
+    double baseMs = timer_elapsed_ms(start);
+    println("%.1f MB, %d tokens", (double)length / (1024.0 * 1024.0), expected->count);
+    println("threads  %12s  speedup", "tokens/s");
+
+    const int maxThreads = threadsArg != nullptr ? max(atoi(threadsArg), 1) : thread_hardware_concurrency();
+    for (int threads = 1; threads <= maxThreads; threads = nextThreads(threads, maxThreads)) {
+        ThreadPool *pool = threads > 1 ? pool_new(threads) : nullptr;
+
+        double best = 0.0;
+        bool matches = true;
+        for (int i = 0; i < BENCH_MIN_ITERATIONS; ++i) {
+            lexer->current = lexer->source;
+            start = timer_now_ns();
+            TokenStream *tokens = tokenizeFileParallel(lexer, pool);
+            const double ms = timer_elapsed_ms(start);
+            best = i == 0 || ms < best ? ms : best;
+            matches = matches && sameTokens(tokens, expected);
+            freeTokenStream(tokens);
+        }
+
+        if (threads == 1) {
+            baseMs = best;
+        }
+
+        println("%7d  %12.0f  %6.2fx%s", threads, expected->count / (best / 1000.0), baseMs / best,
+                matches ? "" : "  (token stream differs from sequential lexing!)");
+        pool_free(pool);
+    }
+
+    freeTokenStream(expected);
+    freeLexer(lexer);
+}
+
+static uint32_t nextRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// An edit like one made while typing: a few characters inserted where a token near the cursor starts or a word
+// deleted. Structural edits go anywhere and also open and close comments and strings.
+static SourceEdit randomEdit(const EditBuffer *buffer, uint32_t *state, uint32_t *cursor, const bool structural) {
+    static const char *typed[] = { "x", "a1", " ", "\n", "0", "_", "(", ")", "+ ", "1.", "fn ", "return " };
+    static const char *structure[] = { "\"", "'", "/-", "-/", "/*", "*/", "//", "\\", "\r\n", "1e", "0x", "..<" };
+
+    SourceEdit edit;
+    edit.offset = nextRandom(state) % (uint32_t)(buffer->length + 1);
+    edit.deleted = 0;
+    edit.text = "";
+    edit.length = 0;
+
+    if (structural) {
+        if (nextRandom(state) % 3 == 0) {
+            edit.deleted = min(nextRandom(state) % 4 + 1, (uint32_t)buffer->length - edit.offset);
+        } else {
+            edit.text = nextRandom(state) % 2 == 0 ? structure[nextRandom(state) % 12] : typed[nextRandom(state) % 12];
+            edit.length = (uint32_t)str_len(edit.text);
+        }
+        return edit;
+    }
+
+    // Looked up through the tokens rather than the text so picking an edit doesn't move the gap.
+    *cursor = min(*cursor + nextRandom(state) % 129, (uint32_t)buffer->length + 64) - 64;
+    edit.offset = *cursor;
+    int lo = 0;
+    int hi = editBufferTokenCount(buffer) - 1;
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        if (editBufferToken(buffer, mid).offset < edit.offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    const Token token = editBufferToken(buffer, lo);
+    edit.offset = token.offset;
+    if (token.type == TK_IDENT && nextRandom(state) % 3 == 0) {
+        edit.deleted = (uint32_t)token.len;
+    } else {
+        edit.text = typed[nextRandom(state) % 12];
+        edit.length = (uint32_t)str_len(edit.text);
+    }
+
+    return edit;
+}
+
+// Compares the buffer's tokens with lexing all of its text again.
+static bool relexMatches(EditBuffer *buffer) {
+    Lexer *lexer = initLexerFromMemory(editBufferText(buffer), buffer->length);
+    TokenStream *expected = tokenizeFile(lexer);
+
+    bool matches = editBufferTokenCount(buffer) == expected->count;
+    for (int i = 0; matches && i < expected->count; ++i) {
+        const Token token = editBufferToken(buffer, i);
+        matches = token.type == expected->kinds[i] && token.offset == expected->offsets[i];
+        if (matches && token.type == TK_INTERNAL_ERROR) {
+            matches = token.lexeme == tokenErrorMessage(expected, i);
+        } else if (matches) {
+            matches = (uint32_t)token.len == expected->lengths[i];
+        }
+    }
+
+    freeTokenStream(expected);
+    freeLexer(lexer);
+    return matches;
+}
+
+// The edit that takes edit back, with the text it deletes copied into removed. The text is read around the gap so
+// nothing moves before the edits are timed.
+static SourceEdit undoOf(const EditBuffer *buffer, const SourceEdit edit, StrBuffer *removed) {
+    removed->len = 0;
+    for (size_t i = edit.offset; i < (size_t)edit.offset + edit.deleted; ++i) {
+        const size_t physical = i < buffer->gapStart ? i : i + buffer->gapEnd - buffer->gapStart;
+        str_buf_append_len(removed, &buffer->text[physical], 1);
+    }
+
+    return (SourceEdit){edit.offset, edit.length, edit.deleted > 0 ? removed->data : "", edit.deleted};
+}
+
+static void benchRelex(const char *sizeArg) {
+    const int megabytes = sizeArg != nullptr ? atoi(sizeArg) : 64;
+    if (megabytes <= 0) {
+        println("Usage: nifty bench relex <megabytes>");
+        return;
+    }
+
+    size_t length;
+    char *source = syntheticSource(64 * 1024, &length);
+    EditBuffer *buffer = initEditBuffer(source, length);
+    free(source);
+
+    uint32_t state = 0x9E3779B9u;
+    uint32_t cursor = (uint32_t)length / 2;
+    for (int i = 0; i < 4000; ++i) {
+        applyEdit(buffer, randomEdit(buffer, &state, &cursor, i % 2 == 0));
+        if (!relexMatches(buffer)) {
+            println("Tokens differ from lexing the whole text after %d edits!", i + 1);
+            freeEditBuffer(buffer);
+            return;
+        }
+    }
+    freeEditBuffer(buffer);
+
+    println("%8s  %12s  %12s  %10s", "MB", "full lex ms", "us per edit", "tokens");
+    for (size_t size = 64 * 1024; size <= (size_t)megabytes * 1024 * 1024; size *= 4) {
+        source = syntheticSource(size, &length);
+
+        uint64_t start = timer_now_ns();
+        buffer = initEditBuffer(source, length);
+        const double fullMs = timer_elapsed_ms(start);
+        free(source);
+
+        // Every edit is taken back right after, so each one is timed on text of the size reported.
+        StrBuffer removed;
+        str_buf_init(&removed);
+        int edits = 0;
+        cursor = (uint32_t)length / 2;
+        start = timer_now_ns();
+        while (edits < 1000 || timer_elapsed_ms(start) < BENCH_MIN_TIME_MS) {
+            const SourceEdit edit = randomEdit(buffer, &state, &cursor, false);
+            const SourceEdit undo = undoOf(buffer, edit, &removed);
+            applyEdit(buffer, edit);
+            applyEdit(buffer, undo);
+            edits += 2;
+        }
+        const double editUs = timer_elapsed_ms(start) * 1000.0 / edits;
+        str_buf_free(&removed);
+
+        println("%8.1f  %12.2f  %12.2f  %10d", (double)buffer->length / (1024.0 * 1024.0), fullMs, editUs,
+                editBufferTokenCount(buffer));
+        freeEditBuffer(buffer);
+    }
+}
+
+static double bestLexMs(Lexer *lexer, const bool interning) {
+    double best = 0.0;
+    for (int i = 0; i < BENCH_MIN_ITERATIONS; ++i) {
+        Interner *interner = interning ? initInterner() : nullptr;
+        lexer->current = lexer->source;
+        if (interner != nullptr) {
+            lexerIntern(lexer, interner);
+        }
+
+        const uint64_t start = timer_now_ns();
+        TokenStream *tokens = tokenizeFile(lexer);
+        const double ms = timer_elapsed_ms(start);
+        best = i == 0 || ms < best ? ms : best;
+
+        freeTokenStream(tokens);
+        freeInterner(interner);
+        lexer->interner = nullptr;
+    }
+
+    return best;
+}
+
+// Lexes file with and without interning names, then checks the symbols against the text and against parallel lexing.
+static void benchIntern(const char *file) {
+    if (str_empty(file)) {
+        println("Usage: nifty bench intern <file>");
+        return;
+    }
+
+    Lexer *lexer = initLexer(file);
+    if (lexer == nullptr) {
+        return;
+    }
+
+    const double plainMs = bestLexMs(lexer, false);
+    const double internMs = bestLexMs(lexer, true);
+
+    Interner *interner = initInterner();
+    lexer->current = lexer->source;
+    lexerIntern(lexer, interner);
+    TokenStream *tokens = tokenizeFile(lexer);
+
+    int names = 0;
+    int mismatches = 0;
+    size_t nameBytes = 0;
+    for (int i = 0; i < tokens->count; ++i) {
+        if (tokens->kinds[i] != TK_IDENT && tokens->kinds[i] != TK_STRING_LIT) {
+            continue;
+        }
+
+        const bool quoted = tokens->kinds[i] == TK_STRING_LIT;
+        const char *text = lexer->source + tokens->offsets[i] + quoted;
+        const int len = (int)tokens->lengths[i] - 2 * quoted;
+        int symbolLen;
+        const char *name = symbolName(interner, tokens->symbols[i], &symbolLen);
+        if (symbolLen != len || memcmp(name, text, (size_t)len) != 0) {
+            ++mismatches;
+        }
+
+        ++names;
+        nameBytes += (size_t)len + 1;
+    }
+
+    ThreadPool *pool = pool_new(max(thread_hardware_concurrency(), 4));
+    lexer->current = lexer->source;
+    TokenStream *parallel = tokenizeFileParallel(lexer, pool);
+    const bool same = parallel->count == tokens->count &&
+                      memcmp(parallel->symbols, tokens->symbols, sizeof(Symbol) * tokens->count) == 0;
+    pool_free(pool);
+
+    println("%.1f MB, %d tokens, %d identifiers and strings, %d distinct", (double)lexer->length / (1024.0 * 1024.0),
+            tokens->count, names, internerSymbolCount(interner));
+    println("lex:                 %8.2f ms", plainMs);
+    println("lex and intern:      %8.2f ms", internMs);
+    println("copying every name:  %8.1f KB", (double)nameBytes / 1024.0);
+    println("interned:            %8.1f KB", (double)internerBytes(interner) / 1024.0);
+    println("%s", mismatches == 0 ? "Every symbol matches its text." : "Symbols differ from their text!");
+    println("%s", same ? "Parallel lexing gives the same symbols." : "Parallel lexing gives different symbols!");
+
+    freeTokenStream(parallel);
+    freeTokenStream(tokens);
+    freeInterner(interner);
+    freeLexer(lexer);
+}
+
+// Parse errors are printed as they are found, this keeps them out of a benchmark's output.
+static int silenceStdout() {
+    fflush(stdout);
+#ifndef N_WIN
+    const int saved = dup(STDOUT_FILENO);
+    const int null = open("/dev/null", O_WRONLY);
+    if (saved >= 0 && null >= 0) {
+        dup2(null, STDOUT_FILENO);
+    }
+    if (null >= 0) {
+        close(null);
+    }
+    return saved;
+#else
+    return -1;
+#endif
+}
+
+static void restoreStdout(const int saved) {
+    fflush(stdout);
+#ifndef N_WIN
+    if (saved >= 0) {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+#endif
+}
+
+// Parses every file once per pass with a fresh interner, like a build would. Then again skipping function bodies, the
+// most a build with lazyFunctionBodies can save.
+static void benchParse(const int count, char **files) {
+    if (count <= 0) {
+        println("Usage: nifty bench parse <files>");
+        return;
+    }
+
+    CompilerConfig config;
+    config.disableColors = true;
+    config.verbosity = Info;
+    config.streamingLexer = false;
+    config.lazyBodies = false;
+    config.threads = 1;
+    config.threadPool = nullptr;
+    config.nslPath = nullptr;
+    config.cacheDir = nullptr;
+
+    for (int lazy = 0; lazy < 2; ++lazy) {
+        config.lazyBodies = lazy;
+
+        int passes = 0;
+        int nodes = 0;
+        int errors = 0;
+        int skipped = 0;
+        size_t treeBytes = 0;
+        double best = 0.0;
+        const uint64_t start = timer_now_ns();
+        while (passes < BENCH_MIN_ITERATIONS || timer_elapsed_ms(start) < BENCH_MIN_TIME_MS) {
+            config.interner = initInterner();
+            nodes = 0;
+            errors = 0;
+            skipped = 0;
+            treeBytes = 0;
+
+            const int saved = silenceStdout();
+            const uint64_t passStart = timer_now_ns();
+            for (int i = 0; i < count; ++i) {
+                ParseResults *results = parseFile(files[i], &config);
+                if (results == nullptr) {
+                    continue;
+                }
+
+                nodes += results->ast.count;
+                errors += results->errorCount;
+                treeBytes += astBytes(&results->ast);
+                for (int node = 0; lazy && node < results->ast.count; ++node) {
+                    skipped += astKind(&results->ast, (NodeIndex)node) == LazyBodyNodeType;
+                }
+                freeParseResults(results);
+            }
+            const double ms = timer_elapsed_ms(passStart);
+            restoreStdout(saved);
+
+            best = passes == 0 || ms < best ? ms : best;
+            freeInterner(config.interner);
+            ++passes;
+        }
+
+        if (!lazy) {
+            println("%d files, %d nodes, %d parse errors, %.1f KB of AST, %.1f bytes per node", count, nodes, errors,
+                    (double)treeBytes / 1024.0, nodes > 0 ? (double)treeBytes / nodes : 0.0);
+            println("parse: %10.3f ms per pass, best of %d", best, passes);
+        } else {
+            println("lazy:  %10.3f ms per pass, best of %d, %d bodies skipped, %d nodes", best, passes, skipped, nodes);
+        }
+    }
+}
+
+#define BENCH_PROGRAM_PACKAGES 40
+
+// A project of packages in a tree: main uses pkg/p00, and package i uses packages 2i + 1 and 2i + 2. A package is a
+// directory of files in one namespace, so they are found through its first file. Returns the entry point.
+static char *writeProgram(const int fileCount) {
+    const char *tmp = getenv("TMPDIR") != nullptr ? getenv("TMPDIR") : getenv("TEMP");
+    char project[64];
+    sprintf(project, "nifty-bench-program-%d", fileCount);
+    char *root = fs_join(tmp != nullptr ? tmp : "/tmp", project);
+    char *pkg = fs_join(root, "pkg");
+    BENCH_MKDIR(root);
+    BENCH_MKDIR(pkg);
+
+    char *entry = fs_join(root, "main.nifty");
+    FILE *fp = fopen(entry, "w");
+    if (fp == nullptr) {
+        println("Could not write '%s'.", entry);
+        str_delete(entry);
+        str_delete(pkg);
+        str_delete(root);
+        return nullptr;
+    }
+    fprintf(fp, "namespace app\n\nuse \"pkg::p00\"\n\nfn main() {\n    p00::f0_0(1)\n}\n");
+    fclose(fp);
+
+    const int perPackage = max(fileCount / BENCH_PROGRAM_PACKAGES, 1);
+    for (int p = 0; p < BENCH_PROGRAM_PACKAGES; ++p) {
+        char name[64];
+        sprintf(name, "p%02d", p);
+        char *dir = fs_join(pkg, name);
+        BENCH_MKDIR(dir);
+
+        for (int f = 0; f < perPackage; ++f) {
+            sprintf(name, "f%04d.nifty", f);
+            char *file = fs_join(dir, name);
+            fp = fopen(file, "w");
+            str_delete(file);
+            if (fp == nullptr) {
+                continue;
+            }
+
+            fprintf(fp, "namespace p%02d\n\n", p);
+            if (f == 0) {
+                for (int child = 2 * p + 1; child <= 2 * p + 2 && child < BENCH_PROGRAM_PACKAGES; ++child) {
+                    fprintf(fp, "use \"..::p%02d\"\n", child);
+                }
+            }
+
+            for (int i = 0; i < 24; ++i) {
+                fprintf(fp, "fn f%d_%d(x: int): int {\n    total := 0\n    for (i := 0; i < x; ++i) {\n"
+                            "        if i %% %d == 0 { total += i * 0x%X } else { total -= (x - i) / 3 }\n"
+                            "    }\n    val name ::= \"f%d_%d\"\n    return total + %d\n}\n\n",
+                        f, i, i + 2, i, f, i, p);
+            }
+            fclose(fp);
+        }
+        str_delete(dir);
+    }
+
+    str_delete(pkg);
+    str_delete(root);
+    return entry;
+}
+
+static uint64_t diagnosticsHash(const DiagnosticBuffer *diagnostics) {
+    uint64_t hash = (uint64_t)diagnostics->count;
+    for (int i = 0; i < diagnostics->count; ++i) {
+        const Diagnostic *diagnostic = &diagnostics->items[i];
+        hash = (hash ^ ((uint64_t)diagnostic->id << 32 | diagnostic->offset)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    return hash;
+}
+
+// Nodes name things by index into their file's names, so trees from different runs or threads compare word for word
+// once the names are compared by their text.
+static uint64_t treeHash(const Ast *ast, const Interner *interner) {
+    const uint64_t parts[] = {
+        hash_bytes((const char *)ast->kinds, ast->count),
+        hash_bytes((const char *)ast->offsets, sizeof(uint32_t) * ast->count),
+        hash_bytes((const char *)ast->data, sizeof(NodeData) * ast->count),
+        hash_bytes((const char *)ast->extra, sizeof(uint32_t) * ast->extraCount),
+        (uint64_t)ast->decls,
+    };
+
+    uint64_t hash = (uint64_t)ast->symbolCount;
+    for (int i = 0; i < 5; ++i) {
+        hash = (hash ^ parts[i]) * 0x9E3779B97F4A7C15ull;
+    }
+    for (int i = 1; i < ast->symbolCount; ++i) {
+        int len = 0;
+        const char *name = symbolName(interner, astSymbol(ast, (uint32_t)i), &len);
+        hash = (hash ^ hash_bytes(name, (size_t)len)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    return hash;
+}
+
+static uint64_t programHash(const Program *program, const Interner *interner) {
+    uint64_t hash = (uint64_t)program->fileCount;
+    for (int i = 0; i < program->fileCount; ++i) {
+        const ParseResults *file = program->files[i];
+        const uint64_t parts[] = {
+            hash_bytes(file->file, str_len(file->file)),
+            treeHash(&file->ast, interner),
+            diagnosticsHash(&file->diagnostics),
+        };
+        for (int j = 0; j < 3; ++j) {
+            hash = (hash ^ parts[j]) * 0x9E3779B97F4A7C15ull;
+        }
+    }
+
+    return hash;
+}
+
+// Every file of a program, found through its uses, on 1 to N threads.
+static void benchParseProgram(const char *entryArg, const char *threadsArg) {
+    char *entry = nullptr;
+    if (entryArg == nullptr || isDigit(entryArg[0])) {
+        entry = writeProgram(entryArg != nullptr ? atoi(entryArg) : 2000);
+    } else {
+        entry = str_new(entryArg, nullptr);
+    }
+    if (entry == nullptr) {
+        return;
+    }
+
+    CompilerConfig config;
+    config.disableColors = true;
+    config.verbosity = Info;
+    config.streamingLexer = false;
+    config.lazyBodies = false;
+    config.threads = 1;
+    config.nslPath = getenv("NIFTY_NSL");
+    config.cacheDir = nullptr;
+
+    uint64_t expected = 0;
+    double baseMs = 0.0;
+    const int maxThreads = threadsArg != nullptr ? max(atoi(threadsArg), 1) : thread_hardware_concurrency();
+    for (int threads = 1; threads <= maxThreads; threads = nextThreads(threads, maxThreads)) {
+        config.threadPool = pool_new(threads);
+
+        double best = 0.0;
+        bool matches = true;
+        for (int passes = 0; passes < BENCH_MIN_ITERATIONS; ++passes) {
+            config.interner = initInterner();
+            const uint64_t start = timer_now_ns();
+            Program *program = parseProgram(entry, &config);
+            const double ms = timer_elapsed_ms(start);
+            if (program == nullptr) {
+                freeInterner(config.interner);
+                pool_free(config.threadPool);
+                str_delete(entry);
+                return;
+            }
+
+            if (threads == 1 && passes == 0) {
+                int nodes = 0;
+                for (int i = 0; i < program->fileCount; ++i) {
+                    nodes += program->files[i]->ast.count;
+                }
+                println("%d files, %d nodes, %d parse errors", program->fileCount, nodes, program->errorCount);
+                println("threads  %10s  speedup", "ms");
+                expected = programHash(program, config.interner);
+            }
+            matches = matches && programHash(program, config.interner) == expected;
+            best = passes == 0 || ms < best ? ms : best;
+
+            freeProgram(program);
+            freeInterner(config.interner);
+        }
+
+        if (threads == 1) {
+            baseMs = best;
+        }
+
+        println("%7d  %10.2f  %6.2fx%s", threads, best, baseMs / best,
+                matches ? "" : "  (files or trees differ from the single threaded parse!)");
+        pool_free(config.threadPool);
+    }
+
+    str_delete(entry);
+}
+
+// Removes the cache files left in dir by an earlier pass.
+static void clearCache(const char *dir) {
+    int count = 0;
+    char **files = fs_list_files(dir, ".ast", &count);
+    for (int i = 0; i < count; ++i) {
+        remove(files[i]);
+    }
+    fs_free_list(files, count);
+}
+
+typedef enum {
+    REBUILD_UNCACHED,
+    REBUILD_COLD,
+    REBUILD_WARM,
+} RebuildMode;
+
+// One build's worth of parsing, like a no-op rebuild would do. Adds each tree's hash to hashes.
+static double rebuildPass(const int count, char **files, CompilerConfig *config, const RebuildMode mode,
+                          uint64_t *hashes, int *hits) {
+    config->interner = initInterner();
+    if (mode == REBUILD_COLD) {
+        clearCache(config->cacheDir);
+    }
+
+    *hits = 0;
+    const int saved = silenceStdout();
+    const uint64_t start = timer_now_ns();
+    for (int i = 0; i < count; ++i) {
+        bool cached = false;
+        ParseResults *results = mode == REBUILD_UNCACHED ? parseFile(files[i], config)
+                                                         : parseFileCached(files[i], config, &cached);
+        if (results == nullptr) {
+            hashes[i] = 0;
+            continue;
+        }
+
+        *hits += cached;
+        hashes[i] = treeHash(&results->ast, config->interner);
+        freeParseResults(results);
+    }
+    const double ms = timer_elapsed_ms(start);
+    restoreStdout(saved);
+
+    freeInterner(config->interner);
+    config->interner = nullptr;
+    return ms;
+}
+
+// A no-op rebuild of every .nifty file under paths: parsing all of them, filling an empty AST cache, and loading every
+// tree from the filled cache. Files with errors aren't cached, so they are parsed every time.
+static void benchRebuild(const int count, char **paths) {
+    if (count <= 0) {
+        println("Usage: nifty bench rebuild <dirs|files>");
+        return;
+    }
+
+    char **files = nullptr;
+    int fileCount = 0;
+    for (int i = 0; i < count; ++i) {
+        int found = 0;
+        char **listed = fs_is_dir(paths[i]) ? fs_list_files_recursive(paths[i], ".nifty", &found) : nullptr;
+        if (listed == nullptr) {
+            listed = (char **)malloc(sizeof(char *));
+            listed[0] = str_new(paths[i], nullptr);
+            found = 1;
+        }
+
+        files = (char **)realloc(files, sizeof(char *) * (fileCount + found));
+        memcpy(files + fileCount, listed, sizeof(char *) * found);
+        fileCount += found;
+        free(listed);
+    }
+
+    const char *tmp = getenv("TMPDIR") != nullptr ? getenv("TMPDIR") : getenv("TEMP");
+    char *cacheDir = fs_join(tmp != nullptr ? tmp : "/tmp", "nifty-bench-ast-cache");
+    if (!fs_make_dirs(cacheDir)) {
+        println("Could not create '%s'.", cacheDir);
+        str_delete(cacheDir);
+        fs_free_list(files, fileCount);
+        return;
+    }
+
+    CompilerConfig config;
+    config.disableColors = true;
+    config.verbosity = Info;
+    config.streamingLexer = false;
+    config.lazyBodies = false;
+    config.threads = 1;
+    config.threadPool = nullptr;
+    config.nslPath = nullptr;
+    config.cacheDir = cacheDir;
+
+    uint64_t *expected = (uint64_t *)malloc(sizeof(uint64_t) * fileCount);
+    uint64_t *hashes = (uint64_t *)malloc(sizeof(uint64_t) * fileCount);
+    static const char *names[] = {"no cache", "cold cache", "warm cache"};
+    double uncachedMs = 0.0;
+
+    println("%d files", fileCount);
+    println("%-10s  %10s  %8s  %6s", "", "ms", "speedup", "hits");
+    for (int mode = REBUILD_UNCACHED; mode <= REBUILD_WARM; ++mode) {
+        double best = 0.0;
+        int hits = 0;
+        bool matches = true;
+        for (int passes = 0; passes < BENCH_MIN_ITERATIONS; ++passes) {
+            const double ms = rebuildPass(fileCount, files, &config, (RebuildMode)mode,
+                                          mode == REBUILD_UNCACHED && passes == 0 ? expected : hashes, &hits);
+            best = passes == 0 || ms < best ? ms : best;
+            matches = matches &&
+                      (mode == REBUILD_UNCACHED || memcmp(hashes, expected, sizeof(uint64_t) * fileCount) == 0);
+        }
+
+        if (mode == REBUILD_UNCACHED) {
+            uncachedMs = best;
+        }
+
+        println("%-10s  %10.2f  %7.2fx  %6d%s", names[mode], best, uncachedMs / best, hits,
+                matches ? "" : "  (trees differ from parsing!)");
+    }
+
+    clearCache(cacheDir);
+    free(hashes);
+    free(expected);
+    str_delete(cacheDir);
+    fs_free_list(files, fileCount);
+}
+
+#define BENCH_SYMBOL_NAMESPACES 64
+
+typedef struct {
+    SymbolTable *table;
+    const Symbol *names;
+    int from;
+    int to;
+    int count; // Of every task, for the lookups.
+    int missing;
+} SymbolTask;
+
+// Declares its slice of the names while the other tasks declare theirs, then looks up every name, declared by anyone.
+static void symbolTask(void *arg) {
+    SymbolTask *task = (SymbolTask *)arg;
+    for (int i = task->from; i < task->to; ++i) {
+        declareSymbol(task->table, task->names[i % BENCH_SYMBOL_NAMESPACES], task->names[i], DECL_FUNCTION, nullptr,
+                      (NodeIndex)i);
+    }
+
+    for (int i = task->from; i < task->to; ++i) {
+        const Declaration *found = lookupSymbol(task->table, task->names[i % BENCH_SYMBOL_NAMESPACES], task->names[i]);
+        task->missing += found == nullptr || found->node != (NodeIndex)i;
+    }
+
+    // The others' names, found only if they were declared already.
+    for (int i = 0; i < task->count; ++i) {
+        lookupSymbol(task->table, task->names[i % BENCH_SYMBOL_NAMESPACES], task->names[i]);
+    }
+}
+
+// Threads declaring and looking up distinct names in one symbol table at the same time, on 1 to N threads.
+static void benchSymbols(const char *countArg, const char *threadsArg) {
+    const int count = countArg != nullptr ? atoi(countArg) : 1000000;
+    if (count <= BENCH_SYMBOL_NAMESPACES) {
+        println("Usage: nifty bench symbols <count> <N>");
+        return;
+    }
+
+    Interner *interner = initInterner();
+    Symbol *names = (Symbol *)malloc(sizeof(Symbol) * count);
+    for (int i = 0; i < count; ++i) {
+        char name[32];
+        names[i] = intern(interner, name, sprintf(name, "name%d", i));
+    }
+
+    println("%d declarations in %d namespaces, each thread looks up all of them", count, BENCH_SYMBOL_NAMESPACES);
+    println("threads  %10s  %12s", "ms", "Mops/s");
+    const int maxThreads = threadsArg != nullptr ? max(atoi(threadsArg), 1) : thread_hardware_concurrency();
+    for (int threads = 1; threads <= maxThreads; threads = nextThreads(threads, maxThreads)) {
+        ThreadPool *pool = pool_new(threads);
+        SymbolTask *tasks = (SymbolTask *)malloc(sizeof(SymbolTask) * threads);
+
+        double best = 0.0;
+        int missing = 0;
+        bool counted = true;
+        for (int passes = 0; passes < BENCH_MIN_ITERATIONS; ++passes) {
+            SymbolTable *table = initSymbolTable();
+            const uint64_t start = timer_now_ns();
+            TaskGroup group = TASK_GROUP_INIT;
+            for (int t = 0; t < threads; ++t) {
+                tasks[t] = (SymbolTask){table, names, (int)((int64_t)count * t / threads),
+                                        (int)((int64_t)count * (t + 1) / threads), count, 0};
+                pool_submit_group(pool, &group, symbolTask, &tasks[t]);
+            }
+            pool_wait_group(pool, &group);
+            const double ms = timer_elapsed_ms(start);
+
+            for (int t = 0; t < threads; ++t) {
+                missing += tasks[t].missing;
+            }
+            counted = counted && symbolTableCount(table) == count;
+            best = passes == 0 || ms < best ? ms : best;
+            freeSymbolTable(table);
+        }
+
+        const double operations = (double)count * (2.0 + threads);
+        println("%7d  %10.2f  %12.2f%s", threads, best, operations / (best * 1e3),
+                missing == 0 && counted ? "" : "  (declarations were lost!)");
+        free(tasks);
+        pool_free(pool);
+    }
+
+    free(names);
+    freeInterner(interner);
+}
+
+typedef struct {
+    TypeTable *table;
+    const Program *program;
+    int from;
+    int to;
+    int nodes;
+} TypesTask;
+
+static void typesTask(void *arg) {
+    TypesTask *task = (TypesTask *)arg;
+    for (int i = task->from; i < task->to; ++i) {
+        const ParseResults *file = task->program->files[i];
+        for (NodeIndex node = 1; node < (NodeIndex)file->ast.count; ++node) {
+            if (file->ast.kinds[node] >= NamedTypeNodeType && file->ast.kinds[node] <= UnionTypeNodeType) {
+                typeFromNode(task->table, task->program->symbols, file, node);
+                ++task->nodes;
+            }
+        }
+    }
+}
+
+static int compareNames(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Types of one table spelled the same way, which should have been one type.
+static int countDuplicateTypes(TypeTable *table, const Interner *interner) {
+    const int count = typeTableCount(table);
+    char **names = (char **)malloc(sizeof(char *) * count);
+    for (int i = 0; i < count; ++i) {
+        StrBuffer buf;
+        str_buf_init(&buf);
+        appendTypeName(table, interner, (TypeId)i + 1, &buf);
+        names[i] = str_new_len(buf.data, buf.len);
+        str_buf_free(&buf);
+    }
+
+    qsort(names, count, sizeof(char *), compareNames);
+    int duplicates = 0;
+    for (int i = 0; i < count; ++i) {
+        duplicates += i > 0 && str_eq(names[i - 1], names[i]);
+    }
+    for (int i = 0; i < count; ++i) {
+        str_delete(names[i]);
+    }
+    free(names);
+
+    return duplicates;
+}
+
+// Every type node of a program made into a type id, with the program's files split over 1 to N threads.
+static void benchTypes(const char *entryArg, const char *threadsArg) {
+    char *entry = nullptr;
+    if (entryArg == nullptr || isDigit(entryArg[0])) {
+        entry = writeProgram(entryArg != nullptr ? atoi(entryArg) : 2000);
+    } else {
+        entry = str_new(entryArg, nullptr);
+    }
+    if (entry == nullptr) {
+        return;
+    }
+
+    CompilerConfig config;
+    config.disableColors = true;
+    config.verbosity = Info;
+    config.streamingLexer = false;
+    config.lazyBodies = false;
+    config.threads = 0;
+    config.nslPath = getenv("NIFTY_NSL");
+    config.cacheDir = nullptr;
+    config.threadPool = pool_new(0);
+    config.interner = initInterner();
+
+    Program *program = parseProgram(entry, &config);
+    pool_free(config.threadPool);
+    str_delete(entry);
+    if (program == nullptr) {
+        freeInterner(config.interner);
+        return;
+    }
+
+    println("%d files, %d declarations", program->fileCount, symbolTableCount(program->symbols));
+    println("threads  %10s  %10s  %10s  %s", "ms", "type nodes", "types", "same spelling, different ids");
+    const int maxThreads = threadsArg != nullptr ? max(atoi(threadsArg), 1) : thread_hardware_concurrency();
+    for (int threads = 1; threads <= maxThreads; threads = nextThreads(threads, maxThreads)) {
+        ThreadPool *pool = pool_new(threads);
+        TypesTask *tasks = (TypesTask *)malloc(sizeof(TypesTask) * threads);
+
+        double best = 0.0;
+        int nodes = 0;
+        int types = 0;
+        int duplicates = 0;
+        for (int passes = 0; passes < BENCH_MIN_ITERATIONS; ++passes) {
+            TypeTable *table = initTypeTable(config.interner);
+            const uint64_t start = timer_now_ns();
+            TaskGroup group = TASK_GROUP_INIT;
+            for (int t = 0; t < threads; ++t) {
+                tasks[t] = (TypesTask){table, program, program->fileCount * t / threads,
+                                       program->fileCount * (t + 1) / threads, 0};
+                pool_submit_group(pool, &group, typesTask, &tasks[t]);
+            }
+            pool_wait_group(pool, &group);
+            const double ms = timer_elapsed_ms(start);
+
+            nodes = 0;
+            for (int t = 0; t < threads; ++t) {
+                nodes += tasks[t].nodes;
+            }
+            types = typeTableCount(table);
+            duplicates = max(duplicates, countDuplicateTypes(table, config.interner));
+            best = passes == 0 || ms < best ? ms : best;
+            freeTypeTable(table);
+        }
+
+        println("%7d  %10.2f  %10d  %10d  %d", threads, best, nodes, types, duplicates);
+        free(tasks);
+        pool_free(pool);
+    }
+
+    freeProgram(program);
+    freeInterner(config.interner);
+}
+
+// The instances a check found, by their spelling, which is the same whichever thread found them first.
+static uint64_t instancesHash(const Program *program, const Interner *interner) {
+    uint64_t hash = (uint64_t)program->instanceCount;
+    for (int i = 0; i < program->instanceCount; ++i) {
+        StrBuffer name;
+        str_buf_init(&name);
+        appendTypeName(program->types, interner, program->instances[i].args, &name);
+        hash = (hash ^ hash_bytes(name.data, (size_t)name.len)) * 0x9E3779B97F4A7C15ull;
+        str_buf_free(&name);
+    }
+
+    return hash;
+}
+
+// Checking the bodies of a program on 1 to N threads. Each pass parses the program again, only the check is timed.
+static void benchCheck(const char *entryArg, const char *threadsArg) {
+    char *entry = nullptr;
+    if (entryArg == nullptr || isDigit(entryArg[0])) {
+        entry = writeProgram(entryArg != nullptr ? atoi(entryArg) : 2000);
+    } else {
+        entry = str_new(entryArg, nullptr);
+    }
+    if (entry == nullptr) {
+        return;
+    }
+
+    CompilerConfig config;
+    config.disableColors = true;
+    config.verbosity = Info;
+    config.streamingLexer = false;
+    config.lazyBodies = false;
+    config.threads = 1;
+    config.nslPath = getenv("NIFTY_NSL");
+    config.cacheDir = nullptr;
+
+    uint64_t expected = 0;
+    double baseMs = 0.0;
+    const int maxThreads = threadsArg != nullptr ? max(atoi(threadsArg), 1) : thread_hardware_concurrency();
+    for (int threads = 1; threads <= maxThreads; threads = nextThreads(threads, maxThreads)) {
+        config.threadPool = pool_new(threads);
+
+        double best = 0.0;
+        bool matches = true;
+        for (int passes = 0; passes < BENCH_MIN_ITERATIONS; ++passes) {
+            config.interner = initInterner();
+            Program *program = parseProgram(entry, &config);
+            if (program == nullptr) {
+                freeInterner(config.interner);
+                pool_free(config.threadPool);
+                str_delete(entry);
+                return;
+            }
+
+            const int parseErrors = program->errorCount;
+            const uint64_t start = timer_now_ns();
+            checkProgram(program, &config);
+            const double ms = timer_elapsed_ms(start);
+
+            const uint64_t hash = programHash(program, config.interner) ^ instancesHash(program, config.interner);
+            if (threads == 1 && passes == 0) {
+                println("%d files, %d bodies, %d errors, %d instances", program->fileCount,
+                        program->times.checkedBodies, program->errorCount - parseErrors, program->instanceCount);
+                println("threads  %10s  speedup", "ms");
+                expected = hash;
+            }
+            matches = matches && hash == expected;
+            best = passes == 0 || ms < best ? ms : best;
+
+            freeProgram(program);
+            freeInterner(config.interner);
+        }
+
+        if (threads == 1) {
+            baseMs = best;
+        }
+
+        println("%7d  %10.2f  %6.2fx%s", threads, best, baseMs / best,
+                matches ? "" : "  (diagnostics or instances differ from the single threaded check!)");
+        pool_free(config.threadPool);
+    }
+
+    str_delete(entry);
+}
+
+// A generated table of literals: integers of every length, floats with and without exponents, hex and octal.
+static char *literalSource(const size_t size, size_t *length) {
+    char *source = (char *)malloc(size + 256);
+    uint32_t state = 0x1234567u;
+    size_t at = 0;
+    for (int i = 0; at < size; ++i) {
+        const uint32_t r = nextRandom(&state);
+        const uint64_t big = ((uint64_t)nextRandom(&state) << 32) | nextRandom(&state);
+        switch (i % 8) {
+            case 0: at += sprintf(source + at, "%u, ", r % 1000); break;
+            case 1: at += sprintf(source + at, "%llu, ", (unsigned long long)(big >> (r % 64))); break;
+            case 2: at += sprintf(source + at, "%u_%03u_%03u, ", r % 1000, r % 997, r % 991); break;
+            case 3: at += sprintf(source + at, "%.*g, ", (int)(r % 17) + 1, (double)big / (double)(r | 1)); break;
+            case 4: at += sprintf(source + at, "%u.%u, ", r % 100000, (uint32_t)big % 1000); break;
+            case 5: at += sprintf(source + at, "%.17e, ", (double)(big >> 11) * 1e-300 * (double)(r % 1000)); break;
+            case 6: at += sprintf(source + at, "0x%llX, ", (unsigned long long)big); break;
+            default: at += sprintf(source + at, "0o%o,\n", r); break;
+        }
+    }
+
+    *length = at;
+    return source;
+}
+
+// Parses the literal again with the C library, the way a later stage would have to without the lexer's values.
+static bool reparseNumber(const char *text, const int len, NumberLiteral *number) {
+    char buf[128];
+    int n = 0;
+    for (int i = 0; i < len && n < (int)sizeof(buf) - 1; ++i) {
+        if (text[i] != '_') {
+            buf[n++] = text[i];
+        }
+    }
+    buf[n] = '\0';
+
+    const bool hex = n > 1 && (buf[1] == 'x' || buf[1] == 'X');
+    const bool octal = n > 1 && (buf[1] == 'o' || buf[1] == 'O' || buf[1] == 'q' || buf[1] == 'Q');
+    if (hex || octal) {
+        number->kind = NUMBER_INTEGER;
+        number->value.integer.low = strtoull(buf + 2, nullptr, hex ? 16 : 8);
+    } else if (strpbrk(buf, ".eE") != nullptr) {
+        number->kind = NUMBER_FLOAT;
+        number->value.real = strtod(buf, nullptr);
+    } else {
+        number->kind = NUMBER_INTEGER;
+        number->value.integer.low = strtoull(buf, nullptr, 10);
+    }
+
+    return n < (int)sizeof(buf) - 1;
+}
+
+static void benchNumbers(const char *sizeArg) {
+    const int megabytes = sizeArg != nullptr ? atoi(sizeArg) : 32;
+    if (megabytes <= 0) {
+        println("Usage: nifty bench numbers <megabytes>");
+        return;
+    }
+
+    size_t length;
+    char *source = literalSource((size_t)megabytes * 1024 * 1024, &length);
+    Lexer *lexer = initLexerFromMemory(source, length);
+    free(source);
+    if (lexer == nullptr) {
+        return;
+    }
+
+    double lexMs = 0.0;
+    TokenStream *tokens = nullptr;
+    for (int i = 0; i < BENCH_MIN_ITERATIONS; ++i) {
+        freeTokenStream(tokens);
+        lexer->current = lexer->source;
+        const uint64_t start = timer_now_ns();
+        tokens = tokenizeFile(lexer);
+        const double ms = timer_elapsed_ms(start);
+        lexMs = i == 0 || ms < lexMs ? ms : lexMs;
+    }
+
+    uint64_t checksum = 0;
+    double reparseMs = 0.0;
+    for (int iteration = 0; iteration < BENCH_MIN_ITERATIONS; ++iteration) {
+        const uint64_t start = timer_now_ns();
+        for (int i = 0; i < tokens->numberCount; ++i) {
+            const uint32_t token = tokens->numbers[i].token;
+            NumberLiteral number;
+            reparseNumber(lexer->source + tokens->offsets[token], (int)tokens->lengths[token], &number);
+            checksum += number.value.integer.low;
+        }
+        const double ms = timer_elapsed_ms(start);
+        reparseMs = iteration == 0 || ms < reparseMs ? ms : reparseMs;
+    }
+
+    // Everything that fits the C library's types has to come out the same.
+    int mismatches = 0;
+    for (int i = 0; i < tokens->numberCount; ++i) {
+        const NumberLiteral *lexed = &tokens->numbers[i];
+        NumberLiteral expected;
+        const char *text = lexer->source + tokens->offsets[lexed->token];
+        const int textLength = (int)tokens->lengths[lexed->token];
+        if (lexed->overflow || (lexed->kind == NUMBER_INTEGER && lexed->value.integer.high != 0) ||
+            !reparseNumber(text, textLength, &expected)) {
+            continue;
+        }
+
+        const bool same = lexed->kind == NUMBER_FLOAT ? lexed->value.real == expected.value.real
+                                                      : lexed->value.integer.low == expected.value.integer.low;
+        if ((lexed->kind != expected.kind || !same) && mismatches++ < 5) {
+            println("Mismatch: '%.*s'", textLength, text);
+        }
+    }
+
+    println("%.1f MB, %d tokens, %d literals (checksum %llu)", (double)length / (1024.0 * 1024.0), tokens->count,
+            tokens->numberCount, (unsigned long long)checksum);
+    println("lex with values:     %8.2f ms  %6.1f MB/s", lexMs, (double)length / (1024.0 * 1024.0) / (lexMs / 1000.0));
+    println("parsing them again:  %8.2f ms  (saved by the lexer's values)", reparseMs);
+    println("%s", mismatches == 0 ? "All values match strtoull and strtod."
+                                  : "Values differ from strtoull and strtod!");
+
+    freeTokenStream(tokens);
+    freeLexer(lexer);
+}
+
+void runBenchmark(const int argc, char **argv) {
+    const char *name = argc > 0 ? argv[0] : nullptr;
+
+    if (str_eq(name, "lex")) {
+        benchLex(argc > 1 ? argv[1] : nullptr);
+    } else if (str_eq(name, "lex-parallel")) {
+        benchLexParallel(argc > 1 ? argv[1] : nullptr, argc > 2 ? argv[2] : nullptr);
+    } else if (str_eq(name, "numbers")) {
+        benchNumbers(argc > 1 ? argv[1] : nullptr);
+    } else if (str_eq(name, "relex")) {
+        benchRelex(argc > 1 ? argv[1] : nullptr);
+    } else if (str_eq(name, "parse")) {
+        benchParse(argc - 1, argv + 1);
+    } else if (str_eq(name, "parse-program")) {
+        benchParseProgram(argc > 1 ? argv[1] : nullptr, argc > 2 ? argv[2] : nullptr);
+    } else if (str_eq(name, "rebuild")) {
+        benchRebuild(argc - 1, argv + 1);
+    } else if (str_eq(name, "symbols")) {
+        benchSymbols(argc > 1 ? argv[1] : nullptr, argc > 2 ? argv[2] : nullptr);
+    } else if (str_eq(name, "types")) {
+        benchTypes(argc > 1 ? argv[1] : nullptr, argc > 2 ? argv[2] : nullptr);
+    } else if (str_eq(name, "check")) {
+        benchCheck(argc > 1 ? argv[1] : nullptr, argc > 2 ? argv[2] : nullptr);
+    } else if (str_eq(name, "intern")) {
+        benchIntern(argc > 1 ? argv[1] : nullptr);
+    } else if (str_eq(name, "keywords")) {
+        benchKeywords(argc > 1 ? argv[1] : nullptr);
+    } else {
+        println("Unknown benchmark '%s'. Run 'nifty help bench' for a list of benchmarks.",
+                name != nullptr ? name : "");
+    }
+}
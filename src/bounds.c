@@ -0,0 +1,433 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "pass.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Bounds checks the compiler can prove pass are removed. A check of index against length passes when index isn't
+// negative and a branch the check's block is only reached through compared index below length, or below a value
+// known not to be above it: the condition of for (i := 0; i < len(a); ++i) is enough for a[i] in the body.
+//
+// Whether a value is negative is a range analysis over the function's integers, from the greatest fixed point of
+// rules that keep values at or above zero: constants that are, lengths, checked sums and products of values that
+// are, and phis of only such values, which covers counters that start at zero and count up. A branch on index >= 0
+// is enough too, for the blocks only reached through it.
+//
+// A check that stays in a loop counting i from start up to end by one, run on every iteration, is hoisted before the
+// loop as one check of end against the length, when the loop only leaves through its condition and both are known
+// before it. A loop that would fail the check then traps before it starts instead of on the first index out of range.
+
+static bool isUnsigned(const TypeId type) {
+    return (type >= primitiveType(TYPE_U8) && type <= primitiveType(TYPE_U28)) || type == primitiveType(TYPE_UINTPTR);
+}
+
+typedef struct {
+    IrFunction *function;
+    IrBlock *idom;
+    IrValue *checks; // The IR_CHECK_OVERFLOW of each value, else IR_NONE.
+    bool *nonNegative;
+    bool *inLoop; // Blocks of the loop being hoisted out of.
+} Ranges;
+
+// Whether value is an IR_INT, and the low 64 bits of it if so, sign extended.
+static bool intValue(const IrFunction *function, const IrValue value, int64_t *result) {
+    const IrInst *inst = irInst(function, value);
+    if (inst->op != IR_INT) {
+        return false;
+    }
+
+    const uint32_t *words = function->extra + inst->a;
+    const bool fits = words[2] == words[3] && (words[3] == 0 || words[3] == UINT32_MAX) &&
+                      (words[1] >> 31 ? words[3] == UINT32_MAX : words[3] == 0);
+    *result = (int64_t)((uint64_t)words[1] << 32 | words[0]);
+    return fits;
+}
+
+// Whether inst, by the nonNegative of its operands, can't be negative.
+static bool keepsNonNegative(const Ranges *ranges, const IrValue value) {
+    const IrFunction *function = ranges->function;
+    const IrInst *inst = irInst(function, value);
+    const bool *known = ranges->nonNegative;
+    if (isUnsigned(inst->type)) {
+        return true;
+    }
+
+    int64_t constant;
+    switch ((IrOp)inst->op) {
+        case IR_INT:
+            return intValue(function, value, &constant) && constant >= 0;
+        case IR_LEN:
+            return true;
+        case IR_ADD:
+        case IR_MUL:
+            return ranges->checks[value] != IR_NONE && known[inst->a] && known[inst->b];
+        case IR_DIV:
+            return known[inst->a] && known[inst->b];
+        case IR_MOD:
+        case IR_SHR:
+            return known[inst->a];
+        case IR_AND:
+            return known[inst->a] || known[inst->b];
+        case IR_PHI: {
+            int count;
+            const uint32_t *operands = irList(function, inst->a, &count);
+            for (int i = 0; i < count; ++i) {
+                if (!known[operands[i]]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Every integer starts out taken as not negative, and falls once a rule says it may be, until none falls.
+static void findNonNegative(Ranges *ranges) {
+    IrFunction *function = ranges->function;
+    for (int v = 0; v < function->instCount; ++v) {
+        ranges->nonNegative[v] = function->insts[v].block != IR_NO_BLOCK && irIsInteger(function->insts[v].type);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = 0; b < function->blockCount; ++b) {
+            const IrBlockData *block = &function->blocks[b];
+            for (int i = 0; i < block->count && !block->removed; ++i) {
+                const IrValue value = block->insts[i];
+                if (ranges->nonNegative[value] && !keepsNonNegative(ranges, value)) {
+                    ranges->nonNegative[value] = false;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+// Whether two values are always equal where both are defined.
+static bool sameValue(const IrFunction *function, const IrValue x, const IrValue y) {
+    if (x == y) {
+        return true;
+    }
+
+    const IrInst *a = irInst(function, x);
+    const IrInst *b = irInst(function, y);
+    if (a->op != b->op || a->type != b->type) {
+        return false;
+    }
+    if (a->op == IR_INT) {
+        return memcmp(function->extra + a->a, function->extra + b->a, sizeof(uint32_t) * 4) == 0;
+    }
+    return a->op == IR_LEN && sameValue(function, a->a, b->a);
+}
+
+// Whether bound is known not to be above length.
+static bool atMost(const IrFunction *function, const IrValue bound, const IrValue length) {
+    int64_t x;
+    int64_t y;
+    return sameValue(function, bound, length) ||
+           (intValue(function, bound, &x) && intValue(function, length, &y) && x <= y);
+}
+
+// Whether cond being holds, true or not, means index < length, or index >= 0 for a length of IR_NONE.
+static bool implies(const Ranges *ranges, const IrValue cond, const bool holds, const IrValue index,
+                    const IrValue length) {
+    const IrFunction *function = ranges->function;
+    const IrInst *inst = irInst(function, cond);
+    const bool less = inst->op == IR_LT || inst->op == IR_GT; // When holds, which side is less.
+    // index < bound and bound > index, or index >= bound and bound <= index when not.
+    const bool below = holds == less;
+    IrValue left = inst->a;
+    IrValue right = inst->b;
+    switch ((IrOp)inst->op) {
+        case IR_NOT:
+            return implies(ranges, inst->a, !holds, index, length);
+        case IR_GT:
+        case IR_LE:
+            left = inst->b;
+            right = inst->a;
+            // fallthrough
+        case IR_LT:
+        case IR_GE:
+            if (length != IR_NONE) {
+                return below && left == index && atMost(function, right, length);
+            }
+            return !below && left == index && ranges->nonNegative[right];
+        default:
+            return false;
+    }
+}
+
+// Whether block is only reached through branches that mean index < length, or index >= 0 for a length of IR_NONE.
+static bool known(const Ranges *ranges, IrBlock block, const IrValue index, const IrValue length) {
+    const IrFunction *function = ranges->function;
+    int64_t x;
+    int64_t y;
+    if (length == IR_NONE ? ranges->nonNegative[index] : intValue(function, index, &x) &&
+                                                          intValue(function, length, &y) && x < y) {
+        return true;
+    }
+
+    while (block != 0 && ranges->idom[block] != IR_NO_BLOCK) {
+        const IrBlock parent = ranges->idom[block];
+        const IrValue branch = irTerminator(function, parent);
+        const IrBlockData *data = &function->blocks[block];
+        if (branch != IR_NONE && irInst(function, branch)->op == IR_BRANCH && data->predCount == 1) {
+            const IrInst *inst = irInst(function, branch);
+            const IrBlock then = function->extra[inst->b];
+            const IrBlock otherwise = function->extra[inst->b + 1];
+            if (then != otherwise && implies(ranges, inst->a, block == then, index, length)) {
+                return true;
+            }
+        }
+        block = parent;
+    }
+
+    return false;
+}
+
+// Whether nothing leaves the loop but the branch of its header.
+static bool onlyLeavesAtHeader(const IrFunction *function, const IrBlock header, const bool *inLoop) {
+    for (int b = 0; b < function->blockCount; ++b) {
+        if (!inLoop[b] || b == (int)header) {
+            continue;
+        }
+
+        const IrValue terminator = irTerminator(function, (IrBlock)b);
+        const IrOp op = terminator != IR_NONE ? (IrOp)irInst(function, terminator)->op : IR_UNREACHABLE;
+        if (op != IR_JUMP && op != IR_BRANCH) {
+            return false;
+        }
+
+        IrBlock succs[2];
+        const int count = irSuccessors(function, (IrBlock)b, succs);
+        for (int s = 0; s < count; ++s) {
+            if (!inLoop[succs[s]]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// value as it is known before the loop, made again before the preheader's jump if it is only made in the loop.
+static IrValue beforeLoop(Ranges *ranges, const IrValue value, const IrBlock preheader) {
+    IrFunction *function = ranges->function;
+    const IrInst inst = *irInst(function, value);
+    if (!ranges->inLoop[inst.block]) {
+        return value;
+    }
+
+    const int end = function->blocks[preheader].count - 1;
+    if (inst.op == IR_INT) {
+        // Copied out first, extra can move as it grows.
+        uint32_t words[4];
+        memcpy(words, function->extra + inst.a, sizeof(words));
+        const uint32_t value = addIrExtra(function, words, 4);
+        return insertIrInst(function, preheader, end, IR_INT, inst.type, value, 0, inst.offset);
+    }
+    if (inst.op == IR_LEN) {
+        const IrValue base = beforeLoop(ranges, inst.a, preheader);
+        return base == IR_NONE ? IR_NONE
+                               : insertIrInst(function, preheader, function->blocks[preheader].count - 1, IR_LEN,
+                                              inst.type, base, 0, inst.offset);
+    }
+    return IR_NONE;
+}
+
+// Whether the check of index against length in block runs on every trip of the loop of header, with index counting
+// from start to end by one. Adds a check of end before the loop if so, which the check can be removed for.
+static bool hoistCheck(Ranges *ranges, const IrValue check, const IrBlock header) {
+    IrFunction *function = ranges->function;
+    const IrInst site = *irInst(function, check);
+    const IrBlockData *data = &function->blocks[header];
+    const IrInst *phi = irInst(function, site.a);
+    if (phi->op != IR_PHI || phi->block != header || data->predCount != 2) {
+        return false;
+    }
+
+    const IrBlock preheader = data->preds[0];
+    const IrBlock latch = data->preds[1];
+    const IrValue terminator = irTerminator(function, preheader);
+    if (ranges->inLoop[preheader] || terminator == IR_NONE || irInst(function, terminator)->op != IR_JUMP) {
+        return false;
+    }
+
+    // i = phi [start, i + 1], one more on each trip.
+    int count;
+    const uint32_t *operands = irList(function, phi->a, &count);
+    const IrValue start = operands[0];
+    const IrInst *next = irInst(function, operands[1]);
+    int64_t step;
+    const bool stepsByOne = next->op == IR_ADD && ranges->checks[operands[1]] != IR_NONE &&
+                            ((next->a == site.a && intValue(function, next->b, &step) && step == 1) ||
+                             (next->b == site.a && intValue(function, next->a, &step) && step == 1));
+    if (!stepsByOne || !ranges->nonNegative[start]) {
+        return false;
+    }
+
+    // while (i < end), with the check only reached through its true edge and on every trip.
+    const IrValue branch = irTerminator(function, header);
+    if (branch == IR_NONE || irInst(function, branch)->op != IR_BRANCH) {
+        return false;
+    }
+    const IrInst *condition = irInst(function, irInst(function, branch)->a);
+    const IrBlock then = function->extra[irInst(function, branch)->b];
+    const IrBlock otherwise = function->extra[irInst(function, branch)->b + 1];
+    IrValue end = IR_NONE;
+    if (condition->op == IR_LT && condition->a == site.a) {
+        end = condition->b;
+    } else if (condition->op == IR_GT && condition->b == site.a) {
+        end = condition->a;
+    }
+    if (end == IR_NONE || !ranges->inLoop[then] || ranges->inLoop[otherwise] ||
+        function->blocks[then].predCount != 1 || !irDominates(ranges->idom, then, site.block) ||
+        !irDominates(ranges->idom, site.block, latch) || !onlyLeavesAtHeader(function, header, ranges->inLoop)) {
+        return false;
+    }
+
+    const IrValue hoistedEnd = beforeLoop(ranges, end, preheader);
+    const IrValue length = hoistedEnd != IR_NONE ? beforeLoop(ranges, site.b, preheader) : IR_NONE;
+    if (length == IR_NONE) {
+        return false;
+    }
+
+    const uint32_t words[2] = {start, length};
+    insertIrInst(function, preheader, function->blocks[preheader].count - 1, IR_CHECK_RANGE, TYPE_ID_NONE, hoistedEnd,
+                 addIrExtra(function, words, 2), site.offset);
+    return true;
+}
+
+// Whether an earlier hoisted check before the preheader of header already covers this one.
+static bool hoistedBefore(const IrFunction *function, const IrValue check, const IrBlock header) {
+    const IrBlock preheader = function->blocks[header].preds[0];
+    const IrBlockData *block = &function->blocks[preheader];
+    const IrInst *site = irInst(function, check);
+    const IrInst *phi = irInst(function, site->a);
+    if (phi->op != IR_PHI || phi->block != header) {
+        return false;
+    }
+
+    int count;
+    const uint32_t *operands = irList(function, phi->a, &count);
+    for (int i = 0; i < block->count; ++i) {
+        const IrInst *inst = irInst(function, block->insts[i]);
+        if (inst->op == IR_CHECK_RANGE && function->extra[inst->b] == operands[0] &&
+            sameValue(function, function->extra[inst->b + 1], site->b)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void findChecks(Ranges *ranges) {
+    IrFunction *function = ranges->function;
+    memset(ranges->checks, 0, sizeof(IrValue) * (function->instCount + 1));
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            const IrInst *inst = irInst(function, block->insts[i]);
+            if (inst->op == IR_CHECK_OVERFLOW) {
+                ranges->checks[inst->a] = block->insts[i];
+            }
+        }
+    }
+}
+
+// Removes or hoists the bounds checks of one function, returns how many.
+static int boundsChecks(IrModule *module, const int f) {
+    IrFunction *function = module->functions[f];
+    const int instCount = function->instCount;
+    Ranges ranges = {function, nullptr, nullptr, nullptr, nullptr};
+    ranges.idom = (IrBlock *)malloc(sizeof(IrBlock) * (function->blockCount + 1));
+    ranges.checks = (IrValue *)malloc(sizeof(IrValue) * (instCount + 1));
+    ranges.nonNegative = (bool *)malloc(sizeof(bool) * (instCount + 1));
+    ranges.inLoop = (bool *)malloc(sizeof(bool) * (function->blockCount + 1));
+    irDominators(function, ranges.idom);
+    findChecks(&ranges);
+    findNonNegative(&ranges);
+
+    int changes = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        if (block->removed || ranges.idom[b] == IR_NO_BLOCK) {
+            continue;
+        }
+
+        for (int i = 0; i < block->count; ++i) {
+            const IrValue check = block->insts[i];
+            const IrInst site = *irInst(function, check);
+            if (site.op != IR_CHECK_BOUNDS || check >= (IrValue)instCount) {
+                continue;
+            }
+
+            if (known(&ranges, (IrBlock)b, site.a, IR_NONE) && known(&ranges, (IrBlock)b, site.a, site.b)) {
+                removeIrInst(function, check, IR_NONE);
+                addIrRemark(module, "bounds", f, site.offset, "bounds check removed, the index is known in range");
+                ++changes;
+                continue;
+            }
+
+            const IrInst *phi = irInst(function, site.a);
+            const IrBlock header = phi->block;
+            if (phi->op == IR_PHI && function->blocks[header].kind == BLOCK_LOOP) {
+                irLoopBlocks(function, header, ranges.inLoop);
+                if (ranges.inLoop[b] &&
+                    (hoistedBefore(function, check, header) || hoistCheck(&ranges, check, header))) {
+                    removeIrInst(function, check, IR_NONE);
+                    addIrRemark(module, "bounds", f, site.offset, "bounds check hoisted out of the loop");
+                    ++changes;
+                    continue;
+                }
+            }
+            addIrRemark(module, "bounds", f, site.offset, "bounds check kept");
+        }
+    }
+
+    free(ranges.inLoop);
+    free(ranges.nonNegative);
+    free(ranges.checks);
+    free(ranges.idom);
+    if (changes > 0) {
+        compactIrFunction(function);
+    }
+    return changes;
+}
+
+int removeBoundsChecks(IrModule *module, StrBuffer *errors) {
+    (void)errors;
+
+    int changes = 0;
+    for (int f = 0; f < module->functionCount; ++f) {
+        if (module->functions[f]->blockCount > 0) {
+            changes += boundsChecks(module, f);
+        }
+    }
+
+    return changes;
+}
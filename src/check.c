@@ -0,0 +1,2325 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "check.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "consteval.h"
+#include "diagnostic.h"
+#include "lexer.h"
+#include "util/array.h"
+#include "util/hash.h"
+#include "util/str.h"
+#include "util/thread.h"
+#include "util/timer.h"
+
+// Instances are spread over shards by the hash of their key, each with its own lock.
+#define INSTANCE_SHARD_BITS 4
+#define INSTANCE_SHARDS (1 << INSTANCE_SHARD_BITS)
+#define INSTANCE_MIN_SLOTS 64
+
+// Functions every file can call without declaring them.
+static const char *builtinNames[] = {"panic", "print", "println", "len", "cap", "min", "max"};
+#define BUILTIN_COUNT ((int)(sizeof(builtinNames) / sizeof(builtinNames[0])))
+
+typedef struct {
+    const Declaration *declaration; // nullptr for an empty slot.
+    TypeId args;
+    TypeId type;
+} InstanceSlot;
+
+typedef struct {
+    Mutex lock;
+    InstanceSlot *slots;
+    uint32_t mask;
+    uint32_t count;
+    char padding[64]; // Keeps shards locked by different threads off the same cache line.
+} InstanceShard;
+
+typedef struct {
+    ParseResults *results;
+    TypeId *types; // The program's nodeTypes of the file.
+    int typeCount; // Nodes types has room for, bodies parsed while checking add more.
+    ConstantTable *constants; // The program's constants of the file.
+    uint8_t *constantStates; // ConstantState of its top level constants by node, nullptr if it has none.
+    DiagnosticBuffer *diagnostics; // Of its signatures and top level constants, without lines like a body's.
+    bool complete; // Every namespace it is using is in the program, so a name declared nowhere is an error.
+} CheckedFile;
+
+typedef struct {
+    Program *program;
+    CompilerConfig *config;
+    TypeTable *types;
+    CheckedFile *files;
+
+    // Index of each file by its results, open addressing on the pointer.
+    const ParseResults **fileKeys;
+    int *fileIndices;
+    uint32_t fileMask;
+
+    Symbol *namespaces; // Declared by the program's files, sorted.
+    int namespaceCount;
+
+    DiagnosticBuffer *diagnostics; // One per file.
+
+    Symbol builtins[BUILTIN_COUNT];
+    Symbol main;
+    InstanceShard shards[INSTANCE_SHARDS];
+} Checker;
+
+typedef struct {
+    Symbol name;
+    TypeId type;
+    bool constant;
+    Constant value; // CONST_NONE unless it is a constant known at compile time.
+} Binding;
+
+// A literal expression checked, waiting for the type it is used as.
+typedef struct {
+    NodeIndex node; // NODE_NONE once it has its type.
+    int start; // Index of the first literal expression in it, they are checked before it.
+} LiteralUse;
+
+// One function body, checked by one task.
+typedef struct {
+    Checker *checker;
+    CheckedFile *file;
+    NodeIndex function;
+    Symbol impl; // The type of methods, SYMBOL_NONE for functions.
+
+    // Locals in scope, innermost last.
+    Binding *bindings;
+    int bindingCount;
+    int bindingCapacity;
+
+    TypeId *returns;
+    int returnCount; // -1 for main declaring nothing, which may return its exit code as an int.
+    const uint32_t *parameters; // Type parameters of the function, as names of its file.
+    int parameterCount;
+
+    // Literal expressions like 1 << 40, in the order they were checked. Each takes its type from where it is used,
+    // or its own if nothing gives it one by the end of the body, and must fit it.
+    LiteralUse *literals;
+    int literalCount;
+    int literalCapacity;
+
+    DiagnosticBuffer diagnostics; // Without lines, they are filled in when added to the file's.
+    ConstantTable constants; // Added to the file's once every body is done.
+    uint64_t ns;
+} BodyCheck;
+
+typedef struct {
+    Checker *checker;
+    int file;
+    uint64_t ns;
+} SignatureTask;
+
+static uint32_t pointerHash(const void *pointer) {
+    const uintptr_t key = (uintptr_t)pointer;
+    return (uint32_t)hash_bytes((const char *)&key, sizeof(key));
+}
+
+static CheckedFile *fileOf(const Checker *checker, const ParseResults *results) {
+    for (uint32_t at = pointerHash(results) & checker->fileMask;; at = (at + 1) & checker->fileMask) {
+        if (checker->fileKeys[at] == results) {
+            return &checker->files[checker->fileIndices[at]];
+        }
+    }
+}
+
+static int compareSymbols(const void *x, const void *y) {
+    const Symbol a = *(const Symbol *)x;
+    const Symbol b = *(const Symbol *)y;
+    return a < b ? -1 : a > b;
+}
+
+static bool isProgramNamespace(const Checker *checker, const Symbol namespace) {
+    return bsearch(&namespace, checker->namespaces, checker->namespaceCount, sizeof(Symbol), compareSymbols) != nullptr;
+}
+
+static bool isBuiltin(const Checker *checker, const Symbol name) {
+    for (int i = 0; i < BUILTIN_COUNT; ++i) {
+        if (checker->builtins[i] == name) {
+            return true;
+        }
+    }
+
+    // size_of, cast, u32(x) and the other keywords that can be called.
+    int len = 0;
+    const char *spelling = symbolName(checker->config->interner, name, &len);
+    return keywordType(spelling, len) != TK_IDENT;
+}
+
+// Records an instance, false if some task already did.
+static bool addInstance(Checker *checker, const Declaration *declaration, const TypeId args, const TypeId type) {
+    const uint64_t key[2] = {(uint64_t)(uintptr_t)declaration, args};
+    const uint64_t h = hash_bytes((const char *)key, sizeof(key));
+    InstanceShard *shard = &checker->shards[h >> (64 - INSTANCE_SHARD_BITS)];
+
+    mutex_lock(&shard->lock);
+    uint32_t at = (uint32_t)h & shard->mask;
+    for (; shard->slots[at].declaration != nullptr; at = (at + 1) & shard->mask) {
+        if (shard->slots[at].declaration == declaration && shard->slots[at].args == args) {
+            mutex_unlock(&shard->lock);
+            return false;
+        }
+    }
+
+    shard->slots[at] = (InstanceSlot){declaration, args, type};
+    if (++shard->count * 4 > (shard->mask + 1) * 3) {
+        const uint32_t size = (shard->mask + 1) * 2;
+        InstanceSlot *slots = (InstanceSlot *)calloc(size, sizeof(InstanceSlot));
+        for (uint32_t i = 0; i <= shard->mask; ++i) {
+            const InstanceSlot slot = shard->slots[i];
+            if (slot.declaration == nullptr) {
+                continue;
+            }
+
+            const uint64_t k[2] = {(uint64_t)(uintptr_t)slot.declaration, slot.args};
+            uint32_t to = (uint32_t)hash_bytes((const char *)k, sizeof(k)) & (size - 1);
+            while (slots[to].declaration != nullptr) {
+                to = (to + 1) & (size - 1);
+            }
+            slots[to] = slot;
+        }
+        free(shard->slots);
+        shard->slots = slots;
+        shard->mask = size - 1;
+    }
+    mutex_unlock(&shard->lock);
+
+    return true;
+}
+
+static const Declaration *findStruct(const Checker *checker, const Symbol namespace, const Symbol name) {
+    for (const Declaration *decl = lookupSymbol(checker->program->symbols, namespace, name); decl != nullptr;
+         decl = decl->next) {
+        if (decl->kind == DECL_STRUCT) {
+            return decl;
+        }
+    }
+
+    return nullptr;
+}
+
+static int typeParameterCount(const Ast *ast, const NodeIndex structNode) {
+    return (int)ast->extra[ast->extra[ast->data[structNode].b + 1]];
+}
+
+// Whether every name in type is declared somewhere, a type parameter isn't.
+static bool isConcrete(const Checker *checker, const TypeId type) {
+    if (type == TYPE_ID_NONE) {
+        return false;
+    }
+
+    const Type *t = typeOf(checker->types, type);
+    switch (t->form) {
+        case FORM_PRIMITIVE:
+            return true;
+        case FORM_NAMED:
+            return lookupSymbol(checker->program->symbols, t->b, t->a) != nullptr;
+        case FORM_POINTER:
+        case FORM_MANY_POINTER:
+        case FORM_SLICE:
+        case FORM_ARRAY:
+        case FORM_VARIADIC:
+        case FORM_OPTIONAL:
+            return isConcrete(checker, t->a);
+        default:
+            break;
+    }
+
+    if (t->form == FORM_GENERIC && !isConcrete(checker, t->a)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < t->count; ++i) {
+        if (!isConcrete(checker, t->items[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Records every generic struct used in type with concrete arguments.
+static void requestInstances(Checker *checker, const TypeId type) {
+    if (type == TYPE_ID_NONE || !isConcrete(checker, type)) {
+        return;
+    }
+
+    const Type *t = typeOf(checker->types, type);
+    switch (t->form) {
+        case FORM_PRIMITIVE:
+        case FORM_NAMED:
+            return;
+        case FORM_POINTER:
+        case FORM_MANY_POINTER:
+        case FORM_SLICE:
+        case FORM_ARRAY:
+        case FORM_VARIADIC:
+        case FORM_OPTIONAL:
+            requestInstances(checker, t->a);
+            return;
+        case FORM_GENERIC: {
+            const Type *base = typeOf(checker->types, t->a);
+            const Declaration *decl = findStruct(checker, base->b, base->a);
+            if (decl != nullptr && typeParameterCount(&decl->file->ast, decl->node) == (int)t->count) {
+                addInstance(checker, decl, type, type);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    for (uint32_t i = 0; i < t->count; ++i) {
+        requestInstances(checker, t->items[i]);
+    }
+}
+
+static uint32_t arrayLength(Checker *checker, const CheckedFile *file, BodyCheck *body, NodeIndex size);
+static void reportIn(DiagnosticBuffer *buffer, const CheckedFile *file, DiagnosticId id, NodeIndex node,
+                     const char *arg0, const char *arg1, const char *arg2);
+
+static bool hasUnknownLength(const Checker *checker, const TypeId type) {
+    if (type == TYPE_ID_NONE) {
+        return false;
+    }
+
+    const Type *t = typeOf(checker->types, type);
+    switch (t->form) {
+        case FORM_ARRAY:
+            return t->b == ARRAY_LENGTH_UNKNOWN || hasUnknownLength(checker, t->a);
+        case FORM_POINTER:
+        case FORM_MANY_POINTER:
+        case FORM_SLICE:
+        case FORM_VARIADIC:
+        case FORM_OPTIONAL:
+            return hasUnknownLength(checker, t->a);
+        default:
+            return false;
+    }
+}
+
+// type, the type of node, with the lengths typeFromNode left unknown worked out, like the size of [COUNT * 2]u8.
+static TypeId withLengths(Checker *checker, const CheckedFile *file, BodyCheck *body, const NodeIndex node,
+                          const TypeId type) {
+    if (type == TYPE_ID_NONE) {
+        return type;
+    }
+
+    const Ast *ast = &file->results->ast;
+    const NodeData data = ast->data[node];
+    const Type *t = typeOf(checker->types, type);
+    switch (astKind(ast, node)) {
+        case ArrayTypeNodeType: {
+            const TypeId element = withLengths(checker, file, body, data.a, t->a);
+            const uint32_t length = t->b != ARRAY_LENGTH_UNKNOWN ? t->b : arrayLength(checker, file, body, data.b);
+            return arrayType(checker->types, element, length);
+        }
+        case PointerTypeNodeType: {
+            const TypeId element = withLengths(checker, file, body, data.a, t->a);
+            return data.b ? manyPointerType(checker->types, element) : pointerType(checker->types, element);
+        }
+        case SliceTypeNodeType:
+            return sliceType(checker->types, withLengths(checker, file, body, data.a, t->a));
+        case VariadicTypeNodeType:
+            return variadicType(checker->types, withLengths(checker, file, body, data.a, t->a));
+        case OptionalTypeNodeType:
+            return optionalType(checker->types, withLengths(checker, file, body, data.a, t->a));
+        default:
+            return type;
+    }
+}
+
+// The type node stands for, in body if it is in one, whose constants array sizes can name.
+static TypeId resolveType(Checker *checker, const CheckedFile *file, BodyCheck *body, const NodeIndex node) {
+    if (node == NODE_NONE) {
+        return TYPE_ID_NONE;
+    }
+
+    TypeId type = typeFromNode(checker->types, checker->program->symbols, file->results, node);
+    if (hasUnknownLength(checker, type)) {
+        type = withLengths(checker, file, body, node, type);
+    }
+    requestInstances(checker, type);
+    return type;
+}
+
+// The type a literal has on its own, for values whose declaration doesn't say.
+static TypeId literalType(const Ast *ast, const NodeIndex node) {
+    switch (astKind(ast, node)) {
+        case IntNodeType: return primitiveType(TYPE_S32);
+        case FloatNodeType: return primitiveType(ast->data[node].b == 32 ? TYPE_F32 : TYPE_F64);
+        case StringNodeType: return primitiveType(TYPE_STRING);
+        case CharNodeType: return primitiveType(TYPE_CHAR);
+        case BoolNodeType: return primitiveType(TYPE_B32);
+        default: return TYPE_ID_NONE;
+    }
+}
+
+// Reports the names in the type node that nothing in the program declares, like Rand in ^Rand, unless they are among
+// the function's type parameters.
+static void reportUndeclaredTypes(Checker *checker, const CheckedFile *file, const NodeIndex node,
+                                  const uint32_t *parameters, const int parameterCount) {
+    const Ast *ast = &file->results->ast;
+    const NodeData data = ast->data[node];
+    switch (astKind(ast, node)) {
+        case NamedTypeNodeType: {
+            const Symbol name = astSymbol(ast, data.a);
+            const TypeId type = typeFromNode(checker->types, checker->program->symbols, file->results, node);
+            if (data.b != TYPE_NONE || !file->complete || typeOf(checker->types, type)->form != FORM_NAMED ||
+                lookupSymbol(checker->program->symbols, NAMESPACE_ANY, name) != nullptr) {
+                return;
+            }
+            for (int i = 0; i < parameterCount; ++i) {
+                if (astSymbol(ast, parameters[i]) == name) {
+                    return;
+                }
+            }
+            const char *spelling = symbolName(checker->config->interner, name, nullptr);
+            reportIn(file->diagnostics, file, DIAG_UNDECLARED, node, spelling, nullptr, nullptr);
+            break;
+        }
+        case PointerTypeNodeType:
+        case SliceTypeNodeType:
+        case ArrayTypeNodeType:
+        case VariadicTypeNodeType:
+        case OptionalTypeNodeType:
+        case GenericTypeNodeType:
+            reportUndeclaredTypes(checker, file, data.a, parameters, parameterCount);
+            break;
+        default:
+            break;
+    }
+}
+
+// Resolves the prototype of function and its arguments, and gives all three their types.
+static void functionSignature(Checker *checker, const CheckedFile *file, const NodeIndex function) {
+    const Ast *ast = &file->results->ast;
+    const NodeIndex prototype = ast->data[function].a;
+    const uint32_t signature = ast->data[prototype].b;
+
+    int argCount;
+    const uint32_t *args = astList(ast, ast->extra[signature], &argCount);
+    int returnCount;
+    const uint32_t *returns = astList(ast, ast->extra[signature + 1], &returnCount);
+
+    int parameterCount;
+    const uint32_t *parameters = astList(ast, ast->extra[signature + 2], &parameterCount);
+
+    TypeId *types = (TypeId *)malloc(sizeof(TypeId) * (argCount + returnCount + 1));
+    bool complete = true;
+    for (int i = 0; i < argCount; ++i) {
+        const uint32_t arg = ast->data[args[i]].b;
+        const NodeIndex typeNode = ast->extra[arg];
+        types[i] = typeNode != NODE_NONE ? resolveType(checker, file, nullptr, typeNode)
+                                         : literalType(ast, ast->extra[arg + 1]);
+        file->types[args[i]] = types[i];
+        complete = complete && types[i] != TYPE_ID_NONE;
+        if (typeNode != NODE_NONE) {
+            reportUndeclaredTypes(checker, file, typeNode, parameters, parameterCount);
+        }
+    }
+    for (int i = 0; i < returnCount; ++i) {
+        types[argCount + i] = resolveType(checker, file, nullptr, returns[i]);
+        complete = complete && types[argCount + i] != TYPE_ID_NONE;
+        reportUndeclaredTypes(checker, file, returns[i], parameters, parameterCount);
+    }
+
+    const TypeId type = complete ? functionType(checker->types, types, argCount, types + argCount, returnCount)
+                                 : TYPE_ID_NONE;
+    file->types[prototype] = type;
+    file->types[function] = type;
+    free(types);
+}
+
+static void structSignature(Checker *checker, const CheckedFile *file, const NodeIndex node) {
+    const Ast *ast = &file->results->ast;
+    file->types[node] = namedType(checker->types, file->results->namespace, astSymbol(ast, ast->data[node].a));
+
+    int fieldCount;
+    const uint32_t *fields = astList(ast, ast->extra[ast->data[node].b], &fieldCount);
+    for (int i = 0; i < fieldCount; ++i) {
+        const uint32_t field = ast->data[fields[i]].b;
+        const NodeIndex typeNode = ast->extra[field];
+        file->types[fields[i]] = typeNode != NODE_NONE ? resolveType(checker, file, nullptr, typeNode)
+                                                      : literalType(ast, ast->extra[field + 1]);
+    }
+}
+
+static void varSignature(Checker *checker, const CheckedFile *file, const NodeIndex node) {
+    const Ast *ast = &file->results->ast;
+    const uint32_t var = ast->data[node].a;
+    TypeId type = resolveType(checker, file, nullptr, ast->extra[var + 1]);
+    if (type == TYPE_ID_NONE) {
+        // Constants are worked out by now, MASK ::= 1 << 5 is as much an int as 32.
+        int valueCount;
+        const uint32_t *values = astList(ast, ast->extra[var + 2], &valueCount);
+        const Constant *known = valueCount > 0 ? findConstant(file->constants, values[0]) : nullptr;
+        if (known != nullptr) {
+            type = primitiveType(known->type);
+        } else if (valueCount > 0) {
+            type = literalType(ast, values[0]);
+        }
+    }
+    file->types[node] = type;
+}
+
+// Whether every namespace the file is using is part of the program, only then are its names all known. A use alone
+// doesn't bring names into scope, but the program leaves out nsl namespaces that don't exist yet.
+static bool usingsFound(const Checker *checker, const ParseResults *results) {
+    const Ast *ast = &results->ast;
+    for (NodeIndex node = 1; node < (NodeIndex)ast->count; ++node) {
+        if (astKind(ast, node) != UseNodeType || !(ast->extra[ast->data[node].b] & USE_USING)) {
+            continue;
+        }
+
+        // The namespace of math::random is random.
+        int len = 0;
+        const char *path = symbolName(checker->config->interner, astSymbol(ast, ast->data[node].a), &len);
+        const char *last = path;
+        for (int i = 0; i + 1 < len; ++i) {
+            if (path[i] == ':' && path[i + 1] == ':') {
+                last = path + i + 2;
+            }
+        }
+
+        const Symbol namespace = intern(checker->config->interner, last, (int)(path + len - last));
+        if (!isProgramNamespace(checker, namespace)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void signatureTask(void *arg) {
+    SignatureTask *task = (SignatureTask *)arg;
+    Checker *checker = task->checker;
+    CheckedFile *file = &checker->files[task->file];
+    const Ast *ast = &file->results->ast;
+    const uint64_t start = timer_now_ns();
+
+    file->complete = usingsFound(checker, file->results);
+
+    int declCount;
+    const uint32_t *decls = astList(ast, ast->decls, &declCount);
+    for (int i = 0; i < declCount; ++i) {
+        switch (astKind(ast, decls[i])) {
+            case FunctionNodeType:
+                functionSignature(checker, file, decls[i]);
+                break;
+            case StructNodeType:
+                structSignature(checker, file, decls[i]);
+                break;
+            case VarNodeType:
+                varSignature(checker, file, decls[i]);
+                break;
+            case ImplNodeType: {
+                int methodCount;
+                const uint32_t *methods = astList(ast, ast->data[decls[i]].b, &methodCount);
+                for (int j = 0; j < methodCount; ++j) {
+                    if (astKind(ast, methods[j]) == FunctionNodeType) {
+                        functionSignature(checker, file, methods[j]);
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    task->ns = timer_now_ns() - start;
+}
+
+// Bodies.
+
+static void reportIn(DiagnosticBuffer *buffer, const CheckedFile *file, const DiagnosticId id, const NodeIndex node,
+                     const char *arg0, const char *arg1, const char *arg2) {
+    reportDiagnostic(buffer, nullptr, SEVERITY_ERROR, id, file->results->ast.offsets[node], 0, arg0, arg1, arg2);
+}
+
+static void report(BodyCheck *body, const DiagnosticId id, const NodeIndex node, const char *arg0, const char *arg1,
+                   const char *arg2) {
+    reportIn(&body->diagnostics, body->file, id, node, arg0, arg1, arg2);
+}
+
+static void typeString(const BodyCheck *body, const TypeId type, StrBuffer *buf) {
+    str_buf_init(buf);
+    appendTypeName(body->checker->types, body->checker->config->interner, type, buf);
+}
+
+// value is nullptr for locals that aren't constants known at compile time.
+static void bind(BodyCheck *body, const Symbol name, const TypeId type, const bool constant, const Constant *value) {
+    if (body->bindingCount == body->bindingCapacity) {
+        body->bindings = (Binding *)array_grow(body->bindings, &body->bindingCapacity, sizeof(Binding));
+    }
+
+    Binding *binding = &body->bindings[body->bindingCount++];
+    binding->name = name;
+    binding->type = type;
+    binding->constant = constant;
+    binding->value.kind = CONST_NONE;
+    if (value != nullptr) {
+        binding->value = *value;
+    }
+}
+
+static const Binding *findBinding(const BodyCheck *body, const Symbol name) {
+    for (int i = body->bindingCount - 1; i >= 0; --i) {
+        if (body->bindings[i].name == name) {
+            return &body->bindings[i];
+        }
+    }
+
+    return nullptr;
+}
+
+// A top level declaration name can refer to from file: in its namespace, else outside any.
+static const Declaration *findTopLevel(const Checker *checker, const ParseResults *file, const Symbol name) {
+    const SymbolTable *symbols = checker->program->symbols;
+    const Declaration *found = lookupSymbol(symbols, file->namespace, name);
+    if (found == nullptr && file->namespace != SYMBOL_NONE) {
+        found = lookupSymbol(symbols, SYMBOL_NONE, name);
+    }
+
+    return found;
+}
+
+static const Declaration *findDeclaration(const BodyCheck *body, const Symbol name) {
+    return findTopLevel(body->checker, body->file->results, name);
+}
+
+// Constants.
+
+typedef enum {
+    CONSTANT_UNSEEN,
+    CONSTANT_ACTIVE, // Being evaluated, a constant naming it depends on itself.
+    CONSTANT_DONE,
+    CONSTANT_FAILED, // Its error is reported.
+} ConstantState;
+
+// Where the names of a constant expression are looked up: the locals of body if it is in one, then the top level.
+typedef struct {
+    Checker *checker;
+    const CheckedFile *file;
+    const BodyCheck *body;
+} ConstantScope;
+
+static bool lookupConstant(ConstEval *eval, NodeIndex name, Constant *value);
+
+static void initConstEval(ConstEval *eval, ConstantScope *scope) {
+    memset(eval, 0, sizeof(ConstEval));
+    eval->types = scope->checker->types;
+    eval->symbols = scope->checker->program->symbols;
+    eval->file = scope->file->results;
+    eval->interner = scope->checker->config->interner;
+    eval->lookup = lookupConstant;
+    eval->context = scope;
+}
+
+static TypeKind kindOf(const Checker *checker, const TypeId type) {
+    if (type == TYPE_ID_NONE) {
+        return TYPE_NONE;
+    }
+
+    const Type *t = typeOf(checker->types, type);
+    return t->form == FORM_PRIMITIVE ? (TypeKind)t->a : TYPE_NONE;
+}
+
+// Reports why eval failed on node, the value of the constant named what. Not being constant is only an error if what
+// isn't nullptr. Returns whether it reported anything.
+static bool reportConstant(const Checker *checker, DiagnosticBuffer *buffer, const CheckedFile *file,
+                           const ConstEval *eval, const NodeIndex node, const char *what) {
+    StrBuffer type;
+    str_buf_init(&type);
+    if (eval->type != TYPE_NONE) {
+        appendTypeName(checker->types, checker->config->interner, primitiveType(eval->type), &type);
+    }
+
+    bool reported = true;
+    switch (eval->status) {
+        case CONST_UNKNOWN:
+            if (what != nullptr) {
+                reportIn(buffer, file, DIAG_NOT_CONSTANT, node, what, nullptr, nullptr);
+            }
+            reported = what != nullptr;
+            break;
+        case CONST_OVERFLOW: {
+            NodeIndex literal = eval->node;
+            while (astKind(&file->results->ast, literal) == NegNodeType) {
+                literal = file->results->ast.data[literal].a;
+            }
+            const NodeKind kind = astKind(&file->results->ast, literal);
+            const DiagnosticId id = kind == IntNodeType || kind == CharNodeType ? DIAG_LITERAL_RANGE
+                                                                                 : DIAG_CONSTANT_OVERFLOW;
+            reportIn(buffer, file, id, eval->node, type.len > 0 ? type.data : "its type", nullptr, nullptr);
+            break;
+        }
+        case CONST_DIVIDE_BY_ZERO:
+            reportIn(buffer, file, DIAG_DIVIDE_BY_ZERO, eval->node, nullptr, nullptr, nullptr);
+            break;
+        case CONST_SHIFT_RANGE:
+            reportIn(buffer, file, DIAG_SHIFT_RANGE, eval->node, type.len > 0 ? type.data : "its type", nullptr,
+                     nullptr);
+            break;
+        default:
+            reported = false;
+            break;
+    }
+    str_buf_free(&type);
+
+    return reported;
+}
+
+// The node of the value var, a VarNodeType, gives the name, NODE_NONE if they don't pair up.
+static NodeIndex valueOfName(const Ast *ast, const NodeIndex var, const Symbol name) {
+    const uint32_t extra = ast->data[var].a;
+    int valueCount;
+    const uint32_t *values = astList(ast, ast->extra[extra + 2], &valueCount);
+    int nameCount;
+    const uint32_t *names = astList(ast, ast->extra[extra + 3], &nameCount);
+    for (int i = 0; i < nameCount && valueCount == nameCount; ++i) {
+        if (astSymbol(ast, names[i]) == name) {
+            return values[i];
+        }
+    }
+
+    return NODE_NONE;
+}
+
+// Works out the values of node, a top level const or val declaration, once, and first the constants they name.
+static void evaluateGlobal(Checker *checker, const CheckedFile *file, const NodeIndex node) {
+    if (file->constantStates[node] != CONSTANT_UNSEEN) {
+        return;
+    }
+    file->constantStates[node] = CONSTANT_ACTIVE;
+
+    const Ast *ast = &file->results->ast;
+    const uint32_t var = ast->data[node].a;
+    const bool required = ast->extra[var] == VAR_CONST;
+    const TypeKind declared = kindOf(checker, typeFromNode(checker->types, checker->program->symbols, file->results,
+                                                           ast->extra[var + 1]));
+    int valueCount;
+    const uint32_t *values = astList(ast, ast->extra[var + 2], &valueCount);
+    int nameCount;
+    const uint32_t *names = astList(ast, ast->extra[var + 3], &nameCount);
+
+    ConstantScope scope = {checker, file, nullptr};
+    ConstEval eval;
+    initConstEval(&eval, &scope);
+    bool failed = false;
+    for (int i = 0; i < nameCount; ++i) {
+        const char *name = required ? symbolName(checker->config->interner, astSymbol(ast, names[i]), nullptr)
+                                    : nullptr;
+        if (valueCount != nameCount) {
+            eval.status = CONST_UNKNOWN;
+            failed = valueCount > 0 && reportConstant(checker, file->diagnostics, file, &eval, node, name);
+            continue;
+        }
+
+        Constant value;
+        if (evaluateConstant(&eval, values[i], declared, &value) &&
+            convertConstant(&eval, values[i], declared, &value)) {
+            addConstant(file->constants, values[i], &value);
+        } else if (reportConstant(checker, file->diagnostics, file, &eval, values[i], name) ||
+                   eval.status == CONST_REPORTED) {
+            failed = true;
+        }
+    }
+    file->constantStates[node] = failed ? CONSTANT_FAILED : CONSTANT_DONE;
+}
+
+static bool notConstant(ConstEval *eval, const ConstStatus status, const NodeIndex node) {
+    eval->status = status;
+    eval->node = node;
+    eval->type = TYPE_NONE;
+    return false;
+}
+
+static bool lookupConstant(ConstEval *eval, const NodeIndex node, Constant *value) {
+    const ConstantScope *scope = (const ConstantScope *)eval->context;
+    Checker *checker = scope->checker;
+    const Ast *ast = &scope->file->results->ast;
+    const Symbol name = astSymbol(ast, ast->data[node].a);
+
+    if (scope->body != nullptr) {
+        const Binding *binding = findBinding(scope->body, name);
+        if (binding != nullptr) {
+            if (binding->value.kind == CONST_NONE) {
+                return notConstant(eval, CONST_UNKNOWN, node);
+            }
+            *value = binding->value;
+            return true;
+        }
+    }
+
+    const Declaration *decl = findTopLevel(checker, scope->file->results, name);
+    if (decl == nullptr || decl->kind != DECL_VARIABLE || decl->next != nullptr) {
+        return notConstant(eval, CONST_UNKNOWN, node);
+    }
+
+    const CheckedFile *file = fileOf(checker, decl->file);
+    const Ast *declAst = &decl->file->ast;
+    if (file->constantStates == nullptr || declAst->extra[declAst->data[decl->node].a] == VAR_LET) {
+        return notConstant(eval, CONST_UNKNOWN, node);
+    }
+
+    evaluateGlobal(checker, file, decl->node);
+    if (file->constantStates[decl->node] == CONSTANT_FAILED) {
+        return notConstant(eval, CONST_REPORTED, node);
+    }
+
+    const Constant *found = findConstant(file->constants, valueOfName(declAst, decl->node, name));
+    if (found == nullptr) {
+        return notConstant(eval, CONST_UNKNOWN, node);
+    }
+    *value = *found;
+    return true;
+}
+
+// Top level constants are worked out before signatures, whose array sizes can name them, in declaration order.
+static void evaluateGlobals(Checker *checker) {
+    for (int i = 0; i < checker->program->fileCount; ++i) {
+        CheckedFile *file = &checker->files[i];
+        const Ast *ast = &file->results->ast;
+        int declCount;
+        const uint32_t *decls = astList(ast, ast->decls, &declCount);
+        for (int j = 0; j < declCount && file->constantStates == nullptr; ++j) {
+            if (astKind(ast, decls[j]) == VarNodeType && ast->extra[ast->data[decls[j]].a] != VAR_LET) {
+                file->constantStates = (uint8_t *)calloc(ast->count + 1, sizeof(uint8_t));
+            }
+        }
+    }
+
+    for (int i = 0; i < checker->program->fileCount; ++i) {
+        const CheckedFile *file = &checker->files[i];
+        const Ast *ast = &file->results->ast;
+        int declCount;
+        const uint32_t *decls = astList(ast, ast->decls, &declCount);
+        for (int j = 0; j < declCount && file->constantStates != nullptr; ++j) {
+            if (astKind(ast, decls[j]) == VarNodeType && ast->extra[ast->data[decls[j]].a] != VAR_LET) {
+                evaluateGlobal(checker, file, decls[j]);
+            }
+        }
+    }
+}
+
+static uint32_t arrayLength(Checker *checker, const CheckedFile *file, BodyCheck *body, const NodeIndex size) {
+    ConstantScope scope = {checker, file, body};
+    ConstEval eval;
+    initConstEval(&eval, &scope);
+    DiagnosticBuffer *diagnostics = body != nullptr ? &body->diagnostics : file->diagnostics;
+
+    Constant value;
+    int64_t length = -1;
+    if (evaluateConstant(&eval, size, TYPE_NONE, &value)) {
+        constantInt64(&value, &length);
+    } else if (eval.status != CONST_UNKNOWN) {
+        reportConstant(checker, diagnostics, file, &eval, size, nullptr);
+        return ARRAY_LENGTH_UNKNOWN;
+    }
+
+    if (length < 0 || length >= ARRAY_LENGTH_UNKNOWN) {
+        reportIn(diagnostics, file, DIAG_ARRAY_SIZE, size, nullptr, nullptr, nullptr);
+        return ARRAY_LENGTH_UNKNOWN;
+    }
+    return (uint32_t)length;
+}
+
+// The value of a local constant declaration's value node, CONST_NONE if it isn't known at compile time. Required
+// constants name themselves what.
+static Constant localConstant(BodyCheck *body, const NodeIndex value, const TypeKind declared, const char *what) {
+    ConstantScope scope = {body->checker, body->file, body};
+    ConstEval eval;
+    initConstEval(&eval, &scope);
+
+    Constant result;
+    if (evaluateConstant(&eval, value, declared, &result) && convertConstant(&eval, value, declared, &result)) {
+        addConstant(&body->constants, value, &result);
+        return result;
+    }
+
+    reportConstant(body->checker, &body->diagnostics, body->file, &eval, value, what);
+    result.kind = CONST_NONE;
+    return result;
+}
+
+// Whether node is only number literals and arithmetic on them, like 1 << 40 or -1.
+static bool isLiteralExpression(const Ast *ast, const NodeIndex node) {
+    const NodeKind kind = astKind(ast, node);
+    const NodeData data = ast->data[node];
+    switch (kind) {
+        case IntNodeType:
+        case FloatNodeType:
+        case CharNodeType:
+            return true;
+        case NegNodeType:
+        case BitNotNodeType:
+            return isLiteralExpression(ast, data.a);
+        default:
+            return kind >= AddNodeType && kind <= BitXorNodeType && isLiteralExpression(ast, data.a) &&
+                   isLiteralExpression(ast, data.b);
+    }
+}
+
+// Gives the literals of node, and the operators on them, type. Shift amounts keep theirs.
+static void setLiteralTypes(BodyCheck *body, const NodeIndex node, const TypeId type) {
+    const Ast *ast = &body->file->results->ast;
+    const NodeKind kind = astKind(ast, node);
+    body->file->types[node] = type;
+    if (kind == NegNodeType || kind == BitNotNodeType) {
+        setLiteralTypes(body, ast->data[node].a, type);
+    } else if (kind >= AddNodeType && kind <= BitXorNodeType) {
+        setLiteralTypes(body, ast->data[node].a, type);
+        if (kind != ShlNodeType && kind != ShrNodeType && kind != ShlSatNodeType) {
+            setLiteralTypes(body, ast->data[node].b, type);
+        }
+    }
+}
+
+// Gives the literal expression at index at of the body's literals the number type it is used as, or its own, and
+// reports a value that doesn't fit like a constant's, if report is set. So x: u64 = 5000000000 + 1 is a u64 sum, and
+// 1 << 40 where an int goes is an error rather than a value truncated to 32 bits.
+static void typeLiteralsAt(BodyCheck *body, const int at, const TypeId type, const bool report) {
+    const NodeIndex node = body->literals[at].node;
+    for (int i = body->literals[at].start; i <= at; ++i) {
+        body->literals[i].node = NODE_NONE;
+    }
+
+    TypeKind kind = kindOf(body->checker, type);
+    if (!isIntegerKind(kind) && !isFloatKind(kind)) {
+        kind = TYPE_NONE;
+    }
+    ConstantScope scope = {body->checker, body->file, body};
+    ConstEval eval;
+    initConstEval(&eval, &scope);
+    Constant value;
+    if (!evaluateConstant(&eval, node, kind, &value)) {
+        if (report) {
+            reportConstant(body->checker, &body->diagnostics, body->file, &eval, node, nullptr);
+        }
+        return;
+    }
+    if (kind != TYPE_NONE) {
+        setLiteralTypes(body, node, type);
+    }
+}
+
+// typeLiteralsAt for node if it is a literal expression that has no type yet.
+static void typeLiterals(BodyCheck *body, const NodeIndex node, const TypeId type, const bool report) {
+    for (int at = body->literalCount - 1; at >= 0; --at) {
+        if (body->literals[at].node == node) {
+            typeLiteralsAt(body, at, type, report);
+            return;
+        }
+    }
+}
+
+// Type of a declaration used as a value. Overloaded names and types used as values have none yet.
+static TypeId declarationType(const BodyCheck *body, const Declaration *decl) {
+    if (decl == nullptr || decl->next != nullptr) {
+        return TYPE_ID_NONE;
+    }
+
+    switch (decl->kind) {
+        case DECL_FUNCTION:
+        case DECL_METHOD:
+        case DECL_VARIABLE:
+            return fileOf(body->checker, decl->file)->types[decl->node];
+        default:
+            return TYPE_ID_NONE;
+    }
+}
+
+static bool isTypeParameter(const BodyCheck *body, const Symbol name) {
+    const Ast *ast = &body->file->results->ast;
+    for (int i = 0; i < body->parameterCount; ++i) {
+        if (astSymbol(ast, body->parameters[i]) == name) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static TypeId fieldType(const Checker *checker, const Declaration *structDecl, const Symbol name) {
+    const Ast *ast = &structDecl->file->ast;
+    int fieldCount;
+    const uint32_t *fields = astList(ast, ast->extra[ast->data[structDecl->node].b], &fieldCount);
+    for (int i = 0; i < fieldCount; ++i) {
+        if (astSymbol(ast, ast->data[fields[i]].a) == name) {
+            return fileOf(checker, structDecl->file)->types[fields[i]];
+        }
+    }
+
+    return TYPE_ID_NONE;
+}
+
+// Type of the field name of a value of type, through one pointer. Fields of generic structs have their type arguments
+// filled in.
+static TypeId memberType(Checker *checker, TypeId type, const Symbol name) {
+    if (type == TYPE_ID_NONE) {
+        return TYPE_ID_NONE;
+    }
+
+    const Type *t = typeOf(checker->types, type);
+    if (t->form == FORM_POINTER) {
+        type = t->a;
+        t = typeOf(checker->types, type);
+    }
+
+    const Type *named = t->form == FORM_GENERIC ? typeOf(checker->types, t->a) : t;
+    if (named->form != FORM_NAMED) {
+        return TYPE_ID_NONE;
+    }
+
+    const Declaration *decl = findStruct(checker, named->b, named->a);
+    if (decl == nullptr) {
+        return TYPE_ID_NONE;
+    }
+
+    const TypeId field = fieldType(checker, decl, name);
+    const Ast *ast = &decl->file->ast;
+    int parameterCount;
+    const uint32_t *parameters = astList(ast, ast->extra[ast->data[decl->node].b + 1], &parameterCount);
+    if (t->form != FORM_GENERIC || parameterCount != (int)t->count) {
+        return t->form == FORM_GENERIC || parameterCount > 0 ? TYPE_ID_NONE : field;
+    }
+
+    TypeId small[8];
+    TypeId *from = parameterCount <= 8 ? small : (TypeId *)malloc(sizeof(TypeId) * parameterCount);
+    for (int i = 0; i < parameterCount; ++i) {
+        from[i] = namedType(checker->types, decl->namespace, astSymbol(ast, parameters[i]));
+    }
+    const TypeId substituted = substituteType(checker->types, field, from, t->items, parameterCount);
+    if (from != small) {
+        free(from);
+    }
+
+    return substituted;
+}
+
+typedef enum {
+    CATEGORY_UNKNOWN, // Could be anything until more of the language is checked.
+    CATEGORY_NUMBER,
+    CATEGORY_BOOL,
+    CATEGORY_STRING,
+    CATEGORY_POINTER,
+    CATEGORY_SLICE,
+    CATEGORY_ARRAY,
+    CATEGORY_STRUCT,
+    CATEGORY_VOID,
+} Category;
+
+static Category categoryOf(const Checker *checker, const TypeId type) {
+    if (type == TYPE_ID_NONE) {
+        return CATEGORY_UNKNOWN;
+    }
+
+    const Type *t = typeOf(checker->types, type);
+    switch (t->form) {
+        case FORM_PRIMITIVE:
+            switch ((TypeKind)t->a) {
+                case TYPE_B8: case TYPE_B16: case TYPE_B32: case TYPE_B64: return CATEGORY_BOOL;
+                case TYPE_STRING: return CATEGORY_STRING;
+                case TYPE_TYPE_ID: case TYPE_ANY: return CATEGORY_UNKNOWN;
+                case TYPE_VOID: return CATEGORY_VOID;
+                default: return CATEGORY_NUMBER;
+            }
+        case FORM_POINTER:
+        case FORM_MANY_POINTER:
+        case FORM_FUNCTION:
+            return CATEGORY_POINTER;
+        case FORM_SLICE:
+        case FORM_VARIADIC:
+            return CATEGORY_SLICE;
+        case FORM_ARRAY:
+            return CATEGORY_ARRAY;
+        case FORM_NAMED:
+            // Type parameters and aliases aren't known yet.
+            return findStruct(checker, t->b, t->a) != nullptr ? CATEGORY_STRUCT : CATEGORY_UNKNOWN;
+        default:
+            return CATEGORY_UNKNOWN;
+    }
+}
+
+static bool isLiteral(const Ast *ast, NodeIndex node) {
+    while (astKind(ast, node) == NegNodeType) {
+        node = ast->data[node].a;
+    }
+    const NodeKind kind = astKind(ast, node);
+    return kind == IntNodeType || kind == FloatNodeType || kind == CharNodeType;
+}
+
+// Whether a value of type from, from the node value, can be given where to is expected.
+static bool assignable(const BodyCheck *body, const TypeId to, const TypeId from, const NodeIndex value) {
+    const Checker *checker = body->checker;
+    const Ast *ast = &body->file->results->ast;
+    if (to == TYPE_ID_NONE || to == from) {
+        return true;
+    }
+
+    const Category toCategory = categoryOf(checker, to);
+    if (astKind(ast, value) == NullNodeType) {
+        return toCategory != CATEGORY_NUMBER && toCategory != CATEGORY_BOOL && toCategory != CATEGORY_STRING &&
+               toCategory != CATEGORY_STRUCT;
+    }
+    if (from == TYPE_ID_NONE) {
+        return true;
+    }
+
+    const Type *t = typeOf(checker->types, to);
+    if (t->form == FORM_OPTIONAL) {
+        return assignable(body, t->a, from, value) || typeOf(checker->types, from)->form == FORM_OPTIONAL;
+    }
+    if (t->form == FORM_UNION) {
+        for (uint32_t i = 0; i < t->count; ++i) {
+            if (assignable(body, t->items[i], from, value)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // A string literal for a cstring.
+    if (t->form == FORM_MANY_POINTER && t->a == primitiveType(TYPE_U8) && from == primitiveType(TYPE_STRING)) {
+        return true;
+    }
+
+    const Category fromCategory = categoryOf(checker, from);
+    if (toCategory == CATEGORY_UNKNOWN || fromCategory == CATEGORY_UNKNOWN) {
+        return true;
+    }
+    if (isLiteral(ast, value) && toCategory == CATEGORY_NUMBER) {
+        return true;
+    }
+    if (toCategory == CATEGORY_BOOL && fromCategory == CATEGORY_NUMBER) {
+        return true; // Zero is false, like the spec's isEven.
+    }
+
+    return toCategory == fromCategory && (toCategory != CATEGORY_STRUCT || to == from);
+}
+
+static void expectAssignable(BodyCheck *body, const TypeId to, const TypeId from, const NodeIndex value) {
+    if (assignable(body, to, from, value)) {
+        return;
+    }
+
+    StrBuffer expected;
+    typeString(body, to, &expected);
+    StrBuffer got;
+    if (astKind(&body->file->results->ast, value) == NullNodeType) {
+        str_buf_init(&got);
+        str_buf_append(&got, "null");
+    } else {
+        typeString(body, from, &got);
+    }
+
+    report(body, DIAG_TYPE_MISMATCH, value, expected.data, got.data, nullptr);
+    str_buf_free(&expected);
+    str_buf_free(&got);
+}
+
+static TypeId checkExpression(BodyCheck *body, NodeIndex node);
+static void checkStatement(BodyCheck *body, NodeIndex node);
+
+static TypeId checkName(BodyCheck *body, const NodeIndex node) {
+    const Ast *ast = &body->file->results->ast;
+    const Symbol name = astSymbol(ast, ast->data[node].a);
+
+    const Binding *binding = findBinding(body, name);
+    if (binding != nullptr) {
+        return binding->type;
+    }
+
+    const Declaration *decl = findDeclaration(body, name);
+    if (decl != nullptr) {
+        return declarationType(body, decl);
+    }
+
+    if (body->impl != SYMBOL_NONE) {
+        // A field of the receiver, else maybe one from its behaviors.
+        const Declaration *structDecl = findStruct(body->checker, body->file->results->namespace, body->impl);
+        return structDecl != nullptr ? fieldType(body->checker, structDecl, name) : TYPE_ID_NONE;
+    }
+
+    if (body->file->complete && lookupSymbol(body->checker->program->symbols, NAMESPACE_ANY, name) == nullptr &&
+        !isBuiltin(body->checker, name) && !isTypeParameter(body, name) &&
+        !isProgramNamespace(body->checker, name)) {
+        report(body, DIAG_UNDECLARED, node, symbolName(body->checker->config->interner, name, nullptr), nullptr,
+               nullptr);
+    }
+
+    return TYPE_ID_NONE;
+}
+
+// The function a call names directly, nullptr for anything else or a name that is overloaded.
+static const Declaration *callTarget(const BodyCheck *body, const NodeIndex callee) {
+    const Ast *ast = &body->file->results->ast;
+    const Declaration *decl = nullptr;
+    if (astKind(ast, callee) == IdentNodeType) {
+        const Symbol name = astSymbol(ast, ast->data[callee].a);
+        decl = findBinding(body, name) == nullptr ? findDeclaration(body, name) : nullptr;
+    } else if (astKind(ast, callee) == ScopeNodeType && astKind(ast, ast->data[callee].a) == IdentNodeType) {
+        decl = lookupSymbol(body->checker->program->symbols, astSymbol(ast, ast->data[ast->data[callee].a].a),
+                            astSymbol(ast, ast->data[callee].b));
+    }
+
+    return decl != nullptr && decl->kind == DECL_FUNCTION && decl->next == nullptr ? decl : nullptr;
+}
+
+// Binds the type parameters in parameter to the parts of argument they stand for.
+static void inferArguments(const Checker *checker, const TypeId parameter, const TypeId argument, const TypeId *from,
+                           TypeId *to, const int count) {
+    if (parameter == TYPE_ID_NONE || argument == TYPE_ID_NONE) {
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (parameter == from[i]) {
+            if (to[i] == TYPE_ID_NONE) {
+                to[i] = argument;
+            }
+            return;
+        }
+    }
+
+    const Type *p = typeOf(checker->types, parameter);
+    const Type *a = typeOf(checker->types, argument);
+    if (p->form == FORM_VARIADIC && a->form != FORM_VARIADIC && a->form != FORM_SLICE) {
+        inferArguments(checker, p->a, argument, from, to, count);
+    } else if (p->form == FORM_SLICE && a->form == FORM_ARRAY) {
+        inferArguments(checker, p->a, a->a, from, to, count);
+    } else if (p->form == a->form && (p->form == FORM_POINTER || p->form == FORM_MANY_POINTER ||
+                                      p->form == FORM_SLICE || p->form == FORM_ARRAY || p->form == FORM_VARIADIC ||
+                                      p->form == FORM_OPTIONAL)) {
+        inferArguments(checker, p->a, a->a, from, to, count);
+    } else if (p->form == FORM_GENERIC && a->form == FORM_GENERIC && p->a == a->a && p->count == a->count) {
+        for (uint32_t i = 0; i < p->count; ++i) {
+            inferArguments(checker, p->items[i], a->items[i], from, to, count);
+        }
+    }
+}
+
+// Checks a call of a generic function, recording the instance its arguments ask for. Returns its return type.
+static TypeId checkGenericCall(BodyCheck *body, const Declaration *target, const TypeId *args, const int argCount) {
+    Checker *checker = body->checker;
+    const Ast *ast = &target->file->ast;
+    const TypeId signature = fileOf(checker, target->file)->types[target->node];
+    if (signature == TYPE_ID_NONE) {
+        return TYPE_ID_NONE;
+    }
+
+    const NodeIndex prototype = ast->data[target->node].a;
+    int parameterCount;
+    const uint32_t *parameters = astList(ast, ast->extra[ast->data[prototype].b + 2], &parameterCount);
+    TypeId *from = (TypeId *)malloc(sizeof(TypeId) * parameterCount * 2);
+    TypeId *to = from + parameterCount;
+    for (int i = 0; i < parameterCount; ++i) {
+        from[i] = namedType(checker->types, target->namespace, astSymbol(ast, parameters[i]));
+        to[i] = TYPE_ID_NONE;
+    }
+
+    const Type *fn = typeOf(checker->types, signature);
+    for (int i = 0; i < argCount && fn->a > 0; ++i) {
+        inferArguments(checker, fn->items[min(i, (int)fn->a - 1)], args[i], from, to, parameterCount);
+    }
+
+    // Arguments that are still type parameters of the caller give no instance.
+    bool bound = true;
+    for (int i = 0; i < parameterCount; ++i) {
+        bound = bound && isConcrete(checker, to[i]);
+    }
+
+    TypeId result = TYPE_ID_NONE;
+    if (bound) {
+        const TypeId instance = substituteType(checker->types, signature, from, to, parameterCount);
+        const TypeId key = genericType(checker->types, namedType(checker->types, target->namespace, target->name), to,
+                                       parameterCount);
+        addInstance(checker, target, key, instance);
+        requestInstances(checker, instance);
+
+        const Type *instanceFn = typeOf(checker->types, instance);
+        result = instanceFn->count - instanceFn->a == 1 ? instanceFn->items[instanceFn->a] : TYPE_ID_NONE;
+    }
+    free(from);
+
+    return result;
+}
+
+static void checkArgumentCount(BodyCheck *body, const NodeIndex call, const Declaration *target, const int positional,
+                               const bool named) {
+    const Ast *ast = &target->file->ast;
+    const NodeIndex prototype = ast->data[target->node].a;
+    int paramCount;
+    const uint32_t *params = astList(ast, ast->extra[ast->data[prototype].b], &paramCount);
+
+    int required = 0;
+    bool variadic = false;
+    for (int i = 0; i < paramCount; ++i) {
+        const uint32_t arg = ast->data[params[i]].b;
+        variadic = astKind(ast, ast->extra[arg]) == VariadicTypeNodeType;
+        required += ast->extra[arg + 1] == NODE_NONE && !variadic ? 1 : 0;
+    }
+
+    const bool tooFew = positional < required && !named;
+    const bool tooMany = positional > paramCount && !variadic;
+    if (!tooFew && !tooMany) {
+        return;
+    }
+
+    char expected[32];
+    if (variadic) {
+        sprintf(expected, "at least %d", required);
+    } else if (required < paramCount) {
+        sprintf(expected, "%d to %d", required, paramCount);
+    } else {
+        sprintf(expected, "%d", paramCount);
+    }
+    char got[16];
+    sprintf(got, "%d", positional);
+    report(body, DIAG_ARGUMENT_COUNT, call, symbolName(body->checker->config->interner, target->name, nullptr),
+           expected, got);
+}
+
+// The type cast(x, T) and T(x) convert to, TYPE_ID_NONE for every other call.
+static TypeId conversionType(const BodyCheck *body, const NodeIndex node) {
+    const Ast *ast = &body->file->results->ast;
+    const NodeData data = ast->data[node];
+    if (astKind(ast, data.a) != IdentNodeType || findBinding(body, astSymbol(ast, ast->data[data.a].a)) != nullptr) {
+        return TYPE_ID_NONE;
+    }
+
+    int argCount;
+    const uint32_t *args = astList(ast, data.b, &argCount);
+    int len = 0;
+    const char *name = symbolName(body->checker->config->interner, astSymbol(ast, ast->data[data.a].a), &len);
+    const NiftyTokenType keyword = keywordType(name, len);
+    NodeIndex type;
+    if (keyword == TK_CAST && argCount == 2) {
+        type = args[1];
+    } else if (keyword >= TK_INT && keyword <= TK_ANY_TYPE && argCount == 1) {
+        type = data.a;
+    } else {
+        return TYPE_ID_NONE;
+    }
+    return typeFromNode(body->checker->types, body->checker->program->symbols, body->file->results, type);
+}
+
+static TypeId checkCall(BodyCheck *body, const NodeIndex node) {
+    const Ast *ast = &body->file->results->ast;
+    const NodeData data = ast->data[node];
+    const Declaration *target = callTarget(body, data.a);
+    const TypeId callee = target != nullptr ? declarationType(body, target) : checkExpression(body, data.a);
+    body->file->types[data.a] = callee;
+
+    int argCount;
+    const uint32_t *argList = astList(ast, data.b, &argCount);
+    TypeId *args = (TypeId *)malloc(sizeof(TypeId) * (argCount + 1));
+    int positional = 0;
+    bool named = false;
+    for (int i = 0; i < argCount; ++i) {
+        const NodeIndex arg = argList[i];
+        if (astKind(ast, arg) == NamedArgNodeType) {
+            named = true;
+            checkExpression(body, ast->data[arg].b);
+        } else {
+            args[positional++] = checkExpression(body, arg);
+        }
+    }
+
+    TypeId result = TYPE_ID_NONE;
+    const TypeId converted = conversionType(body, node);
+    if (converted != TYPE_ID_NONE) {
+        // A literal converted is taken as the type, like cast(1 << 40, u64) is 1 << 40 of u64.
+        typeLiterals(body, argList[0], converted, true);
+        result = converted;
+    } else if (target != nullptr) {
+        checkArgumentCount(body, node, target, positional, named);
+
+        const Ast *targetAst = &target->file->ast;
+        const uint32_t signature = targetAst->data[targetAst->data[target->node].a].b;
+        if (targetAst->extra[targetAst->extra[signature + 2]] > 0) {
+            result = checkGenericCall(body, target, args, positional);
+        } else if (callee != TYPE_ID_NONE) {
+            const Type *fn = typeOf(body->checker->types, callee);
+            for (int i = 0, p = 0; i < argCount && p < (int)fn->a; ++i) {
+                if (astKind(ast, argList[i]) == NamedArgNodeType) {
+                    continue;
+                }
+                if (typeOf(body->checker->types, fn->items[p])->form != FORM_VARIADIC) {
+                    expectAssignable(body, fn->items[p], args[p], argList[i]);
+                    typeLiterals(body, argList[i], fn->items[p], true);
+                }
+                ++p;
+            }
+            result = fn->count - fn->a == 1 ? fn->items[fn->a] : TYPE_ID_NONE;
+        }
+    } else if (callee != TYPE_ID_NONE && typeOf(body->checker->types, callee)->form == FORM_FUNCTION) {
+        const Type *fn = typeOf(body->checker->types, callee);
+        result = fn->count - fn->a == 1 ? fn->items[fn->a] : TYPE_ID_NONE;
+    }
+    free(args);
+
+    return result;
+}
+
+static bool isConstant(const BodyCheck *body, const NodeIndex target) {
+    const Ast *ast = &body->file->results->ast;
+    if (astKind(ast, target) != IdentNodeType) {
+        return false;
+    }
+
+    const Symbol name = astSymbol(ast, ast->data[target].a);
+    const Binding *binding = findBinding(body, name);
+    if (binding != nullptr) {
+        return binding->constant;
+    }
+
+    const Declaration *decl = findDeclaration(body, name);
+    if (decl == nullptr || decl->kind != DECL_VARIABLE) {
+        return false;
+    }
+
+    const Ast *declAst = &decl->file->ast;
+    return declAst->extra[declAst->data[decl->node].a] != VAR_LET;
+}
+
+static void checkAssignTarget(BodyCheck *body, const NodeIndex target) {
+    if (isConstant(body, target)) {
+        const Ast *ast = &body->file->results->ast;
+        report(body, DIAG_ASSIGN_CONSTANT, target,
+               symbolName(body->checker->config->interner, astSymbol(ast, ast->data[target].a), nullptr), nullptr,
+               nullptr);
+    }
+}
+
+static bool isNumber(const Checker *checker, const TypeId type) {
+    return categoryOf(checker, type) == CATEGORY_NUMBER;
+}
+
+static TypeId checkBinary(BodyCheck *body, const NodeIndex node) {
+    const Ast *ast = &body->file->results->ast;
+    const NodeData data = ast->data[node];
+    const NodeKind kind = astKind(ast, node);
+    const TypeId left = checkExpression(body, data.a);
+    const TypeId right = checkExpression(body, data.b);
+
+    // A literal takes the type of the other side, in arithmetic and comparisons, but for shift amounts.
+    TypeId operands = left == right ? left : TYPE_ID_NONE;
+    if (kind >= AddNodeType && kind <= GtEqNodeType) {
+        const bool shift = kind == ShlNodeType || kind == ShrNodeType || kind == ShlSatNodeType;
+        const bool literalLeft = isLiteralExpression(ast, data.a);
+        const bool literalRight = isLiteralExpression(ast, data.b);
+        if (literalRight && !literalLeft && isNumber(body->checker, left)) {
+            if (!shift) {
+                typeLiterals(body, data.b, left, true);
+            }
+            operands = left;
+        } else if (literalLeft && !literalRight && isNumber(body->checker, right)) {
+            typeLiterals(body, data.a, right, true);
+            operands = right;
+        }
+    }
+
+    switch (kind) {
+        case EqNodeType: case NotEqNodeType: case LtNodeType: case LtEqNodeType: case GtNodeType: case GtEqNodeType:
+        case AndNodeType: case OrNodeType:
+            return primitiveType(TYPE_B32);
+        case NullCoalesceNodeType: {
+            const TypeId element = left != TYPE_ID_NONE && typeOf(body->checker->types, left)->form == FORM_OPTIONAL
+                                       ? typeOf(body->checker->types, left)->a
+                                       : TYPE_ID_NONE;
+            return element != TYPE_ID_NONE ? element : right;
+        }
+        case RangeOpenNodeType:
+        case RangeClosedNodeType:
+            return TYPE_ID_NONE;
+        default:
+            return operands;
+    }
+}
+
+static TypeId elementOf(const Checker *checker, const TypeId type) {
+    if (type == TYPE_ID_NONE) {
+        return TYPE_ID_NONE;
+    }
+
+    const Type *t = typeOf(checker->types, type);
+    switch (t->form) {
+        case FORM_MANY_POINTER:
+        case FORM_SLICE:
+        case FORM_ARRAY:
+        case FORM_VARIADIC:
+            return t->a;
+        default:
+            return TYPE_ID_NONE;
+    }
+}
+
+static TypeId checkExpression(BodyCheck *body, const NodeIndex node) {
+    Checker *checker = body->checker;
+    const Ast *ast = &body->file->results->ast;
+    const NodeData data = ast->data[node];
+    const int literals = body->literalCount;
+
+    TypeId type = TYPE_ID_NONE;
+    switch (astKind(ast, node)) {
+        case IntNodeType:
+        case FloatNodeType:
+        case StringNodeType:
+        case CharNodeType:
+        case BoolNodeType:
+            type = literalType(ast, node);
+            break;
+        case IdentNodeType:
+            type = checkName(body, node);
+            break;
+        case ScopeNodeType:
+            // ns::x and Type::x, anything else on the left is an expression.
+            if (astKind(ast, data.a) == IdentNodeType) {
+                const Declaration *decl = lookupSymbol(checker->program->symbols,
+                                                       astSymbol(ast, ast->data[data.a].a), astSymbol(ast, data.b));
+                type = declarationType(body, decl);
+            } else {
+                checkExpression(body, data.a);
+            }
+            break;
+        case CallNodeType:
+        case InlineCallNodeType:
+            type = checkCall(body, node);
+            break;
+        case NamedArgNodeType:
+            checkExpression(body, data.b);
+            break;
+        case IndexNodeType: {
+            const TypeId base = checkExpression(body, data.a);
+            checkExpression(body, data.b);
+            type = elementOf(checker, base);
+            break;
+        }
+        case MemberNodeType:
+        case PointerMemberNodeType:
+            type = memberType(checker, checkExpression(body, data.a), astSymbol(ast, data.b));
+            break;
+        case ArrayLitNodeType: {
+            int count;
+            const uint32_t *items = astList(ast, data.a, &count);
+            TypeId element = TYPE_ID_NONE;
+            for (int i = 0; i < count; ++i) {
+                const TypeId item = checkExpression(body, items[i]);
+                element = i == 0 || item == element ? item : TYPE_ID_NONE;
+            }
+            type = count > 0 ? arrayType(checker->types, element, (uint32_t)count) : TYPE_ID_NONE;
+            break;
+        }
+        case StructLitNodeType: {
+            int count;
+            const uint32_t *fields = astList(ast, data.b, &count);
+            for (int i = 0; i < count; ++i) {
+                checkExpression(body, fields[i]);
+            }
+            if (astKind(ast, data.a) == IdentNodeType) {
+                const Symbol name = astSymbol(ast, ast->data[data.a].a);
+                const Declaration *decl = findDeclaration(body, name);
+                type = decl != nullptr && decl->kind == DECL_STRUCT
+                           ? namedType(checker->types, decl->namespace, name)
+                           : checkName(body, data.a);
+            } else {
+                checkExpression(body, data.a);
+            }
+            break;
+        }
+        case NewNodeType: {
+            const NodeKind kind = astKind(ast, data.a);
+            if (kind == ArrayTypeNodeType) {
+                // new [n]T is a dynamic array of capacity n, which needn't be known at compile time.
+                const NodeIndex size = ast->data[data.a].b;
+                const TypeId element = resolveType(checker, body->file, body, ast->data[data.a].a);
+                expectAssignable(body, primitiveType(TYPE_S32), checkExpression(body, size), size);
+                typeLiterals(body, size, primitiveType(TYPE_S32), true);
+                type = element != TYPE_ID_NONE ? sliceType(checker->types, element) : TYPE_ID_NONE;
+                break;
+            }
+            const TypeId value = kind >= NamedTypeNodeType && kind <= UnionTypeNodeType
+                                     ? resolveType(checker, body->file, body, data.a)
+                                     : checkExpression(body, data.a);
+            type = value != TYPE_ID_NONE ? pointerType(checker->types, value) : TYPE_ID_NONE;
+            break;
+        }
+        case TernaryNodeType: {
+            checkExpression(body, data.a);
+            const TypeId then = checkExpression(body, ast->extra[data.b]);
+            const TypeId otherwise = checkExpression(body, ast->extra[data.b + 1]);
+            type = then == otherwise ? then : TYPE_ID_NONE;
+            break;
+        }
+        case OrElseNodeType: {
+            const TypeId value = checkExpression(body, data.a);
+            checkStatement(body, data.b);
+            type = value != TYPE_ID_NONE && typeOf(checker->types, value)->form == FORM_OPTIONAL
+                       ? typeOf(checker->types, value)->a
+                       : TYPE_ID_NONE;
+            break;
+        }
+        case NegNodeType:
+        case BitNotNodeType:
+        case PreIncNodeType:
+        case PreDecNodeType:
+        case PostIncNodeType:
+        case PostDecNodeType:
+            if (astKind(ast, node) >= PreIncNodeType) {
+                checkAssignTarget(body, data.a);
+            }
+            type = checkExpression(body, data.a);
+            break;
+        case NotNodeType:
+            checkExpression(body, data.a);
+            type = primitiveType(TYPE_B32);
+            break;
+        case AddressOfNodeType: {
+            const TypeId value = checkExpression(body, data.a);
+            type = value != TYPE_ID_NONE ? pointerType(checker->types, value) : TYPE_ID_NONE;
+            break;
+        }
+        case DerefNodeType: {
+            const TypeId pointer = checkExpression(body, data.a);
+            type = pointer != TYPE_ID_NONE && typeOf(checker->types, pointer)->form == FORM_POINTER
+                       ? typeOf(checker->types, pointer)->a
+                       : TYPE_ID_NONE;
+            break;
+        }
+        default: {
+            const NodeKind kind = astKind(ast, node);
+            if (kind >= AddNodeType && kind <= RangeClosedNodeType) {
+                type = checkBinary(body, node);
+            } else if (kind >= NamedTypeNodeType && kind <= UnionTypeNodeType) {
+                resolveType(checker, body->file, body, node); // A type given as an argument, size_of(T).
+            }
+            break;
+        }
+    }
+
+    body->file->types[node] = type;
+    if (isLiteralExpression(ast, node)) {
+        if (body->literalCount == body->literalCapacity) {
+            body->literals = (LiteralUse *)array_grow(body->literals, &body->literalCapacity, sizeof(LiteralUse));
+        }
+        body->literals[body->literalCount++] = (LiteralUse){node, literals};
+    }
+    return type;
+}
+
+// The nth value given by values, a list of count expressions, for as many names: one each, or all from one call.
+static TypeId valueType(const BodyCheck *body, const uint32_t *values, const int count, const TypeId *types,
+                        const int names, const int nth) {
+    if (count == names) {
+        return types[nth];
+    }
+
+    const Ast *ast = &body->file->results->ast;
+    if (count != 1 || !isCallNode(ast, values[0])) {
+        return TYPE_ID_NONE;
+    }
+
+    const TypeId callee = body->file->types[ast->data[values[0]].a];
+    if (callee == TYPE_ID_NONE || typeOf(body->checker->types, callee)->form != FORM_FUNCTION) {
+        return TYPE_ID_NONE;
+    }
+
+    const Type *fn = typeOf(body->checker->types, callee);
+    return nth < (int)(fn->count - fn->a) ? fn->items[fn->a + nth] : TYPE_ID_NONE;
+}
+
+static void checkVar(BodyCheck *body, const NodeIndex node) {
+    const Ast *ast = &body->file->results->ast;
+    const uint32_t var = ast->data[node].a;
+    const bool constant = ast->extra[var] != VAR_LET;
+    const TypeId declared = resolveType(body->checker, body->file, body, ast->extra[var + 1]);
+
+    int valueCount;
+    const uint32_t *values = astList(ast, ast->extra[var + 2], &valueCount);
+    TypeId smallTypes[8];
+    TypeId *types = valueCount <= 8 ? smallTypes : (TypeId *)malloc(sizeof(TypeId) * valueCount);
+    for (int i = 0; i < valueCount; ++i) {
+        types[i] = checkExpression(body, values[i]);
+    }
+
+    int nameCount;
+    const uint32_t *names = astList(ast, ast->extra[var + 3], &nameCount);
+    const bool required = ast->extra[var] == VAR_CONST;
+    for (int i = 0; i < nameCount; ++i) {
+        const TypeId value = valueType(body, values, valueCount, types, nameCount, i);
+        if (declared != TYPE_ID_NONE && valueCount == nameCount) {
+            expectAssignable(body, declared, value, values[i]);
+        }
+        if (valueCount == nameCount) {
+            // A constant's value is reported by localConstant.
+            typeLiterals(body, values[i], declared, !constant);
+        }
+
+        // const must be known at compile time, val and ::= are when their values are.
+        const Symbol name = astSymbol(ast, names[i]);
+        const char *what = required ? symbolName(body->checker->config->interner, name, nullptr) : nullptr;
+        Constant known;
+        known.kind = CONST_NONE;
+        if (constant && valueCount == nameCount) {
+            known = localConstant(body, values[i], kindOf(body->checker, declared), what);
+        } else if (what != nullptr && valueCount > 0) {
+            report(body, DIAG_NOT_CONSTANT, node, what, nullptr, nullptr);
+        }
+        bind(body, name, declared != TYPE_ID_NONE ? declared : value, constant, &known);
+    }
+
+    body->file->types[node] = declared != TYPE_ID_NONE ? declared : valueType(body, values, valueCount, types, 1, 0);
+    if (types != smallTypes) {
+        free(types);
+    }
+}
+
+static void checkReturn(BodyCheck *body, const NodeIndex node) {
+    const Ast *ast = &body->file->results->ast;
+    int count;
+    const uint32_t *values = astList(ast, ast->data[node].a, &count);
+
+    // main declaring nothing may return nothing or its exit code, an int like the one lowering gives it.
+    const bool exitCode = body->returnCount < 0;
+    const int expectedCount = exitCode ? 1 : body->returnCount;
+    const bool oneCall = count == 1 && isCallNode(ast, values[0]);
+    if (exitCode ? count > 1 : (count != body->returnCount && !(oneCall && body->returnCount > 1))) {
+        char expected[16];
+        char got[16];
+        sprintf(expected, "%d", expectedCount);
+        sprintf(got, "%d", count);
+        report(body, DIAG_RETURN_COUNT, node, expected, got, nullptr);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const TypeId type = checkExpression(body, values[i]);
+        if (count == expectedCount) {
+            const TypeId to = exitCode ? primitiveType(TYPE_S32) : body->returns[i];
+            expectAssignable(body, to, type, values[i]);
+            typeLiterals(body, values[i], to, true);
+        }
+    }
+}
+
+static void checkBlock(BodyCheck *body, const NodeIndex node) {
+    const Ast *ast = &body->file->results->ast;
+    const int scope = body->bindingCount;
+    int count;
+    const uint32_t *list = astList(ast, ast->data[node].a, &count);
+    for (int i = 0; i < count; ++i) {
+        checkStatement(body, list[i]);
+    }
+    body->bindingCount = scope;
+}
+
+static void checkStatement(BodyCheck *body, const NodeIndex node) {
+    const Ast *ast = &body->file->results->ast;
+    const NodeData data = ast->data[node];
+    const int scope = body->bindingCount;
+
+    switch (astKind(ast, node)) {
+        case VoidNodeType:
+        case BreakNodeType:
+        case ContinueNodeType:
+        case UseNodeType:
+            break;
+        case BlockNodeType:
+            checkBlock(body, node);
+            break;
+        case VarNodeType:
+            checkVar(body, node);
+            break;
+        case AssignNodeType: {
+            checkAssignTarget(body, data.a);
+            const TypeId target = checkExpression(body, data.a);
+            expectAssignable(body, target, checkExpression(body, data.b), data.b);
+            typeLiterals(body, data.b, target, true);
+            break;
+        }
+        case CompoundAssignNodeType: {
+            checkAssignTarget(body, data.a);
+            const TypeId target = checkExpression(body, data.a);
+            checkExpression(body, ast->extra[data.b + 1]);
+            const NodeKind op = (NodeKind)ast->extra[data.b];
+            if (op != ShlNodeType && op != ShrNodeType && op != ShlSatNodeType) {
+                typeLiterals(body, ast->extra[data.b + 1], target, true);
+            }
+            break;
+        }
+        case ReturnNodeType:
+            checkReturn(body, node);
+            break;
+        case IfNodeType:
+            checkStatement(body, ast->extra[data.b]);
+            checkExpression(body, data.a);
+            checkStatement(body, ast->extra[data.b + 1]);
+            checkStatement(body, ast->extra[data.b + 2]);
+            body->bindingCount = scope;
+            break;
+        case WhileNodeType:
+        case UntilNodeType:
+            checkExpression(body, data.a);
+            checkStatement(body, data.b);
+            break;
+        case ForNodeType:
+            checkStatement(body, ast->extra[data.a]);
+            checkExpression(body, ast->extra[data.a + 1]);
+            checkStatement(body, ast->extra[data.a + 2]);
+            checkStatement(body, ast->extra[data.a + 3]);
+            body->bindingCount = scope;
+            break;
+        case ForInNodeType: {
+            const NodeIndex iterable = ast->extra[data.a + 1];
+            const TypeId over = checkExpression(body, iterable);
+            const NodeKind kind = astKind(ast, iterable);
+            const TypeId element = kind == RangeOpenNodeType || kind == RangeClosedNodeType
+                                       ? body->file->types[ast->data[iterable].a]
+                                       : elementOf(body->checker, over);
+            checkExpression(body, ast->extra[data.a + 2]);
+
+            int count;
+            const uint32_t *names = astList(ast, ast->extra[data.a], &count);
+            for (int i = 0; i < count; ++i) {
+                bind(body, astSymbol(ast, names[i]), i == 0 ? element : TYPE_ID_NONE, false, nullptr);
+            }
+            checkStatement(body, ast->extra[data.a + 3]);
+            body->bindingCount = scope;
+            break;
+        }
+        case DeferNodeType:
+            checkStatement(body, data.a);
+            break;
+        case DeleteNodeType:
+            checkExpression(body, data.a);
+            break;
+        case FunctionNodeType:
+        case StructNodeType:
+        case ImplNodeType:
+        case LazyBodyNodeType:
+            break;
+        default:
+            checkExpression(body, node);
+            break;
+    }
+}
+
+static void bodyTask(void *arg) {
+    BodyCheck *body = (BodyCheck *)arg;
+    const uint64_t start = timer_now_ns();
+    Checker *checker = body->checker;
+    const Ast *ast = &body->file->results->ast;
+    const NodeIndex prototype = ast->data[body->function].a;
+    const uint32_t signature = ast->data[prototype].b;
+
+    body->parameters = astList(ast, ast->extra[signature + 2], &body->parameterCount);
+
+    int argCount;
+    const uint32_t *args = astList(ast, ast->extra[signature], &argCount);
+    for (int i = 0; i < argCount; ++i) {
+        bind(body, astSymbol(ast, ast->data[args[i]].a), body->file->types[args[i]], false, nullptr);
+        const NodeIndex value = ast->extra[ast->data[args[i]].b + 1];
+        if (value != NODE_NONE) {
+            checkExpression(body, value);
+            typeLiterals(body, value, body->file->types[args[i]], true);
+        }
+    }
+
+    // void is the same as no return values.
+    int returnCount;
+    const uint32_t *returns = astList(ast, ast->extra[signature + 1], &returnCount);
+    body->returns = (TypeId *)malloc(sizeof(TypeId) * (returnCount + 1));
+    for (int i = 0; i < returnCount; ++i) {
+        body->returns[i] = resolveType(checker, body->file, body, returns[i]);
+    }
+    body->returnCount = returnCount == 1 && body->returns[0] == primitiveType(TYPE_VOID) ? 0 : returnCount;
+    if (returnCount == 0 && body->impl == SYMBOL_NONE && astSymbol(ast, ast->data[prototype].a) == checker->main) {
+        body->returnCount = -1;
+    }
+
+    checkBlock(body, ast->data[body->function].b);
+    // What nothing gave a type keeps its own, latest first so a whole expression goes before the literals in it.
+    for (int at = body->literalCount - 1; at >= 0; --at) {
+        if (body->literals[at].node != NODE_NONE) {
+            typeLiteralsAt(body, at, TYPE_ID_NONE, true);
+        }
+    }
+
+    free(body->returns);
+    free(body->bindings);
+    free(body->literals);
+    body->bindings = nullptr;
+    body->literals = nullptr;
+    body->ns = timer_now_ns() - start;
+}
+
+static void addBody(BodyCheck **bodies, int *count, int *capacity, Checker *checker, CheckedFile *file,
+                    const NodeIndex function, const Symbol impl) {
+    const Ast *ast = &file->results->ast;
+    if (astKind(ast, ast->data[function].b) != BlockNodeType) {
+        return; // Without a body, or one lazy parsing found nothing calls.
+    }
+
+    if (*count == *capacity) {
+        *bodies = (BodyCheck *)array_grow(*bodies, capacity, sizeof(BodyCheck));
+    }
+
+    BodyCheck *body = &(*bodies)[(*count)++];
+    memset(body, 0, sizeof(BodyCheck));
+    body->checker = checker;
+    body->file = file;
+    body->function = function;
+    body->impl = impl;
+    initDiagnostics(&body->diagnostics);
+}
+
+// Every body of the program parsed so far, in file and then declaration order.
+static BodyCheck *collectBodies(Checker *checker, int *count, int *capacity) {
+    BodyCheck *bodies = nullptr;
+    *capacity = 0;
+    *count = 0;
+
+    for (int i = 0; i < checker->program->fileCount; ++i) {
+        CheckedFile *file = &checker->files[i];
+        const Ast *ast = &file->results->ast;
+        int declCount;
+        const uint32_t *decls = astList(ast, ast->decls, &declCount);
+        for (int j = 0; j < declCount; ++j) {
+            if (astKind(ast, decls[j]) == FunctionNodeType) {
+                addBody(&bodies, count, capacity, checker, file, decls[j], SYMBOL_NONE);
+            } else if (astKind(ast, decls[j]) == ImplNodeType) {
+                const Symbol impl = astSymbol(ast, ast->data[decls[j]].a);
+                int methodCount;
+                const uint32_t *methods = astList(ast, ast->data[decls[j]].b, &methodCount);
+                for (int k = 0; k < methodCount; ++k) {
+                    if (astKind(ast, methods[k]) == FunctionNodeType) {
+                        addBody(&bodies, count, capacity, checker, file, methods[k], impl);
+                    }
+                }
+            }
+        }
+    }
+
+    return bodies;
+}
+
+// Makes room in the node types of the files bodies were parsed into since.
+static void growNodeTypes(Checker *checker) {
+    for (int i = 0; i < checker->program->fileCount; ++i) {
+        CheckedFile *file = &checker->files[i];
+        const int count = file->results->ast.count;
+        if (count > file->typeCount) {
+            file->types = (TypeId *)realloc(file->types, sizeof(TypeId) * (count + 1));
+            memset(file->types + file->typeCount, 0, sizeof(TypeId) * (count + 1 - file->typeCount));
+            file->typeCount = count;
+            checker->program->nodeTypes[i] = file->types;
+        }
+    }
+}
+
+// In file and then declaration order, however the bodies were found.
+static int compareBodies(const void *x, const void *y) {
+    const BodyCheck *a = (const BodyCheck *)x;
+    const BodyCheck *b = (const BodyCheck *)y;
+    if (a->file != b->file) {
+        return a->file < b->file ? -1 : 1;
+    }
+    return a->function < b->function ? -1 : a->function > b->function;
+}
+
+// Adds the errors of the bodies to their files, opening each file with errors once for its lines.
+static int addBodyDiagnostics(BodyCheck *bodies, const int count) {
+    int errors = 0;
+    for (int i = 0; i < count;) {
+        ParseResults *results = bodies[i].file->results;
+        Lexer *lexer = nullptr;
+        for (; i < count && bodies[i].file->results == results; ++i) {
+            errors += mergeDiagnostics(results, &lexer, &bodies[i].diagnostics);
+        }
+        if (lexer != nullptr) {
+            freeLexer(lexer);
+        }
+    }
+
+    return errors;
+}
+
+// Adds the errors found outside bodies, by constants and signatures.
+static int addFileDiagnostics(Checker *checker) {
+    int errors = 0;
+    for (int i = 0; i < checker->program->fileCount; ++i) {
+        Lexer *lexer = nullptr;
+        errors += mergeDiagnostics(checker->files[i].results, &lexer, checker->files[i].diagnostics);
+        if (lexer != nullptr) {
+            freeLexer(lexer);
+        }
+    }
+
+    return errors;
+}
+
+// The constants worked out in bodies join those of their files, for lowering.
+static void addBodyConstants(BodyCheck *bodies, const int count) {
+    for (int i = 0; i < count; ++i) {
+        const ConstantTable *found = &bodies[i].constants;
+        for (int j = 0; j < found->count; ++j) {
+            addConstant(bodies[i].file->constants, found->entries[j].node, &found->entries[j].value);
+        }
+        freeConstants(&bodies[i].constants);
+    }
+}
+
+typedef struct {
+    Instance instance;
+    int file;
+    StrBuffer name;
+} SortedInstance;
+
+static int compareInstances(const void *x, const void *y) {
+    const SortedInstance *a = (const SortedInstance *)x;
+    const SortedInstance *b = (const SortedInstance *)y;
+    if (a->file != b->file) {
+        return a->file < b->file ? -1 : 1;
+    }
+    if (a->instance.declaration->node != b->instance.declaration->node) {
+        return a->instance.declaration->node < b->instance.declaration->node ? -1 : 1;
+    }
+
+    return strcmp(a->name.data, b->name.data);
+}
+
+// Moves the instances out of the shards into the program, in an order that doesn't depend on which task found them.
+static void collectInstances(Checker *checker) {
+    int count = 0;
+    for (int i = 0; i < INSTANCE_SHARDS; ++i) {
+        count += (int)checker->shards[i].count;
+    }
+
+    SortedInstance *sorted = (SortedInstance *)malloc(sizeof(SortedInstance) * (count + 1));
+    int n = 0;
+    for (int i = 0; i < INSTANCE_SHARDS; ++i) {
+        const InstanceShard *shard = &checker->shards[i];
+        for (uint32_t j = 0; j <= shard->mask; ++j) {
+            const InstanceSlot *slot = &shard->slots[j];
+            if (slot->declaration == nullptr) {
+                continue;
+            }
+
+            StrBuffer name;
+            str_buf_init(&name);
+            appendTypeName(checker->types, checker->config->interner, slot->args, &name);
+            sorted[n++] = (SortedInstance){{slot->declaration, slot->type, slot->args},
+                                           (int)(fileOf(checker, slot->declaration->file) - checker->files), name};
+        }
+    }
+    qsort(sorted, n, sizeof(SortedInstance), compareInstances);
+
+    Program *program = checker->program;
+    program->instances = (Instance *)malloc(sizeof(Instance) * (n + 1));
+    program->instanceCount = n;
+    for (int i = 0; i < n; ++i) {
+        program->instances[i] = sorted[i].instance;
+        str_buf_free(&sorted[i].name);
+    }
+    free(sorted);
+}
+
+// A struct waiting for the layouts of its fields.
+typedef struct {
+    TypeId type;
+    TypeId *fields;
+    int fieldCount;
+} PendingLayout;
+
+static void addPendingLayout(PendingLayout **pending, int *count, int *capacity, const TypeId type,
+                             const TypeId *fields, const int fieldCount) {
+    if (*count == *capacity) {
+        *pending = (PendingLayout *)array_grow(*pending, capacity, sizeof(PendingLayout));
+    }
+
+    PendingLayout *layout = &(*pending)[(*count)++];
+    layout->type = type;
+    layout->fieldCount = fieldCount;
+    layout->fields = (TypeId *)malloc(sizeof(TypeId) * (fieldCount + 1));
+    if (fieldCount > 0) {
+        memcpy(layout->fields, fields, sizeof(TypeId) * fieldCount);
+    }
+}
+
+// Lays out structs, and instances of generic ones, field after field at its alignment. A struct holding another by
+// value waits for it, so this goes round until nothing more can be laid out. Whatever is left holds itself, or a
+// type that can't be laid out yet.
+static void layoutStructs(Checker *checker) {
+    PendingLayout *pending = nullptr;
+    int count = 0;
+    int capacity = 0;
+    TypeId *fields = nullptr;
+    int fieldCapacity = 0;
+
+    for (int i = 0; i < checker->program->fileCount; ++i) {
+        const CheckedFile *file = &checker->files[i];
+        const Ast *ast = &file->results->ast;
+        int declCount;
+        const uint32_t *decls = astList(ast, ast->decls, &declCount);
+        for (int j = 0; j < declCount; ++j) {
+            if (astKind(ast, decls[j]) != StructNodeType || typeParameterCount(ast, decls[j]) > 0) {
+                continue;
+            }
+
+            int fieldCount;
+            const uint32_t *list = astList(ast, ast->extra[ast->data[decls[j]].b], &fieldCount);
+            while (fieldCapacity < fieldCount) {
+                fields = (TypeId *)array_grow(fields, &fieldCapacity, sizeof(TypeId));
+            }
+            for (int k = 0; k < fieldCount; ++k) {
+                fields[k] = file->types[list[k]];
+            }
+            addPendingLayout(&pending, &count, &capacity, file->types[decls[j]], fields, fieldCount);
+        }
+    }
+
+    const Program *program = checker->program;
+    for (int i = 0; i < program->instanceCount; ++i) {
+        const Declaration *decl = program->instances[i].declaration;
+        if (decl->kind != DECL_STRUCT) {
+            continue;
+        }
+
+        const Ast *ast = &decl->file->ast;
+        const TypeId *declTypes = fileOf(checker, decl->file)->types;
+        int fieldCount;
+        const uint32_t *list = astList(ast, ast->extra[ast->data[decl->node].b], &fieldCount);
+        int parameterCount;
+        const uint32_t *parameters = astList(ast, ast->extra[ast->data[decl->node].b + 1], &parameterCount);
+        while (fieldCapacity < fieldCount + parameterCount) {
+            fields = (TypeId *)array_grow(fields, &fieldCapacity, sizeof(TypeId));
+        }
+
+        TypeId *from = fields + fieldCount;
+        for (int k = 0; k < parameterCount; ++k) {
+            from[k] = namedType(checker->types, decl->namespace, astSymbol(ast, parameters[k]));
+        }
+        const Type *instance = typeOf(checker->types, program->instances[i].type);
+        for (int k = 0; k < fieldCount; ++k) {
+            fields[k] = substituteType(checker->types, declTypes[list[k]], from, instance->items, parameterCount);
+        }
+        addPendingLayout(&pending, &count, &capacity, program->instances[i].type, fields, fieldCount);
+    }
+
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int i = 0; i < count; ++i) {
+            PendingLayout *layout = &pending[i];
+            if (layout->type == TYPE_ID_NONE) {
+                continue;
+            }
+
+            TypeLayout total = {0, 1};
+            bool known = true;
+            for (int k = 0; k < layout->fieldCount && known; ++k) {
+                TypeLayout field;
+                known = typeLayout(checker->types, layout->fields[k], &field);
+                if (known) {
+                    total.size = (total.size + field.align - 1) / field.align * field.align + field.size;
+                    total.align = max(total.align, field.align);
+                }
+            }
+            if (!known) {
+                continue;
+            }
+
+            total.size = (total.size + total.align - 1) / total.align * total.align;
+            setTypeLayout(checker->types, layout->type, total);
+            layout->type = TYPE_ID_NONE;
+            progress = true;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        free(pending[i].fields);
+    }
+    free(pending);
+    free(fields);
+}
+
+static void initChecker(Checker *checker, Program *program, CompilerConfig *config) {
+    memset(checker, 0, sizeof(Checker));
+    checker->program = program;
+    checker->config = config;
+    checker->types = program->types;
+
+    const int fileCount = program->fileCount;
+    checker->files = (CheckedFile *)calloc(fileCount + 1, sizeof(CheckedFile));
+    uint32_t size = 16;
+    while (size < (uint32_t)fileCount * 2) {
+        size *= 2;
+    }
+    checker->fileKeys = (const ParseResults **)calloc(size, sizeof(ParseResults *));
+    checker->fileIndices = (int *)calloc(size, sizeof(int));
+    checker->fileMask = size - 1;
+    checker->namespaces = (Symbol *)malloc(sizeof(Symbol) * (fileCount + 1));
+    checker->diagnostics = (DiagnosticBuffer *)malloc(sizeof(DiagnosticBuffer) * (fileCount + 1));
+
+    for (int i = 0; i < fileCount; ++i) {
+        ParseResults *results = program->files[i];
+        checker->files[i].results = results;
+        checker->files[i].types = program->nodeTypes[i];
+        checker->files[i].typeCount = results->ast.count;
+        checker->files[i].constants = &program->constants[i];
+        checker->files[i].diagnostics = &checker->diagnostics[i];
+        initDiagnostics(&checker->diagnostics[i]);
+
+        uint32_t at = pointerHash(results) & checker->fileMask;
+        while (checker->fileKeys[at] != nullptr) {
+            at = (at + 1) & checker->fileMask;
+        }
+        checker->fileKeys[at] = results;
+        checker->fileIndices[at] = i;
+
+        if (results->namespace != SYMBOL_NONE) {
+            checker->namespaces[checker->namespaceCount++] = results->namespace;
+        }
+    }
+    qsort(checker->namespaces, checker->namespaceCount, sizeof(Symbol), compareSymbols);
+
+    for (int i = 0; i < BUILTIN_COUNT; ++i) {
+        checker->builtins[i] = intern(config->interner, builtinNames[i], str_len(builtinNames[i]));
+    }
+
+    checker->main = intern(config->interner, "main", 4);
+
+    for (int i = 0; i < INSTANCE_SHARDS; ++i) {
+        InstanceShard *shard = &checker->shards[i];
+        mutex_init(&shard->lock);
+        shard->slots = (InstanceSlot *)calloc(INSTANCE_MIN_SLOTS, sizeof(InstanceSlot));
+        shard->mask = INSTANCE_MIN_SLOTS - 1;
+        shard->count = 0;
+    }
+}
+
+static void freeChecker(Checker *checker) {
+    for (int i = 0; i < INSTANCE_SHARDS; ++i) {
+        mutex_destroy(&checker->shards[i].lock);
+        free(checker->shards[i].slots);
+    }
+    for (int i = 0; i < checker->program->fileCount; ++i) {
+        free(checker->files[i].constantStates);
+        freeDiagnostics(&checker->diagnostics[i]);
+    }
+    free(checker->diagnostics);
+    free(checker->namespaces);
+    free(checker->fileIndices);
+    free(checker->fileKeys);
+    free(checker->files);
+}
+
+void checkProgram(Program *program, CompilerConfig *config) {
+    if (program == nullptr || config == nullptr || config->interner == nullptr || program->types != nullptr) {
+        return;
+    }
+
+    const uint64_t start = timer_now_ns();
+    program->types = initTypeTable(config->interner);
+    program->nodeTypes = (TypeId **)malloc(sizeof(TypeId *) * (program->fileCount + 1));
+    for (int i = 0; i < program->fileCount; ++i) {
+        program->nodeTypes[i] = (TypeId *)calloc(program->files[i]->ast.count + 1, sizeof(TypeId));
+    }
+    program->constants = (ConstantTable *)calloc(program->fileCount + 1, sizeof(ConstantTable));
+
+    Checker checker;
+    initChecker(&checker, program, config);
+    ThreadPool *pool = config->threadPool != nullptr ? config->threadPool : pool_new(config->threads);
+
+    // Constants first, array sizes in signatures name them, then signatures, bodies read them.
+    evaluateGlobals(&checker);
+    SignatureTask *signatures = (SignatureTask *)malloc(sizeof(SignatureTask) * (program->fileCount + 1));
+    TaskGroup group = TASK_GROUP_INIT;
+    for (int i = 0; i < program->fileCount; ++i) {
+        signatures[i] = (SignatureTask){&checker, i, 0};
+        pool_submit_group(pool, &group, signatureTask, &signatures[i]);
+    }
+    pool_wait_group(pool, &group);
+    for (int i = 0; i < program->fileCount; ++i) {
+        program->times.signatures += signatures[i].ns;
+    }
+    free(signatures);
+    program->errorCount += addFileDiagnostics(&checker);
+
+    // With lazy bodies, the ones the bodies checked so far reach are parsed and checked next, until no more are.
+    int bodyCount = 0;
+    int bodyCapacity = 0;
+    BodyCheck *bodies = collectBodies(&checker, &bodyCount, &bodyCapacity);
+    BodyReach *reach = config->lazyBodies ? initBodyReach(program, config) : nullptr;
+    for (int checked = 0;;) {
+        for (int i = checked; i < bodyCount; ++i) {
+            pool_submit_group(pool, &group, bodyTask, &bodies[i]);
+        }
+        pool_wait_group(pool, &group);
+        checked = bodyCount;
+
+        const Declaration **parsed;
+        const int parsedCount = reach != nullptr ? parseReachedBodies(reach, pool, &parsed) : 0;
+        if (parsedCount == 0) {
+            break;
+        }
+        growNodeTypes(&checker);
+        for (int i = 0; i < parsedCount; ++i) {
+            const Declaration *declaration = parsed[i];
+            const Symbol impl = declaration->kind == DECL_METHOD ? declaration->namespace : SYMBOL_NONE;
+            addBody(&bodies, &bodyCount, &bodyCapacity, &checker, fileOf(&checker, declaration->file),
+                    declaration->node, impl);
+        }
+    }
+    freeBodyReach(reach);
+    for (int i = 0; i < program->fileCount; ++i) {
+        freeParseSource(program->files[i]);
+    }
+    if (pool != config->threadPool) {
+        pool_free(pool);
+    }
+    if (bodyCount > 0) {
+        qsort(bodies, bodyCount, sizeof(BodyCheck), compareBodies);
+    }
+
+    for (int i = 0; i < bodyCount; ++i) {
+        program->times.check += bodies[i].ns;
+    }
+    program->times.checkedBodies += bodyCount;
+    program->errorCount += addBodyDiagnostics(bodies, bodyCount);
+    addBodyConstants(bodies, bodyCount);
+    free(bodies);
+
+    collectInstances(&checker);
+    program->times.instances = program->instanceCount;
+    layoutStructs(&checker);
+
+    freeChecker(&checker);
+    program->runTime += (int)timer_elapsed_ms(start);
+}
@@ -0,0 +1,42 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_CHECK_H
+#define NIFTY_CHECK_H
+
+#include "common.h"
+#include "program.h"
+
+// Semantic analysis of a parsed program, in two steps. First the signatures of every file, function prototypes, struct
+// fields and typed globals, are resolved to types, one task per file. Then every function body that was parsed is
+// checked against them, one task per body on the config's thread pool. A body only reads signatures and writes the
+// types of its own nodes, so bodies need nothing from each other. Generic structs and functions used with concrete
+// types are recorded once each, however many bodies ask for them at the same time.
+//
+// Errors found in a body are kept by its task and added to its file's diagnostics in declaration order once every body
+// is checked, so the output doesn't depend on the number of threads or on which body finished first.
+//
+// Until behaviors and the receivers of methods are resolved, names are only reported as undeclared outside of impls,
+// in files whose usings were all found, and types are only reported where they can't match, like a string for an int.
+void checkProgram(Program *program, CompilerConfig *config);
+
+#endif //NIFTY_CHECK_H
@@ -26,6 +26,8 @@
 #define NIFTY_VERSION "0.0.1"
 #define NIFTY_DATE "17 - January - 2025"
 #define NIFTY_BUILD_FILE "build.toml"
+#define NIFTY_BUILD_DIR "build"
+#define NIFTY_AST_CACHE_DIR "ast-cache" // In NIFTY_BUILD_DIR.
 #define NIFTY_ENTRY "__nifty_start"
 #define NIFTY_GENERATED_FILE "_nifty_generated_c.c"
 
@@ -42,7 +44,19 @@ typedef enum {
 
 typedef struct {
     bool disableColors;
+    bool jsonDiagnostics; // Errors and warnings as a JSON array, for tools.
+    bool timeReport; // Print the time of each compiler phase after building.
+    bool emitIr; // Print the IR of every function after building, see ir.h.
+    bool remarks; // Print what the optimization passes did, like the calls they inlined.
+    bool vectorizeReport; // Print which loops the loops pass found can vectorize, and why the rest can't.
     Verbosity verbosity;
+    bool streamingLexer; // Pull tokens one at a time instead of lexing the whole file up front.
+    bool lazyBodies; // Skip function bodies until something needs them, see parseFunctionBody.
+    int threads; // 0 uses every hardware thread.
+    struct ThreadPool *threadPool; // Set while building.
+    struct Interner *interner; // Names from every file, set while building.
+    char *nslPath; // Root of the nifty standard library, nullptr to leave nsl namespaces out.
+    char *cacheDir; // Parsed files are kept here between builds, see astcache.h. nullptr parses every file.
 } CompilerConfig;
 
 #if defined(WIN32) || defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
@@ -80,4 +94,8 @@ typedef struct {
 #   define max(a,b) (((a) > (b)) ? (a) : (b))
 #endif
 
+#ifndef min
+#   define min(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+
 #endif //NIFTY_COMMON_H
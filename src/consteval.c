@@ -0,0 +1,845 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "consteval.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "util/array.h"
+
+// Integers are worked on as a sign and a 128 bit magnitude, with a carry for magnitudes of 2^128 and up, so every
+// result of two values of a type is exact before it is checked against the type.
+
+typedef struct {
+    uint64_t low;
+    uint64_t high;
+} U128;
+
+typedef struct {
+    U128 magnitude;
+    bool negative; // Never set for zero.
+    bool carry;    // The magnitude is at least 2^128, only the low 128 bits are kept.
+} Exact;
+
+bool isIntegerKind(const TypeKind kind) {
+    return (kind >= TYPE_U8 && kind <= TYPE_S28) || kind == TYPE_CHAR || kind == TYPE_UINTPTR;
+}
+
+bool isSignedKind(const TypeKind kind) {
+    return kind >= TYPE_S8 && kind <= TYPE_S28;
+}
+
+bool isFloatKind(const TypeKind kind) {
+    return kind >= TYPE_F16 && kind <= TYPE_F128;
+}
+
+bool isBoolKind(const TypeKind kind) {
+    return kind >= TYPE_B8 && kind <= TYPE_B64;
+}
+
+static int widthOf(const TypeKind kind) {
+    switch (kind) {
+        case TYPE_U8: case TYPE_S8: return 8;
+        case TYPE_U16: case TYPE_S16: return 16;
+        case TYPE_U32: case TYPE_S32: case TYPE_CHAR: return 32;
+        case TYPE_U64: case TYPE_S64: case TYPE_UINTPTR: return 64;
+        default: return 128;
+    }
+}
+
+// 128 bit arithmetic, wrapping.
+
+static bool isZero(const U128 x) {
+    return x.low == 0 && x.high == 0;
+}
+
+static U128 add128(const U128 x, const U128 y, bool *carry) {
+    U128 sum = {x.low + y.low, x.high + y.high};
+    const bool lowCarry = sum.low < x.low;
+    sum.high += lowCarry;
+    *carry = sum.high < x.high || (lowCarry && sum.high == x.high);
+    return sum;
+}
+
+static U128 sub128(const U128 x, const U128 y) {
+    return (U128){x.low - y.low, x.high - y.high - (x.low < y.low)};
+}
+
+static U128 neg128(const U128 x) {
+    return sub128((U128){0, 0}, x);
+}
+
+static int compare128(const U128 x, const U128 y) {
+    if (x.high != y.high) {
+        return x.high < y.high ? -1 : 1;
+    }
+    return x.low == y.low ? 0 : x.low < y.low ? -1 : 1;
+}
+
+static U128 shl128(const U128 x, const int shift) {
+    if (shift == 0) {
+        return x;
+    }
+    if (shift >= 64) {
+        return (U128){0, x.low << (shift - 64)};
+    }
+    return (U128){x.low << shift, x.high << shift | x.low >> (64 - shift)};
+}
+
+static U128 shr128(const U128 x, const int shift, const bool arithmetic) {
+    const uint64_t fill = arithmetic && (x.high >> 63) ? UINT64_MAX : 0;
+    if (shift == 0) {
+        return x;
+    }
+    if (shift >= 64) {
+        const int rest = shift - 64;
+        return (U128){rest == 0 ? x.high : x.high >> rest | fill << (64 - rest), fill};
+    }
+    return (U128){x.low >> shift | x.high << (64 - shift), x.high >> shift | fill << (64 - shift)};
+}
+
+static U128 mul64(const uint64_t x, const uint64_t y) {
+    const uint64_t x0 = (uint32_t)x, x1 = x >> 32;
+    const uint64_t y0 = (uint32_t)y, y1 = y >> 32;
+    const uint64_t p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+    const uint64_t middle = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+    return (U128){(middle << 32) | (uint32_t)p00, p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32)};
+}
+
+// The low 128 bits of the product, overflow is set if it has more.
+static U128 mul128(const U128 x, const U128 y, bool *overflow) {
+    const U128 low = mul64(x.low, y.low);
+    const U128 cross1 = mul64(x.high, y.low);
+    const U128 cross2 = mul64(x.low, y.high);
+    const uint64_t cross = cross1.low + cross2.low;
+    const uint64_t high = low.high + cross;
+    *overflow = (x.high != 0 && y.high != 0) || cross1.high != 0 || cross2.high != 0 || cross < cross1.low ||
+                high < low.high;
+    return (U128){low.low, high};
+}
+
+static U128 divide128(U128 x, const U128 y, U128 *remainder) {
+    if (x.high == 0 && y.high == 0) {
+        *remainder = (U128){x.low % y.low, 0};
+        return (U128){x.low / y.low, 0};
+    }
+
+    U128 quotient = {0, 0};
+    U128 rest = {0, 0};
+    for (int bit = 127; bit >= 0; --bit) {
+        rest = shl128(rest, 1);
+        rest.low |= (bit >= 64 ? x.high >> (bit - 64) : x.low >> bit) & 1;
+        if (compare128(rest, y) >= 0) {
+            rest = sub128(rest, y);
+            if (bit >= 64) {
+                quotient.high |= 1ull << (bit - 64);
+            } else {
+                quotient.low |= 1ull << bit;
+            }
+        }
+    }
+    *remainder = rest;
+    return quotient;
+}
+
+// Between constants and exact values.
+
+static U128 bitsOf(const Constant *constant) {
+    return (U128){constant->low, constant->high};
+}
+
+// Keeps the low bits that fit type, sign or zero extended to 128.
+static Constant makeInt(const TypeKind type, const U128 bits) {
+    const int width = widthOf(type);
+    U128 value = bits;
+    if (width < 128) {
+        const int unused = 128 - width;
+        value = shr128(shl128(bits, unused), unused, isSignedKind(type));
+    }
+
+    Constant constant = {CONST_INT, type, value.low, value.high, 0};
+    return constant;
+}
+
+static Exact exactOf(const Constant *constant) {
+    Exact exact = {bitsOf(constant), false, false};
+    if (isSignedKind(constant->type) && (constant->high >> 63)) {
+        exact.magnitude = neg128(exact.magnitude);
+        exact.negative = true;
+    }
+    return exact;
+}
+
+// The two's complement of the exact value, the low 128 bits of it.
+static U128 wrapExact(const Exact exact) {
+    return exact.negative ? neg128(exact.magnitude) : exact.magnitude;
+}
+
+static bool fits(const TypeKind type, const Exact exact) {
+    if (exact.carry) {
+        return false;
+    }
+
+    const int width = widthOf(type);
+    if (!isSignedKind(type)) {
+        return !exact.negative && (width == 128 || compare128(exact.magnitude, shl128((U128){1, 0}, width)) < 0);
+    }
+
+    const U128 limit = shl128((U128){1, 0}, width - 1);
+    const int order = compare128(exact.magnitude, limit);
+    return exact.negative ? order <= 0 : order < 0;
+}
+
+static Constant limitOf(const TypeKind type, const bool lowest) {
+    const int width = widthOf(type);
+    if (!isSignedKind(type)) {
+        return makeInt(type, lowest ? (U128){0, 0} : (U128){UINT64_MAX, UINT64_MAX});
+    }
+
+    const U128 min = shl128((U128){1, 0}, width - 1);
+    return makeInt(type, lowest ? neg128(min) : sub128(min, (U128){1, 0}));
+}
+
+static Exact exactAdd(const Exact x, const Exact y) {
+    Exact sum = {{0, 0}, false, false};
+    if (x.negative == y.negative) {
+        bool carry;
+        sum.magnitude = add128(x.magnitude, y.magnitude, &carry);
+        sum.carry = carry || x.carry || y.carry;
+        sum.negative = x.negative;
+    } else if (compare128(x.magnitude, y.magnitude) >= 0) {
+        sum.magnitude = sub128(x.magnitude, y.magnitude);
+        sum.negative = x.negative;
+    } else {
+        sum.magnitude = sub128(y.magnitude, x.magnitude);
+        sum.negative = y.negative;
+    }
+    sum.negative = sum.negative && (!isZero(sum.magnitude) || sum.carry);
+    return sum;
+}
+
+static Exact exactNegate(Exact x) {
+    x.negative = !x.negative && !isZero(x.magnitude);
+    return x;
+}
+
+static Exact exactMul(const Exact x, const Exact y) {
+    Exact product = {{0, 0}, false, false};
+    bool overflow;
+    product.magnitude = mul128(x.magnitude, y.magnitude, &overflow);
+    product.carry = overflow;
+    product.negative = x.negative != y.negative && (!isZero(product.magnitude) || overflow);
+    return product;
+}
+
+// The result of an operator that is checked, wraps or saturates, by op.
+static ConstStatus finishArithmetic(const NodeKind op, const TypeKind type, const Exact exact, Constant *result) {
+    if (fits(type, exact)) {
+        *result = makeInt(type, wrapExact(exact));
+        return CONST_OK;
+    }
+
+    switch (op) {
+        case AddWrapNodeType:
+        case SubWrapNodeType:
+        case MulWrapNodeType:
+        case ShlNodeType:
+            *result = makeInt(type, wrapExact(exact));
+            return CONST_OK;
+        case AddSatNodeType:
+        case SubSatNodeType:
+        case MulSatNodeType:
+        case ShlSatNodeType:
+            *result = limitOf(type, exact.negative);
+            return CONST_OK;
+        default:
+            return CONST_OVERFLOW;
+    }
+}
+
+static double roundTo(const TypeKind type, const double value) {
+    return type == TYPE_F16 || type == TYPE_F32 ? (double)(float)value : value;
+}
+
+static double exactToDouble(const Exact exact) {
+    const double value = (double)exact.magnitude.high * 18446744073709551616.0 + (double)exact.magnitude.low;
+    return exact.negative ? -value : value;
+}
+
+static Constant makeBool(const bool value) {
+    Constant constant = {CONST_BOOL, TYPE_B32, value ? 1 : 0, 0, 0};
+    return constant;
+}
+
+static Constant makeFloat(const TypeKind type, const double value) {
+    Constant constant = {CONST_FLOAT, type, 0, 0, roundTo(type, value)};
+    return constant;
+}
+
+Constant intConstant(const TypeKind type, const int64_t value) {
+    const uint64_t high = value < 0 ? UINT64_MAX : 0;
+    return makeInt(type, (U128){(uint64_t)value, high});
+}
+
+Constant wordsConstant(const TypeKind type, const uint32_t words[4]) {
+    return makeInt(type, (U128){(uint64_t)words[1] << 32 | words[0], (uint64_t)words[3] << 32 | words[2]});
+}
+
+void constantWords(const Constant *constant, uint32_t words[4]) {
+    words[0] = (uint32_t)constant->low;
+    words[1] = (uint32_t)(constant->low >> 32);
+    words[2] = (uint32_t)constant->high;
+    words[3] = (uint32_t)(constant->high >> 32);
+}
+
+bool sameConstant(const Constant *x, const Constant *y) {
+    if (x->kind != y->kind || x->type != y->type) {
+        return false;
+    }
+    if (x->kind == CONST_FLOAT) {
+        return memcmp(&x->real, &y->real, sizeof(double)) == 0;
+    }
+    return x->low == y->low && x->high == y->high;
+}
+
+bool constantInt64(const Constant *constant, int64_t *value) {
+    if (constant->kind != CONST_INT) {
+        return false;
+    }
+
+    const Exact exact = exactOf(constant);
+    if (exact.magnitude.high != 0 || exact.magnitude.low > (exact.negative ? 1ull << 63 : INT64_MAX)) {
+        return false;
+    }
+    *value = (int64_t)constant->low;
+    return true;
+}
+
+static int compareConstants(const Constant *x, const Constant *y) {
+    if (x->kind == CONST_FLOAT) {
+        return x->real < y->real ? -1 : x->real > y->real ? 1 : 0;
+    }
+    if (isSignedKind(x->type)) {
+        const Exact a = exactOf(x);
+        const Exact b = exactOf(y);
+        if (a.negative != b.negative) {
+            return a.negative ? -1 : 1;
+        }
+        return a.negative ? compare128(b.magnitude, a.magnitude) : compare128(a.magnitude, b.magnitude);
+    }
+    return compare128(bitsOf(x), bitsOf(y));
+}
+
+static ConstStatus foldCompare(const NodeKind op, const Constant *left, const Constant *right, Constant *result) {
+    // NaN is unordered, every comparison with it but != is false.
+    if (left->kind == CONST_FLOAT && (left->real != left->real || right->real != right->real)) {
+        *result = makeBool(op == NotEqNodeType);
+        return CONST_OK;
+    }
+
+    const int order = compareConstants(left, right);
+    switch (op) {
+        case EqNodeType: *result = makeBool(order == 0); break;
+        case NotEqNodeType: *result = makeBool(order != 0); break;
+        case LtNodeType: *result = makeBool(order < 0); break;
+        case LtEqNodeType: *result = makeBool(order <= 0); break;
+        case GtNodeType: *result = makeBool(order > 0); break;
+        default: *result = makeBool(order >= 0); break;
+    }
+    return CONST_OK;
+}
+
+static ConstStatus foldBools(const NodeKind op, const bool left, const bool right, Constant *result) {
+    switch (op) {
+        case AndNodeType: case BitAndNodeType: *result = makeBool(left && right); return CONST_OK;
+        case OrNodeType: case BitOrNodeType: *result = makeBool(left || right); return CONST_OK;
+        case BitXorNodeType: case NotEqNodeType: *result = makeBool(left != right); return CONST_OK;
+        case EqNodeType: *result = makeBool(left == right); return CONST_OK;
+        default: return CONST_UNKNOWN;
+    }
+}
+
+static ConstStatus foldFloats(const NodeKind op, const TypeKind type, const double left, const double right,
+                              Constant *result) {
+    switch (op) {
+        case AddNodeType: case AddWrapNodeType: case AddSatNodeType:
+            *result = makeFloat(type, left + right);
+            return CONST_OK;
+        case SubNodeType: case SubWrapNodeType: case SubSatNodeType:
+            *result = makeFloat(type, left - right);
+            return CONST_OK;
+        case MulNodeType: case MulWrapNodeType: case MulSatNodeType:
+            *result = makeFloat(type, left * right);
+            return CONST_OK;
+        case DivNodeType:
+            *result = makeFloat(type, left / right);
+            return CONST_OK;
+        default:
+            return CONST_UNKNOWN;
+    }
+}
+
+static ConstStatus foldShift(const NodeKind op, const Constant *left, const Constant *right, Constant *result) {
+    const TypeKind type = left->type;
+    const Exact amount = exactOf(right);
+    if (amount.negative || amount.magnitude.high != 0 || amount.magnitude.low >= (uint64_t)widthOf(type)) {
+        return CONST_SHIFT_RANGE;
+    }
+
+    const int shift = (int)amount.magnitude.low;
+    if (op == ShrNodeType) {
+        *result = makeInt(type, shr128(bitsOf(left), shift, isSignedKind(type)));
+        return CONST_OK;
+    }
+
+    const Exact factor = {shl128((U128){1, 0}, shift), false, false};
+    return finishArithmetic(op, type, exactMul(exactOf(left), factor), result);
+}
+
+ConstStatus foldBinary(const NodeKind op, const Constant *left, const Constant *right, Constant *result) {
+    if (left->kind == CONST_INT && right->kind == CONST_INT &&
+        (op == ShlNodeType || op == ShrNodeType || op == ShlSatNodeType)) {
+        return foldShift(op, left, right, result);
+    }
+    if (left->kind != right->kind || left->type != right->type || left->kind == CONST_NONE) {
+        return CONST_UNKNOWN;
+    }
+    if (op >= EqNodeType && op <= GtEqNodeType && left->kind != CONST_BOOL) {
+        return foldCompare(op, left, right, result);
+    }
+    if (left->kind == CONST_BOOL) {
+        return foldBools(op, left->low != 0, right->low != 0, result);
+    }
+    if (left->kind == CONST_FLOAT) {
+        return foldFloats(op, left->type, left->real, right->real, result);
+    }
+
+    const TypeKind type = left->type;
+    const Exact x = exactOf(left);
+    const Exact y = exactOf(right);
+    switch (op) {
+        case AddNodeType: case AddWrapNodeType: case AddSatNodeType:
+            return finishArithmetic(op, type, exactAdd(x, y), result);
+        case SubNodeType: case SubWrapNodeType: case SubSatNodeType:
+            return finishArithmetic(op, type, exactAdd(x, exactNegate(y)), result);
+        case MulNodeType: case MulWrapNodeType: case MulSatNodeType:
+            return finishArithmetic(op, type, exactMul(x, y), result);
+        case DivNodeType:
+        case ModNodeType: {
+            if (isZero(y.magnitude)) {
+                return CONST_DIVIDE_BY_ZERO;
+            }
+            U128 remainder;
+            const U128 quotient = divide128(x.magnitude, y.magnitude, &remainder);
+            Exact exact = {quotient, x.negative != y.negative && !isZero(quotient), false};
+            // MIN % -1 is an error like MIN / -1, the remainder of a quotient that doesn't fit.
+            if (op == ModNodeType && !fits(type, exact)) {
+                return CONST_OVERFLOW;
+            }
+            if (op == ModNodeType) {
+                exact = (Exact){remainder, x.negative && !isZero(remainder), false};
+            }
+            return finishArithmetic(op, type, exact, result);
+        }
+        case BitAndNodeType:
+            *result = makeInt(type, (U128){left->low & right->low, left->high & right->high});
+            return CONST_OK;
+        case BitOrNodeType:
+            *result = makeInt(type, (U128){left->low | right->low, left->high | right->high});
+            return CONST_OK;
+        case BitXorNodeType:
+            *result = makeInt(type, (U128){left->low ^ right->low, left->high ^ right->high});
+            return CONST_OK;
+        default:
+            return CONST_UNKNOWN;
+    }
+}
+
+ConstStatus foldUnary(const NodeKind op, const Constant *operand, Constant *result) {
+    switch (op) {
+        case NegNodeType:
+            if (operand->kind == CONST_FLOAT) {
+                *result = makeFloat(operand->type, -operand->real);
+                return CONST_OK;
+            }
+            if (operand->kind != CONST_INT) {
+                return CONST_UNKNOWN;
+            }
+            return finishArithmetic(op, operand->type, exactNegate(exactOf(operand)), result);
+        case NotNodeType:
+            if (operand->kind != CONST_BOOL) {
+                return CONST_UNKNOWN;
+            }
+            *result = makeBool(operand->low == 0);
+            return CONST_OK;
+        case BitNotNodeType:
+            if (operand->kind != CONST_INT) {
+                return CONST_UNKNOWN;
+            }
+            *result = makeInt(operand->type, (U128){~operand->low, ~operand->high});
+            return CONST_OK;
+        default:
+            return CONST_UNKNOWN;
+    }
+}
+
+ConstStatus foldConversion(const TypeKind to, const Constant *value, Constant *result) {
+    if (isIntegerKind(to)) {
+        if (value->kind == CONST_INT) {
+            *result = makeInt(to, bitsOf(value));
+            return CONST_OK;
+        }
+        if (value->kind == CONST_BOOL) {
+            *result = makeInt(to, (U128){value->low, 0});
+            return CONST_OK;
+        }
+        if (value->kind != CONST_FLOAT) {
+            return CONST_UNKNOWN;
+        }
+
+        // Truncated toward zero, and NaN or anything out of range doesn't fit.
+        const double magnitude = value->real < 0 ? -value->real : value->real;
+        if (magnitude != magnitude || magnitude >= 340282366920938463463374607431768211456.0) {
+            return CONST_OVERFLOW;
+        }
+        const uint64_t high = (uint64_t)(magnitude / 18446744073709551616.0);
+        const uint64_t low = (uint64_t)(magnitude - (double)high * 18446744073709551616.0);
+        const Exact exact = {{low, high}, value->real < 0 && (low != 0 || high != 0), false};
+        if (!fits(to, exact)) {
+            return CONST_OVERFLOW;
+        }
+        *result = makeInt(to, wrapExact(exact));
+        return CONST_OK;
+    }
+
+    if (isFloatKind(to)) {
+        if (value->kind == CONST_INT) {
+            *result = makeFloat(to, exactToDouble(exactOf(value)));
+        } else if (value->kind == CONST_FLOAT) {
+            *result = makeFloat(to, value->real);
+        } else {
+            return CONST_UNKNOWN;
+        }
+        return CONST_OK;
+    }
+
+    if (isBoolKind(to) && value->kind != CONST_FLOAT && value->kind != CONST_NONE) {
+        *result = makeBool(value->low != 0 || value->high != 0);
+        result->type = to;
+        return CONST_OK;
+    }
+
+    return CONST_UNKNOWN;
+}
+
+void appendConstant(StrBuffer *buf, const Constant *constant) {
+    switch (constant->kind) {
+        case CONST_INT: {
+            const Exact exact = exactOf(constant);
+            char digits[48];
+            int start = (int)sizeof(digits);
+            U128 rest = exact.magnitude;
+            do {
+                U128 digit;
+                rest = divide128(rest, (U128){10, 0}, &digit);
+                digits[--start] = (char)('0' + digit.low);
+            } while (!isZero(rest));
+            if (exact.negative) {
+                digits[--start] = '-';
+            }
+            str_buf_append_len(buf, digits + start, (int)sizeof(digits) - start);
+            break;
+        }
+        case CONST_FLOAT:
+            str_buf_append(buf, "%g", constant->real);
+            break;
+        case CONST_BOOL:
+            str_buf_append(buf, "%s", constant->low ? "true" : "false");
+            break;
+        default:
+            str_buf_append(buf, "?");
+            break;
+    }
+}
+
+// Evaluating expressions.
+
+static bool fail(ConstEval *eval, const ConstStatus status, const NodeIndex node, const TypeKind type) {
+    eval->status = status;
+    eval->node = node;
+    eval->type = type;
+    return false;
+}
+
+static bool isNumberKind(const TypeKind kind) {
+    return isIntegerKind(kind) || isFloatKind(kind);
+}
+
+static bool isLiteral(const Ast *ast, NodeIndex node) {
+    if (astKind(ast, node) == NegNodeType) {
+        node = ast->data[node].a;
+    }
+    const NodeKind kind = astKind(ast, node);
+    return kind == IntNodeType || kind == FloatNodeType || kind == CharNodeType;
+}
+
+static TypeKind kindOfType(const ConstEval *eval, const TypeId type) {
+    if (type == TYPE_ID_NONE) {
+        return TYPE_NONE;
+    }
+
+    const Type *t = typeOf(eval->types, type);
+    return t->form == FORM_PRIMITIVE ? (TypeKind)t->a : TYPE_NONE;
+}
+
+// A number literal, negated or not, as a constant of want, or of its own type.
+static bool evaluateLiteral(ConstEval *eval, const NodeIndex node, const NodeIndex literal, const TypeKind want,
+                            const bool negative, Constant *result) {
+    const Ast *ast = &eval->file->ast;
+    const NodeData data = ast->data[literal];
+
+    if (astKind(ast, literal) == FloatNodeType) {
+        if (isIntegerKind(want)) {
+            return fail(eval, CONST_UNKNOWN, node, want);
+        }
+        double value;
+        const uint64_t bits = (uint64_t)ast->extra[data.a + 1] << 32 | ast->extra[data.a];
+        memcpy(&value, &bits, sizeof(value));
+        *result = makeFloat(isFloatKind(want) ? want : data.b == 32 ? TYPE_F32 : TYPE_F64, negative ? -value : value);
+        return true;
+    }
+
+    const TypeKind own = astKind(ast, literal) == CharNodeType ? TYPE_CHAR : TYPE_S32;
+    const TypeKind type = isNumberKind(want) ? want : own;
+    if (astKind(ast, literal) == IntNodeType && data.b == INT_OVERFLOW) {
+        return fail(eval, CONST_OVERFLOW, node, type);
+    }
+
+    U128 magnitude = {data.a, 0};
+    if (astKind(ast, literal) == IntNodeType && data.b == INT_WIDE) {
+        const uint32_t *words = ast->extra + data.a;
+        magnitude = (U128){(uint64_t)words[1] << 32 | words[0], (uint64_t)words[3] << 32 | words[2]};
+    }
+    const Exact exact = {magnitude, negative && !isZero(magnitude), false};
+    if (isFloatKind(type)) {
+        *result = makeFloat(type, exactToDouble(exact));
+        return true;
+    }
+    if (!fits(type, exact)) {
+        return fail(eval, CONST_OVERFLOW, node, type);
+    }
+
+    *result = makeInt(type, wrapExact(exact));
+    return true;
+}
+
+static bool checkStatus(ConstEval *eval, const ConstStatus status, const NodeIndex node, const TypeKind type) {
+    return status == CONST_OK || fail(eval, status, node, type);
+}
+
+// cast(x, T) and conversions named by a type, u64(x).
+static bool evaluateConversion(ConstEval *eval, const NodeIndex node, Constant *result) {
+    const Ast *ast = &eval->file->ast;
+    const NodeData data = ast->data[node];
+    if (astKind(ast, data.a) != IdentNodeType) {
+        return fail(eval, CONST_UNKNOWN, node, TYPE_NONE);
+    }
+
+    int argCount;
+    const uint32_t *args = astList(ast, data.b, &argCount);
+    int len = 0;
+    const char *name = symbolName(eval->interner, astSymbol(ast, ast->data[data.a].a), &len);
+    const NiftyTokenType keyword = keywordType(name, len);
+    NodeIndex typeNode;
+    if (keyword == TK_CAST && argCount == 2) {
+        typeNode = args[1];
+    } else if (keyword >= TK_INT && keyword <= TK_ANY_TYPE && argCount == 1) {
+        typeNode = data.a;
+    } else {
+        return fail(eval, CONST_UNKNOWN, node, TYPE_NONE);
+    }
+
+    const TypeKind to = kindOfType(eval, typeFromNode(eval->types, eval->symbols, eval->file, typeNode));
+    if (to == TYPE_NONE) {
+        return fail(eval, CONST_UNKNOWN, node, TYPE_NONE);
+    }
+
+    // A literal is taken as the type, like cast(1, u64) is 1 of u64.
+    if (isLiteral(ast, args[0])) {
+        return evaluateConstant(eval, args[0], to, result);
+    }
+
+    Constant value;
+    if (!evaluateConstant(eval, args[0], TYPE_NONE, &value)) {
+        return false;
+    }
+    return checkStatus(eval, foldConversion(to, &value, result), node, to);
+}
+
+static bool evaluateBinary(ConstEval *eval, const NodeIndex node, const TypeKind want, Constant *result) {
+    const Ast *ast = &eval->file->ast;
+    const NodeKind op = astKind(ast, node);
+    const NodeData data = ast->data[node];
+
+    // The operands of comparisons have their own type, shift amounts too.
+    const bool shift = op == ShlNodeType || op == ShrNodeType || op == ShlSatNodeType;
+    const TypeKind operands = (op >= EqNodeType && op <= GtEqNodeType) || op == AndNodeType || op == OrNodeType
+                                  ? TYPE_NONE
+                                  : want;
+    Constant left;
+    Constant right;
+    if (shift) {
+        if (!evaluateConstant(eval, data.a, operands, &left) || !evaluateConstant(eval, data.b, TYPE_NONE, &right)) {
+            return false;
+        }
+    } else if (isLiteral(ast, data.a) && !isLiteral(ast, data.b)) {
+        if (!evaluateConstant(eval, data.b, operands, &right) ||
+            !evaluateConstant(eval, data.a, right.kind == CONST_BOOL ? TYPE_NONE : right.type, &left)) {
+            return false;
+        }
+    } else if (!evaluateConstant(eval, data.a, operands, &left) ||
+               !evaluateConstant(eval, data.b, left.kind == CONST_BOOL ? TYPE_NONE : left.type, &right)) {
+        return false;
+    }
+
+    return checkStatus(eval, foldBinary(op, &left, &right, result), node, left.type);
+}
+
+bool evaluateConstant(ConstEval *eval, const NodeIndex node, const TypeKind want, Constant *result) {
+    const Ast *ast = &eval->file->ast;
+    const NodeData data = ast->data[node];
+    const NodeKind kind = astKind(ast, node);
+
+    switch (kind) {
+        case IntNodeType:
+        case FloatNodeType:
+        case CharNodeType:
+            return evaluateLiteral(eval, node, node, want, false, result);
+        case BoolNodeType:
+            *result = makeBool(data.a != 0);
+            result->type = isBoolKind(want) ? want : TYPE_B32;
+            return true;
+        case IdentNodeType:
+            return eval->lookup != nullptr ? eval->lookup(eval, node, result)
+                                           : fail(eval, CONST_UNKNOWN, node, TYPE_NONE);
+        case NegNodeType: {
+            if (isLiteral(ast, node)) {
+                return evaluateLiteral(eval, node, data.a, want, true, result);
+            }
+            Constant operand;
+            return evaluateConstant(eval, data.a, want, &operand) &&
+                   checkStatus(eval, foldUnary(kind, &operand, result), node, operand.type);
+        }
+        case NotNodeType:
+        case BitNotNodeType: {
+            Constant operand;
+            return evaluateConstant(eval, data.a, kind == NotNodeType ? TYPE_NONE : want, &operand) &&
+                   checkStatus(eval, foldUnary(kind, &operand, result), node, operand.type);
+        }
+        case TernaryNodeType: {
+            Constant condition;
+            if (!evaluateConstant(eval, data.a, TYPE_NONE, &condition)) {
+                return false;
+            }
+            if (condition.kind != CONST_BOOL) {
+                return fail(eval, CONST_UNKNOWN, data.a, TYPE_NONE);
+            }
+            return evaluateConstant(eval, ast->extra[data.b + (condition.low ? 0 : 1)], want, result);
+        }
+        case CallNodeType:
+            return evaluateConversion(eval, node, result);
+        default:
+            if (kind >= AddNodeType && kind <= OrNodeType) {
+                return evaluateBinary(eval, node, want, result);
+            }
+            return fail(eval, CONST_UNKNOWN, node, TYPE_NONE);
+    }
+}
+
+bool convertConstant(ConstEval *eval, const NodeIndex node, const TypeKind to, Constant *value) {
+    if (to == TYPE_NONE || value->type == to) {
+        return true;
+    }
+
+    if (value->kind == CONST_INT && isIntegerKind(to)) {
+        const Exact exact = exactOf(value);
+        if (!fits(to, exact)) {
+            return fail(eval, CONST_OVERFLOW, node, to);
+        }
+        *value = makeInt(to, wrapExact(exact));
+    } else if ((value->kind == CONST_INT || value->kind == CONST_FLOAT) && isFloatKind(to)) {
+        foldConversion(to, value, value);
+    } else if (value->kind == CONST_BOOL && isBoolKind(to)) {
+        value->type = to;
+    }
+    return true;
+}
+
+// Tables.
+
+void addConstant(ConstantTable *table, const NodeIndex node, const Constant *value) {
+    if (table->count == table->capacity) {
+        table->entries = (ConstantEntry *)array_grow(table->entries, &table->capacity, sizeof(ConstantEntry));
+    }
+
+    int at = table->count;
+    while (at > 0 && table->entries[at - 1].node > node) {
+        --at;
+    }
+    memmove(table->entries + at + 1, table->entries + at, sizeof(ConstantEntry) * (table->count - at));
+    table->entries[at].node = node;
+    table->entries[at].value = *value;
+    ++table->count;
+}
+
+const Constant *findConstant(const ConstantTable *table, const NodeIndex node) {
+    if (table == nullptr) {
+        return nullptr;
+    }
+
+    int low = 0;
+    int high = table->count - 1;
+    while (low <= high) {
+        const int middle = (low + high) / 2;
+        const NodeIndex at = table->entries[middle].node;
+        if (at == node) {
+            return &table->entries[middle].value;
+        }
+        if (at < node) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return nullptr;
+}
+
+void freeConstants(ConstantTable *table) {
+    free(table->entries);
+    table->entries = nullptr;
+    table->count = 0;
+    table->capacity = 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_CONSTEVAL_H
+#define NIFTY_CONSTEVAL_H
+
+#include <stdint.h>
+
+#include "ast.h"
+#include "common.h"
+#include "parser.h"
+#include "symtab.h"
+#include "types.h"
+#include "util/str.h"
+
+// Values worked out at compile time: const and ::= declarations, #set macros and array sizes while checking, and the
+// instructions of constant operands folded by the fold pass, with one set of rules for both.
+//
+// Integers are exact for every width from u8 to s128. Plain + - * that leave their type are errors, %+ %- %* wrap,
+// @+ @- @* @<< clamp to the type's range, and << drops the bits shifted out. Floats are doubles, rounded to float for
+// f16 and f32.
+
+typedef enum {
+    CONST_NONE,
+    CONST_INT,
+    CONST_FLOAT,
+    CONST_BOOL,
+} ConstKind;
+
+typedef struct {
+    ConstKind kind;
+    TypeKind type;
+    // CONST_INT: the value in 128 bits, sign or zero extended from its type like IntNodeType. CONST_BOOL: 0 or 1.
+    uint64_t low;
+    uint64_t high;
+    double real; // CONST_FLOAT.
+} Constant;
+
+typedef enum {
+    CONST_OK,
+    CONST_UNKNOWN,        // Not a constant expression, or one the evaluator can't do.
+    CONST_OVERFLOW,       // The result doesn't fit its type.
+    CONST_DIVIDE_BY_ZERO,
+    CONST_SHIFT_RANGE,    // Shifted by at least the width of the type.
+    CONST_REPORTED,       // Depends on a constant whose error was already reported.
+} ConstStatus;
+
+bool isIntegerKind(TypeKind kind);
+bool isSignedKind(TypeKind kind);
+bool isFloatKind(TypeKind kind);
+bool isBoolKind(TypeKind kind);
+
+Constant intConstant(TypeKind type, int64_t value);
+// From the four words of an IntNodeType or IR_INT, low to high.
+Constant wordsConstant(TypeKind type, const uint32_t words[4]);
+void constantWords(const Constant *constant, uint32_t words[4]);
+bool sameConstant(const Constant *x, const Constant *y);
+// Whether a constant is an integer of at most 64 bits once read as its type, and its value if so.
+bool constantInt64(const Constant *constant, int64_t *value);
+
+// op is the node kind of the operator, from AddNodeType to OrNodeType, also for the fold pass.
+ConstStatus foldBinary(NodeKind op, const Constant *left, const Constant *right, Constant *result);
+// NegNodeType, NotNodeType or BitNotNodeType. Negation is checked.
+ConstStatus foldUnary(NodeKind op, const Constant *operand, Constant *result);
+// cast(value, to): integers keep their low bits, floats are truncated and must fit.
+ConstStatus foldConversion(TypeKind to, const Constant *value, Constant *result);
+
+void appendConstant(StrBuffer *buf, const Constant *constant);
+
+typedef struct ConstEval ConstEval;
+
+// The value of the name node, an IdentNodeType. Sets status and returns false when it has none.
+typedef bool (*ConstLookupFn)(ConstEval *eval, NodeIndex name, Constant *value);
+
+struct ConstEval {
+    TypeTable *types;
+    const SymbolTable *symbols;
+    const ParseResults *file;
+    Interner *interner;
+    ConstLookupFn lookup;
+    void *context;
+
+    // Why the last evaluation failed, and where.
+    ConstStatus status;
+    NodeIndex node;
+    TypeKind type;
+};
+
+// Evaluates the expression node of eval's file. Literals take the type want when it is a number type, and give an
+// operator the type of its other side, as they do when checking. Returns false and sets status, node and type if the
+// expression isn't constant or fails.
+bool evaluateConstant(ConstEval *eval, NodeIndex node, TypeKind want, Constant *result);
+// A constant of the type it is given to: integers must fit, and an integer given to a float becomes one.
+bool convertConstant(ConstEval *eval, NodeIndex node, TypeKind to, Constant *value);
+
+// The constant values of one file, by node: the values of constant declarations.
+typedef struct {
+    NodeIndex node;
+    Constant value;
+} ConstantEntry;
+
+typedef struct {
+    ConstantEntry *entries; // Sorted by node.
+    int count;
+    int capacity;
+} ConstantTable;
+
+// Adds in order of node, quickest for nodes added in increasing order.
+void addConstant(ConstantTable *table, NodeIndex node, const Constant *value);
+// nullptr if node has no value in the table, or there is no table.
+const Constant *findConstant(const ConstantTable *table, NodeIndex node);
+void freeConstants(ConstantTable *table);
+
+#endif //NIFTY_CONSTEVAL_H
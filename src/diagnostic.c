@@ -0,0 +1,317 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "diagnostic.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    const char *label; // Before the message in text output.
+    const char *text;
+    int argCount;
+    bool highlight; // Arguments are drawn in HIGHLIGHT_COLOR.
+} DiagnosticKind;
+
+static const DiagnosticKind kinds[DIAG_ID_COUNT] = {
+    [DIAG_SYNTAX] = {"syntax", "Parse error", "{0}", 1, false},
+    [DIAG_LEXER] = {"lexer", "Parse error", "{0}", 1, false},
+    [DIAG_EXPECTED_AFTER] = {"expected-after", "Parse error", "Expected {0} after {1}, got {2} instead.", 3, true},
+    [DIAG_NAMESPACE_SET] = {"namespace-set", "Parse error", "Namespace already set on line {0}.", 1, false},
+    [DIAG_NAMESPACE_NOT_FOUND] = {"namespace-not-found", "Error", "Could not find namespace \"{0}\".", 1, false},
+    [DIAG_UNDECLARED] = {"undeclared", "Error", "{0} is not declared.", 1, true},
+    [DIAG_TYPE_MISMATCH] = {"type-mismatch", "Error", "Expected {0}, got {1}.", 2, true},
+    [DIAG_ARGUMENT_COUNT] = {"argument-count", "Error", "{0} takes {1} arguments, got {2}.", 3, true},
+    [DIAG_RETURN_COUNT] = {"return-count", "Error", "Expected {0} return values, got {1}.", 2, false},
+    [DIAG_ASSIGN_CONSTANT] = {"assign-constant", "Error", "Cannot assign to {0}, it is a constant.", 1, true},
+    [DIAG_NOT_CONSTANT] = {"not-constant", "Error", "The value of {0} must be known at compile time.", 1, true},
+    [DIAG_CONSTANT_OVERFLOW] = {"constant-overflow", "Error", "Constant expression overflows {0}.", 1, true},
+    [DIAG_LITERAL_RANGE] = {"literal-range", "Error", "Literal doesn't fit in {0}.", 1, true},
+    [DIAG_DIVIDE_BY_ZERO] = {"divide-by-zero", "Error", "Division by zero in a constant expression.", 0, false},
+    [DIAG_SHIFT_RANGE] = {"shift-range", "Error", "Shift amount is out of range for {0}.", 1, true},
+    [DIAG_ARRAY_SIZE] = {"array-size", "Error",
+                         "The size of an array must be an integer known at compile time, and not negative.", 0, false},
+    [DIAG_UNKNOWN_TYPE] = {"unknown-type", "Error", "The type of this expression isn't known, so it can't be compiled.",
+                           0, false},
+};
+
+#define DIAGNOSTIC_ARENA_BLOCK (4 * 1024)
+
+void initDiagnostics(DiagnosticBuffer *buffer) {
+    buffer->items = nullptr;
+    buffer->count = 0;
+    buffer->capacity = 0;
+    buffer->errorCount = 0;
+    buffer->warningCount = 0;
+    arena_init(&buffer->arena, DIAGNOSTIC_ARENA_BLOCK);
+}
+
+void freeDiagnostics(DiagnosticBuffer *buffer) {
+    free(buffer->items);
+    arena_free(&buffer->arena);
+    buffer->items = nullptr;
+    buffer->count = 0;
+    buffer->capacity = 0;
+}
+
+void reportDiagnostic(DiagnosticBuffer *buffer, Lexer *lexer, const Severity severity, const DiagnosticId id,
+                      const uint32_t offset, const uint32_t length, ...) {
+    if (buffer->count == buffer->capacity) {
+        const int capacity = buffer->capacity == 0 ? 8 : buffer->capacity * 2;
+        Diagnostic *items = (Diagnostic *)realloc(buffer->items, sizeof(Diagnostic) * capacity);
+        if (items == nullptr) {
+            return;
+        }
+        buffer->items = items;
+        buffer->capacity = capacity;
+    }
+
+    Diagnostic *diagnostic = &buffer->items[buffer->count++];
+    diagnostic->severity = severity;
+    diagnostic->id = id;
+    diagnostic->offset = offset;
+    diagnostic->length = length;
+
+    va_list args;
+    va_start(args, length);
+    for (int i = 0; i < DIAGNOSTIC_MAX_ARGS; ++i) {
+        const char *arg = i < kinds[id].argCount ? va_arg(args, const char *) : nullptr;
+        diagnostic->args[i] = arg != nullptr ? arena_str(&buffer->arena, arg, str_len(arg)) : "";
+    }
+    va_end(args);
+
+    diagnostic->line = 0;
+    diagnostic->column = 0;
+    diagnostic->source = "";
+    diagnostic->sourceLength = 0;
+    if (lexer != nullptr) {
+        const SourceLocation location = lexerLocation(lexer, offset);
+        int len = 0;
+        const char *line = lexerLine(lexer, location.line, &len);
+        diagnostic->line = location.line;
+        diagnostic->column = location.column;
+        diagnostic->source = line != nullptr ? arena_str(&buffer->arena, line, len) : "";
+        diagnostic->sourceLength = line != nullptr ? len : 0;
+    }
+
+    if (severity == SEVERITY_ERROR) {
+        ++buffer->errorCount;
+    } else {
+        ++buffer->warningCount;
+    }
+}
+
+const char *diagnosticName(const DiagnosticId id) {
+    return id < DIAG_ID_COUNT ? kinds[id].name : "unknown";
+}
+
+// Fills in the arguments of the message, in color when config is given and asks for it.
+static void formatMessage(StrBuffer *out, const Diagnostic *diagnostic, const CompilerConfig *config) {
+    const DiagnosticKind *kind = &kinds[diagnostic->id];
+    const char *text = kind->text;
+    const char *run = text;
+    for (const char *c = text; *c; ++c) {
+        if (c[0] != '{' || c[1] < '0' || c[1] > '2' || c[2] != '}') {
+            continue;
+        }
+
+        str_buf_append_len(out, run, (int)(c - run));
+        if (kind->highlight) {
+            str_buf_color(out, config, HIGHLIGHT_COLOR);
+        }
+        const char *arg = diagnostic->args[c[1] - '0'];
+        str_buf_append_len(out, arg, str_len(arg));
+        if (kind->highlight) {
+            str_buf_color(out, config, RESET_COLOR);
+        }
+
+        c += 2;
+        run = c + 1;
+    }
+    str_buf_append_len(out, run, str_len(run));
+}
+
+void diagnosticMessage(StrBuffer *out, const Diagnostic *diagnostic) {
+    formatMessage(out, diagnostic, nullptr);
+}
+
+// file:L1,C2: Parse error: message
+// 1 | source line
+//   | ~^
+static void renderText(StrBuffer *out, const char *file, const Diagnostic *diagnostic, const CompilerConfig *config) {
+    const bool error = diagnostic->severity == SEVERITY_ERROR;
+    str_buf_append(out, "%s:L%d,C%d: ", file, diagnostic->line, diagnostic->column);
+    str_buf_color(out, config, error ? ERROR_COLOR : WARN_COLOR);
+    str_buf_append(out, "%s: ", error ? kinds[diagnostic->id].label : "Warning");
+    str_buf_color(out, config, RESET_COLOR);
+    formatMessage(out, diagnostic, config);
+    str_buf_append_len(out, "\n", 1);
+
+    if (diagnostic->line <= 0) {
+        return;
+    }
+
+    int width = 1;
+    for (int n = diagnostic->line; n >= 10; n /= 10, ++width) {}
+
+    str_buf_color(out, config, LINE_COLOR);
+    str_buf_append(out, "%d | ", diagnostic->line);
+    str_buf_color(out, config, RESET_COLOR);
+    str_buf_append_len(out, diagnostic->source, diagnostic->sourceLength);
+    str_buf_append_len(out, "\n", 1);
+    str_buf_color(out, config, LINE_COLOR);
+    str_buf_repeat(out, ' ', width + 1);
+    str_buf_append_len(out, "| ", 2);
+    str_buf_repeat(out, '~', diagnostic->column - 1);
+    str_buf_append_len(out, "^\n", 2);
+    str_buf_color(out, config, RESET_COLOR);
+}
+
+static void jsonString(StrBuffer *out, const char *s, const int len) {
+    str_buf_append_len(out, "\"", 1);
+    const char *run = s;
+    for (int i = 0; i < len; ++i) {
+        const unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        str_buf_append_len(out, run, (int)(s + i - run));
+        switch (c) {
+            case '"': str_buf_append_len(out, "\\\"", 2); break;
+            case '\\': str_buf_append_len(out, "\\\\", 2); break;
+            case '\n': str_buf_append_len(out, "\\n", 2); break;
+            case '\r': str_buf_append_len(out, "\\r", 2); break;
+            case '\t': str_buf_append_len(out, "\\t", 2); break;
+            default: str_buf_append(out, "\\u%04x", c); break;
+        }
+        run = s + i + 1;
+    }
+    str_buf_append_len(out, run, (int)(s + len - run));
+    str_buf_append_len(out, "\"", 1);
+}
+
+static void renderJson(StrBuffer *out, const char *file, const Diagnostic *diagnostic, const bool first) {
+    str_buf_append(out, "%s\n  {\"file\": ", first ? "" : ",");
+    jsonString(out, file, str_len(file));
+    str_buf_append(out, ", \"line\": %d, \"column\": %d, \"offset\": %u, \"length\": %u, \"severity\": \"%s\", \"id\": \"%s\"",
+                   diagnostic->line, diagnostic->column, diagnostic->offset, diagnostic->length,
+                   diagnostic->severity == SEVERITY_ERROR ? "error" : "warning", diagnosticName(diagnostic->id));
+
+    StrBuffer message;
+    str_buf_init(&message);
+    diagnosticMessage(&message, diagnostic);
+    str_buf_append_len(out, ", \"message\": ", 13);
+    jsonString(out, message.data != nullptr ? message.data : "", message.len);
+    str_buf_free(&message);
+
+    str_buf_append_len(out, ", \"args\": [", 11);
+    for (int i = 0; i < kinds[diagnostic->id].argCount; ++i) {
+        if (i > 0) {
+            str_buf_append_len(out, ", ", 2);
+        }
+        jsonString(out, diagnostic->args[i], str_len(diagnostic->args[i]));
+    }
+    str_buf_append_len(out, "]}", 2);
+}
+
+typedef struct {
+    int file;
+    const Diagnostic *diagnostic;
+} DiagnosticRef;
+
+static int compareDiagnostics(const void *a, const void *b) {
+    const DiagnosticRef *x = (const DiagnosticRef *)a;
+    const DiagnosticRef *y = (const DiagnosticRef *)b;
+    if (x->file != y->file) {
+        return x->file < y->file ? -1 : 1;
+    }
+    if (x->diagnostic->offset != y->diagnostic->offset) {
+        return x->diagnostic->offset < y->diagnostic->offset ? -1 : 1;
+    }
+    if (x->diagnostic->severity != y->diagnostic->severity) {
+        return x->diagnostic->severity < y->diagnostic->severity ? -1 : 1;
+    }
+    if (x->diagnostic->id != y->diagnostic->id) {
+        return x->diagnostic->id < y->diagnostic->id ? -1 : 1;
+    }
+
+    for (int i = 0; i < DIAGNOSTIC_MAX_ARGS; ++i) {
+        const int order = strcmp(x->diagnostic->args[i], y->diagnostic->args[i]);
+        if (order != 0) {
+            return order;
+        }
+    }
+
+    return 0;
+}
+
+int renderDiagnostics(StrBuffer *out, const char **files, const DiagnosticBuffer **buffers, const int count,
+                      const CompilerConfig *config, const bool json) {
+    int total = 0;
+    for (int i = 0; i < count; ++i) {
+        total += buffers[i]->count;
+    }
+
+    DiagnosticRef *refs = (DiagnosticRef *)malloc(sizeof(DiagnosticRef) * (total > 0 ? total : 1));
+    if (refs == nullptr) {
+        return 0;
+    }
+
+    int at = 0;
+    for (int i = 0; i < count; ++i) {
+        for (int j = 0; j < buffers[i]->count; ++j) {
+            refs[at].file = i;
+            refs[at].diagnostic = &buffers[i]->items[j];
+            ++at;
+        }
+    }
+    qsort(refs, total, sizeof(DiagnosticRef), compareDiagnostics);
+
+    int errors = 0;
+    int rendered = 0;
+    if (json) {
+        str_buf_append_len(out, "[", 1);
+    }
+    for (int i = 0; i < total; ++i) {
+        if (i > 0 && compareDiagnostics(&refs[i - 1], &refs[i]) == 0) {
+            continue;
+        }
+
+        const char *file = files[refs[i].file];
+        if (json) {
+            renderJson(out, file, refs[i].diagnostic, rendered == 0);
+        } else {
+            renderText(out, file, refs[i].diagnostic, config);
+        }
+        errors += refs[i].diagnostic->severity == SEVERITY_ERROR;
+        ++rendered;
+    }
+    if (json) {
+        str_buf_append_len(out, rendered > 0 ? "\n]\n" : "]\n", rendered > 0 ? 3 : 2);
+    }
+
+    free(refs);
+    return errors;
+}
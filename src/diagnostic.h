@@ -0,0 +1,105 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_DIAGNOSTIC_H
+#define NIFTY_DIAGNOSTIC_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "lexer.h"
+#include "util/arena.h"
+#include "util/str.h"
+
+// Errors and warnings are recorded as data while compiling and rendered once at the end: sorted by file and position,
+// with duplicates dropped, as text for people or JSON for tools, in one write.
+
+typedef enum {
+    SEVERITY_ERROR,
+    SEVERITY_WARNING,
+} Severity;
+
+// Every kind of message. The text of each, with {0} to {2} standing for its arguments, is in diagnostic.c.
+typedef enum {
+    DIAG_SYNTAX,              // {0} is the whole message.
+    DIAG_LEXER,               // {0} is the lexer's message for an error token.
+    DIAG_EXPECTED_AFTER,      // Expected {0} after {1}, got {2} instead.
+    DIAG_NAMESPACE_SET,       // Namespace already set on line {0}.
+    DIAG_NAMESPACE_NOT_FOUND, // Could not find namespace "{0}".
+    DIAG_UNDECLARED,          // {0} is not declared.
+    DIAG_TYPE_MISMATCH,       // Expected {0}, got {1}.
+    DIAG_ARGUMENT_COUNT,      // {0} takes {1} arguments, got {2}.
+    DIAG_RETURN_COUNT,        // Expected {0} return values, got {1}.
+    DIAG_ASSIGN_CONSTANT,     // Cannot assign to {0}, it is a constant.
+    DIAG_NOT_CONSTANT,        // The value of {0} must be known at compile time.
+    DIAG_CONSTANT_OVERFLOW,   // Constant expression overflows {0}.
+    DIAG_LITERAL_RANGE,       // Literal doesn't fit in {0}.
+    DIAG_DIVIDE_BY_ZERO,      // Division by zero in a constant expression.
+    DIAG_SHIFT_RANGE,         // Shift amount is out of range for {0}.
+    DIAG_ARRAY_SIZE,          // The size of an array must be an integer known at compile time, and not negative.
+    DIAG_UNKNOWN_TYPE,        // The type of this expression isn't known, so it can't be compiled.
+
+    DIAG_ID_COUNT
+} DiagnosticId;
+
+#define DIAGNOSTIC_MAX_ARGS 3
+
+typedef struct {
+    Severity severity;
+    DiagnosticId id;
+    uint32_t offset; // Span in the file's source.
+    uint32_t length;
+    int line;
+    int column;
+    const char *args[DIAGNOSTIC_MAX_ARGS];
+    const char *source; // The line it is on, not NUL terminated.
+    int sourceLength;
+} Diagnostic;
+
+// The diagnostics of one file. Only the task working on the file writes to it, so it needs no lock.
+typedef struct {
+    Diagnostic *items;
+    int count;
+    int capacity;
+    int errorCount;
+    int warningCount;
+    Arena arena; // Arguments and source lines.
+} DiagnosticBuffer;
+
+void initDiagnostics(DiagnosticBuffer *buffer);
+void freeDiagnostics(DiagnosticBuffer *buffer);
+
+// Copies the arguments, as many as id takes, and the line at offset from lexer.
+void reportDiagnostic(DiagnosticBuffer *buffer, Lexer *lexer, Severity severity, DiagnosticId id, uint32_t offset,
+                      uint32_t length, ...);
+
+// The message with its arguments filled in.
+void diagnosticMessage(StrBuffer *out, const Diagnostic *diagnostic);
+// Short name of id for tools, like "expected-after".
+const char *diagnosticName(DiagnosticId id);
+
+// Renders the buffers of count files, in the order given, as text, or as a JSON array when json is set. Returns the
+// number of errors rendered, after dropping duplicates.
+int renderDiagnostics(StrBuffer *out, const char **files, const DiagnosticBuffer **buffers, int count,
+                      const CompilerConfig *config, bool json);
+
+#endif //NIFTY_DIAGNOSTIC_H
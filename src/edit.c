@@ -0,0 +1,337 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "edit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/str.h"
+
+// Gap left when the text or token arrays have to grow.
+#define EDIT_MIN_GAP 4096
+#define EDIT_MIN_TOKEN_GAP 1024
+// Text moved out of the gap before lexing after an edit. Doubles whenever a token runs into the gap.
+#define EDIT_LEX_WINDOW 256
+
+// Moves the text gap to offset.
+static void moveGap(EditBuffer *buffer, const size_t offset) {
+    if (offset < buffer->gapStart) {
+        const size_t n = buffer->gapStart - offset;
+        memmove(buffer->text + buffer->gapEnd - n, buffer->text + offset, n);
+        buffer->gapStart -= n;
+        buffer->gapEnd -= n;
+    } else if (offset > buffer->gapStart) {
+        const size_t n = offset - buffer->gapStart;
+        memmove(buffer->text + buffer->gapStart, buffer->text + buffer->gapEnd, n);
+        buffer->gapStart += n;
+        buffer->gapEnd += n;
+    }
+
+    buffer->text[buffer->gapStart] = '\0';
+}
+
+// Makes the text gap larger than size, it never closes completely so text[gapStart] can always be '\0'.
+static bool reserveGap(EditBuffer *buffer, const size_t size) {
+    if (buffer->gapEnd - buffer->gapStart > size) {
+        return true;
+    }
+
+    const size_t tail = buffer->capacity - buffer->gapEnd;
+    const size_t capacity = max(buffer->capacity * 2, buffer->length + size + EDIT_MIN_GAP);
+    char *text = (char *)realloc(buffer->text, capacity + NIFTY_SOURCE_PADDING);
+    if (text == nullptr) {
+        println("Out of memory.");
+        return false;
+    }
+
+    memmove(text + capacity - tail, text + buffer->gapEnd, tail);
+    memset(text + capacity, 0, NIFTY_SOURCE_PADDING);
+    buffer->text = text;
+    buffer->gapEnd = capacity - tail;
+    buffer->capacity = capacity;
+    return true;
+}
+
+static uint32_t tokenOffset(const EditBuffer *buffer, const int index) {
+    if (index < buffer->tokenGapStart) {
+        return buffer->offsets[index];
+    }
+
+    const int at = index + buffer->tokenGapEnd - buffer->tokenGapStart;
+    return (uint32_t)buffer->length - buffer->offsets[at];
+}
+
+static uint32_t tokenLength(const EditBuffer *buffer, const int index) {
+    if (index < buffer->tokenGapStart) {
+        return buffer->lengths[index];
+    }
+
+    return buffer->lengths[index + buffer->tokenGapEnd - buffer->tokenGapStart];
+}
+
+// Moves the token gap to index, switching the offsets of the tokens that cross it between the two ways they're kept.
+static void moveTokenGap(EditBuffer *buffer, const int index) {
+    const uint32_t length = (uint32_t)buffer->length;
+    while (buffer->tokenGapStart > index) {
+        const int from = --buffer->tokenGapStart;
+        const int to = --buffer->tokenGapEnd;
+        buffer->kinds[to] = buffer->kinds[from];
+        buffer->offsets[to] = length - buffer->offsets[from];
+        buffer->lengths[to] = buffer->lengths[from];
+    }
+
+    while (buffer->tokenGapStart < index) {
+        const int from = buffer->tokenGapEnd++;
+        const int to = buffer->tokenGapStart++;
+        buffer->kinds[to] = buffer->kinds[from];
+        buffer->offsets[to] = length - buffer->offsets[from];
+        buffer->lengths[to] = buffer->lengths[from];
+    }
+}
+
+static void pushToken(EditBuffer *buffer, const NiftyTokenType type, const uint32_t offset, const uint32_t len) {
+    if (buffer->tokenGapStart == buffer->tokenGapEnd) {
+        const int tail = buffer->tokenCapacity - buffer->tokenGapEnd;
+        const int capacity = max(buffer->tokenCapacity * 2, buffer->tokenCapacity + EDIT_MIN_TOKEN_GAP);
+        buffer->kinds = (uint8_t *)realloc(buffer->kinds, sizeof(uint8_t) * capacity);
+        buffer->offsets = (uint32_t *)realloc(buffer->offsets, sizeof(uint32_t) * capacity);
+        buffer->lengths = (uint32_t *)realloc(buffer->lengths, sizeof(uint32_t) * capacity);
+
+        memmove(buffer->kinds + capacity - tail, buffer->kinds + buffer->tokenGapEnd, sizeof(uint8_t) * tail);
+        memmove(buffer->offsets + capacity - tail, buffer->offsets + buffer->tokenGapEnd, sizeof(uint32_t) * tail);
+        memmove(buffer->lengths + capacity - tail, buffer->lengths + buffer->tokenGapEnd, sizeof(uint32_t) * tail);
+        buffer->tokenGapEnd = capacity - tail;
+        buffer->tokenCapacity = capacity;
+    }
+
+    buffer->kinds[buffer->tokenGapStart] = (uint8_t)type;
+    buffer->offsets[buffer->tokenGapStart] = offset;
+    buffer->lengths[buffer->tokenGapStart] = len;
+    ++buffer->tokenGapStart;
+}
+
+// Index of the token after the gap that starts fromEnd bytes before the end of the text, -1 if there isn't one.
+static int findTokenAfterGap(const EditBuffer *buffer, const uint32_t fromEnd) {
+    int lo = buffer->tokenGapEnd;
+    int hi = buffer->tokenCapacity - 1;
+    while (lo <= hi) {
+        const int mid = lo + (hi - lo) / 2;
+        if (buffer->offsets[mid] == fromEnd) {
+            return mid;
+        }
+
+        // Further along means closer to the end.
+        if (buffer->offsets[mid] > fromEnd) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+static Lexer lexerAt(const EditBuffer *buffer, const size_t offset) {
+    Lexer lexer;
+    lexer.source = buffer->text;
+    lexer.length = buffer->gapStart;
+    lexer.mappedSize = 0;
+    lexer.current = buffer->text + offset;
+    lexer.start = lexer.current;
+    lexer.prev = '\0';
+    lexer.interner = nullptr;
+    lexer.symbols = nullptr;
+    lexer.lineStarts = nullptr;
+    lexer.lineCount = 0;
+
+    return lexer;
+}
+
+EditBuffer *initEditBuffer(const char *text, const size_t length) {
+    if (length >= UINT32_MAX) {
+        println("Source is too large for a token stream.");
+        return nullptr;
+    }
+
+    EditBuffer *buffer = (EditBuffer *)malloc(sizeof(EditBuffer));
+    buffer->capacity = length + EDIT_MIN_GAP;
+    buffer->text = (char *)malloc(buffer->capacity + NIFTY_SOURCE_PADDING);
+    if (buffer->text == nullptr) {
+        println("Out of memory.");
+        free(buffer);
+        return nullptr;
+    }
+
+    memcpy(buffer->text, text, length);
+    memset(buffer->text + buffer->capacity, 0, NIFTY_SOURCE_PADDING);
+    buffer->length = length;
+    buffer->gapStart = length;
+    buffer->gapEnd = buffer->capacity;
+    buffer->text[length] = '\0';
+
+    buffer->tokenCapacity = 0;
+    buffer->tokenGapStart = 0;
+    buffer->tokenGapEnd = 0;
+    buffer->kinds = nullptr;
+    buffer->offsets = nullptr;
+    buffer->lengths = nullptr;
+
+    Lexer lexer = lexerAt(buffer, 0);
+    for (;;) {
+        const Token token = nextToken(&lexer);
+        pushToken(buffer, token.type, token.offset, (uint32_t)(lexer.current - lexer.start));
+        if (token.type == TK_EOF) {
+            break;
+        }
+    }
+
+    return buffer;
+}
+
+void freeEditBuffer(EditBuffer *buffer) {
+    if (buffer == nullptr) {
+        return;
+    }
+
+    free(buffer->text);
+    free(buffer->kinds);
+    free(buffer->offsets);
+    free(buffer->lengths);
+    free(buffer);
+}
+
+bool applyEdit(EditBuffer *buffer, const SourceEdit edit) {
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    if ((size_t)edit.offset + edit.deleted > buffer->length) {
+        println("Edit at %u is past the end of the source.", edit.offset);
+        return false;
+    }
+
+    const size_t length = buffer->length - edit.deleted + edit.length;
+    if (length >= UINT32_MAX) {
+        println("Source is too large for a token stream.");
+        return false;
+    }
+
+    if (!reserveGap(buffer, edit.length)) {
+        return false;
+    }
+
+    // Tokens ending far enough before the edit can't have seen it. Lexing restarts right after the last of them, which
+    // is never inside a comment or string since those are only skipped between tokens.
+    int keep = 0;
+    int hi = editBufferTokenCount(buffer);
+    while (keep < hi) {
+        const int mid = keep + (hi - keep) / 2;
+        if (tokenOffset(buffer, mid) < edit.offset) {
+            keep = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    while (keep > 0 && tokenOffset(buffer, keep - 1) + tokenLength(buffer, keep - 1) + NIFTY_TOKEN_LOOKAHEAD > edit.offset) {
+        --keep;
+    }
+
+    const uint32_t restart = keep > 0 ? tokenOffset(buffer, keep - 1) + tokenLength(buffer, keep - 1) : 0;
+    moveTokenGap(buffer, keep);
+
+    // Tokens after the gap count from the end of the text, so the ones past the edit stay right as the length changes.
+    moveGap(buffer, edit.offset);
+    buffer->gapEnd += edit.deleted;
+    memcpy(buffer->text + buffer->gapStart, edit.text, edit.length);
+    buffer->gapStart += edit.length;
+    buffer->text[buffer->gapStart] = '\0';
+    buffer->length = length;
+
+    const uint32_t editEnd = edit.offset + edit.length;
+    size_t window = EDIT_LEX_WINDOW;
+    moveGap(buffer, min(editEnd + window, length));
+
+    Lexer lexer = lexerAt(buffer, restart);
+    for (;;) {
+        const Token token = nextToken(&lexer);
+        const uint32_t end = (uint32_t)(lexer.current - lexer.source);
+
+        // The gap reads as the end of the text. A token too close to it might really go on past it, so move more text
+        // out of the gap and lex again from the end of the last token kept.
+        if (buffer->gapStart < length && end + NIFTY_TOKEN_LOOKAHEAD > buffer->gapStart) {
+            const size_t resume = buffer->tokenGapStart > keep ? tokenOffset(buffer, buffer->tokenGapStart - 1) + tokenLength(buffer, buffer->tokenGapStart - 1) : restart;
+            window *= 2;
+            moveGap(buffer, min(buffer->gapStart + window, length));
+            lexer = lexerAt(buffer, resume);
+            continue;
+        }
+
+        // Past the edit the text is the same as before, so once a new token starts where an old one did the rest of
+        // the old tokens are still right.
+        if (token.offset >= editEnd) {
+            const int old = findTokenAfterGap(buffer, (uint32_t)length - token.offset);
+            if (old >= 0) {
+                buffer->tokenGapEnd = old;
+                moveGap(buffer, token.offset);
+                return true;
+            }
+        }
+
+        pushToken(buffer, token.type, token.offset, end - token.offset);
+        if (token.type == TK_EOF) {
+            buffer->tokenGapEnd = buffer->tokenCapacity;
+            return true;
+        }
+    }
+}
+
+int editBufferTokenCount(const EditBuffer *buffer) {
+    return buffer->tokenGapStart + buffer->tokenCapacity - buffer->tokenGapEnd;
+}
+
+Token editBufferToken(const EditBuffer *buffer, const int index) {
+    const int at = index < buffer->tokenGapStart ? index : index + buffer->tokenGapEnd - buffer->tokenGapStart;
+    const uint32_t offset = tokenOffset(buffer, index);
+    const size_t physical = offset < buffer->gapStart ? offset : offset + buffer->gapEnd - buffer->gapStart;
+
+    Token token;
+    token.type = (NiftyTokenType)buffer->kinds[at];
+    token.symbol = SYMBOL_NONE;
+    token.lexeme = buffer->text + physical;
+    token.len = (int)buffer->lengths[at];
+    token.offset = offset;
+
+    if (token.type == TK_INTERNAL_ERROR) {
+        // The gap is at a token start, so the bad input lexes the same way it did next to the text that followed it.
+        Lexer lexer = lexerAt(buffer, physical);
+        token.lexeme = nextToken(&lexer).lexeme;
+        token.len = (int)str_len(token.lexeme);
+    }
+
+    return token;
+}
+
+const char *editBufferText(EditBuffer *buffer) {
+    moveGap(buffer, buffer->length);
+    return buffer->text;
+}
@@ -0,0 +1,74 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_EDIT_H
+#define NIFTY_EDIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lexer.h"
+
+#include "common.h"
+
+// Replaces deleted bytes at offset with length bytes of text.
+typedef struct {
+    uint32_t offset;
+    uint32_t deleted;
+    const char *text;
+    uint32_t length;
+} SourceEdit;
+
+// Text edited in memory, an editor's buffer for example, with its tokens kept up to date on every edit. The text and
+// the token arrays both keep a gap where the last edit was, so an edit only moves what lies between it and the one
+// before and only lexes the tokens around it. That doesn't depend on how large the text is.
+typedef struct {
+    char *text; // [0, gapStart), the gap, then the rest up to capacity, followed by NIFTY_SOURCE_PADDING zero bytes.
+    size_t length;
+    size_t capacity;
+    size_t gapStart; // Always at the start of a token, and text[gapStart] is '\0'.
+    size_t gapEnd;
+
+    // Tokens before the gap store their offset, tokens after it how far they start from the end of the text.
+    uint8_t *kinds;
+    uint32_t *offsets;
+    uint32_t *lengths;
+    int tokenCapacity;
+    int tokenGapStart;
+    int tokenGapEnd;
+} EditBuffer;
+
+// Lexes a copy of text.
+EditBuffer *initEditBuffer(const char *text, size_t length);
+void freeEditBuffer(EditBuffer *buffer);
+
+// Lexes again from the last token that ends before the edit until the new tokens line up with the old ones. Returns
+// false and leaves the buffer as it was if the edit is out of range.
+bool applyEdit(EditBuffer *buffer, SourceEdit edit);
+
+int editBufferTokenCount(const EditBuffer *buffer);
+// TK_INTERNAL_ERROR tokens have their message as lexeme, like nextToken.
+Token editBufferToken(const EditBuffer *buffer, int index);
+// The whole text, NUL terminated. Closes the gap, which moves everything after it.
+const char *editBufferText(EditBuffer *buffer);
+
+#endif //NIFTY_EDIT_H
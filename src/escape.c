@@ -0,0 +1,482 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "pass.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/array.h"
+
+// Escape analysis. Each pointer from IR_NEW is followed through the addresses made from it to everything that uses
+// it, to see whether it can outlive the call. One that is only read and written through, compared and deleted is dead
+// by the time the function returns, and is given a stack slot instead: a new in a loop can reuse the slot, as keeping
+// one from an earlier iteration takes a phi, which is an escape. One that does escape, but that a deferred delete
+// frees when its scope ends, is allocated from a bump region of the call, so a loop that allocates and frees in
+// order reuses the same memory. That takes every way to a return to go through one of its deletes, and nothing to
+// keep it anywhere that lasts longer than the call, as the region frees it at the return at the latest.
+//
+// Functions are visited callees first, and each records which of its pointer parameters it keeps, so passing a
+// pointer to a call that doesn't keep it isn't an escape. Parameters of functions in a cycle of calls not visited yet
+// are taken as kept, and so are those of functions outside the module. Only what the callee's body does counts: #[in]
+// forbids writing through a parameter, not keeping it.
+
+// Larger values stay on the heap, the stack of a thread is only so big.
+#define ESCAPE_STACK_LIMIT 4096
+
+typedef struct {
+    IrFunction *function;
+    const uint32_t *kept; // Bit i of a function for each parameter i it may keep.
+
+    // Instructions using each value when the function was visited: users[userStarts[v]] up to users[userStarts[v + 1]].
+    int *userStarts;
+    IrValue *users;
+
+    IrValue *seen; // The root each value was last followed from.
+    IrValue *work;
+    int workCount;
+} Analysis;
+
+// Where a pointer and the addresses made from it go.
+typedef struct {
+    bool kept; // Passed to a call that may keep it, or stored. Gone out of sight, but not out of the scope.
+    bool lost; // Returned, merged with other pointers, converted or deleted in part: its lifetime isn't known at all.
+    bool outlives; // Kept somewhere that may outlast the call, anywhere but a stack slot of the function.
+    const char *reason; // The first of either.
+    IrValue *deletes;
+    int deleteCount;
+    int deleteCapacity;
+    bool deferred; // Whether every delete is in a defer block.
+} Escape;
+
+static void countUser(IrFunction *function, IrValue *operand, void *context) {
+    (void)function;
+    ++((int *)context)[*operand + 1];
+}
+
+typedef struct {
+    Analysis *analysis;
+    int *next;
+    IrValue user;
+} UserFill;
+
+static void addUser(IrFunction *function, IrValue *operand, void *context) {
+    (void)function;
+    const UserFill *fill = (const UserFill *)context;
+    fill->analysis->users[fill->next[*operand]++] = fill->user;
+}
+
+static void findUsers(Analysis *analysis) {
+    IrFunction *function = analysis->function;
+    analysis->userStarts = (int *)calloc(function->instCount + 2, sizeof(int));
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            irForEachOperand(function, block->insts[i], countUser, analysis->userStarts);
+        }
+    }
+    for (int v = 0; v <= function->instCount; ++v) {
+        analysis->userStarts[v + 1] += analysis->userStarts[v];
+    }
+
+    analysis->users = (IrValue *)malloc(sizeof(IrValue) * (analysis->userStarts[function->instCount] + 1));
+    int *next = (int *)malloc(sizeof(int) * (function->instCount + 1));
+    memcpy(next, analysis->userStarts, sizeof(int) * (function->instCount + 1));
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            UserFill fill = {analysis, next, block->insts[i]};
+            irForEachOperand(function, block->insts[i], addUser, &fill);
+        }
+    }
+    free(next);
+}
+
+static void keep(Escape *escape, const char *reason) {
+    if (escape->reason == nullptr) {
+        escape->reason = reason;
+    }
+    escape->kept = true;
+}
+
+static void lose(Escape *escape, const char *reason) {
+    if (escape->reason == nullptr) {
+        escape->reason = reason;
+    }
+    escape->lost = true;
+}
+
+static void keepOutside(Escape *escape, const char *reason) {
+    keep(escape, reason);
+    escape->outlives = true;
+}
+
+// Whether address is a stack slot of the function, or a part of one.
+static bool isLocal(const IrFunction *function, IrValue address) {
+    const IrInst *inst = irInst(function, address);
+    while (inst->op == IR_FIELD || inst->op == IR_ELEMENT) {
+        inst = irInst(function, inst->a);
+    }
+
+    return inst->op == IR_ALLOC;
+}
+
+static void push(Analysis *analysis, const IrValue value, const IrValue root) {
+    if (analysis->seen[value] != root) {
+        analysis->seen[value] = root;
+        analysis->work[analysis->workCount++] = value;
+    }
+}
+
+// Whether the call may keep its argument at index.
+static bool callKeeps(const Analysis *analysis, const IrValue call, const int index) {
+    const int callee = irCalledFunction(analysis->function, call);
+    if (callee < 0 || index >= 32) {
+        return true;
+    }
+
+    return (analysis->kept[callee] >> index) & 1;
+}
+
+static void followCall(Analysis *analysis, Escape *escape, const IrValue call, const IrValue value) {
+    const IrInst *inst = irInst(analysis->function, call);
+    if (inst->a == value) {
+        lose(escape, "it is called");
+        return;
+    }
+
+    int count;
+    const uint32_t *args = irList(analysis->function, inst->b, &count);
+    for (int i = 0; i < count; ++i) {
+        if (args[i] == value && callKeeps(analysis, call, i)) {
+            keepOutside(escape, "a call may keep it");
+        }
+    }
+}
+
+// Follows root, and every address made from it, to its users.
+static void follow(Analysis *analysis, const IrValue root, Escape *escape) {
+    const IrFunction *function = analysis->function;
+    escape->kept = false;
+    escape->lost = false;
+    escape->outlives = false;
+    escape->reason = nullptr;
+    escape->deleteCount = 0;
+    escape->deferred = true;
+
+    analysis->workCount = 0;
+    push(analysis, root, root);
+    while (analysis->workCount > 0) {
+        const IrValue value = analysis->work[--analysis->workCount];
+        for (int u = analysis->userStarts[value]; u < analysis->userStarts[value + 1]; ++u) {
+            const IrValue user = analysis->users[u];
+            const IrInst *inst = irInst(function, user);
+            switch ((IrOp)inst->op) {
+                case IR_REMOVED: // A new lowered before this one, with it as the initial value.
+                    keepOutside(escape, "it is stored");
+                    break;
+                case IR_LOAD:
+                case IR_EQ:
+                case IR_NE:
+                case IR_HAS_VALUE:
+                    break;
+                case IR_STORE:
+                    if (inst->b == value && isLocal(function, inst->a)) {
+                        keep(escape, "it is stored");
+                    } else if (inst->b == value) {
+                        keepOutside(escape, "it is stored");
+                    }
+                    break;
+                case IR_FIELD:
+                case IR_ELEMENT:
+                case IR_UNWRAP:
+                    if (inst->a == value) {
+                        push(analysis, user, root);
+                    } else {
+                        lose(escape, "it is used as an index");
+                    }
+                    break;
+                case IR_DELETE:
+                    if (value != root) {
+                        lose(escape, "a part of it is deleted");
+                        break;
+                    }
+                    if (escape->deleteCount == escape->deleteCapacity) {
+                        escape->deletes = (IrValue *)array_grow(escape->deletes, &escape->deleteCapacity,
+                                                                sizeof(IrValue));
+                    }
+                    escape->deletes[escape->deleteCount++] = user;
+                    escape->deferred &= function->blocks[inst->block].kind == BLOCK_DEFER;
+                    break;
+                case IR_CALL:
+                    followCall(analysis, escape, user, value);
+                    break;
+                case IR_NEW:
+                case IR_REGION_NEW:
+                    keepOutside(escape, "it is stored");
+                    break;
+                case IR_RETURN:
+                    lose(escape, "it is returned");
+                    break;
+                case IR_PHI:
+                    lose(escape, "it is merged with other values");
+                    break;
+                default:
+                    lose(escape, "it is converted");
+                    break;
+            }
+        }
+    }
+}
+
+// Index in the entry block after the parameters, where stack slots and the region go.
+static int afterParams(const IrFunction *function) {
+    const IrBlockData *entry = &function->blocks[0];
+    int index = 0;
+    while (index < entry->count && function->insts[entry->insts[index]].op == IR_PARAM) {
+        ++index;
+    }
+
+    return index;
+}
+
+static int indexInBlock(const IrFunction *function, const IrValue value) {
+    const IrBlockData *block = &function->blocks[function->insts[value].block];
+    int index = 0;
+    while (block->insts[index] != value) {
+        ++index;
+    }
+
+    return index;
+}
+
+// The new becomes a store of its initial value to a stack slot, and its deletes go.
+static void toStack(IrFunction *function, const IrValue value, const TypeId element, const Escape *escape) {
+    const IrInst site = function->insts[value];
+    const IrValue slot = insertIrInst(function, 0, afterParams(function), IR_ALLOC, site.type, 0, 0, site.offset);
+
+    int index = indexInBlock(function, value);
+    IrValue initial = site.a;
+    if (initial == IR_NONE) {
+        initial = insertIrInst(function, site.block, index++, IR_ZERO, element, 0, 0, site.offset);
+    }
+    insertIrInst(function, site.block, index, IR_STORE, TYPE_ID_NONE, slot, initial, site.offset);
+    removeIrInst(function, value, slot);
+
+    for (int i = 0; i < escape->deleteCount; ++i) {
+        removeIrInst(function, escape->deletes[i], IR_NONE);
+    }
+}
+
+static void toRegion(IrFunction *function, const IrValue value, IrValue *region, const Escape *escape) {
+    const IrInst site = function->insts[value];
+    if (*region == IR_NONE) {
+        *region = insertIrInst(function, 0, afterParams(function), IR_REGION, TYPE_ID_NONE, 0, 0, site.offset);
+    }
+
+    const IrValue allocation = insertIrInst(function, site.block, indexInBlock(function, value), IR_REGION_NEW,
+                                            site.type, *region, site.a, site.offset);
+    removeIrInst(function, value, allocation);
+
+    for (int i = 0; i < escape->deleteCount; ++i) {
+        const IrInst *freed = irInst(function, escape->deletes[i]);
+        const IrValue pointer = freed->a;
+        const uint32_t offset = freed->offset;
+        insertIrInst(function, freed->block, indexInBlock(function, escape->deletes[i]), IR_REGION_DELETE,
+                     TYPE_ID_NONE, *region, pointer, offset);
+        removeIrInst(function, escape->deletes[i], IR_NONE);
+    }
+}
+
+// Whether every way from the new at value to a return goes through one of its deletes, so the region doesn't free it
+// where the heap wouldn't have.
+static bool deletedBeforeReturns(const IrFunction *function, const IrValue value, const Escape *escape) {
+    bool *deleting = (bool *)calloc(function->blockCount, sizeof(bool));
+    for (int i = 0; i < escape->deleteCount; ++i) {
+        deleting[function->insts[escape->deletes[i]].block] = true;
+    }
+
+    // The blocks reached from the new without passing a delete.
+    bool *reached = (bool *)calloc(function->blockCount, sizeof(bool));
+    IrBlock *work = (IrBlock *)malloc(sizeof(IrBlock) * function->blockCount);
+    const IrBlock start = function->insts[value].block;
+    int workCount = 0;
+    bool deleted = true;
+    if (!deleting[start]) {
+        reached[start] = true;
+        work[workCount++] = start;
+    }
+    while (workCount > 0 && deleted) {
+        const IrBlock block = work[--workCount];
+        const IrValue end = irTerminator(function, block);
+        if (end != IR_NONE && irInst(function, end)->op == IR_RETURN) {
+            deleted = false;
+            break;
+        }
+
+        IrBlock succs[2];
+        const int succCount = irSuccessors(function, block, succs);
+        for (int i = 0; i < succCount; ++i) {
+            if (!reached[succs[i]] && !deleting[succs[i]]) {
+                reached[succs[i]] = true;
+                work[workCount++] = succs[i];
+            }
+        }
+    }
+
+    free(work);
+    free(reached);
+    free(deleting);
+    return deleted;
+}
+
+// Whether a value of type fits the stack, and what it is if so.
+static bool fitsStack(TypeTable *types, const TypeId pointer, TypeId *element) {
+    const Type *type = pointer != TYPE_ID_NONE ? typeOf(types, pointer) : nullptr;
+    if (type == nullptr || type->form != FORM_POINTER) {
+        return false;
+    }
+
+    *element = type->a;
+    TypeLayout layout;
+    return typeLayout(types, type->a, &layout) && layout.size <= ESCAPE_STACK_LIMIT;
+}
+
+static void remark(IrModule *module, const int f, const IrInst *site, const TypeId element, const char *text,
+                   const char *reason) {
+    if (!module->config->remarks) {
+        return;
+    }
+
+    StrBuffer name;
+    str_buf_init(&name);
+    appendTypeName(module->types, module->config->interner, element, &name);
+    if (reason != nullptr) {
+        addIrRemark(module, "escape", f, site->offset, text, name.len, name.data, reason);
+    } else {
+        addIrRemark(module, "escape", f, site->offset, text, name.len, name.data);
+    }
+    str_buf_free(&name);
+}
+
+// Lowers the news of function, returns how many.
+static int lowerNews(IrModule *module, Analysis *analysis, const int f, Escape *escape) {
+    IrFunction *function = analysis->function;
+    const int instCount = function->instCount;
+    IrValue region = IR_NONE;
+    int changes = 0;
+    for (IrValue value = 1; value < (IrValue)instCount; ++value) {
+        const IrInst *site = irInst(function, value);
+        if (site->op != IR_NEW || site->block == IR_NO_BLOCK) {
+            continue;
+        }
+
+        follow(analysis, value, escape);
+        TypeId element = TYPE_ID_NONE;
+        const bool fits = fitsStack(module->types, site->type, &element);
+        if (element == TYPE_ID_NONE) {
+            continue;
+        }
+        const bool scoped = !escape->lost && !escape->outlives && escape->deleteCount > 0 && escape->deferred;
+        if (!escape->kept && !escape->lost && fits) {
+            remark(module, f, site, element, "new %.*s is on the stack", nullptr);
+            toStack(function, value, element, escape);
+            ++changes;
+        } else if (scoped && deletedBeforeReturns(function, value, escape)) {
+            remark(module, f, site, element, "new %.*s is in a region, its deferred delete frees it", nullptr);
+            toRegion(function, value, &region, escape);
+            ++changes;
+        } else if (scoped) {
+            remark(module, f, site, element, "new %.*s stays on the heap, %s", "a return can come before its delete");
+        } else {
+            const char *reason = escape->reason != nullptr ? escape->reason : "it is too large for the stack";
+            remark(module, f, site, element, "new %.*s stays on the heap, %s", reason);
+        }
+    }
+
+    return changes;
+}
+
+// The parameters function may keep, or delete, by their bits.
+static uint32_t keptParams(Analysis *analysis, Escape *escape) {
+    const IrFunction *function = analysis->function;
+    const IrBlockData *entry = &function->blocks[0];
+    uint32_t kept = 0;
+    for (int i = 0; i < entry->count; ++i) {
+        const IrValue value = entry->insts[i];
+        const IrInst *inst = irInst(function, value);
+        if (inst->op != IR_PARAM || inst->a >= 32) {
+            continue;
+        }
+
+        follow(analysis, value, escape);
+        if (escape->kept || escape->lost || escape->deleteCount > 0) {
+            kept |= 1u << inst->a;
+        }
+    }
+
+    return kept;
+}
+
+int lowerAllocations(IrModule *module, StrBuffer *errors) {
+    (void)errors;
+
+    IrCallGraph graph;
+    initIrCallGraph(&graph, module);
+    uint32_t *kept = (uint32_t *)malloc(sizeof(uint32_t) * (module->functionCount + 1));
+    for (int i = 0; i < module->functionCount; ++i) {
+        kept[i] = UINT32_MAX;
+    }
+
+    Escape escape = {0};
+    int changes = 0;
+    for (int o = 0; o < module->functionCount; ++o) {
+        const int f = graph.order[o];
+        IrFunction *function = module->functions[f];
+        if (function->blockCount == 0) {
+            continue;
+        }
+
+        Analysis analysis = {function, kept, nullptr, nullptr, nullptr, nullptr, 0};
+        findUsers(&analysis);
+        analysis.seen = (IrValue *)calloc(function->instCount + 1, sizeof(IrValue));
+        analysis.work = (IrValue *)malloc(sizeof(IrValue) * (function->instCount + 1));
+
+        kept[f] = keptParams(&analysis, &escape);
+        const int lowered = lowerNews(module, &analysis, f, &escape);
+        if (lowered > 0) {
+            compactIrFunction(function);
+            changes += lowered;
+        }
+
+        free(analysis.work);
+        free(analysis.seen);
+        free(analysis.users);
+        free(analysis.userStarts);
+    }
+
+    free(escape.deletes);
+    free(kept);
+    freeIrCallGraph(&graph);
+    return changes;
+}
@@ -0,0 +1,462 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include "pass.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "consteval.h"
+#include "util/array.h"
+
+// Sparse conditional constant propagation. Values start out unknown and only ever fall, to one constant and then to
+// not constant, while blocks are only visited once an edge into them is taken: branches on a constant take one edge,
+// and phis only meet the values of the edges taken. Arithmetic folds with the rules of consteval.h, so the backend
+// gets the same answers as const declarations do.
+
+typedef enum {
+    LATTICE_TOP,    // Not seen yet, or only on edges never taken.
+    LATTICE_CONST,
+    LATTICE_BOTTOM, // Not a constant.
+} Lattice;
+
+typedef struct {
+    IrFunction *function;
+
+    uint8_t *lattice; // Lattice, by value.
+    Constant *values;
+    IrValue *checks; // The IR_CHECK_OVERFLOW of each checked value, else IR_NONE.
+
+    // Instructions using each value: users[userStarts[v]] up to users[userStarts[v + 1]].
+    int *userStarts;
+    IrValue *users;
+
+    bool *reached;
+    uint8_t *taken; // Bit i of the edge to successor i, by block.
+
+    IrBlock *blockWork;
+    int blockCount;
+    IrValue *valueWork;
+    int valueCount;
+    int valueCapacity;
+} Propagation;
+
+static void countUser(IrFunction *function, IrValue *operand, void *context) {
+    (void)function;
+    ++((int *)context)[*operand + 1];
+}
+
+typedef struct {
+    Propagation *propagation;
+    int *next;
+    IrValue user;
+} UserFill;
+
+static void fillUser(IrFunction *function, IrValue *operand, void *context) {
+    (void)function;
+    UserFill *fill = (UserFill *)context;
+    fill->propagation->users[fill->next[*operand]++] = fill->user;
+}
+
+static void findUsers(Propagation *propagation) {
+    IrFunction *function = propagation->function;
+    int *starts = (int *)calloc(function->instCount + 2, sizeof(int));
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count; ++i) {
+            irForEachOperand(function, block->insts[i], countUser, starts);
+        }
+    }
+    for (int v = 0; v < function->instCount; ++v) {
+        starts[v + 1] += starts[v];
+    }
+
+    int *next = (int *)malloc(sizeof(int) * (function->instCount + 1));
+    memcpy(next, starts, sizeof(int) * (function->instCount + 1));
+    propagation->users = (IrValue *)malloc(sizeof(IrValue) * (starts[function->instCount] + 1));
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count; ++i) {
+            UserFill fill = {propagation, next, block->insts[i]};
+            irForEachOperand(function, block->insts[i], fillUser, &fill);
+        }
+    }
+    free(next);
+    propagation->userStarts = starts;
+}
+
+// Lowers value to constant, or to bottom if constant is nullptr. Values that fall are visited again through their
+// users.
+static void lower(Propagation *propagation, const IrValue value, const Constant *constant) {
+    uint8_t *state = &propagation->lattice[value];
+    if (*state == LATTICE_BOTTOM) {
+        return;
+    }
+    if (constant != nullptr && *state == LATTICE_CONST && sameConstant(&propagation->values[value], constant)) {
+        return;
+    }
+
+    if (constant != nullptr && *state == LATTICE_TOP) {
+        *state = LATTICE_CONST;
+        propagation->values[value] = *constant;
+    } else {
+        *state = LATTICE_BOTTOM;
+    }
+
+    if (propagation->valueCount == propagation->valueCapacity) {
+        propagation->valueWork = (IrValue *)array_grow(propagation->valueWork, &propagation->valueCapacity,
+                                                       sizeof(IrValue));
+    }
+    propagation->valueWork[propagation->valueCount++] = value;
+}
+
+static bool edgeTaken(const Propagation *propagation, const IrBlock from, const IrBlock to) {
+    IrBlock succs[2];
+    const int count = irSuccessors(propagation->function, from, succs);
+    for (int i = 0; i < count; ++i) {
+        if (succs[i] == to && propagation->taken[from] & (1 << i)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void take(Propagation *propagation, IrBlock from, int index);
+
+// The node kind whose fold rules an arithmetic instruction follows. Checked ones are the ones that can't overflow.
+static NodeKind foldKind(const IrOp op, const bool checked) {
+    switch (op) {
+        case IR_ADD: return checked ? AddNodeType : AddWrapNodeType;
+        case IR_SUB: return checked ? SubNodeType : SubWrapNodeType;
+        case IR_MUL: return checked ? MulNodeType : MulWrapNodeType;
+        case IR_DIV: return DivNodeType;
+        case IR_MOD: return ModNodeType;
+        case IR_ADD_SAT: return AddSatNodeType;
+        case IR_SUB_SAT: return SubSatNodeType;
+        case IR_MUL_SAT: return MulSatNodeType;
+        case IR_SHL_SAT: return ShlSatNodeType;
+        case IR_SHL: return ShlNodeType;
+        case IR_SHR: return ShrNodeType;
+        case IR_AND: return BitAndNodeType;
+        case IR_OR: return BitOrNodeType;
+        case IR_XOR: return BitXorNodeType;
+        case IR_EQ: return EqNodeType;
+        case IR_NE: return NotEqNodeType;
+        case IR_LT: return LtNodeType;
+        case IR_LE: return LtEqNodeType;
+        case IR_GT: return GtNodeType;
+        case IR_GE: return GtEqNodeType;
+        default: return VoidNodeType;
+    }
+}
+
+// The value of inst from the lattice of its operands, false while an operand is still top.
+static bool evaluate(const Propagation *propagation, const IrInst *inst, const IrValue value, Constant *result,
+                     bool *constant) {
+    const uint8_t *lattice = propagation->lattice;
+    const TypeId type = inst->type;
+    const TypeKind kind = type != TYPE_ID_NONE && type <= primitiveType(TYPE_ANY) ? (TypeKind)(type - 1) : TYPE_NONE;
+    ConstStatus status = CONST_UNKNOWN;
+    *constant = false;
+
+    switch ((IrOp)inst->op) {
+        case IR_INT:
+        case IR_FLOAT:
+        case IR_BOOL:
+            *constant = irConstant(propagation->function, value, result);
+            return true;
+        case IR_ZERO:
+            *constant = isIntegerKind(kind);
+            *result = intConstant(kind, 0);
+            return true;
+        case IR_NEG:
+        case IR_NOT:
+        case IR_BIT_NOT:
+        case IR_CONVERT: {
+            if (lattice[inst->a] != LATTICE_CONST) {
+                return lattice[inst->a] == LATTICE_BOTTOM;
+            }
+
+            const Constant *operand = &propagation->values[inst->a];
+            if (inst->op == IR_NEG) {
+                // Negation wraps like 0 %- x unless it is checked, the checks of the language are explicit
+                // instructions.
+                const Constant zero = intConstant(operand->type, 0);
+                const bool wraps = operand->kind == CONST_INT && propagation->checks[value] == IR_NONE;
+                status = wraps ? foldBinary(SubWrapNodeType, &zero, operand, result)
+                               : foldUnary(NegNodeType, operand, result);
+            } else if (inst->op == IR_CONVERT) {
+                status = kind != TYPE_NONE ? foldConversion(kind, operand, result) : CONST_UNKNOWN;
+            } else {
+                status = foldUnary(inst->op == IR_NOT ? NotNodeType : BitNotNodeType, operand, result);
+            }
+            break;
+        }
+        default: {
+            const NodeKind op = foldKind((IrOp)inst->op, propagation->checks[value] != IR_NONE);
+            if (op == VoidNodeType) {
+                return true;
+            }
+            if (lattice[inst->a] == LATTICE_BOTTOM || lattice[inst->b] == LATTICE_BOTTOM) {
+                return true;
+            }
+            if (lattice[inst->a] == LATTICE_TOP || lattice[inst->b] == LATTICE_TOP) {
+                return false;
+            }
+            status = foldBinary(op, &propagation->values[inst->a], &propagation->values[inst->b], result);
+            break;
+        }
+    }
+
+    // A fold that fails is left to run, and to trap, at run time.
+    *constant = status == CONST_OK && result->type == kind;
+    return true;
+}
+
+static void visitPhi(Propagation *propagation, const IrValue value) {
+    const IrFunction *function = propagation->function;
+    const IrInst *inst = irInst(function, value);
+    const IrBlockData *block = &function->blocks[inst->block];
+    int count;
+    const uint32_t *operands = irList(function, inst->a, &count);
+
+    const Constant *found = nullptr;
+    for (int i = 0; i < count && i < block->predCount; ++i) {
+        if (!edgeTaken(propagation, block->preds[i], inst->block)) {
+            continue;
+        }
+
+        const uint8_t state = propagation->lattice[operands[i]];
+        if (state == LATTICE_BOTTOM ||
+            (state == LATTICE_CONST && found != nullptr && !sameConstant(found, &propagation->values[operands[i]]))) {
+            lower(propagation, value, nullptr);
+            return;
+        }
+        if (state == LATTICE_CONST) {
+            found = &propagation->values[operands[i]];
+        }
+    }
+
+    if (found != nullptr) {
+        const Constant constant = *found;
+        lower(propagation, value, &constant);
+    }
+}
+
+static void visit(Propagation *propagation, const IrValue value) {
+    const IrInst *inst = irInst(propagation->function, value);
+    switch ((IrOp)inst->op) {
+        case IR_PHI:
+            visitPhi(propagation, value);
+            return;
+        case IR_JUMP:
+            take(propagation, inst->block, 0);
+            return;
+        case IR_BRANCH: {
+            const uint8_t state = propagation->lattice[inst->a];
+            if (state == LATTICE_CONST && propagation->values[inst->a].kind == CONST_BOOL) {
+                take(propagation, inst->block, propagation->values[inst->a].low != 0 ? 0 : 1);
+            } else if (state != LATTICE_TOP) {
+                take(propagation, inst->block, 0);
+                take(propagation, inst->block, 1);
+            }
+            return;
+        }
+        default:
+            break;
+    }
+
+    if (isIrTerminator((IrOp)inst->op)) {
+        return;
+    }
+    // Values lowering couldn't type, like calls through a namespace, aren't constants. Left at top they would keep
+    // every branch on them from being taken, and the loops they are in from ever going around.
+    if (inst->type == TYPE_ID_NONE) {
+        lower(propagation, value, nullptr);
+        return;
+    }
+
+    Constant result;
+    bool constant;
+    if (evaluate(propagation, inst, value, &result, &constant)) {
+        lower(propagation, value, constant ? &result : nullptr);
+    }
+}
+
+// Marks the edge from block to its index-th successor taken. Blocks reached for the first time have every
+// instruction visited, blocks reached before only their phis, which have one more edge to meet.
+static void take(Propagation *propagation, const IrBlock from, const int index) {
+    if (propagation->taken[from] & (1 << index)) {
+        return;
+    }
+    propagation->taken[from] |= (uint8_t)(1 << index);
+
+    IrBlock succs[2];
+    irSuccessors(propagation->function, from, succs);
+    const IrBlock to = succs[index];
+    if (!propagation->reached[to]) {
+        propagation->reached[to] = true;
+        propagation->blockWork[propagation->blockCount++] = to;
+        return;
+    }
+
+    const IrBlockData *block = &propagation->function->blocks[to];
+    for (int i = 0; i < block->count && irInst(propagation->function, block->insts[i])->op == IR_PHI; ++i) {
+        visitPhi(propagation, block->insts[i]);
+    }
+}
+
+static void propagate(Propagation *propagation) {
+    IrFunction *function = propagation->function;
+    propagation->reached[0] = true;
+    propagation->blockWork[propagation->blockCount++] = 0;
+
+    while (propagation->blockCount > 0 || propagation->valueCount > 0) {
+        if (propagation->blockCount > 0) {
+            const IrBlockData *block = &function->blocks[propagation->blockWork[--propagation->blockCount]];
+            for (int i = 0; i < block->count; ++i) {
+                visit(propagation, block->insts[i]);
+            }
+            continue;
+        }
+
+        const IrValue value = propagation->valueWork[--propagation->valueCount];
+        for (int i = propagation->userStarts[value]; i < propagation->userStarts[value + 1]; ++i) {
+            const IrValue user = propagation->users[i];
+            if (propagation->reached[irInst(function, user)->block]) {
+                visit(propagation, user);
+            }
+        }
+    }
+}
+
+static bool isLiteral(const IrOp op) {
+    return op == IR_INT || op == IR_FLOAT || op == IR_BOOL;
+}
+
+// Replaces the constant values of block with literals, and the checks and branches they decide.
+static int rewriteBlock(Propagation *propagation, const IrBlock b) {
+    IrFunction *function = propagation->function;
+    int changes = 0;
+
+    // Literals for phis go after the last phi.
+    int phiEnd = 0;
+    while (phiEnd < function->blocks[b].count && irInst(function, function->blocks[b].insts[phiEnd])->op == IR_PHI) {
+        ++phiEnd;
+    }
+
+    for (int i = 0; i < function->blocks[b].count; ++i) {
+        const IrValue value = function->blocks[b].insts[i];
+        const IrInst inst = *irInst(function, value);
+        if (inst.op == IR_CHECK_OVERFLOW && propagation->lattice[inst.a] == LATTICE_CONST) {
+            removeIrInst(function, value, IR_NONE);
+            ++changes;
+            continue;
+        }
+        if (inst.op == IR_CHECK_DIVISOR && propagation->lattice[inst.a] == LATTICE_CONST &&
+            (propagation->values[inst.a].low != 0 || propagation->values[inst.a].high != 0)) {
+            removeIrInst(function, value, IR_NONE);
+            ++changes;
+            continue;
+        }
+        if (inst.op == IR_BRANCH && propagation->lattice[inst.a] == LATTICE_CONST) {
+            const uint32_t then = function->extra[inst.b];
+            const uint32_t otherwise = function->extra[inst.b + 1];
+            const bool taken = propagation->values[inst.a].low != 0;
+            IrInst *branch = irInst(function, value);
+            branch->op = IR_JUMP;
+            branch->a = taken ? then : otherwise;
+            branch->b = 0;
+            removeIrEdge(function, b, taken ? otherwise : then);
+            ++changes;
+            continue;
+        }
+        // Literals added for phis come after them in the block, past the end of the lattice.
+        if (inst.op == IR_REMOVED || isLiteral((IrOp)inst.op) || propagation->lattice[value] != LATTICE_CONST) {
+            continue;
+        }
+
+        const bool phi = inst.op == IR_PHI;
+        const IrValue literal = insertIrConstant(function, b, phi ? phiEnd : i, &propagation->values[value],
+                                                 inst.offset);
+        removeIrInst(function, value, literal);
+        if (!phi) {
+            ++i; // The literal went in ahead of value.
+        }
+        ++changes;
+    }
+
+    return changes;
+}
+
+int foldConstants(const IrModule *module, IrFunction *function, StrBuffer *errors) {
+    (void)module;
+    (void)errors;
+
+    Propagation propagation;
+    memset(&propagation, 0, sizeof(Propagation));
+    propagation.function = function;
+    const int instCount = function->instCount;
+    propagation.lattice = (uint8_t *)calloc(instCount + 1, sizeof(uint8_t));
+    propagation.values = (Constant *)calloc(instCount + 1, sizeof(Constant));
+    propagation.checks = (IrValue *)calloc(instCount + 1, sizeof(IrValue));
+    propagation.reached = (bool *)calloc(function->blockCount + 1, sizeof(bool));
+    propagation.taken = (uint8_t *)calloc(function->blockCount + 1, sizeof(uint8_t));
+    propagation.blockWork = (IrBlock *)malloc(sizeof(IrBlock) * (function->blockCount + 1));
+    findUsers(&propagation);
+
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count; ++i) {
+            const IrInst *inst = irInst(function, block->insts[i]);
+            if (inst->op == IR_CHECK_OVERFLOW) {
+                propagation.checks[inst->a] = block->insts[i];
+            }
+        }
+    }
+
+    propagate(&propagation);
+
+    int changes = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        if (propagation.reached[b] && !function->blocks[b].removed) {
+            changes += rewriteBlock(&propagation, (IrBlock)b);
+        }
+    }
+
+    free(propagation.lattice);
+    free(propagation.values);
+    free(propagation.checks);
+    free(propagation.userStarts);
+    free(propagation.users);
+    free(propagation.reached);
+    free(propagation.taken);
+    free(propagation.blockWork);
+    free(propagation.valueWork);
+
+    if (changes > 0) {
+        compactIrFunction(function);
+        removeTrivialPhis(function);
+    }
+    return changes;
+}
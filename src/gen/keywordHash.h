@@ -0,0 +1,46 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_KEYWORD_HASH_H
+#define NIFTY_KEYWORD_HASH_H
+
+#include <stdint.h>
+
+// Shared by the keyword table generator and the lexer so both hash identifiers the same way.
+// A keyword is identified by its length plus its first two and last two bytes, the generator checks these are unique.
+
+static inline uint32_t keywordFingerprint(const char *s, const int len) {
+    return ((uint32_t)(uint8_t)s[0] | (uint32_t)(uint8_t)s[1] << 8 | (uint32_t)(uint8_t)s[len - 2] << 16 |
+            (uint32_t)(uint8_t)s[len - 1] << 24) ^ (uint32_t)len * 0x9E3779B9u;
+}
+
+static inline uint32_t keywordHash(uint32_t h, const uint32_t seed) {
+    h ^= seed * 0x85EBCA6Bu;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+#endif //NIFTY_KEYWORD_HASH_H
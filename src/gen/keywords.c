@@ -0,0 +1,280 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+// Build time generator for the lexer's keyword table.
+// Usage: keywords <lexer.h> <output.h>
+//
+// Reads the NiftyTokenType enum, collects every entry marked with a quoted spelling and writes a minimal perfect hash
+// over the keywords using hash and displace: the fingerprint picks a bucket, the bucket's displacement picks the slot.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "keywordHash.h"
+
+#define MAX_KEYWORDS 256
+#define MAX_KEYWORD_LEN 15
+#define MAX_DISPLACEMENT UINT16_MAX // Displacements are written as uint16_t, 0 is the bucket hash's own seed.
+
+typedef struct {
+    char name[64];
+    char text[MAX_KEYWORD_LEN + 1];
+    int len;
+    uint32_t fingerprint;
+    int bucket;
+} Keyword;
+
+static Keyword keywords[MAX_KEYWORDS];
+static int keywordCount;
+
+static int isIdentChar(const char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Matches lines like `    TK_FN,    // "fn"`.
+static void parseLine(const char *line, const char *path, const int lineNumber) {
+    while (*line == ' ' || *line == '\t') {
+        ++line;
+    }
+
+    if (strncmp(line, "TK_", 3) != 0) {
+        return;
+    }
+
+    const char *nameEnd = line;
+    while (isIdentChar(*nameEnd)) {
+        ++nameEnd;
+    }
+
+    const char *comment = strstr(nameEnd, "//");
+    if (comment == NULL) {
+        return;
+    }
+    comment += 2;
+    while (*comment == ' ') {
+        ++comment;
+    }
+    if (*comment != '"') {
+        return;
+    }
+
+    const char *text = comment + 1;
+    const char *textEnd = text;
+    while (isIdentChar(*textEnd)) {
+        ++textEnd;
+    }
+    if (*textEnd != '"') {
+        return;
+    }
+
+    const int len = (int)(textEnd - text);
+    if (len < 2 || len > MAX_KEYWORD_LEN || keywordCount == MAX_KEYWORDS) {
+        fprintf(stderr, "%s:%d: keyword must be 2 to %d characters long.\n", path, lineNumber, MAX_KEYWORD_LEN);
+        exit(1);
+    }
+
+    Keyword *kw = &keywords[keywordCount++];
+    memcpy(kw->name, line, nameEnd - line);
+    kw->name[nameEnd - line] = '\0';
+    memcpy(kw->text, text, len);
+    kw->text[len] = '\0';
+    kw->len = len;
+    kw->fingerprint = keywordFingerprint(kw->text, len);
+}
+
+static void readKeywords(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open '%s' for reading.\n", path);
+        exit(1);
+    }
+
+    char line[512];
+    int lineNumber = 0;
+    int inEnum = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ++lineNumber;
+        if (strstr(line, "typedef enum") != NULL) {
+            inEnum = 1;
+        } else if (inEnum && strstr(line, "} NiftyTokenType;") != NULL) {
+            break;
+        } else if (inEnum) {
+            parseLine(line, path, lineNumber);
+        }
+    }
+
+    fclose(file);
+
+    for (int i = 0; i < keywordCount; ++i) {
+        for (int j = i + 1; j < keywordCount; ++j) {
+            if (keywords[i].fingerprint == keywords[j].fingerprint) {
+                fprintf(stderr, "Keywords '%s' and '%s' have the same fingerprint, update keywordFingerprint.\n",
+                        keywords[i].text, keywords[j].text);
+                exit(1);
+            }
+        }
+    }
+}
+
+static int bucketCount;
+static int bucketSizes[MAX_KEYWORDS];
+static int bucketOrder[MAX_KEYWORDS];
+static uint32_t displacements[MAX_KEYWORDS];
+static int slots[MAX_KEYWORDS];
+
+static int compareBuckets(const void *a, const void *b) {
+    const int sa = bucketSizes[*(const int *)a];
+    const int sb = bucketSizes[*(const int *)b];
+    if (sa != sb) {
+        return sb - sa;
+    }
+    return *(const int *)a - *(const int *)b;
+}
+
+static int placeBucket(const int bucket) {
+    int taken[MAX_KEYWORDS];
+    for (uint32_t d = 0; d < MAX_DISPLACEMENT; ++d) {
+        int count = 0;
+        int ok = 1;
+        for (int i = 0; i < keywordCount && ok; ++i) {
+            if (keywords[i].bucket != bucket) {
+                continue;
+            }
+
+            const int slot = (int)(keywordHash(keywords[i].fingerprint, d + 1) % (uint32_t)keywordCount);
+            if (slots[slot] >= 0) {
+                ok = 0;
+            }
+            for (int j = 0; j < count && ok; ++j) {
+                if (taken[j] == slot) {
+                    ok = 0;
+                }
+            }
+            taken[count++] = slot;
+        }
+
+        if (!ok) {
+            continue;
+        }
+
+        count = 0;
+        for (int i = 0; i < keywordCount; ++i) {
+            if (keywords[i].bucket == bucket) {
+                slots[taken[count++]] = i;
+            }
+        }
+        displacements[bucket] = d + 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void buildTable() {
+    bucketCount = (keywordCount + 1) / 2;
+    for (int i = 0; i < keywordCount; ++i) {
+        slots[i] = -1;
+    }
+
+    for (int i = 0; i < keywordCount; ++i) {
+        keywords[i].bucket = (int)(keywordHash(keywords[i].fingerprint, 0) % (uint32_t)bucketCount);
+        ++bucketSizes[keywords[i].bucket];
+    }
+
+    for (int i = 0; i < bucketCount; ++i) {
+        bucketOrder[i] = i;
+    }
+    qsort(bucketOrder, bucketCount, sizeof(int), compareBuckets);
+
+    for (int i = 0; i < bucketCount; ++i) {
+        const int bucket = bucketOrder[i];
+        if (bucketSizes[bucket] == 0) {
+            continue;
+        }
+
+        if (!placeBucket(bucket)) {
+            fprintf(stderr, "Could not find a perfect hash for the keywords.\n");
+            exit(1);
+        }
+    }
+}
+
+static void writeTable(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open '%s' for writing.\n", path);
+        exit(1);
+    }
+
+    int minLen = MAX_KEYWORD_LEN;
+    int maxLen = 0;
+    for (int i = 0; i < keywordCount; ++i) {
+        minLen = keywords[i].len < minLen ? keywords[i].len : minLen;
+        maxLen = keywords[i].len > maxLen ? keywords[i].len : maxLen;
+    }
+
+    fprintf(file, "// Generated by src/gen/keywords.c from lexer.h. Do not edit.\n\n");
+    fprintf(file, "#ifndef NIFTY_KEYWORDS_H\n#define NIFTY_KEYWORDS_H\n\n");
+    fprintf(file, "#include \"gen/keywordHash.h\"\n\n");
+    fprintf(file, "#define KEYWORD_COUNT %d\n", keywordCount);
+    fprintf(file, "#define KEYWORD_BUCKETS %d\n", bucketCount);
+    fprintf(file, "#define KEYWORD_MIN_LEN %d\n", minLen);
+    fprintf(file, "#define KEYWORD_MAX_LEN %d\n\n", maxLen);
+
+    fprintf(file, "static const uint16_t keywordDisplacements[KEYWORD_BUCKETS] = {");
+    for (int i = 0; i < bucketCount; ++i) {
+        if (displacements[i] > MAX_DISPLACEMENT) {
+            fprintf(stderr, "The displacement of bucket %d doesn't fit in a uint16_t.\n", i);
+            fclose(file);
+            exit(1);
+        }
+        fprintf(file, "%s%s%u", i % 12 == 0 ? "\n    " : "", i % 12 == 0 ? "" : " ", displacements[i]);
+        if (i + 1 < bucketCount) {
+            fprintf(file, ",");
+        }
+    }
+    fprintf(file, "\n};\n\n");
+
+    fprintf(file, "static const struct { char text[%d]; uint8_t len; uint8_t type; } keywordTable[KEYWORD_COUNT] = {\n",
+            MAX_KEYWORD_LEN + 1);
+    for (int i = 0; i < keywordCount; ++i) {
+        const Keyword *kw = &keywords[slots[i]];
+        fprintf(file, "    {\"%s\", %d, %s},\n", kw->text, kw->len, kw->name);
+    }
+    fprintf(file, "};\n\n#endif //NIFTY_KEYWORDS_H\n");
+
+    fclose(file);
+}
+
+int main(const int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: keywords <lexer.h> <output.h>\n");
+        return 1;
+    }
+
+    readKeywords(argv[1]);
+    buildTable();
+    writeTable(argv[2]);
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+// Build time generator for the 128 bit powers of five the lexer uses to round decimal floats (Eisel-Lemire).
+// Usage: powers <output.h>
+//
+// Entry q holds the top 128 bits of 5^q for q >= 0, and of 2^b / 5^-q rounded up for q < 0, with b large enough that
+// nothing below the top 128 bits is lost.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SMALLEST_POWER (-342)
+#define LARGEST_POWER 308
+
+// Little endian 32 bit limbs, enough for 2^1800.
+#define LIMBS 64
+
+typedef struct {
+    uint32_t limbs[LIMBS];
+} Big;
+
+static void bigSet(Big *a, const uint32_t v) {
+    memset(a, 0, sizeof(Big));
+    a->limbs[0] = v;
+}
+
+static void bigMul(Big *a, const uint32_t m) {
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        const uint64_t v = (uint64_t)a->limbs[i] * m + carry;
+        a->limbs[i] = (uint32_t)v;
+        carry = v >> 32;
+    }
+
+    if (carry != 0) {
+        fprintf(stderr, "Power of five too large.\n");
+        exit(1);
+    }
+}
+
+static int bigBits(const Big *a) {
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        if (a->limbs[i] != 0) {
+            int bits = 32;
+            while ((a->limbs[i] >> (bits - 1)) == 0) {
+                --bits;
+            }
+            return i * 32 + bits;
+        }
+    }
+
+    return 0;
+}
+
+static int bigBit(const Big *a, const int bit) {
+    return (int)((a->limbs[bit / 32] >> (bit % 32)) & 1);
+}
+
+static void bigSetBit(Big *a, const int bit) {
+    a->limbs[bit / 32] |= 1u << (bit % 32);
+}
+
+static void bigShiftLeft1(Big *a) {
+    for (int i = LIMBS - 1; i > 0; --i) {
+        a->limbs[i] = (a->limbs[i] << 1) | (a->limbs[i - 1] >> 31);
+    }
+    a->limbs[0] <<= 1;
+}
+
+static int bigCompare(const Big *a, const Big *b) {
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        if (a->limbs[i] != b->limbs[i]) {
+            return a->limbs[i] < b->limbs[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+static void bigSub(Big *a, const Big *b) {
+    int64_t borrow = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        const int64_t v = (int64_t)a->limbs[i] - b->limbs[i] - borrow;
+        a->limbs[i] = (uint32_t)v;
+        borrow = v < 0;
+    }
+}
+
+static void bigAdd1(Big *a) {
+    for (int i = 0; i < LIMBS && ++a->limbs[i] == 0; ++i) {}
+}
+
+// 2^bits / d, by long division one bit at a time.
+static void bigDividePowerOfTwo(const int bits, const Big *d, Big *quotient) {
+    Big remainder;
+    bigSet(&remainder, 0);
+    bigSet(quotient, 0);
+    for (int bit = bits; bit >= 0; --bit) {
+        bigShiftLeft1(&remainder);
+        if (bit == bits) {
+            remainder.limbs[0] |= 1;
+        }
+
+        if (bigCompare(&remainder, d) >= 0) {
+            bigSub(&remainder, d);
+            bigSetBit(quotient, bit);
+        }
+    }
+}
+
+// The top 128 bits of a, truncated.
+static void top128(const Big *a, uint64_t *high, uint64_t *low) {
+    const int bits = bigBits(a);
+    *high = 0;
+    *low = 0;
+    for (int i = 0; i < 128; ++i) {
+        const int bit = bits - 1 - i;
+        const uint64_t v = bit >= 0 ? (uint64_t)bigBit(a, bit) : 0;
+        if (i < 64) {
+            *high |= v << (63 - i);
+        } else {
+            *low |= v << (127 - i);
+        }
+    }
+}
+
+int main(const int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: powers <output.h>\n");
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open '%s' for writing.\n", argv[1]);
+        return 1;
+    }
+
+    fprintf(file, "// Generated by src/gen/powers.c. Do not edit.\n\n");
+    fprintf(file, "#ifndef NIFTY_POWERS_H\n#define NIFTY_POWERS_H\n\n");
+    fprintf(file, "#include <stdint.h>\n\n");
+    fprintf(file, "#define POWER_OF_FIVE_MIN %d\n", SMALLEST_POWER);
+    fprintf(file, "#define POWER_OF_FIVE_MAX %d\n\n", LARGEST_POWER);
+    fprintf(file, "// High then low 64 bits of each power from POWER_OF_FIVE_MIN to POWER_OF_FIVE_MAX.\n");
+    fprintf(file, "static const uint64_t powersOfFive[] = {\n");
+
+    for (int q = SMALLEST_POWER; q <= LARGEST_POWER; ++q) {
+        Big power;
+        bigSet(&power, 1);
+        for (int i = 0; i < (q < 0 ? -q : q); ++i) {
+            bigMul(&power, 5);
+        }
+
+        uint64_t high;
+        uint64_t low;
+        if (q >= 0) {
+            top128(&power, &high, &low);
+        } else {
+            // 5^-q isn't a power of two, so this is the smallest z with 2^z > 5^-q.
+            const int z = bigBits(&power);
+            Big quotient;
+            bigDividePowerOfTwo(q >= -27 ? z + 127 : 2 * z + 128, &power, &quotient);
+            bigAdd1(&quotient);
+            top128(&quotient, &high, &low);
+        }
+
+        fprintf(file, "    0x%016llxull, 0x%016llxull,\n", (unsigned long long)high, (unsigned long long)low);
+    }
+
+    fprintf(file, "};\n\n#endif //NIFTY_POWERS_H\n");
+    fclose(file);
+
+    return 0;
+}
@@ -0,0 +1,332 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "pass.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "util/array.h"
+
+// Calls to functions in the module are replaced with a copy of the callee's blocks. Functions are visited callees
+// first, so what a callee inlined is inlined with it, and calls inside a cycle of the call graph are never inlined:
+// recursion would copy the function into itself forever. #[inline] on a function or a call inlines it whatever it
+// costs, #[noInline] on a function keeps it from being inlined except where a call asks for it, and every other call
+// is inlined when the callee is cheap enough. Size limits on the caller stop forced inlining from growing a function
+// without bound.
+//
+// The block of the call is split at it: what follows goes to a new block the callee's returns jump to, with a phi for
+// each return value when there is more than one return. Stack slots of the callee move to the caller's entry block,
+// so they are still made once per call of the caller, and copied instructions take the offset of the call.
+
+// What the cost model inlines: about as much code as the call itself takes to set up and return from.
+#define INLINE_COST_LIMIT 24
+// Callers stop getting inlining from the cost model past this many instructions, and forced inlining past the second.
+#define INLINE_GROWTH_LIMIT 4096
+#define INLINE_SIZE_LIMIT 65536
+
+static bool isConstantOp(const IrOp op) {
+    return op >= IR_INT && op <= IR_GLOBAL && op != IR_PHI;
+}
+
+// Roughly the instructions the function becomes: constants, parameters, phis and jumps are free, calls cost more.
+static int inlineCost(const IrFunction *function) {
+    int cost = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            const IrOp op = (IrOp)function->insts[block->insts[i]].op;
+            if (op == IR_CALL) {
+                cost += 4;
+            } else if (!isConstantOp(op) && op != IR_JUMP) {
+                ++cost;
+            }
+        }
+    }
+
+    return cost;
+}
+
+typedef struct {
+    const IrFunction *callee;
+    IrValue *values; // Copy of each value of the callee, the arguments for its parameters.
+} Copy;
+
+static void remapOperand(IrFunction *function, IrValue *operand, void *context) {
+    (void)function;
+    *operand = ((const Copy *)context)->values[*operand];
+}
+
+// Adds the callee's words at index to function's extra.
+static uint32_t copyExtra(IrFunction *function, const IrFunction *callee, const uint32_t index, const int count) {
+    return addIrExtra(function, callee->extra + index, count);
+}
+
+static uint32_t copyList(IrFunction *function, const IrFunction *callee, const uint32_t index) {
+    return index == 0 ? 0 : copyExtra(function, callee, index, (int)callee->extra[index] + 1);
+}
+
+// The j-th value the inlined call returns, for the call itself or an IR_EXTRACT of it. Returns are in the order their
+// jumps to rest were added, so a phi of them lines up with its predecessors.
+typedef struct {
+    IrFunction *function;
+    const Copy *copy;
+    IrBlock rest;
+    const uint32_t *returns; // Extra indices of the callee's return lists.
+    int returnCount;
+    IrValue *results;
+    int resultCount;
+} Results;
+
+static IrValue result(Results *results, const int j, const TypeId type) {
+    if (j < results->resultCount && results->results[j] != IR_NONE) {
+        return results->results[j];
+    }
+
+    IrFunction *function = results->function;
+    const IrFunction *callee = results->copy->callee;
+    IrValue value;
+    if (results->returnCount == 0 || j >= results->resultCount) {
+        value = insertIrInst(function, results->rest, 0, IR_UNDEF, type, 0, 0, 0);
+    } else if (results->returnCount == 1) {
+        value = results->copy->values[callee->extra[results->returns[0] + 1 + j]];
+    } else {
+        IrValue *operands = (IrValue *)malloc(sizeof(IrValue) * results->returnCount);
+        for (int r = 0; r < results->returnCount; ++r) {
+            operands[r] = results->copy->values[callee->extra[results->returns[r] + 1 + j]];
+        }
+        const TypeId phiType = callee->insts[callee->extra[results->returns[0] + 1 + j]].type;
+        value = insertIrInst(function, results->rest, 0, IR_PHI, phiType,
+                             addIrList(function, operands, results->returnCount), 0, 0);
+        free(operands);
+    }
+    if (j < results->resultCount) {
+        results->results[j] = value;
+    }
+    return value;
+}
+
+// Replaces call with a copy of callee's blocks.
+static void inlineCall(IrFunction *function, const IrValue call, const IrFunction *callee) {
+    const IrInst site = function->insts[call];
+    int index = 0;
+    while (function->blocks[site.block].insts[index] != call) {
+        ++index;
+    }
+    const IrBlock rest = splitIrBlock(function, site.block, index + 1);
+    function->blocks[site.block].count = index;
+
+    IrBlock *blocks = (IrBlock *)malloc(sizeof(IrBlock) * (callee->blockCount + 1));
+    for (int b = 0; b < callee->blockCount; ++b) {
+        blocks[b] = callee->blocks[b].removed ? IR_NO_BLOCK : addIrBlock(function, callee->blocks[b].kind);
+    }
+    for (int b = 0; b < callee->blockCount; ++b) {
+        for (int p = 0; p < callee->blocks[b].predCount && !callee->blocks[b].removed; ++p) {
+            addIrEdge(function, blocks[callee->blocks[b].preds[p]], blocks[b]);
+        }
+    }
+    addIrInst(function, site.block, IR_JUMP, TYPE_ID_NONE, blocks[0], 0, site.offset);
+    addIrEdge(function, site.block, blocks[0]);
+
+    // Parameters are the arguments, read before anything is added to extra.
+    Copy copy = {callee, (IrValue *)calloc(callee->instCount + 1, sizeof(IrValue))};
+    int argCount;
+    const uint32_t *args = irList(function, site.b, &argCount);
+    const IrBlockData *calleeEntry = &callee->blocks[0];
+    for (int i = 0; i < calleeEntry->count; ++i) {
+        const IrInst *inst = &callee->insts[calleeEntry->insts[i]];
+        if (inst->op == IR_PARAM) {
+            copy.values[calleeEntry->insts[i]] = inst->a < (uint32_t)argCount ? args[inst->a] : IR_NONE;
+        }
+    }
+
+    int allocIndex = 0;
+    while (allocIndex < function->blocks[0].count &&
+           function->insts[function->blocks[0].insts[allocIndex]].op == IR_PARAM) {
+        ++allocIndex;
+    }
+
+    uint32_t *returns = (uint32_t *)malloc(sizeof(uint32_t) * (callee->blockCount + 1));
+    int returnCount = 0;
+    for (int b = 0; b < callee->blockCount; ++b) {
+        const IrBlockData *block = &callee->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            const IrValue value = block->insts[i];
+            const IrInst *inst = &callee->insts[value];
+            uint32_t a = inst->a;
+            uint32_t extra = inst->b;
+            switch ((IrOp)inst->op) {
+                case IR_PARAM:
+                    continue;
+                case IR_RETURN:
+                    returns[returnCount++] = inst->a;
+                    addIrInst(function, blocks[b], IR_JUMP, TYPE_ID_NONE, rest, 0, site.offset);
+                    addIrEdge(function, blocks[b], rest);
+                    continue;
+                case IR_ALLOC:
+                    copy.values[value] = insertIrInst(function, 0, allocIndex++, IR_ALLOC, inst->type, inst->a, inst->b,
+                                                      site.offset);
+                    continue;
+                case IR_INT:
+                    a = copyExtra(function, callee, inst->a, 4);
+                    break;
+                case IR_FLOAT:
+                    a = copyExtra(function, callee, inst->a, 2);
+                    break;
+                case IR_PHI:
+                    a = copyList(function, callee, inst->a);
+                    break;
+                case IR_CALL:
+                case IR_TRAP:
+                    extra = copyList(function, callee, inst->b);
+                    break;
+                case IR_CHECK_RANGE:
+                    extra = copyExtra(function, callee, inst->b, 2);
+                    break;
+                case IR_JUMP:
+                    a = blocks[inst->a];
+                    break;
+                case IR_BRANCH: {
+                    const uint32_t targets[2] = {blocks[callee->extra[inst->b]], blocks[callee->extra[inst->b + 1]]};
+                    extra = addIrExtra(function, targets, 2);
+                    break;
+                }
+                default:
+                    break;
+            }
+            copy.values[value] = addIrInst(function, blocks[b], (IrOp)inst->op, inst->type, a, extra, site.offset);
+            function->insts[copy.values[value]].inlining = inst->inlining;
+        }
+    }
+
+    // Operands can name values copied after them, like phis of loops, so they are remapped once every value is.
+    for (int v = 1; v < callee->instCount; ++v) {
+        const IrOp op = (IrOp)callee->insts[v].op;
+        if (copy.values[v] != IR_NONE && op != IR_PARAM && op != IR_ALLOC) {
+            irForEachOperand(function, copy.values[v], remapOperand, &copy);
+        }
+    }
+
+    int resultCount = 0;
+    if (returnCount > 0 && returns[0] != 0) {
+        resultCount = (int)callee->extra[returns[0]];
+    }
+    Results results = {function, &copy, rest, returns, returnCount,
+                       (IrValue *)calloc(resultCount + 1, sizeof(IrValue)), resultCount};
+    IrValue replacement = IR_NONE;
+    if (site.type != TYPE_ID_NONE) {
+        replacement = result(&results, 0, site.type);
+    }
+    // Other return values are read with IR_EXTRACT, which is rare enough to look for among every instruction.
+    if (resultCount > 1 || returnCount == 0) {
+        for (int v = 1; v < function->instCount; ++v) {
+            const IrInst *inst = &function->insts[v];
+            if (inst->op == IR_EXTRACT && inst->a == call && inst->block != IR_NO_BLOCK) {
+                removeIrInst(function, (IrValue)v, result(&results, (int)inst->b, inst->type));
+            }
+        }
+    }
+    removeIrInst(function, call, replacement);
+
+    free(results.results);
+    free(returns);
+    free(copy.values);
+    free(blocks);
+}
+
+int inlineCalls(IrModule *module, StrBuffer *errors) {
+    (void)errors;
+
+    IrCallGraph graph;
+    initIrCallGraph(&graph, module);
+
+    IrValue *calls = nullptr;
+    int callCapacity = 0;
+    int inlined = 0;
+    for (int o = 0; o < module->functionCount; ++o) {
+        const int f = graph.order[o];
+        IrFunction *function = module->functions[f];
+
+        // Calls copied in from callees were already considered there.
+        int callCount = 0;
+        for (int b = 0; b < function->blockCount; ++b) {
+            const IrBlockData *block = &function->blocks[b];
+            for (int i = 0; i < block->count && !block->removed; ++i) {
+                const IrValue value = block->insts[i];
+                if (function->insts[value].op == IR_CALL && irCalledFunction(function, value) >= 0) {
+                    if (callCount == callCapacity) {
+                        calls = (IrValue *)array_grow(calls, &callCapacity, sizeof(IrValue));
+                    }
+                    calls[callCount++] = value;
+                }
+            }
+        }
+
+        int changes = 0;
+        for (int i = 0; i < callCount; ++i) {
+            const IrInst *site = &function->insts[calls[i]];
+            const int c = irCalledFunction(function, calls[i]);
+            const IrFunction *callee = module->functions[c];
+            if (callee->blockCount == 0 || callee->blocks[0].predCount > 0) {
+                continue;
+            }
+
+            char name[256];
+            irFunctionName(module, callee, name, sizeof(name));
+            const bool forced = site->inlining == INLINE_ALWAYS || callee->inlining == INLINE_ALWAYS;
+            const int cost = forced ? 0 : inlineCost(callee);
+            const int limit = forced ? INLINE_SIZE_LIMIT : INLINE_GROWTH_LIMIT;
+            if (graph.components[c] == graph.components[f]) {
+                addIrRemark(module, "inline", f, site->offset, "%s isn't inlined, it is recursive", name);
+            } else if (!forced && callee->inlining == INLINE_NEVER) {
+                addIrRemark(module, "inline", f, site->offset, "%s isn't inlined, it is #[noInline]", name);
+            } else if (cost > INLINE_COST_LIMIT) {
+                addIrRemark(module, "inline", f, site->offset, "%s isn't inlined, it costs %d over %d", name, cost,
+                            INLINE_COST_LIMIT);
+            } else if (function->instCount + callee->instCount > limit) {
+                addIrRemark(module, "inline", f, site->offset,
+                            "%s isn't inlined, the caller would pass %d instructions", name, limit);
+            } else {
+                const uint32_t offset = site->offset;
+                inlineCall(function, calls[i], callee);
+                if (forced) {
+                    addIrRemark(module, "inline", f, offset, "inlined %s, #[inline]", name);
+                } else {
+                    addIrRemark(module, "inline", f, offset, "inlined %s, cost %d", name, cost);
+                }
+                ++changes;
+            }
+        }
+
+        if (changes > 0) {
+            compactIrFunction(function);
+            removeTrivialPhis(function);
+            inlined += changes;
+        }
+    }
+
+    free(calls);
+    freeIrCallGraph(&graph);
+    return inlined;
+}
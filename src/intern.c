@@ -0,0 +1,286 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/arena.h"
+#include "util/hash.h"
+#include "util/str.h"
+#include "util/thread.h"
+
+// Names are spread over shards by the top bits of their hash, each with its own lock, table and copies of the bytes.
+#define INTERN_SHARD_BITS 4
+#define INTERN_SHARDS (1 << INTERN_SHARD_BITS)
+#define INTERN_MIN_SLOTS 256
+
+// Symbol entries are kept in segments of 1024, 2048, 4096... entries, so an entry never moves once it is written and
+// can be read without a lock by anyone holding its symbol.
+#define INTERN_FIRST_SEGMENT_BITS 10
+#define INTERN_SEGMENTS (32 - INTERN_FIRST_SEGMENT_BITS)
+
+// Names are stored with their length in the four bytes before them.
+typedef struct {
+    uint32_t hash;
+    Symbol symbol; // SYMBOL_NONE for an empty slot.
+    const char *name;
+} InternSlot;
+
+typedef struct {
+    Mutex lock;
+    InternSlot *slots;
+    uint32_t mask;
+    uint32_t count;
+    Arena names;
+    char padding[64]; // Keeps shards locked by different threads off the same cache line.
+} InternShard;
+
+struct Interner {
+    InternShard shards[INTERN_SHARDS];
+
+    Mutex lock; // Held while numbering a new name.
+    const char **segments[INTERN_SEGMENTS];
+    uint32_t count;
+};
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+
+static inline int highestBit(const uint32_t v) {
+    unsigned long idx;
+    _BitScanReverse(&idx, v);
+    return (int)idx;
+}
+#else
+#   define highestBit(v) (31 - __builtin_clz(v))
+#endif
+
+static const char **entryOf(const Interner *interner, const Symbol symbol) {
+    const uint32_t v = symbol - 1 + (1u << INTERN_FIRST_SEGMENT_BITS);
+    const int segment = highestBit(v) - INTERN_FIRST_SEGMENT_BITS;
+
+    return &interner->segments[segment][v - (1u << (segment + INTERN_FIRST_SEGMENT_BITS))];
+}
+
+static inline uint32_t nameLength(const char *name) {
+    uint32_t len;
+    memcpy(&len, name - sizeof(uint32_t), sizeof(uint32_t));
+    return len;
+}
+
+static inline bool sameName(const char *name, const char *start, const uint32_t len) {
+    return nameLength(name) == len && hash_same_bytes(name, start, len);
+}
+
+static const char *copyName(Arena *arena, const char *start, const uint32_t len) {
+    char *bytes = (char *)arena_alloc_packed(arena, sizeof(uint32_t) + len + 1);
+    if (bytes == nullptr) {
+        return nullptr;
+    }
+
+    memcpy(bytes, &len, sizeof(uint32_t));
+    memcpy(bytes + sizeof(uint32_t), start, len);
+    bytes[sizeof(uint32_t) + len] = '\0';
+
+    return bytes + sizeof(uint32_t);
+}
+
+Interner *initInterner() {
+    Interner *interner = (Interner *)calloc(1, sizeof(Interner));
+    if (interner == nullptr) {
+        println("Out of memory.");
+        return nullptr;
+    }
+
+    for (int i = 0; i < INTERN_SHARDS; ++i) {
+        InternShard *shard = &interner->shards[i];
+        mutex_init(&shard->lock);
+        shard->slots = (InternSlot *)calloc(INTERN_MIN_SLOTS, sizeof(InternSlot));
+        shard->mask = INTERN_MIN_SLOTS - 1;
+        shard->count = 0;
+        arena_init(&shard->names, 0);
+    }
+    mutex_init(&interner->lock);
+
+    return interner;
+}
+
+void freeInterner(Interner *interner) {
+    if (interner == nullptr) {
+        return;
+    }
+
+    for (int i = 0; i < INTERN_SHARDS; ++i) {
+        InternShard *shard = &interner->shards[i];
+        mutex_destroy(&shard->lock);
+        free(shard->slots);
+        arena_free(&shard->names);
+    }
+
+    for (int i = 0; i < INTERN_SEGMENTS; ++i) {
+        free(interner->segments[i]);
+    }
+    mutex_destroy(&interner->lock);
+    free(interner);
+}
+
+static Symbol addSymbol(Interner *interner, const char *name) {
+    mutex_lock(&interner->lock);
+    if (interner->count >= UINT32_MAX - (1u << INTERN_FIRST_SEGMENT_BITS)) {
+        mutex_unlock(&interner->lock);
+        println("Too many distinct names.");
+        return SYMBOL_NONE;
+    }
+
+    const Symbol symbol = ++interner->count;
+    const uint32_t v = symbol - 1 + (1u << INTERN_FIRST_SEGMENT_BITS);
+    const int segment = highestBit(v) - INTERN_FIRST_SEGMENT_BITS;
+    if (interner->segments[segment] == nullptr) {
+        interner->segments[segment] = (const char **)malloc(sizeof(const char *) << (segment + INTERN_FIRST_SEGMENT_BITS));
+    }
+
+    interner->segments[segment][v - (1u << (segment + INTERN_FIRST_SEGMENT_BITS))] = name;
+    mutex_unlock(&interner->lock);
+
+    return symbol;
+}
+
+static void growShard(InternShard *shard) {
+    const uint32_t size = (shard->mask + 1) * 2;
+    InternSlot *slots = (InternSlot *)calloc(size, sizeof(InternSlot));
+
+    for (uint32_t i = 0; i <= shard->mask; ++i) {
+        const InternSlot slot = shard->slots[i];
+        if (slot.symbol == SYMBOL_NONE) {
+            continue;
+        }
+
+        uint32_t at = slot.hash & (size - 1);
+        while (slots[at].symbol != SYMBOL_NONE) {
+            at = (at + 1) & (size - 1);
+        }
+        slots[at] = slot;
+    }
+
+    free(shard->slots);
+    shard->slots = slots;
+    shard->mask = size - 1;
+}
+
+// The symbol for [start, start + len), its stored copy in name.
+static Symbol internHashed(Interner *interner, const char *start, const uint32_t len, const uint64_t hash, const char **name) {
+    InternShard *shard = &interner->shards[hash >> (64 - INTERN_SHARD_BITS)];
+    const uint32_t h = (uint32_t)hash;
+
+    mutex_lock(&shard->lock);
+    uint32_t at = h & shard->mask;
+    for (; shard->slots[at].symbol != SYMBOL_NONE; at = (at + 1) & shard->mask) {
+        if (shard->slots[at].hash == h && sameName(shard->slots[at].name, start, len)) {
+            const Symbol symbol = shard->slots[at].symbol;
+            *name = shard->slots[at].name;
+            mutex_unlock(&shard->lock);
+            return symbol;
+        }
+    }
+
+    *name = copyName(&shard->names, start, len);
+    const Symbol symbol = *name != nullptr ? addSymbol(interner, *name) : SYMBOL_NONE;
+    if (symbol != SYMBOL_NONE) {
+        shard->slots[at].hash = h;
+        shard->slots[at].symbol = symbol;
+        shard->slots[at].name = *name;
+        // Linear probing stays short up to three quarters full.
+        if (++shard->count * 4 > (shard->mask + 1) * 3) {
+            growShard(shard);
+        }
+    }
+    mutex_unlock(&shard->lock);
+
+    return symbol;
+}
+
+Symbol intern(Interner *interner, const char *start, const int len) {
+    const char *name;
+    return internHashed(interner, start, (uint32_t)len, hash_bytes(start, (size_t)len), &name);
+}
+
+Symbol internCached(Interner *interner, InternCache *cache, const char *start, const int len) {
+    const uint64_t hash = hash_bytes(start, (size_t)len);
+    InternCacheEntry *entry = &cache->entries[hash & (INTERN_CACHE_SIZE - 1)];
+    if (entry->symbol != SYMBOL_NONE && entry->hash == (uint32_t)hash && sameName(entry->name, start, (uint32_t)len)) {
+        return entry->symbol;
+    }
+
+    const char *name;
+    const Symbol symbol = internHashed(interner, start, (uint32_t)len, hash, &name);
+    if (symbol != SYMBOL_NONE) {
+        entry->name = name;
+        entry->hash = (uint32_t)hash;
+        entry->symbol = symbol;
+    }
+
+    return symbol;
+}
+
+const char *symbolName(const Interner *interner, const Symbol symbol, int *len) {
+    if (symbol == SYMBOL_NONE) {
+        if (len != nullptr) {
+            *len = 0;
+        }
+        return "";
+    }
+
+    const char *name = *entryOf(interner, symbol);
+    if (len != nullptr) {
+        *len = (int)nameLength(name);
+    }
+
+    return name;
+}
+
+int internerSymbolCount(Interner *interner) {
+    mutex_lock(&interner->lock);
+    const int count = (int)interner->count;
+    mutex_unlock(&interner->lock);
+
+    return count;
+}
+
+size_t internerBytes(Interner *interner) {
+    size_t bytes = sizeof(Interner);
+    for (int i = 0; i < INTERN_SHARDS; ++i) {
+        InternShard *shard = &interner->shards[i];
+        mutex_lock(&shard->lock);
+        bytes += shard->names.used + sizeof(InternSlot) * (shard->mask + 1);
+        mutex_unlock(&shard->lock);
+    }
+
+    mutex_lock(&interner->lock);
+    for (int i = 0; i < INTERN_SEGMENTS && interner->segments[i] != nullptr; ++i) {
+        bytes += sizeof(const char *) << (i + INTERN_FIRST_SEGMENT_BITS);
+    }
+    mutex_unlock(&interner->lock);
+
+    return bytes;
+}
@@ -0,0 +1,69 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_INTERN_H
+#define NIFTY_INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+// Compiler wide table of names. Every distinct spelling gets one dense id, counting up from 1 in the order they are
+// first seen, and one NUL terminated copy of its bytes. Equal names have equal ids, so comparing them is comparing two
+// integers. Safe to use from any number of threads at once.
+typedef uint32_t Symbol;
+
+#define SYMBOL_NONE 0
+
+typedef struct Interner Interner;
+
+// Recently interned names, kept by each user of the interner (every lexer has one) so repeated names skip the shared
+// table and its locks. Zeroed memory is an empty cache.
+#define INTERN_CACHE_SIZE 1024
+
+typedef struct {
+    const char *name;
+    uint32_t hash;
+    Symbol symbol;
+} InternCacheEntry;
+
+typedef struct {
+    InternCacheEntry entries[INTERN_CACHE_SIZE];
+} InternCache;
+
+Interner *initInterner();
+void freeInterner(Interner *interner);
+
+Symbol intern(Interner *interner, const char *start, int len);
+// Same as intern, checking cache first and updating it. cache must only be used with this interner.
+Symbol internCached(Interner *interner, InternCache *cache, const char *start, int len);
+
+// NUL terminated spelling of symbol, its length in len if that isn't nullptr. "" for SYMBOL_NONE.
+const char *symbolName(const Interner *interner, Symbol symbol, int *len);
+
+// Number of distinct names, the highest id handed out.
+int internerSymbolCount(Interner *interner);
+// Bytes used to keep one copy of every name, including the table entries.
+size_t internerBytes(Interner *interner);
+
+#endif //NIFTY_INTERN_H
@@ -0,0 +1,1576 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "ir.h"
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "util/array.h"
+#include "util/hash.h"
+
+static uint32_t pointerHash(const void *pointer) {
+    const uintptr_t key = (uintptr_t)pointer;
+    return (uint32_t)hash_bytes((const char *)&key, sizeof(key));
+}
+
+IrModule *initIrModule(Program *program, CompilerConfig *config) {
+    IrModule *module = (IrModule *)calloc(1, sizeof(IrModule));
+    module->program = program;
+    module->config = config;
+    module->types = program->types;
+
+    module->functionMask = 63;
+    module->functionKeys = (const Declaration **)calloc(module->functionMask + 1, sizeof(Declaration *));
+    module->functionIndices = (int *)calloc(module->functionMask + 1, sizeof(int));
+    mutex_init(&module->remarkLock);
+
+    return module;
+}
+
+static void freeIrFunction(IrFunction *function) {
+    for (int i = 0; i < function->blockCount; ++i) {
+        free(function->blocks[i].insts);
+        free(function->blocks[i].preds);
+    }
+    free(function->blocks);
+    free(function->insts);
+    free(function->extra);
+    free(function);
+}
+
+void freeIrModule(IrModule *module) {
+    if (module == nullptr) {
+        return;
+    }
+
+    for (int i = 0; i < module->functionCount; ++i) {
+        freeIrFunction(module->functions[i]);
+    }
+    free(module->functions);
+    free(module->functionKeys);
+    free(module->functionIndices);
+    for (int i = 0; i < module->remarkCount; ++i) {
+        free(module->remarks[i].text);
+    }
+    free(module->remarks);
+    mutex_destroy(&module->remarkLock);
+    free(module);
+}
+
+static void indexFunction(IrModule *module, const Declaration *declaration, const int index) {
+    uint32_t at = pointerHash(declaration) & module->functionMask;
+    while (module->functionKeys[at] != nullptr) {
+        at = (at + 1) & module->functionMask;
+    }
+    module->functionKeys[at] = declaration;
+    module->functionIndices[at] = index;
+}
+
+IrFunction *addIrFunction(IrModule *module, const Declaration *declaration) {
+    if (module->functionCount == module->functionCapacity) {
+        module->functions = (IrFunction **)array_grow(module->functions, &module->functionCapacity,
+                                                      sizeof(IrFunction *));
+    }
+
+    IrFunction *function = (IrFunction *)calloc(1, sizeof(IrFunction));
+    function->declaration = declaration;
+    function->namespace = declaration->namespace;
+    function->name = declaration->name;
+    function->file = declaration->file;
+
+    // Instruction 0 stands for no value, extra 0 for the empty list.
+    function->instCapacity = 64;
+    function->insts = (IrInst *)calloc(function->instCapacity, sizeof(IrInst));
+    function->insts[0].block = IR_NO_BLOCK;
+    function->instCount = 1;
+    function->extraCapacity = 64;
+    function->extra = (uint32_t *)calloc(function->extraCapacity, sizeof(uint32_t));
+    function->extraCount = 1;
+
+    const int index = module->functionCount++;
+    module->functions[index] = function;
+
+    if ((uint32_t)module->functionCount * 2 > module->functionMask) {
+        free(module->functionKeys);
+        free(module->functionIndices);
+        module->functionMask = module->functionMask * 2 + 1;
+        module->functionKeys = (const Declaration **)calloc(module->functionMask + 1, sizeof(Declaration *));
+        module->functionIndices = (int *)calloc(module->functionMask + 1, sizeof(int));
+        for (int i = 0; i < module->functionCount; ++i) {
+            indexFunction(module, module->functions[i]->declaration, i);
+        }
+    } else {
+        indexFunction(module, declaration, index);
+    }
+
+    return function;
+}
+
+int irFunctionIndex(const IrModule *module, const Declaration *declaration) {
+    if (declaration == nullptr) {
+        return -1;
+    }
+
+    for (uint32_t at = pointerHash(declaration) & module->functionMask; module->functionKeys[at] != nullptr;
+         at = (at + 1) & module->functionMask) {
+        if (module->functionKeys[at] == declaration) {
+            return module->functionIndices[at];
+        }
+    }
+
+    return -1;
+}
+
+const char *irFunctionName(const IrModule *module, const IrFunction *function, char *buf, const size_t size) {
+    int len;
+    const char *name = symbolName(module->config->interner, function->name, &len);
+    if (function->namespace == SYMBOL_NONE) {
+        snprintf(buf, size, "%.*s", len, name);
+    } else {
+        int namespaceLen;
+        const char *namespace = symbolName(module->config->interner, function->namespace, &namespaceLen);
+        snprintf(buf, size, "%.*s::%.*s", namespaceLen, namespace, len, name);
+    }
+
+    return buf;
+}
+
+IrBlock addIrBlock(IrFunction *function, const IrBlockKind kind) {
+    if (function->blockCount == function->blockCapacity) {
+        function->blocks = (IrBlockData *)array_grow(function->blocks, &function->blockCapacity, sizeof(IrBlockData));
+    }
+
+    IrBlockData *block = &function->blocks[function->blockCount];
+    memset(block, 0, sizeof(IrBlockData));
+    block->kind = kind;
+    return (IrBlock)function->blockCount++;
+}
+
+void addIrEdge(IrFunction *function, const IrBlock from, const IrBlock to) {
+    IrBlockData *block = &function->blocks[to];
+    if (block->predCount == block->predCapacity) {
+        block->preds = (IrBlock *)array_grow(block->preds, &block->predCapacity, sizeof(IrBlock));
+    }
+    block->preds[block->predCount++] = from;
+}
+
+void removeIrEdge(IrFunction *function, const IrBlock from, const IrBlock to) {
+    IrBlockData *block = &function->blocks[to];
+    int index = 0;
+    while (index < block->predCount && block->preds[index] != from) {
+        ++index;
+    }
+    if (index == block->predCount) {
+        return;
+    }
+
+    memmove(block->preds + index, block->preds + index + 1, sizeof(IrBlock) * (block->predCount - index - 1));
+    --block->predCount;
+
+    for (int i = 0; i < block->count; ++i) {
+        const IrInst *inst = &function->insts[block->insts[i]];
+        if (inst->op != IR_PHI) {
+            continue;
+        }
+
+        int count;
+        uint32_t *operands = irList(function, inst->a, &count);
+        if (index < count) {
+            memmove(operands + index, operands + index + 1, sizeof(uint32_t) * (count - index - 1));
+            --function->extra[inst->a];
+        }
+    }
+}
+
+static IrValue newInst(IrFunction *function, const IrBlock block, const IrOp op, const TypeId type, const uint32_t a,
+                       const uint32_t b, const uint32_t offset) {
+    if (function->instCount == function->instCapacity) {
+        function->insts = (IrInst *)array_grow(function->insts, &function->instCapacity, sizeof(IrInst));
+    }
+
+    const IrValue value = (IrValue)function->instCount++;
+    function->insts[value] = (IrInst){(uint8_t)op, 0, INLINE_MAYBE, type, block, a, b, offset};
+    return value;
+}
+
+IrValue addIrInst(IrFunction *function, const IrBlock block, const IrOp op, const TypeId type, const uint32_t a,
+                  const uint32_t b, const uint32_t offset) {
+    return insertIrInst(function, block, function->blocks[block].count, op, type, a, b, offset);
+}
+
+IrValue insertIrInst(IrFunction *function, const IrBlock block, const int index, const IrOp op, const TypeId type,
+                     const uint32_t a, const uint32_t b, const uint32_t offset) {
+    const IrValue value = newInst(function, block, op, type, a, b, offset);
+
+    IrBlockData *data = &function->blocks[block];
+    if (data->count == data->capacity) {
+        data->insts = (IrValue *)array_grow(data->insts, &data->capacity, sizeof(IrValue));
+    }
+    memmove(data->insts + index + 1, data->insts + index, sizeof(IrValue) * (data->count - index));
+    data->insts[index] = value;
+    ++data->count;
+
+    return value;
+}
+
+void moveIrInst(IrFunction *function, const IrValue value, const IrBlock block, const int index) {
+    IrInst *inst = &function->insts[value];
+    IrBlockData *from = &function->blocks[inst->block];
+    for (int i = 0; i < from->count; ++i) {
+        if (from->insts[i] == value) {
+            memmove(from->insts + i, from->insts + i + 1, sizeof(IrValue) * (from->count - i - 1));
+            --from->count;
+            break;
+        }
+    }
+
+    IrBlockData *data = &function->blocks[block];
+    if (data->count == data->capacity) {
+        data->insts = (IrValue *)array_grow(data->insts, &data->capacity, sizeof(IrValue));
+    }
+    memmove(data->insts + index + 1, data->insts + index, sizeof(IrValue) * (data->count - index));
+    data->insts[index] = value;
+    ++data->count;
+    inst->block = block;
+}
+
+void removeIrInst(IrFunction *function, const IrValue value, const IrValue replacement) {
+    IrInst *inst = &function->insts[value];
+    inst->op = IR_REMOVED;
+    inst->block = IR_NO_BLOCK;
+    inst->a = replacement;
+    inst->b = 0;
+}
+
+// What value stands for now, following the replacements of removed instructions.
+static IrValue resolveValue(const IrFunction *function, IrValue value) {
+    while (value != IR_NONE && function->insts[value].op == IR_REMOVED) {
+        value = function->insts[value].a;
+    }
+
+    return value;
+}
+
+static void resolveOperand(IrFunction *function, IrValue *operand, void *context) {
+    (void)context;
+    *operand = resolveValue(function, *operand);
+}
+
+void compactIrFunction(IrFunction *function) {
+    for (int b = 0; b < function->blockCount; ++b) {
+        IrBlockData *block = &function->blocks[b];
+        int kept = 0;
+        for (int i = 0; i < block->count; ++i) {
+            const IrValue value = block->insts[i];
+            if (function->insts[value].op != IR_REMOVED) {
+                irForEachOperand(function, value, resolveOperand, nullptr);
+                block->insts[kept++] = value;
+            }
+        }
+        block->count = kept;
+    }
+}
+
+uint32_t addIrExtra(IrFunction *function, const uint32_t *words, const int count) {
+    while (function->extraCount + count > function->extraCapacity) {
+        function->extra = (uint32_t *)array_grow(function->extra, &function->extraCapacity, sizeof(uint32_t));
+    }
+
+    const uint32_t index = (uint32_t)function->extraCount;
+    if (count > 0) {
+        memcpy(function->extra + index, words, sizeof(uint32_t) * count);
+    }
+    function->extraCount += count;
+    return index;
+}
+
+uint32_t addIrList(IrFunction *function, const IrValue *items, const int count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    const uint32_t length = (uint32_t)count;
+    const uint32_t index = addIrExtra(function, &length, 1);
+    addIrExtra(function, items, count);
+    return index;
+}
+
+IrValue addIrInt(IrFunction *function, const IrBlock block, const TypeId type, const int64_t value,
+                 const uint32_t offset) {
+    const uint32_t high = value < 0 ? UINT32_MAX : 0;
+    const uint32_t words[4] = {(uint32_t)value, (uint32_t)((uint64_t)value >> 32), high, high};
+    return addIrInst(function, block, IR_INT, type, addIrExtra(function, words, 4), 0, offset);
+}
+
+IrValue insertIrConstant(IrFunction *function, const IrBlock block, const int index, const Constant *constant,
+                         const uint32_t offset) {
+    const TypeId type = primitiveType(constant->type);
+    switch (constant->kind) {
+        case CONST_INT: {
+            uint32_t words[4];
+            constantWords(constant, words);
+            return insertIrInst(function, block, index, IR_INT, type, addIrExtra(function, words, 4), 0, offset);
+        }
+        case CONST_FLOAT: {
+            uint32_t words[2];
+            memcpy(words, &constant->real, sizeof(words));
+            return insertIrInst(function, block, index, IR_FLOAT, type, addIrExtra(function, words, 2), 0, offset);
+        }
+        default:
+            return insertIrInst(function, block, index, IR_BOOL, type, constant->low != 0, 0, offset);
+    }
+}
+
+bool irConstant(const IrFunction *function, const IrValue value, Constant *constant) {
+    const IrInst *inst = irInst(function, value);
+    if (inst->type == TYPE_ID_NONE || inst->type > primitiveType(TYPE_ANY)) {
+        return false;
+    }
+
+    const TypeKind kind = (TypeKind)(inst->type - 1);
+    switch ((IrOp)inst->op) {
+        case IR_INT: {
+            if (!isIntegerKind(kind)) {
+                return false;
+            }
+            // A literal that doesn't fit its type is no value of it, rather than its low bits.
+            const uint32_t *words = function->extra + inst->a;
+            *constant = wordsConstant(kind, words);
+            uint32_t kept[4];
+            constantWords(constant, kept);
+            return memcmp(kept, words, sizeof(kept)) == 0;
+        }
+        case IR_FLOAT: {
+            if (!isFloatKind(kind)) {
+                return false;
+            }
+            const uint64_t bits = (uint64_t)function->extra[inst->a] | (uint64_t)function->extra[inst->a + 1] << 32;
+            memset(constant, 0, sizeof(Constant));
+            constant->kind = CONST_FLOAT;
+            constant->type = kind;
+            memcpy(&constant->real, &bits, sizeof(double));
+            return true;
+        }
+        case IR_BOOL:
+            memset(constant, 0, sizeof(Constant));
+            constant->kind = CONST_BOOL;
+            constant->type = kind;
+            constant->low = inst->a != 0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Whether the instruction is a value other instructions can name, they are numbered when printed.
+static bool hasValue(const IrOp op) {
+    return op != IR_STORE && op != IR_DELETE && op != IR_REGION_DELETE && op != IR_CHECK_BOUNDS &&
+           op != IR_CHECK_OVERFLOW && op != IR_CHECK_DIVISOR && op != IR_CHECK_RANGE && op != IR_TRAP &&
+           !isIrTerminator(op);
+}
+
+bool irHasEffects(const IrOp op) {
+    switch (op) {
+        case IR_DELETE:
+        case IR_REGION_DELETE:
+        case IR_STORE:
+        case IR_CALL:
+        case IR_CHECK_BOUNDS:
+        case IR_CHECK_OVERFLOW:
+        case IR_CHECK_DIVISOR:
+        case IR_CHECK_RANGE:
+        case IR_TRAP:
+            return true;
+        default:
+            return isIrTerminator(op);
+    }
+}
+
+bool irNeedsType(const IrOp op) {
+    switch (op) {
+        case IR_FUNCTION:
+        case IR_EXTERN:
+        case IR_CALL:
+        case IR_EXTRACT:
+        case IR_REGION:
+            return false;
+        default:
+            return hasValue(op);
+    }
+}
+
+bool irIsInteger(const TypeId type) {
+    return (type >= primitiveType(TYPE_U8) && type <= primitiveType(TYPE_S28)) || type == primitiveType(TYPE_UINTPTR);
+}
+
+bool irIsSigned(const TypeId type) {
+    return type >= primitiveType(TYPE_S8) && type <= primitiveType(TYPE_S28);
+}
+
+IrValue irTerminator(const IrFunction *function, const IrBlock block) {
+    const IrBlockData *data = &function->blocks[block];
+    if (data->count == 0) {
+        return IR_NONE;
+    }
+
+    const IrValue last = data->insts[data->count - 1];
+    return isIrTerminator((IrOp)function->insts[last].op) ? last : IR_NONE;
+}
+
+int irSuccessors(const IrFunction *function, const IrBlock block, IrBlock succs[2]) {
+    const IrValue terminator = irTerminator(function, block);
+    if (terminator == IR_NONE) {
+        return 0;
+    }
+
+    const IrInst *inst = &function->insts[terminator];
+    switch (inst->op) {
+        case IR_JUMP:
+            succs[0] = inst->a;
+            return 1;
+        case IR_BRANCH:
+            succs[0] = function->extra[inst->b];
+            succs[1] = function->extra[inst->b + 1];
+            return succs[0] == succs[1] ? 1 : 2;
+        default:
+            return 0;
+    }
+}
+
+IrBlock splitIrBlock(IrFunction *function, const IrBlock block, const int index) {
+    const IrBlock rest = addIrBlock(function, BLOCK_PLAIN);
+    IrBlockData *from = &function->blocks[block];
+    IrBlockData *to = &function->blocks[rest];
+    to->count = to->capacity = from->count - index;
+    to->insts = (IrValue *)malloc(sizeof(IrValue) * (to->capacity + 1));
+    memcpy(to->insts, from->insts + index, sizeof(IrValue) * to->count);
+    for (int i = 0; i < to->count; ++i) {
+        function->insts[to->insts[i]].block = rest;
+    }
+    from->count = index;
+
+    // The edges keep their place among the predecessors, and so the phis keep theirs.
+    IrBlock succs[2];
+    const int count = irSuccessors(function, rest, succs);
+    for (int s = 0; s < count; ++s) {
+        IrBlockData *succ = &function->blocks[succs[s]];
+        for (int p = 0; p < succ->predCount; ++p) {
+            if (succ->preds[p] == block) {
+                succ->preds[p] = rest;
+            }
+        }
+    }
+
+    return rest;
+}
+
+static IrBlock intersect(const IrBlock *idom, const int *postorder, IrBlock a, IrBlock b) {
+    while (a != b) {
+        while (postorder[a] < postorder[b]) {
+            a = idom[a];
+        }
+        while (postorder[b] < postorder[a]) {
+            b = idom[b];
+        }
+    }
+
+    return a;
+}
+
+int irPostorder(const IrFunction *function, IrBlock *order) {
+    const int count = function->blockCount;
+    IrBlock *stack = (IrBlock *)malloc(sizeof(IrBlock) * (count + 1));
+    int *edges = (int *)malloc(sizeof(int) * (count + 1));
+    for (int b = 0; b < count; ++b) {
+        edges[b] = -1;
+    }
+
+    int top = 0;
+    int ordered = 0;
+    stack[top++] = 0;
+    edges[0] = 0; // Seen, and how many of its successors have been.
+    while (top > 0) {
+        const IrBlock block = stack[top - 1];
+        IrBlock succs[2];
+        const int succCount = irSuccessors(function, block, succs);
+        if (edges[block] < succCount) {
+            const IrBlock succ = succs[edges[block]++];
+            if (edges[succ] < 0) {
+                edges[succ] = 0;
+                stack[top++] = succ;
+            }
+            continue;
+        }
+
+        order[ordered++] = block;
+        --top;
+    }
+
+    free(edges);
+    free(stack);
+    return ordered;
+}
+
+// Cooper, Harvey and Kennedy's iteration over the blocks in reverse postorder.
+void irDominators(const IrFunction *function, IrBlock *idom) {
+    const int count = function->blockCount;
+    int *postorder = (int *)malloc(sizeof(int) * (count + 1));
+    IrBlock *order = (IrBlock *)malloc(sizeof(IrBlock) * (count + 1));
+    for (int b = 0; b < count; ++b) {
+        idom[b] = IR_NO_BLOCK;
+    }
+    const int ordered = irPostorder(function, order);
+    for (int i = 0; i < ordered; ++i) {
+        postorder[order[i]] = i;
+    }
+
+    idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = ordered - 2; i >= 0; --i) {
+            const IrBlock block = order[i];
+            const IrBlockData *data = &function->blocks[block];
+            IrBlock found = IR_NO_BLOCK;
+            for (int p = 0; p < data->predCount; ++p) {
+                const IrBlock pred = data->preds[p];
+                if (idom[pred] != IR_NO_BLOCK) {
+                    found = found == IR_NO_BLOCK ? pred : intersect(idom, postorder, pred, found);
+                }
+            }
+            if (found != idom[block]) {
+                idom[block] = found;
+                changed = true;
+            }
+        }
+    }
+
+    free(order);
+    free(postorder);
+}
+
+bool irDominates(const IrBlock *idom, const IrBlock a, IrBlock b) {
+    while (b != a) {
+        if (b == 0 || idom[b] == IR_NO_BLOCK) {
+            return false;
+        }
+        b = idom[b];
+    }
+
+    return true;
+}
+
+int irLoopBlocks(const IrFunction *function, const IrBlock header, bool *inLoop) {
+    memset(inLoop, 0, sizeof(bool) * function->blockCount);
+    IrBlock *stack = (IrBlock *)malloc(sizeof(IrBlock) * (function->blockCount + 1));
+    const IrBlockData *data = &function->blocks[header];
+    inLoop[header] = true;
+    int count = 1;
+    int top = 0;
+    const IrBlock latch = data->preds[data->predCount - 1];
+    if (!inLoop[latch]) {
+        inLoop[latch] = true;
+        stack[top++] = latch;
+        ++count;
+    }
+    while (top > 0) {
+        const IrBlockData *block = &function->blocks[stack[--top]];
+        for (int p = 0; p < block->predCount; ++p) {
+            if (!inLoop[block->preds[p]]) {
+                inLoop[block->preds[p]] = true;
+                stack[top++] = block->preds[p];
+                ++count;
+            }
+        }
+    }
+
+    free(stack);
+    return count;
+}
+
+void irForEachOperand(IrFunction *function, const IrValue value, const IrOperandFn visit, void *context) {
+    IrInst *inst = &function->insts[value];
+    switch ((IrOp)inst->op) {
+        case IR_PHI:
+        case IR_RETURN: {
+            int count;
+            uint32_t *items = irList(function, inst->a, &count);
+            for (int i = 0; i < count; ++i) {
+                visit(function, &items[i], context);
+            }
+            break;
+        }
+        case IR_TRAP: {
+            int count;
+            uint32_t *items = irList(function, inst->b, &count);
+            for (int i = 0; i < count; ++i) {
+                visit(function, &items[i], context);
+            }
+            break;
+        }
+        case IR_CHECK_RANGE:
+            visit(function, &inst->a, context);
+            visit(function, &function->extra[inst->b], context);
+            visit(function, &function->extra[inst->b + 1], context);
+            break;
+        case IR_CALL: {
+            visit(function, &inst->a, context);
+            int count;
+            uint32_t *items = irList(function, inst->b, &count);
+            for (int i = 0; i < count; ++i) {
+                visit(function, &items[i], context);
+            }
+            break;
+        }
+        case IR_STORE:
+        case IR_ELEMENT:
+        case IR_CHECK_BOUNDS:
+        case IR_REGION_DELETE:
+            visit(function, &inst->a, context);
+            visit(function, &inst->b, context);
+            break;
+        case IR_NEW:
+            if (inst->a != IR_NONE) {
+                visit(function, &inst->a, context);
+            }
+            if (inst->b != IR_NONE) {
+                visit(function, &inst->b, context);
+            }
+            break;
+        case IR_REGION_NEW:
+            visit(function, &inst->a, context);
+            if (inst->b != IR_NONE) {
+                visit(function, &inst->b, context);
+            }
+            break;
+        case IR_NEG:
+        case IR_NOT:
+        case IR_BIT_NOT:
+        case IR_CONVERT:
+        case IR_LEN:
+        case IR_HAS_VALUE:
+        case IR_UNWRAP:
+        case IR_OVERFLOWED:
+        case IR_DELETE:
+        case IR_LOAD:
+        case IR_FIELD:
+        case IR_EXTRACT:
+        case IR_CHECK_OVERFLOW:
+        case IR_CHECK_DIVISOR:
+        case IR_BRANCH:
+            visit(function, &inst->a, context);
+            break;
+        default:
+            if (inst->op >= IR_ADD && inst->op <= IR_GE) {
+                visit(function, &inst->a, context);
+                visit(function, &inst->b, context);
+            }
+            break;
+    }
+}
+
+int irCalledFunction(const IrFunction *function, const IrValue call) {
+    const IrInst *callee = &function->insts[function->insts[call].a];
+    return callee->op == IR_FUNCTION ? (int)callee->a : -1;
+}
+
+static void addCallees(const IrModule *module, IrCallGraph *graph) {
+    graph->starts = (int *)calloc(module->functionCount + 1, sizeof(int));
+    graph->callees = nullptr;
+    int count = 0;
+    int capacity = 0;
+    for (int f = 0; f < module->functionCount; ++f) {
+        const IrFunction *function = module->functions[f];
+        graph->starts[f] = count;
+        for (int b = 0; b < function->blockCount; ++b) {
+            const IrBlockData *block = &function->blocks[b];
+            for (int i = 0; i < block->count && !block->removed; ++i) {
+                if (function->insts[block->insts[i]].op != IR_CALL) {
+                    continue;
+                }
+
+                const int callee = irCalledFunction(function, block->insts[i]);
+                if (callee >= 0) {
+                    if (count == capacity) {
+                        graph->callees = (int *)array_grow(graph->callees, &capacity, sizeof(int));
+                    }
+                    graph->callees[count++] = callee;
+                }
+            }
+        }
+    }
+    graph->starts[module->functionCount] = count;
+}
+
+typedef struct {
+    int function;
+    int edge;
+} CallFrame;
+
+// Tarjan's strongly connected components without recursion, which come out callees first.
+static void orderFunctions(IrCallGraph *graph, const int count) {
+    graph->order = (int *)malloc(sizeof(int) * (count + 1));
+    graph->components = (int *)malloc(sizeof(int) * (count + 1));
+    int *indices = (int *)malloc(sizeof(int) * (count + 1));
+    int *lows = (int *)malloc(sizeof(int) * (count + 1));
+    bool *onStack = (bool *)calloc(count + 1, sizeof(bool));
+    int *stack = (int *)malloc(sizeof(int) * (count + 1));
+    CallFrame *frames = (CallFrame *)malloc(sizeof(CallFrame) * (count + 1));
+    for (int i = 0; i < count; ++i) {
+        indices[i] = -1;
+    }
+
+    int next = 0;
+    int top = 0;
+    int ordered = 0;
+    int component = 0;
+    for (int root = 0; root < count; ++root) {
+        if (indices[root] >= 0) {
+            continue;
+        }
+
+        int depth = 0;
+        frames[depth++] = (CallFrame){root, graph->starts[root]};
+        indices[root] = lows[root] = next++;
+        stack[top++] = root;
+        onStack[root] = true;
+        while (depth > 0) {
+            CallFrame *frame = &frames[depth - 1];
+            const int f = frame->function;
+            if (frame->edge < graph->starts[f + 1]) {
+                const int callee = graph->callees[frame->edge++];
+                if (indices[callee] < 0) {
+                    indices[callee] = lows[callee] = next++;
+                    stack[top++] = callee;
+                    onStack[callee] = true;
+                    frames[depth++] = (CallFrame){callee, graph->starts[callee]};
+                } else if (onStack[callee] && indices[callee] < lows[f]) {
+                    lows[f] = indices[callee];
+                }
+                continue;
+            }
+
+            if (lows[f] == indices[f]) {
+                int member;
+                do {
+                    member = stack[--top];
+                    onStack[member] = false;
+                    graph->components[member] = component;
+                    graph->order[ordered++] = member;
+                } while (member != f);
+                ++component;
+            }
+            --depth;
+            if (depth > 0 && lows[f] < lows[frames[depth - 1].function]) {
+                lows[frames[depth - 1].function] = lows[f];
+            }
+        }
+    }
+
+    free(frames);
+    free(stack);
+    free(onStack);
+    free(lows);
+    free(indices);
+}
+
+void initIrCallGraph(IrCallGraph *graph, const IrModule *module) {
+    addCallees(module, graph);
+    orderFunctions(graph, module->functionCount);
+}
+
+void freeIrCallGraph(IrCallGraph *graph) {
+    free(graph->components);
+    free(graph->order);
+    free(graph->callees);
+    free(graph->starts);
+}
+
+bool removeTrivialPhis(IrFunction *function) {
+    bool any = false;
+    bool changed = true;
+    IrValue undef = IR_NONE;
+    while (changed) {
+        changed = false;
+        for (int b = 0; b < function->blockCount; ++b) {
+            const IrBlockData *block = &function->blocks[b];
+            for (int i = 0; i < block->count; ++i) {
+                const IrValue phi = block->insts[i];
+                if (function->insts[phi].op != IR_PHI) {
+                    continue;
+                }
+
+                int count;
+                const uint32_t *operands = irList(function, function->insts[phi].a, &count);
+                IrValue same = IR_NONE;
+                bool trivial = true;
+                for (int j = 0; j < count && trivial; ++j) {
+                    const IrValue operand = resolveValue(function, operands[j]);
+                    if (operand == phi || operand == same) {
+                        continue;
+                    }
+                    trivial = same == IR_NONE;
+                    same = operand;
+                }
+                if (!trivial) {
+                    continue;
+                }
+
+                // Only reached through itself, or from nowhere.
+                if (same == IR_NONE) {
+                    if (undef == IR_NONE) {
+                        undef = insertIrInst(function, 0, 0, IR_UNDEF, function->insts[phi].type, 0, 0,
+                                             function->insts[phi].offset);
+                        block = &function->blocks[b];
+                    }
+                    same = undef;
+                }
+                removeIrInst(function, phi, same);
+                changed = any = true;
+            }
+        }
+        if (changed) {
+            compactIrFunction(function);
+        }
+    }
+
+    return any;
+}
+
+static void verifyError(const IrModule *module, const IrFunction *function, StrBuffer *errors, const char *what,
+                        const IrBlock block, const IrValue value) {
+    int len = 0;
+    const char *name = symbolName(module->config->interner, function->name, &len);
+    str_buf_append(errors, "IR of %.*s, block %u, value %u: %s\n", len, name, block, value, what);
+}
+
+typedef struct {
+    const IrFunction *function;
+    bool valid;
+} OperandCheck;
+
+static void checkOperand(IrFunction *function, IrValue *operand, void *context) {
+    OperandCheck *check = (OperandCheck *)context;
+    if (*operand == IR_NONE || *operand >= (IrValue)function->instCount ||
+        function->insts[*operand].block == IR_NO_BLOCK || function->insts[*operand].op == IR_REMOVED) {
+        check->valid = false;
+    }
+}
+
+// Whether value is of type, or either isn't known, like the results of calls of the nsl.
+static bool sameType(const IrFunction *function, const IrValue value, const TypeId type) {
+    const TypeId own = function->insts[value].type;
+    return own == TYPE_ID_NONE || type == TYPE_ID_NONE || own == type;
+}
+
+static bool isPointerTo(const TypeTable *types, const TypeId pointer, const TypeId element) {
+    if (pointer == TYPE_ID_NONE || element == TYPE_ID_NONE) {
+        return true;
+    }
+    const Type *type = typeOf(types, pointer);
+    return type->form == FORM_POINTER && type->a == element;
+}
+
+// The rules of the types of the operands and value of the instruction, checked where they are known.
+static void verifyTypes(const IrModule *module, const IrFunction *function, StrBuffer *errors, const IrBlock block,
+                        const IrValue value) {
+    const IrInst *inst = &function->insts[value];
+    const TypeId b32 = primitiveType(TYPE_B32);
+    const char *error = nullptr;
+    if (inst->type == TYPE_ID_NONE && irNeedsType((IrOp)inst->op)) {
+        error = "value has no type";
+    }
+
+    Constant constant;
+    switch ((IrOp)inst->op) {
+        case IR_INT:
+            if (irIsInteger(inst->type) && !irConstant(function, value, &constant)) {
+                error = "integer doesn't fit its type";
+            }
+            break;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD: case IR_ADD_SAT: case IR_SUB_SAT:
+        case IR_MUL_SAT: case IR_AND: case IR_OR: case IR_XOR:
+            if (!sameType(function, inst->a, inst->type) || !sameType(function, inst->b, inst->type)) {
+                error = "operands aren't of the type of the result";
+            }
+            break;
+        case IR_SHL: case IR_SHR: case IR_SHL_SAT: {
+            const TypeId amount = function->insts[inst->b].type;
+            if (!sameType(function, inst->a, inst->type) || (amount != TYPE_ID_NONE && !irIsInteger(amount))) {
+                error = "shift of another type than its result, or by an amount that isn't an integer";
+            }
+            break;
+        }
+        case IR_EQ: case IR_NE: case IR_LT: case IR_LE: case IR_GT: case IR_GE:
+            if (inst->type != b32 || !sameType(function, inst->b, function->insts[inst->a].type)) {
+                error = "comparison of operands of different types, or whose result isn't b32";
+            }
+            break;
+        case IR_NEG: case IR_BIT_NOT:
+            if (!sameType(function, inst->a, inst->type)) {
+                error = "operand isn't of the type of the result";
+            }
+            break;
+        case IR_NOT: case IR_HAS_VALUE:
+            if (inst->type != b32) {
+                error = "result isn't b32";
+            }
+            break;
+        case IR_OVERFLOWED: case IR_CHECK_OVERFLOW: {
+            const IrOp checked = (IrOp)function->insts[inst->a].op;
+            if ((checked < IR_ADD || checked > IR_MOD) && checked != IR_NEG) {
+                error = "overflow of something that isn't + - * / % or unary -";
+            } else if (inst->op == IR_OVERFLOWED && inst->type != b32) {
+                error = "result isn't b32";
+            }
+            break;
+        }
+        case IR_CHECK_DIVISOR: {
+            const TypeId divisor = function->insts[inst->a].type;
+            if (divisor != TYPE_ID_NONE && !irIsInteger(divisor)) {
+                error = "divisor check of something that isn't an integer";
+            }
+            break;
+        }
+        case IR_BRANCH:
+            if (!sameType(function, inst->a, b32)) {
+                error = "condition isn't b32";
+            }
+            break;
+        case IR_PHI: {
+            int count;
+            const IrValue *items = irList(function, inst->a, &count);
+            for (int i = 0; i < count; ++i) {
+                if (!sameType(function, items[i], inst->type)) {
+                    error = "operand isn't of the type of the phi";
+                }
+            }
+            break;
+        }
+        case IR_RETURN: {
+            int count;
+            const IrValue *items = irList(function, inst->a, &count);
+            const Type *type = function->type != TYPE_ID_NONE ? typeOf(module->types, function->type) : nullptr;
+            for (int i = 0; i < count && type != nullptr; ++i) {
+                if (type->a + i >= type->count || !sameType(function, items[i], type->items[type->a + i])) {
+                    error = "returns a value that isn't of the function's return type";
+                }
+            }
+            break;
+        }
+        case IR_CALL: {
+            // Methods of nsl types are called through values of a type that isn't known, so only calls of functions
+            // of the module are checked. The values of a variadic argument come one by one, last.
+            const IrInst *callee = &function->insts[inst->a];
+            if (callee->op != IR_FUNCTION || callee->type == TYPE_ID_NONE) {
+                break;
+            }
+            int count;
+            const IrValue *items = irList(function, inst->b, &count);
+            const Type *type = typeOf(module->types, callee->type);
+            const int last = (int)type->a - 1;
+            const Type *variadic = last >= 0 ? typeOf(module->types, type->items[last]) : nullptr;
+            if (variadic != nullptr && variadic->form != FORM_VARIADIC) {
+                variadic = nullptr;
+            }
+            for (int i = 0; i < count; ++i) {
+                const bool packed = i == last && sameType(function, items[i], type->items[i]);
+                const TypeId param = variadic != nullptr && i >= last ? variadic->a
+                                     : i <= last                      ? type->items[i]
+                                                                      : TYPE_ID_NONE;
+                if (!packed && (param == TYPE_ID_NONE || !sameType(function, items[i], param))) {
+                    error = "argument isn't of the type of the parameter";
+                }
+            }
+            break;
+        }
+        case IR_LOAD:
+            if (!isPointerTo(module->types, function->insts[inst->a].type, inst->type)) {
+                error = "load from an address that doesn't point to its type";
+            }
+            break;
+        case IR_STORE:
+            if (!isPointerTo(module->types, function->insts[inst->a].type, function->insts[inst->b].type)) {
+                error = "store to an address that doesn't point to the value's type";
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (error != nullptr) {
+        verifyError(module, function, errors, error, block, value);
+    }
+}
+
+typedef struct {
+    const IrBlock *idom;
+    const int *position; // Of each instruction in its block.
+    IrBlock block; // Where the operands are used, before the index-th instruction.
+    int index;
+    bool dominated;
+} DominanceCheck;
+
+static void checkDominance(IrFunction *function, IrValue *operand, void *context) {
+    DominanceCheck *check = (DominanceCheck *)context;
+    const IrBlock block = function->insts[*operand].block;
+    if (block == check->block ? check->position[*operand] >= check->index
+                              : !irDominates(check->idom, block, check->block)) {
+        check->dominated = false;
+    }
+}
+
+// Every value is defined before its uses: in a block that dominates theirs, or earlier in the same block. The operands
+// of phis are used at the end of the predecessor they come from. Uses in blocks the entry doesn't reach are left out.
+static void verifyDominance(const IrModule *module, const IrFunction *function, StrBuffer *errors) {
+    IrFunction *mutableFunction = (IrFunction *)function; // irForEachOperand only reads with checkDominance.
+    IrBlock *idom = (IrBlock *)malloc(sizeof(IrBlock) * (function->blockCount + 1));
+    int *position = (int *)malloc(sizeof(int) * function->instCount);
+    irDominators(function, idom);
+    for (int b = 0; b < function->blockCount; ++b) {
+        for (int i = 0; i < function->blocks[b].count && !function->blocks[b].removed; ++i) {
+            position[function->blocks[b].insts[i]] = i;
+        }
+    }
+
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        if (block->removed || idom[b] == IR_NO_BLOCK) {
+            continue;
+        }
+
+        for (int i = 0; i < block->count; ++i) {
+            const IrValue value = block->insts[i];
+            DominanceCheck check = {idom, position, (IrBlock)b, i, true};
+            if (function->insts[value].op != IR_PHI) {
+                irForEachOperand(mutableFunction, value, checkDominance, &check);
+            } else {
+                int count;
+                IrValue *items = irList(function, function->insts[value].a, &count);
+                for (int p = 0; p < count; ++p) {
+                    check.block = block->preds[p];
+                    check.index = INT_MAX;
+                    if (idom[check.block] != IR_NO_BLOCK) {
+                        checkDominance(mutableFunction, &items[p], &check);
+                    }
+                }
+            }
+            if (!check.dominated) {
+                verifyError(module, function, errors, "operand isn't defined before this use", b, value);
+            }
+        }
+    }
+
+    free(position);
+    free(idom);
+}
+
+bool verifyIrFunction(const IrModule *module, const IrFunction *function, StrBuffer *errors) {
+    const int start = errors->len;
+    IrFunction *mutableFunction = (IrFunction *)function; // irForEachOperand only reads with checkOperand.
+
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        if (block->removed) {
+            continue;
+        }
+
+        if (irTerminator(function, (IrBlock)b) == IR_NONE) {
+            verifyError(module, function, errors, "block doesn't end in a terminator", b, IR_NONE);
+        }
+
+        bool pastPhis = false;
+        for (int i = 0; i < block->count; ++i) {
+            const IrValue value = block->insts[i];
+            const IrInst *inst = &function->insts[value];
+            if (inst->block != (IrBlock)b) {
+                verifyError(module, function, errors, "instruction is listed in another block", b, value);
+            }
+            if (isIrTerminator((IrOp)inst->op) && i != block->count - 1) {
+                verifyError(module, function, errors, "terminator before the end of the block", b, value);
+            }
+            if (inst->op == IR_PHI) {
+                int count;
+                irList(function, inst->a, &count);
+                if (pastPhis) {
+                    verifyError(module, function, errors, "phi after other instructions", b, value);
+                }
+                if (count != block->predCount) {
+                    verifyError(module, function, errors, "phi operands don't match the predecessors", b, value);
+                }
+            } else {
+                pastPhis = true;
+            }
+
+            OperandCheck check = {function, true};
+            irForEachOperand(mutableFunction, value, checkOperand, &check);
+            if (!check.valid) {
+                verifyError(module, function, errors, "operand isn't a live instruction", b, value);
+            } else {
+                verifyTypes(module, function, errors, (IrBlock)b, value);
+            }
+        }
+
+        // Every edge is in the predecessors of its target, as often as the terminator takes it.
+        IrBlock succs[2];
+        const int succCount = irSuccessors(function, (IrBlock)b, succs);
+        for (int s = 0; s < succCount; ++s) {
+            const IrBlockData *succ = &function->blocks[succs[s]];
+            bool found = false;
+            for (int p = 0; p < succ->predCount && !found; ++p) {
+                found = succ->preds[p] == (IrBlock)b;
+            }
+            if (!found || succ->removed) {
+                verifyError(module, function, errors, "edge missing from the predecessors of its target", b, IR_NONE);
+            }
+        }
+    }
+
+    // Positions and dominators only mean something once the blocks and operands are sound.
+    if (errors->len == start) {
+        verifyDominance(module, function, errors);
+    }
+    return errors->len == start;
+}
+
+static const char *opNames[] = {
+    "removed", "int", "float", "bool", "string", "null", "undef", "zero", "type", "param", "phi", "function", "extern",
+    "global", "add", "sub", "mul", "div", "mod", "add_sat", "sub_sat", "mul_sat", "shl_sat", "shl", "shr", "and", "or",
+    "xor", "eq", "ne", "lt", "le", "gt", "ge", "neg", "not", "bit_not", "convert", "len", "has_value", "unwrap",
+    "overflowed", "alloc", "new", "delete", "region", "region_new", "region_delete", "load", "store", "field",
+    "element", "call", "extract", "check_bounds", "check_overflow", "check_divisor", "check_range", "trap", "jump",
+    "branch", "return", "unreachable",
+};
+
+static const char *trapNames[] = {"bounds", "overflow", "divide_by_zero"};
+
+const char *irOpName(const IrOp op) {
+    return op < IR_OP_COUNT ? opNames[op] : "?";
+}
+
+// Four words, low to high, as a decimal number.
+static void appendInt128(StrBuffer *buf, const uint32_t *source, const bool isSigned) {
+    uint32_t words[4] = {source[0], source[1], source[2], source[3]};
+    if (isSigned && (words[3] & 0x80000000u)) {
+        str_buf_append(buf, "-");
+        // Two's complement, word by word.
+        uint64_t carry = 1;
+        for (int i = 0; i < 4; ++i) {
+            const uint64_t sum = (uint64_t)(uint32_t)~words[i] + carry;
+            words[i] = (uint32_t)sum;
+            carry = sum >> 32;
+        }
+    }
+
+    char digits[48];
+    int count = 0;
+    do {
+        uint64_t remainder = 0;
+        for (int i = 3; i >= 0; --i) {
+            const uint64_t current = remainder << 32 | words[i];
+            words[i] = (uint32_t)(current / 10);
+            remainder = current % 10;
+        }
+        digits[count++] = (char)('0' + remainder);
+    } while (words[0] | words[1] | words[2] | words[3]);
+
+    while (count > 0) {
+        str_buf_append_len(buf, &digits[--count], 1);
+    }
+}
+
+static void appendString(StrBuffer *buf, const char *text, const int len) {
+    str_buf_append(buf, "\"");
+    for (int i = 0; i < len; ++i) {
+        switch (text[i]) {
+            case '"': str_buf_append(buf, "\\\""); break;
+            case '\\': str_buf_append(buf, "\\\\"); break;
+            case '\n': str_buf_append(buf, "\\n"); break;
+            case '\t': str_buf_append(buf, "\\t"); break;
+            default: str_buf_append_len(buf, &text[i], 1); break;
+        }
+    }
+    str_buf_append(buf, "\"");
+}
+
+static void appendName(StrBuffer *buf, const Interner *interner, const Symbol namespace, const Symbol name) {
+    int len = 0;
+    const char *text;
+    if (namespace != SYMBOL_NONE) {
+        text = symbolName(interner, namespace, &len);
+        str_buf_append(buf, "%.*s::", len, text);
+    }
+    text = symbolName(interner, name, &len);
+    str_buf_append(buf, "%.*s", len, text);
+}
+
+typedef struct {
+    const IrModule *module;
+    const IrFunction *function;
+    uint32_t *numbers; // Printed number of each value, in the order they are printed.
+    StrBuffer *buf;
+} IrPrinter;
+
+static void appendValue(const IrPrinter *printer, const IrValue value) {
+    str_buf_append(printer->buf, "%%%u", printer->numbers[value]);
+}
+
+static void appendList(const IrPrinter *printer, const uint32_t list) {
+    int count;
+    const uint32_t *items = irList(printer->function, list, &count);
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) {
+            str_buf_append(printer->buf, ", ");
+        }
+        appendValue(printer, items[i]);
+    }
+}
+
+static void appendInst(const IrPrinter *printer, const IrBlock block, const IrValue value) {
+    const IrFunction *function = printer->function;
+    const IrInst *inst = &function->insts[value];
+    const Interner *interner = printer->module->config->interner;
+    StrBuffer *buf = printer->buf;
+
+    str_buf_append(buf, "    ");
+    if (hasValue((IrOp)inst->op)) {
+        appendValue(printer, value);
+        str_buf_append(buf, " = %s ", irOpName((IrOp)inst->op));
+        appendTypeName(printer->module->types, interner, inst->type, buf);
+    } else {
+        str_buf_append(buf, "%s", irOpName((IrOp)inst->op));
+    }
+
+    switch ((IrOp)inst->op) {
+        case IR_INT: {
+            const TypeId type = inst->type;
+            const bool isSigned = irIsSigned(type);
+            str_buf_append(buf, " ");
+            appendInt128(buf, function->extra + inst->a, isSigned);
+            break;
+        }
+        case IR_FLOAT: {
+            const uint64_t bits = (uint64_t)function->extra[inst->a] | (uint64_t)function->extra[inst->a + 1] << 32;
+            double number;
+            memcpy(&number, &bits, sizeof(number));
+            str_buf_append(buf, " %.17g", number);
+            break;
+        }
+        case IR_BOOL:
+            str_buf_append(buf, " %s", inst->a ? "true" : "false");
+            break;
+        case IR_STRING: {
+            int len = 0;
+            const char *text = symbolName(interner, inst->a, &len);
+            str_buf_append(buf, " ");
+            appendString(buf, text, len);
+            break;
+        }
+        case IR_TYPE:
+            str_buf_append(buf, " ");
+            appendTypeName(printer->module->types, interner, inst->a, buf);
+            break;
+        case IR_PARAM:
+            str_buf_append(buf, " %u", inst->a);
+            break;
+        case IR_PHI: {
+            const IrBlockData *data = &function->blocks[block];
+            int count;
+            const uint32_t *operands = irList(function, inst->a, &count);
+            for (int i = 0; i < count; ++i) {
+                str_buf_append(buf, i == 0 ? " [" : ", [");
+                appendValue(printer, operands[i]);
+                str_buf_append(buf, ", b%u]", i < data->predCount ? data->preds[i] : IR_NO_BLOCK);
+            }
+            break;
+        }
+        case IR_FUNCTION: {
+            const IrFunction *target = printer->module->functions[inst->a];
+            str_buf_append(buf, " @");
+            appendName(buf, interner, target->namespace, target->name);
+            break;
+        }
+        case IR_EXTERN:
+        case IR_GLOBAL:
+            str_buf_append(buf, " @");
+            appendName(buf, interner, inst->a, inst->b);
+            break;
+        case IR_FIELD: {
+            int len = 0;
+            const char *name = symbolName(interner, inst->b, &len);
+            str_buf_append(buf, " ");
+            appendValue(printer, inst->a);
+            str_buf_append(buf, ", .%.*s", len, name);
+            break;
+        }
+        case IR_NEW:
+            if (inst->a != IR_NONE) {
+                str_buf_append(buf, " ");
+                appendValue(printer, inst->a);
+            }
+            if (inst->b != IR_NONE) {
+                str_buf_append(buf, " cap ");
+                appendValue(printer, inst->b);
+            }
+            break;
+        case IR_REGION_NEW:
+            str_buf_append(buf, " ");
+            appendValue(printer, inst->a);
+            if (inst->b != IR_NONE) {
+                str_buf_append(buf, ", ");
+                appendValue(printer, inst->b);
+            }
+            break;
+        case IR_CALL:
+            str_buf_append(buf, " ");
+            appendValue(printer, inst->a);
+            str_buf_append(buf, "(");
+            appendList(printer, inst->b);
+            str_buf_append(buf, ")");
+            break;
+        case IR_EXTRACT:
+            str_buf_append(buf, " ");
+            appendValue(printer, inst->a);
+            str_buf_append(buf, ", %u", inst->b);
+            break;
+        case IR_CHECK_RANGE:
+            str_buf_append(buf, " ");
+            appendValue(printer, function->extra[inst->b]);
+            str_buf_append(buf, " ..< ");
+            appendValue(printer, inst->a);
+            str_buf_append(buf, ", ");
+            appendValue(printer, function->extra[inst->b + 1]);
+            break;
+        case IR_TRAP:
+            str_buf_append(buf, " %s ", trapNames[inst->a]);
+            appendList(printer, inst->b);
+            break;
+        case IR_JUMP:
+            str_buf_append(buf, " b%u", inst->a);
+            break;
+        case IR_BRANCH:
+            str_buf_append(buf, " ");
+            appendValue(printer, inst->a);
+            str_buf_append(buf, ", b%u, b%u", function->extra[inst->b], function->extra[inst->b + 1]);
+            break;
+        case IR_RETURN:
+            if (inst->a != 0) {
+                str_buf_append(buf, " ");
+                appendList(printer, inst->a);
+            }
+            break;
+        case IR_STORE:
+        case IR_ELEMENT:
+        case IR_CHECK_BOUNDS:
+        case IR_REGION_DELETE:
+            str_buf_append(buf, " ");
+            appendValue(printer, inst->a);
+            str_buf_append(buf, ", ");
+            appendValue(printer, inst->b);
+            break;
+        default:
+            if (inst->op >= IR_ADD && inst->op <= IR_GE) {
+                str_buf_append(buf, " ");
+                appendValue(printer, inst->a);
+                str_buf_append(buf, ", ");
+                appendValue(printer, inst->b);
+            } else if (inst->op >= IR_NEG && inst->op <= IR_OVERFLOWED) {
+                str_buf_append(buf, " ");
+                appendValue(printer, inst->a);
+            } else if (inst->op == IR_DELETE || inst->op == IR_LOAD || inst->op == IR_CHECK_OVERFLOW ||
+                       inst->op == IR_CHECK_DIVISOR) {
+                str_buf_append(buf, " ");
+                appendValue(printer, inst->a);
+            }
+            break;
+    }
+    str_buf_append(buf, "\n");
+}
+
+void appendIrFunction(const IrModule *module, const IrFunction *function, StrBuffer *buf) {
+    const Interner *interner = module->config->interner;
+    IrPrinter printer = {module, function, (uint32_t *)calloc(function->instCount + 1, sizeof(uint32_t)), buf};
+
+    // Values are numbered in the order they are printed, parameters first.
+    uint32_t next = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            if (hasValue((IrOp)function->insts[block->insts[i]].op)) {
+                printer.numbers[block->insts[i]] = next++;
+            }
+        }
+    }
+
+    str_buf_append(buf, "fn ");
+    appendName(buf, interner, function->namespace, function->name);
+    str_buf_append(buf, "(");
+    int params = 0;
+    const IrBlockData *entry = &function->blocks[0];
+    for (int i = 0; i < entry->count; ++i) {
+        const IrInst *inst = &function->insts[entry->insts[i]];
+        if (inst->op == IR_PARAM) {
+            str_buf_append(buf, params++ > 0 ? ", " : "");
+            appendValue(&printer, entry->insts[i]);
+            str_buf_append(buf, " ");
+            appendTypeName(module->types, interner, inst->type, buf);
+        }
+    }
+    str_buf_append(buf, ")");
+
+    if (function->type != TYPE_ID_NONE) {
+        const Type *type = typeOf(module->types, function->type);
+        for (uint32_t i = type->a; i < type->count; ++i) {
+            str_buf_append(buf, i == type->a ? ": " : ", ");
+            appendTypeName(module->types, interner, type->items[i], buf);
+        }
+    }
+    str_buf_append(buf, " {\n");
+
+    static const char *kindNames[] = {"", "loop", "defer", "cold"};
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        if (block->removed) {
+            continue;
+        }
+
+        str_buf_append(buf, "b%d", b);
+        if (block->kind != BLOCK_PLAIN) {
+            str_buf_append(buf, " (%s%s%s)", kindNames[block->kind], block->hints & LOOP_COUNTED ? ", counted" : "",
+                           block->hints & LOOP_INDEPENDENT ? ", independent" : "");
+        }
+        str_buf_append(buf, ":");
+        for (int p = 0; p < block->predCount; ++p) {
+            str_buf_append(buf, p == 0 ? "  ; from b%u" : ", b%u", block->preds[p]);
+        }
+        str_buf_append(buf, "\n");
+
+        for (int i = 0; i < block->count; ++i) {
+            if (function->insts[block->insts[i]].op != IR_PARAM) {
+                appendInst(&printer, (IrBlock)b, block->insts[i]);
+            }
+        }
+    }
+    str_buf_append(buf, "}\n");
+
+    free(printer.numbers);
+}
+
+void printIrModule(const IrModule *module) {
+    StrBuffer buf;
+    str_buf_init(&buf);
+    for (int i = 0; i < module->functionCount; ++i) {
+        if (i > 0) {
+            str_buf_append(&buf, "\n");
+        }
+        appendIrFunction(module, module->functions[i], &buf);
+    }
+
+    if (buf.len > 0) {
+        fwrite(buf.data, 1, buf.len, stdout);
+    }
+    str_buf_free(&buf);
+}
+
+void addIrRemark(IrModule *module, const char *pass, const int function, const uint32_t offset, const char *text,
+                 ...) {
+    // --vectorize-report alone keeps only what the loops pass says.
+    if (!module->config->remarks && !(module->config->vectorizeReport && strcmp(pass, "loops") == 0)) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, text);
+    va_list copy;
+    va_copy(copy, args);
+    const int len = vsnprintf(nullptr, 0, text, copy);
+    va_end(copy);
+    char *formatted = (char *)malloc(len + 1);
+    vsnprintf(formatted, len + 1, text, args);
+    va_end(args);
+
+    mutex_lock(&module->remarkLock);
+    if (module->remarkCount == module->remarkCapacity) {
+        module->remarks = (IrRemark *)array_grow(module->remarks, &module->remarkCapacity, sizeof(IrRemark));
+    }
+    module->remarks[module->remarkCount++] = (IrRemark){pass, function, offset, formatted};
+    mutex_unlock(&module->remarkLock);
+}
+
+static int compareRemarks(const void *x, const void *y) {
+    const IrRemark *a = (const IrRemark *)x;
+    const IrRemark *b = (const IrRemark *)y;
+    if (a->function != b->function) {
+        return a->function < b->function ? -1 : 1;
+    }
+    if (a->offset != b->offset) {
+        return a->offset < b->offset ? -1 : 1;
+    }
+    return strcmp(a->text, b->text);
+}
+
+void printIrRemarks(const IrModule *module, const char *pass) {
+    if (module->remarkCount == 0) {
+        return;
+    }
+
+    IrRemark *sorted = (IrRemark *)malloc(sizeof(IrRemark) * (module->remarkCount + 1));
+    memcpy(sorted, module->remarks, sizeof(IrRemark) * module->remarkCount);
+    qsort(sorted, module->remarkCount, sizeof(IrRemark), compareRemarks);
+
+    // Functions of a file are next to each other, so each file is opened once for its lines.
+    StrBuffer buf;
+    str_buf_init(&buf);
+    const ParseResults *file = nullptr;
+    Lexer *lexer = nullptr;
+    for (int i = 0; i < module->remarkCount; ++i) {
+        const IrRemark *remark = &sorted[i];
+        if (pass != nullptr && strcmp(remark->pass, pass) != 0) {
+            continue;
+        }
+        const ParseResults *results = module->functions[remark->function]->file;
+        if (results != file) {
+            if (lexer != nullptr) {
+                freeLexer(lexer);
+            }
+            file = results;
+            lexer = initLexer(results->file);
+        }
+
+        const SourceLocation at = lexer != nullptr ? lexerLocation(lexer, remark->offset) : (SourceLocation){0, 0};
+        str_buf_append(&buf, "%s:L%d,C%d: %s: %s\n", results->file, at.line, at.column, remark->pass, remark->text);
+    }
+    if (lexer != nullptr) {
+        freeLexer(lexer);
+    }
+    free(sorted);
+
+    if (buf.len > 0) {
+        fwrite(buf.data, 1, buf.len, stdout);
+    }
+    str_buf_free(&buf);
+}
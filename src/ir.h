@@ -0,0 +1,364 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_IR_H
+#define NIFTY_IR_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "program.h"
+#include "types.h"
+#include "util/str.h"
+#include "util/thread.h"
+
+// Typed SSA form of a program's functions, between the checked trees and code generation, so optimizations are
+// written once whatever the backend. A function is a list of basic blocks of instructions, and every instruction that
+// gives a value is that value: operands name the instructions that made them, each made exactly once. Where control
+// flow joins, phi instructions at the top of the block pick the value of the edge that was taken.
+//
+// Instructions live in one array per function and are addressed by index, like the nodes of an Ast, with anything
+// that doesn't fit in their two operand fields in the function's extra array. Blocks list their instructions in order,
+// phis first and a terminator last, and know their predecessors; successors are read off the terminator.
+//
+// What the language checks at run time is explicit: indexing is preceded by a bounds check of the index against the
+// length, plain integer arithmetic is followed by an overflow check of its result, and deferred statements are copied
+// into defer blocks on every edge that leaves their scope. Passes can then remove, move or lower them like anything else.
+
+typedef uint32_t IrValue;
+typedef uint32_t IrBlock;
+
+// Instruction 0 is never used, operands that are missing are IR_NONE.
+#define IR_NONE 0
+
+// Block of removed instructions, and the target of nothing.
+#define IR_NO_BLOCK UINT32_MAX
+
+// "list" is an extra index of a list, its length followed by its items, as in an Ast.
+typedef enum {
+    IR_REMOVED,       // Left behind by a removed instruction. a: the value that replaced it, or IR_NONE.
+
+    // Constants and other values.
+    IR_INT,           // a: extra [four words of the value, low to high], sign or zero extended from its type.
+    IR_FLOAT,         // a: extra [two words of the double, low first].
+    IR_BOOL,          // a: 0 or 1.
+    IR_STRING,        // a: Symbol of the text.
+    IR_NULL,
+    IR_UNDEF,         // Any value, for undefined and variables read before they are written.
+    IR_ZERO,          // The zero value of the type, for variables declared without one.
+    IR_TYPE,          // a: TypeId, for types passed as arguments like size_of(T).
+    IR_PARAM,         // a: index of the argument.
+    IR_PHI,           // a: list of values, one per predecessor of the block in the same order.
+    IR_FUNCTION,      // a: index of the function in the module.
+    IR_EXTERN,        // a: namespace, b: name. A function without a body in the module, or a builtin.
+    IR_GLOBAL,        // a: namespace, b: name. Address of a global variable.
+
+    // Arithmetic, a: left, b: right. Plain + - * wrap like %+ %- %* and are followed by IR_CHECK_OVERFLOW, and so are
+    // / and % of signed integers, for MIN / -1. Their divisor is checked by IR_CHECK_DIVISOR before them.
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,           // Rounds toward zero, MIN / -1 wraps to MIN.
+    IR_MOD,           // Has the sign of left, MIN % -1 is 0.
+    IR_ADD_SAT,
+    IR_SUB_SAT,
+    IR_MUL_SAT,
+    IR_SHL_SAT,
+    IR_SHL,
+    IR_SHR,
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+    IR_EQ,
+    IR_NE,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+
+    // Unary, a: operand.
+    IR_NEG,           // Wraps, -MIN is MIN. Plain - of an integer is followed by IR_CHECK_OVERFLOW.
+    IR_NOT,
+    IR_BIT_NOT,
+    IR_CONVERT,       // To the instruction's type, cast(x, T).
+    IR_LEN,           // Length of a slice, array or string.
+    IR_HAS_VALUE,     // Whether an optional isn't null.
+    IR_UNWRAP,        // Value of an optional that isn't null.
+    IR_OVERFLOWED,    // a: what IR_CHECK_OVERFLOW takes. Whether it didn't fit its type, the flag
+                      // __builtin_add_overflow and the others give with the result. What IR_CHECK_OVERFLOW lowers to.
+
+    // Memory. Addresses are pointers to the type they hold.
+    IR_ALLOC,         // A stack slot for a value of the type the instruction points to, for the whole call.
+    IR_NEW,           // a: initial value or IR_NONE, b: capacity of a dynamic array or IR_NONE. A heap allocation.
+    IR_DELETE,        // a: pointer.
+    IR_REGION,        // A bump allocator for the call, what is left in it is freed when the function returns.
+    IR_REGION_NEW,    // a: region, b: initial value or IR_NONE. IR_NEW from the region.
+    IR_REGION_DELETE, // a: region, b: pointer. Frees it if it was the region's last allocation, else at the return.
+    IR_LOAD,          // a: address.
+    IR_STORE,         // a: address, b: value.
+    IR_FIELD,         // a: address of a struct, b: name of the field. Address of the field.
+    IR_ELEMENT,       // a: array address, slice or many pointer, b: index. Address of the element.
+
+    IR_CALL,          // a: callee, b: list of arguments. The value is the only return value, see IR_EXTRACT for more.
+    IR_EXTRACT,       // a: call, b: index of the return value.
+
+    // Checks, trapping when they fail.
+    IR_CHECK_BOUNDS,   // a: index, b: length. index < length, unsigned.
+    IR_CHECK_OVERFLOW, // a: IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD or IR_NEG. The result fits its type.
+    IR_CHECK_DIVISOR,  // a: divisor of the IR_DIV or IR_MOD after it. It isn't 0.
+    IR_CHECK_RANGE,    // a: end, b: extra [start, length]. start >= end or end <= length, the bounds checks of a
+                       // loop over start ..< end hoisted before it.
+    IR_TRAP,           // a: IrTrap, b: list [offset of the check, then the values it failed on]. Ends the program.
+
+    // Terminators, last in every block.
+    IR_JUMP,          // a: block.
+    IR_BRANCH,        // a: condition, b: extra [then block, else block].
+    IR_RETURN,        // a: list of values.
+    IR_UNREACHABLE,
+
+    IR_OP_COUNT
+} IrOp;
+
+// What an IR_TRAP reports.
+typedef enum {
+    TRAP_BOUNDS,         // [index, length], as u64.
+    TRAP_OVERFLOW,       // [], + - * / % or unary - that didn't fit its type.
+    TRAP_DIVIDE_BY_ZERO, // [], / or % by 0.
+    TRAP_COUNT
+} IrTrap;
+
+// How a function or a call asked to be inlined, see the inline pass.
+typedef enum {
+    INLINE_MAYBE,  // Up to the inliner's cost model, without an attribute.
+    INLINE_ALWAYS, // #[inline]
+    INLINE_NEVER,  // #[noInline]
+} IrInlining;
+
+typedef struct {
+    uint8_t op; // IrOp.
+    uint8_t flags; // Free for passes to mark instructions with.
+    uint8_t inlining; // IrInlining of calls, INLINE_ALWAYS for #[inline] f().
+    TypeId type; // TYPE_ID_NONE for instructions without a value, or values of a type that isn't known.
+    IrBlock block; // IR_NO_BLOCK once removed.
+    uint32_t a;
+    uint32_t b;
+    uint32_t offset; // In the source of the function's file.
+} IrInst;
+
+typedef enum {
+    BLOCK_PLAIN,
+    BLOCK_LOOP,  // The header of a loop, its condition. The back edge is its last predecessor.
+    BLOCK_DEFER, // Deferred statements run on one way out of their scope.
+    BLOCK_COLD,  // Only reached when something went wrong, like a failed check, and kept away from the rest.
+} IrBlockKind;
+
+// What the loops pass found out about a loop, on its header, for a backend to pass on like #pragma GCC ivdep.
+typedef enum {
+    LOOP_COUNTED = 1 << 0,     // Runs a known number of times once it starts: a counter stepping by a constant up or
+                               // down to a value from before the loop, which it only leaves through.
+    LOOP_INDEPENDENT = 1 << 1, // Nothing an iteration does depends on an earlier one, but for reductions like sums.
+} IrLoopHints;
+
+typedef struct {
+    IrValue *insts;
+    int count;
+    int capacity;
+
+    IrBlock *preds;
+    int predCount;
+    int predCapacity;
+
+    IrBlockKind kind;
+    uint8_t hints; // IrLoopHints of loop headers.
+    bool removed;
+} IrBlockData;
+
+typedef struct {
+    const Declaration *declaration;
+    Symbol namespace; // The type of methods.
+    Symbol name;
+    ParseResults *file;
+    TypeId type; // FORM_FUNCTION, with the receiver of methods first.
+    int paramCount;
+    IrInlining inlining;
+    // Bit i for parameter i if nothing else the function reaches aliases what it points to: restrict as the caller's
+    // promise, and strings, which are never written. #[in] and #[out] aren't, f(x, x) is a legal call of either.
+    uint32_t restrictParams;
+
+    IrInst *insts;
+    int instCount;
+    int instCapacity;
+
+    uint32_t *extra;
+    int extraCount;
+    int extraCapacity;
+
+    IrBlockData *blocks; // The entry block first.
+    int blockCount;
+    int blockCapacity;
+} IrFunction;
+
+// Something a pass did or didn't do that --remarks lists, like a call it inlined.
+typedef struct {
+    const char *pass;
+    int function; // Index in the module of the function the remark is about.
+    uint32_t offset; // In the source of the function's file.
+    char *text;
+} IrRemark;
+
+typedef struct {
+    Program *program;
+    CompilerConfig *config;
+    TypeTable *types;
+
+    // In program order: files in order, and declarations in file order.
+    IrFunction **functions;
+    int functionCount;
+    int functionCapacity;
+
+    // Index of each function by its declaration, open addressing on the pointer.
+    const Declaration **functionKeys;
+    int *functionIndices;
+    uint32_t functionMask;
+
+    // Only kept with the config's remarks. Function passes add theirs from many threads at once.
+    IrRemark *remarks;
+    int remarkCount;
+    int remarkCapacity;
+    Mutex remarkLock;
+} IrModule;
+
+IrModule *initIrModule(Program *program, CompilerConfig *config);
+void freeIrModule(IrModule *module);
+
+// Adds a function for declaration, which must not have one yet.
+IrFunction *addIrFunction(IrModule *module, const Declaration *declaration);
+// Index of the function of declaration, -1 if the module has none.
+int irFunctionIndex(const IrModule *module, const Declaration *declaration);
+// The function's name in buf, with its namespace. Returns buf.
+const char *irFunctionName(const IrModule *module, const IrFunction *function, char *buf, size_t size);
+
+IrBlock addIrBlock(IrFunction *function, IrBlockKind kind);
+void addIrEdge(IrFunction *function, IrBlock from, IrBlock to);
+// Removes the edge, and the operand of each phi of to for it.
+void removeIrEdge(IrFunction *function, IrBlock from, IrBlock to);
+
+// Appends an instruction to block.
+IrValue addIrInst(IrFunction *function, IrBlock block, IrOp op, TypeId type, uint32_t a, uint32_t b, uint32_t offset);
+// Adds an instruction to block before its index-th instruction.
+IrValue insertIrInst(IrFunction *function, IrBlock block, int index, IrOp op, TypeId type, uint32_t a, uint32_t b,
+                     uint32_t offset);
+// Takes value out of its block and puts it in block before its index-th instruction, counted without it.
+void moveIrInst(IrFunction *function, IrValue value, IrBlock block, int index);
+// Takes value out of its block, operands naming it are rewritten to replacement by compactIrFunction.
+void removeIrInst(IrFunction *function, IrValue value, IrValue replacement);
+// Points every operand at what replaced the values it named and drops removed instructions from their blocks.
+void compactIrFunction(IrFunction *function);
+
+uint32_t addIrExtra(IrFunction *function, const uint32_t *words, int count);
+uint32_t addIrList(IrFunction *function, const IrValue *items, int count);
+IrValue addIrInt(IrFunction *function, IrBlock block, TypeId type, int64_t value, uint32_t offset);
+// An IR_INT, IR_FLOAT or IR_BOOL of constant and its type, added to block before its index-th instruction.
+IrValue insertIrConstant(IrFunction *function, IrBlock block, int index, const Constant *constant, uint32_t offset);
+// Whether value is an IR_INT, IR_FLOAT or IR_BOOL of a builtin type, and the constant it is if so. An IR_INT whose
+// words don't fit its type isn't one.
+bool irConstant(const IrFunction *function, IrValue value, Constant *constant);
+
+// Items of the list at index, only valid until extra grows.
+static inline uint32_t *irList(const IrFunction *function, const uint32_t index, int *count) {
+    *count = (int)function->extra[index];
+    return function->extra + index + 1;
+}
+
+static inline IrInst *irInst(const IrFunction *function, const IrValue value) {
+    return &function->insts[value];
+}
+
+static inline bool isIrTerminator(const IrOp op) {
+    return op >= IR_JUMP && op <= IR_UNREACHABLE;
+}
+
+// Whether removing the instruction when nothing uses its value changes what the function does.
+bool irHasEffects(IrOp op);
+// Whether the op's value must have a type. Functions, calls and their results can be of a type that isn't known, like
+// those of the nsl and builtins, and regions have none.
+bool irNeedsType(IrOp op);
+// Whether type is an integer, the types arithmetic is checked for overflow in.
+bool irIsInteger(TypeId type);
+// Whether type is a signed integer, the ones / and % can overflow in.
+bool irIsSigned(TypeId type);
+
+// The last instruction of block if it is a terminator, else IR_NONE.
+IrValue irTerminator(const IrFunction *function, IrBlock block);
+// Fills succs with the blocks the terminator of block goes to, returns how many.
+int irSuccessors(const IrFunction *function, IrBlock block, IrBlock succs[2]);
+// Moves the instructions of block from index on to a new block, with the edges out of it. Returns the new block.
+IrBlock splitIrBlock(IrFunction *function, IrBlock block, int index);
+
+// Fills order with the blocks the entry block reaches, each after the blocks it goes to but for back edges. Returns
+// how many.
+int irPostorder(const IrFunction *function, IrBlock *order);
+// Marks the blocks of the loop of header in inLoop: it and the blocks that reach its back edge without going through
+// it. Returns how many.
+int irLoopBlocks(const IrFunction *function, IrBlock header, bool *inLoop);
+// Fills idom with the immediate dominator of each block. The entry block is its own, and blocks the entry doesn't
+// reach have IR_NO_BLOCK.
+void irDominators(const IrFunction *function, IrBlock *idom);
+// Whether every path from the entry to b goes through a, with idom from irDominators.
+bool irDominates(const IrBlock *idom, IrBlock a, IrBlock b);
+
+// Calls visit with the address of every operand of value that names an instruction.
+typedef void (*IrOperandFn)(IrFunction *function, IrValue *operand, void *context);
+void irForEachOperand(IrFunction *function, IrValue value, IrOperandFn visit, void *context);
+
+// Calls between the module's functions, as they are when the graph is made.
+typedef struct {
+    int *starts; // The functions f calls are callees[starts[f]] up to callees[starts[f + 1]], once per call.
+    int *callees;
+    int *order; // Every function, callees before their callers except within a cycle of calls.
+    int *components; // Of each function, the same for functions in one cycle of calls and only for them.
+} IrCallGraph;
+
+void initIrCallGraph(IrCallGraph *graph, const IrModule *module);
+void freeIrCallGraph(IrCallGraph *graph);
+// Index in the module of the function the IR_CALL call calls, -1 if it isn't one of the module's.
+int irCalledFunction(const IrFunction *function, IrValue call);
+
+// Replaces phis whose operands are all one value, or the phi itself, with that value. Returns whether any was.
+bool removeTrivialPhis(IrFunction *function);
+
+// Whether the function is well formed, appends what is wrong with it to errors if it isn't: its blocks and edges, the
+// types of operands and values where they are known, and every value defined before its uses.
+bool verifyIrFunction(const IrModule *module, const IrFunction *function, StrBuffer *errors);
+
+void appendIrFunction(const IrModule *module, const IrFunction *function, StrBuffer *buf);
+// Every function, in one write to stdout.
+void printIrModule(const IrModule *module);
+
+// Adds a remark about function if the config keeps them, text is printf formatted.
+void addIrRemark(IrModule *module, const char *pass, int function, uint32_t offset, const char *text, ...);
+// Every remark of pass, or of every pass for nullptr, by function and then offset, as file:line,column: pass: text.
+void printIrRemarks(const IrModule *module, const char *pass);
+
+const char *irOpName(IrOp op);
+
+#endif //NIFTY_IR_H
@@ -23,14 +23,62 @@
 #include "lexer.h"
 
 #include <stdlib.h>
+#include <math.h>
+#include <string.h>
 
+#include "gen/keywords.h"
+#include "gen/powers.h"
+#include "util/scan.h"
 #include "util/str.h"
 
-static char *stringFromFile(const char *filename) {
+#ifndef N_WIN
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+static char *readStream(FILE *file, size_t *length) {
+    size_t capacity = 64 * 1024;
+    size_t size = 0;
+    char *ret = (char *)malloc(capacity + NIFTY_SOURCE_PADDING);
+    if (ret == nullptr) {
+        println("Out of memory.");
+        return nullptr;
+    }
+
+    for (;;) {
+        size += fread(ret + size, sizeof(char), capacity - size, file);
+        if (size < capacity) {
+            break;
+        }
+
+        capacity *= 2;
+        char *grown = (char *)realloc(ret, capacity + NIFTY_SOURCE_PADDING);
+        if (grown == nullptr) {
+            println("Out of memory.");
+            free(ret);
+            return nullptr;
+        }
+        ret = grown;
+    }
+
+    memset(ret + size, 0, NIFTY_SOURCE_PADDING);
+    *length = size;
+
+    return ret;
+}
+
+// '\r' is left in the buffer, the lexer treats "\r\n" as a newline.
+static char *stringFromFile(const char *filename, size_t *length) {
     if (filename == nullptr) {
         return nullptr;
     }
 
+    if (str_eq(filename, "-")) {
+        return readStream(stdin, length);
+    }
+
 #ifndef N_WIN
     FILE *file = fopen(filename, "r");
     if (file == nullptr) {
@@ -47,57 +95,157 @@ static char *stringFromFile(const char *filename) {
 #endif
 
     fseek(file, 0, SEEK_END);
-    const long length = ftell(file);
+    const long size = ftell(file);
     fseek(file, 0, SEEK_SET);
 
-    char *ret = (char *)malloc(length + 1);
+    if (size < 0) {
+        // Not seekable, a pipe or a device.
+        char *ret = readStream(file, length);
+        fclose(file);
+        return ret;
+    }
+
+    char *ret = (char *)malloc(size + NIFTY_SOURCE_PADDING);
     if (ret == nullptr) {
         println("Out of memory.");
+        fclose(file);
         return nullptr;
     }
 
-    fread(ret, sizeof(char), length, file);
-    ret[length] = '\0';
-    
-    // Filter out '\r'
-    size_t offset = 0;
-    for (size_t i = 0; i < length - offset; ++i) {
-        const char c = ret[i + offset];
-        if (c == '\r') {
-            ++offset;
-            --i;
-            continue;
-        }
-
-        if (offset) {
-            ret[i] = c;
-        }
-    }
-    
-    ret[length - offset] = '\0';
+    *length = fread(ret, sizeof(char), size, file);
+    memset(ret + *length, 0, NIFTY_SOURCE_PADDING);
     fclose(file);
 
     return ret;
 }
 
+#ifndef N_WIN
+// Maps a regular file read only. The mapping is placed over zero filled anonymous pages so the source is followed by
+// NIFTY_SOURCE_PADDING zero bytes even when the file ends exactly on a page boundary. Returns nullptr if the file can't be mapped, the
+// caller then falls back to reading it.
+static const char *mapFile(const char *filename, size_t *length, size_t *mappedSize) {
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+
+    const size_t size = (size_t)st.st_size;
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t reserved = (size + NIFTY_SOURCE_PADDING + page - 1) / page * page;
+
+    char *base = (char *)mmap(nullptr, reserved, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    if (size > 0 && mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, reserved);
+        close(fd);
+        return nullptr;
+    }
+
+    close(fd);
+
+    *length = size;
+    *mappedSize = reserved;
+    return base;
+}
+#endif
+
 Lexer *initLexer(const char *filename) {
-    Lexer *lexer = (Lexer*)malloc(sizeof(Lexer));
-    
-    lexer->source = stringFromFile(filename);
+    return initLexerWithMode(filename, SOURCE_LOAD_AUTO);
+}
+
+static void resetLexer(Lexer *lexer) {
     lexer->start = lexer->source;
     lexer->current = lexer->start;
     lexer->prev = '\0';
-    lexer->line = 1;
-    lexer->linePos = 0;
+    lexer->interner = nullptr;
+    lexer->symbols = nullptr;
+    lexer->lineStarts = nullptr;
+    lexer->lineCount = 0;
+}
+
+Lexer *initLexerWithMode(const char *filename, const SourceLoadMode mode) {
+    Lexer *lexer = (Lexer*)malloc(sizeof(Lexer));
+
+    lexer->source = nullptr;
+    lexer->length = 0;
+    lexer->mappedSize = 0;
+#ifndef N_WIN
+    if (mode == SOURCE_LOAD_AUTO && filename != nullptr && !str_eq(filename, "-")) {
+        lexer->source = mapFile(filename, &lexer->length, &lexer->mappedSize);
+    }
+#endif
+    if (lexer->source == nullptr) {
+        lexer->source = stringFromFile(filename, &lexer->length);
+    }
+
+    if (lexer->source == nullptr) {
+        free(lexer);
+        return nullptr;
+    }
+
+    resetLexer(lexer);
+
+    return lexer;
+}
+
+Lexer *initLexerFromMemory(const char *source, const size_t length) {
+    char *copy = (char *)malloc(length + NIFTY_SOURCE_PADDING);
+    if (copy == nullptr) {
+        println("Out of memory.");
+        return nullptr;
+    }
+
+    memcpy(copy, source, length);
+    memset(copy + length, 0, NIFTY_SOURCE_PADDING);
+
+    Lexer *lexer = (Lexer*)malloc(sizeof(Lexer));
+    lexer->source = copy;
+    lexer->length = length;
+    lexer->mappedSize = 0;
+    resetLexer(lexer);
 
     return lexer;
 }
 
 void freeLexer(Lexer *lexer) {
-    free(lexer->source);
+    if (lexer == nullptr) {
+        return;
+    }
+
+    free(lexer->lineStarts);
+    free(lexer->symbols);
+
+#ifndef N_WIN
+    if (lexer->mappedSize > 0) {
+        munmap((void *)lexer->source, lexer->mappedSize);
+        free(lexer);
+        return;
+    }
+#endif
+
+    free((void *)lexer->source);
     free(lexer);
 }
 
+void lexerIntern(Lexer *lexer, Interner *interner) {
+    lexer->interner = interner;
+    if (lexer->symbols == nullptr) {
+        lexer->symbols = (InternCache *)calloc(1, sizeof(InternCache));
+    } else {
+        memset(lexer->symbols, 0, sizeof(InternCache));
+    }
+}
+
 static inline bool atEnd(const Lexer *lexer) {
     return *lexer->current == '\0';
 }
@@ -105,10 +253,10 @@ static inline bool atEnd(const Lexer *lexer) {
 static Token makeToken(const Lexer *lexer, const NiftyTokenType type) {
     Token token;
     token.type = type;
+    token.symbol = SYMBOL_NONE;
     token.lexeme = lexer->start;
     token.len = (int)(lexer->current - lexer->start);
-    token.line = lexer->line;
-    token.pos = lexer->linePos - token.len + 1;
+    token.offset = (uint32_t)(lexer->start - lexer->source);
 
     return token;
 }
@@ -116,10 +264,10 @@ static Token makeToken(const Lexer *lexer, const NiftyTokenType type) {
 static Token errorToken(const Lexer *lexer, const char *msg) {
     Token token;
     token.type = TK_INTERNAL_ERROR;
+    token.symbol = SYMBOL_NONE;
     token.lexeme = msg;
     token.len = (int)str_len(msg);
-    token.line = lexer->line;
-    token.pos = lexer->linePos - token.len + 1;
+    token.offset = (uint32_t)(lexer->start - lexer->source);
 
     return token;
 }
@@ -127,7 +275,6 @@ static Token errorToken(const Lexer *lexer, const char *msg) {
 static char advance(Lexer *lexer) {
     lexer->prev = *lexer->current;
     lexer->current++;
-    ++lexer->linePos;
     return lexer->current[-1];
 }
 
@@ -143,42 +290,49 @@ inline static char peekNext(const Lexer *lexer) {
     return lexer->current[1];
 }
 
+// Moves to p after a vectorized scan.
+static void skipTo(Lexer *lexer, const char *p) {
+    if (p == lexer->current) {
+        return;
+    }
+
+    lexer->prev = p[-1];
+    lexer->current = p;
+}
+
 static void skipWhitespace(Lexer *lexer) {
     for (;;) {
         const char c = peek(lexer);
         switch (c) {
-            case ' ':
             case '\r':
-            case '\t':
-                advance(lexer);
-                break;
             case '\n':
-                ++lexer->line;
                 advance(lexer);
-                lexer->linePos = 0;
+                break;
+            case ' ':
+            case '\t':
+                skipTo(lexer, scan_blanks(lexer->current));
                 break;
             case '/':
                 if (peekNext(lexer) == '/') {
-                    while (peek(lexer) != '\n' && !atEnd(lexer)) {
-                        advance(lexer);
-                    }
+                    skipTo(lexer, scan_line_end(lexer->current));
                 } else if (peekNext(lexer) == '-' || peekNext(lexer) == '*') {
                     int level = 0;
                     advance(lexer);
                     while (!atEnd(lexer) && (level >= 1 || !((peek(lexer) == '-' || peek(lexer) == '*') && peekNext(lexer) == '/'))) {
-                        if (peek(lexer) == '\n') {
-                            lexer->line++;
-                        } else if (peek(lexer) == '/' && (peekNext(lexer) == '-' || peekNext(lexer) == '*')) {
+                        if (peek(lexer) == '/' && (peekNext(lexer) == '-' || peekNext(lexer) == '*')) {
                             ++level;
                         } else if ((peek(lexer) == '-' || peek(lexer) == '*') && peekNext(lexer) == '/') {
                             --level;
                         }
 
                         advance(lexer);
+                        skipTo(lexer, scan_comment_body(lexer->current));
                     }
 
-                    advance(lexer); // - or *
-                    advance(lexer); // /
+                    if (!atEnd(lexer)) {
+                        advance(lexer); // - or *
+                        advance(lexer); // /
+                    }
                 } else {
                     return;
                 }
@@ -189,23 +343,6 @@ static void skipWhitespace(Lexer *lexer) {
     }
 }
 
-static NiftyTokenType checkKeyword(const Lexer *lexer, const int start, const int len, const char *rest, const NiftyTokenType type) {
-    if (lexer->current - lexer->start == start + len && str_eq_len(lexer->start + start, rest, len)) {
-        return type;
-    }
-
-    return TK_IDENT;
-}
-
-static NiftyTokenType checkKeyword2(const Lexer *lexer, const int start, const int len, const char *rest, const NiftyTokenType type, const int len2, const char *rest2, const NiftyTokenType type2) {
-    const NiftyTokenType tokenType = checkKeyword(lexer, start, len, rest, type);
-    if (tokenType == TK_IDENT) {
-        return checkKeyword(lexer, start, len2, rest2, type2);
-    }
-
-    return tokenType;
-}
-
 static bool match(Lexer *lexer, const char expected) {
     if (atEnd(lexer)) {
         return false;
@@ -219,376 +356,351 @@ static bool match(Lexer *lexer, const char expected) {
     return true;
 }
 
-static NiftyTokenType checkUInts(const Lexer *lexer) {
-    if (str_eq_len(lexer->start + 1, "32", 2)) {
-        return TK_U32;
-    }
-    if (str_eq_len(lexer->start + 1, "8", 1)) {
-        return TK_U8;
-    }
-    if (str_eq_len(lexer->start + 1, "int", 3)) {
-        return TK_UINT;
-    }
-    if (str_eq_len(lexer->start + 1, "64", 2)) {
-        return TK_U64;
+NiftyTokenType keywordType(const char *start, const int len) {
+    if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN) {
+        return TK_IDENT;
     }
-    if (str_eq_len(lexer->start + 1, "16", 2)) {
-        return TK_U16;
-    }
-    if (str_eq_len(lexer->start + 1, "intptr", 6)) {
-        return TK_UINTPTR;
-    }
-    if (str_eq_len(lexer->start + 1, "128", 3)) {
-        return TK_U128;
+
+    const uint32_t fingerprint = keywordFingerprint(start, len);
+    const uint32_t bucket = keywordHash(fingerprint, 0) % KEYWORD_BUCKETS;
+    const uint32_t slot = keywordHash(fingerprint, keywordDisplacements[bucket]) % KEYWORD_COUNT;
+    if (keywordTable[slot].len != len || memcmp(keywordTable[slot].text, start, len) != 0) {
+        return TK_IDENT;
     }
 
-    return TK_IDENT;
+    return (NiftyTokenType)keywordTable[slot].type;
 }
 
-static NiftyTokenType checkSInts(const Lexer *lexer) {
-    if (str_eq_len(lexer->start + 1, "32", 2)) {
-        return TK_S32;
-    }
-    if (str_eq_len(lexer->start + 1, "64", 2)) {
-        return TK_S64;
+static Token stringLit(Lexer *lexer, const char strChar) {
+    //TODO: Raw strings.
+
+    for (;;) {
+        skipTo(lexer, scan_string_body(lexer->current, strChar));
+
+        if (peek(lexer) != '\\') {
+            break;
+        }
+
+        // Escapes always take the next character so "\\" doesn't escape the closing quote.
+        advance(lexer);
+        if (!atEnd(lexer)) {
+            advance(lexer);
+        }
     }
-    if (str_eq_len(lexer->start + 1, "8", 1)) {
-        return TK_S8;
+
+    if (atEnd(lexer)) {
+        return errorToken(lexer, "Unterminated string.");
     }
-    if (str_eq_len(lexer->start + 1, "16", 2)) {
-        return TK_S16;
+
+    advance(lexer);
+    if (strChar == '\'') {
+        return makeToken(lexer, TK_CHAR_LIT);
     }
-    if (str_eq_len(lexer->start + 1, "128", 3)) {
-        return TK_S128;
+
+    Token token = makeToken(lexer, TK_STRING_LIT);
+    if (lexer->interner != nullptr) {
+        token.symbol = internCached(lexer->interner, lexer->symbols, token.lexeme + 1, token.len - 2);
     }
 
-    return TK_IDENT;
+    return token;
 }
 
-static NiftyTokenType checkBoolTypes(const Lexer *lexer) {
-    if (str_eq_len(lexer->start + 1, "ool", 3)) {
-        return TK_BOOL;
-    }
-    if (str_eq_len(lexer->start + 1, "8", 1)) {
-        return TK_B8;
+static Token ident(Lexer *lexer) {
+    skipTo(lexer, scan_ident(lexer->current));
+
+    Token token = makeToken(lexer, keywordType(lexer->start, (int)(lexer->current - lexer->start)));
+    if (token.type == TK_IDENT && lexer->interner != nullptr) {
+        token.symbol = internCached(lexer->interner, lexer->symbols, token.lexeme, token.len);
     }
-    if (str_eq_len(lexer->start + 1, "16", 2)) {
-        return TK_B16;
+
+    return token;
+}
+
+static inline uint64_t load64(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+// Whether the eight bytes of v, first byte lowest, are all digits.
+static inline bool isEightDigits(const uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+// The eight digits in v as a number, by combining neighbouring digits, then pairs, then fours.
+static inline uint32_t eightDigits(uint64_t v) {
+    v -= 0x3030303030303030ull;
+    v = v * 10 + (v >> 8);
+    v = ((v & 0x000000FF000000FFull) * 0x000F424000000064ull + ((v >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull) >> 32;
+    return (uint32_t)v;
+}
+
+// high:low = high:low * mul + add. Returns false if that doesn't fit in 128 bits.
+static bool mulAdd128(uint64_t *low, uint64_t *high, const uint32_t mul, const uint32_t add) {
+    const uint64_t l0 = (*low & 0xFFFFFFFFu) * mul + add;
+    const uint64_t l1 = (*low >> 32) * mul + (l0 >> 32);
+    const uint64_t h0 = (*high & 0xFFFFFFFFu) * mul + (l1 >> 32);
+    const uint64_t h1 = (*high >> 32) * mul + (h0 >> 32);
+
+    *low = (l1 << 32) | (l0 & 0xFFFFFFFFu);
+    *high = (h1 << 32) | (h0 & 0xFFFFFFFFu);
+    return (h1 >> 32) == 0;
+}
+
+static void setInteger(NumberLiteral *number, const uint64_t low, const uint64_t high, const bool overflow) {
+    number->kind = NUMBER_INTEGER;
+    number->overflow = (uint8_t)overflow;
+    number->value.integer.low = overflow ? UINT64_MAX : low;
+    number->value.integer.high = overflow ? UINT64_MAX : high;
+}
+
+// [p, end) is digits and '_'.
+static void decimalInteger(const char *p, const char *end, NumberLiteral *number) {
+    // Up to eight digits in one step: shifted to the top of the word with '0's below them. The source is padded, so
+    // reading past the end of the literal is fine.
+    const int len = (int)(end - p);
+    if (len <= 8) {
+        uint64_t v = load64(p);
+        if (len < 8) {
+            v = (v << (8 * (8 - len))) | (0x3030303030303030ull >> (8 * len));
+        }
+
+        if (isEightDigits(v)) {
+            setInteger(number, eightDigits(v), 0, false);
+            return;
+        }
     }
-    if (str_eq_len(lexer->start + 1, "32", 2)) {
-        return TK_B32;
+
+    uint64_t low = 0;
+    while (p < end) {
+        if (end - p >= 8 && low <= (UINT64_MAX - 99999999u) / 100000000u && isEightDigits(load64(p))) {
+            low = low * 100000000u + eightDigits(load64(p));
+            p += 8;
+        } else if (*p == '_') {
+            ++p;
+        } else if (low <= (UINT64_MAX - 9) / 10) {
+            low = low * 10 + (uint64_t)(*p++ - '0');
+        } else {
+            break;
+        }
     }
-    if (str_eq_len(lexer->start + 1, "64", 2)) {
-        return TK_B64;
+
+    // More than 64 bits.
+    uint64_t high = 0;
+    bool fits = true;
+    while (p < end && fits) {
+        if (end - p >= 8 && isEightDigits(load64(p))) {
+            fits = mulAdd128(&low, &high, 100000000u, eightDigits(load64(p)));
+            p += 8;
+        } else {
+            if (*p != '_') {
+                fits = mulAdd128(&low, &high, 10, (uint32_t)(*p - '0'));
+            }
+            ++p;
+        }
     }
 
-    return TK_IDENT;
+    setInteger(number, low, high, !fits);
 }
 
-static NiftyTokenType checkFloatTypes(const Lexer *lexer) {
-    if (str_eq_len(lexer->start + 1, "32", 2)) {
-        return TK_F32;
+// [p, end) is hex or octal digits, bits is 4 or 3.
+static void radixInteger(const char *p, const char *end, const int bits, NumberLiteral *number) {
+    uint64_t low = 0;
+    uint64_t high = 0;
+    bool fits = true;
+    for (; p < end; ++p) {
+        const uint64_t digit = *p <= '9' ? (uint64_t)(*p - '0') : (uint64_t)((*p | 0x20) - 'a' + 10);
+        fits = fits && (high >> (64 - bits)) == 0;
+        high = (high << bits) | (low >> (64 - bits));
+        low = (low << bits) | digit;
     }
-    if (str_eq_len(lexer->start + 1, "oat", 3)) {
-        return TK_FLOAT;
+
+    setInteger(number, low, high, !fits);
+}
+
+static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// a * b, the high 64 bits returned and the low ones in low.
+static inline uint64_t mul128(const uint64_t a, const uint64_t b, uint64_t *low) {
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 product = (unsigned __int128)a * b;
+    *low = (uint64_t)product;
+    return (uint64_t)(product >> 64);
+#else
+    const uint64_t ll = (a & 0xFFFFFFFFu) * (b & 0xFFFFFFFFu);
+    const uint64_t lh = (a & 0xFFFFFFFFu) * (b >> 32);
+    const uint64_t hl = (a >> 32) * (b & 0xFFFFFFFFu);
+    const uint64_t hh = (a >> 32) * (b >> 32);
+    const uint64_t mid = (ll >> 32) + (lh & 0xFFFFFFFFu) + (hl & 0xFFFFFFFFu);
+    *low = (mid << 32) | (ll & 0xFFFFFFFFu);
+    return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+static inline int leadingZeros64(const uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return 63 - (int)idx;
+#else
+    return __builtin_clzll(v);
+#endif
+}
+
+// mantissa * 10^exp10 rounded to the nearest double with the Eisel-Lemire algorithm: a 128 bit approximation of the
+// power of ten is almost always enough to know which way to round. Returns false when it isn't.
+static bool eiselLemire(uint64_t mantissa, const int exp10, double *result) {
+    if (mantissa == 0 || exp10 < POWER_OF_FIVE_MIN) {
+        *result = 0.0;
+        return true;
     }
-    if (str_eq_len(lexer->start + 1, "64", 2)) {
-        return TK_F64;
+
+    if (exp10 > POWER_OF_FIVE_MAX) {
+        *result = INFINITY;
+        return true;
     }
-    if (str_eq_len(lexer->start + 1, "16", 2)) {
-        return TK_F16;
+
+    const int zeros = leadingZeros64(mantissa);
+    mantissa <<= zeros;
+
+    // 55 bits are needed, the 53 of a double and two to round with. If all the bits below those are set, adding the
+    // next 64 bits of the power could still carry into them.
+    const int index = 2 * (exp10 - POWER_OF_FIVE_MIN);
+    uint64_t low;
+    uint64_t high = mul128(mantissa, powersOfFive[index], &low);
+    if ((high & 0x1FF) == 0x1FF) {
+        uint64_t lowLow;
+        const uint64_t lowHigh = mul128(mantissa, powersOfFive[index + 1], &lowLow);
+        low += lowHigh;
+        high += lowHigh > low;
     }
-    if (str_eq_len(lexer->start + 1, "128", 3)) {
-        return TK_F128;
+
+    if (low == UINT64_MAX && (exp10 < -27 || exp10 > 55)) {
+        return false;
     }
 
-    return TK_IDENT;
-}
+    const int upper = (int)(high >> 63);
+    const int shift = upper + 64 - 52 - 3;
+    uint64_t bits = high >> shift;
+    // floor(log2(10^exp10)) + 63, then the exponent bias.
+    int exp2 = ((217706 * exp10) >> 16) + 63 + upper - zeros + 1023;
+
+    if (exp2 <= 0) {
+        // Subnormal.
+        if (-exp2 + 1 >= 64) {
+            *result = 0.0;
+            return true;
+        }
 
-static NiftyTokenType identType(const Lexer *lexer) {
-    switch (lexer->start[0]) {
-        case '_': return checkKeyword(lexer, 1, 8, "_anytype", TK_ANY_TYPE); // __anytype
-        case 'a':
-            // align_of
-            // api
-            // as
-            // assert
-            // assert_db
-            // auto_cast
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'l': return checkKeyword(lexer, 2, 6, "ign_of", TK_ALIGN_OF);
-                    case 'p': return checkKeyword(lexer, 2, 1, "i", TK_API);
-                    case 's':
-                        if (lexer->start[2] == 's') {
-                            return checkKeyword2(lexer, 2, 4, "sert", TK_ASSERT, 7, "sert_db", TK_ASSERT_DB);
-                        } else {
-                            return checkKeyword(lexer, 2, 0, "", TK_AS);
-                        }
-                    case 'u': return checkKeyword(lexer, 2, 7, "to_cast", TK_AUTO_CAST);
-                    default: break;
-                }
-            }
-        case 'b': {
-            // behavior
-            // break
-            // bool b8 b16 b32 b64
-            const NiftyTokenType type = checkKeyword2(lexer, 1, 4, "reak", TK_BREAK, 7, "ehavior", TK_BEHAVIOR);
-            if (type != TK_IDENT) {
-                return type;
-            }
-            return checkBoolTypes(lexer);
-        }
-        case 'c':
-            // cast
-            // char
-            // const
-            // constimpl
-            // continue
-            // cstring
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'a': return checkKeyword(lexer, 2, 2, "st", TK_CAST);
-                    case 'h': return checkKeyword(lexer, 2, 2, "ar", TK_CHAR_TYPE);
-                    case 'o':
-                        if (lexer->start[2] == 'n' && lexer->start[3] == 's') {
-                            return checkKeyword2(lexer, 4, 1, "t", TK_CONST, 5, "timpl", TK_CONST_IMPL);
-                        } else {
-                            return checkKeyword(lexer, 3, 5, "ntinue", TK_CONTINUE);
-                        }
-                    case 's': return checkKeyword(lexer, 2, 5, "tring", TK_CSTRING_TYPE);
-                    default: break;
-                }
-            }
-        case 'd':
-            // defer
-            // defer_err
-            // delete
-            // does
-            // double
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'e':
-                        if (lexer->start[2] == 'f') {
-                            return checkKeyword2(lexer, 3, 2, "er", TK_DEFER, 6, "er_err", TK_DEFER_ERR);
-                        } else {
-                            return checkKeyword(lexer, 2, 4, "lete", TK_DELETE);
-                        }
-                    case 'o': return checkKeyword2(lexer, 2, 2, "es", TK_DOES, 4, "uble", TK_DOUBLE);
-                    default: break;
-                }
-            }
-        case 'e':
-            // else
-            // elif
-            // emit
-            // endimpl
-            // enum
-            // extern
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'l': return checkKeyword2(lexer, 2, 2, "se", TK_ELSE, 2, "if", TK_ELIF);
-                    case 'm': return checkKeyword(lexer, 2, 2, "it", TK_EMIT);
-                    case 'n': return checkKeyword2(lexer, 2, 2, "um", TK_ENUM, 3, "dimpl", TK_END_IMPL);
-                    case 'x': return checkKeyword(lexer, 2, 4, "tern", TK_EXTERN);
-                    default: break;
-                }
-            }
-        case 'f': {
-            // false
-            // float
-            // f16 f32 f64
-            // fn
-            // for
-            NiftyTokenType type = checkKeyword(lexer, 1, 1, "n", TK_FN);
-            if (type != TK_IDENT) {
-                return type;
-            }
-            type = checkFloatTypes(lexer);
-            if (type != TK_IDENT) {
-                return type;
-            }
-            return checkKeyword2(lexer, 1, 2, "or", TK_FOR, 4, "alse", TK_FALSE);
-        }
-        case 'g': return checkKeyword(lexer, 1, 3, "oto", TK_GOTO); // goto
-        case 'h': break;
-        case 'i':
-            // if
-            // impl
-            // in
-            // int
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'f': return checkKeyword(lexer, 2, 0, "", TK_IF);
-                    case 'm': return checkKeyword(lexer, 2, 2, "pl", TK_IMPL);
-                    case 'n': return checkKeyword2(lexer, 2, 0, "", TK_IN, 1, "t", TK_INT);
-                    default: break;
-                }
-            }
-        case 'j':
-        case 'k': break;
-        case 'l': return checkKeyword(lexer, 1, 2, "et", TK_LET); // let
-        case 'm': return checkKeyword(lexer, 1, 1, "d", TK_MD); // md
-        case 'n':
-            // name_of
-            // namespace
-            // new
-            // null
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'a': return checkKeyword2(lexer, 2, 5, "me_of", TK_NAME_OF, 7, "mespace", TK_NAMESPACE);
-                    case 'e': return checkKeyword(lexer, 2, 1, "w", TK_NEW);
-                    case 'u': return checkKeyword(lexer, 2, 2, "ll", TK_NULL);
-                    default: break;
-                }
-            }
-        case 'o': break;
-        case 'p': return checkKeyword(lexer, 1, 6, "ackage", TK_PACKAGE); // package
-        case 'q': break;
-        case 'r':
-            // rawptr
-            // recast
-            // restrict
-            // return
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'a': return checkKeyword(lexer, 2, 3, "ptr", TK_RAWPTR);
-                    case 'e':
-                        switch (lexer->start[2]) {
-                            case 'c': return checkKeyword(lexer, 3, 3, "ast", TK_RECAST);
-                            case 's': return checkKeyword(lexer, 3, 6, "strict", TK_RESTRICT);
-                            case 't': return checkKeyword(lexer, 3, 3, "urn", TK_RETURN);
-                            default: break;
-                        }
-                    default: break;
-                }
-            }
-        case 's': {
-            // size_of
-            // skip
-            // string
-            // struct
-            // s8 s16 s32 s64 s128
-            const NiftyTokenType type = checkSInts(lexer);
-            if (type != TK_IDENT) {
-                return type;
-            }
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'i': return checkKeyword(lexer, 2, 5, "ze_of", TK_SIZE_OF);
-                    case 'k': return checkKeyword(lexer, 2, 2, "ip", TK_SKIP);
-                    case 't': return checkKeyword2(lexer, 2, 4, "ring", TK_STRING_TYPE, 4, "ruct", TK_STRUCT);
-                    default: break;
-                }
-            }
+        bits >>= -exp2 + 1;
+        bits += bits & 1;
+        bits >>= 1;
+        exp2 = bits < (1ull << 52) ? 0 : 1;
+    } else {
+        // Exactly halfway between two doubles, round to even instead of up.
+        if (low <= 1 && exp10 >= -4 && exp10 <= 23 && (bits & 3) == 1 && (bits << shift) == high) {
+            bits &= ~1ull;
         }
-        case 't':
-            // test
-            // true
-            // try
-            // type
-            // type_of
-            // type_from
-            // typeid_of
-            // typeinfo_of
-            // typeid
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'e': return checkKeyword(lexer, 2, 2, "st", TK_TEST);
-                    case 'r': return checkKeyword2(lexer, 2, 1, "y", TK_TRY, 2, "ue", TK_TRUE);
-                    case 'y': {
-                        NiftyTokenType type = checkKeyword(lexer, 2, 5, "pedef", TK_TYPEDEF);
-                        if (type != TK_IDENT) {
-                            return type;
-                        }
-                        type = checkKeyword2(lexer, 2, 5, "pe_of", TK_TYPE_OF, 7, "pe_from", TK_TYPE_FROM);
-                        if (type != TK_IDENT) {
-                            return type;
-                        }
-                        type = checkKeyword2(lexer, 2, 7, "peid_of", TK_TYPEID_OF, 9, "peinfo_of", TK_TYPEINFO_OF);
-                        if (type != TK_IDENT) {
-                            return type;
-                        }
-                        return checkKeyword(lexer, 2, 4, "peid", TK_TYPEID);
-                    }
-                    default: break;
-                }
-            }
-        case 'u': {
-            // until
-            // use
-            // using
-            // u8 u16 u32 u64 u128
-            // uint
-            // uintptr
-            // unused
-            // undefined
-            NiftyTokenType type = checkKeyword2(lexer, 1, 2, "se", TK_USE, 4, "sing", TK_USING);
-            if (type != TK_IDENT) {
-                return type;
-            }
-            type = checkKeyword(lexer, 1, 4, "ntil", TK_UNTIL);
-            if (type != TK_IDENT) {
-                return type;
-            }
-            type = checkUInts(lexer);
-            if (type != TK_IDENT) {
-                return type;
-            }
-            return checkKeyword2(lexer, 1, 8, "ndefined", TK_UNDEFINED, 5, "nused", TK_UNUSED);
-        }
-        case 'v':
-            // val
-            // void
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'a': return checkKeyword(lexer, 2, 1, "l", TK_VAL);
-                    case 'o': return checkKeyword(lexer, 2, 2, "id", TK_VOID);
-                    default: break;
-                }
-            }
-        case 'w': return checkKeyword2(lexer, 1, 4, "hile", TK_WHILE, 2, "en", TK_WHEN); // when, while
-        case 'x':
-        case 'y':
-        case 'z':
-        default: break;
-    }
 
-    return TK_IDENT;
-}
+        bits += bits & 1;
+        bits >>= 1;
+        if (bits >= (2ull << 52)) {
+            bits = 1ull << 52;
+            ++exp2;
+        }
 
-static Token stringLit(Lexer *lexer, const char strChar) {
-    //TODO: Raw strings.
+        bits &= ~(1ull << 52);
+        if (exp2 >= 0x7FF) {
+            *result = INFINITY;
+            return true;
+        }
+    }
 
-    bool overwrite = false;
-    while ((peek(lexer) != strChar || overwrite) && !atEnd(lexer)) {
-        overwrite = false;
+    bits |= (uint64_t)exp2 << 52;
+    memcpy(result, &bits, sizeof(bits));
+    return true;
+}
 
-        if (peek(lexer) == '\\' && peekNext(lexer) == strChar) {
-            overwrite = true;
+// [p, end) is digits and '_' with a fraction, an exponent or both.
+static void decimalFloat(const char *p, const char *end, NumberLiteral *number) {
+    const char *literal = p;
+    uint64_t mantissa = 0;
+    int digits = 0; // In mantissa, at most 19 so it can't overflow.
+    int exp10 = 0;
+    bool truncated = false;
+    bool fraction = false;
+
+    for (; p < end && *p != 'e' && *p != 'E'; ++p) {
+        if (digits <= 19 - 8 && end - p >= 8 && isEightDigits(load64(p))) {
+            mantissa = mantissa * 100000000u + eightDigits(load64(p));
+            digits += 8;
+            exp10 -= fraction ? 8 : 0;
+            p += 7;
+        } else if (*p == '.') {
+            fraction = true;
+        } else if (*p != '_') {
+            if (mantissa == 0 && *p == '0') {
+                exp10 -= fraction ? 1 : 0;
+            } else if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                ++digits;
+                exp10 -= fraction ? 1 : 0;
+            } else {
+                truncated = true;
+            }
         }
+    }
 
-        if (peek(lexer) == '\n') {
-            lexer->line++;
+    if (p < end) {
+        int exponent = 0;
+        bool negative = false;
+        for (++p; p < end; ++p) {
+            if (*p == '-') {
+                negative = true;
+            } else if (isDigit(*p) && exponent < 100000) {
+                exponent = exponent * 10 + (*p - '0');
+            }
         }
-
-        advance(lexer);
+        exp10 += negative ? -exponent : exponent;
     }
 
-    if (atEnd(lexer)) {
-        return errorToken(lexer, "Unterminated string.");
+    number->kind = NUMBER_FLOAT;
+    number->overflow = false;
+
+    // Both the mantissa and the power of ten are exact doubles, so one rounding gives the right answer.
+    if (!truncated && mantissa <= (1ull << 53) && exp10 >= -22 && exp10 <= 22) {
+        const double m = (double)mantissa;
+        number->value.real = exp10 < 0 ? m / powersOfTen[-exp10] : m * powersOfTen[exp10];
+        return;
     }
 
-    advance(lexer);
-    return makeToken(lexer, strChar == '"' ? TK_STRING_LIT : TK_CHAR_LIT);
-}
+    if (!truncated && eiselLemire(mantissa, exp10, &number->value.real)) {
+        number->overflow = (uint8_t)isinf(number->value.real);
+        return;
+    }
 
-static Token ident(Lexer *lexer) {
-    while (isAlphaNumeric(peek(lexer))) {
-        advance(lexer);
+    char small[64];
+    const size_t len = (size_t)(end - literal);
+    char *text = len < sizeof(small) ? small : (char *)malloc(len + 1);
+    size_t n = 0;
+    for (const char *c = literal; c < end; ++c) {
+        if (*c != '_') {
+            text[n++] = *c;
+        }
     }
+    text[n] = '\0';
 
-    return makeToken(lexer, identType(lexer));
+    number->value.real = strtod(text, nullptr);
+    number->overflow = (uint8_t)isinf(number->value.real);
+    if (text != small) {
+        free(text);
+    }
 }
 
 static Token exponent(Lexer *lexer) {
@@ -606,17 +718,14 @@ static Token exponent(Lexer *lexer) {
         return errorToken(lexer, "Invalid exponent literal.");
     }
 
-    while (isDigit(peek(lexer)) || peek(lexer) == '_') {
-        advance(lexer);
-    }
+    skipTo(lexer, scan_digits(lexer->current));
 
+    decimalFloat(lexer->start, lexer->current, &lexer->number);
     return makeToken(lexer, TK_NUMBER);
 }
 
 static Token number(Lexer *lexer) {
-    while (isDigit(peek(lexer)) || peek(lexer) == '_') {
-        advance(lexer);
-    }
+    skipTo(lexer, scan_digits(lexer->current));
 
     if (peek(lexer) == 'e' || peek(lexer) == 'E') {
         return exponent(lexer);
@@ -624,16 +733,17 @@ static Token number(Lexer *lexer) {
 
     if (peek(lexer) == '.' && isDigit(peekNext(lexer))) {
         advance(lexer);
-
-        while (isDigit(peek(lexer)) || peek(lexer) == '_') {
-            advance(lexer);
-        }
+        skipTo(lexer, scan_digits(lexer->current));
 
         if (peek(lexer) == 'e' || peek(lexer) == 'E') {
             return exponent(lexer);
         }
+
+        decimalFloat(lexer->start, lexer->current, &lexer->number);
+        return makeToken(lexer, TK_NUMBER);
     }
 
+    decimalInteger(lexer->start, lexer->current, &lexer->number);
     return makeToken(lexer, TK_NUMBER);
 }
 
@@ -652,10 +762,12 @@ static Token octalNumber(Lexer *lexer) {
             return errorToken(lexer, "Invalid octal literal.");
         }
 
+        const char *digits = lexer->current;
         while (isOctDigit(peek(lexer))) {
             advance(lexer);
         }
 
+        radixInteger(digits, lexer->current, 3, &lexer->number);
         return makeToken(lexer, TK_NUMBER);
     }
 
@@ -677,10 +789,12 @@ static Token hexNumber(Lexer *lexer) {
             return errorToken(lexer, "Invalid hex literal.");
         }
 
+        const char *digits = lexer->current;
         while (isHexDigit(peek(lexer))) {
             advance(lexer);
         }
 
+        radixInteger(digits, lexer->current, 4, &lexer->number);
         return makeToken(lexer, TK_NUMBER);
     }
 
@@ -691,10 +805,10 @@ Token nextToken(Lexer *lexer) {
     if (lexer == nullptr) {
         Token token;
         token.type = TK_INTERNAL_ERROR;
+        token.symbol = SYMBOL_NONE;
         token.lexeme = nullptr;
         token.len = 0;
-        token.line = 0;
-        token.pos = 0;
+        token.offset = 0;
         
         return token;
     }
@@ -727,9 +841,9 @@ Token nextToken(Lexer *lexer) {
         case '.':
             if (match(lexer, '.')) {
                 if (match(lexer, '<')) {
-                    return makeToken(lexer, TK_C_RANGE);
-                } else if (match(lexer, '=')) {
                     return makeToken(lexer, TK_O_RANGE);
+                } else if (match(lexer, '=')) {
+                    return makeToken(lexer, TK_C_RANGE);
                 }
                 return makeToken(lexer, TK_DOT_DOT);
             }
@@ -884,6 +998,408 @@ Token nextToken(Lexer *lexer) {
     return errorToken(lexer, "Unexpected character.");
 }
 
+static void reserveTokens(TokenStream *tokens, const int capacity) {
+    tokens->capacity = capacity;
+    tokens->kinds = (uint8_t *)realloc(tokens->kinds, sizeof(uint8_t) * tokens->capacity);
+    tokens->offsets = (uint32_t *)realloc(tokens->offsets, sizeof(uint32_t) * tokens->capacity);
+    tokens->lengths = (uint32_t *)realloc(tokens->lengths, sizeof(uint32_t) * tokens->capacity);
+    if (tokens->symbols != nullptr) {
+        tokens->symbols = (Symbol *)realloc(tokens->symbols, sizeof(Symbol) * tokens->capacity);
+    }
+}
+
+static void pushToken(TokenStream *tokens, const Token *token, const uint32_t offset, const uint32_t len) {
+    if (tokens->count == tokens->capacity) {
+        reserveTokens(tokens, tokens->capacity * 2);
+    }
+
+    tokens->kinds[tokens->count] = (uint8_t)token->type;
+    tokens->offsets[tokens->count] = offset;
+    tokens->lengths[tokens->count] = len;
+    if (tokens->symbols != nullptr) {
+        tokens->symbols[tokens->count] = token->symbol;
+    }
+    ++tokens->count;
+}
+
+static void pushError(TokenStream *tokens, const uint32_t token, const char *msg) {
+    if (tokens->errorCount == tokens->errorCapacity) {
+        tokens->errorCapacity = tokens->errorCapacity == 0 ? 8 : tokens->errorCapacity * 2;
+        tokens->errors = (TokenError *)realloc(tokens->errors, sizeof(TokenError) * tokens->errorCapacity);
+    }
+
+    tokens->errors[tokens->errorCount].token = token;
+    tokens->errors[tokens->errorCount].msg = msg;
+    ++tokens->errorCount;
+}
+
+static void pushNumber(TokenStream *tokens, const uint32_t token, const NumberLiteral *number) {
+    if (tokens->numberCount == tokens->numberCapacity) {
+        tokens->numberCapacity = tokens->numberCapacity == 0 ? 64 : tokens->numberCapacity * 2;
+        tokens->numbers = (NumberLiteral *)realloc(tokens->numbers, sizeof(NumberLiteral) * tokens->numberCapacity);
+    }
+
+    tokens->numbers[tokens->numberCount] = *number;
+    tokens->numbers[tokens->numberCount].token = token;
+    ++tokens->numberCount;
+}
+
+static TokenStream *newTokenStream(const Lexer *lexer, const size_t bytes) {
+    TokenStream *tokens = (TokenStream *)malloc(sizeof(TokenStream));
+    // Roughly one token every five bytes in typical source.
+    tokens->capacity = (int)max(bytes / 5, 64);
+    tokens->count = 0;
+    tokens->kinds = (uint8_t *)malloc(sizeof(uint8_t) * tokens->capacity);
+    tokens->offsets = (uint32_t *)malloc(sizeof(uint32_t) * tokens->capacity);
+    tokens->lengths = (uint32_t *)malloc(sizeof(uint32_t) * tokens->capacity);
+    tokens->symbols = lexer->interner != nullptr ? (Symbol *)malloc(sizeof(Symbol) * tokens->capacity) : nullptr;
+    tokens->errors = nullptr;
+    tokens->errorCount = 0;
+    tokens->errorCapacity = 0;
+    tokens->numbers = nullptr;
+    tokens->numberCount = 0;
+    tokens->numberCapacity = 0;
+
+    return tokens;
+}
+
+static void appendToken(TokenStream *tokens, const Lexer *lexer, const Token token) {
+    if (token.type == TK_INTERNAL_ERROR) {
+        pushError(tokens, (uint32_t)tokens->count, token.lexeme);
+    } else if (token.type == TK_NUMBER) {
+        pushNumber(tokens, (uint32_t)tokens->count, &lexer->number);
+    }
+
+    pushToken(tokens, &token, (uint32_t)(lexer->start - lexer->source), (uint32_t)(lexer->current - lexer->start));
+}
+
+// Appends every token that starts before end. Returns where the first token at or after end starts, that token isn't
+// lexed again by the caller. TK_EOF is only appended if it is before end.
+static uint32_t lexRange(Lexer *lexer, const uint32_t end, TokenStream *tokens) {
+    for (;;) {
+        const Token token = nextToken(lexer);
+        const uint32_t offset = (uint32_t)(lexer->start - lexer->source);
+        if (offset >= end) {
+            return offset;
+        }
+
+        appendToken(tokens, lexer, token);
+        if (token.type == TK_EOF) {
+            return offset;
+        }
+    }
+}
+
+TokenStream *tokenizeFile(Lexer *lexer) {
+    if (lexer == nullptr) {
+        return nullptr;
+    }
+
+    if (lexer->length >= UINT32_MAX) {
+        println("Source is too large for a token stream.");
+        return nullptr;
+    }
+
+    TokenStream *tokens = newTokenStream(lexer, lexer->length - (size_t)(lexer->current - lexer->source));
+    lexRange(lexer, UINT32_MAX, tokens);
+
+    return tokens;
+}
+
+typedef struct {
+    const Lexer *lexer;
+    uint32_t begin;
+    uint32_t end; // UINT32_MAX for the last chunk.
+    TokenStream *tokens;
+    uint32_t resume;
+} LexChunk;
+
+// Lexes a chunk as if nothing before it could still be open. The merge checks that guess.
+static void lexChunk(void *arg) {
+    LexChunk *chunk = (LexChunk *)arg;
+    Lexer lexer = *chunk->lexer;
+    lexer.current = lexer.source + chunk->begin;
+    lexer.start = lexer.current;
+    if (lexer.interner != nullptr) {
+        // Every thread gets its own cache, the interner itself is shared.
+        lexer.symbols = (InternCache *)calloc(1, sizeof(InternCache));
+    }
+
+    const uint32_t end = chunk->end == UINT32_MAX ? (uint32_t)lexer.length : chunk->end;
+    chunk->tokens = newTokenStream(&lexer, end - chunk->begin);
+    chunk->resume = lexRange(&lexer, chunk->end, chunk->tokens);
+
+    if (lexer.interner != nullptr) {
+        free(lexer.symbols);
+    }
+}
+
+static int findTokenOffset(const TokenStream *tokens, const uint32_t offset) {
+    int lo = 0;
+    int hi = tokens->count - 1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        if (tokens->offsets[mid] == offset) {
+            return mid;
+        }
+
+        if (tokens->offsets[mid] < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+static void appendTokens(TokenStream *tokens, const TokenStream *from, const int first) {
+    const int count = from->count - first;
+    if (tokens->count + count > tokens->capacity) {
+        reserveTokens(tokens, tokens->count + count);
+    }
+
+    for (int i = 0; i < from->errorCount; ++i) {
+        if (from->errors[i].token >= (uint32_t)first) {
+            pushError(tokens, tokens->count + from->errors[i].token - first, from->errors[i].msg);
+        }
+    }
+
+    for (int i = 0; i < from->numberCount; ++i) {
+        if (from->numbers[i].token >= (uint32_t)first) {
+            pushNumber(tokens, tokens->count + from->numbers[i].token - first, &from->numbers[i]);
+        }
+    }
+
+    memcpy(tokens->kinds + tokens->count, from->kinds + first, sizeof(uint8_t) * count);
+    memcpy(tokens->offsets + tokens->count, from->offsets + first, sizeof(uint32_t) * count);
+    memcpy(tokens->lengths + tokens->count, from->lengths + first, sizeof(uint32_t) * count);
+    if (tokens->symbols != nullptr) {
+        memcpy(tokens->symbols + tokens->count, from->symbols + first, sizeof(Symbol) * count);
+    }
+    tokens->count += count;
+}
+
+TokenStream *tokenizeFileParallel(Lexer *lexer, ThreadPool *pool) {
+    if (lexer == nullptr) {
+        return nullptr;
+    }
+
+    const uint32_t begin = (uint32_t)(lexer->current - lexer->source);
+    const size_t size = lexer->length - begin;
+    if (pool == nullptr || pool_thread_count(pool) < 2 || size < NIFTY_PARALLEL_LEX_MIN_SIZE || lexer->length >= UINT32_MAX) {
+        return tokenizeFile(lexer);
+    }
+
+    int chunkCount = pool_thread_count(pool) * 4;
+    if (size / chunkCount < NIFTY_PARALLEL_LEX_MIN_CHUNK) {
+        chunkCount = (int)(size / NIFTY_PARALLEL_LEX_MIN_CHUNK);
+    }
+
+    // Chunks start right after a newline.
+    LexChunk *chunks = (LexChunk *)malloc(sizeof(LexChunk) * (chunkCount + 1));
+    int count = 0;
+    uint32_t at = begin;
+    while (at < lexer->length) {
+        LexChunk *chunk = &chunks[count++];
+        chunk->lexer = lexer;
+        chunk->begin = at;
+
+        const char *nl = nullptr;
+        const size_t target = at + size / chunkCount;
+        if (count < chunkCount && target < lexer->length) {
+            nl = (const char *)memchr(lexer->source + target, '\n', lexer->length - target);
+        }
+
+        if (nl == nullptr) {
+            chunk->end = UINT32_MAX;
+            break;
+        }
+
+        chunk->end = (uint32_t)(nl - lexer->source) + 1;
+        at = chunk->end;
+    }
+    if (count == 0 || chunks[count - 1].end != UINT32_MAX) {
+        // The input ends on a newline, lex the empty remainder so the stream gets its TK_EOF.
+        chunks[count].lexer = lexer;
+        chunks[count].begin = at;
+        chunks[count].end = UINT32_MAX;
+        ++count;
+    }
+
+    // A group, so files can be lexed from inside tasks of the same pool.
+    TaskGroup group = TASK_GROUP_INIT;
+    for (int i = 0; i < count; ++i) {
+        pool_submit_group(pool, &group, lexChunk, &chunks[i]);
+    }
+    pool_wait_group(pool, &group);
+
+    // Each chunk was lexed as if it started outside any comment or string. Where the previous chunk actually ended up
+    // somewhere else, in a block comment at any nesting level or an open string, lex again from there until a token
+    // starts at the same place as one of the chunk's own tokens. From a token start on, lexing is the same no matter
+    // where it began, so the rest of the chunk is kept as is.
+    TokenStream *tokens = newTokenStream(lexer, size);
+    uint32_t resume = begin;
+    for (int i = 0; i < count; ++i) {
+        LexChunk *chunk = &chunks[i];
+        if (resume >= chunk->end) {
+            freeTokenStream(chunk->tokens);
+            continue;
+        }
+
+        int first = resume == chunk->begin ? 0 : findTokenOffset(chunk->tokens, resume);
+        if (first < 0) {
+            Lexer relex = *lexer;
+            relex.current = relex.source + resume;
+            relex.start = relex.current;
+
+            for (;;) {
+                const Token token = nextToken(&relex);
+                const uint32_t offset = (uint32_t)(relex.start - relex.source);
+                if (offset >= chunk->end) {
+                    resume = offset;
+                    break;
+                }
+
+                first = findTokenOffset(chunk->tokens, offset);
+                if (first >= 0) {
+                    break;
+                }
+
+                appendToken(tokens, &relex, token);
+                if (token.type == TK_EOF) {
+                    resume = offset;
+                    break;
+                }
+            }
+        }
+
+        if (first >= 0) {
+            appendTokens(tokens, chunk->tokens, first);
+            resume = chunk->resume;
+        }
+
+        freeTokenStream(chunk->tokens);
+    }
+
+    free(chunks);
+    lexer->current = lexer->source + lexer->length;
+    lexer->start = lexer->current;
+
+    return tokens;
+}
+
+void freeTokenStream(TokenStream *tokens) {
+    if (tokens == nullptr) {
+        return;
+    }
+
+    free(tokens->kinds);
+    free(tokens->offsets);
+    free(tokens->lengths);
+    free(tokens->symbols);
+    free(tokens->errors);
+    free(tokens->numbers);
+    free(tokens);
+}
+
+const char *tokenErrorMessage(const TokenStream *tokens, const int index) {
+    int lo = 0;
+    int hi = tokens->errorCount - 1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        if (tokens->errors[mid].token == (uint32_t)index) {
+            return tokens->errors[mid].msg;
+        }
+
+        if (tokens->errors[mid].token < (uint32_t)index) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return "Unknown error.";
+}
+
+const NumberLiteral *tokenNumber(const TokenStream *tokens, const int index) {
+    int lo = 0;
+    int hi = tokens->numberCount - 1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        if (tokens->numbers[mid].token == (uint32_t)index) {
+            return &tokens->numbers[mid];
+        }
+
+        if (tokens->numbers[mid].token < (uint32_t)index) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return nullptr;
+}
+
+static void buildLineTable(Lexer *lexer) {
+    const size_t newlines = scan_line_starts(lexer->source, lexer->length, 0, nullptr);
+    lexer->lineStarts = (uint32_t *)malloc(sizeof(uint32_t) * (newlines + 1));
+    lexer->lineStarts[0] = 0;
+    scan_line_starts(lexer->source, lexer->length, 0, lexer->lineStarts + 1);
+    lexer->lineCount = (int)newlines + 1;
+}
+
+// Index of the line containing offset.
+static int lineIndex(const Lexer *lexer, const uint32_t offset) {
+    int lo = 0;
+    int hi = lexer->lineCount - 1;
+    while (lo < hi) {
+        const int mid = lo + (hi - lo + 1) / 2;
+        if (lexer->lineStarts[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return lo;
+}
+
+SourceLocation lexerLocation(Lexer *lexer, const uint32_t offset) {
+    if (lexer->lineStarts == nullptr) {
+        buildLineTable(lexer);
+    }
+
+    const int line = lineIndex(lexer, offset);
+    SourceLocation location;
+    location.line = line + 1;
+    location.column = (int)(offset - lexer->lineStarts[line]) + 1;
+
+    return location;
+}
+
+const char *lexerLine(Lexer *lexer, const int line, int *len) {
+    if (lexer->lineStarts == nullptr) {
+        buildLineTable(lexer);
+    }
+
+    if (line < 1 || line > lexer->lineCount) {
+        return nullptr;
+    }
+
+    const uint32_t start = lexer->lineStarts[line - 1];
+    uint32_t end = line < lexer->lineCount ? lexer->lineStarts[line] - 1 : (uint32_t)lexer->length;
+    if (end > start && lexer->source[end - 1] == '\r') {
+        --end;
+    }
+
+    if (len != nullptr) {
+        *len = (int)(end - start);
+    }
+
+    return lexer->source + start;
+}
+
 void printToken(const Token token) {
     if (token.type == TK_INTERNAL_ERROR) {
         println("TK_INTERNAL_ERROR");
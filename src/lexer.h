@@ -23,107 +23,116 @@
 #ifndef __NIFTY_LEXER_H__
 #define __NIFTY_LEXER_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "intern.h"
+#include "util/thread.h"
+
+// Keywords are marked with their spelling in quotes. src/gen/keywords.c reads this enum at build time to generate the
+// perfect hash table the lexer uses to classify identifiers, adding a keyword only needs an entry here.
 typedef enum {
     TK_UNKNOWN = 0,
     
-    TK_FN,
-    TK_MD,
-
-    TK_TEST,
-    TK_SKIP,
-    
-    TK_IF,
-    TK_ELIF,
-    TK_ELSE,
-    TK_IN,
-    TK_AS,
-    TK_CAST,
-    TK_RECAST,
-    TK_AUTO_CAST,
-    TK_STRUCT,
-    TK_IMPL,
-    TK_CONST_IMPL,
-    TK_END_IMPL,
-    TK_DOES,
-    TK_BEHAVIOR,
-    TK_ENUM,
-    
-    TK_DEFER,
-    TK_DEFER_ERR,
-    TK_RESTRICT,
-    
-    TK_TYPEDEF,
-    TK_FOR,
-    TK_WHILE,
-    TK_UNTIL,
-    TK_WHEN,
-    TK_GOTO,
-    TK_BREAK,
-    TK_CONTINUE,
-    TK_RETURN,
-    TK_TRY,
-    
-    TK_TRUE,
-    TK_FALSE,
-    
-    TK_LET, // mutable
-    TK_VAL, // immutable, run time
-    TK_CONST, // immutable, compile time
-    TK_NEW,
-    TK_DELETE,
-    
-    TK_USE,
-    TK_USING,
-    TK_NAMESPACE,
-    TK_PACKAGE,
-    TK_API,
-    TK_EXTERN,
-    
-    TK_SIZE_OF,
-    TK_ALIGN_OF,
-    TK_TYPE_OF,
-    TK_TYPEID_OF,
-    TK_TYPEINFO_OF,
-    TK_TYPE_FROM,
-    TK_NAME_OF,
-    
-    TK_INT,
-    TK_UINT,
-    TK_FLOAT,
-    TK_DOUBLE,
-    TK_STRING_TYPE,
-    TK_CSTRING_TYPE,
-    TK_CHAR_TYPE,
-    TK_BOOL,
-    TK_B8,
-    TK_B16,
-    TK_B32,
-    TK_B64,
-    TK_U8,
-    TK_U16,
-    TK_U32,
-    TK_U64,
-    TK_U128,
-    TK_S8,
-    TK_S16,
-    TK_S32,
-    TK_S64,
-    TK_S128,
-    TK_F16,
-    TK_F32,
-    TK_F64,
-    TK_F128,
-    TK_VOID,
-    TK_RAWPTR,
-    TK_UINTPTR,
-    TK_TYPEID,
-    TK_ANY_TYPE,
-    
-    TK_NULL,
-    TK_UNDEFINED,
-    TK_UNUSED,
-    
-    TK_EMIT,
+    TK_FN,                      // "fn"
+    TK_MD,                      // "md"
+
+    TK_TEST,                    // "test"
+    TK_SKIP,                    // "skip"
+    
+    TK_IF,                      // "if"
+    TK_ELIF,                    // "elif"
+    TK_ELSE,                    // "else"
+    TK_IN,                      // "in"
+    TK_AS,                      // "as"
+    TK_CAST,                    // "cast"
+    TK_RECAST,                  // "recast"
+    TK_AUTO_CAST,               // "auto_cast"
+    TK_STRUCT,                  // "struct"
+    TK_IMPL,                    // "impl"
+    TK_CONST_IMPL,              // "constimpl"
+    TK_END_IMPL,                // "endimpl"
+    TK_DOES,                    // "does"
+    TK_BEHAVIOR,                // "behavior"
+    TK_ENUM,                    // "enum"
+    
+    TK_DEFER,                   // "defer"
+    TK_DEFER_ERR,               // "defer_err"
+    TK_RESTRICT,                // "restrict"
+    
+    TK_TYPEDEF,                 // "typedef"
+    TK_FOR,                     // "for"
+    TK_WHILE,                   // "while"
+    TK_UNTIL,                   // "until"
+    TK_WHEN,                    // "when"
+    TK_GOTO,                    // "goto"
+    TK_BREAK,                   // "break"
+    TK_CONTINUE,                // "continue"
+    TK_RETURN,                  // "return"
+    TK_TRY,                     // "try"
+    
+    TK_TRUE,                    // "true"
+    TK_FALSE,                   // "false"
+    
+    TK_LET,                     // "let" mutable
+    TK_VAL,                     // "val" immutable, run time
+    TK_CONST,                   // "const" immutable, compile time
+    TK_NEW,                     // "new"
+    TK_DELETE,                  // "delete"
+    
+    TK_USE,                     // "use"
+    TK_USING,                   // "using"
+    TK_NAMESPACE,               // "namespace"
+    TK_PACKAGE,                 // "package"
+    TK_API,                     // "api"
+    TK_EXTERN,                  // "extern"
+    
+    TK_SIZE_OF,                 // "size_of"
+    TK_ALIGN_OF,                // "align_of"
+    TK_TYPE_OF,                 // "type_of"
+    TK_TYPEID_OF,               // "typeid_of"
+    TK_TYPEINFO_OF,             // "typeinfo_of"
+    TK_TYPE_FROM,               // "type_from"
+    TK_NAME_OF,                 // "name_of"
+    
+    TK_INT,                     // "int"
+    TK_UINT,                    // "uint"
+    TK_FLOAT,                   // "float"
+    TK_DOUBLE,                  // "double"
+    TK_STRING_TYPE,             // "string"
+    TK_CSTRING_TYPE,            // "cstring"
+    TK_CHAR_TYPE,               // "char"
+    TK_BOOL,                    // "bool"
+    TK_B8,                      // "b8"
+    TK_B16,                     // "b16"
+    TK_B32,                     // "b32"
+    TK_B64,                     // "b64"
+    TK_U8,                      // "u8"
+    TK_U16,                     // "u16"
+    TK_U32,                     // "u32"
+    TK_U64,                     // "u64"
+    TK_U128,                    // "u128"
+    TK_S8,                      // "s8"
+    TK_S16,                     // "s16"
+    TK_S32,                     // "s32"
+    TK_S64,                     // "s64"
+    TK_S128,                    // "s128"
+    TK_F16,                     // "f16"
+    TK_F32,                     // "f32"
+    TK_F64,                     // "f64"
+    TK_F128,                    // "f128"
+    TK_VOID,                    // "void"
+    TK_RAWPTR,                  // "rawptr"
+    TK_UINTPTR,                 // "uintptr"
+    TK_TYPEID,                  // "typeid"
+    TK_ANY_TYPE,                // "__anytype"
+    
+    TK_NULL,                    // "null"
+    TK_UNDEFINED,               // "undefined"
+    TK_UNUSED,                  // "unused"
+    
+    TK_EMIT,                    // "emit"
     
     TK_COLON,                   // :
     TK_COMMA,                   // ,
@@ -211,8 +220,8 @@ typedef enum {
     TK_NULL_COALESCE_ASSIGN,    // ??=
     TK_NULLISH_COALESCE_ASSIGN, // ||=
 
-    TK_ASSERT,
-    TK_ASSERT_DB,
+    TK_ASSERT,                  // "assert"
+    TK_ASSERT_DB,               // "assert_db"
     
     TK_IDENT,
     TK_STRING_LIT,
@@ -225,26 +234,121 @@ typedef enum {
 
 typedef struct {
     NiftyTokenType type;
+    Symbol symbol; // Interned spelling of TK_IDENT, and of TK_STRING_LIT without its quotes. SYMBOL_NONE otherwise.
     const char *lexeme;
     int len;
-    int line;
-    int pos;
+    uint32_t offset; // Byte offset into the source, see lexerLocation for the line and column.
 } Token;
 
+// Files smaller than this are always lexed on one thread.
+#define NIFTY_PARALLEL_LEX_MIN_SIZE (4 * 1024 * 1024)
+#define NIFTY_PARALLEL_LEX_MIN_CHUNK (512 * 1024)
+
+// Zero bytes guaranteed after the end of every source buffer, the vectorized scanners read ahead in blocks.
+#define NIFTY_SOURCE_PADDING 32
+
+// How far past the end of a token the lexer may look to decide where it ends, "1." stops before the '.' only after
+// seeing the character following it.
+#define NIFTY_TOKEN_LOOKAHEAD 2
+
+typedef enum {
+    SOURCE_LOAD_AUTO, // Memory map regular files, read stdin and other streams into the heap.
+    SOURCE_LOAD_COPY, // Always read into a heap buffer.
+} SourceLoadMode;
+
+typedef enum {
+    NUMBER_INTEGER,
+    NUMBER_FLOAT,
+} NumberKind;
+
+// Value of a TK_NUMBER token, worked out while lexing it.
 typedef struct {
-    char *source;
+    uint32_t token; // Index of the token in its stream.
+    uint8_t kind;
+    uint8_t overflow; // Integers wider than 128 bits, floats too large for a double (those are infinite).
+
+    union {
+        struct { uint64_t low; uint64_t high; } integer;
+        double real; // Exactly rounded.
+    } value;
+} NumberLiteral;
+
+typedef struct {
+    const char *source; // Always NUL terminated, may contain '\r'.
+    size_t length;
+    size_t mappedSize; // Size of the mapping if the source is memory mapped, 0 if it is on the heap.
     const char *start;
     const char *current;
     char prev;
-    int line;
-    int linePos;
+    NumberLiteral number; // Value of the last TK_NUMBER token.
+
+    Interner *interner; // Identifiers and strings are only interned if this is set.
+    InternCache *symbols;
+
+    // Offset of the first character of every line, built by the first lexerLocation or lexerLine call.
+    uint32_t *lineStarts;
+    int lineCount;
 } Lexer;
 
+typedef struct {
+    int line;   // From 1.
+    int column; // From 1, in bytes.
+} SourceLocation;
+
+typedef struct {
+    uint32_t token;
+    const char *msg;
+} TokenError;
+
+// A whole file of tokens laid out as separate arrays. Offsets and lengths are in bytes into the lexer's source, the
+// last token is always TK_EOF. TK_INTERNAL_ERROR tokens cover the bad input and keep their message in errors.
+typedef struct {
+    uint8_t *kinds;
+    uint32_t *offsets;
+    uint32_t *lengths;
+    Symbol *symbols; // Only if the lexer interns, see Token.symbol.
+    int count;
+    int capacity;
+
+    TokenError *errors;
+    int errorCount;
+    int errorCapacity;
+
+    NumberLiteral *numbers; // One for every TK_NUMBER token, in token order.
+    int numberCount;
+    int numberCapacity;
+} TokenStream;
+
+// A filename of "-" reads from stdin.
 Lexer *initLexer(const char *filename);
+Lexer *initLexerWithMode(const char *filename, SourceLoadMode mode);
+// Lexes a copy of source.
+Lexer *initLexerFromMemory(const char *source, size_t length);
 void freeLexer(Lexer *lexer);
+// Interns every identifier and string lexed from now on, see Token.symbol.
+void lexerIntern(Lexer *lexer, Interner *interner);
 
 Token nextToken(Lexer *lexer);
 
+// The keyword spelled by [start, start + len), TK_IDENT if it isn't one.
+NiftyTokenType keywordType(const char *start, int len);
+
+// Lexes everything left in the lexer's source.
+TokenStream *tokenizeFile(Lexer *lexer);
+// Same as tokenizeFile, but large sources are split at newlines and the pieces are lexed on pool.
+TokenStream *tokenizeFileParallel(Lexer *lexer, ThreadPool *pool);
+void freeTokenStream(TokenStream *tokens);
+
+// Message of the TK_INTERNAL_ERROR token at index.
+const char *tokenErrorMessage(const TokenStream *tokens, int index);
+// Value of the TK_NUMBER token at index.
+const NumberLiteral *tokenNumber(const TokenStream *tokens, int index);
+
+// Line and column of the character at offset, found by binary search over the line table.
+SourceLocation lexerLocation(Lexer *lexer, uint32_t offset);
+// Start of line, without its newline in len. nullptr if the source has no such line.
+const char *lexerLine(Lexer *lexer, int line, int *len);
+
 void printToken(Token token);
 
 #endif //__NIFTY_LEXER_H__
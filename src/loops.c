@@ -0,0 +1,477 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "pass.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Loops are put in the shape C compilers vectorize, and each is marked with whether it is in it. What doesn't change
+// in a loop is hoisted to the block before it, innermost loops first so it can keep going out: len(a) in the
+// condition of for (i := 0; i < len(a); ++i) is worked out once, and the loop's trip count is known before it starts.
+//
+// An innermost loop can vectorize when it is counted, see LOOP_COUNTED, and nothing in it can stop it early: no
+// break or return, no call, and no check that can fail. Its memory accesses mustn't depend on each other across
+// iterations: two accesses where one is a store must be to the element of the counter in the same array, or to
+// objects that can't overlap, like the function's own allocations, different globals, or restrict and string
+// parameters against anything. Values carried from one iteration to the next must be integer reductions like sums.
+// --vectorize-report says for each loop whether it can, or the first reason it can't.
+
+typedef struct {
+    IrModule *module;
+    IrFunction *function;
+    bool *inLoop;
+    IrBlock header;
+    IrBlock preheader; // The block before the loop that only goes to it, IR_NO_BLOCK if there isn't one.
+    IrValue counter; // The header phi the loop counts with, IR_NONE if it isn't counted.
+} Loop;
+
+static bool isInvariant(const Loop *loop, const IrValue value) {
+    const IrBlock block = irInst(loop->function, value)->block;
+    return block != IR_NO_BLOCK && !loop->inLoop[block];
+}
+
+typedef struct {
+    const Loop *loop;
+    bool invariant;
+} Operands;
+
+static void checkOperand(IrFunction *function, IrValue *operand, void *context) {
+    (void)function;
+    Operands *operands = (Operands *)context;
+    operands->invariant = operands->invariant && isInvariant(operands->loop, *operand);
+}
+
+// Whether the op gives the same value from the same operands wherever it runs, and can't trap or touch memory.
+static bool canHoist(const IrOp op) {
+    switch (op) {
+        case IR_INT:
+        case IR_FLOAT:
+        case IR_BOOL:
+        case IR_STRING:
+        case IR_NULL:
+        case IR_ZERO:
+        case IR_TYPE:
+        case IR_FUNCTION:
+        case IR_EXTERN:
+        case IR_GLOBAL:
+        case IR_NEG:
+        case IR_NOT:
+        case IR_BIT_NOT:
+        case IR_CONVERT:
+        case IR_LEN:
+        case IR_HAS_VALUE:
+        case IR_OVERFLOWED:
+        case IR_FIELD:
+        case IR_ELEMENT:
+            return true;
+        default:
+            return op >= IR_ADD && op <= IR_GE && op != IR_DIV && op != IR_MOD;
+    }
+}
+
+// Moves what doesn't change in the loop to the end of its preheader, returns how many.
+static int hoistInvariants(const Loop *loop, const IrBlock *order, const int count) {
+    IrFunction *function = loop->function;
+    const IrBlockData *preheader = &function->blocks[loop->preheader];
+    int hoisted = 0;
+    for (int o = count - 1; o >= 0; --o) {
+        const IrBlock b = order[o];
+        if (!loop->inLoop[b]) {
+            continue;
+        }
+
+        for (int i = 0; i < function->blocks[b].count;) {
+            const IrValue value = function->blocks[b].insts[i];
+            Operands operands = {loop, true};
+            if (canHoist((IrOp)irInst(function, value)->op)) {
+                irForEachOperand(function, value, checkOperand, &operands);
+            }
+            if (!canHoist((IrOp)irInst(function, value)->op) || !operands.invariant) {
+                ++i;
+                continue;
+            }
+
+            moveIrInst(function, value, loop->preheader, preheader->count - 1);
+            ++hoisted;
+        }
+    }
+
+    return hoisted;
+}
+
+static bool isInt(const IrFunction *function, const IrValue value) {
+    return irInst(function, value)->op == IR_INT;
+}
+
+// Whether phi of the header steps by a constant each iteration.
+static bool isStep(const Loop *loop, const IrValue phi) {
+    const IrFunction *function = loop->function;
+    const IrInst *inst = irInst(function, phi);
+    if (inst->op != IR_PHI || inst->block != loop->header || !irIsInteger(inst->type)) {
+        return false;
+    }
+
+    int count;
+    const uint32_t *operands = irList(function, inst->a, &count);
+    if (count != 2) {
+        return false;
+    }
+    const IrInst *next = irInst(function, operands[1]);
+    return (next->op == IR_ADD && ((next->a == phi && isInt(function, next->b)) ||
+                                   (next->b == phi && isInt(function, next->a)))) ||
+           (next->op == IR_SUB && next->a == phi && isInt(function, next->b));
+}
+
+// The counter of the loop if its header leaves it on a compare of one against a value from before the loop.
+static IrValue findCounter(const Loop *loop) {
+    const IrFunction *function = loop->function;
+    const IrValue terminator = irTerminator(function, loop->header);
+    const IrInst *branch = irInst(function, terminator);
+    if (loop->preheader == IR_NO_BLOCK || branch->op != IR_BRANCH ||
+        loop->inLoop[function->extra[branch->b]] == loop->inLoop[function->extra[branch->b + 1]]) {
+        return IR_NONE;
+    }
+
+    const IrInst *condition = irInst(function, branch->a);
+    if (condition->op != IR_NE && (condition->op < IR_LT || condition->op > IR_GE)) {
+        return IR_NONE;
+    }
+    if (isStep(loop, condition->a) && isInvariant(loop, condition->b)) {
+        return condition->a;
+    }
+    if (isStep(loop, condition->b) && isInvariant(loop, condition->a)) {
+        return condition->b;
+    }
+    return IR_NONE;
+}
+
+// The kind of the trap block, which only failed checks go to.
+static IrTrap trapOf(const IrFunction *function, const IrBlock block) {
+    const IrBlockData *data = &function->blocks[block];
+    for (int i = 0; i < data->count; ++i) {
+        const IrInst *inst = irInst(function, data->insts[i]);
+        if (inst->op == IR_TRAP) {
+            return (IrTrap)inst->a;
+        }
+    }
+    return TRAP_BOUNDS;
+}
+
+// Why the loop can leave other than through its header, nullptr if it can't. Sets breaks if it can by a break or
+// return rather than a failed check.
+static const char *earlyExit(const Loop *loop, bool *breaks) {
+    const IrFunction *function = loop->function;
+    const char *reason = nullptr;
+    *breaks = false;
+    for (int b = 0; b < function->blockCount; ++b) {
+        if (!loop->inLoop[b] || b == (int)loop->header) {
+            continue;
+        }
+
+        IrBlock succs[2];
+        const int count = irSuccessors(function, (IrBlock)b, succs);
+        for (int s = 0; s < count; ++s) {
+            if (loop->inLoop[succs[s]]) {
+                continue;
+            }
+            if (function->blocks[succs[s]].kind != BLOCK_COLD) {
+                *breaks = true;
+                return "it can leave early, through a break or return";
+            }
+            static const char *reasons[TRAP_COUNT] = {
+                "a bounds check in it can fail",
+                "an overflow check in it can fail",
+                "a division in it can be by 0",
+            };
+            reason = reasons[trapOf(function, succs[s])];
+        }
+    }
+
+    return reason;
+}
+
+// What a memory access is to: an element of the array at base, or a part of root if base is IR_NONE.
+typedef struct {
+    IrValue root; // The object, after every field and element.
+    IrValue base;
+    IrValue index;
+    bool store;
+} Access;
+
+static Access accessOf(const IrFunction *function, IrValue address, const bool store) {
+    Access access = {IR_NONE, IR_NONE, IR_NONE, store};
+    while (irInst(function, address)->op == IR_FIELD) {
+        address = irInst(function, address)->a;
+    }
+    if (irInst(function, address)->op == IR_ELEMENT) {
+        access.base = irInst(function, address)->a;
+        access.index = irInst(function, address)->b;
+    }
+    while (irInst(function, address)->op == IR_FIELD || irInst(function, address)->op == IR_ELEMENT) {
+        address = irInst(function, address)->a;
+    }
+    access.root = address;
+    return access;
+}
+
+static bool isAllocation(const IrOp op) {
+    return op == IR_ALLOC || op == IR_NEW || op == IR_REGION_NEW;
+}
+
+// Whether nothing of root a can be part of root b.
+static bool distinctRoots(const IrFunction *function, const IrValue a, const IrValue b) {
+    const IrInst *x = irInst(function, a);
+    const IrInst *y = irInst(function, b);
+    for (int i = 0; i < 2; ++i) {
+        const IrInst *param = i == 0 ? x : y;
+        if (param->op == IR_PARAM && param->a < 32 && function->restrictParams >> param->a & 1) {
+            return true;
+        }
+    }
+
+    if (isAllocation((IrOp)x->op) || isAllocation((IrOp)y->op)) {
+        // The function's own allocations are only reached through what it loads once it stores them somewhere.
+        const IrOp other = (IrOp)(isAllocation((IrOp)x->op) ? y->op : x->op);
+        return isAllocation(other) || other == IR_GLOBAL || other == IR_PARAM;
+    }
+    return x->op == IR_GLOBAL && y->op == IR_GLOBAL && (x->a != y->a || x->b != y->b);
+}
+
+// Whether accesses a and b, one of them a store, can be to the same memory in different iterations.
+static bool dependent(const Loop *loop, const Access *a, const Access *b) {
+    if (a->root != b->root) {
+        return !distinctRoots(loop->function, a->root, b->root);
+    }
+    return a->base == IR_NONE || a->base != b->base || a->index != loop->counter || b->index != loop->counter;
+}
+
+// Why memory keeps the loop's iterations in order, nullptr if it doesn't.
+static const char *memoryOrder(const Loop *loop) {
+    const IrFunction *function = loop->function;
+    int count = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        for (int i = 0; i < function->blocks[b].count && loop->inLoop[b]; ++i) {
+            const IrOp op = (IrOp)irInst(function, function->blocks[b].insts[i])->op;
+            if (op == IR_NEW || op == IR_DELETE || op == IR_REGION_NEW || op == IR_REGION_DELETE) {
+                return "it allocates or frees memory";
+            }
+            count += op == IR_LOAD || op == IR_STORE;
+        }
+    }
+
+    Access *accesses = (Access *)malloc(sizeof(Access) * (count + 1));
+    count = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        for (int i = 0; i < function->blocks[b].count && loop->inLoop[b]; ++i) {
+            const IrInst *inst = irInst(function, function->blocks[b].insts[i]);
+            if (inst->op == IR_LOAD || inst->op == IR_STORE) {
+                accesses[count++] = accessOf(function, inst->a, inst->op == IR_STORE);
+            }
+        }
+    }
+
+    const char *reason = nullptr;
+    for (int i = 0; i < count && reason == nullptr; ++i) {
+        for (int j = i; j < count; ++j) {
+            if ((accesses[i].store || accesses[j].store) && dependent(loop, &accesses[i], &accesses[j])) {
+                reason = "an iteration may use memory another one writes";
+                break;
+            }
+        }
+    }
+    free(accesses);
+    return reason;
+}
+
+typedef struct {
+    IrValue value;
+    int uses;
+} Uses;
+
+static void countUse(IrFunction *function, IrValue *operand, void *context) {
+    (void)function;
+    Uses *uses = (Uses *)context;
+    uses->uses += *operand == uses->value;
+}
+
+// Whether the header phi is a reduction, only ever combined with something else by an op that doesn't care about
+// the order.
+static bool isReduction(const Loop *loop, const IrValue phi) {
+    IrFunction *function = loop->function;
+    int count;
+    const uint32_t *operands = irList(function, irInst(function, phi)->a, &count);
+    const IrInst *next = irInst(function, operands[count - 1]);
+    const bool reduces = (next->op == IR_ADD || next->op == IR_MUL || next->op == IR_AND || next->op == IR_OR ||
+                          next->op == IR_XOR) &&
+                         (next->a == phi || next->b == phi);
+    if (!reduces) {
+        return false;
+    }
+
+    Uses uses = {phi, 0};
+    for (int b = 0; b < function->blockCount; ++b) {
+        for (int i = 0; i < function->blocks[b].count && loop->inLoop[b]; ++i) {
+            if (function->blocks[b].insts[i] != phi) {
+                irForEachOperand(function, function->blocks[b].insts[i], countUse, &uses);
+            }
+        }
+    }
+    return uses.uses == 1;
+}
+
+// Why values carry over from one iteration to the next, nullptr if only reductions do.
+static const char *carriedValues(const Loop *loop) {
+    const IrFunction *function = loop->function;
+    const IrBlockData *header = &function->blocks[loop->header];
+    for (int i = 0; i < header->count; ++i) {
+        const IrValue value = header->insts[i];
+        const IrInst *phi = irInst(function, value);
+        if (phi->op != IR_PHI || value == loop->counter) {
+            continue;
+        }
+
+        if (!isReduction(loop, value)) {
+            return "a value carries over from one iteration to the next";
+        }
+        if (!irIsInteger(phi->type)) {
+            return "it adds up floats in an order vectorizing would change";
+        }
+    }
+
+    return nullptr;
+}
+
+// Why the innermost loop can't vectorize in buf, nullptr if it can.
+static const char *blocker(const Loop *loop, char *buf, const size_t size) {
+    const IrFunction *function = loop->function;
+    for (int b = 0; b < function->blockCount; ++b) {
+        for (int i = 0; i < function->blocks[b].count && loop->inLoop[b]; ++i) {
+            const IrValue value = function->blocks[b].insts[i];
+            if (irInst(function, value)->op != IR_CALL) {
+                continue;
+            }
+
+            const int callee = irCalledFunction(function, value);
+            if (callee < 0) {
+                return "it makes a call";
+            }
+            char name[256];
+            irFunctionName(loop->module, loop->module->functions[callee], name, sizeof(name));
+            snprintf(buf, size, "it calls %s", name);
+            return buf;
+        }
+    }
+
+    if (loop->counter == IR_NONE) {
+        return "its trip count isn't known before it starts";
+    }
+    bool breaks;
+    const char *reason = earlyExit(loop, &breaks);
+    if (reason == nullptr) {
+        reason = memoryOrder(loop);
+    }
+    if (reason == nullptr) {
+        reason = carriedValues(loop);
+    }
+    return reason;
+}
+
+// Hoists out of and marks the loops of one function, returns how many instructions were hoisted and loops marked.
+static int optimizeFunction(IrModule *module, const int f) {
+    IrFunction *function = module->functions[f];
+    const int blockCount = function->blockCount;
+    IrBlock *order = (IrBlock *)malloc(sizeof(IrBlock) * (blockCount + 1));
+    const int count = irPostorder(function, order);
+    bool *inLoop = (bool *)calloc(blockCount + 1, sizeof(bool));
+
+    // Headers by the size of their loop, smallest first, so loops come before the loops around them.
+    IrBlock *headers = (IrBlock *)malloc(sizeof(IrBlock) * (count + 1));
+    int *sizes = (int *)malloc(sizeof(int) * (count + 1));
+    int headerCount = 0;
+    for (int o = 0; o < count; ++o) {
+        if (function->blocks[order[o]].kind != BLOCK_LOOP) {
+            continue;
+        }
+
+        const int size = irLoopBlocks(function, order[o], inLoop);
+        int at = headerCount++;
+        for (; at > 0 && sizes[at - 1] > size; --at) {
+            headers[at] = headers[at - 1];
+            sizes[at] = sizes[at - 1];
+        }
+        headers[at] = order[o];
+        sizes[at] = size;
+    }
+
+    int changes = 0;
+    for (int h = 0; h < headerCount; ++h) {
+        irLoopBlocks(function, headers[h], inLoop);
+        Loop loop = {module, function, inLoop, headers[h], IR_NO_BLOCK, IR_NONE};
+        IrBlockData *header = &function->blocks[headers[h]];
+        const IrBlock entry = header->preds[0];
+        if (header->predCount == 2 && !inLoop[entry] &&
+            irInst(function, irTerminator(function, entry))->op == IR_JUMP) {
+            loop.preheader = entry;
+            changes += hoistInvariants(&loop, order, count);
+        }
+        loop.counter = findCounter(&loop);
+
+        bool innermost = true;
+        for (int other = 0; other < headerCount; ++other) {
+            innermost = innermost && (other == h || !inLoop[headers[other]]);
+        }
+
+        bool breaks;
+        earlyExit(&loop, &breaks);
+        header->hints = loop.counter != IR_NONE && !breaks ? LOOP_COUNTED : 0;
+        char buf[300];
+        const char *reason = innermost ? blocker(&loop, buf, sizeof(buf)) : "it has a loop inside";
+        const uint32_t offset = irInst(function, irTerminator(function, headers[h]))->offset;
+        if (reason == nullptr) {
+            header->hints |= LOOP_INDEPENDENT;
+            addIrRemark(module, "loops", f, offset, "loop can vectorize");
+            ++changes;
+        } else {
+            addIrRemark(module, "loops", f, offset, "loop can't vectorize, %s", reason);
+        }
+    }
+
+    free(sizes);
+    free(headers);
+    free(inLoop);
+    free(order);
+    return changes;
+}
+
+int optimizeLoops(IrModule *module, StrBuffer *errors) {
+    (void)errors;
+
+    int changes = 0;
+    for (int f = 0; f < module->functionCount; ++f) {
+        if (module->functions[f]->blockCount > 0) {
+            changes += optimizeFunction(module, f);
+        }
+    }
+
+    return changes;
+}
@@ -0,0 +1,2340 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "lower.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostic.h"
+#include "lexer.h"
+#include "util/array.h"
+#include "util/hash.h"
+#include "util/thread.h"
+#include "util/timer.h"
+
+// How a method gets the struct it is called on.
+typedef enum {
+    RECEIVER_NONE,    // Functions.
+    RECEIVER_VALUE,   // As its first argument, md add[foo: Foo].
+    RECEIVER_POINTER, // As its first argument, md add[foo: ^Foo].
+    RECEIVER_HIDDEN,  // As an argument its declaration doesn't name, this: ^Foo, for methods using fields by name.
+} Receiver;
+
+typedef struct {
+    Receiver receiver;
+    TypeId receiverType; // The struct of methods, TYPE_ID_NONE if it isn't known.
+    NodeIndex node;
+} LoweredFunction;
+
+typedef struct {
+    ParseResults *results;
+    TypeId *types; // The program's nodeTypes of the file.
+    Symbol *addressed; // Names whose address is taken somewhere in the file, sorted.
+    int addressedCount;
+    const ConstantTable *constants; // Values of the file's constant declarations, by value node.
+} LoweredFile;
+
+typedef struct {
+    IrModule *module;
+    Program *program;
+    CompilerConfig *config;
+    TypeTable *types;
+    LoweredFile *files;
+
+    // Index of each file by its results, open addressing on the pointer.
+    const ParseResults **fileKeys;
+    int *fileIndices;
+    uint32_t fileMask;
+
+    LoweredFunction *functions; // Of each function of the module, by index.
+
+    Symbol len;
+    Symbol main;
+    Symbol this;
+} Lowering;
+
+typedef struct {
+    Symbol name;
+    TypeId type;
+    IrValue slot; // Address of its stack slot, IR_NONE for locals in SSA form.
+} Variable;
+
+typedef struct {
+    uint64_t key; // Block and variable, 0 for an empty slot.
+    IrValue value;
+} Definition;
+
+typedef struct {
+    IrBlock block;
+    int variable;
+    IrValue phi;
+} IncompletePhi;
+
+typedef struct {
+    IrBlock exit;
+    IrBlock latch; // Where continue goes, the step of for loops.
+    int deferredCount; // Deferred before the loop, break and continue run the rest.
+} Loop;
+
+typedef struct {
+    int bindingCount;
+    int deferredCount;
+} Scope;
+
+// One function body, lowered by one task.
+typedef struct {
+    Lowering *lowering;
+    TypeTable *types;
+    IrFunction *function;
+    int index;
+
+    // The file whose nodes are lowered, the callee's while lowering one of its default arguments.
+    const LoweredFile *file;
+    const Ast *ast;
+    const TypeId *nodeTypes;
+    uint32_t offset; // Of the call whose default arguments are lowered, UINT32_MAX for nodes of the function's file.
+
+    Receiver receiver;
+    TypeId receiverType;
+    int receiverVariable; // -1 without one.
+    Symbol impl; // The type of methods, SYMBOL_NONE for functions.
+
+    IrBlock current;
+    int entryCount; // Parameters and stack slots at the top of the entry block, new slots go after them.
+
+    Variable *variables;
+    int variableCount;
+    int variableCapacity;
+
+    int *bindings; // Variables in scope, innermost last.
+    int bindingCount;
+    int bindingCapacity;
+
+    // Value of each local in SSA form at the end of each block it is written or read in, open addressing.
+    Definition *definitions;
+    uint32_t definitionMask;
+    uint32_t definitionCount;
+
+    // Blocks whose predecessors are all known. Reading a local in one that isn't leaves an incomplete phi behind, its
+    // operands are read once the block is sealed.
+    bool *sealed;
+    int sealedCapacity;
+    IncompletePhi *incomplete;
+    int incompleteCount;
+    int incompleteCapacity;
+
+    NodeIndex *deferred; // Statements of the scopes being lowered, outermost first.
+    int deferredCount;
+    int deferredCapacity;
+
+    Loop *loops;
+    int loopCount;
+    int loopCapacity;
+
+    TypeId *returns;
+    int returnCount;
+
+    DiagnosticBuffer diagnostics; // Values it can't give a type, added to the function's file once every body is done.
+    uint64_t ns;
+} FunctionLower;
+
+static uint32_t pointerHash(const void *pointer) {
+    const uintptr_t key = (uintptr_t)pointer;
+    return (uint32_t)hash_bytes((const char *)&key, sizeof(key));
+}
+
+static const LoweredFile *fileOf(const Lowering *lowering, const ParseResults *results) {
+    for (uint32_t at = pointerHash(results) & lowering->fileMask;; at = (at + 1) & lowering->fileMask) {
+        if (lowering->fileKeys[at] == results) {
+            return &lowering->files[lowering->fileIndices[at]];
+        }
+    }
+}
+
+static int compareSymbols(const void *x, const void *y) {
+    const Symbol a = *(const Symbol *)x;
+    const Symbol b = *(const Symbol *)y;
+    return a < b ? -1 : a > b;
+}
+
+static uint32_t signatureOf(const Ast *ast, const NodeIndex function) {
+    return ast->data[ast->data[function].a].b;
+}
+
+// Types.
+
+static TypeForm formOf(const TypeTable *types, const TypeId type) {
+    return type == TYPE_ID_NONE ? FORM_NAMED : typeOf(types, type)->form;
+}
+
+static bool isFloat(const TypeTable *types, const TypeId type) {
+    if (formOf(types, type) != FORM_PRIMITIVE) {
+        return false;
+    }
+
+    const TypeKind kind = (TypeKind)typeOf(types, type)->a;
+    return kind >= TYPE_F16 && kind <= TYPE_F128;
+}
+
+static bool isNumeric(const TypeTable *types, const TypeId type) {
+    return irIsInteger(type) || isFloat(types, type) || type == primitiveType(TYPE_CHAR);
+}
+
+// Type of the elements of slices, arrays and the like, TYPE_ID_NONE for anything else.
+static TypeId elementOf(const TypeTable *types, const TypeId type) {
+    switch (formOf(types, type)) {
+        case FORM_MANY_POINTER:
+        case FORM_SLICE:
+        case FORM_ARRAY:
+        case FORM_VARIADIC:
+            return typeOf(types, type)->a;
+        default:
+            return TYPE_ID_NONE;
+    }
+}
+
+static TypeId pointerTo(TypeTable *types, const TypeId type) {
+    return type != TYPE_ID_NONE ? pointerType(types, type) : TYPE_ID_NONE;
+}
+
+static TypeId pointee(const TypeTable *types, const TypeId type) {
+    return formOf(types, type) == FORM_POINTER ? typeOf(types, type)->a : TYPE_ID_NONE;
+}
+
+static const Declaration *findStruct(const Lowering *lowering, const Symbol namespace, const Symbol name) {
+    for (const Declaration *decl = lookupSymbol(lowering->program->symbols, namespace, name); decl != nullptr;
+         decl = decl->next) {
+        if (decl->kind == DECL_STRUCT) {
+            return decl;
+        }
+    }
+
+    return nullptr;
+}
+
+// The struct declaration of a value of type, through one pointer. nullptr for anything else.
+static const Declaration *structOf(const Lowering *lowering, TypeId type) {
+    const TypeTable *types = lowering->types;
+    if (formOf(types, type) == FORM_POINTER) {
+        type = typeOf(types, type)->a;
+    }
+    if (type != TYPE_ID_NONE && typeOf(types, type)->form == FORM_GENERIC) {
+        type = typeOf(types, type)->a;
+    }
+    if (type == TYPE_ID_NONE || typeOf(types, type)->form != FORM_NAMED) {
+        return nullptr;
+    }
+
+    return findStruct(lowering, typeOf(types, type)->b, typeOf(types, type)->a);
+}
+
+static int typeParameterCount(const Ast *ast, const NodeIndex structNode) {
+    return (int)ast->extra[ast->extra[ast->data[structNode].b + 1]];
+}
+
+// Whether the struct has the field name, and its type if it is known.
+static bool findField(const Lowering *lowering, const Declaration *structDecl, const Symbol name, TypeId *type) {
+    const Ast *ast = &structDecl->file->ast;
+    int fieldCount;
+    const uint32_t *fields = astList(ast, ast->extra[ast->data[structDecl->node].b], &fieldCount);
+    for (int i = 0; i < fieldCount; ++i) {
+        if (astSymbol(ast, ast->data[fields[i]].a) == name) {
+            *type = fileOf(lowering, structDecl->file)->types[fields[i]];
+            return true;
+        }
+    }
+
+    *type = TYPE_ID_NONE;
+    return false;
+}
+
+// Instructions and blocks.
+
+static TypeId nodeType(const FunctionLower *lower, const NodeIndex node) {
+    return lower->nodeTypes[node];
+}
+
+static TypeId valueType(const FunctionLower *lower, const IrValue value) {
+    return lower->function->insts[value].type;
+}
+
+static uint32_t offsetOf(const FunctionLower *lower, const NodeIndex node) {
+    return lower->offset != UINT32_MAX ? lower->offset : lower->ast->offsets[node];
+}
+
+static void seal(FunctionLower *lower, IrBlock block);
+
+static IrBlock newBlock(FunctionLower *lower, const IrBlockKind kind) {
+    const IrBlock block = addIrBlock(lower->function, kind);
+    while ((int)block >= lower->sealedCapacity) {
+        const int old = lower->sealedCapacity;
+        lower->sealed = (bool *)array_grow(lower->sealed, &lower->sealedCapacity, sizeof(bool));
+        memset(lower->sealed + old, 0, sizeof(bool) * (lower->sealedCapacity - old));
+    }
+
+    return block;
+}
+
+static bool isOpen(const FunctionLower *lower) {
+    return irTerminator(lower->function, lower->current) == IR_NONE;
+}
+
+// The block to add instructions to. Code after a return or a break goes in a block nothing jumps to.
+static IrBlock openBlock(FunctionLower *lower) {
+    if (!isOpen(lower)) {
+        lower->current = newBlock(lower, BLOCK_PLAIN);
+        seal(lower, lower->current);
+    }
+
+    return lower->current;
+}
+
+// Continues in block, whose predecessors are all added.
+static void enter(FunctionLower *lower, const IrBlock block) {
+    seal(lower, block);
+    lower->current = block;
+}
+
+static void findUntyped(IrFunction *function, IrValue *operand, void *context) {
+    const IrInst *inst = irInst(function, *operand);
+    *(bool *)context |= inst->type == TYPE_ID_NONE && irNeedsType((IrOp)inst->op);
+}
+
+// Reports value if it needs a type it doesn't have, unless one of its operands doesn't have one either and was
+// reported already.
+static IrValue requireType(FunctionLower *lower, const IrValue value, const NodeIndex node) {
+    const IrInst *inst = irInst(lower->function, value);
+    bool operand = false;
+    if (inst->type != TYPE_ID_NONE || !irNeedsType((IrOp)inst->op)) {
+        return value;
+    }
+
+    irForEachOperand(lower->function, value, findUntyped, &operand);
+    if (!operand) {
+        reportDiagnostic(&lower->diagnostics, nullptr, SEVERITY_ERROR, DIAG_UNKNOWN_TYPE, offsetOf(lower, node), 0);
+    }
+    return value;
+}
+
+static IrValue emit(FunctionLower *lower, const IrOp op, const TypeId type, const uint32_t a, const uint32_t b,
+                    const NodeIndex node) {
+    return requireType(lower, addIrInst(lower->function, openBlock(lower), op, type, a, b, offsetOf(lower, node)),
+                       node);
+}
+
+static IrValue emitInt(FunctionLower *lower, const TypeId type, const int64_t value, const NodeIndex node) {
+    return addIrInt(lower->function, openBlock(lower), type, value, offsetOf(lower, node));
+}
+
+static IrValue emitFloat(FunctionLower *lower, const TypeId type, const double value, const NodeIndex node) {
+    uint32_t words[2];
+    memcpy(words, &value, sizeof(words));
+    return emit(lower, IR_FLOAT, type, addIrExtra(lower->function, words, 2), 0, node);
+}
+
+// The literal of a value known at compile time, IR_NONE if it isn't of type.
+static IrValue emitConstant(FunctionLower *lower, const Constant *value, const TypeId type, const NodeIndex node) {
+    if (value == nullptr || type != primitiveType(value->type)) {
+        return IR_NONE;
+    }
+
+    const IrBlock block = openBlock(lower);
+    return insertIrConstant(lower->function, block, lower->function->blocks[block].count, value, offsetOf(lower, node));
+}
+
+static IrValue emitBool(FunctionLower *lower, const bool value, const NodeIndex node) {
+    return emit(lower, IR_BOOL, primitiveType(TYPE_B32), value, 0, node);
+}
+
+static IrValue emitUndef(FunctionLower *lower, const TypeId type, const NodeIndex node) {
+    return emit(lower, IR_UNDEF, type, 0, 0, node);
+}
+
+// Plain integer + - * are checked for overflow, their wrapping and saturating forms aren't. / and % check their
+// divisor isn't 0 first, and overflow after in signed types, where MIN / -1 doesn't fit.
+static IrValue emitArithmetic(FunctionLower *lower, const IrOp op, const TypeId type, const IrValue left,
+                              const IrValue right, const bool checked, const NodeIndex node) {
+    const bool integer = checked && irIsInteger(type);
+    const bool division = op == IR_DIV || op == IR_MOD;
+    if (integer && division) {
+        emit(lower, IR_CHECK_DIVISOR, TYPE_ID_NONE, right, 0, node);
+    }
+    const IrValue value = emit(lower, op, type, left, right, node);
+    if (integer && (op == IR_ADD || op == IR_SUB || op == IR_MUL || (division && irIsSigned(type)))) {
+        emit(lower, IR_CHECK_OVERFLOW, TYPE_ID_NONE, value, 0, node);
+    }
+
+    return value;
+}
+
+static void jump(FunctionLower *lower, const IrBlock target, const NodeIndex node) {
+    const IrBlock from = openBlock(lower);
+    emit(lower, IR_JUMP, TYPE_ID_NONE, target, 0, node);
+    addIrEdge(lower->function, from, target);
+}
+
+static void branch(FunctionLower *lower, const IrValue condition, const IrBlock then, const IrBlock otherwise,
+                   const NodeIndex node) {
+    const IrBlock from = openBlock(lower);
+    const uint32_t targets[2] = {then, otherwise};
+    emit(lower, IR_BRANCH, TYPE_ID_NONE, condition, addIrExtra(lower->function, targets, 2), node);
+    addIrEdge(lower->function, from, then);
+    addIrEdge(lower->function, from, otherwise);
+}
+
+// A stack slot for a value of type, at the top of the entry block so it is made once per call. value is what it is
+// made to hold, IR_NONE if nothing yet, and the slot isn't reported for lacking a type if value was already.
+static IrValue addSlot(FunctionLower *lower, const TypeId type, IrValue value, const NodeIndex node) {
+    const IrValue slot = insertIrInst(lower->function, 0, lower->entryCount++, IR_ALLOC, pointerTo(lower->types, type),
+                                      0, 0, offsetOf(lower, node));
+    bool reported = false;
+    if (value != IR_NONE) {
+        findUntyped(lower->function, &value, &reported);
+    }
+    return reported ? slot : requireType(lower, slot, node);
+}
+
+// Stores value in a new stack slot, for values used where an address is wanted.
+static IrValue spill(FunctionLower *lower, const IrValue value, const NodeIndex node) {
+    const IrValue slot = addSlot(lower, valueType(lower, value), value, node);
+    emit(lower, IR_STORE, TYPE_ID_NONE, slot, value, node);
+    return slot;
+}
+
+// SSA construction, after Braun et al., Simple and Efficient Construction of Static Single Assignment Form.
+
+static uint32_t definitionHash(const uint64_t key) {
+    return (uint32_t)hash_bytes((const char *)&key, sizeof(key));
+}
+
+static void writeVariable(FunctionLower *lower, const int variable, const IrBlock block, const IrValue value) {
+    if ((lower->definitionCount + 1) * 4 > (lower->definitionMask + 1) * 3) {
+        const uint32_t mask = lower->definitionMask * 2 + 1;
+        Definition *definitions = (Definition *)calloc(mask + 1, sizeof(Definition));
+        for (uint32_t i = 0; i <= lower->definitionMask; ++i) {
+            if (lower->definitions[i].key == 0) {
+                continue;
+            }
+
+            uint32_t at = definitionHash(lower->definitions[i].key) & mask;
+            while (definitions[at].key != 0) {
+                at = (at + 1) & mask;
+            }
+            definitions[at] = lower->definitions[i];
+        }
+        free(lower->definitions);
+        lower->definitions = definitions;
+        lower->definitionMask = mask;
+    }
+
+    const uint64_t key = ((uint64_t)block << 32 | (uint32_t)variable) + 1;
+    uint32_t at = definitionHash(key) & lower->definitionMask;
+    while (lower->definitions[at].key != 0 && lower->definitions[at].key != key) {
+        at = (at + 1) & lower->definitionMask;
+    }
+    if (lower->definitions[at].key == 0) {
+        ++lower->definitionCount;
+    }
+    lower->definitions[at] = (Definition){key, value};
+}
+
+static IrValue findDefinition(const FunctionLower *lower, const int variable, const IrBlock block) {
+    const uint64_t key = ((uint64_t)block << 32 | (uint32_t)variable) + 1;
+    for (uint32_t at = definitionHash(key) & lower->definitionMask; lower->definitions[at].key != 0;
+         at = (at + 1) & lower->definitionMask) {
+        if (lower->definitions[at].key == key) {
+            return lower->definitions[at].value;
+        }
+    }
+
+    return IR_NONE;
+}
+
+static IrValue readVariable(FunctionLower *lower, int variable, IrBlock block);
+
+static void addPhiOperands(FunctionLower *lower, const int variable, const IrBlock block, const IrValue phi) {
+    const int count = lower->function->blocks[block].predCount;
+    IrValue small[8] = {IR_NONE};
+    IrValue *operands = count <= 8 ? small : (IrValue *)malloc(sizeof(IrValue) * count);
+    for (int i = 0; i < count; ++i) {
+        operands[i] = readVariable(lower, variable, lower->function->blocks[block].preds[i]);
+    }
+    lower->function->insts[phi].a = addIrList(lower->function, operands, count);
+    if (operands != small) {
+        free(operands);
+    }
+}
+
+static IrValue readVariable(FunctionLower *lower, const int variable, const IrBlock block) {
+    const IrValue found = findDefinition(lower, variable, block);
+    if (found != IR_NONE) {
+        return found;
+    }
+
+    IrFunction *function = lower->function;
+    const TypeId type = lower->variables[variable].type;
+    IrValue value;
+    if (!lower->sealed[block]) {
+        value = insertIrInst(function, block, 0, IR_PHI, type, 0, 0, 0);
+        if (lower->incompleteCount == lower->incompleteCapacity) {
+            lower->incomplete = (IncompletePhi *)array_grow(lower->incomplete, &lower->incompleteCapacity,
+                                                            sizeof(IncompletePhi));
+        }
+        lower->incomplete[lower->incompleteCount++] = (IncompletePhi){block, variable, value};
+    } else if (function->blocks[block].predCount == 1) {
+        value = readVariable(lower, variable, function->blocks[block].preds[0]);
+    } else if (function->blocks[block].predCount == 0) {
+        // Read before it is written, or in code nothing reaches.
+        value = insertIrInst(function, block, 0, IR_UNDEF, type, 0, 0, 0);
+        lower->entryCount += block == 0;
+    } else {
+        // Written before its operands are read, so a loop back to the block finds the phi instead of another.
+        value = insertIrInst(function, block, 0, IR_PHI, type, 0, 0, 0);
+        writeVariable(lower, variable, block, value);
+        addPhiOperands(lower, variable, block, value);
+    }
+
+    writeVariable(lower, variable, block, value);
+    return value;
+}
+
+static void seal(FunctionLower *lower, const IrBlock block) {
+    if (lower->sealed[block]) {
+        return;
+    }
+
+    lower->sealed[block] = true;
+    for (int i = 0; i < lower->incompleteCount;) {
+        const IncompletePhi phi = lower->incomplete[i];
+        if (phi.block != block) {
+            ++i;
+            continue;
+        }
+
+        lower->incomplete[i] = lower->incomplete[--lower->incompleteCount];
+        addPhiOperands(lower, phi.variable, phi.block, phi.phi);
+    }
+}
+
+// Locals and scopes.
+
+// A local in SSA form, in scope from now on.
+static int addVariable(FunctionLower *lower, const Symbol name, const TypeId type) {
+    if (lower->variableCount == lower->variableCapacity) {
+        lower->variables = (Variable *)array_grow(lower->variables, &lower->variableCapacity, sizeof(Variable));
+    }
+    const int variable = lower->variableCount++;
+    lower->variables[variable] = (Variable){name, type, IR_NONE};
+
+    if (lower->bindingCount == lower->bindingCapacity) {
+        lower->bindings = (int *)array_grow(lower->bindings, &lower->bindingCapacity, sizeof(int));
+    }
+    lower->bindings[lower->bindingCount++] = variable;
+
+    return variable;
+}
+
+static bool isAddressed(const FunctionLower *lower, const Symbol name) {
+    return lower->file->addressedCount > 0 &&
+           bsearch(&name, lower->file->addressed, lower->file->addressedCount, sizeof(Symbol), compareSymbols) !=
+           nullptr;
+}
+
+// Declares a local holding value, in a stack slot if it needs an address or its type can't be a plain value.
+static int bindVariable(FunctionLower *lower, const Symbol name, TypeId type, const IrValue value,
+                        const NodeIndex node) {
+    if (type == TYPE_ID_NONE && value != IR_NONE) {
+        type = valueType(lower, value);
+    }
+
+    const int variable = addVariable(lower, name, type);
+    const TypeForm form = formOf(lower->types, type);
+    if (form == FORM_NAMED || form == FORM_GENERIC || form == FORM_ARRAY || form == FORM_UNION ||
+        isAddressed(lower, name)) {
+        const IrValue slot = addSlot(lower, type, value, node);
+        lower->variables[variable].slot = slot;
+        if (value != IR_NONE) {
+            emit(lower, IR_STORE, TYPE_ID_NONE, slot, value, node);
+        }
+    } else if (value != IR_NONE) {
+        writeVariable(lower, variable, openBlock(lower), value);
+    }
+
+    return variable;
+}
+
+static int findVariable(const FunctionLower *lower, const Symbol name) {
+    for (int i = lower->bindingCount - 1; i >= 0; --i) {
+        if (lower->variables[lower->bindings[i]].name == name) {
+            return lower->bindings[i];
+        }
+    }
+
+    return -1;
+}
+
+static IrValue loadVariable(FunctionLower *lower, const int variable, const NodeIndex node) {
+    const Variable *v = &lower->variables[variable];
+    if (v->slot != IR_NONE) {
+        return emit(lower, IR_LOAD, v->type, v->slot, 0, node);
+    }
+
+    return readVariable(lower, variable, openBlock(lower));
+}
+
+static Scope openScope(const FunctionLower *lower) {
+    return (Scope){lower->bindingCount, lower->deferredCount};
+}
+
+static void lowerStatement(FunctionLower *lower, NodeIndex node);
+
+// Runs the statements deferred since from, innermost first, in a defer block on the way out of their scopes. With
+// resume the function goes on after them, else the caller ends the defer block with its own jump or return.
+static void emitDeferred(FunctionLower *lower, const int from, const bool resume, const NodeIndex node) {
+    const int count = lower->deferredCount - from;
+    if (count <= 0 || !isOpen(lower)) {
+        return;
+    }
+
+    // Deferred statements can defer statements of their own, which would be pushed over these.
+    NodeIndex small[8];
+    NodeIndex *statements = count <= 8 ? small : (NodeIndex *)malloc(sizeof(NodeIndex) * count);
+    memcpy(statements, lower->deferred + from, sizeof(NodeIndex) * count);
+
+    const IrBlock block = newBlock(lower, BLOCK_DEFER);
+    jump(lower, block, node);
+    enter(lower, block);
+
+    // While one runs only the statements deferred before it are pending, a return in one runs the rest once.
+    const int deferredCount = lower->deferredCount;
+    for (int i = count - 1; i >= 0; --i) {
+        lower->deferredCount = from + i;
+        const int bindingCount = lower->bindingCount;
+        lowerStatement(lower, statements[i]);
+        emitDeferred(lower, from + i, true, node);
+        lower->bindingCount = bindingCount;
+    }
+    lower->deferredCount = deferredCount;
+    if (statements != small) {
+        free(statements);
+    }
+
+    if (resume && isOpen(lower)) {
+        const IrBlock next = newBlock(lower, BLOCK_PLAIN);
+        jump(lower, next, node);
+        enter(lower, next);
+    }
+}
+
+static void closeScope(FunctionLower *lower, const Scope scope, const NodeIndex node) {
+    emitDeferred(lower, scope.deferredCount, true, node);
+    lower->bindingCount = scope.bindingCount;
+    lower->deferredCount = scope.deferredCount;
+}
+
+// Names.
+
+// A top level declaration name can refer to from the file: in its namespace, else outside any.
+static const Declaration *findDeclaration(const FunctionLower *lower, const Symbol name) {
+    const SymbolTable *symbols = lower->lowering->program->symbols;
+    const Declaration *found = lookupSymbol(symbols, lower->file->results->namespace, name);
+    if (found == nullptr && lower->file->results->namespace != SYMBOL_NONE) {
+        found = lookupSymbol(symbols, SYMBOL_NONE, name);
+    }
+
+    return found;
+}
+
+// The value of the global decl named name if it is a constant known at compile time, else nullptr.
+static const Constant *globalConstant(const FunctionLower *lower, const Declaration *decl, const Symbol name) {
+    if (decl == nullptr || decl->kind != DECL_VARIABLE) {
+        return nullptr;
+    }
+
+    const LoweredFile *file = fileOf(lower->lowering, decl->file);
+    const Ast *ast = &decl->file->ast;
+    const uint32_t var = ast->data[decl->node].a;
+    if (file->constants == nullptr || ast->extra[var] == VAR_LET) {
+        return nullptr;
+    }
+
+    int valueCount;
+    const uint32_t *values = astList(ast, ast->extra[var + 2], &valueCount);
+    int nameCount;
+    const uint32_t *names = astList(ast, ast->extra[var + 3], &nameCount);
+    for (int i = 0; i < nameCount && valueCount == nameCount; ++i) {
+        if (astSymbol(ast, names[i]) == name) {
+            return findConstant(file->constants, values[i]);
+        }
+    }
+
+    return nullptr;
+}
+
+static NiftyTokenType keywordOf(const FunctionLower *lower, const Symbol name) {
+    int len = 0;
+    const char *spelling = symbolName(lower->lowering->config->interner, name, &len);
+    return keywordType(spelling, len);
+}
+
+static TypeId typeOfNode(const FunctionLower *lower, const NodeIndex node) {
+    return typeFromNode(lower->types, lower->lowering->program->symbols, lower->file->results, node);
+}
+
+// A function of the module by its index when the declaration has one, else by its name.
+static IrValue functionValue(FunctionLower *lower, const Declaration *decl, const Symbol namespace, const Symbol name,
+                             const NodeIndex node) {
+    const int index = decl != nullptr && decl->next == nullptr ? irFunctionIndex(lower->lowering->module, decl) : -1;
+    if (index >= 0) {
+        return emit(lower, IR_FUNCTION, lower->lowering->module->functions[index]->type, (uint32_t)index, 0, node);
+    }
+
+    return emit(lower, IR_EXTERN, nodeType(lower, node), namespace, name, node);
+}
+
+// Address of the struct the method was called on.
+static IrValue receiverAddress(FunctionLower *lower, const NodeIndex node) {
+    const Variable *v = &lower->variables[lower->receiverVariable];
+    if (lower->receiver == RECEIVER_VALUE) {
+        return v->slot;
+    }
+
+    return loadVariable(lower, lower->receiverVariable, node);
+}
+
+// Address of a field of the receiver used by name, like _lives in md getLives(). IR_NONE if it has no such field.
+static IrValue receiverField(FunctionLower *lower, const Symbol name, const NodeIndex node) {
+    if (lower->receiverVariable < 0) {
+        return IR_NONE;
+    }
+
+    const Declaration *structDecl = findStruct(lower->lowering, lower->file->results->namespace, lower->impl);
+    TypeId type;
+    if (structDecl == nullptr || !findField(lower->lowering, structDecl, name, &type)) {
+        return IR_NONE;
+    }
+
+    return emit(lower, IR_FIELD, pointerTo(lower->types, type), receiverAddress(lower, node), name, node);
+}
+
+// Expressions.
+
+static IrValue lowerExpression(FunctionLower *lower, NodeIndex node);
+static IrValue lowerAddress(FunctionLower *lower, NodeIndex node);
+
+static bool isNumberLiteral(const Ast *ast, const NodeIndex node) {
+    const NodeKind kind = astKind(ast, node);
+    return kind == IntNodeType || kind == FloatNodeType || kind == CharNodeType;
+}
+
+// A number literal as a constant of type, or of its own type if type isn't a number. negated gives -literal, which the
+// checker knows fits where the literal itself may not, like -128 as an s8.
+static IrValue lowerNumber(FunctionLower *lower, const NodeIndex node, TypeId type, const bool negated) {
+    const Ast *ast = lower->ast;
+    const NodeData data = ast->data[node];
+    if (!isNumeric(lower->types, type)) {
+        type = nodeType(lower, node);
+    }
+
+    if (astKind(ast, node) == FloatNodeType) {
+        if (!isFloat(lower->types, type)) {
+            type = primitiveType(data.b == 32 ? TYPE_F32 : TYPE_F64);
+        }
+        uint32_t words[2] = {ast->extra[data.a], ast->extra[data.a + 1]};
+        words[1] ^= negated ? 0x80000000u : 0;
+        return emit(lower, IR_FLOAT, type, addIrExtra(lower->function, words, 2), 0, node);
+    }
+
+    uint32_t words[4] = {data.a, 0, 0, 0};
+    if (astKind(ast, node) == IntNodeType && data.b != INT_SMALL) {
+        memcpy(words, ast->extra + data.a, sizeof(words));
+    }
+    if (isFloat(lower->types, type)) {
+        const double value = (double)((uint64_t)words[1] << 32 | words[0]);
+        return emitFloat(lower, type, negated ? -value : value, node);
+    }
+
+    // Two's complement in 128 bits, what IR_INT sign extends to.
+    bool carry = negated;
+    for (int i = 0; i < 4 && negated; ++i) {
+        words[i] = ~words[i] + carry;
+        carry = carry && words[i] == 0;
+    }
+    return emit(lower, IR_INT, type, addIrExtra(lower->function, words, 4), 0, node);
+}
+
+// Lowers node where a value of type is wanted. Literals take the type, like 1 in x + 1 for a u64 x.
+static IrValue lowerAs(FunctionLower *lower, const NodeIndex node, const TypeId type) {
+    const Ast *ast = lower->ast;
+    if (isNumberLiteral(ast, node)) {
+        return lowerNumber(lower, node, type, false);
+    }
+    if (astKind(ast, node) == NegNodeType && isNumberLiteral(ast, ast->data[node].a)) {
+        return lowerNumber(lower, ast->data[node].a, type, true);
+    }
+    if (astKind(ast, node) == UndefinedNodeType || astKind(ast, node) == NullNodeType) {
+        return emit(lower, astKind(ast, node) == NullNodeType ? IR_NULL : IR_UNDEF, type, 0, 0, node);
+    }
+
+    // Any number can be given where another is expected, f64 := f32, and converts to it.
+    const IrValue value = lowerExpression(lower, node);
+    const TypeId from = valueType(lower, value);
+    if (from != type && isNumeric(lower->types, from) && isNumeric(lower->types, type)) {
+        return emit(lower, IR_CONVERT, type, value, 0, node);
+    }
+    return value;
+}
+
+// Continues in join with a phi picking values[i] on its i-th edge.
+static IrValue joinValues(FunctionLower *lower, const IrBlock join, const IrValue *values, const int count,
+                          const TypeId type, const NodeIndex node) {
+    enter(lower, join);
+    if (count == 0) {
+        return emitUndef(lower, type, node);
+    }
+    if (count == 1) {
+        return values[0];
+    }
+
+    return insertIrInst(lower->function, join, 0, IR_PHI, type, addIrList(lower->function, values, count), 0,
+                        offsetOf(lower, node));
+}
+
+// Jumps to join with the value of node when the block can still reach it.
+static void joinWith(FunctionLower *lower, const IrBlock join, IrValue *values, int *count, const IrValue value,
+                     const NodeIndex node) {
+    if (isOpen(lower)) {
+        values[(*count)++] = value;
+        jump(lower, join, node);
+    }
+}
+
+
+static IrValue lowerShortCircuit(FunctionLower *lower, const NodeIndex node, const bool isAnd) {
+    const NodeData data = lower->ast->data[node];
+    const IrValue left = lowerExpression(lower, data.a);
+    // The value when the right side is skipped, in the block that skips it.
+    const IrValue skipped = emitBool(lower, !isAnd, node);
+    const IrBlock right = newBlock(lower, BLOCK_PLAIN);
+    const IrBlock join = newBlock(lower, BLOCK_PLAIN);
+    if (isAnd) {
+        branch(lower, left, right, join, node);
+    } else {
+        branch(lower, left, join, right, node);
+    }
+
+    IrValue values[2] = {skipped, IR_NONE};
+    int count = 1;
+    enter(lower, right);
+    joinWith(lower, join, values, &count, lowerExpression(lower, data.b), node);
+    return joinValues(lower, join, values, count, primitiveType(TYPE_B32), node);
+}
+
+// The value of an optional if it has one, else what otherwise gives: an expression, or the last statement of a block.
+static IrValue lowerOrElse(FunctionLower *lower, const NodeIndex node, const NodeIndex otherwise) {
+    const Ast *ast = lower->ast;
+    const TypeId type = nodeType(lower, node);
+    const IrValue optional = lowerExpression(lower, ast->data[node].a);
+    const IrBlock some = newBlock(lower, BLOCK_PLAIN);
+    const IrBlock none = newBlock(lower, BLOCK_PLAIN);
+    const IrBlock join = newBlock(lower, BLOCK_PLAIN);
+    branch(lower, emit(lower, IR_HAS_VALUE, primitiveType(TYPE_B32), optional, 0, node), some, none, node);
+
+    IrValue values[2];
+    int count = 0;
+    enter(lower, some);
+    joinWith(lower, join, values, &count, emit(lower, IR_UNWRAP, type, optional, 0, node), node);
+
+    enter(lower, none);
+    IrValue fallback = IR_NONE;
+    if (astKind(ast, otherwise) == BlockNodeType) {
+        const Scope scope = openScope(lower);
+        int statementCount;
+        const uint32_t *statements = astList(ast, ast->data[otherwise].a, &statementCount);
+        for (int i = 0; i < statementCount; ++i) {
+            if (i == statementCount - 1 && astKind(ast, statements[i]) >= IntNodeType) {
+                fallback = lowerAs(lower, statements[i], type);
+            } else {
+                lowerStatement(lower, statements[i]);
+            }
+        }
+        closeScope(lower, scope, otherwise);
+    } else {
+        fallback = lowerAs(lower, otherwise, type);
+    }
+    if (fallback == IR_NONE && isOpen(lower)) {
+        fallback = emitUndef(lower, type, node);
+    }
+    joinWith(lower, join, values, &count, fallback, node);
+
+    return joinValues(lower, join, values, count, type, node);
+}
+
+static IrValue lowerTernary(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const NodeData data = ast->data[node];
+    const TypeId type = nodeType(lower, node);
+    const IrValue condition = lowerExpression(lower, data.a);
+    const IrBlock then = newBlock(lower, BLOCK_PLAIN);
+    const IrBlock otherwise = newBlock(lower, BLOCK_PLAIN);
+    const IrBlock join = newBlock(lower, BLOCK_PLAIN);
+    branch(lower, condition, then, otherwise, node);
+
+    IrValue values[2];
+    int count = 0;
+    enter(lower, then);
+    joinWith(lower, join, values, &count, lowerAs(lower, ast->extra[data.b], type), node);
+    enter(lower, otherwise);
+    joinWith(lower, join, values, &count, lowerAs(lower, ast->extra[data.b + 1], type), node);
+
+    return joinValues(lower, join, values, count, type, node);
+}
+
+static IrOp binaryOp(const NodeKind kind) {
+    switch (kind) {
+        case AddNodeType: case AddWrapNodeType: return IR_ADD;
+        case SubNodeType: case SubWrapNodeType: return IR_SUB;
+        case MulNodeType: case MulWrapNodeType: return IR_MUL;
+        case DivNodeType: return IR_DIV;
+        case ModNodeType: return IR_MOD;
+        case AddSatNodeType: return IR_ADD_SAT;
+        case SubSatNodeType: return IR_SUB_SAT;
+        case MulSatNodeType: return IR_MUL_SAT;
+        case ShlSatNodeType: return IR_SHL_SAT;
+        case ShlNodeType: return IR_SHL;
+        case ShrNodeType: return IR_SHR;
+        case BitAndNodeType: return IR_AND;
+        case BitOrNodeType: return IR_OR;
+        case BitXorNodeType: return IR_XOR;
+        case EqNodeType: return IR_EQ;
+        case NotEqNodeType: return IR_NE;
+        case LtNodeType: return IR_LT;
+        case LtEqNodeType: return IR_LE;
+        case GtNodeType: return IR_GT;
+        case GtEqNodeType: return IR_GE;
+        default: return IR_REMOVED;
+    }
+}
+
+// The type both sides of a binary node are taken at, the type of the side that isn't a literal.
+static TypeId operandType(const FunctionLower *lower, const NodeIndex left, const NodeIndex right) {
+    const TypeId leftType = nodeType(lower, left);
+    const TypeId rightType = nodeType(lower, right);
+    if (leftType != TYPE_ID_NONE && !isNumberLiteral(lower->ast, left)) {
+        return leftType;
+    }
+    if (rightType != TYPE_ID_NONE && !isNumberLiteral(lower->ast, right)) {
+        return rightType;
+    }
+
+    return leftType != TYPE_ID_NONE ? leftType : rightType;
+}
+
+// The operator kind applied to left and the value of right, for binary nodes and compound assignments.
+static IrValue lowerOperation(FunctionLower *lower, const NodeKind kind, const IrValue left, const NodeIndex right,
+                              TypeId type, const NodeIndex node) {
+    const IrOp op = binaryOp(kind);
+    if (type == TYPE_ID_NONE) {
+        type = valueType(lower, left);
+    }
+
+    // Shift amounts keep their own type, x << cast(n, u8).
+    const bool shift = op == IR_SHL || op == IR_SHR || op == IR_SHL_SAT;
+    const IrValue value = shift ? lowerExpression(lower, right) : lowerAs(lower, right, valueType(lower, left));
+    if (op == IR_REMOVED) {
+        return emitUndef(lower, type, node);
+    }
+    if (op >= IR_EQ && op <= IR_GE) {
+        return emit(lower, op, primitiveType(TYPE_B32), left, value, node);
+    }
+
+    const bool checked = kind == AddNodeType || kind == SubNodeType || kind == MulNodeType || kind == DivNodeType ||
+                         kind == ModNodeType;
+    return emitArithmetic(lower, op, type, left, value, checked, node);
+}
+
+static IrValue lowerBinary(FunctionLower *lower, const NodeIndex node) {
+    const NodeKind kind = astKind(lower->ast, node);
+    const NodeData data = lower->ast->data[node];
+    switch (kind) {
+        case AndNodeType:
+            return lowerShortCircuit(lower, node, true);
+        case OrNodeType:
+            return lowerShortCircuit(lower, node, false);
+        case NullCoalesceNodeType:
+            return lowerOrElse(lower, node, data.b);
+        case RangeOpenNodeType:
+        case RangeClosedNodeType:
+            // Ranges are only iterated over so far, see lowerForIn.
+            lowerExpression(lower, data.a);
+            lowerExpression(lower, data.b);
+            return emitUndef(lower, nodeType(lower, node), node);
+        default:
+            break;
+    }
+
+    const TypeId operands = operandType(lower, data.a, data.b);
+    const TypeId type = nodeType(lower, node) != TYPE_ID_NONE ? nodeType(lower, node) : operands;
+    const bool shift = kind == ShlNodeType || kind == ShrNodeType || kind == ShlSatNodeType;
+    const IrValue left = lowerAs(lower, data.a, shift ? type : operands);
+    return lowerOperation(lower, kind, left, data.b, type, node);
+}
+
+// Where an assignment stores: a local in SSA form, or an address.
+typedef struct {
+    int variable;
+    IrValue address;
+    TypeId type;
+} Place;
+
+static Place lowerPlace(FunctionLower *lower, const NodeIndex node) {
+    if (astKind(lower->ast, node) == IdentNodeType) {
+        const int variable = findVariable(lower, astSymbol(lower->ast, lower->ast->data[node].a));
+        if (variable >= 0 && lower->variables[variable].slot == IR_NONE) {
+            return (Place){variable, IR_NONE, lower->variables[variable].type};
+        }
+    }
+
+    const IrValue address = lowerAddress(lower, node);
+    const TypeId type = nodeType(lower, node);
+    return (Place){-1, address, type != TYPE_ID_NONE ? type : pointee(lower->types, valueType(lower, address))};
+}
+
+static IrValue loadPlace(FunctionLower *lower, const Place *place, const NodeIndex node) {
+    if (place->variable >= 0) {
+        return readVariable(lower, place->variable, openBlock(lower));
+    }
+
+    return emit(lower, IR_LOAD, place->type, place->address, 0, node);
+}
+
+static void storePlace(FunctionLower *lower, const Place *place, const IrValue value, const NodeIndex node) {
+    if (place->variable >= 0) {
+        writeVariable(lower, place->variable, openBlock(lower), value);
+    } else {
+        emit(lower, IR_STORE, TYPE_ID_NONE, place->address, value, node);
+    }
+}
+
+static IrValue lowerIncrement(FunctionLower *lower, const NodeIndex node) {
+    const NodeKind kind = astKind(lower->ast, node);
+    const Place place = lowerPlace(lower, lower->ast->data[node].a);
+    const IrValue old = loadPlace(lower, &place, node);
+    const TypeId type = place.type != TYPE_ID_NONE ? place.type : valueType(lower, old);
+    const IrValue one = isFloat(lower->types, type) ? emitFloat(lower, type, 1, node) : emitInt(lower, type, 1, node);
+    const IrOp op = kind == PreIncNodeType || kind == PostIncNodeType ? IR_ADD : IR_SUB;
+    const IrValue value = emitArithmetic(lower, op, type, old, one, true, node);
+    storePlace(lower, &place, value, node);
+
+    return kind == PreIncNodeType || kind == PreDecNodeType ? value : old;
+}
+
+// The length an index into base is checked against, IR_NONE where there is none to check against, like for [^]T.
+// Arrays are indexed at their address, everything else as a value.
+static IrValue lengthOf(FunctionLower *lower, const TypeId type, const IrValue base, const NodeIndex node) {
+    const TypeId length = primitiveType(TYPE_S32);
+    switch (formOf(lower->types, type)) {
+        case FORM_MANY_POINTER:
+            return IR_NONE;
+        case FORM_ARRAY:
+            if (typeOf(lower->types, type)->b != ARRAY_LENGTH_UNKNOWN) {
+                return emitInt(lower, length, typeOf(lower->types, type)->b, node);
+            }
+            return emit(lower, IR_LEN, length, emit(lower, IR_LOAD, type, base, 0, node), 0, node);
+        default:
+            return emit(lower, IR_LEN, length, base, 0, node);
+    }
+}
+
+// Whether values of type are indexed at their address.
+static bool indexedInPlace(const FunctionLower *lower, const TypeId type) {
+    return formOf(lower->types, type) == FORM_ARRAY;
+}
+
+// Address of the element of base at index, after checking index against the length of base.
+static IrValue lowerElement(FunctionLower *lower, const NodeIndex node) {
+    const NodeData data = lower->ast->data[node];
+    const TypeId baseType = nodeType(lower, data.a);
+    const IrValue base = indexedInPlace(lower, baseType) ? lowerAddress(lower, data.a) : lowerExpression(lower, data.a);
+    const IrValue index = lowerExpression(lower, data.b);
+    const IrValue length = lengthOf(lower, baseType, base, node);
+    if (length != IR_NONE) {
+        emit(lower, IR_CHECK_BOUNDS, TYPE_ID_NONE, index, length, node);
+    }
+
+    return emit(lower, IR_ELEMENT, pointerTo(lower->types, nodeType(lower, node)), base, index, node);
+}
+
+static IrValue lowerAddress(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const NodeData data = ast->data[node];
+    const TypeId pointer = pointerTo(lower->types, nodeType(lower, node));
+
+    switch (astKind(ast, node)) {
+        case IdentNodeType: {
+            const Symbol name = astSymbol(ast, data.a);
+            const int variable = findVariable(lower, name);
+            if (variable >= 0) {
+                const Variable *v = &lower->variables[variable];
+                return v->slot != IR_NONE ? v->slot : spill(lower, loadVariable(lower, variable, node), node);
+            }
+
+            const Declaration *decl = findDeclaration(lower, name);
+            if (decl != nullptr && decl->kind == DECL_VARIABLE) {
+                return emit(lower, IR_GLOBAL, pointer, decl->namespace, name, node);
+            }
+            if (decl == nullptr) {
+                const IrValue field = receiverField(lower, name, node);
+                if (field != IR_NONE) {
+                    return field;
+                }
+
+                // Declared nowhere, which the checker leaves to here in files using namespaces the nsl doesn't have,
+                // or in methods a field of a behavior. What uses the undef isn't reported again.
+                const char *spelling = symbolName(lower->lowering->config->interner, name, nullptr);
+                reportDiagnostic(&lower->diagnostics, nullptr, SEVERITY_ERROR,
+                                 lower->impl != SYMBOL_NONE ? DIAG_UNKNOWN_TYPE : DIAG_UNDECLARED,
+                                 offsetOf(lower, node), 0, spelling);
+                return addIrInst(lower->function, openBlock(lower), IR_UNDEF, TYPE_ID_NONE, 0, 0,
+                                 offsetOf(lower, node));
+            }
+            break;
+        }
+        case ScopeNodeType:
+            if (astKind(ast, data.a) == IdentNodeType) {
+                return emit(lower, IR_GLOBAL, pointer, astSymbol(ast, ast->data[data.a].a), astSymbol(ast, data.b),
+                            node);
+            }
+            break;
+        case MemberNodeType:
+        case PointerMemberNodeType: {
+            // Fields of pointers are fields of what they point to.
+            const TypeId base = nodeType(lower, data.a);
+            const IrValue address = astKind(ast, node) == PointerMemberNodeType || formOf(lower->types, base) ==
+                                                                                       FORM_POINTER
+                                        ? lowerExpression(lower, data.a)
+                                        : lowerAddress(lower, data.a);
+            return emit(lower, IR_FIELD, pointer, address, astSymbol(ast, data.b), node);
+        }
+        case IndexNodeType:
+            return lowerElement(lower, node);
+        case DerefNodeType:
+            return lowerExpression(lower, data.a);
+        default:
+            break;
+    }
+
+    return spill(lower, lowerExpression(lower, node), node);
+}
+
+// Calls.
+
+typedef struct {
+    IrValue value;
+    const Declaration *target; // The function of the module the call names, nullptr for anything else.
+    const LoweredFunction *lowered; // Its receiver.
+    IrValue receiver; // Passed first, IR_NONE for calls that don't name one.
+} Callee;
+
+// cast(x, T) and T(x), IR_NONE for every other call.
+static IrValue lowerConversion(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const NodeData data = ast->data[node];
+    if (astKind(ast, data.a) != IdentNodeType || findVariable(lower, astSymbol(ast, ast->data[data.a].a)) >= 0) {
+        return IR_NONE;
+    }
+
+    int argCount;
+    const uint32_t *args = astList(ast, data.b, &argCount);
+    const NiftyTokenType keyword = keywordOf(lower, astSymbol(ast, ast->data[data.a].a));
+    TypeId to;
+    if (keyword == TK_CAST && argCount == 2) {
+        to = typeOfNode(lower, args[1]);
+    } else if (keyword >= TK_INT && keyword <= TK_ANY_TYPE && argCount == 1) {
+        to = typeOfNode(lower, data.a);
+    } else {
+        return IR_NONE;
+    }
+
+    // Numbers are converted by lowerAs already.
+    const IrValue value = lowerAs(lower, args[0], to);
+    return valueType(lower, value) == to ? value : emit(lower, IR_CONVERT, to, value, 0, node);
+}
+
+// The receiver of a call of a method on base, as the method takes it.
+static IrValue lowerReceiver(FunctionLower *lower, const NodeIndex callee, const Receiver receiver) {
+    const Ast *ast = lower->ast;
+    const NodeIndex base = ast->data[callee].a;
+    const TypeId type = nodeType(lower, base);
+    const bool isPointer = astKind(ast, callee) == PointerMemberNodeType || formOf(lower->types, type) == FORM_POINTER;
+    if (receiver == RECEIVER_VALUE) {
+        const IrValue value = lowerExpression(lower, base);
+        return isPointer ? emit(lower, IR_LOAD, pointee(lower->types, type), value, 0, callee) : value;
+    }
+
+    return isPointer ? lowerExpression(lower, base) : lowerAddress(lower, base);
+}
+
+// A method name of the struct, nullptr if it has none or more than one.
+static const Declaration *findMethod(const FunctionLower *lower, const Symbol type, const Symbol name) {
+    const Declaration *decl = lookupSymbol(lower->lowering->program->symbols, type, name);
+    return decl != nullptr && decl->kind == DECL_METHOD && decl->next == nullptr ? decl : nullptr;
+}
+
+static void setTarget(const FunctionLower *lower, Callee *callee, const Declaration *decl) {
+    const int index = irFunctionIndex(lower->lowering->module, decl);
+    if (index >= 0) {
+        callee->target = decl;
+        callee->lowered = &lower->lowering->functions[index];
+    }
+}
+
+static Callee lowerCallee(FunctionLower *lower, const NodeIndex call) {
+    const Ast *ast = lower->ast;
+    const NodeIndex node = ast->data[call].a;
+    const NodeData data = ast->data[node];
+    Callee callee = {IR_NONE, nullptr, nullptr, IR_NONE};
+
+    const Declaration *decl = nullptr;
+    Symbol namespace = SYMBOL_NONE;
+    Symbol name = SYMBOL_NONE;
+    switch (astKind(ast, node)) {
+        case IdentNodeType:
+            name = astSymbol(ast, data.a);
+            if (findVariable(lower, name) >= 0) {
+                break;
+            }
+
+            decl = findDeclaration(lower, name);
+            namespace = decl != nullptr ? decl->namespace : SYMBOL_NONE;
+            if (decl != nullptr && decl->kind == DECL_FUNCTION && decl->next == nullptr) {
+                setTarget(lower, &callee, decl);
+            } else if (decl == nullptr && lower->receiverVariable >= 0) {
+                // Another method of the same struct, on the same receiver unless it names its receiver itself.
+                decl = findMethod(lower, lower->impl, name);
+                if (decl != nullptr) {
+                    namespace = lower->impl;
+                    setTarget(lower, &callee, decl);
+                }
+                if (callee.target != nullptr && callee.lowered->receiver == RECEIVER_HIDDEN) {
+                    callee.receiver = receiverAddress(lower, node);
+                }
+            }
+            callee.value = functionValue(lower, callee.target, namespace, name, node);
+            return callee;
+        case ScopeNodeType:
+            if (astKind(ast, data.a) != IdentNodeType) {
+                break;
+            }
+
+            namespace = astSymbol(ast, ast->data[data.a].a);
+            name = astSymbol(ast, data.b);
+            decl = lookupSymbol(lower->lowering->program->symbols, namespace, name);
+            if (decl != nullptr && decl->next == nullptr &&
+                (decl->kind == DECL_FUNCTION || decl->kind == DECL_METHOD)) {
+                setTarget(lower, &callee, decl);
+            }
+            callee.value = functionValue(lower, callee.target, namespace, name, node);
+            return callee;
+        case MemberNodeType:
+        case PointerMemberNodeType: {
+            // A method of the struct the base is or points to, else a field holding a function.
+            name = astSymbol(ast, data.b);
+            const Declaration *structDecl = structOf(lower->lowering, nodeType(lower, data.a));
+            if (structDecl != nullptr) {
+                namespace = structDecl->name;
+                decl = lookupSymbol(lower->lowering->program->symbols, namespace, name);
+                if (decl == nullptr || decl->kind != DECL_METHOD) {
+                    decl = nullptr;
+                }
+            }
+            if (decl == nullptr && formOf(lower->types, nodeType(lower, node)) == FORM_FUNCTION) {
+                break;
+            }
+
+            if (decl != nullptr && decl->next == nullptr) {
+                setTarget(lower, &callee, decl);
+            }
+            callee.receiver = lowerReceiver(lower, node, callee.target != nullptr
+                                                             ? callee.lowered->receiver
+                                                             : RECEIVER_POINTER);
+            callee.value = functionValue(lower, callee.target, namespace, name, node);
+            return callee;
+        }
+        default:
+            break;
+    }
+
+    callee.value = lowerExpression(lower, node);
+    return callee;
+}
+
+// Lowers a default argument of the function callee in its own file, as part of call.
+static IrValue lowerDefault(FunctionLower *lower, const Declaration *callee, const NodeIndex value, const TypeId type,
+                            const NodeIndex call) {
+    const LoweredFile *file = lower->file;
+    const Ast *ast = lower->ast;
+    const TypeId *nodeTypes = lower->nodeTypes;
+    const uint32_t offset = lower->offset;
+    const int bindingCount = lower->bindingCount;
+
+    // The callee's names, not the caller's locals.
+    lower->offset = offsetOf(lower, call);
+    lower->bindingCount = 0;
+    lower->file = fileOf(lower->lowering, callee->file);
+    lower->ast = &callee->file->ast;
+    lower->nodeTypes = lower->file->types;
+    const IrValue result = lowerAs(lower, value, type);
+
+    lower->file = file;
+    lower->ast = ast;
+    lower->nodeTypes = nodeTypes;
+    lower->offset = offset;
+    lower->bindingCount = bindingCount;
+    return result;
+}
+
+// The arguments of a call of a function of the module, in the order it declares them: named arguments where they are
+// declared and defaults for the ones not given, with the values of a variadic argument last. Arguments are evaluated
+// in the order they are written, then defaults. Returns how many there are.
+static int arrangeArguments(FunctionLower *lower, const Callee *callee, const uint32_t *args, const int argCount,
+                            const NodeIndex call, IrValue *out) {
+    const Ast *targetAst = &callee->target->file->ast;
+    const TypeId *targetTypes = fileOf(lower->lowering, callee->target->file)->types;
+    int paramCount;
+    const uint32_t *params = astList(targetAst, targetAst->extra[signatureOf(targetAst, callee->target->node)],
+                                     &paramCount);
+
+    // A receiver declared as the first argument is given by the call already.
+    const Receiver receiver = callee->lowered->receiver;
+    if (callee->receiver != IR_NONE && (receiver == RECEIVER_VALUE || receiver == RECEIVER_POINTER) &&
+        paramCount > 0) {
+        ++params;
+        --paramCount;
+    }
+
+    for (int i = 0; i < paramCount; ++i) {
+        out[i] = IR_NONE;
+    }
+
+    int count = paramCount;
+    int positional = 0;
+    for (int i = 0; i < argCount; ++i) {
+        if (astKind(lower->ast, args[i]) == NamedArgNodeType) {
+            const Symbol name = astSymbol(lower->ast, lower->ast->data[args[i]].a);
+            int at = 0;
+            while (at < paramCount && astSymbol(targetAst, targetAst->data[params[at]].a) != name) {
+                ++at;
+            }
+            const IrValue value = lowerAs(lower, lower->ast->data[args[i]].b,
+                                          at < paramCount ? targetTypes[params[at]] : TYPE_ID_NONE);
+            if (at < paramCount) {
+                out[at] = value;
+            }
+            continue;
+        }
+
+        // Past the last argument, only a variadic one takes more.
+        const int at = positional < paramCount ? positional : paramCount - 1;
+        ++positional;
+        TypeId type = at >= 0 ? targetTypes[params[at]] : TYPE_ID_NONE;
+        if (formOf(lower->types, type) == FORM_VARIADIC) {
+            type = typeOf(lower->types, type)->a;
+        }
+        const IrValue value = lowerAs(lower, args[i], type);
+        if (at >= 0 && out[at] == IR_NONE) {
+            out[at] = value;
+        } else {
+            out[count++] = value;
+        }
+    }
+
+    for (int i = 0; i < paramCount; ++i) {
+        if (out[i] != IR_NONE) {
+            continue;
+        }
+
+        const NodeIndex value = targetAst->extra[targetAst->data[params[i]].b + 1];
+        const TypeId type = targetTypes[params[i]];
+        if (value != NODE_NONE) {
+            out[i] = lowerDefault(lower, callee->target, value, type, call);
+        } else if (i == paramCount - 1 && count == paramCount && formOf(lower->types, type) == FORM_VARIADIC) {
+            count = i; // Given no values.
+        } else {
+            out[i] = emitUndef(lower, type, call);
+        }
+    }
+
+    return count;
+}
+
+static IrValue lowerCall(FunctionLower *lower, const NodeIndex node) {
+    const IrValue conversion = lowerConversion(lower, node);
+    if (conversion != IR_NONE) {
+        return conversion;
+    }
+
+    const Ast *ast = lower->ast;
+    const Lowering *lowering = lower->lowering;
+    int argCount;
+    const uint32_t *args = astList(ast, ast->data[node].b, &argCount);
+
+    const NodeIndex name = ast->data[node].a;
+    if (astKind(ast, name) == IdentNodeType && astSymbol(ast, ast->data[name].a) == lowering->len && argCount == 1 &&
+        findVariable(lower, lowering->len) < 0 && findDeclaration(lower, lowering->len) == nullptr) {
+        return emit(lower, IR_LEN, primitiveType(TYPE_S32), lowerExpression(lower, args[0]), 0, node);
+    }
+
+    const Callee callee = lowerCallee(lower, node);
+    int paramCount = 0;
+    if (callee.target != nullptr) {
+        const Ast *targetAst = &callee.target->file->ast;
+        paramCount = (int)targetAst->extra[targetAst->extra[signatureOf(targetAst, callee.target->node)]];
+    }
+
+    // Room for a receiver, every parameter and every argument.
+    IrValue small[16];
+    const int capacity = 1 + paramCount + argCount;
+    IrValue *values = capacity <= 16 ? small : (IrValue *)malloc(sizeof(IrValue) * capacity);
+    int count = 0;
+    if (callee.receiver != IR_NONE) {
+        values[count++] = callee.receiver;
+    } else if (callee.target != nullptr && callee.lowered->receiver == RECEIVER_HIDDEN) {
+        // Point::origin() has nothing to pass.
+        values[count++] = emit(lower, IR_NULL, pointerTo(lower->types, callee.lowered->receiverType), 0, 0, node);
+    }
+
+    if (callee.target != nullptr) {
+        count += arrangeArguments(lower, &callee, args, argCount, node, values + count);
+    } else {
+        for (int i = 0; i < argCount; ++i) {
+            values[count++] = lowerExpression(lower, args[i]);
+        }
+    }
+
+    TypeId type = nodeType(lower, node);
+    const TypeId fn = valueType(lower, callee.value);
+    if (type == TYPE_ID_NONE && formOf(lower->types, fn) == FORM_FUNCTION) {
+        const Type *t = typeOf(lower->types, fn);
+        type = t->count - t->a == 1 ? t->items[t->a] : TYPE_ID_NONE;
+    }
+
+    const IrValue value = emit(lower, IR_CALL, type, callee.value, addIrList(lower->function, values, count), node);
+    if (astKind(ast, node) == InlineCallNodeType) {
+        irInst(lower->function, value)->inlining = INLINE_ALWAYS;
+    }
+    if (values != small) {
+        free(values);
+    }
+    return value;
+}
+
+// The first count values call returns, typed by the function it calls when that is known.
+static void extractResults(FunctionLower *lower, const IrValue call, IrValue *out, const int count,
+                           const NodeIndex node) {
+    const IrInst *inst = &lower->function->insts[call];
+    const TypeId fn = inst->op == IR_CALL ? valueType(lower, inst->a) : TYPE_ID_NONE;
+    const Type *t = formOf(lower->types, fn) == FORM_FUNCTION ? typeOf(lower->types, fn) : nullptr;
+    for (int i = 0; i < count; ++i) {
+        const TypeId type = t != nullptr && (uint32_t)i < t->count - t->a ? t->items[t->a + i] : TYPE_ID_NONE;
+        out[i] = emit(lower, IR_EXTRACT, type, call, (uint32_t)i, node);
+    }
+}
+
+// Literals.
+
+static IrValue lowerStructLiteral(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const TypeId type = nodeType(lower, node);
+    const Declaration *structDecl = structOf(lower->lowering, type);
+    const IrValue slot = addSlot(lower, type, IR_NONE, node);
+    emit(lower, IR_STORE, TYPE_ID_NONE, slot, emit(lower, IR_ZERO, type, 0, 0, node), node);
+
+    int declaredCount = 0;
+    const uint32_t *declared = nullptr;
+    if (structDecl != nullptr) {
+        const Ast *structAst = &structDecl->file->ast;
+        declared = astList(structAst, structAst->extra[structAst->data[structDecl->node].b], &declaredCount);
+    }
+
+    // Named fields go where they are named, plain values in the order the fields are declared.
+    int count;
+    const uint32_t *fields = astList(ast, ast->data[node].b, &count);
+    for (int i = 0; i < count; ++i) {
+        Symbol name = SYMBOL_NONE;
+        NodeIndex value = fields[i];
+        if (astKind(ast, fields[i]) == NamedArgNodeType) {
+            name = astSymbol(ast, ast->data[fields[i]].a);
+            value = ast->data[fields[i]].b;
+        } else if (i < declaredCount) {
+            name = astSymbol(&structDecl->file->ast, structDecl->file->ast.data[declared[i]].a);
+        }
+
+        TypeId field = TYPE_ID_NONE;
+        if (structDecl == nullptr || !findField(lower->lowering, structDecl, name, &field)) {
+            lowerExpression(lower, value);
+            continue;
+        }
+
+        const IrValue item = lowerAs(lower, value, field);
+        const IrValue address = emit(lower, IR_FIELD, pointerTo(lower->types, field), slot, name, fields[i]);
+        emit(lower, IR_STORE, TYPE_ID_NONE, address, item, fields[i]);
+    }
+
+    return emit(lower, IR_LOAD, type, slot, 0, node);
+}
+
+static IrValue lowerArrayLiteral(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const TypeId type = nodeType(lower, node);
+    const TypeId element = elementOf(lower->types, type);
+    const IrValue slot = addSlot(lower, type, IR_NONE, node);
+
+    int count;
+    const uint32_t *items = astList(ast, ast->data[node].a, &count);
+    for (int i = 0; i < count; ++i) {
+        const IrValue item = lowerAs(lower, items[i], element);
+        const IrValue index = emitInt(lower, primitiveType(TYPE_S32), i, items[i]);
+        const IrValue address = emit(lower, IR_ELEMENT, pointerTo(lower->types, element), slot, index, items[i]);
+        emit(lower, IR_STORE, TYPE_ID_NONE, address, item, items[i]);
+    }
+
+    return emit(lower, IR_LOAD, type, slot, 0, node);
+}
+
+// An identifier as a value: a local, a global, a function, a type, or a field of the receiver.
+static IrValue lowerName(FunctionLower *lower, const NodeIndex node) {
+    const Symbol name = astSymbol(lower->ast, lower->ast->data[node].a);
+    const int variable = findVariable(lower, name);
+    if (variable >= 0) {
+        return loadVariable(lower, variable, node);
+    }
+
+    const Declaration *decl = findDeclaration(lower, name);
+    if (decl != nullptr && decl->kind == DECL_FUNCTION) {
+        return functionValue(lower, decl, decl->namespace, name, node);
+    }
+    const NiftyTokenType keyword = keywordOf(lower, name);
+    if ((decl != nullptr && decl->kind == DECL_STRUCT) || (keyword >= TK_INT && keyword <= TK_ANY_TYPE)) {
+        return emit(lower, IR_TYPE, primitiveType(TYPE_TYPE_ID), typeOfNode(lower, node), 0, node);
+    }
+    if (decl != nullptr && decl->kind != DECL_VARIABLE) {
+        return emit(lower, IR_EXTERN, nodeType(lower, node), decl->namespace, name, node);
+    }
+    const IrValue known = emitConstant(lower, globalConstant(lower, decl, name), nodeType(lower, node), node);
+    if (known != IR_NONE) {
+        return known;
+    }
+
+    return emit(lower, IR_LOAD, nodeType(lower, node), lowerAddress(lower, node), 0, node);
+}
+
+static IrValue lowerExpression(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const NodeData data = ast->data[node];
+    const NodeKind kind = astKind(ast, node);
+    const TypeId type = nodeType(lower, node);
+
+    switch (kind) {
+        case IntNodeType:
+        case FloatNodeType:
+        case CharNodeType:
+            return lowerNumber(lower, node, type, false);
+        case StringNodeType:
+            return emit(lower, IR_STRING, primitiveType(TYPE_STRING), astSymbol(ast, data.a), 0, node);
+        case BoolNodeType:
+            return emitBool(lower, data.a != 0, node);
+        case NullNodeType:
+            return emit(lower, IR_NULL, type, 0, 0, node);
+        case UndefinedNodeType:
+            return emitUndef(lower, type, node);
+        case IdentNodeType:
+            return lowerName(lower, node);
+        case ScopeNodeType:
+            if (astKind(ast, data.a) == IdentNodeType) {
+                const Symbol namespace = astSymbol(ast, ast->data[data.a].a);
+                const Declaration *decl = lookupSymbol(lower->lowering->program->symbols, namespace,
+                                                       astSymbol(ast, data.b));
+                if (decl != nullptr && decl->kind == DECL_VARIABLE) {
+                    const IrValue known = emitConstant(lower, globalConstant(lower, decl, astSymbol(ast, data.b)),
+                                                       type, node);
+                    return known != IR_NONE ? known : emit(lower, IR_LOAD, type, lowerAddress(lower, node), 0, node);
+                }
+                return functionValue(lower, decl, namespace, astSymbol(ast, data.b), node);
+            }
+            lowerExpression(lower, data.a);
+            return emitUndef(lower, type, node);
+        case CallNodeType:
+        case InlineCallNodeType:
+            return lowerCall(lower, node);
+        case NamedArgNodeType:
+            return lowerExpression(lower, data.b);
+        case IndexNodeType:
+        case MemberNodeType:
+        case PointerMemberNodeType:
+            return emit(lower, IR_LOAD, type, lowerAddress(lower, node), 0, node);
+        case ArrayLitNodeType:
+            return lowerArrayLiteral(lower, node);
+        case StructLitNodeType:
+            return lowerStructLiteral(lower, node);
+        case NewNodeType: {
+            const NodeKind valueKind = astKind(ast, data.a);
+            if (valueKind == ArrayTypeNodeType) {
+                const IrValue capacity = lowerAs(lower, ast->data[data.a].b, primitiveType(TYPE_S32));
+                return emit(lower, IR_NEW, type, IR_NONE, capacity, node);
+            }
+            const bool isType = valueKind >= NamedTypeNodeType && valueKind <= UnionTypeNodeType;
+            return emit(lower, IR_NEW, type, isType ? IR_NONE : lowerExpression(lower, data.a), 0, node);
+        }
+        case TernaryNodeType:
+            return lowerTernary(lower, node);
+        case OrElseNodeType:
+            return lowerOrElse(lower, node, data.b);
+        case NegNodeType: {
+            if (isNumberLiteral(ast, data.a)) {
+                return lowerNumber(lower, data.a, type, true);
+            }
+            const IrValue value = emit(lower, IR_NEG, type, lowerAs(lower, data.a, type), 0, node);
+            if (irIsInteger(type)) {
+                emit(lower, IR_CHECK_OVERFLOW, TYPE_ID_NONE, value, 0, node);
+            }
+            return value;
+        }
+        case NotNodeType:
+            return emit(lower, IR_NOT, primitiveType(TYPE_B32), lowerExpression(lower, data.a), 0, node);
+        case BitNotNodeType:
+            return emit(lower, IR_BIT_NOT, type, lowerExpression(lower, data.a), 0, node);
+        case AddressOfNodeType:
+            return lowerAddress(lower, data.a);
+        case DerefNodeType:
+            return emit(lower, IR_LOAD, type, lowerExpression(lower, data.a), 0, node);
+        case PreIncNodeType:
+        case PreDecNodeType:
+        case PostIncNodeType:
+        case PostDecNodeType:
+            return lowerIncrement(lower, node);
+        default:
+            break;
+    }
+
+    if (kind >= AddNodeType && kind <= RangeClosedNodeType) {
+        return lowerBinary(lower, node);
+    }
+    if (kind >= NamedTypeNodeType && kind <= UnionTypeNodeType) {
+        // A type given as an argument, size_of(T).
+        return emit(lower, IR_TYPE, primitiveType(TYPE_TYPE_ID), typeOfNode(lower, node), 0, node);
+    }
+
+    return emitUndef(lower, type, node);
+}
+
+// Statements.
+
+static void lowerVar(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const uint32_t var = ast->data[node].a;
+    const TypeId declared = ast->extra[var + 1] != NODE_NONE ? nodeType(lower, node) : TYPE_ID_NONE;
+
+    int valueCount;
+    const uint32_t *values = astList(ast, ast->extra[var + 2], &valueCount);
+    int nameCount;
+    const uint32_t *names = astList(ast, ast->extra[var + 3], &nameCount);
+
+    IrValue small[8];
+    IrValue *results = nameCount <= 8 ? small : (IrValue *)malloc(sizeof(IrValue) * nameCount);
+    if (valueCount == nameCount) {
+        // Constants are lowered as their values, so the passes and the backend see literals.
+        for (int i = 0; i < nameCount; ++i) {
+            const Constant *known = findConstant(lower->file->constants, values[i]);
+            const TypeId type = declared != TYPE_ID_NONE ? declared : nodeType(lower, values[i]);
+            results[i] = emitConstant(lower, known, type, values[i]);
+            if (results[i] == IR_NONE) {
+                results[i] = lowerAs(lower, values[i], declared);
+            }
+        }
+    } else if (valueCount == 1 && isCallNode(ast, values[0])) {
+        extractResults(lower, lowerExpression(lower, values[0]), results, nameCount, node);
+    } else {
+        // x, y: f64 = undefined, and names declared without a value.
+        const IrValue value = valueCount == 1 ? lowerAs(lower, values[0], declared)
+                                              : emit(lower, IR_ZERO, declared, 0, 0, node);
+        for (int i = 0; i < nameCount; ++i) {
+            results[i] = value;
+        }
+    }
+
+    // The names are in scope once every value is lowered, x := x + 1 reads the x of an outer scope.
+    for (int i = 0; i < nameCount; ++i) {
+        const TypeId type = declared != TYPE_ID_NONE || nameCount > 1 ? declared : nodeType(lower, node);
+        bindVariable(lower, astSymbol(ast, names[i]), type, results[i], node);
+    }
+    if (results != small) {
+        free(results);
+    }
+}
+
+static void lowerReturn(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    int count;
+    const uint32_t *values = astList(ast, ast->data[node].a, &count);
+
+    // return f() for a function returning what f returns.
+    const bool spread = count == 1 && lower->returnCount > 1 && isCallNode(ast, values[0]);
+    const int resultCount = spread ? lower->returnCount : count;
+    IrValue small[8];
+    IrValue *results = resultCount <= 8 ? small : (IrValue *)malloc(sizeof(IrValue) * resultCount);
+    if (spread) {
+        extractResults(lower, lowerExpression(lower, values[0]), results, resultCount, node);
+    } else {
+        for (int i = 0; i < count; ++i) {
+            results[i] = lowerAs(lower, values[i], i < lower->returnCount ? lower->returns[i] : TYPE_ID_NONE);
+        }
+    }
+
+    emitDeferred(lower, 0, false, node);
+    emit(lower, IR_RETURN, TYPE_ID_NONE, addIrList(lower->function, results, resultCount), 0, node);
+    if (results != small) {
+        free(results);
+    }
+}
+
+static void lowerJump(FunctionLower *lower, const NodeIndex node, const bool isBreak) {
+    if (lower->loopCount == 0) {
+        return;
+    }
+
+    const Loop *loop = &lower->loops[lower->loopCount - 1];
+    const IrBlock target = isBreak ? loop->exit : loop->latch;
+    emitDeferred(lower, loop->deferredCount, false, node);
+    jump(lower, target, node);
+}
+
+typedef struct {
+    IrBlock header; // The condition, its back edge comes from the latch.
+    IrBlock body;
+    IrBlock latch;
+    IrBlock exit;
+} LoopBlocks;
+
+// Jumps to the header of a new loop, whose condition is lowered next.
+static LoopBlocks beginLoop(FunctionLower *lower, const NodeIndex node) {
+    LoopBlocks loop;
+    loop.header = newBlock(lower, BLOCK_LOOP);
+    loop.body = newBlock(lower, BLOCK_PLAIN);
+    loop.latch = newBlock(lower, BLOCK_PLAIN);
+    loop.exit = newBlock(lower, BLOCK_PLAIN);
+    jump(lower, loop.header, node);
+    lower->current = loop.header; // Sealed once the latch jumps back to it.
+
+    return loop;
+}
+
+typedef void (*StepFn)(FunctionLower *lower, const void *context);
+
+// Lowers the body of a loop whose body block is current, then the latch with its step, and goes on after the loop.
+static void endLoop(FunctionLower *lower, const LoopBlocks *loop, const NodeIndex body, const StepFn step,
+                    const void *context, const NodeIndex node) {
+    if (lower->loopCount == lower->loopCapacity) {
+        lower->loops = (Loop *)array_grow(lower->loops, &lower->loopCapacity, sizeof(Loop));
+    }
+    lower->loops[lower->loopCount++] = (Loop){loop->exit, loop->latch, lower->deferredCount};
+    lowerStatement(lower, body);
+    --lower->loopCount;
+    if (isOpen(lower)) {
+        jump(lower, loop->latch, node);
+    }
+
+    enter(lower, loop->latch);
+    if (step != nullptr) {
+        step(lower, context);
+    }
+    jump(lower, loop->header, node);
+    seal(lower, loop->header);
+    enter(lower, loop->exit);
+}
+
+static void lowerConditionLoop(FunctionLower *lower, const NodeIndex node, const bool until) {
+    const NodeData data = lower->ast->data[node];
+    const LoopBlocks loop = beginLoop(lower, node);
+    const IrValue condition = lowerExpression(lower, data.a);
+    branch(lower, condition, until ? loop.exit : loop.body, until ? loop.body : loop.exit, node);
+    enter(lower, loop.body);
+    endLoop(lower, &loop, data.b, nullptr, nullptr, node);
+}
+
+static void stepStatement(FunctionLower *lower, const void *context) {
+    lowerStatement(lower, *(const NodeIndex *)context);
+}
+
+static void lowerFor(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const uint32_t parts = ast->data[node].a;
+    const Scope scope = openScope(lower);
+    lowerStatement(lower, ast->extra[parts]);
+
+    const LoopBlocks loop = beginLoop(lower, node);
+    const NodeIndex condition = ast->extra[parts + 1];
+    if (condition != NODE_NONE) {
+        branch(lower, lowerExpression(lower, condition), loop.body, loop.exit, node);
+    } else {
+        jump(lower, loop.body, node);
+    }
+    enter(lower, loop.body);
+
+    const NodeIndex step = ast->extra[parts + 2];
+    endLoop(lower, &loop, ast->extra[parts + 3], stepStatement, &step, node);
+    closeScope(lower, scope, node);
+}
+
+typedef struct {
+    int counter;
+    IrValue step;
+    IrOp op;
+    NodeIndex node;
+} CounterStep;
+
+static void stepCounter(FunctionLower *lower, const void *context) {
+    const CounterStep *step = (const CounterStep *)context;
+    const IrValue value = readVariable(lower, step->counter, openBlock(lower));
+    const IrValue next = emitArithmetic(lower, step->op, valueType(lower, value), value, step->step, true, step->node);
+    writeVariable(lower, step->counter, openBlock(lower), next);
+}
+
+// for (i in a ..< b), for <(val x, i in items; 2) and the like, as a loop over a counter: the value of ranges, the
+// index into anything else.
+static void lowerForIn(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const uint32_t parts = ast->data[node].a;
+    const bool reverse = ast->data[node].b != 0;
+    int nameCount;
+    const uint32_t *names = astList(ast, ast->extra[parts], &nameCount);
+    const NodeIndex iterable = ast->extra[parts + 1];
+    const NodeIndex stepNode = ast->extra[parts + 2];
+    const NodeKind kind = astKind(ast, iterable);
+    const bool range = kind == RangeOpenNodeType || kind == RangeClosedNodeType;
+    const Scope scope = openScope(lower);
+
+    TypeId counterType = primitiveType(TYPE_S32);
+    TypeId iterableType = TYPE_ID_NONE;
+    IrValue start;
+    IrValue end;
+    IrValue base = IR_NONE;
+    if (range) {
+        const NodeData bounds = ast->data[iterable];
+        const TypeId type = operandType(lower, bounds.a, bounds.b);
+        counterType = type != TYPE_ID_NONE ? type : counterType;
+        start = lowerAs(lower, bounds.a, counterType);
+        end = lowerAs(lower, bounds.b, counterType);
+    } else {
+        iterableType = nodeType(lower, iterable);
+        base = indexedInPlace(lower, iterableType) ? lowerAddress(lower, iterable) : lowerExpression(lower, iterable);
+        start = emitInt(lower, counterType, 0, iterable);
+        end = lengthOf(lower, iterableType, base, iterable);
+        if (end == IR_NONE) {
+            end = emit(lower, IR_LEN, counterType, base, 0, iterable);
+        }
+    }
+
+    // Counts from the first value up to the last, or back down when reversed.
+    const bool closed = kind == RangeClosedNodeType;
+    IrValue first = start;
+    if (reverse) {
+        first = closed ? end
+                       : emitArithmetic(lower, IR_SUB, counterType, end, emitInt(lower, counterType, 1, node), true,
+                                        node);
+    }
+    const CounterStep step = {
+        addVariable(lower, SYMBOL_NONE, counterType),
+        stepNode != NODE_NONE ? lowerAs(lower, stepNode, counterType) : emitInt(lower, counterType, 1, node),
+        reverse ? IR_SUB : IR_ADD,
+        node,
+    };
+    writeVariable(lower, step.counter, openBlock(lower), first);
+
+    const LoopBlocks loop = beginLoop(lower, node);
+    const IrValue counter = readVariable(lower, step.counter, loop.header);
+    const IrOp compare = reverse ? IR_GE : closed ? IR_LE : IR_LT;
+    branch(lower, emit(lower, compare, primitiveType(TYPE_B32), counter, reverse ? start : end, node), loop.body,
+           loop.exit, node);
+    enter(lower, loop.body);
+
+    // Ranges name their value first, everything else its element first and the index second.
+    const IrValue current = readVariable(lower, step.counter, loop.body);
+    if (range && nameCount > 0) {
+        bindVariable(lower, astSymbol(ast, names[0]), counterType, current, node);
+    } else if (nameCount > 0) {
+        const TypeId element = elementOf(lower->types, iterableType);
+        emit(lower, IR_CHECK_BOUNDS, TYPE_ID_NONE, current, end, iterable);
+        const IrValue address = emit(lower, IR_ELEMENT, pointerTo(lower->types, element), base, current, iterable);
+        bindVariable(lower, astSymbol(ast, names[0]), element, emit(lower, IR_LOAD, element, address, 0, iterable),
+                     node);
+        if (nameCount > 1) {
+            bindVariable(lower, astSymbol(ast, names[1]), counterType, current, node);
+        }
+    }
+
+    endLoop(lower, &loop, ast->extra[parts + 3], stepCounter, &step, node);
+    closeScope(lower, scope, node);
+}
+
+static void lowerIf(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const NodeData data = ast->data[node];
+    const Scope scope = openScope(lower);
+    lowerStatement(lower, ast->extra[data.b]);
+
+    const NodeIndex otherwise = ast->extra[data.b + 2];
+    const IrValue condition = lowerExpression(lower, data.a);
+    const IrBlock then = newBlock(lower, BLOCK_PLAIN);
+    const IrBlock elseBlock = otherwise != NODE_NONE ? newBlock(lower, BLOCK_PLAIN) : IR_NO_BLOCK;
+    const IrBlock join = newBlock(lower, BLOCK_PLAIN);
+    branch(lower, condition, then, otherwise != NODE_NONE ? elseBlock : join, node);
+
+    enter(lower, then);
+    lowerStatement(lower, ast->extra[data.b + 1]);
+    if (isOpen(lower)) {
+        jump(lower, join, node);
+    }
+    if (otherwise != NODE_NONE) {
+        enter(lower, elseBlock);
+        lowerStatement(lower, otherwise);
+        if (isOpen(lower)) {
+            jump(lower, join, node);
+        }
+    }
+    enter(lower, join);
+    closeScope(lower, scope, node);
+}
+
+static void lowerStatement(FunctionLower *lower, const NodeIndex node) {
+    const Ast *ast = lower->ast;
+    const NodeData data = ast->data[node];
+
+    switch (astKind(ast, node)) {
+        case VoidNodeType:
+        case UseNodeType:
+        case FunctionNodeType:
+        case StructNodeType:
+        case ImplNodeType:
+        case LazyBodyNodeType:
+            break;
+        case BlockNodeType: {
+            const Scope scope = openScope(lower);
+            int count;
+            const uint32_t *list = astList(ast, data.a, &count);
+            for (int i = 0; i < count; ++i) {
+                lowerStatement(lower, list[i]);
+            }
+            closeScope(lower, scope, node);
+            break;
+        }
+        case VarNodeType:
+            lowerVar(lower, node);
+            break;
+        case AssignNodeType: {
+            const Place place = lowerPlace(lower, data.a);
+            storePlace(lower, &place, lowerAs(lower, data.b, place.type), node);
+            break;
+        }
+        case CompoundAssignNodeType: {
+            const Place place = lowerPlace(lower, data.a);
+            const IrValue old = loadPlace(lower, &place, node);
+            const IrValue value = lowerOperation(lower, (NodeKind)ast->extra[data.b], old, ast->extra[data.b + 1],
+                                                 place.type, node);
+            storePlace(lower, &place, value, node);
+            break;
+        }
+        case ReturnNodeType:
+            lowerReturn(lower, node);
+            break;
+        case IfNodeType:
+            lowerIf(lower, node);
+            break;
+        case WhileNodeType:
+            lowerConditionLoop(lower, node, false);
+            break;
+        case UntilNodeType:
+            lowerConditionLoop(lower, node, true);
+            break;
+        case ForNodeType:
+            lowerFor(lower, node);
+            break;
+        case ForInNodeType:
+            lowerForIn(lower, node);
+            break;
+        case BreakNodeType:
+            lowerJump(lower, node, true);
+            break;
+        case ContinueNodeType:
+            lowerJump(lower, node, false);
+            break;
+        case DeferNodeType:
+            if (lower->deferredCount == lower->deferredCapacity) {
+                lower->deferred = (NodeIndex *)array_grow(lower->deferred, &lower->deferredCapacity, sizeof(NodeIndex));
+            }
+            lower->deferred[lower->deferredCount++] = data.a;
+            break;
+        case DeleteNodeType:
+            emit(lower, IR_DELETE, TYPE_ID_NONE, lowerExpression(lower, data.a), 0, node);
+            break;
+        default:
+            lowerExpression(lower, node);
+            break;
+    }
+}
+
+// Functions.
+
+static void lowerTask(void *arg) {
+    FunctionLower *lower = (FunctionLower *)arg;
+    const uint64_t start = timer_now_ns();
+    Lowering *lowering = lower->lowering;
+    IrFunction *function = lower->function;
+    const Ast *ast = lower->ast;
+    const NodeIndex node = lowering->functions[lower->index].node;
+    const uint32_t signature = signatureOf(ast, node);
+
+    lower->definitionMask = 63;
+    lower->definitions = (Definition *)calloc(lower->definitionMask + 1, sizeof(Definition));
+    lower->offset = UINT32_MAX;
+    lower->receiverVariable = -1;
+    lower->current = newBlock(lower, BLOCK_PLAIN);
+    seal(lower, lower->current);
+
+    // Arguments arrive as parameters, and are stored like any other local.
+    int argCount;
+    const uint32_t *args = astList(ast, ast->extra[signature], &argCount);
+    const int hidden = lower->receiver == RECEIVER_HIDDEN;
+    for (int i = 0; i < function->paramCount; ++i) {
+        const TypeId type = i < hidden ? pointerTo(lower->types, lower->receiverType)
+                                       : lower->nodeTypes[args[i - hidden]];
+        emit(lower, IR_PARAM, type, (uint32_t)i, 0, node);
+        ++lower->entryCount;
+    }
+    for (int i = 0; i < function->paramCount; ++i) {
+        const IrValue param = function->blocks[0].insts[i];
+        const Symbol name = i < hidden ? lowering->this : astSymbol(ast, ast->data[args[i - hidden]].a);
+        const int variable = bindVariable(lower, name, valueType(lower, param), param, node);
+        if (i == 0 && lower->receiver != RECEIVER_NONE) {
+            lower->receiverVariable = variable;
+        }
+    }
+
+    // A receiver taken by value is used at its slot.
+    if (lower->receiver == RECEIVER_VALUE && lower->variables[lower->receiverVariable].slot == IR_NONE) {
+        lower->receiverVariable = -1;
+    }
+
+    // void is the same as no return values.
+    int returnCount;
+    const uint32_t *returns = astList(ast, ast->extra[signature + 1], &returnCount);
+    lower->returns = (TypeId *)malloc(sizeof(TypeId) * (returnCount + 1));
+    for (int i = 0; i < returnCount; ++i) {
+        lower->returns[i] = typeOfNode(lower, returns[i]);
+    }
+    lower->returnCount = returnCount == 1 && lower->returns[0] == primitiveType(TYPE_VOID) ? 0 : returnCount;
+    const bool isMain = lower->impl == SYMBOL_NONE && function->name == lowering->main;
+    if (returnCount == 0 && isMain) {
+        // main declaring nothing may still give the exit code, as an int.
+        lower->returns[0] = primitiveType(TYPE_S32);
+        lower->returnCount = 1;
+    }
+
+    lowerStatement(lower, ast->data[node].b);
+    if (isOpen(lower)) {
+        // Falling off the end returns nothing, a function declaring return values can't get there.
+        const bool canReturn = lower->returnCount == 0 || isMain;
+        emit(lower, canReturn ? IR_RETURN : IR_UNREACHABLE, TYPE_ID_NONE, LIST_EMPTY, 0, ast->data[node].b);
+    }
+
+    removeTrivialPhis(function);
+    compactIrFunction(function);
+
+    free(lower->returns);
+    free(lower->loops);
+    free(lower->deferred);
+    free(lower->incomplete);
+    free(lower->sealed);
+    free(lower->definitions);
+    free(lower->bindings);
+    free(lower->variables);
+    lower->ns = timer_now_ns() - start;
+}
+
+// The declaration of the function at node of file, declared in namespace.
+static const Declaration *findFunction(const Lowering *lowering, const ParseResults *file, const Symbol namespace,
+                                       const NodeIndex node) {
+    const Ast *ast = &file->ast;
+    for (const Declaration *decl = lookupSymbol(lowering->program->symbols, namespace,
+                                                astSymbol(ast, ast->data[ast->data[node].a].a));
+         decl != nullptr; decl = decl->next) {
+        if (decl->file == file && decl->node == node) {
+            return decl;
+        }
+    }
+
+    return nullptr;
+}
+
+// How the method at node of a struct of type takes it: as its first argument when that is the struct or points to it.
+static Receiver receiverOf(const Lowering *lowering, const LoweredFile *file, const NodeIndex node, const TypeId type) {
+    const Ast *ast = &file->results->ast;
+    int argCount;
+    const uint32_t *args = astList(ast, ast->extra[signatureOf(ast, node)], &argCount);
+    if (argCount > 0 && type != TYPE_ID_NONE) {
+        const TypeId first = file->types[args[0]];
+        if (first == type) {
+            return RECEIVER_VALUE;
+        }
+        if (formOf(lowering->types, first) == FORM_POINTER && typeOf(lowering->types, first)->a == type) {
+            return RECEIVER_POINTER;
+        }
+    }
+
+    return RECEIVER_HIDDEN;
+}
+
+static void addFunction(Lowering *lowering, const LoweredFile *file, const NodeIndex node, const Symbol impl,
+                        const TypeId receiverType, int *capacity) {
+    const Ast *ast = &file->results->ast;
+    const uint32_t signature = signatureOf(ast, node);
+    if (astKind(ast, ast->data[node].b) != BlockNodeType || ast->extra[ast->extra[signature + 2]] > 0) {
+        return; // Without a body, one lazy parsing found nothing calls, or generic.
+    }
+
+    const Declaration *decl = findFunction(lowering, file->results, impl != SYMBOL_NONE ? impl
+                                                                                        : file->results->namespace,
+                                           node);
+    if (decl == nullptr || irFunctionIndex(lowering->module, decl) >= 0) {
+        return;
+    }
+
+    const int index = lowering->module->functionCount;
+    if (index == *capacity) {
+        lowering->functions = (LoweredFunction *)array_grow(lowering->functions, capacity, sizeof(LoweredFunction));
+    }
+
+    IrFunction *function = addIrFunction(lowering->module, decl);
+    const Receiver receiver = impl != SYMBOL_NONE ? receiverOf(lowering, file, node, receiverType) : RECEIVER_NONE;
+    lowering->functions[index] = (LoweredFunction){receiver, receiverType, node};
+
+    int argCount;
+    astList(ast, ast->extra[signature], &argCount);
+    function->paramCount = argCount + (receiver == RECEIVER_HIDDEN);
+    const uint32_t flags = ast->extra[signature + 3];
+    function->inlining = flags & FN_NO_INLINE ? INLINE_NEVER : flags & FN_INLINE ? INLINE_ALWAYS : INLINE_MAYBE;
+    function->type = file->types[node];
+    if (receiver == RECEIVER_HIDDEN && function->type != TYPE_ID_NONE) {
+        // The type with the hidden receiver first.
+        const Type *t = typeOf(lowering->types, function->type);
+        TypeId *items = (TypeId *)malloc(sizeof(TypeId) * (t->count + 1));
+        items[0] = pointerTo(lowering->types, receiverType);
+        if (t->count > 0) {
+            memcpy(items + 1, t->items, sizeof(TypeId) * t->count);
+        }
+        function->type = items[0] != TYPE_ID_NONE
+                             ? functionType(lowering->types, items, (int)t->a + 1, items + t->a + 1,
+                                            (int)(t->count - t->a))
+                             : TYPE_ID_NONE;
+        free(items);
+    }
+    int returnCount;
+    astList(ast, ast->extra[signature + 1], &returnCount);
+    if (impl == SYMBOL_NONE && function->name == lowering->main && returnCount == 0 && function->type != TYPE_ID_NONE) {
+        // main declaring nothing returns the exit code, see lowerTask.
+        const Type *t = typeOf(lowering->types, function->type);
+        const TypeId exitCode = primitiveType(TYPE_S32);
+        function->type = functionType(lowering->types, t->items, (int)t->a, &exitCode, 1);
+    }
+
+    // Strings are never written, so nothing can change what one points to behind the function's back.
+    const int hidden = receiver == RECEIVER_HIDDEN;
+    const uint32_t *args = astList(ast, ast->extra[signature], &argCount);
+    const Type *type = function->type != TYPE_ID_NONE ? typeOf(lowering->types, function->type) : nullptr;
+    for (int i = 0; i < argCount && i + hidden < 32; ++i) {
+        const bool restricted = ast->extra[ast->data[args[i]].b + 2] & ARG_RESTRICT;
+        const bool string = type != nullptr && (uint32_t)(i + hidden) < type->a &&
+                            type->items[i + hidden] == primitiveType(TYPE_STRING);
+        if (restricted || string) {
+            function->restrictParams |= 1u << (i + hidden);
+        }
+    }
+}
+
+// Every function with a body, in file and then declaration order, as checkProgram collects them.
+static void collectFunctions(Lowering *lowering) {
+    int capacity = 0;
+    for (int i = 0; i < lowering->program->fileCount; ++i) {
+        const LoweredFile *file = &lowering->files[i];
+        const Ast *ast = &file->results->ast;
+        int declCount;
+        const uint32_t *decls = astList(ast, ast->decls, &declCount);
+        for (int j = 0; j < declCount; ++j) {
+            if (astKind(ast, decls[j]) == FunctionNodeType) {
+                addFunction(lowering, file, decls[j], SYMBOL_NONE, TYPE_ID_NONE, &capacity);
+                continue;
+            }
+            if (astKind(ast, decls[j]) != ImplNodeType) {
+                continue;
+            }
+
+            // Methods of generic structs are lowered with their instances.
+            const Symbol impl = astSymbol(ast, ast->data[decls[j]].a);
+            const Declaration *structDecl = findStruct(lowering, file->results->namespace, impl);
+            if (structDecl != nullptr && typeParameterCount(&structDecl->file->ast, structDecl->node) > 0) {
+                continue;
+            }
+
+            const TypeId type = structDecl != nullptr ? namedType(lowering->types, structDecl->namespace, impl)
+                                                      : TYPE_ID_NONE;
+            int methodCount;
+            const uint32_t *methods = astList(ast, ast->data[decls[j]].b, &methodCount);
+            for (int k = 0; k < methodCount; ++k) {
+                if (astKind(ast, methods[k]) == FunctionNodeType) {
+                    addFunction(lowering, file, methods[k], impl, type, &capacity);
+                }
+            }
+        }
+    }
+}
+
+// Names whose address is taken anywhere in the file, &x. Locals by those names live in stack slots.
+static void findAddressed(LoweredFile *file) {
+    const Ast *ast = &file->results->ast;
+    int capacity = 0;
+    for (int i = 0; i < ast->count; ++i) {
+        if (astKind(ast, i) != AddressOfNodeType || astKind(ast, ast->data[i].a) != IdentNodeType) {
+            continue;
+        }
+
+        if (file->addressedCount == capacity) {
+            file->addressed = (Symbol *)array_grow(file->addressed, &capacity, sizeof(Symbol));
+        }
+        file->addressed[file->addressedCount++] = astSymbol(ast, ast->data[ast->data[i].a].a);
+    }
+    if (file->addressedCount > 1) {
+        qsort(file->addressed, file->addressedCount, sizeof(Symbol), compareSymbols);
+    }
+}
+
+static void initLowering(Lowering *lowering, Program *program, CompilerConfig *config) {
+    memset(lowering, 0, sizeof(Lowering));
+    lowering->module = initIrModule(program, config);
+    lowering->program = program;
+    lowering->config = config;
+    lowering->types = program->types;
+
+    const int fileCount = program->fileCount;
+    lowering->files = (LoweredFile *)calloc(fileCount + 1, sizeof(LoweredFile));
+    uint32_t size = 16;
+    while (size < (uint32_t)fileCount * 2) {
+        size *= 2;
+    }
+    lowering->fileKeys = (const ParseResults **)calloc(size, sizeof(ParseResults *));
+    lowering->fileIndices = (int *)calloc(size, sizeof(int));
+    lowering->fileMask = size - 1;
+
+    for (int i = 0; i < fileCount; ++i) {
+        ParseResults *results = program->files[i];
+        lowering->files[i].results = results;
+        lowering->files[i].types = program->nodeTypes[i];
+        lowering->files[i].constants = program->constants != nullptr ? &program->constants[i] : nullptr;
+        findAddressed(&lowering->files[i]);
+
+        uint32_t at = pointerHash(results) & lowering->fileMask;
+        while (lowering->fileKeys[at] != nullptr) {
+            at = (at + 1) & lowering->fileMask;
+        }
+        lowering->fileKeys[at] = results;
+        lowering->fileIndices[at] = i;
+    }
+
+    lowering->len = intern(config->interner, "len", 3);
+    lowering->main = intern(config->interner, "main", 4);
+    lowering->this = intern(config->interner, "this", 4);
+}
+
+static void freeLowering(Lowering *lowering) {
+    for (int i = 0; i < lowering->program->fileCount; ++i) {
+        free(lowering->files[i].addressed);
+    }
+    free(lowering->functions);
+    free(lowering->fileIndices);
+    free(lowering->fileKeys);
+    free(lowering->files);
+}
+
+IrModule *lowerProgram(Program *program, CompilerConfig *config) {
+    if (program == nullptr || config == nullptr || config->interner == nullptr || program->types == nullptr) {
+        return nullptr;
+    }
+
+    const uint64_t start = timer_now_ns();
+    Lowering lowering;
+    initLowering(&lowering, program, config);
+    collectFunctions(&lowering);
+
+    const int count = lowering.module->functionCount;
+    FunctionLower *lowers = (FunctionLower *)calloc(count + 1, sizeof(FunctionLower));
+    for (int i = 0; i < count; ++i) {
+        FunctionLower *lower = &lowers[i];
+        const LoweredFunction *function = &lowering.functions[i];
+        initDiagnostics(&lower->diagnostics);
+        lower->lowering = &lowering;
+        lower->types = lowering.types;
+        lower->function = lowering.module->functions[i];
+        lower->index = i;
+        lower->file = fileOf(&lowering, lower->function->file);
+        lower->ast = &lower->function->file->ast;
+        lower->nodeTypes = lower->file->types;
+        lower->receiver = function->receiver;
+        lower->receiverType = function->receiverType;
+        lower->impl = function->receiver != RECEIVER_NONE ? lower->function->namespace : SYMBOL_NONE;
+    }
+
+    ThreadPool *pool = config->threadPool != nullptr ? config->threadPool : pool_new(config->threads);
+    TaskGroup group = TASK_GROUP_INIT;
+    for (int i = 0; i < count; ++i) {
+        pool_submit_group(pool, &group, lowerTask, &lowers[i]);
+    }
+    pool_wait_group(pool, &group);
+    if (pool != config->threadPool) {
+        pool_free(pool);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        program->times.lower += lowers[i].ns;
+        Lexer *lexer = nullptr;
+        program->errorCount += mergeDiagnostics(lowers[i].function->file, &lexer, &lowers[i].diagnostics);
+        if (lexer != nullptr) {
+            freeLexer(lexer);
+        }
+    }
+    program->times.loweredFunctions += count;
+    free(lowers);
+
+    IrModule *module = lowering.module;
+    freeLowering(&lowering);
+    program->runTime += (int)timer_elapsed_ms(start);
+    return module;
+}
@@ -0,0 +1,44 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_LOWER_H
+#define NIFTY_LOWER_H
+
+#include "common.h"
+#include "ir.h"
+#include "program.h"
+
+// Lowers every function body of a checked program to the IR, one task per body on the config's thread pool. Functions
+// are added to the module in the order checkProgram collects bodies, before any is lowered, so calls between them name
+// each other by index whichever finishes first.
+//
+// Locals are built into SSA form as they are lowered, with phis placed where control flow joins and removed again
+// where they turn out to pick the same value on every edge. Locals whose address is taken somewhere in their file, and
+// locals holding structs, arrays or values of an unknown type, live in stack slots instead.
+//
+// Generic functions, and the methods of generic structs, aren't lowered until their instances are; calls to them, like
+// calls to the nsl and to builtins, are IR_EXTERN. Programs with errors shouldn't be lowered. Values lowering can't give
+// a type, like names a file using a namespace the nsl doesn't have never declares, are errors of the program, and its
+// module is only good for freeing then.
+IrModule *lowerProgram(Program *program, CompilerConfig *config);
+
+#endif //NIFTY_LOWER_H
@@ -32,6 +32,7 @@
 #   include <unistd.h>
 #endif
 
+#include "bench.h"
 #include "project.h"
 #include "util/help.h"
 
@@ -47,6 +48,32 @@ static void printColors(const ProjectInfo *info) {
     printf(RESET_COLOR);
 }
 
+// Applies the --flags after build or run and returns the target, the first argument that isn't a flag.
+static const char *buildArgs(const int argc, char **argv, ProjectInfo *info) {
+    const char *target = nullptr;
+    for (int i = 2; i < argc; ++i) {
+        if (argv[i][0] != '-' || argv[i][1] != '-') {
+            target = target == nullptr ? argv[i] : target;
+        } else if (info == nullptr) {
+            continue;
+        } else if (str_eq(argv[i], "--json")) {
+            info->config.jsonDiagnostics = true;
+        } else if (str_eq(argv[i], "--time-report")) {
+            info->config.timeReport = true;
+        } else if (str_eq(argv[i], "--emit-ir")) {
+            info->config.emitIr = true;
+        } else if (str_eq(argv[i], "--remarks")) {
+            info->config.remarks = true;
+        } else if (str_eq(argv[i], "--vectorize-report")) {
+            info->config.vectorizeReport = true;
+        } else {
+            println("Unknown flag '%s'.", argv[i]);
+        }
+    }
+
+    return target;
+}
+
 int main(const int argc, char **argv) {
     const bool buildFileFound = access(NIFTY_BUILD_FILE, F_OK) == 0;
     ProjectInfo *projectInfo = nullptr;
@@ -85,13 +112,17 @@ int main(const int argc, char **argv) {
         } else if (str_eq2(cmd, "list", "-l")) {
             listTargets(projectInfo);
         } else if (str_eq2(cmd, "build", "-b")) {
-            build(argv[2], projectInfo);
+            build(buildArgs(argc, argv, projectInfo), projectInfo);
         } else if (str_eq2(cmd, "run", "-r")) {
-            run(argv[2], projectInfo);
+            run(buildArgs(argc, argv, projectInfo), projectInfo);
+        } else if (str_eq2(cmd, "clean", "-c")) {
+            clean(buildArgs(argc, argv, projectInfo), projectInfo);
         } else if (str_eq2(cmd, "new", "-n")) {
             newProject(buildFileFound);
         } else if (str_eq2(cmd, "test", "-t")) {
             println("test");
+        } else if (str_eq(cmd, "bench")) {
+            runBenchmark(argc - 2, argv + 2);
         } else if (str_eq(cmd, "colors")) {
             printColors(projectInfo);
         } else {
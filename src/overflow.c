@@ -0,0 +1,561 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "pass.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Overflow checks of + - * / % and unary - that can't fail are removed, and so are the checks of divisors that can't
+// be 0 and the saturation of @+ @- and @* that can't saturate, which leaves the wrapping operation. Whether they can
+// is from the range of each integer of up to 32 bits, an interval of the values it can have.
+//
+// Ranges come from the usual rules for constants and arithmetic, a checked result being in its type since the check
+// traps otherwise, and from the branches a block is only reached through: in the body of for (i in 0 ..< n), i < n,
+// so i + 1 can't overflow whatever n is, and i is in [0, 9] for a constant n of 10. Phis are the union of their
+// values, widened to their type when they keep growing around a loop, then narrowed again by a few more rounds.
+
+// Times a phi's range grows before it is widened to its type.
+#define WIDEN_AFTER 2
+// Rounds recomputing every range after they stop growing, each can only narrow them.
+#define NARROW_ROUNDS 2
+// Rounds of growing ranges before giving up on them, which only a bug in the widening reaches.
+#define MAX_ROUNDS 256
+// Dominators looked through for the branches a block is only reached through.
+#define REFINE_DEPTH 16
+
+typedef struct {
+    int64_t min;
+    int64_t max;
+} Range;
+
+typedef struct {
+    IrFunction *function;
+    IrBlock *idom;
+    IrBlock *order; // Reverse postorder.
+    int orderCount;
+    IrValue *checks; // The IR_CHECK_OVERFLOW of each value, else IR_NONE.
+    Range *ranges;
+    bool *known;
+    uint8_t *growth;
+} Ranges;
+
+// The values of type, false for types that aren't integers of up to 32 bits.
+static bool typeRange(const TypeId type, Range *range) {
+    static const struct {
+        TypeKind kind;
+        Range range;
+    } bounds[] = {
+        {TYPE_U8, {0, UINT8_MAX}},          {TYPE_U16, {0, UINT16_MAX}},        {TYPE_U32, {0, UINT32_MAX}},
+        {TYPE_S8, {INT8_MIN, INT8_MAX}},    {TYPE_S16, {INT16_MIN, INT16_MAX}}, {TYPE_S32, {INT32_MIN, INT32_MAX}},
+    };
+    for (int i = 0; i < (int)(sizeof(bounds) / sizeof(bounds[0])); ++i) {
+        if (type == primitiveType(bounds[i].kind)) {
+            *range = bounds[i].range;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool within(const Range range, const Range bounds) {
+    return range.min >= bounds.min && range.max <= bounds.max;
+}
+
+static Range clamp(const Range range, const Range bounds) {
+    Range result = {range.min < bounds.min ? bounds.min : range.min, range.max > bounds.max ? bounds.max : range.max};
+    if (result.min > result.max) {
+        result = bounds;
+    }
+    return result;
+}
+
+static int64_t min64(const int64_t a, const int64_t b) {
+    return a < b ? a : b;
+}
+
+static int64_t max64(const int64_t a, const int64_t b) {
+    return a > b ? a : b;
+}
+
+// a * b, held at the limits of int64_t, which ranges of up to 32 bits only reach for the largest u32 products.
+static int64_t mulClamped(const int64_t a, const int64_t b) {
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+
+    const bool negative = (a < 0) != (b < 0);
+    const uint64_t x = a < 0 ? (uint64_t)0 - (uint64_t)a : (uint64_t)a;
+    const uint64_t y = b < 0 ? (uint64_t)0 - (uint64_t)b : (uint64_t)b;
+    if (x > (uint64_t)INT64_MAX / y) {
+        return negative ? INT64_MIN : INT64_MAX;
+    }
+    return negative ? -(int64_t)(x * y) : (int64_t)(x * y);
+}
+
+// The range of a / b or a % b. b leaves out 0, which the divisor check before every division traps on.
+static bool division(const IrOp op, const Range a, const Range b, Range *result) {
+    if (b.min < 0 && b.max > 0) {
+        Range negative;
+        Range positive;
+        division(op, a, (Range){b.min, -1}, &negative);
+        division(op, a, (Range){1, b.max}, &positive);
+        *result = (Range){min64(negative.min, positive.min), max64(negative.max, positive.max)};
+        return true;
+    }
+    const Range divisor = {b.min == 0 ? 1 : b.min, b.max == 0 ? -1 : b.max};
+    if (divisor.min > divisor.max) {
+        return false;
+    }
+
+    if (op == IR_DIV) {
+        const int64_t corners[4] = {a.min / divisor.min, a.min / divisor.max, a.max / divisor.min,
+                                    a.max / divisor.max};
+        *result = (Range){corners[0], corners[0]};
+        for (int i = 1; i < 4; ++i) {
+            result->min = min64(result->min, corners[i]);
+            result->max = max64(result->max, corners[i]);
+        }
+        return true;
+    }
+
+    const int64_t most = max64(-divisor.min, divisor.max) - 1;
+    if (a.min >= 0) {
+        *result = (Range){0, min64(a.max, most)};
+    } else if (a.max <= 0) {
+        *result = (Range){max64(a.min, -most), 0};
+    } else {
+        *result = (Range){-most, most};
+    }
+    return true;
+}
+
+// The exact range of a op b, as if it couldn't overflow, false for ops it isn't known for.
+static bool arithmetic(const IrOp op, const Range a, const Range b, Range *result) {
+    switch (op) {
+        case IR_ADD:
+        case IR_ADD_SAT:
+            *result = (Range){a.min + b.min, a.max + b.max};
+            return true;
+        case IR_SUB:
+        case IR_SUB_SAT:
+            *result = (Range){a.min - b.max, a.max - b.min};
+            return true;
+        case IR_MUL:
+        case IR_MUL_SAT: {
+            const int64_t corners[4] = {mulClamped(a.min, b.min), mulClamped(a.min, b.max), mulClamped(a.max, b.min),
+                                        mulClamped(a.max, b.max)};
+            *result = (Range){corners[0], corners[0]};
+            for (int i = 1; i < 4; ++i) {
+                result->min = min64(result->min, corners[i]);
+                result->max = max64(result->max, corners[i]);
+            }
+            return true;
+        }
+        case IR_DIV:
+        case IR_MOD:
+            return division(op, a, b, result);
+        case IR_AND:
+            if (a.min < 0 && b.min < 0) {
+                return false;
+            }
+            *result = (Range){0, a.min >= 0 && b.min >= 0 ? min64(a.max, b.max) : a.min >= 0 ? a.max : b.max};
+            return true;
+        case IR_SHR:
+            if (a.min < 0 || b.min < 0 || b.max > 63) {
+                return false;
+            }
+            *result = (Range){a.min >> b.max, a.max >> b.min};
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The range of value where it is known, its type's if it isn't an integer ranges are kept for or isn't known yet.
+static bool rangeOf(const Ranges *ranges, const IrValue value, Range *range) {
+    if (!typeRange(irInst(ranges->function, value)->type, range)) {
+        return false;
+    }
+    if (ranges->known[value]) {
+        *range = ranges->ranges[value];
+    }
+    return true;
+}
+
+// Narrows range, of value, by cond being holds, true or not.
+static void refineBy(const Ranges *ranges, const IrValue cond, bool holds, const IrValue value, Range *range) {
+    const IrInst *inst = irInst(ranges->function, cond);
+    IrOp op = (IrOp)inst->op;
+    IrValue other = inst->b;
+    while (op == IR_NOT) {
+        holds = !holds;
+        inst = irInst(ranges->function, inst->a);
+        op = (IrOp)inst->op;
+        other = inst->b;
+    }
+    if (op < IR_EQ || op > IR_GE) {
+        return;
+    }
+
+    // As value op other.
+    if (inst->b == value && inst->a != value) {
+        static const IrOp mirrored[] = {IR_EQ, IR_NE, IR_GT, IR_GE, IR_LT, IR_LE};
+        op = mirrored[op - IR_EQ];
+        other = inst->a;
+    } else if (inst->a != value) {
+        return;
+    }
+    if (!holds) {
+        static const IrOp negated[] = {IR_NE, IR_EQ, IR_GE, IR_GT, IR_LE, IR_LT};
+        op = negated[op - IR_EQ];
+    }
+
+    Range bound;
+    if (!rangeOf(ranges, other, &bound)) {
+        return;
+    }
+    switch (op) {
+        case IR_EQ:
+            range->min = max64(range->min, bound.min);
+            range->max = min64(range->max, bound.max);
+            break;
+        case IR_LT:
+            range->max = min64(range->max, bound.max - 1);
+            break;
+        case IR_LE:
+            range->max = min64(range->max, bound.max);
+            break;
+        case IR_GT:
+            range->min = max64(range->min, bound.min + 1);
+            break;
+        case IR_GE:
+            range->min = max64(range->min, bound.min);
+            break;
+        default:
+            break;
+    }
+}
+
+// The range of value in block, narrowed by the branches block is only reached through.
+static bool rangeIn(const Ranges *ranges, const IrValue value, IrBlock block, Range *range) {
+    if (!rangeOf(ranges, value, range)) {
+        return false;
+    }
+
+    const IrFunction *function = ranges->function;
+    Range refined = *range;
+    for (int depth = 0; depth < REFINE_DEPTH && block != 0 && ranges->idom[block] != IR_NO_BLOCK; ++depth) {
+        const IrBlock parent = ranges->idom[block];
+        const IrValue branch = irTerminator(function, parent);
+        if (branch != IR_NONE && irInst(function, branch)->op == IR_BRANCH && function->blocks[block].predCount == 1) {
+            const IrInst *inst = irInst(function, branch);
+            const IrBlock then = function->extra[inst->b];
+            if (then != function->extra[inst->b + 1]) {
+                refineBy(ranges, inst->a, block == then, value, &refined);
+            }
+        }
+        block = parent;
+    }
+
+    // A branch that can't be taken leaves nothing, which only unreachable code sees.
+    if (refined.min <= refined.max) {
+        *range = refined;
+    }
+    return true;
+}
+
+// The range of value from its operands, false if it isn't one ranges are kept for or none of them are known yet.
+static bool transfer(const Ranges *ranges, const IrValue value, const bool widen, Range *result) {
+    const IrFunction *function = ranges->function;
+    const IrInst *inst = irInst(function, value);
+    Range type;
+    if (!typeRange(inst->type, &type)) {
+        return false;
+    }
+
+    *result = type;
+    Range a;
+    Range b;
+    Constant constant;
+    switch ((IrOp)inst->op) {
+        case IR_INT:
+            if (irConstant(function, value, &constant)) {
+                *result = (Range){(int64_t)constant.low, (int64_t)constant.low};
+            }
+            break;
+        case IR_LEN:
+            *result = (Range){0, type.max};
+            break;
+        case IR_CONVERT:
+            if (rangeIn(ranges, inst->a, inst->block, &a) && within(a, type)) {
+                *result = a;
+            }
+            break;
+        case IR_NEG:
+            if (rangeIn(ranges, inst->a, inst->block, &a) &&
+                (ranges->checks[value] != IR_NONE || within((Range){-a.max, -a.min}, type))) {
+                *result = clamp((Range){-a.max, -a.min}, type);
+            }
+            break;
+        case IR_PHI: {
+            int count;
+            const uint32_t *operands = irList(function, inst->a, &count);
+            const IrBlockData *block = &function->blocks[inst->block];
+            bool any = false;
+            for (int i = 0; i < count && i < block->predCount; ++i) {
+                // Values not reached yet, from back edges, are left out until they are.
+                if (ranges->known[operands[i]]) {
+                    rangeIn(ranges, operands[i], block->preds[i], &a);
+                    *result = any ? (Range){min64(result->min, a.min), max64(result->max, a.max)} : a;
+                    any = true;
+                }
+            }
+            if (!any) {
+                return false;
+            }
+
+            // While widening a phi only grows, else one narrowed by its refined operands would grow and be widened
+            // again without end.
+            const Range old = ranges->ranges[value];
+            if (widen && ranges->known[value]) {
+                *result = (Range){min64(result->min, old.min), max64(result->max, old.max)};
+            }
+            if (widen && ranges->known[value] && ranges->growth[value] >= WIDEN_AFTER) {
+                result->min = result->min < old.min ? type.min : result->min;
+                result->max = result->max > old.max ? type.max : result->max;
+            }
+            *result = clamp(*result, type);
+            break;
+        }
+        default:
+            if (inst->op >= IR_ADD && inst->op <= IR_AND && rangeIn(ranges, inst->a, inst->block, &a) &&
+                rangeIn(ranges, inst->b, inst->block, &b) && arithmetic((IrOp)inst->op, a, b, result)) {
+                // A checked result traps unless it fits, a saturated one is held in the type.
+                const bool held = ranges->checks[value] != IR_NONE || inst->op == IR_ADD_SAT ||
+                                  inst->op == IR_SUB_SAT || inst->op == IR_MUL_SAT;
+                *result = held || within(*result, type) ? clamp(*result, type) : type;
+            }
+            break;
+    }
+
+    return true;
+}
+
+// Runs over the blocks in reverse postorder until no range changes, widening phis when widen is set.
+static bool propagate(Ranges *ranges, const bool widen) {
+    IrFunction *function = ranges->function;
+    bool changed = false;
+    for (int o = 0; o < ranges->orderCount; ++o) {
+        const IrBlockData *block = &function->blocks[ranges->order[o]];
+        for (int i = 0; i < block->count; ++i) {
+            const IrValue value = block->insts[i];
+            Range range;
+            if (!transfer(ranges, value, widen, &range)) {
+                continue;
+            }
+
+            const Range old = ranges->ranges[value];
+            if (!ranges->known[value] || range.min != old.min || range.max != old.max) {
+                const bool grew = ranges->known[value] && (range.min < old.min || range.max > old.max);
+                if (grew && ranges->growth[value] < UINT8_MAX) {
+                    ++ranges->growth[value];
+                }
+                ranges->ranges[value] = range;
+                ranges->known[value] = true;
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+static void findRanges(Ranges *ranges) {
+    IrFunction *function = ranges->function;
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            const IrInst *inst = irInst(function, block->insts[i]);
+            if (inst->op == IR_CHECK_OVERFLOW) {
+                ranges->checks[inst->a] = block->insts[i];
+            }
+        }
+    }
+
+    int rounds = 0;
+    while (rounds < MAX_ROUNDS && propagate(ranges, true)) {
+        ++rounds;
+    }
+    if (rounds == MAX_ROUNDS) {
+        // Ranges that haven't settled aren't sound, every value is left to its type.
+        memset(ranges->known, 0, sizeof(bool) * (function->instCount + 1));
+        return;
+    }
+    for (int i = 0; i < NARROW_ROUNDS && propagate(ranges, false); ++i) {
+    }
+}
+
+static void remark(IrModule *module, const int f, const IrInst *inst, const char *text, const Range *range) {
+    if (range != nullptr) {
+        addIrRemark(module, "overflow", f, inst->offset, text, irOpName((IrOp)inst->op), (long long)range->min,
+                    (long long)range->max);
+    } else {
+        addIrRemark(module, "overflow", f, inst->offset, text);
+    }
+}
+
+// The exact range of the checked arithmetic, false if it isn't known. Sets quotient to whether the quotient of a % fits
+// its type, which MIN % -1 fails on while its remainder is 0.
+static bool checkedRange(const Ranges *ranges, const IrInst *arith, const IrBlock block, const Range type,
+                         Range *exact, bool *quotient) {
+    Range left;
+    Range right;
+    *quotient = true;
+    if (!rangeIn(ranges, arith->a, block, &left)) {
+        return false;
+    }
+    if (arith->op == IR_NEG) {
+        *exact = (Range){-left.max, -left.min};
+        return true;
+    }
+    if (!rangeIn(ranges, arith->b, block, &right) || !arithmetic((IrOp)arith->op, left, right, exact)) {
+        return false;
+    }
+
+    Range divided;
+    if (arith->op == IR_MOD) {
+        *quotient = arithmetic(IR_DIV, left, right, &divided) && within(divided, type);
+    }
+    return true;
+}
+
+// Removes the divisor check if the divisor can't be 0.
+static int divisorCheck(IrModule *module, const int f, const Ranges *ranges, const IrBlock block, const IrValue check) {
+    IrFunction *function = ranges->function;
+    const IrInst *inst = irInst(function, check);
+    Range divisor;
+    if (!rangeIn(ranges, inst->a, block, &divisor) || (divisor.min <= 0 && divisor.max >= 0)) {
+        addIrRemark(module, "overflow", f, inst->offset, "divisor check kept, the divisor can be 0");
+        return 0;
+    }
+
+    addIrRemark(module, "overflow", f, inst->offset, "divisor check removed, the divisor is in [%lld, %lld]",
+                (long long)divisor.min, (long long)divisor.max);
+    removeIrInst(function, check, IR_NONE);
+    return 1;
+}
+
+// Removes the overflow checks and saturation of one function that can't happen, returns how many.
+static int overflowChecks(IrModule *module, const int f) {
+    IrFunction *function = module->functions[f];
+    const int instCount = function->instCount;
+    Ranges ranges = {function, nullptr, nullptr, 0, nullptr, nullptr, nullptr, nullptr};
+    ranges.idom = (IrBlock *)malloc(sizeof(IrBlock) * (function->blockCount + 1));
+    ranges.order = (IrBlock *)malloc(sizeof(IrBlock) * (function->blockCount + 1));
+    ranges.checks = (IrValue *)calloc(instCount + 1, sizeof(IrValue));
+    ranges.ranges = (Range *)calloc(instCount + 1, sizeof(Range));
+    ranges.known = (bool *)calloc(instCount + 1, sizeof(bool));
+    ranges.growth = (uint8_t *)calloc(instCount + 1, sizeof(uint8_t));
+    irDominators(function, ranges.idom);
+    ranges.orderCount = irPostorder(function, ranges.order);
+    for (int i = 0, j = ranges.orderCount - 1; i < j; ++i, --j) {
+        const IrBlock block = ranges.order[i];
+        ranges.order[i] = ranges.order[j];
+        ranges.order[j] = block;
+    }
+    findRanges(&ranges);
+
+    int changes = 0;
+    for (int o = 0; o < ranges.orderCount; ++o) {
+        const IrBlock b = ranges.order[o];
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count; ++i) {
+            IrInst *inst = irInst(function, block->insts[i]);
+            const IrOp op = (IrOp)inst->op;
+            const bool saturated = op == IR_ADD_SAT || op == IR_SUB_SAT || op == IR_MUL_SAT;
+            if (op == IR_CHECK_DIVISOR) {
+                changes += divisorCheck(module, f, &ranges, b, block->insts[i]);
+                continue;
+            }
+            if (op != IR_CHECK_OVERFLOW && !saturated) {
+                continue;
+            }
+
+            IrInst *arith = op == IR_CHECK_OVERFLOW ? irInst(function, inst->a) : inst;
+            Range type;
+            Range exact;
+            bool quotient;
+            if (!typeRange(arith->type, &type) || !checkedRange(&ranges, arith, b, type, &exact, &quotient)) {
+                if (!saturated) {
+                    remark(module, f, inst, "overflow check kept", nullptr);
+                }
+                continue;
+            }
+
+            if (!within(exact, type)) {
+                if (!saturated) {
+                    remark(module, f, arith, "overflow check kept, %s can be anywhere in [%lld, %lld]", &exact);
+                }
+                continue;
+            }
+            if (!quotient) {
+                addIrRemark(module, "overflow", f, arith->offset, "overflow check kept, it can be MIN %% -1");
+                continue;
+            }
+
+            if (saturated) {
+                remark(module, f, arith, "saturation removed, %s is in [%lld, %lld]", &exact);
+                arith->op = op == IR_ADD_SAT ? IR_ADD : op == IR_SUB_SAT ? IR_SUB : IR_MUL;
+            } else {
+                remark(module, f, arith, "overflow check removed, %s is in [%lld, %lld]", &exact);
+                removeIrInst(function, block->insts[i], IR_NONE);
+            }
+            ++changes;
+        }
+    }
+
+    free(ranges.growth);
+    free(ranges.known);
+    free(ranges.ranges);
+    free(ranges.checks);
+    free(ranges.order);
+    free(ranges.idom);
+    if (changes > 0) {
+        compactIrFunction(function);
+    }
+    return changes;
+}
+
+int removeOverflowChecks(IrModule *module, StrBuffer *errors) {
+    (void)errors;
+
+    int changes = 0;
+    for (int f = 0; f < module->functionCount; ++f) {
+        if (module->functions[f]->blockCount > 0) {
+            changes += overflowChecks(module, f);
+        }
+    }
+
+    return changes;
+}
@@ -22,118 +22,84 @@
 
 #include "parser.h"
 
+#include <stdio.h>
 #include <stdlib.h>
-#include <__stdarg_va_arg.h>
+#include <string.h>
 
 #include "util/str.h"
 
-void errorStart(Parser *parser) {
-    ParseResults *ast = parser->results;
-    ast->errorCount++;
-    parser->panicMode = true;
-
-    printf("%s:L%d,C%d: ", ast->file, parser->current.line, parser->current.pos);
-    setTextColor(parser->compilerConfig, ERROR_COLOR);
-    printf("Parse error: ");
-    setTextColor(parser->compilerConfig, RESET_COLOR);
-}
-
-void warnStart(const Parser *parser) {
-    ParseResults *ast = parser->results;
-    ast->errorCount++;
-
-    printf("%s:L %d,C%d: ", ast->file, parser->current.line, parser->current.pos);
-    setTextColor(parser->compilerConfig, WARN_COLOR);
-    printf("Warning: ");
-    setTextColor(parser->compilerConfig, RESET_COLOR);
-}
-
-static void printLineWithError(const Parser *parser, const Token *token) {
-    char *line = str_get_line(parser->lexer->source, token->line, nullptr);
-
-    int width = 3;
-    for (int n = token->line; n > 0; n /= 10, ++width) {}
+// Errors are recorded in the results and rendered by the caller once every file is parsed.
+static void report(Parser *parser, const Token *token, const DiagnosticId id, const char *arg0, const char *arg1,
+                   const char *arg2) {
+    // Only the first error until the parser gets back in sync.
+    if (parser->panicMode) {
+        return;
+    }
 
-    setTextColor(parser->compilerConfig, LINE_COLOR);
-    printf("%d | ", token->line);
-    setTextColor(parser->compilerConfig, RESET_COLOR);
-    println("%s", line);
-    setTextColor(parser->compilerConfig, LINE_COLOR);
+    parser->results->errorCount++;
+    parser->panicMode = true;
 
-    int i = 0;
-    for (; i < width - 2; ++i) {
-        printf(" ");
-    }
-    printf("| ");
-    for (; i - width + 3 < token->pos; ++i) {
-        printf("~");
-    }
-    println("^");
-    setTextColor(parser->compilerConfig, RESET_COLOR);
+    // Error tokens carry their message instead of their source length.
+    const uint32_t length = token->type == TK_INTERNAL_ERROR ? 1 : (uint32_t)token->len;
+    reportDiagnostic(&parser->results->diagnostics, parser->lexer, SEVERITY_ERROR, id, token->offset, length, arg0,
+                     arg1, arg2);
 }
 
 static void expectedAfter(Parser *parser, const char *expected, const char *after) {
-    errorStart(parser);
-    printf("Expected ");
-    setTextColor(parser->compilerConfig, HIGHLIGHT_COLOR);
-    printf("%s", expected);
-    setTextColor(parser->compilerConfig, RESET_COLOR);
-    printf(" after ");
-    setTextColor(parser->compilerConfig, HIGHLIGHT_COLOR);
-    printf("%s", after);
-    setTextColor(parser->compilerConfig, RESET_COLOR);
-    printf(", got ");
-    setTextColor(parser->compilerConfig, HIGHLIGHT_COLOR);
-    printf("%.*s", parser->current.len, parser->current.lexeme);
-    setTextColor(parser->compilerConfig, RESET_COLOR);
-    println(" instead.");
-    printLineWithError(parser, &parser->current);
+    char got[64];
+    snprintf(got, sizeof(got), "%.*s", parser->current.len, parser->current.lexeme);
+    report(parser, &parser->current, DIAG_EXPECTED_AFTER, expected, after, got);
 }
 
 static void errorAt(Parser *parser, const Token *token, const char *msg) {
-    errorStart(parser);
-    println(msg);
-    printLineWithError(parser, token);
+    report(parser, token, DIAG_SYNTAX, msg, nullptr, nullptr);
 }
 
 static void errorAtCurrent(Parser *parser, const char *msg) {
     errorAt(parser, &parser->current, msg);
 }
 
-static void errorAtCurrentf(Parser *parser, const char *msg, ...) {
-    char *buf = (char *)malloc(sizeof(char) * 1024);
-    va_list args;
-    va_start(args, msg);
-    vsprintf(buf, msg, args);
-    va_end(args);
+static NodeIndex addNode(const Parser *parser, const NodeKind kind, const uint32_t offset, const uint32_t a,
+                         const uint32_t b) {
+    return addAstNode(&parser->results->ast, kind, offset, a, b);
+}
 
-    errorAt(parser, &parser->current, buf);
-    free(buf);
+static uint32_t addExtra2(const Parser *parser, const uint32_t first, const uint32_t second) {
+    const uint32_t words[2] = {first, second};
+    return addAstExtra(&parser->results->ast, words, 2);
 }
 
-static Node *newNode(const Parser *parser, const NodeKind kind) {
-    Node *node = (Node *)malloc(sizeof(Node));
-    node->location.line = parser->current.line;
-    node->location.pos = parser->current.pos;
-    node->kind = kind;
+static uint32_t addExtra3(const Parser *parser, const uint32_t first, const uint32_t second, const uint32_t third) {
+    const uint32_t words[3] = {first, second, third};
+    return addAstExtra(&parser->results->ast, words, 3);
+}
 
-    return node;
+static uint32_t addExtra4(const Parser *parser, const uint32_t first, const uint32_t second, const uint32_t third,
+                          const uint32_t fourth) {
+    const uint32_t words[4] = {first, second, third, fourth};
+    return addAstExtra(&parser->results->ast, words, 4);
 }
 
-static void addNode(const Parser *parser, Node *node) {
-    if (parser->results->nodes.count + 1 >= parser->results->nodes.capacity) {
-        parser->results->nodes.capacity *= 2;
-        parser->results->nodes.list = (Node**)malloc(sizeof(Node) * parser->results->nodes.capacity);
+static void pushScratch(Parser *parser, const uint32_t item) {
+    if (parser->scratchCount == parser->scratchCapacity) {
+        parser->scratchCapacity = parser->scratchCapacity == 0 ? 64 : parser->scratchCapacity * 2;
+        parser->scratch = (uint32_t *)realloc(parser->scratch, sizeof(uint32_t) * parser->scratchCapacity);
     }
 
-    parser->results->nodes.list[parser->results->nodes.count++] = node;
+    parser->scratch[parser->scratchCount++] = item;
 }
 
-static void freeNodes(const Nodes nodes) {
-    for (int i = 0; i < nodes.count; ++i) {
-        free(nodes.list[i]);
-    }
-    free(nodes.list);
+// Moves everything pushed since top into a list in extra.
+static uint32_t finishList(Parser *parser, const int top) {
+    const uint32_t list = addAstList(&parser->results->ast, parser->scratch + top, parser->scratchCount - top);
+    parser->scratchCount = top;
+
+    return list;
+}
+
+void freeParseSource(ParseResults *results) {
+    freeLexer(results->lexer);
+    results->lexer = nullptr;
 }
 
 void freeParseResults(ParseResults *results) {
@@ -141,13 +107,54 @@ void freeParseResults(ParseResults *results) {
         return;
     }
 
-    freeNodes(results->nodes);
+    freeParseSource(results);
+    freeAst(&results->ast);
+    freeDiagnostics(&results->diagnostics);
+    arena_free(&results->arena);
     free(results);
 }
 
+static Token tokenAt(const Parser *parser, const int index) {
+    const TokenStream *tokens = parser->tokens;
+
+    Token token;
+    token.type = (NiftyTokenType)tokens->kinds[index];
+    token.symbol = tokens->symbols != nullptr ? tokens->symbols[index] : SYMBOL_NONE;
+    token.len = (int)tokens->lengths[index];
+    token.offset = tokens->offsets[index];
+    token.lexeme = parser->lexer->source + token.offset;
+
+    if (token.type == TK_INTERNAL_ERROR) {
+        token.lexeme = tokenErrorMessage(tokens, index);
+        token.len = str_len(token.lexeme);
+    }
+
+    return token;
+}
+
+// Reads the token after current into next.
+static void pull(Parser *parser) {
+    if (parser->tokens == nullptr) {
+        parser->next = nextToken(parser->lexer);
+        if (parser->next.type == TK_NUMBER) {
+            parser->nextNumber = parser->lexer->number;
+        }
+    } else if (parser->tokenIndex < parser->tokens->count) {
+        parser->next = tokenAt(parser, parser->tokenIndex++);
+        if (parser->next.type == TK_NUMBER) {
+            parser->nextNumber = parser->tokens->numbers[parser->numberIndex++];
+        }
+    }
+}
+
 static void advance(Parser *parser) {
+    // Error tokens carry their message instead of their source length.
+    if (parser->current.type != TK_INTERNAL_ERROR) {
+        parser->previousEnd = parser->current.offset + (uint32_t)parser->current.len;
+    }
     parser->current = parser->next;
-    parser->next = nextToken(parser->lexer);
+    parser->currentNumber = parser->nextNumber;
+    pull(parser);
 }
 
 static void eat(Parser *parser, const NiftyTokenType tokenType, const char *msg) {
@@ -159,7 +166,36 @@ static void eat(Parser *parser, const NiftyTokenType tokenType, const char *msg)
     errorAtCurrent(parser, msg);
 }
 
-static Parser *initParser(const char *file, CompilerConfig *config) {
+static void startParser(Parser *parser, ParseResults *results, Lexer *lexer, CompilerConfig *config) {
+    parser->hadError = false;
+    parser->panicMode = false;
+    parser->skippedBodies = 0;
+    parser->currentImpl = 0;
+    parser->namespace = SYMBOL_NONE;
+    parser->namespaceOffset = 0;
+    parser->results = results;
+    parser->compilerConfig = config;
+    parser->lexer = lexer;
+    parser->tokens = nullptr;
+    parser->tokenIndex = 0;
+    parser->numberIndex = 0;
+    parser->previousEnd = 0;
+    parser->noStructLiteral = false;
+    parser->nesting = 0;
+    parser->scratch = nullptr;
+    parser->scratchCount = 0;
+    parser->scratchCapacity = 0;
+    parser->localKeys = nullptr;
+    parser->localValues = nullptr;
+    parser->localCount = 0;
+    parser->localCapacity = 0;
+
+    if (lexer != nullptr && config->interner != nullptr) {
+        lexerIntern(lexer, config->interner);
+    }
+}
+
+static Parser *initParser(const char *file, Lexer *lexer, CompilerConfig *config) {
     Parser *parser = (Parser*)malloc(sizeof(Parser));
     ParseResults *results = (ParseResults*)malloc(sizeof(ParseResults));
 
@@ -168,28 +204,41 @@ static Parser *initParser(const char *file, CompilerConfig *config) {
         return nullptr;
     }
 
+    arena_init(&results->arena, 0);
     results->errorCount = 0;
-    results->nodes.count = 0;
-    results->nodes.capacity = 32;
-    results->nodes.list = (Node**)malloc(sizeof(Node) * 32);
-    results->file = str_new(file, nullptr);
+    initDiagnostics(&results->diagnostics);
+    results->namespace = SYMBOL_NONE;
+    results->file = arena_str(&results->arena, file, str_len(file));
+    results->lexer = nullptr;
 
-    parser->hadError = false;
-    parser->panicMode = false;
-    parser->currentImpl = nullptr;
-    parser->namespace.name = nullptr;
-    parser->namepsaceLine = -1;
-    parser->results = results;
-    parser->compilerConfig = config;
-    parser->lexer = initLexer(file);
-    parser->next = nextToken(parser->lexer);
+    startParser(parser, results, lexer, config);
+    if (parser->lexer == nullptr) {
+        initAst(&results->ast, 0);
+        return parser;
+    }
+
+    if (!config->streamingLexer) {
+        parser->tokens = tokenizeFileParallel(parser->lexer, config->threadPool);
+    }
+
+    // About one node for every two tokens, or every eight bytes of source when the token count isn't known yet.
+    initAst(&results->ast, parser->tokens != nullptr ? parser->tokens->count / 2 : (int)(parser->lexer->length / 8));
+
+    parser->current.type = TK_UNKNOWN;
+    parser->current.offset = 0;
+    parser->current.len = 0;
+    pull(parser);
     advance(parser);
 
     return parser;
 }
 
 static void freeParser(Parser *parser) {
+    freeTokenStream(parser->tokens);
     freeLexer(parser->lexer);
+    free(parser->scratch);
+    free(parser->localKeys);
+    free(parser->localValues);
     free(parser);
 }
 
@@ -197,6 +246,10 @@ static bool check(const Parser *parser, const NiftyTokenType tokenType) {
     return parser->current.type == tokenType;
 }
 
+static bool checkNext(const Parser *parser, const NiftyTokenType tokenType) {
+    return parser->next.type == tokenType;
+}
+
 static bool match(Parser *parser, const NiftyTokenType tokenType) {
     if (!check(parser, tokenType)) {
         return false;
@@ -206,107 +259,1792 @@ static bool match(Parser *parser, const NiftyTokenType tokenType) {
     return true;
 }
 
+// Whether a line break separates current from the token before it.
+static bool newlineBefore(const Parser *parser) {
+    const uint32_t start = parser->previousEnd;
+    const uint32_t end = parser->current.offset;
+
+    return end > start && memchr(parser->lexer->source + start, '\n', end - start) != nullptr;
+}
+
+// Statements end at line breaks, except inside parentheses and brackets.
+static bool lineEnds(const Parser *parser) {
+    return parser->nesting == 0 && newlineBefore(parser);
+}
+
+// Identifiers and keywords, which can name methods and members: md new(), x.len().
+static bool isName(const NiftyTokenType type) {
+    return type == TK_IDENT || (type > TK_UNKNOWN && type < TK_COLON);
+}
+
+static bool identIs(const Parser *parser, const char *name, const int len) {
+    return check(parser, TK_IDENT) && parser->current.len == len && memcmp(parser->current.lexeme, name, len) == 0;
+}
+
+// Skips to the start of the next statement after an error: the first token on a new line outside of brackets, or the
+// '}' closing the block.
+static void synchronize(Parser *parser) {
+    parser->panicMode = false;
+
+    int depth = 0;
+    for (bool first = true; !check(parser, TK_EOF); first = false) {
+        if (depth == 0 && !first && newlineBefore(parser)) {
+            return;
+        }
+
+        if (check(parser, TK_LPAREN) || check(parser, TK_LBRACKET) || check(parser, TK_LBRACE)) {
+            ++depth;
+        } else if (check(parser, TK_RPAREN) || check(parser, TK_RBRACKET) || check(parser, TK_RBRACE)) {
+            if (depth == 0 && check(parser, TK_RBRACE)) {
+                return;
+            }
+            depth = depth > 0 ? depth - 1 : 0;
+        }
+        advance(parser);
+    }
+}
+
+// Index of symbol in the file's names, added on first use. SYMBOL_NONE is always index 0.
+static uint32_t localSymbol(Parser *parser, const Symbol symbol) {
+    if (symbol == SYMBOL_NONE) {
+        return 0;
+    }
+
+    if (parser->localCount * 2 >= parser->localCapacity) {
+        const int capacity = parser->localCapacity == 0 ? 256 : parser->localCapacity * 2;
+        Symbol *keys = (Symbol *)calloc(capacity, sizeof(Symbol));
+        uint32_t *values = (uint32_t *)malloc(sizeof(uint32_t) * capacity);
+        for (int i = 0; i < parser->localCapacity; ++i) {
+            if (parser->localKeys[i] == SYMBOL_NONE) {
+                continue;
+            }
+
+            uint32_t slot = (parser->localKeys[i] * 2654435761u) & (uint32_t)(capacity - 1);
+            while (keys[slot] != SYMBOL_NONE) {
+                slot = (slot + 1) & (uint32_t)(capacity - 1);
+            }
+            keys[slot] = parser->localKeys[i];
+            values[slot] = parser->localValues[i];
+        }
+
+        free(parser->localKeys);
+        free(parser->localValues);
+        parser->localKeys = keys;
+        parser->localValues = values;
+        parser->localCapacity = capacity;
+    }
+
+    const uint32_t mask = (uint32_t)(parser->localCapacity - 1);
+    uint32_t slot = (symbol * 2654435761u) & mask;
+    while (parser->localKeys[slot] != SYMBOL_NONE) {
+        if (parser->localKeys[slot] == symbol) {
+            return parser->localValues[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    parser->localKeys[slot] = symbol;
+    parser->localValues[slot] = addAstSymbol(&parser->results->ast, symbol);
+    ++parser->localCount;
+
+    return parser->localValues[slot];
+}
+
 static void namespaceDeclaration(Parser *parser) {
-    if (parser->namespace.name != nullptr) {
-        errorAtCurrentf(parser, "Namespace already set on line %d.", parser->namepsaceLine);
+    if (parser->namespace != SYMBOL_NONE) {
+        char line[16];
+        snprintf(line, sizeof(line), "%d", lexerLocation(parser->lexer, parser->namespaceOffset).line);
+        report(parser, &parser->current, DIAG_NAMESPACE_SET, line, nullptr, nullptr);
         return;
     }
 
-    parser->namepsaceLine = parser->current.line;
+    parser->namespaceOffset = parser->current.offset;
 
     if (!check(parser, TK_IDENT)) {
         expectedAfter(parser, "identifier", "namespace");
         return;
     }
 
-    parser->namespace.name = str_new_len(parser->current.lexeme, parser->current.len);
+    parser->namespace = parser->current.symbol;
+    parser->results->namespace = parser->current.symbol;
+    localSymbol(parser, parser->current.symbol); // Kept with the file's names for the AST cache.
+    advance(parser);
+}
+
+// Index of token's name in the file's names. Type keywords aren't interned by the lexer.
+static uint32_t tokenSymbol(Parser *parser, const Token *token) {
+    if (token->symbol != SYMBOL_NONE || parser->compilerConfig->interner == nullptr) {
+        return localSymbol(parser, token->symbol);
+    }
+
+    return localSymbol(parser, intern(parser->compilerConfig->interner, token->lexeme, token->len));
+}
+
+static TypeKind typeKindOf(const NiftyTokenType type) {
+    switch (type) {
+        case TK_U8: return TYPE_U8;
+        case TK_U16: return TYPE_U16;
+        case TK_U32: return TYPE_U32;
+        case TK_U64: return TYPE_U64;
+        case TK_U128: return TYPE_U28;
+        case TK_S8: return TYPE_S8;
+        case TK_S16: return TYPE_S16;
+        case TK_S32: return TYPE_S32;
+        case TK_S64: return TYPE_S64;
+        case TK_S128: return TYPE_S28;
+        case TK_F16: return TYPE_F16;
+        case TK_F32: return TYPE_F32;
+        case TK_F64: return TYPE_F64;
+        case TK_F128: return TYPE_F128;
+        case TK_B8: return TYPE_B8;
+        case TK_B16: return TYPE_B16;
+        case TK_B32: return TYPE_B32;
+        case TK_B64: return TYPE_B64;
+        case TK_STRING_TYPE: return TYPE_STRING;
+        case TK_CHAR_TYPE: return TYPE_CHAR;
+        case TK_UINTPTR: return TYPE_UINTPTR;
+        case TK_TYPEID: return TYPE_TYPE_ID;
+        case TK_ANY_TYPE: return TYPE_ANY;
+        case TK_VOID: return TYPE_VOID;
+        default: return TYPE_NONE; // int, float and the other aliases are resolved later.
+    }
+}
+
+static bool isTypeKeyword(const NiftyTokenType type) {
+    return type >= TK_INT && type <= TK_ANY_TYPE;
+}
+
+// Skips a bracketed group, current is its opening token.
+static void skipGroup(Parser *parser) {
+    int depth = 0;
+    do {
+        if (check(parser, TK_LPAREN) || check(parser, TK_LBRACKET) || check(parser, TK_LBRACE)) {
+            ++depth;
+        } else if (check(parser, TK_RPAREN) || check(parser, TK_RBRACKET) || check(parser, TK_RBRACE)) {
+            --depth;
+        }
+        advance(parser);
+    } while (depth > 0 && !check(parser, TK_EOF));
+}
+
+// Skips generic parameters or arguments, <T>, <T: #number> or <Vec<T>>.
+static void skipAngles(Parser *parser) {
+    int depth = 0;
+    do {
+        if (check(parser, TK_LT)) {
+            ++depth;
+        } else if (check(parser, TK_GR)) {
+            --depth;
+        } else if (check(parser, TK_LSR)) {
+            depth -= 2;
+        }
+        advance(parser);
+    } while (depth > 0 && !check(parser, TK_EOF));
+}
+
+// Names of generic parameters as a list, current is the '<'. Constraints, <T: int | float> or <N: #number>, are
+// skipped for now.
+static uint32_t typeParameters(Parser *parser) {
+    const int top = parser->scratchCount;
+    advance(parser);
+    while (check(parser, TK_IDENT)) {
+        pushScratch(parser, tokenSymbol(parser, &parser->current));
+        advance(parser);
+
+        int depth = 0;
+        while (!check(parser, TK_EOF) && (depth > 0 || (!check(parser, TK_COMMA) && !check(parser, TK_GR)))) {
+            if (check(parser, TK_LT)) {
+                ++depth;
+            } else if (check(parser, TK_GR)) {
+                --depth;
+            } else if (check(parser, TK_LSR)) {
+                depth -= 2;
+            }
+            advance(parser);
+        }
+        if (!match(parser, TK_COMMA)) {
+            break;
+        }
+    }
+    eat(parser, TK_GR, "Expected > after the type parameters.");
+
+    return finishList(parser, top);
+}
+
+// Skips the rest of the line, for declarations the parser doesn't build nodes for yet.
+static void skipLine(Parser *parser) {
+    do {
+        if (check(parser, TK_LPAREN) || check(parser, TK_LBRACKET) || check(parser, TK_LBRACE)) {
+            skipGroup(parser);
+        } else {
+            advance(parser);
+        }
+    } while (!check(parser, TK_EOF) && !newlineBefore(parser));
+}
+
+// Adds a UseNodeType for path, ending the use with its alias if it has one.
+static void addUse(Parser *parser, const uint32_t offset, const char *path, const int len, const UseFlags flags) {
+    const uint32_t name = parser->compilerConfig->interner != nullptr
+                              ? localSymbol(parser, intern(parser->compilerConfig->interner, path, len))
+                              : 0;
+
+    uint32_t alias = 0;
+    if (check(parser, TK_AS) && !newlineBefore(parser)) {
+        advance(parser);
+        if (!check(parser, TK_IDENT)) {
+            expectedAfter(parser, "identifier", "as");
+            return;
+        }
+        alias = tokenSymbol(parser, &parser->current);
+        advance(parser);
+    }
+
+    pushScratch(parser, addNode(parser, UseNodeType, offset, name, addExtra2(parser, flags, alias)));
+}
+
+// use fmt, use math::random, use <math.random>, use "foo::bar" or using fmt. The nodes go straight on the scratch
+// stack, a group like use nsl::{io, mem} gives one for each namespace in it. Picking items with use fmt{println} isn't
+// kept yet.
+static void useDeclaration(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    const UseFlags using = check(parser, TK_USING) ? USE_USING : 0;
+    const char *keyword = using ? "using" : "use";
+    advance(parser);
+
+    if (check(parser, TK_STRING_LIT) || check(parser, TK_CHAR_LIT)) {
+        const Token path = parser->current;
+        advance(parser);
+        addUse(parser, offset, path.lexeme + 1, path.len - 2, using | USE_PATH);
+        return;
+    }
+
+    // Namespaces are spelled with :: whichever separator the source used.
+    char path[256];
+    int len = 0;
+    const bool angled = match(parser, TK_LT);
+    for (;;) {
+        if (check(parser, TK_LBRACE) && len > 0) {
+            advance(parser);
+            while (isName(parser->current.type)) {
+                if (len + 2 + parser->current.len >= (int)sizeof(path)) {
+                    break;
+                }
+                str_cpyn(path + len, 2, "::");
+                str_cpyn(path + len + 2, parser->current.len, parser->current.lexeme);
+                addUse(parser, offset, path, len + 2 + parser->current.len, using);
+                advance(parser);
+                if (!match(parser, TK_COMMA)) {
+                    break;
+                }
+            }
+            eat(parser, TK_RBRACE, "Expected } after the namespaces.");
+            return;
+        }
+
+        if (!isName(parser->current.type)) {
+            expectedAfter(parser, "namespace", keyword);
+            return;
+        }
+        if (len + 2 + parser->current.len >= (int)sizeof(path)) {
+            errorAtCurrent(parser, "Namespace name is too long.");
+            return;
+        }
+
+        if (len > 0) {
+            str_cpyn(path + len, 2, "::");
+            len += 2;
+        }
+        str_cpyn(path + len, parser->current.len, parser->current.lexeme);
+        len += parser->current.len;
+        advance(parser);
+
+        if (!match(parser, TK_SCOPE) && !(angled && match(parser, TK_DOT))) {
+            break;
+        }
+    }
+
+    if (angled) {
+        eat(parser, TK_GR, "Expected > after the namespace.");
+    }
+    if (check(parser, TK_LBRACE) && !newlineBefore(parser)) {
+        skipGroup(parser);
+    }
+
+    addUse(parser, offset, path, len, using);
+}
+
+// The FunctionFlags an attribute's name stands for, 0 for the ones the compiler doesn't act on yet.
+static uint32_t attributeFlags(const Token *name) {
+    if (name->len == 6 && memcmp(name->lexeme, "inline", 6) == 0) {
+        return FN_INLINE;
+    }
+    if (name->len == 8 && memcmp(name->lexeme, "noInline", 8) == 0) {
+        return FN_NO_INLINE;
+    }
+
+    return 0;
+}
+
+// The name in the string of #[in("a")] or #[out("a")], kept in names for the function after it.
+static void addArgName(Parser *parser, const Token *string, uint32_t *names, int *count) {
+    if (*count == FN_IN_ARGS || string->len < 2) {
+        return;
+    }
+
+    Token name = *string;
+    name.lexeme += 1;
+    name.len -= 2;
+    name.symbol = SYMBOL_NONE;
+    names[(*count)++] = tokenSymbol(parser, &name);
+}
+
+// #[inline, in("a")], #[overloads("+=")] or #noAutoInit, returns their FunctionFlags. The names of in and out are
+// kept in inNames and outNames, other arguments are skipped.
+static uint32_t attribute(Parser *parser) {
+    advance(parser);
+    uint32_t flags = 0;
+    if (check(parser, TK_LBRACKET)) {
+        // Names of attributes are one level in, their arguments two.
+        int depth = 0;
+        bool in = false;
+        bool out = false;
+        do {
+            if (check(parser, TK_LPAREN) || check(parser, TK_LBRACKET) || check(parser, TK_LBRACE)) {
+                ++depth;
+            } else if (check(parser, TK_RPAREN) || check(parser, TK_RBRACKET) || check(parser, TK_RBRACE)) {
+                --depth;
+            } else if (depth == 1) {
+                in = check(parser, TK_IN);
+                out = check(parser, TK_IDENT) && parser->current.len == 3 &&
+                      memcmp(parser->current.lexeme, "out", 3) == 0;
+                flags |= check(parser, TK_IDENT) ? attributeFlags(&parser->current) : 0;
+            } else if (depth == 2 && in && check(parser, TK_STRING_LIT)) {
+                addArgName(parser, &parser->current, parser->inNames, &parser->inNameCount);
+            } else if (depth == 2 && out && check(parser, TK_STRING_LIT)) {
+                addArgName(parser, &parser->current, parser->outNames, &parser->outNameCount);
+            }
+            advance(parser);
+        } while (depth > 0 && !check(parser, TK_EOF));
+    } else if (check(parser, TK_IDENT)) {
+        advance(parser);
+        if (check(parser, TK_LPAREN) && !newlineBefore(parser)) {
+            skipGroup(parser);
+        }
+    }
+
+    return flags;
+}
+
+// #[inline] before a call asks for it to be inlined.
+static NodeIndex markInlineCall(Parser *parser, const NodeIndex node, const uint32_t flags) {
+    if ((flags & FN_INLINE) && node != NODE_NONE && astKind(&parser->results->ast, node) == CallNodeType) {
+        parser->results->ast.kinds[node] = InlineCallNodeType;
+    }
+
+    return node;
+}
+
+static NodeIndex expression(Parser *parser);
+static NodeIndex postfix(Parser *parser, NodeIndex node);
+static NodeIndex statement(Parser *parser);
+static NodeIndex block(Parser *parser);
+
+static NodeIndex parseType(Parser *parser);
+
+// Type arguments of a generic type, current is the '<'. A >> closing two lists at once is split in two.
+static uint32_t typeArguments(Parser *parser) {
+    const int top = parser->scratchCount;
+    advance(parser);
+    while (!check(parser, TK_GR) && !check(parser, TK_LSR) && !check(parser, TK_EOF)) {
+        pushScratch(parser, parseType(parser));
+        if (parser->panicMode || !match(parser, TK_COMMA)) {
+            break;
+        }
+    }
+
+    if (check(parser, TK_LSR)) {
+        parser->current.type = TK_GR;
+        ++parser->current.lexeme;
+        ++parser->current.offset;
+        parser->current.len = 1;
+    } else {
+        eat(parser, TK_GR, "Expected > after the type arguments.");
+    }
+
+    return finishList(parser, top);
+}
+
+// A type without unions, ^int | float is (^int) | float.
+static NodeIndex typeTerm(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    NodeIndex type = NODE_NONE;
+
+    if (match(parser, TK_DOT_DOT)) {
+        const NodeIndex element = typeTerm(parser);
+        return addNode(parser, VariadicTypeNodeType, offset, element, 0);
+    }
+
+    if (match(parser, TK_DOES)) {
+        return typeTerm(parser); // A behavior, only its name matters until types are checked.
+    }
+
+    if (match(parser, TK_CARET)) {
+        const NodeIndex element = typeTerm(parser);
+        type = addNode(parser, PointerTypeNodeType, offset, element, 0);
+    } else if (match(parser, TK_LBRACKET)) {
+        if (match(parser, TK_RBRACKET)) {
+            const NodeIndex element = typeTerm(parser);
+            type = addNode(parser, SliceTypeNodeType, offset, element, 0);
+        } else if (check(parser, TK_CARET) && checkNext(parser, TK_RBRACKET)) {
+            // [^]T points at many.
+            advance(parser);
+            advance(parser);
+            const NodeIndex element = typeTerm(parser);
+            type = addNode(parser, PointerTypeNodeType, offset, element, 1);
+        } else {
+            ++parser->nesting;
+            const NodeIndex size = expression(parser);
+            --parser->nesting;
+            eat(parser, TK_RBRACKET, "Expected ] after array size.");
+            const NodeIndex element = typeTerm(parser);
+            type = addNode(parser, ArrayTypeNodeType, offset, element, size);
+        }
+    } else if (match(parser, TK_FN)) {
+        const int top = parser->scratchCount;
+        if (match(parser, TK_LPAREN)) {
+            // Argument names are optional, fn(T, int) and fn(prefix, msg: string) are both fine. Identifiers are
+            // taken as types until a ':' shows they were names sharing the type after it.
+            int names = top;
+            while (!check(parser, TK_RPAREN) && !check(parser, TK_EOF)) {
+                if (check(parser, TK_IDENT) && checkNext(parser, TK_COLON)) {
+                    advance(parser);
+                    advance(parser);
+                    const NodeIndex shared = parseType(parser);
+                    for (int i = names; i < parser->scratchCount; ++i) {
+                        parser->scratch[i] = shared;
+                    }
+                    pushScratch(parser, shared);
+                    names = parser->scratchCount;
+                } else {
+                    const bool named = check(parser, TK_IDENT);
+                    pushScratch(parser, parseType(parser));
+                    if (!named) {
+                        names = parser->scratchCount;
+                    }
+                }
+                if (parser->panicMode || !match(parser, TK_COMMA)) {
+                    break;
+                }
+            }
+            eat(parser, TK_RPAREN, "Expected ) after the argument types.");
+        }
+        const uint32_t args = finishList(parser, top);
+
+        if (match(parser, TK_COLON)) {
+            do {
+                pushScratch(parser, parseType(parser));
+            } while (!parser->panicMode && match(parser, TK_COMMA));
+        }
+        type = addNode(parser, FunctionTypeNodeType, offset, args, finishList(parser, top));
+    } else if (check(parser, TK_IDENT)) {
+        uint32_t name = tokenSymbol(parser, &parser->current);
+        advance(parser);
+
+        // module::Type, the last name is the type's.
+        while (check(parser, TK_SCOPE) && checkNext(parser, TK_IDENT)) {
+            advance(parser);
+            name = tokenSymbol(parser, &parser->current);
+            advance(parser);
+        }
+        type = addNode(parser, NamedTypeNodeType, offset, name, TYPE_NONE);
+        if (check(parser, TK_LT) && !newlineBefore(parser)) {
+            type = addNode(parser, GenericTypeNodeType, offset, type, typeArguments(parser));
+        }
+    } else if (isTypeKeyword(parser->current.type)) {
+        type = addNode(parser, NamedTypeNodeType, offset, tokenSymbol(parser, &parser->current),
+                       typeKindOf(parser->current.type));
+        advance(parser);
+    } else {
+        errorAtCurrent(parser, "Expected a type.");
+        return NODE_NONE;
+    }
+
+    if (check(parser, TK_QMRK) && !newlineBefore(parser)) {
+        advance(parser);
+        type = addNode(parser, OptionalTypeNodeType, offset, type, 0);
+    }
+
+    return type;
+}
+
+static NodeIndex parseType(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    const NodeIndex type = typeTerm(parser);
+    if (!check(parser, TK_BIT_OR) || newlineBefore(parser) || parser->panicMode) {
+        return type;
+    }
+
+    const int top = parser->scratchCount;
+    pushScratch(parser, type);
+    while (check(parser, TK_BIT_OR) && !newlineBefore(parser)) {
+        advance(parser);
+        pushScratch(parser, typeTerm(parser));
+        if (parser->panicMode) {
+            break;
+        }
+    }
+
+    return addNode(parser, UnionTypeNodeType, offset, finishList(parser, top), 0);
+}
+
+// Turns the names waiting for a type, pushed as name, offset and ArgFlags from pending on, into arguments of that type.
+static void finishArguments(Parser *parser, const int pending, const NodeIndex type, const NodeIndex value) {
+    const int count = (parser->scratchCount - pending) / 3;
+    for (int i = 0; i < count; ++i) {
+        const uint32_t name = parser->scratch[pending + 3 * i];
+        const uint32_t offset = parser->scratch[pending + 3 * i + 1];
+        // Only the last name is followed by the default value.
+        const uint32_t words[3] = {type, i == count - 1 ? value : NODE_NONE, parser->scratch[pending + 3 * i + 2]};
+        const uint32_t extra = addAstExtra(&parser->results->ast, words, 3);
+        parser->scratch[pending + i] = addNode(parser, ArgNodeType, offset, name, extra);
+    }
+    parser->scratchCount = pending + count;
+}
+
+// (x: int, y, z: f32 = 1, w := 2, restrict p: ^int) where names before a type share it. The ArgNodes are pushed on
+// the scratch stack. Methods list their receiver the same way in brackets first, md add[foo: Foo](a, b: int), and
+// structs their fields in braces, one per line or separated by commas.
+static void parseArguments(Parser *parser, const NiftyTokenType close) {
+    int pending = parser->scratchCount;
+
+    while (!check(parser, close) && !check(parser, TK_EOF)) {
+        if (check(parser, TK_HASH)) {
+            attribute(parser); // x: int #[json("x")]
+            continue;
+        }
+
+        const uint32_t flags = match(parser, TK_RESTRICT) ? ARG_RESTRICT : 0;
+        if (!check(parser, TK_IDENT)) {
+            errorAtCurrent(parser, close == TK_RBRACE ? "Expected a field name." : "Expected an argument name.");
+            while (!check(parser, close) && !check(parser, TK_EOF)) {
+                advance(parser);
+            }
+            break;
+        }
+
+        pushScratch(parser, tokenSymbol(parser, &parser->current));
+        pushScratch(parser, parser->current.offset);
+        pushScratch(parser, flags);
+        advance(parser);
+        match(parser, TK_QMRK); // random?: ^Random
+
+        if (match(parser, TK_COLON)) {
+            const NodeIndex type = parseType(parser);
+            const NodeIndex value = match(parser, TK_ASSIGN) ? expression(parser) : NODE_NONE;
+            finishArguments(parser, pending, type, value);
+            pending = parser->scratchCount;
+        } else if (match(parser, TK_LET_DECL)) {
+            // The type comes from the value.
+            finishArguments(parser, pending, NODE_NONE, expression(parser));
+            pending = parser->scratchCount;
+        }
+
+        if (parser->panicMode) {
+            while (!check(parser, close) && !check(parser, TK_EOF)) {
+                advance(parser);
+            }
+            break;
+        }
+        match(parser, TK_COMMA);
+    }
+    finishArguments(parser, pending, NODE_NONE, NODE_NONE);
+
+    switch (close) {
+        case TK_RPAREN: eat(parser, close, "Expected ) after arguments."); break;
+        case TK_RBRACKET: eat(parser, close, "Expected ] after the receiver."); break;
+        default: eat(parser, close, "Expected } after the fields."); break;
+    }
+}
+
+// fn name overloads {a, b}, current is the '{'.
+static NodeIndex overloads(Parser *parser, const uint32_t offset, const uint32_t name) {
+    advance(parser);
+
+    const int top = parser->scratchCount;
+    while (check(parser, TK_IDENT)) {
+        pushScratch(parser, tokenSymbol(parser, &parser->current));
+        advance(parser);
+        if (!match(parser, TK_COMMA)) {
+            break;
+        }
+    }
+    eat(parser, TK_RBRACE, "Expected } after the overloaded functions.");
+
+    return addNode(parser, OverloadsNodeType, offset, name, finishList(parser, top));
+}
+
+// Steps over the body starting at current, a '{', by counting braces in the token array, leaving a LazyBodyNodeType
+// for parseFunctionBody. Bodies that hold a use, which the program needs to find its files, or a lexer error, which has
+// to be reported, are left to block, as are all bodies when streaming tokens or recovering from an error in the
+// prototype. NODE_NONE if the body wasn't skipped.
+static NodeIndex skipBody(Parser *parser) {
+    const TokenStream *tokens = parser->tokens;
+    if (tokens == nullptr) {
+        return NODE_NONE;
+    }
+
+    // Current is the token before next, which was the last one pulled.
+    int depth = 0;
+    int end = parser->tokenIndex - 2;
+    for (; end < tokens->count; ++end) {
+        const NiftyTokenType type = (NiftyTokenType)tokens->kinds[end];
+        if (type == TK_LBRACE) {
+            ++depth;
+        } else if (type == TK_RBRACE && --depth == 0) {
+            break;
+        } else if (type == TK_USE || type == TK_USING || type == TK_INTERNAL_ERROR || type == TK_EOF) {
+            return NODE_NONE;
+        }
+    }
+
+    const uint32_t offset = parser->current.offset;
+    const uint32_t endOffset = tokens->offsets[end] + tokens->lengths[end];
+
+    // Continue with the closing brace as next, skipping the values of the numbers in between.
+    parser->tokenIndex = end;
+    while (parser->numberIndex < tokens->numberCount && tokens->numbers[parser->numberIndex].token < (uint32_t)end) {
+        ++parser->numberIndex;
+    }
+    pull(parser);
+    advance(parser);
+    advance(parser);
+
+    ++parser->skippedBodies;
+    return addNode(parser, LazyBodyNodeType, offset, 0, endOffset);
+}
+
+// After fn or md. Functions without a body, like extern ones, end in undefined.
+static void clearAttributes(Parser *parser) {
+    parser->attributes = 0;
+    parser->inNameCount = 0;
+    parser->outNameCount = 0;
+}
+
+// FN_IN bits of the arguments #[in] named. Those #[out] names get ARG_OUT.
+static uint32_t inArguments(const Parser *parser, const uint32_t args) {
+    Ast *ast = &parser->results->ast;
+    int count;
+    const uint32_t *items = astList(ast, args, &count);
+    uint32_t flags = 0;
+    for (int i = 0; i < count; ++i) {
+        const uint32_t name = ast->data[items[i]].a;
+        for (int j = 0; j < parser->inNameCount && i < FN_IN_ARGS; ++j) {
+            if (parser->inNames[j] == name) {
+                flags |= FN_IN << i;
+            }
+        }
+        for (int j = 0; j < parser->outNameCount; ++j) {
+            if (parser->outNames[j] == name) {
+                ast->extra[ast->data[items[i]].b + 2] |= ARG_OUT;
+            }
+        }
+    }
+
+    return flags;
+}
+
+static NodeIndex fnDeclaration(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    if (!isName(parser->current.type)) {
+        expectedAfter(parser, "identifier", "fn");
+        return NODE_NONE;
+    }
+
+    uint32_t name = tokenSymbol(parser, &parser->current);
+    advance(parser);
+
+    // Type::method, the last name is the function's.
+    while (check(parser, TK_SCOPE) && checkNext(parser, TK_IDENT)) {
+        advance(parser);
+        name = tokenSymbol(parser, &parser->current);
+        advance(parser);
+    }
+
+    if (identIs(parser, "overloads", 9) && checkNext(parser, TK_LBRACE)) {
+        advance(parser);
+        clearAttributes(parser);
+        return overloads(parser, offset, name);
+    }
+
+    const uint32_t parameters = check(parser, TK_LT) ? typeParameters(parser) : LIST_EMPTY;
+
+    const int top = parser->scratchCount;
+    if (match(parser, TK_LBRACKET)) {
+        parseArguments(parser, TK_RBRACKET);
+    }
+
+    if (!match(parser, TK_LPAREN)) {
+        errorAtCurrent(parser, "Expected ( after function name.");
+        parser->scratchCount = top;
+        return NODE_NONE;
+    }
+
+    parseArguments(parser, TK_RPAREN);
+    const uint32_t args = finishList(parser, top);
+    const uint32_t flags = parser->attributes | inArguments(parser, args);
+    clearAttributes(parser);
+
+    if (match(parser, TK_COLON)) {
+        do {
+            pushScratch(parser, parseType(parser));
+        } while (!parser->panicMode && match(parser, TK_COMMA));
+    }
+    const uint32_t returns = finishList(parser, top);
+
+    const NodeIndex prototype = addNode(parser, PrototypeNodeType, offset, name,
+                                            addExtra4(parser, args, returns, parameters, flags));
+
+    NodeIndex body = NODE_NONE;
+    if (check(parser, TK_LBRACE)) {
+        body = parser->compilerConfig->lazyBodies && !parser->panicMode ? skipBody(parser) : NODE_NONE;
+        if (body == NODE_NONE) {
+            body = block(parser);
+        }
+    } else if (!match(parser, TK_UNDEFINED) && !parser->panicMode) {
+        errorAtCurrent(parser, "Expected { or undefined after the function's prototype.");
+    }
+
+    return addNode(parser, FunctionNodeType, offset, prototype, body);
+}
+
+// 42, 1.5, 19.f or 0.d, the value was worked out by the lexer.
+static NodeIndex number(Parser *parser) {
+    const Token token = parser->current;
+    const NumberLiteral value = parser->currentNumber;
+    advance(parser);
+
+    // The suffix lexes as its own '.' and identifier right after the number.
+    uint32_t suffix = 0;
+    if (check(parser, TK_DOT) && parser->current.offset == token.offset + (uint32_t)token.len &&
+        checkNext(parser, TK_IDENT) && parser->next.offset == parser->current.offset + 1 && parser->next.len == 1 &&
+        (parser->next.lexeme[0] == 'f' || parser->next.lexeme[0] == 'd')) {
+        suffix = parser->next.lexeme[0] == 'f' ? 32 : 64;
+        advance(parser);
+        advance(parser);
+    }
+
+    if (value.kind == NUMBER_FLOAT || suffix != 0) {
+        double real = value.value.real;
+        if (value.kind == NUMBER_INTEGER) {
+            real = (double)value.value.integer.high * 18446744073709551616.0 + (double)value.value.integer.low;
+        }
+
+        uint64_t bits;
+        memcpy(&bits, &real, sizeof(bits));
+        const uint32_t words[2] = {(uint32_t)bits, (uint32_t)(bits >> 32)};
+        return addNode(parser, FloatNodeType, token.offset, addAstExtra(&parser->results->ast, words, 2), suffix);
+    }
+
+    const uint64_t low = value.value.integer.low;
+    const uint64_t high = value.value.integer.high;
+    if (high == 0 && low <= UINT32_MAX && !value.overflow) {
+        return addNode(parser, IntNodeType, token.offset, (uint32_t)low, INT_SMALL);
+    }
+
+    const uint32_t words[4] = {(uint32_t)low, (uint32_t)(low >> 32), (uint32_t)high, (uint32_t)(high >> 32)};
+    return addNode(parser, IntNodeType, token.offset, addAstExtra(&parser->results->ast, words, 4),
+                   value.overflow ? INT_OVERFLOW : INT_WIDE);
+}
+
+// Items of a bracketed, comma separated list up to close. Inside call arguments and struct literals name: value items
+// become NamedArgNodeType.
+static uint32_t expressionList(Parser *parser, const NiftyTokenType close, const bool named) {
+    const bool noStructLiteral = parser->noStructLiteral;
+    parser->noStructLiteral = false;
+
+    const int top = parser->scratchCount;
+    while (!check(parser, close) && !check(parser, TK_EOF)) {
+        NodeIndex item;
+        if (named && check(parser, TK_IDENT) && checkNext(parser, TK_COLON)) {
+            const uint32_t offset = parser->current.offset;
+            const uint32_t name = tokenSymbol(parser, &parser->current);
+            advance(parser);
+            advance(parser);
+            const NodeIndex value = expression(parser);
+            item = addNode(parser, NamedArgNodeType, offset, name, value);
+        } else {
+            item = expression(parser);
+        }
+        pushScratch(parser, item);
+
+        // Struct literals written one field per line can leave out the commas.
+        if (parser->panicMode || (!match(parser, TK_COMMA) && (close != TK_RBRACE || !newlineBefore(parser)))) {
+            break;
+        }
+    }
+
+    parser->noStructLiteral = noStructLiteral;
+    return finishList(parser, top);
+}
+
+// Code point of a character literal, quotes included in the token. Unknown escapes are the escaped character.
+static uint32_t charValue(const Token *token) {
+    const unsigned char *text = (const unsigned char *)token->lexeme + 1;
+    const int len = token->len - 2;
+    if (len <= 0) {
+        return 0;
+    }
+
+    if (text[0] == '\\' && len > 1) {
+        switch (text[1]) {
+            case 'n': return '\n';
+            case 't': return '\t';
+            case 'r': return '\r';
+            case '0': return '\0';
+            default: return text[1];
+        }
+    }
+
+    // The first code point of UTF-8 text.
+    if (text[0] < 0x80 || len < 2) {
+        return text[0];
+    }
+    const int extra = text[0] >= 0xF0 ? 3 : text[0] >= 0xE0 ? 2 : 1;
+    uint32_t value = text[0] & (0x3F >> extra);
+    for (int i = 1; i <= extra && i < len; ++i) {
+        value = value << 6 | (text[i] & 0x3F);
+    }
+
+    return value;
+}
+
+static NodeIndex primary(Parser *parser) {
+    const Token token = parser->current;
+
+    switch (token.type) {
+        case TK_NUMBER:
+            return number(parser);
+        case TK_STRING_LIT:
+            advance(parser);
+            return addNode(parser, StringNodeType, token.offset, localSymbol(parser, token.symbol), 0);
+        case TK_CHAR_LIT:
+            advance(parser);
+            return addNode(parser, CharNodeType, token.offset, charValue(&token), 0);
+        case TK_TRUE:
+        case TK_FALSE:
+            advance(parser);
+            return addNode(parser, BoolNodeType, token.offset, token.type == TK_TRUE, 0);
+        case TK_NULL:
+            advance(parser);
+            return addNode(parser, NullNodeType, token.offset, 0, 0);
+        case TK_UNDEFINED:
+            advance(parser);
+            return addNode(parser, UndefinedNodeType, token.offset, 0, 0);
+        case TK_IDENT:
+            advance(parser);
+            return addNode(parser, IdentNodeType, token.offset, localSymbol(parser, token.symbol), 0);
+        case TK_HASH: {
+            if (checkNext(parser, TK_LBRACKET)) {
+                const uint32_t flags = attribute(parser); // x := #[inline] f()
+                return markInlineCall(parser, postfix(parser, primary(parser)), flags);
+            }
+
+            // #NAME names a #set value.
+            advance(parser);
+            if (!check(parser, TK_IDENT)) {
+                errorAtCurrent(parser, "Expected a name after #.");
+                return NODE_NONE;
+            }
+            const Token name = parser->current;
+            advance(parser);
+            return addNode(parser, IdentNodeType, name.offset, localSymbol(parser, name.symbol), 0);
+        }
+        case TK_ASSERT:
+        case TK_ASSERT_DB:
+            advance(parser);
+            return addNode(parser, IdentNodeType, token.offset, tokenSymbol(parser, &token), 0);
+        case TK_LPAREN: {
+            advance(parser);
+            const bool noStructLiteral = parser->noStructLiteral;
+            parser->noStructLiteral = false;
+            ++parser->nesting;
+            const NodeIndex inner = expression(parser);
+            --parser->nesting;
+            parser->noStructLiteral = noStructLiteral;
+            eat(parser, TK_RPAREN, "Expected ) after the expression.");
+            return inner;
+        }
+        case TK_LBRACKET: {
+            advance(parser);
+            ++parser->nesting;
+            const uint32_t items = expressionList(parser, TK_RBRACKET, false);
+            --parser->nesting;
+            eat(parser, TK_RBRACKET, "Expected ] after the array's items.");
+            return addNode(parser, ArrayLitNodeType, token.offset, items, 0);
+        }
+        case TK_INTERNAL_ERROR:
+            report(parser, &token, DIAG_LEXER, token.lexeme, nullptr, nullptr);
+            return NODE_NONE;
+        default:
+            break;
+    }
+
+    // size_of(T), cast(x, u32) and types passed as arguments.
+    if ((token.type >= TK_SIZE_OF && token.type <= TK_NAME_OF) || token.type == TK_CAST || token.type == TK_RECAST ||
+        token.type == TK_AUTO_CAST || isTypeKeyword(token.type)) {
+        advance(parser);
+        return addNode(parser, IdentNodeType, token.offset, tokenSymbol(parser, &token), 0);
+    }
+
+    errorAtCurrent(parser, "Expected an expression.");
+    return NODE_NONE;
+}
+
+static bool startsOperand(const NiftyTokenType type) {
+    switch (type) {
+        case TK_NUMBER: case TK_STRING_LIT: case TK_CHAR_LIT: case TK_IDENT: case TK_TRUE: case TK_FALSE:
+        case TK_NULL: case TK_LPAREN: case TK_LBRACKET: case TK_SUB: case TK_BANG: case TK_BIT_NOT:
+        case TK_BIT_AND: case TK_NEW: case TK_CAST: case TK_RECAST: case TK_AUTO_CAST:
+            return true;
+        default:
+            return type >= TK_SIZE_OF && type <= TK_NAME_OF;
+    }
+}
+
+static NodeIndex postfix(Parser *parser, NodeIndex node) {
+    while (node != NODE_NONE && !parser->panicMode) {
+        const uint32_t offset = parser->current.offset;
+
+        switch (parser->current.type) {
+            case TK_LPAREN: {
+                if (lineEnds(parser)) {
+                    return node;
+                }
+                advance(parser);
+                ++parser->nesting;
+                const uint32_t args = expressionList(parser, TK_RPAREN, true);
+                --parser->nesting;
+                eat(parser, TK_RPAREN, "Expected ) after arguments.");
+                node = addNode(parser, CallNodeType, offset, node, args);
+                break;
+            }
+            case TK_LBRACKET: {
+                if (lineEnds(parser)) {
+                    return node;
+                }
+                advance(parser);
+                ++parser->nesting;
+                const NodeIndex index = expression(parser);
+                --parser->nesting;
+                eat(parser, TK_RBRACKET, "Expected ] after the index.");
+                node = addNode(parser, IndexNodeType, offset, node, index);
+                break;
+            }
+            case TK_DOT:
+            case TK_QDOT:
+            case TK_ARROW:
+            case TK_SCOPE: {
+                const NiftyTokenType type = parser->current.type;
+                advance(parser);
+                if (!isName(parser->current.type)) {
+                    errorAtCurrent(parser, "Expected a name after the member access.");
+                    return node;
+                }
+                const NodeKind kind = type == TK_ARROW ? PointerMemberNodeType
+                                    : type == TK_SCOPE ? ScopeNodeType : MemberNodeType;
+                node = addNode(parser, kind, offset, node, tokenSymbol(parser, &parser->current));
+                advance(parser);
+                break;
+            }
+            case TK_INC: case TK_INC_W: case TK_INC_S:
+            case TK_DEC: case TK_DEC_W: case TK_DEC_S: {
+                if (lineEnds(parser)) {
+                    return node;
+                }
+                const bool inc = check(parser, TK_INC) || check(parser, TK_INC_W) || check(parser, TK_INC_S);
+                advance(parser);
+                node = addNode(parser, inc ? PostIncNodeType : PostDecNodeType, offset, node, 0);
+                break;
+            }
+            case TK_CARET:
+                // x^ dereferences, x ^ y is xor.
+                if (startsOperand(parser->next.type) && parser->next.offset > offset + 1) {
+                    return node;
+                }
+                advance(parser);
+                node = addNode(parser, DerefNodeType, offset, node, 0);
+                break;
+            case TK_LBRACE: {
+                const NodeKind kind = astKind(&parser->results->ast, node);
+                if (parser->noStructLiteral || lineEnds(parser) ||
+                    (kind != IdentNodeType && kind != ScopeNodeType && kind != MemberNodeType)) {
+                    return node;
+                }
+                advance(parser);
+                const int nesting = parser->nesting;
+                parser->nesting = 0;
+                const uint32_t fields = expressionList(parser, TK_RBRACE, true);
+                parser->nesting = nesting;
+                eat(parser, TK_RBRACE, "Expected } after the struct's fields.");
+                node = addNode(parser, StructLitNodeType, offset, node, fields);
+                break;
+            }
+            default:
+                return node;
+        }
+    }
+
+    return node;
+}
+
+static NodeIndex unary(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+
+    NodeKind kind;
+    switch (parser->current.type) {
+        case TK_SUB: kind = NegNodeType; break;
+        case TK_BANG: kind = NotNodeType; break;
+        case TK_BIT_NOT: kind = BitNotNodeType; break;
+        case TK_BIT_AND: kind = AddressOfNodeType; break;
+        case TK_INC: case TK_INC_W: case TK_INC_S: kind = PreIncNodeType; break;
+        case TK_DEC: case TK_DEC_W: case TK_DEC_S: kind = PreDecNodeType; break;
+        case TK_ADD:
+        case TK_TRY:
+            advance(parser); // +x is x, try only matters once errors are checked.
+            return unary(parser);
+        case TK_NEW: {
+            advance(parser);
+            // new [n]int allocates a type, new Foo{} a value.
+            const NodeIndex value = check(parser, TK_LBRACKET) || check(parser, TK_CARET) ||
+                                    isTypeKeyword(parser->current.type) ? typeTerm(parser) : unary(parser);
+            return addNode(parser, NewNodeType, offset, value, 0);
+        }
+        default:
+            return postfix(parser, primary(parser));
+    }
+
     advance(parser);
-//    eat(parser, TK_IDENT, "Expected identifier after package.");
+    const NodeIndex operand = unary(parser);
+    return addNode(parser, kind, offset, operand, 0);
 }
 
-static BlockNode *parseBlock(const Parser *parser) {
-    return nullptr;
+// From loosest to tightest.
+typedef enum {
+    PREC_NONE,
+    PREC_COALESCE, // ??
+    PREC_OR,       // ||
+    PREC_AND,      // &&
+    PREC_EQUALITY, // == !=
+    PREC_COMPARE,  // < <= > >=
+    PREC_RANGE,    // ..< ..=
+    PREC_BIT_OR,   // |
+    PREC_BIT_XOR,  // ^ ~
+    PREC_BIT_AND,  // &
+    PREC_SHIFT,    // << >> @<<
+    PREC_TERM,     // + - and their wrapping and saturating forms
+    PREC_FACTOR,   // * / % and their wrapping and saturating forms
+} Precedence;
+
+static Precedence binaryOperator(const NiftyTokenType type, NodeKind *kind) {
+    switch (type) {
+        case TK_NULL_COALESCE: *kind = NullCoalesceNodeType; return PREC_COALESCE;
+        case TK_OR: *kind = OrNodeType; return PREC_OR;
+        case TK_AND: *kind = AndNodeType; return PREC_AND;
+        case TK_EQ: *kind = EqNodeType; return PREC_EQUALITY;
+        case TK_NOT_EQ: *kind = NotEqNodeType; return PREC_EQUALITY;
+        case TK_LT: *kind = LtNodeType; return PREC_COMPARE;
+        case TK_LT_EQ: *kind = LtEqNodeType; return PREC_COMPARE;
+        case TK_GR: *kind = GtNodeType; return PREC_COMPARE;
+        case TK_GR_EQ: *kind = GtEqNodeType; return PREC_COMPARE;
+        case TK_O_RANGE: *kind = RangeOpenNodeType; return PREC_RANGE;
+        case TK_C_RANGE: *kind = RangeClosedNodeType; return PREC_RANGE;
+        case TK_BIT_OR: *kind = BitOrNodeType; return PREC_BIT_OR;
+        case TK_CARET: *kind = BitXorNodeType; return PREC_BIT_XOR;
+        case TK_BIT_NOT: *kind = BitXorNodeType; return PREC_BIT_XOR;
+        case TK_BIT_AND: *kind = BitAndNodeType; return PREC_BIT_AND;
+        case TK_LSL: *kind = ShlNodeType; return PREC_SHIFT;
+        case TK_LSR: *kind = ShrNodeType; return PREC_SHIFT;
+        case TK_LSL_S: *kind = ShlSatNodeType; return PREC_SHIFT;
+        case TK_ADD: *kind = AddNodeType; return PREC_TERM;
+        case TK_SUB: *kind = SubNodeType; return PREC_TERM;
+        case TK_ADD_W: *kind = AddWrapNodeType; return PREC_TERM;
+        case TK_SUB_W: *kind = SubWrapNodeType; return PREC_TERM;
+        case TK_ADD_S: *kind = AddSatNodeType; return PREC_TERM;
+        case TK_SUB_S: *kind = SubSatNodeType; return PREC_TERM;
+        case TK_MUL: *kind = MulNodeType; return PREC_FACTOR;
+        case TK_DIV: *kind = DivNodeType; return PREC_FACTOR;
+        case TK_MOD: *kind = ModNodeType; return PREC_FACTOR;
+        case TK_MUL_W: *kind = MulWrapNodeType; return PREC_FACTOR;
+        case TK_MUL_S: *kind = MulSatNodeType; return PREC_FACTOR;
+        default: return PREC_NONE;
+    }
 }
 
-static ArgNode **parseArguments(Parser *parser) {
-    eat(parser, TK_LPAREN, "Expected (");
+static NodeIndex binary(Parser *parser, const Precedence min) {
+    NodeIndex left = unary(parser);
 
-    while (parser->current.type != TK_RPAREN) {
+    while (!parser->panicMode) {
+        NodeKind kind;
+        const Precedence precedence = binaryOperator(parser->current.type, &kind);
+        if (precedence == PREC_NONE || precedence < min || lineEnds(parser)) {
+            break;
+        }
+
+        const uint32_t offset = parser->current.offset;
         advance(parser);
+        const NodeIndex right = binary(parser, (Precedence)(precedence + 1));
+        left = addNode(parser, kind, offset, left, right);
     }
 
-    eat(parser, TK_RPAREN, "Expected )");
+    return left;
+}
+
+static NodeIndex expression(Parser *parser) {
+    const NodeIndex condition = binary(parser, PREC_COALESCE);
+    if (!check(parser, TK_QMRK) || lineEnds(parser) || parser->panicMode) {
+        return condition;
+    }
 
-    return nullptr;
+    // a ? b : c
+    const uint32_t offset = parser->current.offset;
+    advance(parser);
+    const NodeIndex then = expression(parser);
+    eat(parser, TK_COLON, "Expected : after the ternary's first value.");
+    const NodeIndex otherwise = expression(parser);
+
+    return addNode(parser, TernaryNodeType, offset, condition, addExtra2(parser, then, otherwise));
 }
 
-static TypeNode **parseReturnTypes(Parser *parser) {
-    return nullptr;
+// Condition of an if or a loop, (x < y) or x < y without the parentheses.
+static NodeIndex condition(Parser *parser) {
+    const bool noStructLiteral = parser->noStructLiteral;
+    parser->noStructLiteral = true;
+    const NodeIndex value = expression(parser);
+    parser->noStructLiteral = noStructLiteral;
+
+    return value;
 }
 
-static PrototypeNode *parsePrototype(Parser *parser) {
+// Values after = or :=, f() else { "" } gives a fallback for a missing value.
+static uint32_t valueList(Parser *parser) {
+    const int top = parser->scratchCount;
+    do {
+        const NodeIndex value = expression(parser);
+        if (check(parser, TK_ELSE) && checkNext(parser, TK_LBRACE) && !lineEnds(parser)) {
+            const uint32_t offset = parser->current.offset;
+            advance(parser);
+            const NodeIndex fallback = block(parser);
+            pushScratch(parser, addNode(parser, OrElseNodeType, offset, value, fallback));
+        } else {
+            pushScratch(parser, value);
+        }
+    } while (!parser->panicMode && match(parser, TK_COMMA));
+
+    return finishList(parser, top);
+}
+
+// The rest of a declaration after its first name, which is already on the scratch stack from top on.
+static NodeIndex varDeclarationRest(Parser *parser, const uint32_t offset, const VarFlags flags, const int top) {
+    while (match(parser, TK_COMMA)) {
+        if (!check(parser, TK_IDENT) && !check(parser, TK_UNUSED)) {
+            errorAtCurrent(parser, "Expected a variable name after ,.");
+            parser->scratchCount = top;
+            return NODE_NONE;
+        }
+        pushScratch(parser, tokenSymbol(parser, &parser->current));
+        advance(parser);
+    }
+
+    NodeIndex type = NODE_NONE;
+    uint32_t values = LIST_EMPTY;
+    if (match(parser, TK_COLON)) {
+        type = parseType(parser);
+        if (match(parser, TK_ASSIGN)) {
+            values = valueList(parser);
+        }
+    } else if (match(parser, TK_ASSIGN) || match(parser, TK_LET_DECL) || match(parser, TK_CONST_DECL)) {
+        values = valueList(parser);
+    } else if (flags != VAR_LET || check(parser, TK_EOF) || !newlineBefore(parser)) {
+        errorAtCurrent(parser, "Expected a type or a value for the variable.");
+    }
+
+    const uint32_t names = finishList(parser, top);
+    return addNode(parser, VarNodeType, offset, addExtra4(parser, flags, type, values, names), 0);
+}
+
+// let, val or const.
+static NodeIndex varDeclaration(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    const VarFlags flags = check(parser, TK_LET) ? VAR_LET : check(parser, TK_VAL) ? VAR_VAL : VAR_CONST;
+    advance(parser);
+
     if (!check(parser, TK_IDENT)) {
-        expectedAfter(parser, "identifier", "fn"); // TODO: Handle md.
-        return nullptr;
+        errorAtCurrent(parser, "Expected a variable name.");
+        return NODE_NONE;
     }
 
-    PrototypeNode *prototype = (PrototypeNode*)malloc(sizeof(PrototypeNode));
-    prototype->name = str_new_len(parser->current.lexeme, parser->current.len);
+    const int top = parser->scratchCount;
+    pushScratch(parser, tokenSymbol(parser, &parser->current));
     advance(parser);
 
-    prototype->args = parseArguments(parser);
-    prototype->returnTypes = parseReturnTypes(parser);
+    return varDeclarationRest(parser, offset, flags, top);
+}
 
-    return prototype;
+// x := 1, a, b ::= f(), unused, s := f() and x: u64 = 1.
+static NodeIndex shortVarDeclaration(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+
+    const int top = parser->scratchCount;
+    for (;;) {
+        pushScratch(parser, tokenSymbol(parser, &parser->current));
+        advance(parser);
+        if (!check(parser, TK_COMMA) || !(checkNext(parser, TK_IDENT) || checkNext(parser, TK_UNUSED))) {
+            break;
+        }
+        advance(parser);
+    }
+
+    if (check(parser, TK_COLON)) {
+        return varDeclarationRest(parser, offset, VAR_LET, top);
+    }
+
+    VarFlags flags = VAR_LET;
+    if (match(parser, TK_CONST_DECL)) {
+        flags = VAR_VAL;
+    } else if (!match(parser, TK_LET_DECL)) {
+        errorAtCurrent(parser, "Expected := or ::= after the variable names.");
+        parser->scratchCount = top;
+        return NODE_NONE;
+    }
+
+    const uint32_t values = valueList(parser);
+    const uint32_t names = finishList(parser, top);
+
+    return addNode(parser, VarNodeType, offset, addExtra4(parser, flags, NODE_NONE, values, names), 0);
 }
 
-static void fnDeclaration(Parser *parser) {
-    Node *function = newNode(parser, FunctionNodeType);
-    function->data.functionNode.prototype = parsePrototype(parser);
-    function->data.functionNode.body = parseBlock(parser);
-    addNode(parser, function);
+static bool startsSet(const Parser *parser) {
+    return check(parser, TK_HASH) && checkNext(parser, TK_IDENT) && parser->next.len == 3 &&
+           memcmp(parser->next.lexeme, "set", 3) == 0;
 }
 
-static void declaration(Parser *parser) {
-    if (match(parser, TK_NAMESPACE)) {
-        namespaceDeclaration(parser);
-    } else if (match(parser, TK_FN) || match(parser, TK_MD)) {
-        fnDeclaration(parser);
+// #set NAME expr, a value known at compile time named as #NAME. It's kept as const NAME = expr.
+static NodeIndex setDeclaration(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    advance(parser);
+    advance(parser);
+    if (!check(parser, TK_IDENT)) {
+        errorAtCurrent(parser, "Expected a name after #set.");
+        return NODE_NONE;
+    }
+
+    const int top = parser->scratchCount;
+    pushScratch(parser, tokenSymbol(parser, &parser->current));
+    advance(parser);
+    match(parser, TK_ASSIGN);
+    pushScratch(parser, expression(parser));
+    const uint32_t values = finishList(parser, top + 1);
+    const uint32_t names = finishList(parser, top);
+
+    return addNode(parser, VarNodeType, offset, addExtra4(parser, VAR_CONST, NODE_NONE, values, names), 0);
+}
+
+static bool startsShortVar(const Parser *parser) {
+    return (check(parser, TK_IDENT) || check(parser, TK_UNUSED)) &&
+           (checkNext(parser, TK_LET_DECL) || checkNext(parser, TK_CONST_DECL) || checkNext(parser, TK_COMMA) ||
+            checkNext(parser, TK_COLON));
+}
+
+static NodeKind compoundOperator(const NiftyTokenType type) {
+    switch (type) {
+        case TK_ADD_EQ: return AddNodeType;
+        case TK_SUB_EQ: return SubNodeType;
+        case TK_MUL_EQ: return MulNodeType;
+        case TK_DIV_EQ: return DivNodeType;
+        case TK_MOD_EQ: return ModNodeType;
+        case TK_ADD_EQ_W: return AddWrapNodeType;
+        case TK_SUB_EQ_W: return SubWrapNodeType;
+        case TK_MUL_EQ_W: return MulWrapNodeType;
+        case TK_ADD_EQ_S: return AddSatNodeType;
+        case TK_SUB_EQ_S: return SubSatNodeType;
+        case TK_MUL_EQ_S: return MulSatNodeType;
+        case TK_LSL_EQ_S: return ShlSatNodeType;
+        case TK_BIT_XOR_EQ: return BitXorNodeType;
+        case TK_BIT_AND_EQ: return BitAndNodeType;
+        case TK_BIT_OR_EQ: return BitOrNodeType;
+        case TK_LSL_EQ: return ShlNodeType;
+        case TK_LSR_EQ: return ShrNodeType;
+        case TK_NULL_COALESCE_ASSIGN: return NullCoalesceNodeType;
+        case TK_NULLISH_COALESCE_ASSIGN: return OrNodeType;
+        default: return VoidNodeType;
+    }
+}
+
+// Declarations, assignments and expressions, the statements allowed in a for's header too.
+static NodeIndex simpleStatement(Parser *parser) {
+    if (startsShortVar(parser)) {
+        return shortVarDeclaration(parser);
+    }
+    if (check(parser, TK_LET) || check(parser, TK_VAL) || check(parser, TK_CONST)) {
+        return varDeclaration(parser);
+    }
+
+    const NodeIndex target = expression(parser);
+    if (parser->panicMode || lineEnds(parser)) {
+        return target;
+    }
+
+    const uint32_t offset = parser->current.offset;
+    if (match(parser, TK_ASSIGN)) {
+        const NodeIndex value = expression(parser);
+        return addNode(parser, AssignNodeType, offset, target, value);
+    }
+
+    const NodeKind kind = compoundOperator(parser->current.type);
+    if (kind != VoidNodeType) {
+        advance(parser);
+        const NodeIndex value = expression(parser);
+        return addNode(parser, CompoundAssignNodeType, offset, target, addExtra2(parser, kind, value));
+    }
+
+    return target;
+}
+
+// After if or elif.
+static NodeIndex ifStatement(Parser *parser, const uint32_t offset) {
+    NodeIndex init = NODE_NONE;
+    NodeIndex cond;
+
+    if (match(parser, TK_LPAREN)) {
+        // if (value, ok := f(); ok) runs a statement first.
+        ++parser->nesting;
+        cond = simpleStatement(parser);
+        if (match(parser, TK_SEMICOLON)) {
+            init = cond;
+            cond = expression(parser);
+        }
+        --parser->nesting;
+        eat(parser, TK_RPAREN, "Expected ) after the condition.");
     } else {
-        advance(parser); // TODO: Remove.
+        cond = condition(parser);
+    }
+
+    const NodeIndex then = block(parser);
+    NodeIndex otherwise = NODE_NONE;
+    if (check(parser, TK_ELIF) || (check(parser, TK_ELSE) && checkNext(parser, TK_IF))) {
+        if (check(parser, TK_ELSE)) {
+            advance(parser);
+        }
+        const uint32_t elseOffset = parser->current.offset;
+        advance(parser);
+        otherwise = ifStatement(parser, elseOffset);
+    } else if (match(parser, TK_ELSE)) {
+        otherwise = block(parser);
+    }
+
+    return addNode(parser, IfNodeType, offset, cond, addExtra3(parser, init, then, otherwise));
+}
+
+// for (init; condition; step), for (val i in range; step), for <(val i in range) and for (range).
+static NodeIndex forStatement(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    advance(parser);
+
+    const bool reverse = match(parser, TK_LT);
+    eat(parser, TK_LPAREN, "Expected ( after for.");
+    ++parser->nesting;
+
+    const int top = parser->scratchCount;
+    bool isIn = false;
+    NodeIndex init = NODE_NONE;
+    if (check(parser, TK_LET) || check(parser, TK_VAL) || check(parser, TK_CONST) ||
+        (check(parser, TK_IDENT) && (checkNext(parser, TK_IN) || checkNext(parser, TK_COMMA)))) {
+        const uint32_t varOffset = parser->current.offset;
+        const VarFlags flags = check(parser, TK_LET) ? VAR_LET : check(parser, TK_CONST) ? VAR_CONST : VAR_VAL;
+        if (!check(parser, TK_IDENT)) {
+            advance(parser);
+        }
+
+        // val x, i in items names the index too.
+        while (check(parser, TK_IDENT)) {
+            pushScratch(parser, tokenSymbol(parser, &parser->current));
+            advance(parser);
+            if (!check(parser, TK_COMMA) || !checkNext(parser, TK_IDENT)) {
+                break;
+            }
+            advance(parser);
+        }
+
+        if (match(parser, TK_IN)) {
+            isIn = true;
+        } else {
+            init = varDeclarationRest(parser, varOffset, flags, top);
+        }
+    } else if (!check(parser, TK_SEMICOLON)) {
+        init = simpleStatement(parser);
+    }
+
+    NodeIndex loop;
+    if (isIn || !check(parser, TK_SEMICOLON)) {
+        const uint32_t names = finishList(parser, top);
+        const NodeIndex iterable = isIn ? expression(parser) : init;
+        const NodeIndex step = match(parser, TK_SEMICOLON) ? expression(parser) : NODE_NONE;
+        --parser->nesting;
+        eat(parser, TK_RPAREN, "Expected ) after the for's range.");
+        const NodeIndex body = block(parser);
+        loop = addNode(parser, ForInNodeType, offset, addExtra4(parser, names, iterable, step, body), reverse);
+    } else {
+        advance(parser);
+        const NodeIndex cond = check(parser, TK_SEMICOLON) ? NODE_NONE : expression(parser);
+        eat(parser, TK_SEMICOLON, "Expected ; after the for's condition.");
+        const NodeIndex step = check(parser, TK_RPAREN) ? NODE_NONE : simpleStatement(parser);
+        --parser->nesting;
+        eat(parser, TK_RPAREN, "Expected ) after the for's step.");
+        const NodeIndex body = block(parser);
+        loop = addNode(parser, ForNodeType, offset, addExtra4(parser, init, cond, step, body), 0);
+    }
+
+    return loop;
+}
+
+static NodeIndex statement(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+
+    switch (parser->current.type) {
+        case TK_LBRACE:
+            return block(parser);
+        case TK_IF:
+            advance(parser);
+            return ifStatement(parser, offset);
+        case TK_WHILE:
+        case TK_UNTIL: {
+            const NodeKind kind = check(parser, TK_WHILE) ? WhileNodeType : UntilNodeType;
+            advance(parser);
+            const NodeIndex cond = condition(parser);
+            const NodeIndex body = block(parser);
+            return addNode(parser, kind, offset, cond, body);
+        }
+        case TK_FOR:
+            return forStatement(parser);
+        case TK_RETURN: {
+            advance(parser);
+            const int top = parser->scratchCount;
+            if (!check(parser, TK_RBRACE) && !check(parser, TK_SEMICOLON) && !check(parser, TK_EOF) &&
+                !newlineBefore(parser)) {
+                do {
+                    pushScratch(parser, expression(parser));
+                } while (!parser->panicMode && match(parser, TK_COMMA));
+            }
+            return addNode(parser, ReturnNodeType, offset, finishList(parser, top), 0);
+        }
+        case TK_BREAK:
+            advance(parser);
+            return addNode(parser, BreakNodeType, offset, 0, 0);
+        case TK_CONTINUE:
+            advance(parser);
+            return addNode(parser, ContinueNodeType, offset, 0, 0);
+        case TK_DEFER:
+        case TK_DEFER_ERR: {
+            advance(parser);
+            const NodeIndex deferred = statement(parser);
+            return addNode(parser, DeferNodeType, offset, deferred, 0);
+        }
+        case TK_DELETE: {
+            advance(parser);
+            const NodeIndex value = expression(parser);
+            return addNode(parser, DeleteNodeType, offset, value, 0);
+        }
+        case TK_HASH: {
+            if (startsSet(parser)) {
+                return setDeclaration(parser);
+            }
+            const uint32_t flags = attribute(parser);
+            return check(parser, TK_RBRACE) ? NODE_NONE : markInlineCall(parser, statement(parser), flags);
+        }
+        case TK_USE:
+        case TK_USING:
+            useDeclaration(parser);
+            return NODE_NONE;
+        case TK_SEMICOLON:
+            return NODE_NONE;
+        default:
+            return simpleStatement(parser);
+    }
+}
+
+static NodeIndex block(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    if (!match(parser, TK_LBRACE)) {
+        errorAtCurrent(parser, "Expected {.");
+        return NODE_NONE;
+    }
+
+    // Braces start over, a line break ends a statement even inside parentheses around the block.
+    const bool noStructLiteral = parser->noStructLiteral;
+    const int nesting = parser->nesting;
+    parser->noStructLiteral = false;
+    parser->nesting = 0;
+
+    const int top = parser->scratchCount;
+    while (!check(parser, TK_RBRACE) && !check(parser, TK_EOF)) {
+        const NodeIndex item = statement(parser);
+        if (item != NODE_NONE) {
+            pushScratch(parser, item);
+        }
+
+        if (!parser->panicMode && !match(parser, TK_SEMICOLON) && !check(parser, TK_RBRACE) &&
+            !check(parser, TK_EOF) && !newlineBefore(parser)) {
+            errorAtCurrent(parser, "Expected a new line or ; after the statement.");
+        }
+        if (parser->panicMode) {
+            synchronize(parser);
+        }
+    }
+    eat(parser, TK_RBRACE, "Expected } at the end of the block.");
+
+    parser->noStructLiteral = noStructLiteral;
+    parser->nesting = nesting;
+
+    return addNode(parser, BlockNodeType, offset, finishList(parser, top), 0);
+}
+
+// impl Type [does Behavior] ... endimpl [Type]
+static NodeIndex implDeclaration(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    advance(parser);
+
+    if (!check(parser, TK_IDENT)) {
+        expectedAfter(parser, "identifier", "impl");
+        return NODE_NONE;
+    }
+    const uint32_t name = tokenSymbol(parser, &parser->current);
+    advance(parser);
+    if (check(parser, TK_LT)) {
+        skipAngles(parser);
+    }
+    if (match(parser, TK_DOES)) {
+        parseType(parser); // Checked against the behavior once there are types.
+    }
+
+    parser->currentImpl = name;
+    const int top = parser->scratchCount;
+    while (!check(parser, TK_END_IMPL) && !check(parser, TK_EOF)) {
+        if (match(parser, TK_FN) || match(parser, TK_MD)) {
+            const NodeIndex method = fnDeclaration(parser);
+            if (method != NODE_NONE) {
+                pushScratch(parser, method);
+            }
+        } else if (check(parser, TK_HASH)) {
+            parser->attributes |= attribute(parser);
+            continue;
+        } else {
+            errorAtCurrent(parser, "Expected a method.");
+        }
+        clearAttributes(parser);
+
+        if (parser->panicMode) {
+            synchronize(parser);
+            match(parser, TK_RBRACE);
+        }
+    }
+    parser->currentImpl = 0;
+
+    eat(parser, TK_END_IMPL, "Expected endimpl.");
+    if (check(parser, TK_IDENT) && !newlineBefore(parser)) {
+        advance(parser);
+    }
+
+    return addNode(parser, ImplNodeType, offset, name, finishList(parser, top));
+}
+
+// type Name struct {...}. Behaviors, enums and aliases are skipped for now.
+static NodeIndex typeDeclaration(Parser *parser) {
+    const uint32_t offset = parser->current.offset;
+    advance(parser);
+
+    if (!check(parser, TK_IDENT)) {
+        expectedAfter(parser, "identifier", "type");
+        return NODE_NONE;
+    }
+    const uint32_t name = tokenSymbol(parser, &parser->current);
+    advance(parser);
+    const uint32_t parameters = check(parser, TK_LT) ? typeParameters(parser) : LIST_EMPTY;
+
+    if (!match(parser, TK_STRUCT)) {
+        skipLine(parser);
+        return NODE_NONE;
+    }
+
+    const int top = parser->scratchCount;
+    eat(parser, TK_LBRACE, "Expected { after struct.");
+    parseArguments(parser, TK_RBRACE);
+    const uint32_t fields = finishList(parser, top);
+
+    return addNode(parser, StructNodeType, offset, name, addExtra2(parser, fields, parameters));
+}
+
+static void declaration(Parser *parser) {
+    NodeIndex decl = NODE_NONE;
+
+    switch (parser->current.type) {
+        case TK_NAMESPACE:
+            advance(parser);
+            namespaceDeclaration(parser);
+            break;
+        case TK_FN:
+        case TK_MD:
+            advance(parser);
+            decl = fnDeclaration(parser);
+            break;
+        case TK_EXTERN:
+            advance(parser);
+            if (match(parser, TK_FN)) {
+                decl = fnDeclaration(parser);
+            }
+            break;
+        case TK_IMPL:
+            decl = implDeclaration(parser);
+            break;
+        case TK_LET:
+        case TK_VAL:
+        case TK_CONST:
+            decl = varDeclaration(parser);
+            break;
+        case TK_USE:
+        case TK_USING:
+            useDeclaration(parser);
+            break;
+        case TK_TYPEDEF:
+            skipLine(parser);
+            break;
+        case TK_TEST:
+        case TK_SKIP:
+            // Tests only build in test mode.
+            while (!check(parser, TK_LBRACE) && !check(parser, TK_EOF)) {
+                advance(parser);
+            }
+            skipGroup(parser);
+            break;
+        case TK_HASH:
+            if (startsSet(parser)) {
+                decl = setDeclaration(parser);
+            } else {
+                parser->attributes |= attribute(parser);
+                return; // Kept for the declaration after it.
+            }
+            break;
+        case TK_IDENT:
+            if (identIs(parser, "type", 4) && checkNext(parser, TK_IDENT)) {
+                decl = typeDeclaration(parser);
+            } else if (startsShortVar(parser)) {
+                decl = shortVarDeclaration(parser);
+            } else {
+                advance(parser); // TODO: Remove.
+            }
+            break;
+        default:
+            advance(parser); // package, conditional compilation braces, stray ; and the like.
+            break;
+    }
+
+    clearAttributes(parser);
+    if (decl != NODE_NONE) {
+        pushScratch(parser, decl);
+    }
+    if (parser->panicMode) {
+        synchronize(parser);
+        match(parser, TK_RBRACE);
     }
 }
 
 ParseResults *parseFile(const char *file, CompilerConfig *config) {
+    return parseFileWithLexer(file, initLexer(file), config);
+}
+
+ParseResults *parseFileWithLexer(const char *file, Lexer *lexer, CompilerConfig *config) {
     if (config == nullptr) {
         println("Invalid compiler config sent to parser.");
+        freeLexer(lexer);
         return nullptr;
     }
 
-    Parser *parser = initParser(file, config);
+    Parser *parser = initParser(file, lexer, config);
     if (parser == nullptr) {
         println("Could not initialize parser.");
+        freeLexer(lexer);
         return nullptr;
     }
-    
+
     if (parser->lexer == nullptr) {
-        free(parser->results->nodes.list);
-        free(parser->results);
+        freeParseResults(parser->results);
         freeParser(parser);
         return nullptr;
     }
 
-    while (!match(parser, TK_EOF)) {
+    while (!check(parser, TK_EOF)) {
         declaration(parser);
     }
-    
-//    while (parser->current.type != TK_EOF) {
-//        printToken(parser->current);
-//        advance(parser);
-//    }
+    parser->results->ast.decls = finishList(parser, 0);
 
+    // Skipped bodies are parsed from the same source later.
     ParseResults *results = parser->results;
+    if (parser->skippedBodies > 0) {
+        results->lexer = parser->lexer;
+        parser->lexer = nullptr;
+    }
     freeParser(parser);
 
     return results;
 }
+
+bool parseFunctionBody(ParseResults *results, const NodeIndex function, CompilerConfig *config) {
+    Ast *ast = &results->ast;
+    const NodeIndex lazy = ast->data[function].b;
+    if (astKind(ast, function) != FunctionNodeType || astKind(ast, lazy) != LazyBodyNodeType) {
+        return true;
+    }
+
+    const uint32_t start = ast->offsets[lazy];
+    const uint32_t end = ast->data[lazy].b;
+    if (results->lexer == nullptr) {
+        results->lexer = initLexer(results->file);
+        if (results->lexer == nullptr) {
+            return false;
+        }
+    }
+
+    // The file changed since it was parsed, only possible when it is read again for a tree from the cache.
+    Lexer *lexer = results->lexer;
+    if (lexer->length < end || lexer->source[start] != '{' || lexer->source[end - 1] != '}') {
+        println("'%s' changed while it was being compiled.", results->file);
+        return false;
+    }
+
+    Parser parser;
+    startParser(&parser, results, lexer, config);
+    lexer->start = lexer->current = lexer->source + start;
+    lexer->prev = start > 0 ? lexer->source[start - 1] : '\0';
+    parser.previousEnd = start;
+
+    // Keep each name at the index the first pass gave it.
+    for (int i = 1; i < ast->symbolCount; ++i) {
+        localSymbol(&parser, ast->symbols[i]);
+    }
+
+    parser.current.type = TK_UNKNOWN;
+    parser.current.offset = start;
+    parser.current.len = 0;
+    pull(&parser);
+    advance(&parser);
+
+    const NodeIndex body = block(&parser);
+    if (body != NODE_NONE) {
+        ast->data[function].b = body;
+    }
+
+    free(parser.scratch);
+    free(parser.localKeys);
+    free(parser.localValues);
+
+    return body != NODE_NONE;
+}
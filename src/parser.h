@@ -23,132 +23,65 @@
 #ifndef NIFTY_PARSER_H
 #define NIFTY_PARSER_H
 
+#include "ast.h"
+#include "diagnostic.h"
 #include "lexer.h"
 
 #include "common.h"
+#include "util/arena.h"
 
-typedef enum {
-    TYPE_U8,
-    TYPE_U16,
-    TYPE_U32,
-    TYPE_U64,
-    TYPE_U28,
-    TYPE_S8,
-    TYPE_S16,
-    TYPE_S32,
-    TYPE_S64,
-    TYPE_S28,
-    TYPE_F32,
-    TYPE_F64,
-    TYPE_F128,
-    TYPE_B8,
-    TYPE_B16,
-    TYPE_B32,
-    TYPE_B64,
-
-    TYPE_STRING,
-    TYPE_CHAR,
-
-    TYPE_ARRAY,
-    TYPE_SLICE,
-    TYPE_STRUCT,
-    TYPE_ENUM,
-
-    TYPE_POINTER,
-    TYPE_UINTPTR,
-
-    TYPE_TYPE_ID,
-
-    TYPE_ANY,
-    TYPE_NONE,
-} TypeKind;
-
-typedef struct Node Node;
-
-typedef struct {
-    int count;
-    int capacity;
-    Node **list;
-} Nodes;
-
-typedef enum {
-    VoidNodeType,
-
-    PrototypeNodeType,
-
-    BlockNodeType,
-    ReturnNodeType,
-
-    FunctionNodeType,
-
-    AddNodeType,
-    SubNodeType,
-    MulNodeType,
-    DivNodeType,
-} NodeKind;
-
-typedef struct {
-    int line;
-    int pos;
-} Location;
-
-typedef struct TypeNode { char *name; TypeKind typeKind; } TypeNode;
-typedef struct ArgNode { char *name; TypeNode type; } ArgNode;
-typedef struct PrototypeNode { char *name; ArgNode **args; TypeNode **returnTypes; } PrototypeNode;
-typedef struct BlockNode { Nodes statements; } BlockNode;
-typedef struct ReturnNode { Node *statement; } ReturnNode;
-typedef struct FunctionNode { PrototypeNode *prototype; BlockNode *body; } FunctionNode;
-
-typedef struct AddNode { Node *left; Node *right; } AddNode;
-typedef struct SubNode { Node *left; Node *right; } SubNode;
-typedef struct MulNode { Node *left; Node *right; } MulNode;
-typedef struct DivNode { Node *left; Node *right; } DivNode;
-
-struct Node {
-    Location location;
-    NodeKind kind;
-
-    union {
-        TypeNode typeNode;
-        ArgNode argNode;
-        PrototypeNode prototypeNode;
-
-        BlockNode blockNode;
-        ReturnNode returnNode;
-
-        FunctionNode functionNode;
-
-        AddNode addNode;
-        SubNode subNode;
-        MulNode mulNode;
-        DivNode divNode;
-    } data;
-};
-
-// One results per file.
+// One results per file. The tree and the arena holding the rest are freed all at once with the results.
 typedef struct {
     const char *file;
-    Nodes nodes;
+    Symbol namespace; // SYMBOL_NONE for files without a namespace declaration.
+    Ast ast;
     int errorCount;
+    DiagnosticBuffer diagnostics; // Rendered once every file is parsed.
 
     int runTime; // In ms.
-} ParseResults;
 
-typedef struct {
-    char *name;
-    // List of files
-    // Symbol table
-} Namespace;
+    // The source skipped bodies are parsed from, kept while the tree has any, see parseFunctionBody. Trees from the AST
+    // cache read it for the first body parsed.
+    Lexer *lexer;
+
+    Arena arena;
+} ParseResults;
 
 typedef struct {
     Lexer *lexer;
+    TokenStream *tokens; // nullptr when pulling tokens from the lexer one at a time.
+    int tokenIndex; // Index of next in tokens.
     Token current;
     Token next;
+    NumberLiteral currentNumber; // Value of current if it is a TK_NUMBER.
+    NumberLiteral nextNumber;
+    int numberIndex; // Next entry of tokens->numbers.
+    uint32_t previousEnd; // End offset of the token before current.
+    bool noStructLiteral; // Set in conditions, where "if x == y {" opens a block.
+    int nesting; // Open parentheses and brackets, line breaks don't end expressions inside them.
+
+    // Children of the lists being parsed. A list takes its items off the top when it is finished.
+    uint32_t *scratch;
+    int scratchCount;
+    int scratchCapacity;
+
+    // Global symbol to its index in the file's names, open addressing.
+    Symbol *localKeys;
+    uint32_t *localValues;
+    int localCount;
+    int localCapacity;
+
     bool hadError;
     bool panicMode;
-    char *currentImpl;
-    Namespace namespace;
-    int namepsaceLine;
+    int skippedBodies; // LazyBodyNodeTypes left in the tree.
+    uint32_t currentImpl; // Name of the type, in the file's names.
+    uint32_t attributes; // FunctionFlags of the attributes since the last declaration, for the next function.
+    uint32_t inNames[FN_IN_ARGS]; // Arguments #[in("a")] named since the last declaration, in the file's names.
+    int inNameCount;
+    uint32_t outNames[FN_IN_ARGS]; // The same for #[out("a")].
+    int outNameCount;
+    Symbol namespace; // Declared by the file. What it declares goes into the program's SymbolTable, see symtab.h.
+    uint32_t namespaceOffset;
 
     ParseResults *results;
     CompilerConfig *compilerConfig;
@@ -163,6 +96,17 @@ typedef struct {
 } Local;
 
 ParseResults *parseFile(const char *file, CompilerConfig *config);
+// Parses the source of lexer, which the parser takes ownership of. nullptr if lexer is nullptr.
+ParseResults *parseFileWithLexer(const char *file, Lexer *lexer, CompilerConfig *config);
+
+// With config->lazyBodies the parser leaves a LazyBodyNodeType in place of most function bodies, and keeps the file's
+// source in the results. This lexes and parses the body of function, a FunctionNodeType, and appends it to the tree.
+// The tokens of the file aren't kept, lexing one body again costs less than holding every file's tokens until it is
+// checked. Errors in it go to the results' diagnostics. Nothing to do for functions that already have their body.
+// Bodies of one file are parsed one at a time. False if the file can't be read.
+bool parseFunctionBody(ParseResults *results, NodeIndex function, CompilerConfig *config);
+// Frees the source kept for parseFunctionBody, once no more bodies of the file will be parsed.
+void freeParseSource(ParseResults *results);
 void freeParseResults(ParseResults *results);
 
 #endif //NIFTY_PARSER_H
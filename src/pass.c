@@ -0,0 +1,294 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "pass.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/thread.h"
+#include "util/timer.h"
+
+// Blocks nothing jumps to from the entry block, and the edges out of them, are removed.
+static int removeUnreachableBlocks(const IrModule *module, IrFunction *function, StrBuffer *errors) {
+    (void)module;
+    (void)errors;
+
+    bool *reached = (bool *)calloc(function->blockCount + 1, sizeof(bool));
+    IrBlock *stack = (IrBlock *)malloc(sizeof(IrBlock) * (function->blockCount + 1));
+    int top = 0;
+    stack[top++] = 0;
+    reached[0] = true;
+    while (top > 0) {
+        IrBlock succs[2];
+        const int count = irSuccessors(function, stack[--top], succs);
+        for (int i = 0; i < count; ++i) {
+            if (!reached[succs[i]]) {
+                reached[succs[i]] = true;
+                stack[top++] = succs[i];
+            }
+        }
+    }
+
+    int removed = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        IrBlockData *block = &function->blocks[b];
+        if (reached[b] || block->removed) {
+            continue;
+        }
+
+        IrBlock succs[2];
+        const int count = irSuccessors(function, (IrBlock)b, succs);
+        for (int i = 0; i < count; ++i) {
+            removeIrEdge(function, (IrBlock)b, succs[i]);
+        }
+        for (int i = 0; i < block->count; ++i) {
+            removeIrInst(function, block->insts[i], IR_NONE);
+        }
+        block->count = 0;
+        block->predCount = 0;
+        block->removed = true;
+        ++removed;
+    }
+    free(stack);
+    free(reached);
+
+    // Phis that lost an edge can be left with one value.
+    if (removed > 0) {
+        compactIrFunction(function);
+        removeTrivialPhis(function);
+    }
+    return removed;
+}
+
+static void markOperand(IrFunction *function, IrValue *operand, void *context) {
+    IrValue **top = (IrValue **)context;
+    if (!function->insts[*operand].flags) {
+        function->insts[*operand].flags = 1;
+        *(*top)++ = *operand;
+    }
+}
+
+// Instructions without effects whose values nothing uses are removed, and so are the ones only they used.
+static int removeDeadInstructions(const IrModule *module, IrFunction *function, StrBuffer *errors) {
+    (void)module;
+    (void)errors;
+
+    IrValue *stack = (IrValue *)malloc(sizeof(IrValue) * (function->instCount + 1));
+    IrValue *top = stack;
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count; ++i) {
+            IrInst *inst = &function->insts[block->insts[i]];
+            inst->flags = irHasEffects((IrOp)inst->op);
+            if (inst->flags) {
+                *top++ = block->insts[i];
+            }
+        }
+    }
+    while (top > stack) {
+        irForEachOperand(function, *--top, markOperand, &top);
+    }
+    free(stack);
+
+    int removed = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count; ++i) {
+            IrInst *inst = &function->insts[block->insts[i]];
+            if (!inst->flags) {
+                removeIrInst(function, block->insts[i], IR_NONE);
+                ++removed;
+            }
+            inst->flags = 0;
+        }
+    }
+
+    if (removed > 0) {
+        compactIrFunction(function);
+    }
+    return removed;
+}
+
+static int verify(const IrModule *module, IrFunction *function, StrBuffer *errors) {
+    return !verifyIrFunction(module, function, errors);
+}
+
+static const Pass passes[] = {
+    {"fold", PASS_FUNCTION, foldConstants, nullptr},
+    {"cfg", PASS_FUNCTION, removeUnreachableBlocks, nullptr},
+    {"dce", PASS_FUNCTION, removeDeadInstructions, nullptr},
+    {"inline", PASS_MODULE, nullptr, inlineCalls},
+    {"escape", PASS_MODULE, nullptr, lowerAllocations},
+    {"bounds", PASS_MODULE, nullptr, removeBoundsChecks},
+    {"overflow", PASS_MODULE, nullptr, removeOverflowChecks},
+    {"traps", PASS_FUNCTION, lowerChecks, nullptr},
+    {"loops", PASS_MODULE, nullptr, optimizeLoops},
+    {"verify", PASS_FUNCTION, verify, nullptr},
+};
+#define PASS_COUNT ((int)(sizeof(passes) / sizeof(passes[0])))
+
+// Bounds goes before overflow, it takes the overflow checks of a loop's counter as what keeps it from going negative.
+// Loops goes after traps, so the checks left are branches it can see leave the loop.
+static const char *const defaultPasses[] = {"fold", "cfg",    "dce",      "inline", "fold",  "cfg", "escape",
+                                            "dce",  "bounds", "overflow", "traps",  "loops", "dce", "verify"};
+#define DEFAULT_PASS_COUNT ((int)(sizeof(defaultPasses) / sizeof(defaultPasses[0])))
+
+const Pass *findPass(const char *name) {
+    for (int i = 0; i < PASS_COUNT; ++i) {
+        if (str_eq(passes[i].name, name)) {
+            return &passes[i];
+        }
+    }
+
+    return nullptr;
+}
+
+// The function passes from first to last, in order, over one function.
+typedef struct {
+    const IrModule *module;
+    IrFunction *function;
+    const Pass **passes;
+    int first;
+    int last;
+    uint64_t ns[MAX_PASS_TIMES];
+    int changes[MAX_PASS_TIMES];
+    StrBuffer errors;
+} PassTask;
+
+static void passTask(void *arg) {
+    PassTask *task = (PassTask *)arg;
+    for (int i = task->first; i < task->last; ++i) {
+        const uint64_t start = timer_now_ns();
+        task->changes[i] += task->passes[i]->runFunction(task->module, task->function, &task->errors);
+        task->ns[i] += timer_now_ns() - start;
+    }
+}
+
+// The time of pass, added on its first run.
+static PassTime *passTime(PhaseTimes *times, const Pass *pass) {
+    for (int i = 0; i < times->passCount; ++i) {
+        if (str_eq(times->passes[i].name, pass->name)) {
+            return &times->passes[i];
+        }
+    }
+    if (times->passCount == MAX_PASS_TIMES) {
+        return nullptr;
+    }
+
+    PassTime *time = &times->passes[times->passCount++];
+    time->name = pass->name;
+    time->ns = 0;
+    time->changes = 0;
+    time->module = pass->kind == PASS_MODULE;
+    return time;
+}
+
+bool runPasses(IrModule *module, const char *const *names, const int count) {
+    if (count > MAX_PASS_TIMES) {
+        println("At most %d passes can run at once.", MAX_PASS_TIMES);
+        return false;
+    }
+
+    const Pass *pipeline[MAX_PASS_TIMES];
+    for (int i = 0; i < count; ++i) {
+        pipeline[i] = findPass(names[i]);
+        if (pipeline[i] == nullptr) {
+            println("No pass is named %s.", names[i]);
+            return false;
+        }
+    }
+
+    const CompilerConfig *config = module->config;
+    ThreadPool *pool = config->threadPool != nullptr ? config->threadPool : pool_new(config->threads);
+    PassTask *tasks = (PassTask *)calloc(module->functionCount + 1, sizeof(PassTask));
+    for (int i = 0; i < module->functionCount; ++i) {
+        tasks[i].module = module;
+        tasks[i].function = module->functions[i];
+        tasks[i].passes = pipeline;
+        str_buf_init(&tasks[i].errors);
+    }
+
+    StrBuffer errors;
+    str_buf_init(&errors);
+    PhaseTimes *times = &module->program->times;
+    for (int first = 0; first < count;) {
+        if (pipeline[first]->kind == PASS_MODULE) {
+            const uint64_t start = timer_now_ns();
+            const int changes = pipeline[first]->runModule(module, &errors);
+            PassTime *time = passTime(times, pipeline[first]);
+            if (time != nullptr) {
+                time->ns += timer_now_ns() - start;
+                time->changes += changes;
+            }
+            ++first;
+            continue;
+        }
+
+        int last = first;
+        while (last < count && pipeline[last]->kind == PASS_FUNCTION) {
+            ++last;
+        }
+        TaskGroup group = TASK_GROUP_INIT;
+        for (int i = 0; i < module->functionCount; ++i) {
+            tasks[i].first = first;
+            tasks[i].last = last;
+            pool_submit_group(pool, &group, passTask, &tasks[i]);
+        }
+        pool_wait_group(pool, &group);
+        first = last;
+    }
+    if (pool != config->threadPool) {
+        pool_free(pool);
+    }
+
+    // Function passes are summed over threads, and errors are in function order whichever task finished first.
+    for (int i = 0; i < count; ++i) {
+        if (pipeline[i]->kind == PASS_MODULE) {
+            continue;
+        }
+
+        PassTime *time = passTime(times, pipeline[i]);
+        for (int j = 0; j < module->functionCount && time != nullptr; ++j) {
+            time->ns += tasks[j].ns[i];
+            time->changes += tasks[j].changes[i];
+        }
+    }
+    for (int i = 0; i < module->functionCount; ++i) {
+        if (tasks[i].errors.len > 0) {
+            str_buf_append_len(&errors, tasks[i].errors.data, tasks[i].errors.len);
+        }
+        str_buf_free(&tasks[i].errors);
+    }
+    free(tasks);
+
+    const bool passed = errors.len == 0;
+    if (!passed) {
+        fwrite(errors.data, 1, errors.len, stderr);
+    }
+    str_buf_free(&errors);
+    return passed;
+}
+
+bool runDefaultPasses(IrModule *module) {
+    return runPasses(module, defaultPasses, DEFAULT_PASS_COUNT);
+}
@@ -0,0 +1,83 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_PASS_H
+#define NIFTY_PASS_H
+
+#include "common.h"
+#include "ir.h"
+#include "util/str.h"
+
+// Passes over a module's IR, run in order by name. A function pass sees one function at a time and runs on the
+// config's thread pool, one task per function for each run of function passes in a row. A module pass sees the whole
+// module, and every function pass before it has finished with every function when it starts.
+//
+// Passes return how many changes they made, which --time-report shows with the time of each. Problems that mean the
+// compiler is wrong, like IR that doesn't verify, go to errors.
+
+typedef enum {
+    PASS_FUNCTION,
+    PASS_MODULE,
+} PassKind;
+
+typedef struct {
+    const char *name;
+    PassKind kind;
+    int (*runFunction)(const IrModule *module, IrFunction *function, StrBuffer *errors);
+    int (*runModule)(IrModule *module, StrBuffer *errors);
+} Pass;
+
+// Sparse conditional constant propagation: values known at compile time become literals, with the overflow checks
+// they pass and the branches they decide removed. In fold.c.
+int foldConstants(const IrModule *module, IrFunction *function, StrBuffer *errors);
+// Calls of the module's functions replaced with their bodies, for #[inline] and calls cheap enough to. A module pass,
+// callees are inlined into before their callers. In inline.c.
+int inlineCalls(IrModule *module, StrBuffer *errors);
+// News whose pointer can't outlive the call moved to the stack, and ones a deferred delete frees before every return
+// to a bump region of the call. A module pass, callees first so calls that don't keep a pointer are known. In escape.c.
+int lowerAllocations(IrModule *module, StrBuffer *errors);
+// Bounds checks known to pass removed, and checks of a loop's counter hoisted before the loop as one check of its end.
+// A module pass for its remarks. In bounds.c.
+int removeBoundsChecks(IrModule *module, StrBuffer *errors);
+// Overflow checks that can't fail removed, and saturating arithmetic that can't saturate made the wrapping kind, from
+// the range of each integer. A module pass for its remarks. In overflow.c.
+int removeOverflowChecks(IrModule *module, StrBuffer *errors);
+// The checks left as branches to a cold block per function for each kind of trap. In traps.c.
+int lowerChecks(const IrModule *module, IrFunction *function, StrBuffer *errors);
+
+// Invariant instructions hoisted out of loops, and loops marked with whether they are counted and free of what keeps a
+// C compiler from vectorizing them. A module pass for its remarks, which --vectorize-report shows. In loops.c.
+int optimizeLoops(IrModule *module, StrBuffer *errors);
+
+// nullptr if no pass has the name.
+const Pass *findPass(const char *name);
+
+// Runs the passes named, in order, then prints any errors to stderr, off the stdout JSON diagnostics go to. Returns
+// false if a pass reported errors, or if a name isn't a pass, without running any.
+bool runPasses(IrModule *module, const char *const *names, int count);
+// What building runs: constants folded, unreachable blocks removed and dead instructions removed, then calls inlined,
+// the same again over what they became with news lowered before the dead instructions go, then bounds and overflow
+// checks that can't fail removed and the rest branched to traps, loops hoisted out of and marked for vectorizing, with
+// the dead instructions that leaves removed, and the result verified.
+bool runDefaultPasses(IrModule *module);
+
+#endif //NIFTY_PASS_H
@@ -0,0 +1,817 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "program.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "astcache.h"
+#include "diagnostic.h"
+#include "intern.h"
+#include "lexer.h"
+#include "symtab.h"
+#include "util/array.h"
+#include "util/fs.h"
+#include "util/hash.h"
+#include "util/str.h"
+#include "util/thread.h"
+#include "util/timer.h"
+
+#define NIFTY_SOURCE_EXTENSION ".nifty"
+
+typedef struct SourceFile SourceFile;
+typedef struct Scheduler Scheduler;
+
+struct SourceFile {
+    char *path; // Real path, so a file is parsed once however it is reached.
+    char *dir;
+    const char *name; // As shown in messages, relative to the working directory when it is inside it.
+    uint64_t hash;
+    Scheduler *scheduler;
+    ParseResults *results;
+
+    // Set under the scheduler's lock.
+    bool parsed;
+    bool expanded; // Its uses have been followed, at most once.
+    bool used; // Named by a use, not only next to a file of some namespace.
+    Symbol *namespaces; // Namespaces of the files next to it that pulled it in, it belongs if it declares one.
+    int namespaceCount;
+
+    // Written by the task that parses the file and the one that expands it, read once every task is done.
+    uint64_t parseNs;
+    uint64_t declareNs;
+    int declarations;
+    SourceFile **uses;
+    int useCount;
+    int useCapacity;
+
+    bool visited;
+};
+
+// The files of one directory, pulled in by the first file there that declared namespace.
+typedef struct {
+    const char *dir;
+    Symbol namespace;
+    SourceFile **files; // Sorted by path.
+    int fileCount;
+} NamespaceDir;
+
+struct Scheduler {
+    CompilerConfig *config;
+    SymbolTable *symbols;
+    ThreadPool *pool;
+    TaskGroup group;
+    char *workingDir;
+
+    Mutex lock;
+    SourceFile **table; // Open addressing on the path's hash.
+    int capacity;
+    int count;
+    NamespaceDir **dirs;
+    int dirCount;
+    int dirCapacity;
+};
+
+static bool wanted(const SourceFile *file) {
+    if (file->used) {
+        return true;
+    }
+
+    if (file->results == nullptr || file->results->namespace == SYMBOL_NONE) {
+        return false;
+    }
+
+    for (int i = 0; i < file->namespaceCount; ++i) {
+        if (file->namespaces[i] == file->results->namespace) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static SourceFile *newSourceFile(Scheduler *scheduler, char *path, const uint64_t hash) {
+    SourceFile *file = (SourceFile *)calloc(1, sizeof(SourceFile));
+    if (file == nullptr) {
+        println("Out of memory.");
+        exit(1);
+    }
+
+    file->path = path;
+    file->dir = fs_dir_of(path);
+    file->hash = hash;
+    file->scheduler = scheduler;
+
+    const int rootLen = str_len(scheduler->workingDir);
+    const bool inside = str_eq_len(path, scheduler->workingDir, rootLen) && path[rootLen] == '/';
+    file->name = inside ? path + rootLen + 1 : path;
+
+    return file;
+}
+
+static void freeSourceFile(SourceFile *file) {
+    str_delete(file->path);
+    str_delete(file->dir);
+    free(file->namespaces);
+    free(file->uses);
+    free(file);
+}
+
+static void growTable(Scheduler *scheduler) {
+    const int capacity = scheduler->capacity == 0 ? 64 : scheduler->capacity * 2;
+    SourceFile **table = (SourceFile **)calloc(capacity, sizeof(SourceFile *));
+    if (table == nullptr) {
+        println("Out of memory.");
+        exit(1);
+    }
+
+    for (int i = 0; i < scheduler->capacity; ++i) {
+        SourceFile *file = scheduler->table[i];
+        if (file == nullptr) {
+            continue;
+        }
+
+        int slot = (int)(file->hash & (uint64_t)(capacity - 1));
+        while (table[slot] != nullptr) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        table[slot] = file;
+    }
+
+    free(scheduler->table);
+    scheduler->table = table;
+    scheduler->capacity = capacity;
+}
+
+static void expandFile(SourceFile *file);
+
+static void parseTask(void *arg) {
+    SourceFile *file = (SourceFile *)arg;
+    Scheduler *scheduler = file->scheduler;
+    const uint64_t start = timer_now_ns();
+    ParseResults *results = parseFileCached(file->name, scheduler->config, nullptr);
+    file->parseNs = timer_now_ns() - start;
+
+    mutex_lock(&scheduler->lock);
+    file->results = results;
+    file->parsed = true;
+    const bool expand = !file->expanded && wanted(file);
+    file->expanded |= expand;
+    mutex_unlock(&scheduler->lock);
+
+    if (expand) {
+        expandFile(file);
+    }
+}
+
+static void expandTask(void *arg) {
+    expandFile((SourceFile *)arg);
+}
+
+// Takes path, a real path. A use passes SYMBOL_NONE for namespace, a file pulling in its directory passes its own.
+// New files are parsed on the pool, files that were parsed but left out until now are expanded.
+static SourceFile *requestFile(Scheduler *scheduler, char *path, const Symbol namespace) {
+    const uint64_t hash = hash_bytes(path, str_len(path));
+
+    mutex_lock(&scheduler->lock);
+    if (scheduler->count * 2 >= scheduler->capacity) {
+        growTable(scheduler);
+    }
+
+    int slot = (int)(hash & (uint64_t)(scheduler->capacity - 1));
+    while (scheduler->table[slot] != nullptr && !str_eq(scheduler->table[slot]->path, path)) {
+        slot = (slot + 1) & (scheduler->capacity - 1);
+    }
+
+    SourceFile *file = scheduler->table[slot];
+    const bool added = file == nullptr;
+    if (added) {
+        file = newSourceFile(scheduler, path, hash);
+        scheduler->table[slot] = file;
+        ++scheduler->count;
+    } else {
+        str_delete(path);
+    }
+
+    if (namespace == SYMBOL_NONE) {
+        file->used = true;
+    } else {
+        int i = 0;
+        for (; i < file->namespaceCount && file->namespaces[i] != namespace; ++i) {}
+        if (i == file->namespaceCount) {
+            file->namespaces = (Symbol *)realloc(file->namespaces, sizeof(Symbol) * (file->namespaceCount + 1));
+            file->namespaces[file->namespaceCount++] = namespace;
+        }
+    }
+
+    const bool expand = file->parsed && !file->expanded && wanted(file);
+    file->expanded |= expand;
+    mutex_unlock(&scheduler->lock);
+
+    if (added) {
+        pool_submit_group(scheduler->pool, &scheduler->group, parseTask, file);
+    } else if (expand) {
+        pool_submit_group(scheduler->pool, &scheduler->group, expandTask, file);
+    }
+
+    return file;
+}
+
+static void addUse(SourceFile *file, SourceFile *used) {
+    if (file->useCount == file->useCapacity) {
+        file->uses = (SourceFile **)array_grow(file->uses, &file->useCapacity, sizeof(SourceFile *));
+    }
+    file->uses[file->useCount++] = used;
+}
+
+// Errors found after parsing go with the file's parse errors, pointing at the use.
+static void useError(const SourceFile *file, const uint32_t offset, const DiagnosticId id, const char *name) {
+    ++file->results->errorCount;
+
+    // The file's lexer is gone, open it again for the line.
+    Lexer *lexer = initLexer(file->name);
+    reportDiagnostic(&file->results->diagnostics, lexer, SEVERITY_ERROR, id, offset, 0, name);
+    freeLexer(lexer);
+}
+
+static void useDirectory(SourceFile *file, const char *dir) {
+    int count = 0;
+    char **files = fs_list_files(dir, NIFTY_SOURCE_EXTENSION, &count);
+    for (int i = 0; i < count; ++i) {
+        char *path = fs_real_path(files[i]);
+        if (path != nullptr) {
+            addUse(file, requestFile(file->scheduler, path, SYMBOL_NONE));
+        }
+    }
+    fs_free_list(files, count);
+}
+
+static void useNamespace(SourceFile *file, const NodeIndex node) {
+    const Ast *ast = &file->results->ast;
+    const NodeData data = ast->data[node];
+    const UseFlags flags = (UseFlags)ast->extra[data.b];
+    const CompilerConfig *config = file->scheduler->config;
+    const Symbol namespace = astSymbol(ast, data.a);
+    if (namespace == SYMBOL_NONE || config->interner == nullptr) {
+        return;
+    }
+
+    const char *base = flags & USE_PATH ? file->dir : config->nslPath;
+    if (base == nullptr) {
+        return;
+    }
+
+    // foo::bar is the directory foo/bar or the file foo/bar.nifty.
+    int len = 0;
+    const char *name = symbolName(config->interner, namespace, &len);
+    char *relative = str_new_len(name, len);
+    int at = 0;
+    for (int i = 0; i < len; ++i, ++at) {
+        if (name[i] == ':' && name[i + 1] == ':') {
+            relative[at] = '/';
+            ++i;
+        } else {
+            relative[at] = name[i];
+        }
+    }
+    relative[at] = '\0';
+
+    char *path = fs_join(base, relative);
+    if (fs_is_dir(path)) {
+        useDirectory(file, path);
+    } else {
+        char *source = str_new_fmt(nullptr, "%s%s", path, NIFTY_SOURCE_EXTENSION);
+        char *real = fs_is_file(source) ? fs_real_path(source) : nullptr;
+        if (real != nullptr) {
+            addUse(file, requestFile(file->scheduler, real, SYMBOL_NONE));
+        } else if (flags & USE_PATH) {
+            useError(file, ast->offsets[node], DIAG_NAMESPACE_NOT_FOUND, name);
+        }
+        str_delete(source);
+    }
+
+    str_delete(path);
+    str_delete(relative);
+}
+
+// The first file to declare a namespace in a directory pulls in the rest of the directory, the files that declare the
+// same namespace belong to the program.
+static void claimDirectory(SourceFile *file) {
+    Scheduler *scheduler = file->scheduler;
+    const Symbol namespace = file->results->namespace;
+
+    mutex_lock(&scheduler->lock);
+    for (int i = 0; i < scheduler->dirCount; ++i) {
+        if (scheduler->dirs[i]->namespace == namespace && str_eq(scheduler->dirs[i]->dir, file->dir)) {
+            mutex_unlock(&scheduler->lock);
+            return;
+        }
+    }
+
+    NamespaceDir *dir = (NamespaceDir *)calloc(1, sizeof(NamespaceDir));
+    dir->dir = file->dir;
+    dir->namespace = namespace;
+    if (scheduler->dirCount == scheduler->dirCapacity) {
+        scheduler->dirs = (NamespaceDir **)array_grow(scheduler->dirs, &scheduler->dirCapacity, sizeof(NamespaceDir *));
+    }
+    scheduler->dirs[scheduler->dirCount++] = dir;
+    mutex_unlock(&scheduler->lock);
+
+    int count = 0;
+    char **files = fs_list_files(file->dir, NIFTY_SOURCE_EXTENSION, &count);
+    dir->files = (SourceFile **)malloc(sizeof(SourceFile *) * (count > 0 ? count : 1));
+    for (int i = 0; i < count; ++i) {
+        if (str_eq(files[i], file->path)) {
+            dir->files[dir->fileCount++] = file;
+            continue;
+        }
+
+        // The directory is a real path already, only the file names are new.
+        dir->files[dir->fileCount++] = requestFile(scheduler, files[i], namespace);
+        files[i] = nullptr;
+    }
+    fs_free_list(files, count);
+}
+
+static void expandFile(SourceFile *file) {
+    if (file->results == nullptr) {
+        return;
+    }
+
+    const Ast *ast = &file->results->ast;
+    for (NodeIndex node = 1; node < (NodeIndex)ast->count; ++node) {
+        if (astKind(ast, node) == UseNodeType) {
+            useNamespace(file, node);
+        }
+    }
+
+    if (file->results->namespace != SYMBOL_NONE) {
+        claimDirectory(file);
+    }
+
+    // Every expanded file ends up in the program, so its declarations stay valid as long as the table.
+    const uint64_t start = timer_now_ns();
+    file->declarations = declareFile(file->scheduler->symbols, file->results);
+    file->declareNs = timer_now_ns() - start;
+}
+
+static const NamespaceDir *findDir(const Scheduler *scheduler, const SourceFile *file) {
+    for (int i = 0; i < scheduler->dirCount; ++i) {
+        const NamespaceDir *dir = scheduler->dirs[i];
+        if (dir->namespace == file->results->namespace && str_eq(dir->dir, file->dir)) {
+            return dir;
+        }
+    }
+
+    return nullptr;
+}
+
+// Depth first from the entry point: a file, what it uses in order, then the rest of its namespace in its directory.
+// Only the parsed trees decide the order, not the timing of the tasks.
+static void visit(const Scheduler *scheduler, SourceFile *file, Program *program) {
+    if (file->visited || file->results == nullptr) {
+        return;
+    }
+    file->visited = true;
+
+    program->files[program->fileCount++] = file->results;
+    program->errorCount += file->results->errorCount;
+    program->times.parse += file->parseNs;
+    program->times.declare += file->declareNs;
+    program->times.declarations += file->declarations;
+
+    for (int i = 0; i < file->useCount; ++i) {
+        visit(scheduler, file->uses[i], program);
+    }
+
+    if (file->results->namespace == SYMBOL_NONE) {
+        return;
+    }
+
+    const NamespaceDir *dir = findDir(scheduler, file);
+    for (int i = 0; dir != nullptr && i < dir->fileCount; ++i) {
+        const SourceFile *mate = dir->files[i];
+        if (mate->results != nullptr && mate->results->namespace == file->results->namespace) {
+            visit(scheduler, dir->files[i], program);
+        }
+    }
+}
+
+// Pairs already resolved by a BodyReach, open addressing on the pair.
+typedef struct {
+    uint64_t *keys; // 0 for an empty slot, names are never SYMBOL_NONE.
+    int count;
+    int capacity;
+} PairSet;
+
+static bool addPair(PairSet *set, const Symbol namespace, const Symbol name) {
+    if (set->count * 2 >= set->capacity) {
+        const int capacity = set->capacity == 0 ? 256 : set->capacity * 2;
+        uint64_t *keys = (uint64_t *)calloc(capacity, sizeof(uint64_t));
+        for (int i = 0; i < set->capacity; ++i) {
+            if (set->keys[i] == 0) {
+                continue;
+            }
+
+            uint32_t at = (uint32_t)(hash_bytes((const char *)&set->keys[i], sizeof(uint64_t))) & (capacity - 1);
+            while (keys[at] != 0) {
+                at = (at + 1) & (capacity - 1);
+            }
+            keys[at] = set->keys[i];
+        }
+        free(set->keys);
+        set->keys = keys;
+        set->capacity = capacity;
+    }
+
+    const uint64_t key = (uint64_t)namespace << 32 | name;
+    uint32_t at = (uint32_t)(hash_bytes((const char *)&key, sizeof(uint64_t))) & (set->capacity - 1);
+    for (; set->keys[at] != 0; at = (at + 1) & (set->capacity - 1)) {
+        if (set->keys[at] == key) {
+            return false;
+        }
+    }
+
+    set->keys[at] = key;
+    ++set->count;
+    return true;
+}
+
+struct BodyReach {
+    Program *program;
+    CompilerConfig *config;
+    PairSet resolved;
+    const Declaration **pending;
+    int pendingCount;
+    int pendingCapacity;
+    const Declaration **parsed; // Of the last parseReachedBodies.
+    int parsedCapacity;
+};
+
+static void reachChain(BodyReach *reach, const Declaration *declaration, const bool byName) {
+    for (; declaration != nullptr; declaration = byName ? declaration->sameName : declaration->next) {
+        if (declaration->kind != DECL_FUNCTION && declaration->kind != DECL_METHOD &&
+            declaration->kind != DECL_OVERLOADS) {
+            continue;
+        }
+
+        if (reach->pendingCount == reach->pendingCapacity) {
+            reach->pending = (const Declaration **)array_grow(reach->pending, &reach->pendingCapacity,
+                                                              sizeof(Declaration *));
+        }
+        reach->pending[reach->pendingCount++] = declaration;
+    }
+}
+
+// What name in namespace can refer to: the declarations of the pair, else of the name outside any namespace, else of
+// the name anywhere, so an alias or a using the lookup doesn't know about yet still reaches its target.
+static void reachName(BodyReach *reach, const Symbol namespace, const Symbol name) {
+    if (name == SYMBOL_NONE || !addPair(&reach->resolved, namespace, name)) {
+        return;
+    }
+
+    ++reach->program->times.lookups;
+    const Declaration *found = lookupSymbol(reach->program->symbols, namespace, name);
+    if (found != nullptr) {
+        reachChain(reach, found, namespace == NAMESPACE_ANY);
+    } else if (namespace != SYMBOL_NONE && namespace != NAMESPACE_ANY) {
+        reachName(reach, SYMBOL_NONE, name);
+    } else if (namespace == SYMBOL_NONE) {
+        reachName(reach, NAMESPACE_ANY, name);
+    }
+}
+
+// Every name nodes [from, to) of file refer to.
+static void reachReferences(BodyReach *reach, const ParseResults *file, const NodeIndex from, const NodeIndex to) {
+    const uint64_t start = timer_now_ns();
+    const Ast *ast = &file->ast;
+    for (NodeIndex i = from; i < to; ++i) {
+        const NodeData data = ast->data[i];
+        switch (astKind(ast, i)) {
+            case IdentNodeType:
+                reachName(reach, file->namespace, astSymbol(ast, data.a));
+                break;
+            case ScopeNodeType: {
+                // ns::f and Type::method, anything else on the left is an expression.
+                const Symbol left = astKind(ast, data.a) == IdentNodeType ? astSymbol(ast, ast->data[data.a].a) : NAMESPACE_ANY;
+                reachName(reach, left, astSymbol(ast, data.b));
+                break;
+            }
+            case MemberNodeType:
+            case PointerMemberNodeType:
+                // Which type's method it is isn't known before type checking.
+                reachName(reach, NAMESPACE_ANY, astSymbol(ast, data.b));
+                break;
+            default:
+                break;
+        }
+    }
+    reach->program->times.lookup += timer_now_ns() - start;
+}
+
+BodyReach *initBodyReach(Program *program, CompilerConfig *config) {
+    BodyReach *reach = (BodyReach *)calloc(1, sizeof(BodyReach));
+    reach->program = program;
+    reach->config = config;
+    for (int i = 0; i < program->fileCount; ++i) {
+        reachReferences(reach, program->files[i], 0, (NodeIndex)program->files[i]->ast.count);
+    }
+    reachName(reach, program->files[0]->namespace, intern(config->interner, "main", 4));
+
+    return reach;
+}
+
+// The bodies of one file a wave of parseReachedBodies parses.
+typedef struct {
+    ParseResults *file;
+    const Declaration **declarations;
+    int count;
+    CompilerConfig *config;
+    uint64_t ns;
+} BodyTask;
+
+static void bodyTask(void *arg) {
+    BodyTask *task = (BodyTask *)arg;
+    const uint64_t start = timer_now_ns();
+    for (int i = 0; i < task->count; ++i) {
+        parseFunctionBody(task->file, task->declarations[i]->node, task->config);
+    }
+    task->ns = timer_now_ns() - start;
+}
+
+// By file, then by node, so a file's bodies are together and each only once.
+static int compareBodies(const void *x, const void *y) {
+    const Declaration *a = *(const Declaration **)x;
+    const Declaration *b = *(const Declaration **)y;
+    if (a->file != b->file) {
+        return (uintptr_t)a->file < (uintptr_t)b->file ? -1 : 1;
+    }
+    return a->node < b->node ? -1 : a->node > b->node;
+}
+
+int parseReachedBodies(BodyReach *reach, struct ThreadPool *pool, const Declaration ***parsed) {
+    Program *program = reach->program;
+    int count = 0;
+    while (reach->pendingCount > 0) {
+        const Declaration *declaration = reach->pending[--reach->pendingCount];
+        const Ast *ast = &declaration->file->ast;
+        if (declaration->kind == DECL_OVERLOADS) {
+            int functionCount;
+            const uint32_t *functions = astList(ast, ast->data[declaration->node].b, &functionCount);
+            for (int j = 0; j < functionCount; ++j) {
+                reachName(reach, declaration->namespace, astSymbol(ast, functions[j]));
+            }
+        } else if (astKind(ast, ast->data[declaration->node].b) == LazyBodyNodeType) {
+            if (count == reach->parsedCapacity) {
+                reach->parsed = (const Declaration **)array_grow(reach->parsed, &reach->parsedCapacity,
+                                                                 sizeof(Declaration *));
+            }
+            reach->parsed[count++] = declaration;
+        }
+    }
+
+    if (count > 0) {
+        qsort(reach->parsed, count, sizeof(Declaration *), compareBodies);
+    }
+    int unique = 0;
+    for (int i = 0; i < count; ++i) {
+        if (unique == 0 || reach->parsed[unique - 1] != reach->parsed[i]) {
+            reach->parsed[unique++] = reach->parsed[i];
+        }
+    }
+    count = unique;
+
+    // One task per file, the bodies of a file all go to the end of its tree.
+    BodyTask *tasks = (BodyTask *)malloc(sizeof(BodyTask) * (count + 1));
+    int taskCount = 0;
+    TaskGroup group = TASK_GROUP_INIT;
+    for (int i = 0; i < count; ++taskCount) {
+        BodyTask *task = &tasks[taskCount];
+        *task = (BodyTask){reach->parsed[i]->file, reach->parsed + i, 0, reach->config, 0};
+        for (; i < count && reach->parsed[i]->file == task->file; ++i) {
+            ++task->count;
+        }
+    }
+
+    int *errors = (int *)malloc(sizeof(int) * (taskCount + 1));
+    NodeIndex *from = (NodeIndex *)malloc(sizeof(NodeIndex) * (taskCount + 1));
+    for (int i = 0; i < taskCount; ++i) {
+        errors[i] = tasks[i].file->errorCount;
+        from[i] = (NodeIndex)tasks[i].file->ast.count;
+        pool_submit_group(pool, &group, bodyTask, &tasks[i]);
+    }
+    pool_wait_group(pool, &group);
+
+    // What the new bodies use is parsed by the next wave.
+    for (int i = 0; i < taskCount; ++i) {
+        program->times.lazyBodies += tasks[i].ns;
+        program->times.bodies += tasks[i].count;
+        program->errorCount += tasks[i].file->errorCount - errors[i];
+        reachReferences(reach, tasks[i].file, from[i], (NodeIndex)tasks[i].file->ast.count);
+    }
+
+    free(from);
+    free(errors);
+    free(tasks);
+    *parsed = reach->parsed;
+    return count;
+}
+
+void freeBodyReach(BodyReach *reach) {
+    if (reach == nullptr) {
+        return;
+    }
+
+    free(reach->pending);
+    free(reach->parsed);
+    free(reach->resolved.keys);
+    free(reach);
+}
+
+static void freeScheduler(Scheduler *scheduler) {
+    for (int i = 0; i < scheduler->capacity; ++i) {
+        SourceFile *file = scheduler->table[i];
+        if (file == nullptr) {
+            continue;
+        }
+
+        // Parsed to find out its namespace, but not part of the program.
+        if (!file->visited) {
+            freeParseResults(file->results);
+        }
+        freeSourceFile(file);
+    }
+
+    for (int i = 0; i < scheduler->dirCount; ++i) {
+        free(scheduler->dirs[i]->files);
+        free(scheduler->dirs[i]);
+    }
+
+    free(scheduler->dirs);
+    free(scheduler->table);
+    str_delete(scheduler->workingDir);
+    mutex_destroy(&scheduler->lock);
+}
+
+Program *parseProgram(const char *entryPoint, CompilerConfig *config) {
+    if (config == nullptr) {
+        println("Invalid compiler config sent to parser.");
+        return nullptr;
+    }
+
+    const uint64_t start = timer_now_ns();
+    char *path = fs_real_path(entryPoint);
+    if (path == nullptr) {
+        println("Could not open '%s' for reading.", entryPoint);
+        return nullptr;
+    }
+
+    Scheduler scheduler = {0};
+    scheduler.config = config;
+    scheduler.symbols = initSymbolTable();
+    scheduler.pool = config->threadPool != nullptr ? config->threadPool : pool_new(config->threads);
+    scheduler.workingDir = fs_real_path(".");
+    if (scheduler.workingDir == nullptr) {
+        scheduler.workingDir = str_new("", nullptr);
+    }
+    mutex_init(&scheduler.lock);
+
+    SourceFile *entry = requestFile(&scheduler, path, SYMBOL_NONE);
+    pool_wait_group(scheduler.pool, &scheduler.group);
+    if (scheduler.pool != config->threadPool) {
+        pool_free(scheduler.pool);
+    }
+
+    Program *program = nullptr;
+    if (entry->results != nullptr) {
+        program = (Program *)malloc(sizeof(Program));
+        program->files = (ParseResults **)malloc(sizeof(ParseResults *) * scheduler.count);
+        program->fileCount = 0;
+        program->errorCount = 0;
+        program->symbols = scheduler.symbols;
+        program->types = nullptr;
+        program->nodeTypes = nullptr;
+        program->constants = nullptr;
+        program->instances = nullptr;
+        program->instanceCount = 0;
+        memset(&program->times, 0, sizeof(PhaseTimes));
+        visit(&scheduler, entry, program);
+        program->runTime = (int)timer_elapsed_ms(start);
+    } else {
+        freeSymbolTable(scheduler.symbols);
+    }
+
+    freeScheduler(&scheduler);
+
+    return program;
+}
+
+void freeProgram(Program *program) {
+    if (program == nullptr) {
+        return;
+    }
+
+    for (int i = 0; i < program->fileCount; ++i) {
+        freeParseResults(program->files[i]);
+        if (program->nodeTypes != nullptr) {
+            free(program->nodeTypes[i]);
+        }
+        if (program->constants != nullptr) {
+            freeConstants(&program->constants[i]);
+        }
+    }
+    free(program->nodeTypes);
+    free(program->constants);
+    free(program->instances);
+    freeTypeTable(program->types);
+    freeSymbolTable(program->symbols);
+    free(program->files);
+    free(program);
+}
+
+int mergeDiagnostics(ParseResults *results, Lexer **lexer, DiagnosticBuffer *found) {
+    int errors = 0;
+    if (found->count > 0 && *lexer == nullptr) {
+        *lexer = initLexer(results->file);
+    }
+
+    for (int j = 0; j < found->count; ++j) {
+        const Diagnostic *d = &found->items[j];
+        reportDiagnostic(&results->diagnostics, *lexer, d->severity, d->id, d->offset, d->length, d->args[0],
+                         d->args[1], d->args[2]);
+        if (d->severity == SEVERITY_ERROR) {
+            ++results->errorCount;
+            ++errors;
+        }
+    }
+    freeDiagnostics(found);
+
+    return errors;
+}
+
+int printProgramDiagnostics(const Program *program, const CompilerConfig *config) {
+    const char **files = (const char **)malloc(sizeof(char *) * (program->fileCount + 1));
+    const DiagnosticBuffer **buffers = (const DiagnosticBuffer **)malloc(sizeof(DiagnosticBuffer *) * (program->fileCount + 1));
+    for (int i = 0; i < program->fileCount; ++i) {
+        files[i] = program->files[i]->file;
+        buffers[i] = &program->files[i]->diagnostics;
+    }
+
+    StrBuffer out;
+    str_buf_init(&out);
+    const int errors = renderDiagnostics(&out, files, buffers, program->fileCount, config, config->jsonDiagnostics);
+    if (out.len > 0) {
+        fwrite(out.data, 1, out.len, stdout);
+    }
+
+    str_buf_free(&out);
+    free(buffers);
+    free(files);
+
+    return errors;
+}
+
+void printTimeReport(const Program *program) {
+    const PhaseTimes *times = &program->times;
+    println("Phase             ms");
+    println("  parse      %8.2f  %d files, summed over threads", (double)times->parse / 1e6, program->fileCount);
+    println("  declare    %8.2f  %d declarations, summed over threads", (double)times->declare / 1e6,
+            times->declarations);
+    println("  lookup     %8.2f  %d lookups", (double)times->lookup / 1e6, times->lookups);
+    println("  bodies     %8.2f  %d function bodies parsed lazily", (double)times->lazyBodies / 1e6, times->bodies);
+    if (program->types != nullptr) {
+        println("  signatures %8.2f  summed over threads", (double)times->signatures / 1e6);
+        println("  check      %8.2f  %d function bodies, %d generic instances, summed over threads",
+                (double)times->check / 1e6, times->checkedBodies, times->instances);
+    }
+    if (times->loweredFunctions > 0) {
+        println("  lower      %8.2f  %d functions, summed over threads", (double)times->lower / 1e6,
+                times->loweredFunctions);
+    }
+    for (int i = 0; i < times->passCount; ++i) {
+        println("  %-10s %8.2f  %d changes, %s", times->passes[i].name, (double)times->passes[i].ns / 1e6,
+                times->passes[i].changes, times->passes[i].module ? "wall time" : "summed over threads");
+    }
+    println("  total      %8d  wall time", program->runTime);
+}
@@ -0,0 +1,129 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_PROGRAM_H
+#define NIFTY_PROGRAM_H
+
+#include "common.h"
+#include "consteval.h"
+#include "parser.h"
+#include "symtab.h"
+#include "types.h"
+
+// Every file of a build. Starting from the entry point, files are found through the use declarations of the files
+// already parsed and parsed on the config's thread pool as soon as they are found:
+//
+//  - use "foo::bar" is foo/bar next to the using file, every .nifty file in it if it is a directory, else foo/bar.nifty.
+//  - use math::random and use <math.random> are found the same way under the config's nslPath. Namespaces the nsl
+//    doesn't have yet are left out.
+//  - Files in the same directory that declare the same namespace are one namespace, and are all part of the program.
+//
+// With the config's lazyBodies, function bodies are skipped while parsing and only the ones reachable from main are
+// parsed, as checkProgram gets to them, so errors in functions nothing calls aren't reported.
+// Most passes --time-report lists, see pass.h.
+#define MAX_PASS_TIMES 16
+
+typedef struct {
+    const char *name;
+    uint64_t ns; // Summed over threads, but for module passes, which run once and are timed by the wall clock.
+    int changes;
+    bool module;
+} PassTime;
+
+// Time spent in each phase, in ns. Files are parsed and declared on the pool, those times are summed over its threads
+// and can add up to more than the wall time.
+typedef struct {
+    uint64_t parse;
+    uint64_t declare;
+    uint64_t lookup;
+    uint64_t lazyBodies;
+    uint64_t signatures;
+    uint64_t check;
+    uint64_t lower;
+    int declarations;
+    int lookups;
+    int bodies;
+    int checkedBodies;
+    int instances;
+    int loweredFunctions;
+    PassTime passes[MAX_PASS_TIMES]; // In the order they first ran.
+    int passCount;
+} PhaseTimes;
+
+// A generic struct or function used with concrete type arguments, found while checking.
+typedef struct {
+    const Declaration *declaration;
+    TypeId type; // The struct's FORM_GENERIC type, or the function's type with the arguments filled in.
+    TypeId args; // The type arguments, as a FORM_GENERIC type of the declaration's name.
+} Instance;
+
+typedef struct {
+    // Entry point first, then every file after the file that first used it, in the order of its uses. Doesn't depend
+    // on the number of threads or on which file finished parsing first.
+    ParseResults **files;
+    int fileCount;
+    int errorCount;
+
+    // Top level declarations of every file, filled as each file is parsed.
+    SymbolTable *symbols;
+
+    // Filled by checkProgram, nullptr until then. The type of every node of each file, TYPE_ID_NONE where it has none
+    // or it isn't known, and every instance of a generic, sorted by declaration and then by the spelling of its type.
+    TypeTable *types;
+    TypeId **nodeTypes;
+    Instance *instances;
+    int instanceCount;
+    // Also by checkProgram, the values of each file's constant declarations by the nodes of their values.
+    ConstantTable *constants;
+
+    PhaseTimes times;
+    int runTime; // In ms.
+} Program;
+
+// nullptr if the entry point can't be read.
+Program *parseProgram(const char *entryPoint, CompilerConfig *config);
+void freeProgram(Program *program);
+
+// The skipped bodies of the functions main can reach. Until they are checked, names are resolved only as far as the
+// symbol table can: x in the file's namespace, ns::x and Type::x in ns and Type, falling back to every declaration of
+// the name, so more bodies may be parsed than needed but never too few. Everything parsed up front, global values,
+// default arguments and bodies that weren't skipped, counts as reached from the start.
+typedef struct BodyReach BodyReach;
+
+BodyReach *initBodyReach(Program *program, CompilerConfig *config);
+// Parses the bodies reached since the last call on pool, one task per file, and reaches what they use for the next.
+// *parsed is set to their declarations, valid until the next call. Returns how many, 0 once nothing more is reached.
+int parseReachedBodies(BodyReach *reach, struct ThreadPool *pool, const Declaration ***parsed);
+void freeBodyReach(BodyReach *reach);
+
+// Adds found, of a task working on one file, to the diagnostics of results and frees it. The file is opened for its
+// lines the first time it's needed, in *lexer for the caller to free. Returns the number of errors.
+int mergeDiagnostics(ParseResults *results, Lexer **lexer, DiagnosticBuffer *found);
+
+// Renders the diagnostics of every file in file order, as JSON if the config asks for it, in one write to stdout.
+// Returns the number of errors.
+int printProgramDiagnostics(const Program *program, const CompilerConfig *config);
+
+// Where the time of parseProgram went, one line per phase.
+void printTimeReport(const Program *program);
+
+#endif //NIFTY_PROGRAM_H
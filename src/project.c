@@ -31,8 +31,15 @@
 #endif
 #include <time.h>
 
+#include "check.h"
+#include "intern.h"
+#include "lower.h"
 #include "parser.h"
+#include "pass.h"
+#include "program.h"
+#include "util/fs.h"
 #include "util/str.h"
+#include "util/thread.h"
 
 #ifdef N_WIN
 #   define MKDIR_CHECK() _mkdir(folder)
@@ -76,6 +83,15 @@ static bool loadBoolForKey(const toml_table_t *table, const char *key, bool defa
     return defaultValue;
 }
 
+static int loadIntForKey(const toml_table_t *table, const char *key, const int defaultValue) {
+    const toml_datum_t datum = toml_int_in(table, key);
+    if (datum.ok) {
+        return (int)datum.u.i;
+    }
+
+    return defaultValue;
+}
+
 static void projectError(const ProjectInfo *info) {
     setTextColor(&info->config, ERROR_COLOR);
     printf("Project error:");
@@ -92,6 +108,19 @@ ProjectInfo *loadProject() {
     
     info->config.verbosity = Debug; // TODO: Remove for release.
     info->config.disableColors = getenv("NIFTY_DISABLE_COLORS") != nullptr;
+    info->config.jsonDiagnostics = false;
+    info->config.timeReport = false;
+    info->config.emitIr = false;
+    info->config.remarks = false;
+    info->config.vectorizeReport = false;
+    info->config.streamingLexer = false;
+    info->config.lazyBodies = false;
+    info->config.threads = 0;
+    info->config.threadPool = nullptr;
+    info->config.interner = nullptr;
+    info->config.nslPath = nullptr;
+    info->config.cacheDir = nullptr;
+    info->buildDir = nullptr;
 
     FILE *fp = fopen(NIFTY_BUILD_FILE, "r");
     if (fp == nullptr) {
@@ -111,7 +140,18 @@ ProjectInfo *loadProject() {
     }
 
     info->name = loadStringForKey(conf, "project", nullptr);
+    // The build file is in the working directory, but the project's output shouldn't depend on it staying there.
+    char *projectDir = fs_real_path(".");
+    info->buildDir = fs_join(projectDir != nullptr ? projectDir : ".", NIFTY_BUILD_DIR);
+    str_delete(projectDir);
     info->config.disableColors = loadBoolForKey(conf, "disableColors", false);
+    info->config.streamingLexer = loadBoolForKey(conf, "streamingLexer", false);
+    info->config.lazyBodies = loadBoolForKey(conf, "lazyFunctionBodies", false);
+    info->config.threads = loadIntForKey(conf, "threads", 0);
+    info->config.nslPath = loadStringForKey(conf, "nslPath", getenv("NIFTY_NSL"));
+    if (loadBoolForKey(conf, "astCache", true)) {
+        info->config.cacheDir = fs_join(info->buildDir, NIFTY_AST_CACHE_DIR);
+    }
 
     info->targets = (TargetInfo**)malloc(sizeof(TargetInfo*));
     info->targets[0] = (TargetInfo*)malloc(sizeof(TargetInfo));
@@ -184,6 +224,9 @@ void freeProject(ProjectInfo *info) {
     }
     free(info->targets);
     str_delete(info->name);
+    str_delete(info->config.nslPath);
+    str_delete(info->config.cacheDir);
+    str_delete(info->buildDir);
     free(info);
 }
 
@@ -236,7 +279,7 @@ void build(const char *targetName, ProjectInfo *info) {
         return;
     }
     
-    if (info->config.verbosity >= Debug) {
+    if (info->config.verbosity >= Debug && !info->config.jsonDiagnostics) {
         printf("Building target ");
         setTextColor(&info->config, HIGHLIGHT_COLOR);
         printf("%s", target->targetName);
@@ -244,18 +287,61 @@ void build(const char *targetName, ProjectInfo *info) {
         println(".");
     }
 
-    ParseResults *results = parseFile(target->entryPoint, &info->config);
-    if (results->errorCount > 0) {
+    info->config.threadPool = pool_new(info->config.threads);
+    info->config.interner = initInterner();
+    Program *program = parseProgram(target->entryPoint, &info->config);
+    checkProgram(program, &info->config);
+
+    // Only programs without errors are lowered, their trees are typed throughout.
+    bool irVerified = true;
+    if (program != nullptr && program->errorCount == 0) {
+        IrModule *module = lowerProgram(program, &info->config);
+        // Nor optimized if lowering found values it couldn't type.
+        if (program->errorCount == 0) {
+            irVerified = runDefaultPasses(module);
+            if (info->config.emitIr && !info->config.jsonDiagnostics) {
+                printIrModule(module);
+            }
+            if ((info->config.remarks || info->config.vectorizeReport) && !info->config.jsonDiagnostics) {
+                printIrRemarks(module, info->config.remarks ? nullptr : "loops");
+            }
+        }
+        freeIrModule(module);
+    }
+    pool_free(info->config.threadPool);
+    info->config.threadPool = nullptr;
+
+    if (program == nullptr) {
         info->buildFailed = true;
+        freeInterner(info->config.interner);
+        info->config.interner = nullptr;
+        return;
+    }
 
-        if (results->errorCount > 1) {
-            println("\nBuild finished with %d errors.", results->errorCount);
-        } else {
-            println("\nBuild finished with an error.");
-        }
+    const int errorCount = printProgramDiagnostics(program, &info->config);
+
+    if (errorCount > 0 || !irVerified) {
+        info->buildFailed = true;
+    }
+
+    // With JSON diagnostics the array is all that goes to stdout.
+    if (errorCount > 1 && !info->config.jsonDiagnostics) {
+        println("\nBuild finished with %d errors.", errorCount);
+    } else if (errorCount == 1 && !info->config.jsonDiagnostics) {
+        println("\nBuild finished with an error.");
+    } else if (!irVerified && !info->config.jsonDiagnostics) {
+        println("\nBuild failed, the compiler made IR that doesn't verify.");
     }
 
-    freeParseResults(results);
+    // Kept off stdout in JSON mode, where the array is all that goes there.
+    if (info->config.timeReport && !info->config.jsonDiagnostics) {
+        println("");
+        printTimeReport(program);
+    }
+
+    freeProgram(program);
+    freeInterner(info->config.interner);
+    info->config.interner = nullptr;
 }
 
 void run(const char *targetName, ProjectInfo *info) {
@@ -284,6 +370,22 @@ void run(const char *targetName, ProjectInfo *info) {
     }
 }
 
+void clean(const char *targetName, const ProjectInfo *info) {
+    if (info == nullptr) {
+        println("No project found, nothing to clean.");
+        return;
+    }
+
+    // Targets share the build folder so far, cleaning any of them cleans them all.
+    if (getTargetInfo(targetName, info) == nullptr) {
+        return;
+    }
+
+    if (!fs_remove_dirs(info->buildDir)) {
+        println("Could not delete %s.", info->buildDir);
+    }
+}
+
 void newProject(const bool exists) {
     char *answer = str_new_empty(100);
 
@@ -393,7 +495,7 @@ void createProject(const CreateProjectInfo *info) {
     if (!createFolder("src")) {
         return;
     }
-    if (!createFolder("build-debug")) {
+    if (!createFolder(NIFTY_BUILD_DIR)) {
         return;
     }
 
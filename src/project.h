@@ -67,6 +67,7 @@ typedef struct {
     
     CompilerConfig config;
     bool buildFailed;
+    char *buildDir; // Where the project's targets are built to, in its directory. nifty clean deletes it.
 } ProjectInfo;
 
 ProjectInfo *loadProject();
@@ -76,6 +77,7 @@ TargetInfo *getTargetInfo(const char *targetName, const ProjectInfo *info);
 
 void build(const char *targetName, ProjectInfo *info);
 void run(const char *targetName, ProjectInfo *info);
+void clean(const char *targetName, const ProjectInfo *info);
 void newProject(bool exists);
 void createProject(const CreateProjectInfo *info);
 
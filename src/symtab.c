@@ -0,0 +1,293 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "symtab.h"
+
+#include <stdlib.h>
+
+#include "util/arena.h"
+#include "util/thread.h"
+
+#define SYMTAB_SHARD_BITS 6
+#define SYMTAB_SHARDS (1 << SYMTAB_SHARD_BITS)
+#define SYMTAB_MIN_SLOTS 64
+
+// head is published last, so a reader that sees it also sees the key.
+typedef struct {
+    Symbol namespace;
+    Symbol name;
+    void *volatile head; // const Declaration *, nullptr for an empty slot.
+} SymbolSlot;
+
+typedef struct SlotArray {
+    struct SlotArray *retired; // The smaller arrays this one replaced, freed with the table.
+    uint32_t mask;
+    SymbolSlot slots[];
+} SlotArray;
+
+typedef struct {
+    Mutex lock;
+    void *volatile slots; // SlotArray *, replaced whole when it grows.
+    uint32_t count;
+    Arena declarations;
+    int declared;
+    char padding[64]; // Keeps shards locked by different threads off the same cache line.
+} SymbolShard;
+
+struct SymbolTable {
+    SymbolShard shards[SYMTAB_SHARDS];
+};
+
+static inline uint64_t pairHash(const Symbol namespace, const Symbol name) {
+    uint64_t h = ((uint64_t)namespace << 32 | name) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    return h * 0xBF58476D1CE4E5B9ull;
+}
+
+static SlotArray *newSlots(const uint32_t size) {
+    SlotArray *array = (SlotArray *)calloc(1, sizeof(SlotArray) + sizeof(SymbolSlot) * size);
+    if (array == nullptr) {
+        println("Out of memory.");
+        exit(1);
+    }
+
+    array->mask = size - 1;
+    return array;
+}
+
+SymbolTable *initSymbolTable() {
+    SymbolTable *table = (SymbolTable *)calloc(1, sizeof(SymbolTable));
+    if (table == nullptr) {
+        println("Out of memory.");
+        return nullptr;
+    }
+
+    for (int i = 0; i < SYMTAB_SHARDS; ++i) {
+        SymbolShard *shard = &table->shards[i];
+        mutex_init(&shard->lock);
+        shard->slots = newSlots(SYMTAB_MIN_SLOTS);
+        arena_init(&shard->declarations, 0);
+    }
+
+    return table;
+}
+
+void freeSymbolTable(SymbolTable *table) {
+    if (table == nullptr) {
+        return;
+    }
+
+    for (int i = 0; i < SYMTAB_SHARDS; ++i) {
+        SymbolShard *shard = &table->shards[i];
+        SlotArray *array = (SlotArray *)shard->slots;
+        while (array != nullptr) {
+            SlotArray *retired = array->retired;
+            free(array);
+            array = retired;
+        }
+        arena_free(&shard->declarations);
+        mutex_destroy(&shard->lock);
+    }
+    free(table);
+}
+
+// Under the shard's lock. Readers keep using the old array until they load the new one, both stay valid.
+static void growShard(SymbolShard *shard) {
+    SlotArray *old = (SlotArray *)shard->slots;
+    const uint32_t size = (old->mask + 1) * 2;
+    SlotArray *array = newSlots(size);
+    array->retired = old;
+
+    for (uint32_t i = 0; i <= old->mask; ++i) {
+        const SymbolSlot *slot = &old->slots[i];
+        if (slot->head == nullptr) {
+            continue;
+        }
+
+        uint32_t at = (uint32_t)pairHash(slot->namespace, slot->name) & array->mask;
+        while (array->slots[at].head != nullptr) {
+            at = (at + 1) & array->mask;
+        }
+        array->slots[at] = *slot;
+    }
+
+    atomic_store_ptr(&shard->slots, array);
+}
+
+static SymbolShard *shardOf(SymbolTable *table, const uint64_t hash) {
+    return &table->shards[hash >> (64 - SYMTAB_SHARD_BITS)];
+}
+
+// Under the shard's lock. The slot of (namespace, name), an empty one if the pair isn't there yet.
+static SymbolSlot *findSlot(SymbolShard *shard, const uint64_t hash, const Symbol namespace, const Symbol name) {
+    SlotArray *array = (SlotArray *)shard->slots;
+    uint32_t at = (uint32_t)hash & array->mask;
+    for (; array->slots[at].head != nullptr; at = (at + 1) & array->mask) {
+        if (array->slots[at].namespace == namespace && array->slots[at].name == name) {
+            break;
+        }
+    }
+
+    return &array->slots[at];
+}
+
+// Under the shard's lock, with the rest of declaration already written.
+static void publish(SymbolShard *shard, SymbolSlot *slot, const Symbol namespace, const Symbol name,
+                    Declaration *declaration) {
+    const bool added = slot->head == nullptr;
+    if (added) {
+        slot->namespace = namespace;
+        slot->name = name;
+    }
+    atomic_store_ptr(&slot->head, declaration);
+
+    // Linear probing stays short up to three quarters full.
+    if (added && ++shard->count * 4 > (((SlotArray *)shard->slots)->mask + 1) * 3) {
+        growShard(shard);
+    }
+}
+
+const Declaration *declareSymbol(SymbolTable *table, const Symbol namespace, const Symbol name,
+                                 const DeclarationKind kind, ParseResults *file, const NodeIndex node) {
+    if (name == SYMBOL_NONE) {
+        return nullptr;
+    }
+
+    // A declaration is in two chains, by its pair and by its name alone. Both shards are locked, lower index first, so
+    // both links are written before either chain shows the declaration.
+    const uint64_t hash = pairHash(namespace, name);
+    const uint64_t anyHash = pairHash(NAMESPACE_ANY, name);
+    SymbolShard *shard = shardOf(table, hash);
+    SymbolShard *anyShard = shardOf(table, anyHash);
+    SymbolShard *first = shard < anyShard ? shard : anyShard;
+    SymbolShard *second = shard < anyShard ? anyShard : shard;
+    mutex_lock(&first->lock);
+    if (second != first) {
+        mutex_lock(&second->lock);
+    }
+
+    Declaration *declaration = (Declaration *)arena_alloc(&shard->declarations, sizeof(Declaration));
+    if (declaration != nullptr) {
+        SymbolSlot *slot = findSlot(shard, hash, namespace, name);
+        SymbolSlot *anySlot = findSlot(anyShard, anyHash, NAMESPACE_ANY, name);
+
+        declaration->namespace = namespace;
+        declaration->name = name;
+        declaration->kind = kind;
+        declaration->file = file;
+        declaration->node = node;
+        declaration->next = (const Declaration *)slot->head;
+        declaration->sameName = (const Declaration *)anySlot->head;
+
+        publish(shard, slot, namespace, name, declaration);
+        // Growing the first shard may have moved the other slot if both pairs are in the same shard.
+        publish(anyShard, findSlot(anyShard, anyHash, NAMESPACE_ANY, name), NAMESPACE_ANY, name, declaration);
+        ++shard->declared;
+    }
+
+    if (second != first) {
+        mutex_unlock(&second->lock);
+    }
+    mutex_unlock(&first->lock);
+
+    if (declaration == nullptr) {
+        println("Out of memory.");
+    }
+    return declaration;
+}
+
+int declareFile(SymbolTable *table, ParseResults *file) {
+    const Ast *ast = &file->ast;
+    const Symbol namespace = file->namespace;
+
+    int count = 0;
+    int declCount;
+    const uint32_t *decls = astList(ast, ast->decls, &declCount);
+    for (int i = 0; i < declCount; ++i) {
+        const NodeIndex node = decls[i];
+        const NodeData data = ast->data[node];
+        switch (astKind(ast, node)) {
+            case FunctionNodeType:
+                count += declareSymbol(table, namespace, astSymbol(ast, ast->data[data.a].a), DECL_FUNCTION, file,
+                                       node) != nullptr;
+                break;
+            case OverloadsNodeType:
+                count += declareSymbol(table, namespace, astSymbol(ast, data.a), DECL_OVERLOADS, file, node) != nullptr;
+                break;
+            case StructNodeType:
+                count += declareSymbol(table, namespace, astSymbol(ast, data.a), DECL_STRUCT, file, node) != nullptr;
+                break;
+            case VarNodeType: {
+                int nameCount;
+                const uint32_t *names = astList(ast, ast->extra[data.a + 3], &nameCount);
+                for (int j = 0; j < nameCount; ++j) {
+                    count += declareSymbol(table, namespace, astSymbol(ast, names[j]), DECL_VARIABLE, file,
+                                           node) != nullptr;
+                }
+                break;
+            }
+            case ImplNodeType: {
+                const Symbol type = astSymbol(ast, data.a);
+                int methodCount;
+                const uint32_t *methods = astList(ast, data.b, &methodCount);
+                for (int j = 0; j < methodCount; ++j) {
+                    if (astKind(ast, methods[j]) != FunctionNodeType) {
+                        continue;
+                    }
+                    const NodeIndex prototype = ast->data[methods[j]].a;
+                    count += declareSymbol(table, type, astSymbol(ast, ast->data[prototype].a), DECL_METHOD, file,
+                                           methods[j]) != nullptr;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    return count;
+}
+
+const Declaration *lookupSymbol(const SymbolTable *table, const Symbol namespace, const Symbol name) {
+    const uint64_t hash = pairHash(namespace, name);
+    const SymbolShard *shard = &table->shards[hash >> (64 - SYMTAB_SHARD_BITS)];
+    const SlotArray *array = (const SlotArray *)atomic_load_ptr((void *volatile *)&shard->slots);
+
+    for (uint32_t at = (uint32_t)hash & array->mask;; at = (at + 1) & array->mask) {
+        const SymbolSlot *slot = &array->slots[at];
+        const Declaration *head = (const Declaration *)atomic_load_ptr((void *volatile *)&slot->head);
+        if (head == nullptr) {
+            return nullptr;
+        }
+        if (slot->namespace == namespace && slot->name == name) {
+            return head;
+        }
+    }
+}
+
+int symbolTableCount(const SymbolTable *table) {
+    int count = 0;
+    for (int i = 0; i < SYMTAB_SHARDS; ++i) {
+        count += table->shards[i].declared;
+    }
+    return count;
+}
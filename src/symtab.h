@@ -0,0 +1,77 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_SYMTAB_H
+#define NIFTY_SYMTAB_H
+
+#include "ast.h"
+#include "intern.h"
+#include "parser.h"
+
+// Every top level declaration of a program, by its (namespace, name) pair. Methods are declared in their type, so
+// Point::new is the pair (Point, new), and files without a namespace declaration are in SYMBOL_NONE.
+//
+// Pairs are spread over shards by their hash. Declaring takes the lock of one shard, looking up takes none: a slot's
+// key is written before its declaration is published and tables replaced by growing are kept until the table is freed,
+// so a reader always sees a whole declaration or none. Any number of threads can declare and look up at once.
+
+// Namespace of the index of every declaration by name alone, for names nothing else resolves, like x.len().
+#define NAMESPACE_ANY ((Symbol)UINT32_MAX)
+
+typedef enum {
+    DECL_FUNCTION,
+    DECL_METHOD,
+    DECL_OVERLOADS,
+    DECL_STRUCT,
+    DECL_VARIABLE,
+} DeclarationKind;
+
+typedef struct Declaration {
+    Symbol namespace; // The type of methods.
+    Symbol name;
+    DeclarationKind kind;
+    ParseResults *file;
+    NodeIndex node; // FunctionNodeType, OverloadsNodeType, StructNodeType or VarNodeType.
+
+    const struct Declaration *next; // Declared earlier with the same namespace and name.
+    const struct Declaration *sameName; // Declared earlier with the same name, in any namespace.
+} Declaration;
+
+typedef struct SymbolTable SymbolTable;
+
+SymbolTable *initSymbolTable();
+void freeSymbolTable(SymbolTable *table);
+
+// Declarations of one name can come from several files, and from several threads in any order.
+const Declaration *declareSymbol(SymbolTable *table, Symbol namespace, Symbol name, DeclarationKind kind,
+                                 ParseResults *file, NodeIndex node);
+// Adds the top level declarations of file, and the methods of its impls. Returns how many there were.
+int declareFile(SymbolTable *table, ParseResults *file);
+
+// Latest declaration of name in namespace, follow next for the rest. nullptr if there is none. With NAMESPACE_ANY,
+// the latest in any namespace, follow sameName for the rest.
+const Declaration *lookupSymbol(const SymbolTable *table, Symbol namespace, Symbol name);
+
+// Number of declarations, only exact once no thread is declaring anymore.
+int symbolTableCount(const SymbolTable *table);
+
+#endif //NIFTY_SYMTAB_H
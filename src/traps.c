@@ -0,0 +1,174 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "pass.h"
+
+#include <stdlib.h>
+
+// The checks left after the bounds and overflow passes become a branch to a trap block when they fail. A function has
+// one trap block for each IrTrap its checks can fail with, cold and kept last, so a check costs its compare and a
+// branch predicted not taken in the code that runs. The trap block reports the check that failed from phis of its
+// source offset and the values it failed on.
+//
+// An overflow check becomes IR_OVERFLOWED of its arithmetic, the flag __builtin_add_overflow and the others give with
+// the result, so a backend can fold both into one instruction and a jump on the carry or overflow flag. A divisor check
+// becomes a compare with 0 ahead of the division.
+
+// A check that branches to a trap block when it fails.
+typedef struct {
+    IrBlock block;
+    IrTrap trap;
+    IrValue offset; // u32
+    IrValue index; // u64, TRAP_BOUNDS only.
+    IrValue length; // u64, TRAP_BOUNDS only.
+} Failure;
+
+static IrTrap trapOf(const IrOp op) {
+    return op == IR_CHECK_OVERFLOW ? TRAP_OVERFLOW : op == IR_CHECK_DIVISOR ? TRAP_DIVIDE_BY_ZERO : TRAP_BOUNDS;
+}
+
+static bool isCheck(const IrOp op) {
+    return op == IR_CHECK_BOUNDS || op == IR_CHECK_RANGE || op == IR_CHECK_OVERFLOW || op == IR_CHECK_DIVISOR;
+}
+
+// Replaces the check at index of block with a branch to its trap block when it fails, the rest of block continuing
+// in a new block. The edge to the trap block is left to add once it exists.
+static Failure lowerCheck(IrFunction *function, const IrBlock block, const int index, const IrBlock *traps) {
+    const IrValue check = function->blocks[block].insts[index];
+    const IrInst site = *irInst(function, check);
+    const IrBlock rest = splitIrBlock(function, block, index + 1);
+    removeIrInst(function, check, IR_NONE);
+
+    const TypeId u64 = primitiveType(TYPE_U64);
+    const TypeId b32 = primitiveType(TYPE_B32);
+    Failure failure = {block, trapOf((IrOp)site.op), IR_NONE, IR_NONE, IR_NONE};
+    IrValue ok = IR_NONE;
+    IrValue failed = IR_NONE;
+    if (site.op == IR_CHECK_BOUNDS) {
+        failure.index = addIrInst(function, block, IR_CONVERT, u64, site.a, 0, site.offset);
+        failure.length = addIrInst(function, block, IR_CONVERT, u64, site.b, 0, site.offset);
+        ok = addIrInst(function, block, IR_LT, b32, failure.index, failure.length, site.offset);
+    } else if (site.op == IR_CHECK_RANGE) {
+        const IrValue empty = addIrInst(function, block, IR_GE, b32, function->extra[site.b], site.a, site.offset);
+        failure.index = addIrInst(function, block, IR_CONVERT, u64, site.a, 0, site.offset);
+        failure.length = addIrInst(function, block, IR_CONVERT, u64, function->extra[site.b + 1], 0, site.offset);
+        const IrValue fits = addIrInst(function, block, IR_LE, b32, failure.index, failure.length, site.offset);
+        ok = addIrInst(function, block, IR_OR, b32, empty, fits, site.offset);
+    } else if (site.op == IR_CHECK_DIVISOR) {
+        const IrValue zero = addIrInst(function, block, IR_ZERO, irInst(function, site.a)->type, 0, 0, site.offset);
+        ok = addIrInst(function, block, IR_NE, b32, site.a, zero, site.offset);
+    } else {
+        failed = addIrInst(function, block, IR_OVERFLOWED, b32, site.a, 0, site.offset);
+    }
+    failure.offset = addIrInt(function, block, primitiveType(TYPE_U32), site.offset, site.offset);
+
+    const IrBlock trap = traps[failure.trap];
+    const uint32_t targets[2] = {ok != IR_NONE ? rest : trap, ok != IR_NONE ? trap : rest};
+    addIrInst(function, block, IR_BRANCH, TYPE_ID_NONE, ok != IR_NONE ? ok : failed, addIrExtra(function, targets, 2),
+              site.offset);
+    addIrEdge(function, block, rest);
+    return failure;
+}
+
+// The trap block of kind, with phis of what each of its failures reports.
+static void addTrap(IrFunction *function, const IrTrap kind, const IrBlock trap, const Failure *failures,
+                    const int count) {
+    IrValue *offsets = (IrValue *)malloc(sizeof(IrValue) * count * 3);
+    IrValue *indices = offsets + count;
+    IrValue *lengths = indices + count;
+    int preds = 0;
+    for (int i = 0; i < count; ++i) {
+        if (failures[i].trap == kind) {
+            addIrEdge(function, failures[i].block, trap);
+            offsets[preds] = failures[i].offset;
+            indices[preds] = failures[i].index;
+            lengths[preds++] = failures[i].length;
+        }
+    }
+
+    const TypeId u64 = primitiveType(TYPE_U64);
+    const uint32_t offset = irInst(function, offsets[0])->offset;
+    IrValue values[3];
+    int valueCount = 0;
+    values[valueCount++] =
+        addIrInst(function, trap, IR_PHI, primitiveType(TYPE_U32), addIrList(function, offsets, preds), 0, offset);
+    if (kind == TRAP_BOUNDS) {
+        values[valueCount++] = addIrInst(function, trap, IR_PHI, u64, addIrList(function, indices, preds), 0, offset);
+        values[valueCount++] = addIrInst(function, trap, IR_PHI, u64, addIrList(function, lengths, preds), 0, offset);
+    }
+    addIrInst(function, trap, IR_TRAP, TYPE_ID_NONE, kind, addIrList(function, values, valueCount), offset);
+    addIrInst(function, trap, IR_UNREACHABLE, TYPE_ID_NONE, 0, 0, offset);
+    free(offsets);
+}
+
+int lowerChecks(const IrModule *module, IrFunction *function, StrBuffer *errors) {
+    (void)module;
+    (void)errors;
+
+    int count = 0;
+    int kinds[TRAP_COUNT] = {0};
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            const IrOp op = (IrOp)irInst(function, block->insts[i])->op;
+            if (isCheck(op)) {
+                ++kinds[trapOf(op)];
+                ++count;
+            }
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // Each check splits its block in two, and the trap blocks come after all of them.
+    IrBlock traps[TRAP_COUNT];
+    IrBlock next = (IrBlock)(function->blockCount + count);
+    for (int k = 0; k < TRAP_COUNT; ++k) {
+        traps[k] = kinds[k] > 0 ? next++ : IR_NO_BLOCK;
+    }
+
+    Failure *failures = (Failure *)malloc(sizeof(Failure) * count);
+    int lowered = 0;
+    for (int b = 0; b < function->blockCount; ++b) {
+        const IrBlockData *block = &function->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; ++i) {
+            if (isCheck((IrOp)irInst(function, block->insts[i])->op)) {
+                // What follows the check is in a block of its own now, looked at in turn.
+                failures[lowered++] = lowerCheck(function, (IrBlock)b, i, traps);
+                break;
+            }
+        }
+    }
+
+    for (int k = 0; k < TRAP_COUNT; ++k) {
+        if (traps[k] != IR_NO_BLOCK) {
+            addIrBlock(function, BLOCK_COLD);
+            addTrap(function, (IrTrap)k, traps[k], failures, count);
+        }
+    }
+    compactIrFunction(function);
+    removeTrivialPhis(function);
+
+    free(failures);
+    return count;
+}
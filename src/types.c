@@ -0,0 +1,730 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "types.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/arena.h"
+#include "util/hash.h"
+#include "util/thread.h"
+
+// Laid out like the interner: types are spread over shards by the top bits of their hash, each with its own lock and
+// table, and numbered into segments of 1024, 2048, 4096... entries, so an entry never moves once it is written.
+#define TYPES_SHARD_BITS 4
+#define TYPES_SHARDS (1 << TYPES_SHARD_BITS)
+#define TYPES_MIN_SLOTS 256
+
+#define TYPES_FIRST_SEGMENT_BITS 10
+#define TYPES_SEGMENTS (32 - TYPES_FIRST_SEGMENT_BITS)
+
+#define POINTER_SIZE 8
+
+typedef enum {
+    LAYOUT_UNKNOWN,
+    LAYOUT_KNOWN,
+} LayoutState;
+
+typedef struct {
+    Type type;
+    TypeLayout layout;
+    volatile int layoutState; // LAYOUT_KNOWN once layout is written, it never changes after.
+} TypeEntry;
+
+typedef struct {
+    uint32_t hash;
+    TypeId type; // TYPE_ID_NONE for an empty slot.
+} TypeSlot;
+
+typedef struct {
+    Mutex lock;
+    TypeSlot *slots;
+    uint32_t mask;
+    uint32_t count;
+    Arena items; // Members and arguments of the types in the shard.
+    char padding[64];
+} TypeShard;
+
+struct TypeTable {
+    TypeShard shards[TYPES_SHARDS];
+
+    Mutex lock; // Held while numbering a new type.
+    TypeEntry *segments[TYPES_SEGMENTS];
+    uint32_t count;
+
+    Mutex layoutLock; // Held while writing a layout.
+
+    // Builtin aliases, by name.
+    Symbol intName, uintName, floatName, doubleName, boolName, cstringName, rawptrName;
+    Symbol primitiveNames[TYPE_NONE]; // Of the builtins, for type keywords passed as arguments like cast(x, u64).
+};
+
+static const char *primitiveNames[] = {
+    "u8", "u16", "u32", "u64", "u128", "s8", "s16", "s32", "s64", "s128", "f16", "f32", "f64", "f128",
+    "b8", "b16", "b32", "b64", "string", "char", "uintptr", "typeid", "__anytype", "void",
+};
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+
+static inline int highestBit(const uint32_t v) {
+    unsigned long idx;
+    _BitScanReverse(&idx, v);
+    return (int)idx;
+}
+#else
+#   define highestBit(v) (31 - __builtin_clz(v))
+#endif
+
+static TypeEntry *entryOf(const TypeTable *table, const TypeId type) {
+    const uint32_t v = type - 1 + (1u << TYPES_FIRST_SEGMENT_BITS);
+    const int segment = highestBit(v) - TYPES_FIRST_SEGMENT_BITS;
+
+    return &table->segments[segment][v - (1u << (segment + TYPES_FIRST_SEGMENT_BITS))];
+}
+
+static uint32_t hashType(const Type *type) {
+    const uint32_t head[4] = {(uint32_t)type->form, type->a, type->b, type->count};
+    uint64_t h = hash_bytes((const char *)head, sizeof(head));
+    if (type->count > 0) {
+        h ^= hash_bytes((const char *)type->items, sizeof(TypeId) * type->count) * 0x9E3779B97F4A7C15ull;
+    }
+
+    return (uint32_t)(h ^ h >> 32);
+}
+
+static bool sameType(const Type *x, const Type *y) {
+    return x->form == y->form && x->a == y->a && x->b == y->b && x->count == y->count &&
+           (x->count == 0 || memcmp(x->items, y->items, sizeof(TypeId) * x->count) == 0);
+}
+
+static TypeId addType(TypeTable *table, const Type *type) {
+    mutex_lock(&table->lock);
+    if (table->count >= UINT32_MAX - (1u << TYPES_FIRST_SEGMENT_BITS)) {
+        mutex_unlock(&table->lock);
+        println("Too many distinct types.");
+        return TYPE_ID_NONE;
+    }
+
+    const TypeId id = ++table->count;
+    const uint32_t v = id - 1 + (1u << TYPES_FIRST_SEGMENT_BITS);
+    const int segment = highestBit(v) - TYPES_FIRST_SEGMENT_BITS;
+    if (table->segments[segment] == nullptr) {
+        table->segments[segment] = (TypeEntry *)malloc(sizeof(TypeEntry) << (segment + TYPES_FIRST_SEGMENT_BITS));
+    }
+
+    TypeEntry *entry = &table->segments[segment][v - (1u << (segment + TYPES_FIRST_SEGMENT_BITS))];
+    entry->type = *type;
+    entry->layout = (TypeLayout){0, 0};
+    entry->layoutState = LAYOUT_UNKNOWN;
+    mutex_unlock(&table->lock);
+
+    return id;
+}
+
+static void growShard(TypeShard *shard) {
+    const uint32_t size = (shard->mask + 1) * 2;
+    TypeSlot *slots = (TypeSlot *)calloc(size, sizeof(TypeSlot));
+
+    for (uint32_t i = 0; i <= shard->mask; ++i) {
+        const TypeSlot slot = shard->slots[i];
+        if (slot.type == TYPE_ID_NONE) {
+            continue;
+        }
+
+        uint32_t at = slot.hash & (size - 1);
+        while (slots[at].type != TYPE_ID_NONE) {
+            at = (at + 1) & (size - 1);
+        }
+        slots[at] = slot;
+    }
+
+    free(shard->slots);
+    shard->slots = slots;
+    shard->mask = size - 1;
+}
+
+// The id of type, made if it is new. type's items are copied into the table.
+static TypeId internType(TypeTable *table, Type type) {
+    const uint32_t h = hashType(&type);
+    TypeShard *shard = &table->shards[h >> (32 - TYPES_SHARD_BITS)];
+
+    mutex_lock(&shard->lock);
+    uint32_t at = h & shard->mask;
+    for (; shard->slots[at].type != TYPE_ID_NONE; at = (at + 1) & shard->mask) {
+        if (shard->slots[at].hash == h && sameType(&entryOf(table, shard->slots[at].type)->type, &type)) {
+            const TypeId id = shard->slots[at].type;
+            mutex_unlock(&shard->lock);
+            return id;
+        }
+    }
+
+    if (type.count > 0) {
+        TypeId *items = (TypeId *)arena_alloc(&shard->items, sizeof(TypeId) * type.count);
+        memcpy(items, type.items, sizeof(TypeId) * type.count);
+        type.items = items;
+    } else {
+        type.items = nullptr;
+    }
+
+    const TypeId id = addType(table, &type);
+    if (id != TYPE_ID_NONE) {
+        shard->slots[at].hash = h;
+        shard->slots[at].type = id;
+        if (++shard->count * 4 > (shard->mask + 1) * 3) {
+            growShard(shard);
+        }
+    }
+    mutex_unlock(&shard->lock);
+
+    return id;
+}
+
+static TypeId elementType(TypeTable *table, const TypeForm form, const TypeId element, const uint32_t b) {
+    if (element == TYPE_ID_NONE) {
+        return TYPE_ID_NONE;
+    }
+
+    const Type type = {form, element, b, 0, nullptr};
+    return internType(table, type);
+}
+
+TypeTable *initTypeTable(Interner *interner) {
+    TypeTable *table = (TypeTable *)calloc(1, sizeof(TypeTable));
+    if (table == nullptr) {
+        println("Out of memory.");
+        return nullptr;
+    }
+
+    for (int i = 0; i < TYPES_SHARDS; ++i) {
+        TypeShard *shard = &table->shards[i];
+        mutex_init(&shard->lock);
+        shard->slots = (TypeSlot *)calloc(TYPES_MIN_SLOTS, sizeof(TypeSlot));
+        shard->mask = TYPES_MIN_SLOTS - 1;
+        shard->count = 0;
+        arena_init(&shard->items, 0);
+    }
+    mutex_init(&table->lock);
+    mutex_init(&table->layoutLock);
+
+    // In order, so every builtin's id is primitiveType of its kind.
+    for (int kind = 0; kind < TYPE_NONE; ++kind) {
+        const Type type = {FORM_PRIMITIVE, (uint32_t)kind, 0, 0, nullptr};
+        internType(table, type);
+    }
+
+    table->intName = intern(interner, "int", 3);
+    table->uintName = intern(interner, "uint", 4);
+    table->floatName = intern(interner, "float", 5);
+    table->doubleName = intern(interner, "double", 6);
+    table->boolName = intern(interner, "bool", 4);
+    table->cstringName = intern(interner, "cstring", 7);
+    table->rawptrName = intern(interner, "rawptr", 6);
+    for (int kind = 0; kind < TYPE_NONE; ++kind) {
+        table->primitiveNames[kind] = intern(interner, primitiveNames[kind], str_len(primitiveNames[kind]));
+    }
+
+    return table;
+}
+
+void freeTypeTable(TypeTable *table) {
+    if (table == nullptr) {
+        return;
+    }
+
+    for (int i = 0; i < TYPES_SHARDS; ++i) {
+        TypeShard *shard = &table->shards[i];
+        mutex_destroy(&shard->lock);
+        free(shard->slots);
+        arena_free(&shard->items);
+    }
+
+    for (int i = 0; i < TYPES_SEGMENTS; ++i) {
+        free(table->segments[i]);
+    }
+    mutex_destroy(&table->lock);
+    mutex_destroy(&table->layoutLock);
+    free(table);
+}
+
+TypeId namedType(TypeTable *table, const Symbol namespace, const Symbol name) {
+    const Type type = {FORM_NAMED, name, namespace, 0, nullptr};
+    return internType(table, type);
+}
+
+TypeId pointerType(TypeTable *table, const TypeId element) {
+    return elementType(table, FORM_POINTER, element, 0);
+}
+
+TypeId manyPointerType(TypeTable *table, const TypeId element) {
+    return elementType(table, FORM_MANY_POINTER, element, 0);
+}
+
+TypeId sliceType(TypeTable *table, const TypeId element) {
+    return elementType(table, FORM_SLICE, element, 0);
+}
+
+TypeId arrayType(TypeTable *table, const TypeId element, const uint32_t length) {
+    return elementType(table, FORM_ARRAY, element, length);
+}
+
+TypeId variadicType(TypeTable *table, const TypeId element) {
+    return elementType(table, FORM_VARIADIC, element, 0);
+}
+
+TypeId optionalType(TypeTable *table, const TypeId element) {
+    return elementType(table, FORM_OPTIONAL, element, 0);
+}
+
+static int compareIds(const void *x, const void *y) {
+    const TypeId a = *(const TypeId *)x;
+    const TypeId b = *(const TypeId *)y;
+    return a < b ? -1 : a > b;
+}
+
+TypeId unionType(TypeTable *table, const TypeId *members, const int count) {
+    int total = 0;
+    for (int i = 0; i < count; ++i) {
+        if (members[i] == TYPE_ID_NONE) {
+            return TYPE_ID_NONE;
+        }
+        const Type *member = &entryOf(table, members[i])->type;
+        total += member->form == FORM_UNION ? (int)member->count : 1;
+    }
+
+    TypeId small[16];
+    TypeId *flat = total <= 16 ? small : (TypeId *)malloc(sizeof(TypeId) * total);
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        const Type *member = &entryOf(table, members[i])->type;
+        if (member->form == FORM_UNION) {
+            memcpy(flat + n, member->items, sizeof(TypeId) * member->count);
+            n += (int)member->count;
+        } else {
+            flat[n++] = members[i];
+        }
+    }
+
+    qsort(flat, n, sizeof(TypeId), compareIds);
+    int unique = 0;
+    for (int i = 0; i < n; ++i) {
+        if (unique == 0 || flat[unique - 1] != flat[i]) {
+            flat[unique++] = flat[i];
+        }
+    }
+
+    TypeId id = unique == 1 ? flat[0] : TYPE_ID_NONE;
+    if (unique > 1) {
+        const Type type = {FORM_UNION, 0, 0, (uint32_t)unique, flat};
+        id = internType(table, type);
+    }
+    if (flat != small) {
+        free(flat);
+    }
+
+    return id;
+}
+
+TypeId genericType(TypeTable *table, const TypeId base, const TypeId *args, const int count) {
+    if (base == TYPE_ID_NONE) {
+        return TYPE_ID_NONE;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (args[i] == TYPE_ID_NONE) {
+            return TYPE_ID_NONE;
+        }
+    }
+
+    const Type type = {FORM_GENERIC, base, 0, (uint32_t)count, args};
+    return internType(table, type);
+}
+
+TypeId functionType(TypeTable *table, const TypeId *args, const int argCount, const TypeId *returns,
+                    const int returnCount) {
+    const int count = argCount + returnCount;
+    TypeId small[16];
+    TypeId *items = count <= 16 ? small : (TypeId *)malloc(sizeof(TypeId) * count);
+    if (argCount > 0) {
+        memcpy(items, args, sizeof(TypeId) * argCount);
+    }
+    if (returnCount > 0) {
+        memcpy(items + argCount, returns, sizeof(TypeId) * returnCount);
+    }
+
+    TypeId id = TYPE_ID_NONE;
+    bool complete = true;
+    for (int i = 0; i < count; ++i) {
+        complete = complete && items[i] != TYPE_ID_NONE;
+    }
+    if (complete) {
+        const Type type = {FORM_FUNCTION, (uint32_t)argCount, 0, (uint32_t)count, items};
+        id = internType(table, type);
+    }
+    if (items != small) {
+        free(items);
+    }
+
+    return id;
+}
+
+// A named type, or the builtin it is another name for.
+static TypeId resolveName(TypeTable *table, const SymbolTable *symbols, const ParseResults *file, const Symbol name) {
+    if (name == table->intName) {
+        return primitiveType(TYPE_S32);
+    } else if (name == table->uintName) {
+        return primitiveType(TYPE_U32);
+    } else if (name == table->floatName) {
+        return primitiveType(TYPE_F32);
+    } else if (name == table->doubleName) {
+        return primitiveType(TYPE_F64);
+    } else if (name == table->boolName) {
+        return primitiveType(TYPE_B32);
+    } else if (name == table->cstringName) {
+        return manyPointerType(table, primitiveType(TYPE_U8));
+    } else if (name == table->rawptrName) {
+        return pointerType(table, primitiveType(TYPE_VOID));
+    }
+
+    if (symbols != nullptr) {
+        for (const Declaration *decl = lookupSymbol(symbols, file->namespace, name); decl != nullptr; decl = decl->next) {
+            if (decl->kind == DECL_STRUCT) {
+                return namedType(table, decl->namespace, name);
+            }
+        }
+        for (const Declaration *decl = lookupSymbol(symbols, NAMESPACE_ANY, name); decl != nullptr;
+             decl = decl->sameName) {
+            if (decl->kind == DECL_STRUCT) {
+                return namedType(table, decl->namespace, name);
+            }
+        }
+    }
+
+    return namedType(table, file->namespace, name);
+}
+
+// The types of a list of type nodes into ids, which holds room for all of them.
+static bool typesFromList(TypeTable *table, const SymbolTable *symbols, const ParseResults *file, const uint32_t list,
+                          TypeId *ids) {
+    const Ast *ast = &file->ast;
+    for (uint32_t i = 0; i < ast->extra[list]; ++i) {
+        ids[i] = typeFromNode(table, symbols, file, ast->extra[list + 1 + i]);
+        if (ids[i] == TYPE_ID_NONE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TypeId typeFromNode(TypeTable *table, const SymbolTable *symbols, const ParseResults *file, const NodeIndex node) {
+    const Ast *ast = &file->ast;
+    const NodeData data = ast->data[node];
+
+    switch ((NodeKind)ast->kinds[node]) {
+        case NamedTypeNodeType:
+            return data.b != TYPE_NONE ? primitiveType((TypeKind)data.b)
+                                       : resolveName(table, symbols, file, astSymbol(ast, data.a));
+        case IdentNodeType: {
+            const Symbol name = astSymbol(ast, data.a);
+            for (int kind = 0; kind < TYPE_NONE; ++kind) {
+                if (table->primitiveNames[kind] == name) {
+                    return primitiveType((TypeKind)kind);
+                }
+            }
+            return resolveName(table, symbols, file, name);
+        }
+        case PointerTypeNodeType: {
+            const TypeId element = typeFromNode(table, symbols, file, data.a);
+            return data.b ? manyPointerType(table, element) : pointerType(table, element);
+        }
+        case SliceTypeNodeType:
+            return sliceType(table, typeFromNode(table, symbols, file, data.a));
+        case ArrayTypeNodeType: {
+            const bool literal = ast->kinds[data.b] == IntNodeType && ast->data[data.b].b == INT_SMALL;
+            return arrayType(table, typeFromNode(table, symbols, file, data.a),
+                             literal ? ast->data[data.b].a : ARRAY_LENGTH_UNKNOWN);
+        }
+        case VariadicTypeNodeType:
+            return variadicType(table, typeFromNode(table, symbols, file, data.a));
+        case OptionalTypeNodeType:
+            return optionalType(table, typeFromNode(table, symbols, file, data.a));
+        case UnionTypeNodeType:
+        case GenericTypeNodeType:
+        case FunctionTypeNodeType: {
+            const uint32_t list = ast->kinds[node] == UnionTypeNodeType ? data.a : data.b;
+            const uint32_t argCount = ast->kinds[node] == FunctionTypeNodeType ? ast->extra[data.a] : 0;
+            const uint32_t count = argCount + ast->extra[list];
+            TypeId small[16];
+            TypeId *ids = count <= 16 ? small : (TypeId *)malloc(sizeof(TypeId) * count);
+
+            TypeId id = TYPE_ID_NONE;
+            if ((argCount == 0 || typesFromList(table, symbols, file, data.a, ids)) &&
+                typesFromList(table, symbols, file, list, ids + argCount)) {
+                if (ast->kinds[node] == UnionTypeNodeType) {
+                    id = unionType(table, ids, (int)count);
+                } else if (ast->kinds[node] == GenericTypeNodeType) {
+                    id = genericType(table, typeFromNode(table, symbols, file, data.a), ids, (int)count);
+                } else {
+                    id = functionType(table, ids, (int)argCount, ids + argCount, (int)(count - argCount));
+                }
+            }
+            if (ids != small) {
+                free(ids);
+            }
+            return id;
+        }
+        default:
+            return TYPE_ID_NONE;
+    }
+}
+
+TypeId substituteType(TypeTable *table, const TypeId type, const TypeId *from, const TypeId *to, const int count) {
+    for (int i = 0; i < count; ++i) {
+        if (type == from[i]) {
+            return to[i];
+        }
+    }
+    if (type == TYPE_ID_NONE) {
+        return TYPE_ID_NONE;
+    }
+
+    const Type *t = &entryOf(table, type)->type;
+    switch (t->form) {
+        case FORM_PRIMITIVE:
+        case FORM_NAMED:
+            return type;
+        case FORM_POINTER:
+        case FORM_MANY_POINTER:
+        case FORM_SLICE:
+        case FORM_ARRAY:
+        case FORM_VARIADIC:
+        case FORM_OPTIONAL: {
+            const TypeId element = substituteType(table, t->a, from, to, count);
+            return element == t->a ? type : elementType(table, t->form, element, t->b);
+        }
+        default: {
+            TypeId small[16];
+            TypeId *items = t->count <= 16 ? small : (TypeId *)malloc(sizeof(TypeId) * t->count);
+            bool changed = false;
+            for (uint32_t i = 0; i < t->count; ++i) {
+                items[i] = substituteType(table, t->items[i], from, to, count);
+                changed = changed || items[i] != t->items[i];
+            }
+
+            TypeId id = type;
+            if (changed && t->form == FORM_UNION) {
+                id = unionType(table, items, (int)t->count);
+            } else if (changed && t->form == FORM_GENERIC) {
+                id = genericType(table, t->a, items, (int)t->count);
+            } else if (changed) {
+                id = functionType(table, items, (int)t->a, items + t->a, (int)(t->count - t->a));
+            }
+            if (items != small) {
+                free(items);
+            }
+            return id;
+        }
+    }
+}
+
+const Type *typeOf(const TypeTable *table, const TypeId type) {
+    return &entryOf(table, type)->type;
+}
+
+static TypeLayout primitiveLayout(const TypeKind kind) {
+    switch (kind) {
+        case TYPE_U8: case TYPE_S8: case TYPE_B8: return (TypeLayout){1, 1};
+        case TYPE_U16: case TYPE_S16: case TYPE_F16: case TYPE_B16: return (TypeLayout){2, 2};
+        case TYPE_U32: case TYPE_S32: case TYPE_F32: case TYPE_B32: case TYPE_CHAR: return (TypeLayout){4, 4};
+        case TYPE_U64: case TYPE_S64: case TYPE_F64: case TYPE_B64: case TYPE_UINTPTR: case TYPE_TYPE_ID:
+            return (TypeLayout){8, 8};
+        case TYPE_U28: case TYPE_S28: case TYPE_F128: return (TypeLayout){16, 16};
+        case TYPE_STRING: return (TypeLayout){2 * POINTER_SIZE, POINTER_SIZE}; // Pointer and length.
+        case TYPE_ANY: return (TypeLayout){8 + POINTER_SIZE, 8};                 // typeid and pointer.
+        default: return (TypeLayout){0, 1};                                      // void
+    }
+}
+
+static int64_t alignUp(const int64_t size, const int align) {
+    return (size + align - 1) / align * align;
+}
+
+static bool computeLayout(TypeTable *table, const Type *type, TypeLayout *layout) {
+    TypeLayout element;
+    switch (type->form) {
+        case FORM_PRIMITIVE:
+            *layout = primitiveLayout((TypeKind)type->a);
+            return true;
+        case FORM_POINTER:
+        case FORM_MANY_POINTER:
+        case FORM_FUNCTION:
+            *layout = (TypeLayout){POINTER_SIZE, POINTER_SIZE};
+            return true;
+        case FORM_SLICE:
+        case FORM_VARIADIC:
+            *layout = (TypeLayout){2 * POINTER_SIZE, POINTER_SIZE};
+            return true;
+        case FORM_ARRAY:
+            if (type->b == ARRAY_LENGTH_UNKNOWN || !typeLayout(table, type->a, &element)) {
+                return false;
+            }
+            *layout = (TypeLayout){element.size * type->b, element.align};
+            return true;
+        case FORM_OPTIONAL: {
+            // Pointers use null for a missing value, everything else gets a flag after it.
+            const TypeForm form = entryOf(table, type->a)->type.form;
+            if (!typeLayout(table, type->a, &element)) {
+                return false;
+            }
+            *layout = form == FORM_POINTER || form == FORM_MANY_POINTER || form == FORM_FUNCTION
+                          ? element
+                          : (TypeLayout){alignUp(element.size + 1, element.align), element.align};
+            return true;
+        }
+        case FORM_UNION: {
+            // The largest member and a u32 saying which one it holds.
+            TypeLayout largest = {0, 4};
+            for (uint32_t i = 0; i < type->count; ++i) {
+                if (!typeLayout(table, type->items[i], &element)) {
+                    return false;
+                }
+                largest.size = max(largest.size, element.size);
+                largest.align = max(largest.align, element.align);
+            }
+            *layout = (TypeLayout){alignUp(alignUp(largest.size, 4) + 4, largest.align), largest.align};
+            return true;
+        }
+        default:
+            return false; // Named and generic types are laid out by whoever knows their fields.
+    }
+}
+
+bool typeLayout(TypeTable *table, const TypeId type, TypeLayout *layout) {
+    if (type == TYPE_ID_NONE) {
+        return false;
+    }
+
+    TypeEntry *entry = entryOf(table, type);
+    if (atomic_get(&entry->layoutState) == LAYOUT_KNOWN) {
+        *layout = entry->layout;
+        return true;
+    }
+
+    if (!computeLayout(table, &entry->type, layout)) {
+        return false;
+    }
+    setTypeLayout(table, type, *layout);
+
+    return true;
+}
+
+void setTypeLayout(TypeTable *table, const TypeId type, const TypeLayout layout) {
+    TypeEntry *entry = entryOf(table, type);
+
+    mutex_lock(&table->layoutLock);
+    if (atomic_get(&entry->layoutState) != LAYOUT_KNOWN) {
+        entry->layout = layout;
+        atomic_add(&entry->layoutState, LAYOUT_KNOWN);
+    }
+    mutex_unlock(&table->layoutLock);
+}
+
+static void appendList(const TypeTable *table, const Interner *interner, const TypeId *items, const uint32_t count,
+                       const char *separator, StrBuffer *buf) {
+    for (uint32_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            str_buf_append(buf, "%s", separator);
+        }
+        appendTypeName(table, interner, items[i], buf);
+    }
+}
+
+void appendTypeName(const TypeTable *table, const Interner *interner, const TypeId type, StrBuffer *buf) {
+    if (type == TYPE_ID_NONE) {
+        str_buf_append(buf, "?");
+        return;
+    }
+
+    const Type *t = typeOf(table, type);
+    switch (t->form) {
+        case FORM_PRIMITIVE:
+            str_buf_append(buf, "%s", primitiveNames[t->a]);
+            break;
+        case FORM_NAMED:
+            if (t->b != SYMBOL_NONE) {
+                str_buf_append(buf, "%s::", symbolName(interner, t->b, nullptr));
+            }
+            str_buf_append(buf, "%s", symbolName(interner, t->a, nullptr));
+            break;
+        case FORM_POINTER:
+        case FORM_MANY_POINTER:
+        case FORM_SLICE:
+        case FORM_VARIADIC:
+            str_buf_append(buf, "%s", t->form == FORM_POINTER        ? "^"
+                                      : t->form == FORM_MANY_POINTER ? "[^]"
+                                      : t->form == FORM_SLICE        ? "[]"
+                                                                     : "..");
+            appendTypeName(table, interner, t->a, buf);
+            break;
+        case FORM_ARRAY:
+            if (t->b == ARRAY_LENGTH_UNKNOWN) {
+                str_buf_append(buf, "[_]");
+            } else {
+                str_buf_append(buf, "[%u]", t->b);
+            }
+            appendTypeName(table, interner, t->a, buf);
+            break;
+        case FORM_OPTIONAL:
+            appendTypeName(table, interner, t->a, buf);
+            str_buf_append(buf, "?");
+            break;
+        case FORM_UNION:
+            str_buf_append(buf, "(");
+            appendList(table, interner, t->items, t->count, " | ", buf);
+            str_buf_append(buf, ")");
+            break;
+        case FORM_GENERIC:
+            appendTypeName(table, interner, t->a, buf);
+            str_buf_append(buf, "<");
+            appendList(table, interner, t->items, t->count, ", ", buf);
+            str_buf_append(buf, ">");
+            break;
+        case FORM_FUNCTION:
+            str_buf_append(buf, "fn(");
+            appendList(table, interner, t->items, t->a, ", ", buf);
+            str_buf_append(buf, ")");
+            if (t->count > t->a) {
+                str_buf_append(buf, ": ");
+                appendList(table, interner, t->items + t->a, t->count - t->a, ", ", buf);
+            }
+            break;
+    }
+}
+
+int typeTableCount(TypeTable *table) {
+    mutex_lock(&table->lock);
+    const int count = (int)table->count;
+    mutex_unlock(&table->lock);
+
+    return count;
+}
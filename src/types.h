@@ -0,0 +1,120 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_TYPES_H
+#define NIFTY_TYPES_H
+
+#include <stdint.h>
+
+#include "ast.h"
+#include "intern.h"
+#include "parser.h"
+#include "symtab.h"
+#include "util/str.h"
+
+// Compiler wide table of types. Every distinct type is made once and named by a dense id, so two types are the same
+// type exactly when their ids are equal, and anything worked out about a type, like its layout, is kept with its id.
+// Types are built from the ids of their parts: ^[]int is the pointer type of the slice type of the id of int.
+//
+// Safe to use from any number of threads at once. Reading a type by its id takes no lock, types never move or change
+// once made.
+typedef uint32_t TypeId;
+
+#define TYPE_ID_NONE 0
+
+// The length of an array whose size expression isn't evaluated yet.
+#define ARRAY_LENGTH_UNKNOWN UINT32_MAX
+
+typedef enum {
+    FORM_PRIMITIVE,    // a: TypeKind.
+    FORM_NAMED,        // a: name, b: namespace. Structs and other declared types, and type parameters like T.
+    FORM_POINTER,      // a: element type. ^T
+    FORM_MANY_POINTER, // a: element type. [^]T
+    FORM_SLICE,        // a: element type. []T
+    FORM_ARRAY,        // a: element type, b: length or ARRAY_LENGTH_UNKNOWN. [4]T
+    FORM_VARIADIC,     // a: element type. ..T
+    FORM_OPTIONAL,     // a: element type. T?
+    FORM_UNION,        // items: members, in order of their ids. int | float
+    FORM_GENERIC,      // a: the FORM_NAMED generic type, items: type arguments. Array<T>
+    FORM_FUNCTION,     // a: argument count, items: argument types then return types.
+} TypeForm;
+
+typedef struct {
+    TypeForm form;
+    uint32_t a;
+    uint32_t b;
+    uint32_t count; // Of items.
+    const TypeId *items;
+} Type;
+
+typedef struct {
+    int64_t size;
+    int align;
+} TypeLayout;
+
+typedef struct TypeTable TypeTable;
+
+// The interner is only used to know the builtin aliases like int by their names.
+TypeTable *initTypeTable(Interner *interner);
+void freeTypeTable(TypeTable *table);
+
+// Every builtin type exists from the start, with the id after its kind.
+static inline TypeId primitiveType(const TypeKind kind) {
+    return (TypeId)kind + 1;
+}
+
+TypeId namedType(TypeTable *table, Symbol namespace, Symbol name);
+TypeId pointerType(TypeTable *table, TypeId element);
+TypeId manyPointerType(TypeTable *table, TypeId element);
+TypeId sliceType(TypeTable *table, TypeId element);
+TypeId arrayType(TypeTable *table, TypeId element, uint32_t length);
+TypeId variadicType(TypeTable *table, TypeId element);
+TypeId optionalType(TypeTable *table, TypeId element);
+// Members that are unions themselves are merged in and repeats are dropped, so int | (float | int) is float | int,
+// which is int | float. A union of one type is that type.
+TypeId unionType(TypeTable *table, const TypeId *members, int count);
+TypeId genericType(TypeTable *table, TypeId base, const TypeId *args, int count);
+TypeId functionType(TypeTable *table, const TypeId *args, int argCount, const TypeId *returns, int returnCount);
+
+// The type node of file as a type, TYPE_ID_NONE for a missing one. Identifiers are taken as the type they name, for
+// types passed as arguments like cast(x, u64). Named types are found in symbols, first in the
+// file's namespace and then in any, and are taken as a type parameter of the file's namespace if they aren't
+// declared. symbols can be nullptr. Array sizes other than integer literals are left ARRAY_LENGTH_UNKNOWN.
+TypeId typeFromNode(TypeTable *table, const SymbolTable *symbols, const ParseResults *file, NodeIndex node);
+
+// type with every from[i] in it replaced by to[i], like Array<T> with T as s32 giving Array<s32>.
+TypeId substituteType(TypeTable *table, TypeId type, const TypeId *from, const TypeId *to, int count);
+
+const Type *typeOf(const TypeTable *table, TypeId type);
+
+// Size and alignment of type on a 64 bit target, false if they can't be known yet: named and generic types only have a
+// layout once setTypeLayout gives them one, and so do types holding them by value. Answers are kept with the type.
+bool typeLayout(TypeTable *table, TypeId type, TypeLayout *layout);
+void setTypeLayout(TypeTable *table, TypeId type, TypeLayout layout);
+
+// Appends the type as it is written in source to buf, like ^[]int or Array<T>?.
+void appendTypeName(const TypeTable *table, const Interner *interner, TypeId type, StrBuffer *buf);
+
+// Number of distinct types, the highest id handed out.
+int typeTableCount(TypeTable *table);
+
+#endif //NIFTY_TYPES_H
@@ -0,0 +1,116 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "str.h"
+
+#define ARENA_ALIGN 16
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;
+};
+
+void arena_init(Arena *arena, const size_t blockSize) {
+    arena->blocks = nullptr;
+    arena->at = nullptr;
+    arena->end = nullptr;
+    arena->blockSize = blockSize == 0 ? ARENA_DEFAULT_BLOCK : blockSize;
+    arena->used = 0;
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    while (block != nullptr) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena_init(arena, arena->blockSize);
+}
+
+// Starts a new block with room for at least size bytes after aligning.
+static bool grow(Arena *arena, const size_t size) {
+    const size_t header = (sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    const size_t bytes = max(arena->blockSize, size + header);
+
+    ArenaBlock *block = (ArenaBlock *)malloc(bytes);
+    if (block == nullptr) {
+        println("Out of memory.");
+        return false;
+    }
+
+    block->next = arena->blocks;
+    block->size = bytes;
+    arena->blocks = block;
+    arena->at = (char *)block + header;
+    arena->end = (char *)block + bytes;
+
+    return true;
+}
+
+void *arena_alloc(Arena *arena, const size_t size) {
+    uintptr_t at = ((uintptr_t)arena->at + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1);
+    if (arena->at == nullptr || at + size > (uintptr_t)arena->end) {
+        if (!grow(arena, size)) {
+            return nullptr;
+        }
+        at = (uintptr_t)arena->at;
+    }
+
+    arena->at = (char *)(at + size);
+    arena->used += size;
+
+    return (void *)at;
+}
+
+void *arena_alloc_packed(Arena *arena, const size_t size) {
+    if (arena->at == nullptr || size > (size_t)(arena->end - arena->at)) {
+        if (!grow(arena, size)) {
+            return nullptr;
+        }
+    }
+
+    void *bytes = arena->at;
+    arena->at += size;
+    arena->used += size;
+
+    return bytes;
+}
+
+char *arena_str(Arena *arena, const char *start, const size_t len) {
+    char *str = (char *)arena_alloc_packed(arena, len + 1);
+    if (str == nullptr) {
+        return nullptr;
+    }
+
+    memcpy(str, start, len);
+    str[len] = '\0';
+
+    return str;
+}
@@ -0,0 +1,55 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_ARENA_H
+#define NIFTY_ARENA_H
+
+#include <stddef.h>
+
+#include "../common.h"
+
+// Bump allocator. Memory handed out lives until arena_free, which releases every block at once.
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *blocks; // Newest first.
+    char *at;
+    char *end;
+    size_t blockSize;
+    size_t used; // Bytes handed out, not counting alignment padding.
+} Arena;
+
+// blockSize 0 uses ARENA_DEFAULT_BLOCK.
+#define ARENA_DEFAULT_BLOCK (64 * 1024)
+
+void arena_init(Arena *arena, size_t blockSize);
+void arena_free(Arena *arena);
+
+// Aligned for any type.
+void *arena_alloc(Arena *arena, size_t size);
+// Unaligned, for byte data.
+void *arena_alloc_packed(Arena *arena, size_t size);
+// NUL terminated copy of [start, start + len), unaligned.
+char *arena_str(Arena *arena, const char *start, size_t len);
+
+#endif //NIFTY_ARENA_H
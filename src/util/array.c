@@ -0,0 +1,38 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "array.h"
+
+#include <stdlib.h>
+
+#include "str.h"
+
+void *array_grow(void *items, int *capacity, const size_t itemSize) {
+    *capacity = *capacity == 0 ? 8 : *capacity * 2;
+    void *grown = realloc(items, itemSize * *capacity);
+    if (grown == nullptr) {
+        println("Out of memory.");
+        exit(1);
+    }
+
+    return grown;
+}
@@ -0,0 +1,369 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "fs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef N_WIN
+#   include <dirent.h>
+#   include <fcntl.h>
+#   include <limits.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#else
+#   include <direct.h>
+#endif
+
+#include "str.h"
+
+bool fs_is_dir(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+bool fs_is_file(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+}
+
+char *fs_real_path(const char *path) {
+#ifndef N_WIN
+    char *resolved = realpath(path, nullptr);
+    if (resolved == nullptr) {
+        return nullptr;
+    }
+
+    // realpath allocates with malloc, but keep every path on str_new so they are all freed the same way.
+    char *ret = str_new(resolved, nullptr);
+    free(resolved);
+    return ret;
+#else
+    char resolved[MAX_PATH];
+    if (_fullpath(resolved, path, MAX_PATH) == nullptr || access(resolved, F_OK) != 0) {
+        return nullptr;
+    }
+
+    for (char *c = resolved; *c; ++c) {
+        if (*c == '\\') {
+            *c = '/';
+        }
+    }
+    return str_new(resolved, nullptr);
+#endif
+}
+
+char *fs_dir_of(const char *path) {
+    int end = -1;
+    for (int i = 0; path[i]; ++i) {
+        if (path[i] == '/' || path[i] == '\\') {
+            end = i;
+        }
+    }
+
+    if (end < 0) {
+        return str_new(".", nullptr);
+    }
+
+    return str_new_len(path, end == 0 ? 1 : end);
+}
+
+char *fs_join(const char *dir, const char *name) {
+    const int dirLen = str_len(dir);
+    const int nameLen = str_len(name);
+    const bool separated = dirLen == 0 || (dir[dirLen - 1] == '/' || dir[dirLen - 1] == '\\');
+
+    char *ret = str_new_empty(dirLen + 1 + nameLen);
+    memcpy(ret, dir, dirLen);
+    int len = dirLen;
+    if (!separated) {
+        ret[len++] = '/';
+    }
+    memcpy(ret + len, name, nameLen + 1);
+
+    return ret;
+}
+
+bool fs_make_dirs(const char *path) {
+    if (fs_is_dir(path)) {
+        return true;
+    }
+
+    char *copy = str_new(path, nullptr);
+    const int len = str_len(copy);
+    // Every parent first, skipping a leading separator and drive letters.
+    for (int i = 1; i <= len; ++i) {
+        if (i < len && copy[i] != '/' && copy[i] != '\\') {
+            continue;
+        }
+
+        const char separator = copy[i];
+        copy[i] = '\0';
+        if (copy[i - 1] != ':' && !fs_is_dir(copy)) {
+#ifndef N_WIN
+            mkdir(copy, 0755);
+#else
+            _mkdir(copy);
+#endif
+        }
+        copy[i] = separator;
+    }
+    str_delete(copy);
+
+    // Another thread or process may have made it first, only the result matters.
+    return fs_is_dir(path);
+}
+
+bool fs_remove_dirs(const char *path) {
+    if (!fs_is_dir(path)) {
+        return remove(path) == 0 || !fs_is_file(path);
+    }
+
+#ifndef N_WIN
+    DIR *handle = opendir(path);
+    if (handle == nullptr) {
+        return false;
+    }
+
+    const struct dirent *entry;
+    while ((entry = readdir(handle)) != nullptr) {
+        if (!str_eq(entry->d_name, ".") && !str_eq(entry->d_name, "..")) {
+            char *file = fs_join(path, entry->d_name);
+            fs_remove_dirs(file);
+            str_delete(file);
+        }
+    }
+    closedir(handle);
+    rmdir(path);
+#else
+    char *pattern = fs_join(path, "*");
+    WIN32_FIND_DATAA data;
+    const HANDLE handle = FindFirstFileA(pattern, &data);
+    str_delete(pattern);
+    if (handle != INVALID_HANDLE_VALUE) {
+        do {
+            if (!str_eq(data.cFileName, ".") && !str_eq(data.cFileName, "..")) {
+                char *file = fs_join(path, data.cFileName);
+                fs_remove_dirs(file);
+                str_delete(file);
+            }
+        } while (FindNextFileA(handle, &data));
+        FindClose(handle);
+    }
+    _rmdir(path);
+#endif
+
+    return !fs_is_dir(path);
+}
+
+static bool hasExtension(const char *name, const char *extension) {
+    const int len = str_len(name);
+    const int extLen = str_len(extension);
+
+    return len > extLen && str_eq(name + len - extLen, extension);
+}
+
+static int compareNames(const void *a, const void *b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static bool addFile(char ***files, int *count, int *capacity, char *file) {
+    if (*count == *capacity) {
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+        char **grown = (char **)realloc(*files, sizeof(char *) * *capacity);
+        if (grown == nullptr) {
+            str_delete(file);
+            return false;
+        }
+        *files = grown;
+    }
+
+    (*files)[(*count)++] = file;
+    return true;
+}
+
+static bool listInto(const char *dir, const char *extension, const bool recursive, char ***files, int *count,
+                     int *capacity) {
+#ifndef N_WIN
+    DIR *handle = opendir(dir);
+    if (handle == nullptr) {
+        return false;
+    }
+
+    const struct dirent *entry;
+    while ((entry = readdir(handle)) != nullptr) {
+        if (str_eq(entry->d_name, ".") || str_eq(entry->d_name, "..")) {
+            continue;
+        }
+
+        const bool matches = hasExtension(entry->d_name, extension);
+        if (!matches && !recursive) {
+            continue;
+        }
+
+        char *file = fs_join(dir, entry->d_name);
+        if (recursive && fs_is_dir(file)) {
+            listInto(file, extension, recursive, files, count, capacity);
+            str_delete(file);
+        } else if (!matches || !fs_is_file(file)) {
+            str_delete(file);
+        } else if (!addFile(files, count, capacity, file)) {
+            break;
+        }
+    }
+    closedir(handle);
+#else
+    char *pattern = fs_join(dir, "*");
+    WIN32_FIND_DATAA data;
+    const HANDLE handle = FindFirstFileA(pattern, &data);
+    str_delete(pattern);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (recursive && !str_eq(data.cFileName, ".") && !str_eq(data.cFileName, "..")) {
+                char *sub = fs_join(dir, data.cFileName);
+                listInto(sub, extension, recursive, files, count, capacity);
+                str_delete(sub);
+            }
+            continue;
+        }
+
+        if (!hasExtension(data.cFileName, extension)) {
+            continue;
+        }
+
+        if (!addFile(files, count, capacity, fs_join(dir, data.cFileName))) {
+            break;
+        }
+    } while (FindNextFileA(handle, &data));
+    FindClose(handle);
+#endif
+
+    return true;
+}
+
+static char **listFiles(const char *dir, const char *extension, const bool recursive, int *count) {
+    char **files = nullptr;
+    int capacity = 0;
+    *count = 0;
+
+    if (!listInto(dir, extension, recursive, &files, count, &capacity)) {
+        fs_free_list(files, *count);
+        *count = 0;
+        return nullptr;
+    }
+
+    if (files == nullptr) {
+        // An empty directory still gives a list.
+        files = (char **)malloc(sizeof(char *));
+    }
+    qsort(files, *count, sizeof(char *), compareNames);
+
+    return files;
+}
+
+char **fs_list_files(const char *dir, const char *extension, int *count) {
+    return listFiles(dir, extension, false, count);
+}
+
+char **fs_list_files_recursive(const char *dir, const char *extension, int *count) {
+    return listFiles(dir, extension, true, count);
+}
+
+void fs_free_list(char **files, const int count) {
+    if (files == nullptr) {
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        str_delete(files[i]);
+    }
+    free(files);
+}
+
+const void *fs_map(const char *path, size_t *size) {
+#ifndef N_WIN
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+
+    *size = (size_t)st.st_size;
+    return data;
+#else
+    // Read into memory instead, mappings of files can't be replaced on Windows while they are open.
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+
+    fseek(file, 0L, SEEK_END);
+    const long len = ftell(file);
+    rewind(file);
+    if (len <= 0) {
+        fclose(file);
+        return nullptr;
+    }
+
+    void *data = malloc((size_t)len);
+    if (data == nullptr || fread(data, 1, (size_t)len, file) != (size_t)len) {
+        free(data);
+        fclose(file);
+        return nullptr;
+    }
+    fclose(file);
+
+    *size = (size_t)len;
+    return data;
+#endif
+}
+
+void fs_unmap(const void *data, const size_t size) {
+    if (data == nullptr) {
+        return;
+    }
+
+#ifndef N_WIN
+    munmap((void *)data, size);
+#else
+    (void)size;
+    free((void *)data);
+#endif
+}
@@ -0,0 +1,56 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_FS_H
+#define NIFTY_FS_H
+
+#include <stddef.h>
+
+#include "../common.h"
+
+// Paths use '/', which Windows accepts too. Returned strings are freed with str_delete.
+
+bool fs_is_dir(const char *path);
+bool fs_is_file(const char *path);
+
+// Absolute path with . and .. resolved, nullptr if path doesn't exist.
+char *fs_real_path(const char *path);
+// path up to its last separator, "." if it has none.
+char *fs_dir_of(const char *path);
+char *fs_join(const char *dir, const char *name);
+// Creates path and any missing parents. True if it is a directory afterwards.
+bool fs_make_dirs(const char *path);
+// Deletes path and everything in it. True if it doesn't exist afterwards.
+bool fs_remove_dirs(const char *path);
+
+// Full paths of the files in dir ending in extension, sorted so the order doesn't depend on the file system. nullptr
+// if dir can't be read. Freed with fs_free_list.
+char **fs_list_files(const char *dir, const char *extension, int *count);
+// Same as fs_list_files, with the files of every directory below dir too.
+char **fs_list_files_recursive(const char *dir, const char *extension, int *count);
+void fs_free_list(char **files, int count);
+
+// Read only view of a whole file, nullptr if it can't be read or is empty. Freed with fs_unmap.
+const void *fs_map(const char *path, size_t *size);
+void fs_unmap(const void *data, size_t size);
+
+#endif //NIFTY_FS_H
@@ -0,0 +1,97 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_HASH_H
+#define NIFTY_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../common.h"
+
+static inline uint64_t hash_load64(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t hash_load32(const char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// Hash of [p, p + len), eight bytes at a time. Never reads outside the span, short tails are loaded as overlapping
+// words. Every bit of the result depends on every input byte, so the high and low bits can be used separately. Not
+// meant to resist chosen inputs.
+static inline uint64_t hash_bytes(const char *p, const size_t len) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = (len + 1) * k;
+
+    if (len >= 8) {
+        size_t i = 0;
+        for (; i + 8 < len; i += 8) {
+            h = (h ^ hash_load64(p + i)) * k;
+            h ^= h >> 32;
+        }
+        h = (h ^ hash_load64(p + len - 8)) * k;
+    } else if (len >= 4) {
+        h = (h ^ (hash_load32(p) << 32 | hash_load32(p + len - 4))) * k;
+    } else if (len > 0) {
+        h = (h ^ ((uint64_t)(uint8_t)p[0] << 16 | (uint64_t)(uint8_t)p[len / 2] << 8 | (uint8_t)p[len - 1])) * k;
+    }
+
+    // Finalizer from MurmurHash3.
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+
+    return h;
+}
+
+// Whether [a, a + len) and [b, b + len) hold the same bytes, without a call for names up to 16 bytes.
+static inline bool hash_same_bytes(const char *a, const char *b, const size_t len) {
+    if (len > 16) {
+        return memcmp(a, b, len) == 0;
+    }
+
+    if (len >= 8) {
+        return hash_load64(a) == hash_load64(b) && hash_load64(a + len - 8) == hash_load64(b + len - 8);
+    }
+
+    if (len >= 4) {
+        return hash_load32(a) == hash_load32(b) && hash_load32(a + len - 4) == hash_load32(b + len - 4);
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif //NIFTY_HASH_H
@@ -40,6 +40,12 @@ void printHelp(const char *cmd) {
         dbln();
         println("Build specific flags:");
         printStrsWithSpacer("\t--all", '-', "Builds all the targets in the build file.", width);
+        printStrsWithSpacer("\t--json", '-', "Prints errors and warnings as a JSON array instead of text.", width);
+        printStrsWithSpacer("\t--time-report", '-', "Prints the time spent in each compiler phase.", width);
+        printStrsWithSpacer("\t--emit-ir", '-', "Prints the IR of every function after building.", width);
+        printStrsWithSpacer("\t--remarks", '-', "Prints what the optimizer did, like the calls it inlined.", width);
+        printStrsWithSpacer("\t--vectorize-report", '-', "Prints which loops can vectorize, and why the others can't.",
+                            width);
 
         if (!printAll) {
             return;
@@ -73,7 +79,7 @@ void printHelp(const char *cmd) {
         printStrsWithSpacer("\tnifty clean <string>", '-', "Delete compiled files for the project or target.", width);
         dbln();
         println("Examples:");
-        printStrsWithSpacer("\tnifty clean", '-', "Cleans the default target in 'build.toml'.", width); // TODO: NIFTY_BUILD_FILE
+        printStrsWithSpacer("\tnifty clean", '-', "Deletes the project's 'build' folder, with its AST cache.", width);
         printStrsWithSpacer("\tnifty clean editor", '-', "Cleans the target 'editor' in 'build.toml'.", width); // TODO: NIFTY_BUILD_FILE
         dbln();
         println("Clean specific flags:");
@@ -156,6 +162,33 @@ void printHelp(const char *cmd) {
         }
     }
 
+    if (str_eq(cmd, "bench") || printAll) {
+        if (printAll) {
+            dbln();
+        }
+
+        println("Usage: nifty bench <name> <inputs>");
+        printStrsWithSpacer("\tnifty bench <name>", '-', "Runs a compiler benchmark.", width);
+        dbln();
+        println("Benchmarks:");
+        printStrsWithSpacer("\tlex <file>", '-', "Lexing speed and peak RSS with memory mapped and copied sources.", width);
+        printStrsWithSpacer("\tlex-parallel <MB> <N>", '-', "Tokens per second lexing a synthetic file on 1 to N threads, 100 MB and all cores by default.", width);
+        printStrsWithSpacer("\tparse <files>", '-', "Time to parse every file once, without printing parse errors, and again skipping function bodies.", width);
+        printStrsWithSpacer("\tparse-program <entry|count> <N>", '-', "Parsing every file a program uses on 1 to N threads, checking each thread count gives the same files and trees. A count instead of an entry point generates a project with that many files, 2000 by default.", width);
+        printStrsWithSpacer("\trebuild <dirs|files>", '-', "A no-op rebuild of every .nifty file under dirs: parsing, filling an empty AST cache and loading from a warm one, checking the cached trees match.", width);
+        printStrsWithSpacer("\tsymbols <count> <N>", '-', "Declaring and looking up names in the symbol table from 1 to N threads at once, checking none are lost, a million by default.", width);
+        printStrsWithSpacer("\ttypes <entry|count> <N>", '-', "Making every type written in a program into a type id, its files split over 1 to N threads, checking no type was made twice. A count generates the program like parse-program.", width);
+        printStrsWithSpacer("\tcheck <entry|count> <N>", '-', "Checking the function bodies of a program on 1 to N threads, checking the diagnostics and instances are the same on each. A count generates the program like parse-program.", width);
+        printStrsWithSpacer("\tintern <file>", '-', "Lexing file with and without interning names, checking the symbols against the text and parallel lexing.", width);
+        printStrsWithSpacer("\tnumbers <MB>", '-', "Lexing a synthetic table of numeric literals, checking every value against strtoull and strtod, 32 MB by default.", width);
+        printStrsWithSpacer("\trelex <MB>", '-', "Time per keystroke edit in an edit buffer, on synthetic files from 64 KB up to MB, 64 by default.", width);
+        printStrsWithSpacer("\tkeywords <file>", '-', "Keyword classification speed of the perfect hash against the old switch.", width);
+
+        if (!printAll) {
+            return;
+        }
+    }
+
     if (str_eq(cmd, "version") || printAll) {
         if (printAll) {
             dbln();
@@ -295,6 +328,7 @@ void printHelp(const char *cmd) {
     printStrsWithSpacer("\tinfo", '-', "Prints information about the Nifty compiler.", width);
     printStrsWithSpacer("\tlist", '-', "List all of the targets for the build file in the current directory.", width);
     printStrsWithSpacer("\tcolors", '-', "Color codes can be set in the nifty config file, prints colors for reference.", width);
+    printStrsWithSpacer("\tbench", '-', "Runs compiler benchmarks.", width);
     dbln();
     println("To see a list of flags run 'nifty help flags'.");
     println("To see a list of environment variables used by nifty run 'nifty help env'.");
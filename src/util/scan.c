@@ -0,0 +1,229 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "scan.h"
+
+#include <stdint.h>
+
+#include "str.h"
+
+#if NIFTY_SCAN_WIDTH == 32
+#   include <immintrin.h>
+
+typedef __m256i Vec;
+typedef uint32_t Mask;
+#   define SCAN_ALL      0xFFFFFFFFu
+#   define vload(p)      _mm256_loadu_si256((const __m256i *)(p))
+#   define vset1(c)      _mm256_set1_epi8((char)(c))
+#   define veq(a, b)     _mm256_cmpeq_epi8(a, b)
+#   define vor(a, b)     _mm256_or_si256(a, b)
+#   define vsub(a, b)    _mm256_sub_epi8(a, b)
+#   define vmin(a, b)    _mm256_min_epu8(a, b)
+#   define vmask(v)      ((Mask)_mm256_movemask_epi8(v))
+#elif NIFTY_SCAN_WIDTH == 16
+#   include <emmintrin.h>
+
+typedef __m128i Vec;
+typedef uint32_t Mask;
+#   define SCAN_ALL      0xFFFFu
+#   define vload(p)      _mm_loadu_si128((const __m128i *)(p))
+#   define vset1(c)      _mm_set1_epi8((char)(c))
+#   define veq(a, b)     _mm_cmpeq_epi8(a, b)
+#   define vor(a, b)     _mm_or_si128(a, b)
+#   define vsub(a, b)    _mm_sub_epi8(a, b)
+#   define vmin(a, b)    _mm_min_epu8(a, b)
+#   define vmask(v)      ((Mask)_mm_movemask_epi8(v))
+#endif
+
+#if NIFTY_SCAN_WIDTH > 1
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+
+static inline int ctz(const Mask m) {
+    unsigned long idx;
+    _BitScanForward(&idx, m);
+    return (int)idx;
+}
+
+static inline int popcount(const Mask m) {
+    return (int)__popcnt(m);
+}
+#else
+#   define ctz(m)      __builtin_ctz(m)
+#   define popcount(m) __builtin_popcount(m)
+#endif
+
+// Lanes where lo <= c <= hi, as an unsigned compare.
+static inline Vec inRange(const Vec v, const char lo, const char hi) {
+    const Vec t = vsub(v, vset1(lo));
+    return veq(vmin(t, vset1(hi - lo)), t);
+}
+
+static inline Mask identMask(const Vec v) {
+    const Vec letters = inRange(vor(v, vset1(0x20)), 'a', 'z');
+    const Vec digits = inRange(v, '0', '9');
+    return vmask(vor(vor(letters, digits), veq(v, vset1('_'))));
+}
+
+#endif
+
+const char *scan_blanks(const char *p) {
+#if NIFTY_SCAN_WIDTH > 1
+    const Vec space = vset1(' ');
+    const Vec tab = vset1('\t');
+    for (;; p += NIFTY_SCAN_WIDTH) {
+        const Vec v = vload(p);
+        const Mask stop = ~vmask(vor(veq(v, space), veq(v, tab))) & SCAN_ALL;
+        if (stop != 0) {
+            return p + ctz(stop);
+        }
+    }
+#else
+    while (*p == ' ' || *p == '\t') {
+        ++p;
+    }
+    return p;
+#endif
+}
+
+const char *scan_line_end(const char *p) {
+#if NIFTY_SCAN_WIDTH > 1
+    const Vec nl = vset1('\n');
+    const Vec zero = vset1('\0');
+    for (;; p += NIFTY_SCAN_WIDTH) {
+        const Vec v = vload(p);
+        const Mask stop = vmask(vor(veq(v, nl), veq(v, zero)));
+        if (stop != 0) {
+            return p + ctz(stop);
+        }
+    }
+#else
+    while (*p != '\n' && *p != '\0') {
+        ++p;
+    }
+    return p;
+#endif
+}
+
+const char *scan_ident(const char *p) {
+#if NIFTY_SCAN_WIDTH > 1
+    for (;; p += NIFTY_SCAN_WIDTH) {
+        const Mask stop = ~identMask(vload(p)) & SCAN_ALL;
+        if (stop != 0) {
+            return p + ctz(stop);
+        }
+    }
+#else
+    while (isAlphaNumeric(*p)) {
+        ++p;
+    }
+    return p;
+#endif
+}
+
+const char *scan_digits(const char *p) {
+#if NIFTY_SCAN_WIDTH > 1
+    const Vec underscore = vset1('_');
+    for (;; p += NIFTY_SCAN_WIDTH) {
+        const Vec v = vload(p);
+        const Mask stop = ~vmask(vor(inRange(v, '0', '9'), veq(v, underscore))) & SCAN_ALL;
+        if (stop != 0) {
+            return p + ctz(stop);
+        }
+    }
+#else
+    while (isDigit(*p) || *p == '_') {
+        ++p;
+    }
+    return p;
+#endif
+}
+
+const char *scan_comment_body(const char *p) {
+#if NIFTY_SCAN_WIDTH > 1
+    const Vec slash = vset1('/');
+    const Vec dash = vset1('-');
+    const Vec star = vset1('*');
+    const Vec zero = vset1('\0');
+    for (;; p += NIFTY_SCAN_WIDTH) {
+        const Vec v = vload(p);
+        const Mask stop = vmask(vor(vor(veq(v, slash), veq(v, dash)), vor(veq(v, star), veq(v, zero))));
+        if (stop != 0) {
+            return p + ctz(stop);
+        }
+    }
+#else
+    while (*p != '/' && *p != '-' && *p != '*' && *p != '\0') {
+        ++p;
+    }
+    return p;
+#endif
+}
+
+const char *scan_string_body(const char *p, const char quote) {
+#if NIFTY_SCAN_WIDTH > 1
+    const Vec q = vset1(quote);
+    const Vec backslash = vset1('\\');
+    const Vec zero = vset1('\0');
+    for (;; p += NIFTY_SCAN_WIDTH) {
+        const Vec v = vload(p);
+        const Mask stop = vmask(vor(vor(veq(v, q), veq(v, backslash)), veq(v, zero)));
+        if (stop != 0) {
+            return p + ctz(stop);
+        }
+    }
+#else
+    while (*p != quote && *p != '\\' && *p != '\0') {
+        ++p;
+    }
+    return p;
+#endif
+}
+
+size_t scan_line_starts(const char *p, const size_t len, const uint32_t base, uint32_t *starts) {
+    size_t count = 0;
+    size_t i = 0;
+#if NIFTY_SCAN_WIDTH > 1
+    const Vec nl = vset1('\n');
+    for (; i + NIFTY_SCAN_WIDTH <= len; i += NIFTY_SCAN_WIDTH) {
+        Mask m = vmask(veq(vload(p + i), nl));
+        if (starts == nullptr) {
+            count += popcount(m);
+            continue;
+        }
+
+        for (; m != 0; m &= m - 1) {
+            starts[count++] = base + (uint32_t)(i + ctz(m)) + 1;
+        }
+    }
+#endif
+    for (; i < len; ++i) {
+        if (p[i] == '\n') {
+            if (starts != nullptr) {
+                starts[count] = base + (uint32_t)i + 1;
+            }
+            ++count;
+        }
+    }
+    return count;
+}
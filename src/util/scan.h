@@ -0,0 +1,61 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_SCAN_H
+#define NIFTY_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common.h"
+
+// Vectorized scanners used by the lexer. They read up to NIFTY_SCAN_WIDTH bytes at a time past the returned position,
+// so the buffer must be NUL terminated and followed by at least that many readable bytes (see NIFTY_SOURCE_PADDING).
+// '\0' always stops a scan.
+
+#if defined(__AVX2__)
+#   define NIFTY_SCAN_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define NIFTY_SCAN_WIDTH 16
+#else
+#   define NIFTY_SCAN_WIDTH 1
+#endif
+
+// Skips ' ' and '\t'.
+const char *scan_blanks(const char *p);
+// Skips to the next '\n' or '\0'.
+const char *scan_line_end(const char *p);
+// Skips [a-zA-Z0-9_].
+const char *scan_ident(const char *p);
+// Skips [0-9_].
+const char *scan_digits(const char *p);
+
+// Skips to the next '/', '-', '*' or '\0'.
+const char *scan_comment_body(const char *p);
+// Skips to the next quote, '\\' or '\0'.
+const char *scan_string_body(const char *p, char quote);
+
+// Number of '\n' in [p, p + len). If starts isn't nullptr, base plus the offset of the character after each one is
+// written to it in order, it must have room for all of them.
+size_t scan_line_starts(const char *p, size_t len, uint32_t base, uint32_t *starts);
+
+#endif //NIFTY_SCAN_H
@@ -59,7 +59,7 @@ inline void str_cpy(register char *dst, register const char *src) {
 
 inline void str_cpyn(register char *dst, const register int n, register const char *src) {
     for (int i = 0; i < n && ((*dst = *src)); ++src, ++dst, ++i) {}
-    dst[n] = '\0';
+    *dst = '\0';
 }
 
 char *str_new(const char *s, int *len) {
@@ -225,7 +225,7 @@ char *str_get_line(const char *src, const int line, int *len) {
 
     int currentLine = 1;
     const char *at = src;
-    for (; *at != EOF; ++at) {
+    for (; *at != '\0'; ++at) {
         if (currentLine == line) {
             break;
         }
@@ -235,14 +235,18 @@ char *str_get_line(const char *src, const int line, int *len) {
         }
     }
 
-    if (*at == EOF) {
+    if (currentLine != line) {
         println("Could not find line %d.", line);
         return nullptr;
     }
 
     const char *start = at;
     int length = 0;
-    for (; *at != '\n'; ++at, ++length) {}
+    for (; *at != '\n' && *at != '\0'; ++at, ++length) {}
+
+    if (length > 0 && start[length - 1] == '\r') {
+        --length;
+    }
 
     if (len != nullptr) {
         *len = length;
@@ -289,3 +293,76 @@ void setTextColor(const CompilerConfig *cfg, const char *color) {
         printf("%s", color);
     }
 }
+
+void str_buf_init(StrBuffer *buf) {
+    buf->data = nullptr;
+    buf->len = 0;
+    buf->capacity = 0;
+}
+
+void str_buf_free(StrBuffer *buf) {
+    free(buf->data);
+    str_buf_init(buf);
+}
+
+// Room for len more characters and the NUL.
+static bool str_buf_reserve(StrBuffer *buf, const int len) {
+    if (buf->len + len + 1 <= buf->capacity) {
+        return true;
+    }
+
+    int capacity = buf->capacity < 256 ? 256 : buf->capacity * 2;
+    while (capacity < buf->len + len + 1) {
+        capacity *= 2;
+    }
+
+    char *data = (char *)realloc(buf->data, capacity);
+    if (data == nullptr) {
+        return false;
+    }
+    buf->data = data;
+    buf->capacity = capacity;
+
+    return true;
+}
+
+void str_buf_append(StrBuffer *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int len = vsnprintf(nullptr, 0, fmt, args);
+    va_end(args);
+    if (len <= 0 || !str_buf_reserve(buf, len)) {
+        return;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(buf->data + buf->len, len + 1, fmt, args);
+    va_end(args);
+    buf->len += len;
+}
+
+void str_buf_append_len(StrBuffer *buf, const char *s, const int len) {
+    if (len <= 0 || !str_buf_reserve(buf, len)) {
+        return;
+    }
+
+    memcpy(buf->data + buf->len, s, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+void str_buf_repeat(StrBuffer *buf, const char c, const int count) {
+    if (count <= 0 || !str_buf_reserve(buf, count)) {
+        return;
+    }
+
+    memset(buf->data + buf->len, c, count);
+    buf->len += count;
+    buf->data[buf->len] = '\0';
+}
+
+void str_buf_color(StrBuffer *buf, const CompilerConfig *cfg, const char *color) {
+    if (cfg != nullptr && !cfg->disableColors) {
+        str_buf_append(buf, "%s", color);
+    }
+}
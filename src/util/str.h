@@ -69,4 +69,18 @@ void printStrsWithSpacer(const char *s1, char spacer, const char *s2, int width)
 
 void setTextColor(const CompilerConfig *cfg, const char *color);
 
+// Growable text, for output that has to be held back and printed later.
+typedef struct {
+    char *data;
+    int len;
+    int capacity;
+} StrBuffer;
+
+void str_buf_init(StrBuffer *buf);
+void str_buf_free(StrBuffer *buf);
+void str_buf_append(StrBuffer *buf, const char *fmt, ...);
+void str_buf_append_len(StrBuffer *buf, const char *s, int len);
+void str_buf_repeat(StrBuffer *buf, char c, int count);
+void str_buf_color(StrBuffer *buf, const CompilerConfig *cfg, const char *color);
+
 #endif //NIFTY_STR_H
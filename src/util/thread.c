@@ -0,0 +1,402 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "thread.h"
+
+#include <stdlib.h>
+
+#ifndef N_WIN
+#   include <unistd.h>
+#endif
+
+typedef struct {
+    TaskFn fn;
+    void *arg;
+    TaskGroup *group;
+} Task;
+
+typedef struct {
+    TaskFn fn;
+    void *arg;
+} ThreadStart;
+
+#ifndef N_WIN
+static void *threadMain(void *arg) {
+    const ThreadStart start = *(ThreadStart *)arg;
+    free(arg);
+    start.fn(start.arg);
+    return nullptr;
+}
+#else
+static DWORD WINAPI threadMain(LPVOID arg) {
+    const ThreadStart start = *(ThreadStart *)arg;
+    free(arg);
+    start.fn(start.arg);
+    return 0;
+}
+#endif
+
+bool thread_start(Thread *thread, const TaskFn fn, void *arg) {
+    ThreadStart *start = (ThreadStart *)malloc(sizeof(ThreadStart));
+    start->fn = fn;
+    start->arg = arg;
+
+#ifndef N_WIN
+    if (pthread_create(thread, nullptr, threadMain, start) != 0) {
+        free(start);
+        return false;
+    }
+#else
+    *thread = CreateThread(nullptr, 0, threadMain, start, 0, nullptr);
+    if (*thread == nullptr) {
+        free(start);
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+void thread_join(const Thread thread) {
+#ifndef N_WIN
+    pthread_join(thread, nullptr);
+#else
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#endif
+}
+
+int thread_hardware_concurrency() {
+#ifndef N_WIN
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#else
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#endif
+}
+
+#ifndef N_WIN
+void mutex_init(Mutex *mutex)        { pthread_mutex_init(mutex, nullptr); }
+void mutex_destroy(Mutex *mutex)     { pthread_mutex_destroy(mutex); }
+void mutex_lock(Mutex *mutex)        { pthread_mutex_lock(mutex); }
+void mutex_unlock(Mutex *mutex)      { pthread_mutex_unlock(mutex); }
+
+void cond_init(Cond *cond)                  { pthread_cond_init(cond, nullptr); }
+void cond_destroy(Cond *cond)               { pthread_cond_destroy(cond); }
+void cond_wait(Cond *cond, Mutex *mutex)    { pthread_cond_wait(cond, mutex); }
+void cond_signal(Cond *cond)                { pthread_cond_signal(cond); }
+void cond_broadcast(Cond *cond)             { pthread_cond_broadcast(cond); }
+
+int atomic_add(volatile int *value, const int delta) { return __atomic_add_fetch(value, delta, __ATOMIC_SEQ_CST); }
+int atomic_get(volatile int *value)                  { return __atomic_load_n(value, __ATOMIC_SEQ_CST); }
+
+void *atomic_load_ptr(void *volatile *ptr)              { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+void atomic_store_ptr(void *volatile *ptr, void *value) { __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+#else
+void mutex_init(Mutex *mutex)        { InitializeSRWLock(mutex); }
+void mutex_destroy(Mutex *mutex)     { (void)mutex; }
+void mutex_lock(Mutex *mutex)        { AcquireSRWLockExclusive(mutex); }
+void mutex_unlock(Mutex *mutex)      { ReleaseSRWLockExclusive(mutex); }
+
+void cond_init(Cond *cond)                  { InitializeConditionVariable(cond); }
+void cond_destroy(Cond *cond)               { (void)cond; }
+void cond_wait(Cond *cond, Mutex *mutex)    { SleepConditionVariableSRW(cond, mutex, INFINITE, 0); }
+void cond_signal(Cond *cond)                { WakeConditionVariable(cond); }
+void cond_broadcast(Cond *cond)             { WakeAllConditionVariable(cond); }
+
+int atomic_add(volatile int *value, const int delta) { return InterlockedAdd((volatile LONG *)value, delta); }
+int atomic_get(volatile int *value)                  { return InterlockedCompareExchange((volatile LONG *)value, 0, 0); }
+
+void *atomic_load_ptr(void *volatile *ptr)              { return InterlockedCompareExchangePointer(ptr, nullptr, nullptr); }
+void atomic_store_ptr(void *volatile *ptr, void *value) { InterlockedExchangePointer(ptr, value); }
+#endif
+
+// A double ended queue of tasks. Its worker pushes and pops at the back, so it runs what it submitted last while the
+// data is still in its cache, other threads steal the oldest task from the front.
+typedef struct {
+    Mutex lock;
+    Task *tasks; // Ring buffer.
+    int head;
+    int count;
+    int capacity;
+} TaskQueue;
+
+typedef struct {
+    ThreadPool *pool;
+    int index;
+} WorkerStart;
+
+struct ThreadPool {
+    Thread *threads;
+    WorkerStart *starts;
+    int threadCount;
+
+    // One queue per worker, and a last one for tasks submitted by threads outside the pool.
+    TaskQueue *queues;
+    int queueCount;
+
+    volatile int queued;   // Tasks in the queues.
+    volatile int pending;  // Queued or running.
+    volatile int sleeping; // Threads waiting on wake.
+    bool stopping;
+
+    Mutex lock; // Only for sleeping and waking.
+    Cond wake;
+};
+
+#ifndef N_WIN
+#   define THREAD_LOCAL __thread
+#else
+#   define THREAD_LOCAL __declspec(thread)
+#endif
+
+// The pool and queue of the worker running on this thread, nullptr outside of pools.
+static THREAD_LOCAL ThreadPool *currentPool = nullptr;
+static THREAD_LOCAL int currentQueue = 0;
+
+static void queueInit(TaskQueue *queue) {
+    mutex_init(&queue->lock);
+    queue->capacity = 64;
+    queue->tasks = (Task *)malloc(sizeof(Task) * queue->capacity);
+    queue->head = 0;
+    queue->count = 0;
+}
+
+static void queueFree(TaskQueue *queue) {
+    mutex_destroy(&queue->lock);
+    free(queue->tasks);
+}
+
+static void queuePush(TaskQueue *queue, const Task *task) {
+    mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity) {
+        Task *tasks = (Task *)malloc(sizeof(Task) * queue->capacity * 2);
+        for (int i = 0; i < queue->count; ++i) {
+            tasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+        }
+        free(queue->tasks);
+        queue->tasks = tasks;
+        queue->head = 0;
+        queue->capacity *= 2;
+    }
+
+    queue->tasks[(queue->head + queue->count) % queue->capacity] = *task;
+    ++queue->count;
+    mutex_unlock(&queue->lock);
+}
+
+// Takes the newest task when back is set, the oldest otherwise.
+static bool queueTake(TaskQueue *queue, Task *task, const bool back) {
+    mutex_lock(&queue->lock);
+    if (queue->count == 0) {
+        mutex_unlock(&queue->lock);
+        return false;
+    }
+
+    if (back) {
+        *task = queue->tasks[(queue->head + queue->count - 1) % queue->capacity];
+    } else {
+        *task = queue->tasks[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+    }
+    --queue->count;
+    mutex_unlock(&queue->lock);
+
+    return true;
+}
+
+// Own queue first, then the others starting with the next one, so thieves spread out.
+static bool findTask(ThreadPool *pool, const int self, Task *task) {
+    if (atomic_get(&pool->queued) == 0) {
+        return false;
+    }
+
+    for (int i = 0; i < pool->queueCount; ++i) {
+        const int index = (self + i) % pool->queueCount;
+        if (queueTake(&pool->queues[index], task, i == 0 && self < pool->threadCount)) {
+            atomic_add(&pool->queued, -1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void wakeAll(ThreadPool *pool) {
+    mutex_lock(&pool->lock);
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+}
+
+static void runTask(ThreadPool *pool, const Task *task) {
+    task->fn(task->arg);
+
+    // Waiters check their counter under the lock before sleeping, so a broadcast at zero can't be missed.
+    const bool groupDone = task->group != nullptr && atomic_add(&task->group->pending, -1) == 0;
+    if (atomic_add(&pool->pending, -1) == 0 || groupDone) {
+        wakeAll(pool);
+    }
+}
+
+// Sleeps until there is work to steal, the pool stops or *counter reaches zero. Returns false once the pool is
+// stopping and every task has been taken.
+static bool sleepUntil(ThreadPool *pool, volatile int *counter) {
+    mutex_lock(&pool->lock);
+    atomic_add(&pool->sleeping, 1);
+    while (atomic_get(&pool->queued) == 0 && !pool->stopping && (counter == nullptr || atomic_get(counter) > 0)) {
+        cond_wait(&pool->wake, &pool->lock);
+    }
+    atomic_add(&pool->sleeping, -1);
+    const bool running = !pool->stopping || atomic_get(&pool->queued) > 0;
+    mutex_unlock(&pool->lock);
+
+    return running;
+}
+
+static void worker(void *arg) {
+    const WorkerStart *start = (WorkerStart *)arg;
+    ThreadPool *pool = start->pool;
+    currentPool = pool;
+    currentQueue = start->index;
+
+    Task task;
+    for (;;) {
+        if (findTask(pool, currentQueue, &task)) {
+            runTask(pool, &task);
+        } else if (!sleepUntil(pool, nullptr)) {
+            break;
+        }
+    }
+}
+
+ThreadPool *pool_new(int threads) {
+    if (threads <= 0) {
+        threads = thread_hardware_concurrency();
+    }
+
+    ThreadPool *pool = (ThreadPool *)malloc(sizeof(ThreadPool));
+    pool->threads = (Thread *)malloc(sizeof(Thread) * threads);
+    pool->starts = (WorkerStart *)malloc(sizeof(WorkerStart) * threads);
+    pool->threadCount = 0;
+    pool->queueCount = threads + 1;
+    pool->queues = (TaskQueue *)malloc(sizeof(TaskQueue) * pool->queueCount);
+    for (int i = 0; i < pool->queueCount; ++i) {
+        queueInit(&pool->queues[i]);
+    }
+    pool->queued = 0;
+    pool->pending = 0;
+    pool->sleeping = 0;
+    pool->stopping = false;
+    mutex_init(&pool->lock);
+    cond_init(&pool->wake);
+
+    for (int i = 0; i < threads; ++i) {
+        pool->starts[i].pool = pool;
+        pool->starts[i].index = i;
+        if (!thread_start(&pool->threads[pool->threadCount], worker, &pool->starts[i])) {
+            break;
+        }
+        ++pool->threadCount;
+    }
+
+    return pool;
+}
+
+void pool_free(ThreadPool *pool) {
+    if (pool == nullptr) {
+        return;
+    }
+
+    mutex_lock(&pool->lock);
+    pool->stopping = true;
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->threadCount; ++i) {
+        thread_join(pool->threads[i]);
+    }
+
+    cond_destroy(&pool->wake);
+    mutex_destroy(&pool->lock);
+    for (int i = 0; i < pool->queueCount; ++i) {
+        queueFree(&pool->queues[i]);
+    }
+    free(pool->queues);
+    free(pool->starts);
+    free(pool->threads);
+    free(pool);
+}
+
+int pool_thread_count(const ThreadPool *pool) {
+    return pool->threadCount;
+}
+
+void pool_submit_group(ThreadPool *pool, TaskGroup *group, const TaskFn fn, void *arg) {
+    if (pool->threadCount == 0) {
+        fn(arg);
+        return;
+    }
+
+    const Task task = {fn, arg, group};
+    if (group != nullptr) {
+        atomic_add(&group->pending, 1);
+    }
+    atomic_add(&pool->pending, 1);
+
+    // Workers keep what they submit, tasks from outside go to the shared queue.
+    queuePush(&pool->queues[currentPool == pool ? currentQueue : pool->threadCount], &task);
+    atomic_add(&pool->queued, 1);
+
+    if (atomic_get(&pool->sleeping) > 0) {
+        mutex_lock(&pool->lock);
+        cond_signal(&pool->wake);
+        mutex_unlock(&pool->lock);
+    }
+}
+
+void pool_submit(ThreadPool *pool, const TaskFn fn, void *arg) {
+    pool_submit_group(pool, nullptr, fn, arg);
+}
+
+// Runs tasks until *counter reaches zero, sleeping only when there is nothing left to take.
+static void helpUntil(ThreadPool *pool, volatile int *counter) {
+    const int self = currentPool == pool ? currentQueue : pool->threadCount;
+
+    Task task;
+    while (atomic_get(counter) > 0) {
+        if (findTask(pool, self, &task)) {
+            runTask(pool, &task);
+        } else {
+            sleepUntil(pool, counter);
+        }
+    }
+}
+
+void pool_wait_group(ThreadPool *pool, TaskGroup *group) {
+    helpUntil(pool, &group->pending);
+}
+
+void pool_wait(ThreadPool *pool) {
+    helpUntil(pool, &pool->pending);
+}
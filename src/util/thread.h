@@ -0,0 +1,87 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#ifndef NIFTY_THREAD_H
+#define NIFTY_THREAD_H
+
+#include "../common.h"
+
+#ifndef N_WIN
+#   include <pthread.h>
+
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Cond;
+#else
+typedef HANDLE Thread;
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE Cond;
+#endif
+
+typedef void (*TaskFn)(void *arg);
+
+bool thread_start(Thread *thread, TaskFn fn, void *arg);
+void thread_join(Thread thread);
+int thread_hardware_concurrency();
+
+void mutex_init(Mutex *mutex);
+void mutex_destroy(Mutex *mutex);
+void mutex_lock(Mutex *mutex);
+void mutex_unlock(Mutex *mutex);
+
+void cond_init(Cond *cond);
+void cond_destroy(Cond *cond);
+void cond_wait(Cond *cond, Mutex *mutex);
+void cond_signal(Cond *cond);
+void cond_broadcast(Cond *cond);
+
+// Sequentially consistent. atomic_add returns the new value.
+int atomic_add(volatile int *value, int delta);
+int atomic_get(volatile int *value);
+
+// Acquire and release, for publishing what a pointer points to to threads that read it without a lock.
+void *atomic_load_ptr(void *volatile *ptr);
+void atomic_store_ptr(void *volatile *ptr, void *value);
+
+// Work stealing: every worker has its own queue of tasks and takes from the others when it runs out.
+typedef struct ThreadPool ThreadPool;
+
+// Tasks waited on together. Unlike pool_wait, a task can wait for the group of tasks it submitted.
+typedef struct {
+    volatile int pending;
+} TaskGroup;
+
+#define TASK_GROUP_INIT {0}
+
+// threads <= 0 uses one thread per hardware thread.
+ThreadPool *pool_new(int threads);
+void pool_free(ThreadPool *pool);
+int pool_thread_count(const ThreadPool *pool);
+
+void pool_submit(ThreadPool *pool, TaskFn fn, void *arg);
+void pool_submit_group(ThreadPool *pool, TaskGroup *group, TaskFn fn, void *arg);
+// Blocks until every submitted task has finished, running queued tasks meanwhile. Not for use inside a task.
+void pool_wait(ThreadPool *pool);
+// Runs queued tasks until every task of group has finished.
+void pool_wait_group(ThreadPool *pool, TaskGroup *group);
+
+#endif //NIFTY_THREAD_H
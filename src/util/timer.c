@@ -0,0 +1,69 @@
+/*
+ * Nifty - Nifty Programming Language
+ * Copyright (c) 2024 Skyler Burwell
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+
+#include "timer.h"
+
+#include "../common.h"
+
+#ifndef N_WIN
+#   include <time.h>
+#   include <sys/resource.h>
+#else
+#   include <psapi.h>
+#endif
+
+uint64_t timer_now_ns() {
+#ifndef N_WIN
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#else
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)freq.QuadPart);
+#endif
+}
+
+double timer_elapsed_ms(const uint64_t start) {
+    return (double)(timer_now_ns() - start) / 1e6;
+}
+
+long timer_peak_rss_kb() {
+#ifndef N_WIN
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#   ifdef N_MAC
+    return usage.ru_maxrss / 1024; // Bytes on macOS.
+#   else
+    return usage.ru_maxrss;
+#   endif
+#else
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return (long)(counters.PeakWorkingSetSize / 1024);
+#endif
+}